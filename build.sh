@@ -0,0 +1,21 @@
+#!/bin/sh
+
+# Headless software pipeline, for profiling and checking the portable core off Windows
+
+NAME=overlay_headless
+CFLAGS="-o $NAME -std=c++17 -O2 -g -fno-exceptions -fno-rtti -Wall -Wno-unused-function -Wno-unused-variable"
+
+# @Note -x11 and -bench x11 need the Xlib and MIT-SHM headers, XDamage is looked up when it runs
+LIBS=""
+if [ -f /usr/include/X11/extensions/XShm.h ]; then
+	CFLAGS="$CFLAGS -DX11_CAPTURE=1"
+	LIBS="-lX11 -lXext -ldl"
+fi
+
+# @Note -gl and -bench opengl need EGL and the GL core headers, Mesa's llvmpipe is enough to run them
+if [ -f /usr/include/EGL/egl.h ] && [ -f /usr/include/GL/glcorearb.h ]; then
+	CFLAGS="$CFLAGS -DOPENGL_COMPOSITOR=1"
+	LIBS="$LIBS -lEGL"
+fi
+
+c++ $CFLAGS "$(dirname "$0")/linux_main.cpp" $LIBS && echo SUCCESS
@@ -0,0 +1,4896 @@
+//
+// Micro benchmarks for the headless tool, -bench <name>
+//
+
+// @Note xorshift, same sequence every run so numbers are comparable between builds
+internal u32 NextRandom(u32 *Series)
+{
+	u32 X = *Series;
+	X ^= X << 13;
+	X ^= X >> 17;
+	X ^= X << 5;
+	*Series = X;
+	
+	return X;
+}
+
+inline int RandomBetween(u32 *Series, int Min, int Max)
+{
+	return Min + (int)(NextRandom(Series) % (u32)(Max - Min + 1));
+}
+
+//
+// Atlas: overlays coming and going and changing size, the way dragging them around does
+//
+
+#define ATLAS_BENCH_ROUNDS 200000
+
+internal bool BenchmarkAtlas()
+{
+	atlas_layout Layout;
+	InitializeAtlasLayout(&Layout, 8192);
+	
+	int Widths[MAX_OVERLAYS];
+	int Heights[MAX_OVERLAYS];
+	bool SlotMoved[ATLAS_MAX_SLOTS];
+	u32 Count = 0;
+	u32 Series = 0x12345678;
+	
+	u64 MovedCount     = 0;
+	double Occupancy   = 0.0;
+	double WorstFill   = 1.0;
+	
+	u64 StartTime = GetNanoseconds();
+	for (int Round = 0; Round < ATLAS_BENCH_ROUNDS; ++Round)
+	{
+		int Action = RandomBetween(&Series, 0, 3);
+		if (((Action == 0) || (Count == 0)) && (Count < MAX_OVERLAYS))
+		{
+			Widths[Count]  = RandomBetween(&Series, 16, 640);
+			Heights[Count] = RandomBetween(&Series, 16, 480);
+			++Count;
+		}
+		else if ((Action == 1) && (Count > 1))
+		{
+			// Remove one from the middle, the rest shift down like RemoveOverlay does
+			u32 Index = (u32)RandomBetween(&Series, 0, (int)Count - 1);
+			for (u32 Shift = Index; Shift + 1 < Count; ++Shift)
+			{
+				Widths[Shift]  = Widths[Shift + 1];
+				Heights[Shift] = Heights[Shift + 1];
+			}
+			--Count;
+		}
+		else
+		{
+			// A resize drag, a few pixels at a time
+			u32 Index = (u32)RandomBetween(&Series, 0, (int)Count - 1);
+			Widths[Index]  = Max(16, Min(640, Widths[Index]  + RandomBetween(&Series, -8, 8)));
+			Heights[Index] = Max(16, Min(480, Heights[Index] + RandomBetween(&Series, -8, 8)));
+		}
+		
+		UpdateAtlasLayout(&Layout, Widths, Heights, Count, SlotMoved);
+		
+		u64 Area = 0;
+		for (u32 Index = 0; Index < Count; ++Index)
+		{
+			if (BoxIsEmpty(Layout.Slots[Index]))
+			{
+				fprintf(stderr, "atlas could not fit %u overlays\n", Count);
+				return false;
+			}
+			
+			MovedCount += SlotMoved[Index] ? 1 : 0;
+			Area += (u64)Widths[Index] * Heights[Index];
+		}
+		
+		box Bounds = GetAtlasBounds(&Layout);
+		double Fill = (double)Area / ((double)GetBoxWidth(Bounds) * GetBoxHeight(Bounds));
+		Occupancy += Fill;
+		WorstFill = Min(WorstFill, Fill);
+	}
+	u64 ElapsedTime = GetNanoseconds() - StartTime;
+	
+	printf("atlas %d updates, %.1fns per update, %.1f%% average fill, %.1f%% worst, %llu slot moves, %u rebuilds, ends %dx%d\n",
+		   ATLAS_BENCH_ROUNDS, (double)ElapsedTime / ATLAS_BENCH_ROUNDS, 100.0 * Occupancy / ATLAS_BENCH_ROUNDS, 100.0 * WorstFill,
+		   (unsigned long long)MovedCount, Layout.RebuildCount, Layout.Packer.Width, Layout.Packer.Height);
+	
+	return true;
+}
+
+//
+// Pacing: a source with jitter on a made up clock, presents land where RunOverlayFrame would put them
+//
+
+#define PACING_BENCH_SECONDS 60
+
+struct pacing_scenario
+{
+	const char *Name;
+	u32 SourceRate;
+	u32 SourceJitter; // Microseconds either way
+	pacing_mode Mode;
+	u32 CapRate;
+};
+
+internal void BenchmarkPacingScenario(pacing_scenario *Scenario, u32 *Series)
+{
+	frame_pacer Pacer = {};
+	pacing_params Params;
+	Params.Mode    = Scenario->Mode;
+	Params.CapRate = Scenario->CapRate;
+	UpdatePacingParams(&Pacer, Params);
+	
+	u64 SourceInterval = 1000000 / Scenario->SourceRate;
+	u64 EndTime        = (u64)PACING_BENCH_SECONDS * 1000000;
+	u64 ArrivalTime    = SourceInterval;
+	
+	bool PresentPending = false;
+	u64 SourceCount  = 0;
+	u64 PresentCount = 0;
+	u64 ShortestGap  = (u64)-1;
+	u64 PacerTime    = 0;
+	
+	while (ArrivalTime < EndTime)
+	{
+		u64 NextArrival = ArrivalTime + SourceInterval - Scenario->SourceJitter + (u64)RandomBetween(Series, 0, 2 * (int)Scenario->SourceJitter);
+		
+		u64 StartTime = GetNanoseconds();
+		
+		// @Note A frame arrives, gets cropped, and either goes now or waits for its turn replacing whatever was waiting
+		++SourceCount;
+		NoteSourceFrame(&Pacer, ArrivalTime);
+		if (PresentPending)
+		{
+			++Pacer.DroppedFrameCount;
+		}
+		PresentPending = true;
+		
+		u64 Now = ArrivalTime;
+		u64 Delay = GetPresentDelay(&Pacer, Now);
+		
+		// @Note Otherwise the acquire times out when its turn comes, unless the next frame beats it
+		if ((Delay > 0) && (Now + Delay < NextArrival))
+		{
+			Now += Delay;
+			Delay = 0;
+		}
+		
+		if (Delay == 0)
+		{
+			u64 LastPresentTime = Pacer.LastPresentTime;
+			NotePresent(&Pacer, Now);
+			PresentPending = false;
+			
+			if (PresentCount++ > 0)
+			{
+				ShortestGap = Min(ShortestGap, Now - LastPresentTime);
+			}
+		}
+		
+		PacerTime += GetNanoseconds() - StartTime;
+		ArrivalTime = NextArrival;
+	}
+	
+	printf("pacing %-28s %6.1f frames/s in, %6.1f presented, %5.1f%% dropped, jitter avg %7.1fus, max %6lluus, shortest gap %6lluus, %.1fns per frame\n",
+		   Scenario->Name, (double)SourceCount / PACING_BENCH_SECONDS, (double)PresentCount / PACING_BENCH_SECONDS,
+		   100.0 * Pacer.DroppedFrameCount / SourceCount, Pacer.JitterCount ? (double)Pacer.JitterTotal / Pacer.JitterCount : 0.0,
+		   (unsigned long long)Pacer.JitterMax, (unsigned long long)ShortestGap, (double)PacerTime / SourceCount);
+}
+
+internal bool BenchmarkPacing()
+{
+	pacing_scenario Scenarios[] =
+	{
+		{ "144Hz +-1ms, lowest latency", 144, 1000, PacingMode_LowestLatency, 0 },
+		{ "144Hz +-1ms, cap 30",         144, 1000, PacingMode_FixedCap,      30 },
+		{ "144Hz +-1ms, cap 60",         144, 1000, PacingMode_FixedCap,      60 },
+		{ "144Hz +-1ms, match source",   144, 1000, PacingMode_MatchSource,   0 },
+		{ "60Hz +-2ms, cap 30",          60,  2000, PacingMode_FixedCap,      30 },
+		{ "60Hz +-2ms, match source",    60,  2000, PacingMode_MatchSource,   0 },
+		{ "240Hz +-0.5ms, cap 30",       240, 500,  PacingMode_FixedCap,      30 },
+	};
+	
+	u32 Series = 0x12345678;
+	for (u32 ScenarioIndex = 0; ScenarioIndex < GetArrayCount(Scenarios); ++ScenarioIndex)
+	{
+		BenchmarkPacingScenario(&Scenarios[ScenarioIndex], &Series);
+	}
+	
+	return true;
+}
+
+//
+// Latency: what recording costs the thread being measured, and what the dumper pays per sample
+//
+
+#define LATENCY_BENCH_SAMPLES 4000000
+#define LATENCY_BENCH_BATCH   1024
+#define LATENCY_BENCH_BUDGET  1000 // Nanoseconds a sample may cost the recording thread
+
+internal bool BenchmarkLatency()
+{
+	latency_ring *Ring = (latency_ring *)LinuxAllocateMemory(sizeof(latency_ring));
+	latency_recorder *Recorder = (latency_recorder *)LinuxAllocateMemory(sizeof(latency_recorder));
+	if (!Ring || !Recorder)
+	{
+		Error("Latency benchmark memory");
+	}
+	
+	InitializeLatencyRing(Ring, GetNanoseconds);
+	InitializeLatencyRecorder(Recorder);
+	AddLatencyRing(Recorder, Ring);
+	
+	// @Note Known spread of durations so the percentiles can be checked, 1ns to about 16ms
+	u32 Series = 0x12345678;
+	u64 PushTime  = 0;
+	u64 DrainTime = 0;
+	for (u32 Sample = 0; Sample < LATENCY_BENCH_SAMPLES; Sample += LATENCY_BENCH_BATCH)
+	{
+		u64 StartTime = GetNanoseconds();
+		for (u32 BatchIndex = 0; BatchIndex < LATENCY_BENCH_BATCH; ++BatchIndex)
+		{
+			u32 Duration = 1 + (NextRandom(&Series) >> 8);
+			PushLatencySample(Ring, (latency_stage)(BatchIndex % LatencyStage_Count), Duration);
+		}
+		
+		u64 MidTime = GetNanoseconds();
+		DrainLatencyRings(Recorder);
+		
+		u64 EndTime = GetNanoseconds();
+		PushTime  += MidTime - StartTime;
+		DrainTime += EndTime - MidTime;
+	}
+	
+	// @Note The real thing, two clock reads around nothing
+	u64 PairStart = GetNanoseconds();
+	for (u32 Sample = 0; Sample < LATENCY_RING_SIZE; ++Sample)
+	{
+		u64 Start = StartLatency(Ring);
+		EndLatency(Ring, LatencyStage_Layout, Start);
+	}
+	u64 PairTime = GetNanoseconds() - PairStart;
+	
+	// @Note One more than fits, the last one has to be dropped rather than waited on
+	DrainLatencyRings(Recorder);
+	for (u32 Sample = 0; Sample <= LATENCY_RING_SIZE; ++Sample)
+	{
+		PushLatencySample(Ring, LatencyStage_Layout, 1);
+	}
+	bool DroppedOne = (GetDroppedLatencySamples(Recorder) == 1);
+	DrainLatencyRings(Recorder);
+	
+	// @Note Uniform durations, so every percentile is known, allow the bucket width on top of the sampling noise
+	latency_histogram *Histogram = &Recorder->Histograms[LatencyStage_Crop];
+	u32 Expected = (u32)((u64)(1 << 24) * 9900 / 10000);
+	u32 Measured = GetLatencyPercentile(Histogram, 9900);
+	bool PercentileIsClose = (Measured > Expected - Expected / 16) && (Measured < Expected + Expected / 16);
+	
+	double PushCost  = (double)PushTime  / LATENCY_BENCH_SAMPLES;
+	double DrainCost = (double)DrainTime / LATENCY_BENCH_SAMPLES;
+	double PairCost  = (double)PairTime  / LATENCY_RING_SIZE;
+	
+	printf("latency push %.1fns, start+end with clock reads %.1fns, drain into histogram %.1fns per sample (budget %dns)\n",
+		   PushCost, PairCost, DrainCost, LATENCY_BENCH_BUDGET);
+	printf("latency p99 of uniform 1..%u is %u, expected about %u, %s; ring full %s\n", 1 << 24, Measured, Expected,
+		   PercentileIsClose ? "ok" : "OFF", DroppedOne ? "drops" : "DOES NOT DROP");
+	
+	char ReportMemory[1024];
+	text_buffer Report = { ReportMemory, sizeof(ReportMemory) - 1, 0 };
+	WriteLatencyReport(Recorder, LatencyFormat_CSV, &Report);
+	Report.Memory[Report.Used] = 0;
+	printf("%s", Report.Memory);
+	
+	LinuxFreeMemory(Ring, sizeof(latency_ring));
+	LinuxFreeMemory(Recorder, sizeof(latency_recorder));
+	
+	return (PairCost < LATENCY_BENCH_BUDGET) && PercentileIsClose && DroppedOne;
+}
+
+//
+// Shade: every kernel this machine has against the scalar one, over cut box sizes and scales
+//
+
+#define SHADE_BENCH_PIXELS 20000000 // Destination pixels per kernel and case, enough to get past the noise
+
+struct shade_case
+{
+	const char *Name;
+	int CutWidth;
+	int CutHeight;
+	int DisplayWidth;
+	int DisplayHeight;
+	bool Rotated;
+};
+
+internal bool BenchmarkShade()
+{
+	shade_case Cases[] =
+	{
+		{ "64x64 1:1",               64,   64,   64,   64,   false },
+		{ "200x200 1:1",             200,  200,  200,  200,  false },
+		{ "200x200 -> 300x300",      200,  200,  300,  300,  false },
+		{ "640x480 -> 320x240",      640,  480,  320,  240,  false },
+		{ "640x480 -> 480x640 rot",  640,  480,  480,  640,  true  },
+		{ "1920x1080 1:1",           1920, 1080, 1920, 1080, false },
+		{ "1920x1080 -> 2880x1620",  1920, 1080, 2880, 1620, false },
+	};
+	
+	int MaxTexture = 2048;
+	int MaxTarget  = 3072;
+	size_t TextureSize = (size_t)MaxTexture * MaxTexture * BITMAP_BYTES_PER_PIXEL;
+	size_t TargetSize  = (size_t)MaxTarget  * MaxTarget  * BITMAP_BYTES_PER_PIXEL;
+	
+	bitmap Texture   = { (u8 *)LinuxAllocateMemory(TextureSize), MaxTexture, MaxTexture, MaxTexture * BITMAP_BYTES_PER_PIXEL };
+	bitmap Reference = { (u8 *)LinuxAllocateMemory(TargetSize),  MaxTarget,  MaxTarget,  MaxTarget  * BITMAP_BYTES_PER_PIXEL };
+	bitmap Target    = { (u8 *)LinuxAllocateMemory(TargetSize),  MaxTarget,  MaxTarget,  MaxTarget  * BITMAP_BYTES_PER_PIXEL };
+	if (!Texture.Memory || !Reference.Memory || !Target.Memory)
+	{
+		Error("Shade benchmark memory");
+	}
+	
+	// @Note Noise, so every tap and every weight matters
+	u32 Series = 0x12345678;
+	u32 *Texels = (u32 *)Texture.Memory;
+	for (int TexelIndex = 0; TexelIndex < MaxTexture * MaxTexture; ++TexelIndex)
+	{
+		Texels[TexelIndex] = NextRandom(&Series) | 0xFF000000;
+	}
+	
+	shade_params Shade = {};
+	Shade.Alpha  = 0.1f;
+	Shade.Darken = 0.1f;
+	
+	bool AllMatch = true;
+	for (u32 CaseIndex = 0; CaseIndex < GetArrayCount(Cases); ++CaseIndex)
+	{
+		shade_case *Case = &Cases[CaseIndex];
+		
+		// @Note Not at the atlas origin, so the clamp to the slot is exercised
+		box CropSlot = { 3, 5, 3 + Case->CutWidth, 5 + Case->CutHeight };
+		
+		uv_transform UV;
+		UV.Origin = v2{ 0.0f, 0.0f };
+		UV.AxisX  = v2{ 1.0f, 0.0f };
+		UV.AxisY  = v2{ 0.0f, 1.0f };
+		if (Case->Rotated)
+		{
+			UV.Origin = v2{ 1.0f, 0.0f };
+			UV.AxisX  = v2{ 0.0f, 1.0f };
+			UV.AxisY  = v2{ -1.0f, 0.0f };
+		}
+		
+		// @Note Off the pixel grid like a piece of a spanned cut box can be
+		v2 DestinationMin = { 1.25f, 2.5f };
+		v2 DestinationMax = { 1.25f + (float)Case->DisplayWidth, 2.5f + (float)Case->DisplayHeight };
+		u64 PixelCount = (u64)Case->DisplayWidth * Case->DisplayHeight;
+		int Repeats = (int)Max(SHADE_BENCH_PIXELS / PixelCount, (u64)1);
+		
+		ShadePiece(&Reference, DestinationMin, DestinationMax, &Texture, CropSlot, UV, Shade, ShadeRowScalar);
+		
+		u64 ScalarElapsed = 0;
+		for (int Kernel = 0; Kernel < ShadeKernel_Count; ++Kernel)
+		{
+			shade_row_function *ShadeRow = GetShadeRow((shade_kernel)Kernel);
+			if (!ShadeRow)
+			{
+				continue;
+			}
+			
+			u64 StartTime = GetNanoseconds();
+			for (int Repeat = 0; Repeat < Repeats; ++Repeat)
+			{
+				ShadePiece(&Target, DestinationMin, DestinationMax, &Texture, CropSlot, UV, Shade, ShadeRow);
+			}
+			u64 Elapsed = GetNanoseconds() - StartTime;
+			if (Kernel == ShadeKernel_Scalar)
+			{
+				ScalarElapsed = Elapsed;
+			}
+			
+			int MaxDifference = 0;
+			u64 DifferentCount = 0;
+			for (int Y = 0; Y < Case->DisplayHeight + 3; ++Y)
+			{
+				u8 *ReferenceRow = Reference.Memory + Y * Reference.Pitch;
+				u8 *TargetRow    = Target.Memory    + Y * Target.Pitch;
+				for (int Byte = 0; Byte < (Case->DisplayWidth + 2) * BITMAP_BYTES_PER_PIXEL; ++Byte)
+				{
+					int Difference = (ReferenceRow[Byte] > TargetRow[Byte]) ? (ReferenceRow[Byte] - TargetRow[Byte]) : (TargetRow[Byte] - ReferenceRow[Byte]);
+					MaxDifference = Max(MaxDifference, Difference);
+					DifferentCount += (Difference != 0);
+				}
+			}
+			
+			// @Note Bit exact on x86, one off allowed for the fused multiply-adds on ARM
+			bool Matches = (MaxDifference <= 1);
+			AllMatch &= Matches;
+			
+			printf("shade %-24s %-6s %8.1f Mpixel/s, %6.2fx scalar, max diff %d (%llu bytes differ)%s\n", Case->Name, ShadeKernelNames[Kernel],
+				   (double)PixelCount * Repeats * 1000.0 / (double)Elapsed, (double)ScalarElapsed / (double)Elapsed, MaxDifference, (unsigned long long)DifferentCount,
+				   Matches ? "" : " MISMATCH");
+		}
+	}
+	
+	LinuxFreeMemory(Texture.Memory, TextureSize);
+	LinuxFreeMemory(Reference.Memory, TargetSize);
+	LinuxFreeMemory(Target.Memory, TargetSize);
+	
+	return AllMatch;
+}
+
+//
+// Tiles: a whole 1080p cut box cropped and scaled up to 1620p through the software compositor, 1 to N threads
+//
+
+#define TILES_BENCH_FRAMES 60
+
+// @Note FNV-1a, to tell whether every thread count drew the same thing
+internal u64 HashBytes(u8 *Bytes, size_t Size)
+{
+	u64 Hash = 14695981039346656037ull;
+	for (size_t Index = 0; Index < Size; ++Index)
+	{
+		Hash = (Hash ^ Bytes[Index]) * 1099511628211ull;
+	}
+	
+	return Hash;
+}
+
+internal bool BenchmarkTiles()
+{
+	int DesktopWidth  = 1920;
+	int DesktopHeight = 1080;
+	
+	memory_arena Arena;
+	size_t MemorySize = Megabytes(4) + (size_t)DesktopWidth * DesktopHeight * BITMAP_BYTES_PER_PIXEL;
+	InitializeArena(&Arena, LinuxAllocateMemory(MemorySize), MemorySize);
+	
+	bitmap *Desktop = PushStruct(&Arena, bitmap);
+	*Desktop = PushBitmap(&Arena, DesktopWidth, DesktopHeight);
+	
+	u32 Series = 0x12345678;
+	u32 *Pixels = (u32 *)Desktop->Memory;
+	for (int PixelIndex = 0; PixelIndex < DesktopWidth * DesktopHeight; ++PixelIndex)
+	{
+		Pixels[PixelIndex] = NextRandom(&Series) | 0xFF000000;
+	}
+	
+	box Output = { 0, 0, DesktopWidth, DesktopHeight };
+	render_state State = DefaultRenderState(&Output, 1, DesktopWidth, DesktopHeight);
+	State.Overlays[0].DisplayWidth  = DesktopWidth  * 3 / 2;
+	State.Overlays[0].DisplayHeight = DesktopHeight * 3 / 2;
+	
+	output_geometry Geometry[MAX_OUTPUTS];
+	Geometry[0].Rotation      = DisplayRotation_Identity;
+	Geometry[0].DesktopWidth  = DesktopWidth;
+	Geometry[0].DesktopHeight = DesktopHeight;
+	
+	crop_piece Pieces[MAX_CROP_PIECES];
+	u32 PieceCount = BuildCropPieces(&State, Geometry, Pieces);
+	Pieces[0].HasImage = true;
+	
+	captured_frame Frame = {};
+	Frame.Surface       = Desktop;
+	Frame.DesktopWidth  = DesktopWidth;
+	Frame.DesktopHeight = DesktopHeight;
+	
+	box CutBox = Pieces[0].Mapping.SurfaceBox;
+	
+	// @Note At least two so the pool gets exercised, more than the cores only time-slices
+	long CoreCount = sysconf(_SC_NPROCESSORS_ONLN);
+	u32 MaxThreads = (u32)Min(Max(CoreCount, 2L), (long)MAX_TILE_WORKERS);
+	tile_pool *Pool = CreateTilePool(&Arena, MaxThreads, false);
+	
+	software_compositor *Compositor = PushStruct(&Arena, software_compositor);
+	InitializeSoftwareCompositor(Compositor, LinuxAllocateMemory, LinuxFreeMemory);
+	Compositor->TilePool = Pool;
+	
+	bool SlotMoved[MAX_CROP_PIECES];
+	SoftwareLayout(Compositor, &State, Pieces, PieceCount, SlotMoved);
+	
+	bitmap *Target = &Compositor->BackBuffer;
+	u64 DisplayPixels = (u64)Target->Width * Target->Height;
+	
+	printf("tiles %dx%d -> %dx%d, %s kernel, %ld cores\n", GetBoxWidth(CutBox), GetBoxHeight(CutBox), Target->Width, Target->Height,
+		   ShadeKernelNames[Compositor->ShadeKernel], CoreCount);
+	
+	bool AllMatch = true;
+	u64 FirstHash = 0;
+	double OneThreadTime = 0.0;
+	for (u32 ThreadCount = 1;; ThreadCount = Min(ThreadCount * 2, MaxThreads))
+	{
+		// @Note The extra workers just never get woken
+		Pool->WorkerCount = ThreadCount;
+		u64 StolenBefore = GetStolenTileCount(Pool);
+		u64 AllocationsBefore = AllocationCount;
+		
+		u64 StartTime = GetNanoseconds();
+		for (int FrameIndex = 0; FrameIndex < TILES_BENCH_FRAMES; ++FrameIndex)
+		{
+			SoftwareCrop(Compositor, &Frame, 0, CutBox, &CutBox, 1);
+			SoftwareShade(Compositor, &State, Pieces, PieceCount);
+		}
+		double FrameTime = (double)(GetNanoseconds() - StartTime) / TILES_BENCH_FRAMES / 1000.0;
+		
+		u64 Hash = HashBytes(Target->Memory, (size_t)Target->Pitch * Target->Height);
+		if (ThreadCount == 1)
+		{
+			FirstHash     = Hash;
+			OneThreadTime = FrameTime;
+		}
+		
+		bool Matches = (Hash == FirstHash);
+		AllMatch &= Matches;
+		
+		printf("tiles %2u threads %9.1fus per frame, %7.1f Mpixel/s, %5.2fx, %llu stolen, %llu allocations, %s\n", ThreadCount, FrameTime,
+			   (double)DisplayPixels / FrameTime, OneThreadTime / FrameTime, (unsigned long long)(GetStolenTileCount(Pool) - StolenBefore),
+			   (unsigned long long)(AllocationCount - AllocationsBefore), Matches ? "same image" : "DIFFERENT IMAGE");
+		
+		AllMatch &= (AllocationCount == AllocationsBefore);
+		if (ThreadCount == MaxThreads)
+		{
+			break;
+		}
+	}
+	
+	// @Note The worker threads stay parked, the process is about to end anyway
+	return AllMatch;
+}
+
+//
+// Record: synthetic display textures through the tile-delta writer and back out of the reader
+//
+
+#define RECORD_BENCH_FRAMES 300 // Five seconds at 60Hz, one keyframe
+#define RECORD_BENCH_RATE   60
+
+enum record_stream
+{
+	RecordStream_Static, // Nothing moves after the first frame
+	RecordStream_Mover,  // A 64x64 square crossing a still picture, the headless desktop
+	RecordStream_Scroll, // Text-like rows scrolling up a few pixels a frame
+	RecordStream_Video,  // A quarter of the picture is noise every frame
+	RecordStream_Noise,  // Every pixel changes every frame, the worst case
+	
+	RecordStream_Count,
+};
+
+global const char *RecordStreamNames[RecordStream_Count] = { "static", "mover", "scroll", "video", "noise" };
+
+// @Note Flat runs with a few edges, what a window full of text looks like to the encoder
+inline u32 GetTextPixel(int X, int Y)
+{
+	u32 Line = (u32)Y / 16;
+	bool IsInk = ((Y % 16) < 11) && ((((u32)X / 6) * 2654435761u + Line * 40503u) % 7 < 3) && ((X % 6) < 4);
+	return IsInk ? 0xFF202020 : 0xFFF0F0F0;
+}
+
+internal void DrawRecordStream(bitmap *Image, record_stream Stream, int FrameIndex, u32 *Series)
+{
+	u8 *Row = Image->Memory;
+	for (int Y = 0; Y < Image->Height; ++Y)
+	{
+		u32 *Pixel = (u32 *)Row;
+		for (int X = 0; X < Image->Width; ++X)
+		{
+			u32 Colour = GetTextPixel(X, Y);
+			if (Stream == RecordStream_Scroll)
+			{
+				Colour = GetTextPixel(X, Y + FrameIndex * 3);
+			}
+			else if ((Stream == RecordStream_Noise) || ((Stream == RecordStream_Video) && (X < Image->Width / 2) && (Y < Image->Height / 2)))
+			{
+				Colour = 0xFF000000 | (NextRandom(Series) & 0x00FFFFFF);
+			}
+			
+			Pixel[X] = Colour;
+		}
+		
+		Row += Image->Pitch;
+	}
+	
+	if (Stream == RecordStream_Mover)
+	{
+		int Travel = Max(Image->Width - 64, 1);
+		int Left = (FrameIndex * 7) % Travel;
+		FillBox(Image, box{ Left, Image->Height / 2 - 32, Left + 64, Image->Height / 2 + 32 }, 0xFF000000 | (0x00FFFFFF - FrameIndex * 0x010101));
+	}
+}
+
+internal bool BenchmarkRecordStream(record_stream Stream, int Width, int Height, u8 *File, size_t FileSize)
+{
+	bitmap Frames[2];
+	for (int Index = 0; Index < 2; ++Index)
+	{
+		Frames[Index].Width  = Width;
+		Frames[Index].Height = Height;
+		Frames[Index].Pitch  = Width * BITMAP_BYTES_PER_PIXEL;
+		Frames[Index].Memory = (u8 *)LinuxAllocateMemory((size_t)Frames[Index].Pitch * Height);
+	}
+	
+	// @Note One piece drawing the whole texture 1:1, the layout only goes in the keyframes
+	shade_params Shade = {};
+	Shade.Alpha  = 0.1f;
+	Shade.Darken = 0.1f;
+	
+	shade_setup Setup;
+	if (!SetupShadePiece(&Setup, &Frames[0], v2{ 0, 0 }, v2{ (float)Width, (float)Height }, &Frames[0], box{ 0, 0, Width, Height },
+						 GetRotationUV(DisplayRotation_Identity), Shade))
+	{
+		return false;
+	}
+	
+	recording_writer Writer;
+	InitializeRecordingWriter(&Writer, LinuxAllocateMemory, LinuxFreeMemory);
+	
+	recording_header Header = GetRecordingHeader();
+	CopyBytes(File, &Header, sizeof(Header));
+	size_t Used = sizeof(Header);
+	
+	// @Note Every frame is drawn before the clock starts, only the encoder is timed. Hashes check the decode.
+	u64 Hashes[RECORD_BENCH_FRAMES];
+	u64 EncodeTime = 0;
+	u32 Series = 1234;
+	for (int FrameIndex = 0; FrameIndex < RECORD_BENCH_FRAMES; ++FrameIndex)
+	{
+		bitmap *Image = &Frames[FrameIndex & 1];
+		if ((Stream != RecordStream_Static) || (FrameIndex < 2))
+		{
+			DrawRecordStream(Image, Stream, FrameIndex, &Series);
+		}
+		Hashes[FrameIndex] = HashBytes(Image->Memory, (size_t)Image->Pitch * Height);
+		
+		u64 StartTime = GetNanoseconds();
+		size_t Size = EncodeRecordingFrame(&Writer, Image, (u64)FrameIndex * 1000000 / RECORD_BENCH_RATE, &Setup, 1, ScaleMode_Bilinear, Width, Height);
+		EncodeTime += GetNanoseconds() - StartTime;
+		
+		if (!Size || (Used + Size > FileSize))
+		{
+			return false;
+		}
+		
+		CopyBytes(File + Used, Writer.Buffer, Size);
+		Used += Size;
+	}
+	
+	u64 *FrameOffsets = (u64 *)LinuxAllocateMemory(RECORD_BENCH_FRAMES * sizeof(u64));
+	recording_reader Reader;
+	if (!InitializeRecordingReader(&Reader, File, Used, FrameOffsets, RECORD_BENCH_FRAMES, LinuxAllocateMemory, LinuxFreeMemory) ||
+		(Reader.FrameCount != RECORD_BENCH_FRAMES))
+	{
+		return false;
+	}
+	
+	bool Matches = true;
+	u64 DecodeTime = 0;
+	for (u32 FrameIndex = 0; FrameIndex < Reader.FrameCount; ++FrameIndex)
+	{
+		u64 StartTime = GetNanoseconds();
+		bool Decoded = SeekRecording(&Reader, FrameIndex);
+		DecodeTime += GetNanoseconds() - StartTime;
+		
+		Matches &= Decoded && (HashBytes(Reader.Image.Memory, (size_t)Reader.Image.Pitch * Height) == Hashes[FrameIndex]);
+	}
+	
+	// @Note Random seeks, each one from the keyframe before it
+	u64 SeekTime = 0;
+	for (int SeekIndex = 0; SeekIndex < 20; ++SeekIndex)
+	{
+		u32 FrameIndex = NextRandom(&Series) % RECORD_BENCH_FRAMES;
+		Reader.CurrentFrame = RECORDING_NO_FRAME;
+		
+		u64 StartTime = GetNanoseconds();
+		bool Decoded = SeekRecording(&Reader, FrameIndex);
+		SeekTime += GetNanoseconds() - StartTime;
+		
+		Matches &= Decoded && (HashBytes(Reader.Image.Memory, (size_t)Reader.Image.Pitch * Height) == Hashes[FrameIndex]);
+	}
+	
+	double RawBytes = (double)RECORD_BENCH_FRAMES * Width * Height * BITMAP_BYTES_PER_PIXEL;
+	double MinuteBytes = (double)Used / RECORD_BENCH_FRAMES * RECORD_BENCH_RATE * 60.0;
+	printf("record %-6s %4dx%-4d %8.1fKB per frame, %8.1fMB a minute at %dHz, %5.1f%% of raw, encode %7.1fMB/s, decode %7.1fMB/s, seek %7.2fms, %s\n",
+		   RecordStreamNames[Stream], Width, Height, GetKilobytes(Used) / RECORD_BENCH_FRAMES, MinuteBytes / (1024.0 * 1024.0),
+		   RECORD_BENCH_RATE, 100.0 * Used / RawBytes, RawBytes / ((double)EncodeTime / 1000.0), RawBytes / ((double)DecodeTime / 1000.0),
+		   (double)SeekTime / 20 / 1000000.0, Matches ? "same frames" : "DIFFERENT FRAMES");
+	
+	// @Note Bench memory, the process ends soon after
+	return Matches;
+}
+
+internal bool BenchmarkRecord()
+{
+	// @Note Room for every frame raw and then some, the noise stream is about that
+	size_t FileSize = (size_t)RECORD_BENCH_FRAMES * (GetRecordingFrameBound(1280, 720) + 64);
+	u8 *File = (u8 *)LinuxAllocateMemory(FileSize);
+	if (!File)
+	{
+		return false;
+	}
+	
+	bool AllMatch = true;
+	for (int Stream = 0; Stream < RecordStream_Count; ++Stream)
+	{
+		AllMatch &= BenchmarkRecordStream((record_stream)Stream, 1280, 720, File, FileSize);
+	}
+	
+	return AllMatch;
+}
+
+//
+// Hash: is a crop the same as last time, tile hashes against comparing with a kept copy of the whole slot
+//
+// @Note The detector picks the kept copy up to CHANGE_COMPARE_MAX_PIXELS, whichever it picks has to be the faster
+// of the two there, give or take HASH_BENCH_SLACK for the noise
+//
+
+#define HASH_BENCH_ROUNDS 2000
+#define HASH_BENCH_BUDGET 100 // Microseconds for a 400x400 crop
+#define HASH_BENCH_SLACK  1.15
+
+struct hash_case
+{
+	const char *Name;
+	int Width;
+	int Height;
+};
+
+internal bool BenchmarkHash()
+{
+	hash_case Cases[] =
+	{
+		{ "400x400",   400,  400  },
+		{ "200x200",   200,  200  },
+		{ "1920x1080", 1920, 1080 },
+	};
+	
+	bool AllGood = true;
+	for (u32 CaseIndex = 0; CaseIndex < GetArrayCount(Cases); ++CaseIndex)
+	{
+		hash_case *Case = &Cases[CaseIndex];
+		size_t Size = (size_t)Case->Width * Case->Height * BITMAP_BYTES_PER_PIXEL;
+		
+		bitmap Texture = { (u8 *)LinuxAllocateMemory(Size), Case->Width, Case->Height, Case->Width * BITMAP_BYTES_PER_PIXEL };
+		u8 *Kept = (u8 *)LinuxAllocateMemory(Size);
+		
+		u32 Series = 0x2468ACE0;
+		u32 *Texels = (u32 *)Texture.Memory;
+		for (int Texel = 0; Texel < Case->Width * Case->Height; ++Texel)
+		{
+			Texels[Texel] = NextRandom(&Series) | 0xFF000000;
+		}
+		CopyBytes(Kept, Texture.Memory, Size);
+		
+		box Whole = { 0, 0, Case->Width, Case->Height };
+		int Rounds = (int)Max((u64)HASH_BENCH_ROUNDS * 400 * 400 / ((u64)Case->Width * Case->Height), (u64)20);
+		
+		// @Note What the hash saves us from, a second copy of the slot that has to be kept up to date.
+		// A change in the last row is its worst case, all of it compared and then all of it copied.
+		u32 *LastPixel = (u32 *)(Texture.Memory + Size) - 1;
+		double CompareTimes[2];
+		for (int Changing = 0; Changing < 2; ++Changing)
+		{
+			u64 StartTime = GetNanoseconds();
+			u32 SameCount = 0;
+			for (int Round = 0; Round < Rounds; ++Round)
+			{
+				*LastPixel ^= Changing;
+				
+				bool Same = (memcmp(Kept, Texture.Memory, Size) == 0);
+				if (!Same)
+				{
+					memcpy(Kept, Texture.Memory, Size);
+				}
+				SameCount += Same;
+			}
+			CompareTimes[Changing] = (double)(GetNanoseconds() - StartTime) / Rounds / 1000.0;
+			
+			AllGood &= (SameCount == (Changing ? 0u : (u32)Rounds));
+		}
+		double CompareTime = CompareTimes[0];
+		
+		printf("hash %-9s compare  %8.2fus, %.2fus when it changed, keeps a %.1fKB copy\n", Case->Name, CompareTime, CompareTimes[1],
+			   GetKilobytes(Size));
+		
+		// @Note The kernels with the copy turned off, then the copy, which is the last method
+		u64 ScalarHashes[8];
+		double BestHashTime = 0.0;
+		double KeptTime = 0.0;
+		for (int Kernel = 0; Kernel <= ShadeKernel_Count; ++Kernel)
+		{
+			bool Keeps = (Kernel == ShadeKernel_Count);
+			if (!Keeps && !GetHashTile((shade_kernel)Kernel))
+			{
+				continue;
+			}
+			
+			change_detector Detector;
+			InitializeChangeDetector(&Detector, LinuxAllocateMemory, LinuxFreeMemory, Keeps ? GetBestShadeKernel() : (shade_kernel)Kernel);
+			Detector.MaxComparePixels = Keeps ? (u64)Case->Width * Case->Height : 0;
+			ResizeChangeDetector(&Detector, Case->Width, Case->Height);
+			
+			u32 TileCount = Detector.TilesAcross * Detector.TilesDown;
+			bool Good = (DetectChanges(&Detector, &Texture, Whole) == TileCount);
+			
+			u64 StartTime = GetNanoseconds();
+			u32 ChangedCount = 0;
+			for (int Round = 0; Round < Rounds; ++Round)
+			{
+				ChangedCount += DetectChanges(&Detector, &Texture, Whole);
+			}
+			double HashTime = (double)(GetNanoseconds() - StartTime) / Rounds / 1000.0;
+			Good &= (ChangedCount == 0);
+			
+			// @Note One pixel in a tile changes that tile and no other, even in its top bit. Putting it back undoes it.
+			int X = Case->Width / 2 + 3;
+			int Y = Case->Height / 3 + 5;
+			u32 *Pixel = (u32 *)(Texture.Memory + Y * Texture.Pitch + X * BITMAP_BYTES_PER_PIXEL);
+			u32 Original = *Pixel;
+			
+			ClearChangedTiles(&Detector);
+			*Pixel ^= 0x80000000;
+			Good &= (DetectChanges(&Detector, &Texture, Whole) == 1) && TileHasChanged(&Detector, X / CHANGE_TILE_SIZE, Y / CHANGE_TILE_SIZE);
+			*Pixel = Original;
+			Good &= (DetectChanges(&Detector, &Texture, Whole) == 1);
+			
+			// @Note Two bits that would cancel out in a hash that only xors the lanes
+			ClearChangedTiles(&Detector);
+			u32 *Below = (u32 *)((u8 *)Pixel + Texture.Pitch);
+			*Pixel ^= 0x80000000;
+			*Below ^= 0x80000000;
+			Good &= (DetectChanges(&Detector, &Texture, Whole) >= 1);
+			*Pixel = Original;
+			*Below ^= 0x80000000;
+			DetectChanges(&Detector, &Texture, Whole);
+			
+			// @Note Every kernel hashes the same, so they can take over from each other
+			if (!Keeps)
+			{
+				u64 Sample = 0;
+				for (u32 Tile = 0; Tile < TileCount; ++Tile)
+				{
+					Sample = (Sample ^ Detector.Hashes[Tile]) * 1099511628211ull;
+				}
+				if (Kernel == ShadeKernel_Scalar)
+				{
+					ScalarHashes[CaseIndex] = Sample;
+				}
+				Good &= (Sample == ScalarHashes[CaseIndex]);
+			}
+			
+			if (Keeps)
+			{
+				KeptTime = HashTime;
+			}
+			else if (Kernel == GetBestShadeKernel())
+			{
+				BestHashTime = HashTime;
+			}
+			
+			// @Note The budget is for the kernel a crop would get on this machine
+			bool InBudget = (Case->Width * Case->Height > 400 * 400) || (Kernel != GetBestShadeKernel()) || (HashTime < HASH_BENCH_BUDGET);
+			printf("hash %-9s %-6s   %8.2fus, %6.2fx compare, %u tiles, %.1fKB %s, %s%s\n", Case->Name, Keeps ? "kept" : ShadeKernelNames[Kernel],
+				   HashTime, CompareTime / HashTime, TileCount, GetKilobytes(GetChangeDetectorSize(&Detector, Case->Width, Case->Height)),
+				   Keeps ? "with the copy" : "of hashes", Good ? "detects" : "WRONG", InBudget ? "" : " OVER BUDGET");
+			
+			AllGood &= Good && InBudget;
+			FreeChangeDetector(&Detector);
+		}
+		
+		// @Note What a crop of this size actually gets
+		change_detector Picked;
+		InitializeChangeDetector(&Picked, LinuxAllocateMemory, LinuxFreeMemory, GetBestShadeKernel());
+		bool PicksKept = KeepsChangeCopy(&Picked, Case->Width, Case->Height);
+		double PickedTime = PicksKept ? KeptTime : BestHashTime;
+		double OtherTime  = PicksKept ? BestHashTime : KeptTime;
+		bool PickedIsFaster = (PickedTime <= OtherTime * HASH_BENCH_SLACK);
+		printf("hash %-9s picks %s, %.2fx the other, %s\n", Case->Name, PicksKept ? "the kept copy" : "the hashes", OtherTime / PickedTime,
+			   PickedIsFaster ? "ok" : "SLOWER");
+		
+		AllGood &= PickedIsFaster;
+		
+		LinuxFreeMemory(Texture.Memory, Size);
+		LinuxFreeMemory(Kept, Size);
+	}
+	
+	return AllGood;
+}
+
+//
+// Scaling modes, what each costs against how close it gets to the picture it should show
+//
+
+#define SCALE_BENCH_PIXELS 4000000 // Destination pixels per mode and case
+
+struct scale_case
+{
+	const char *Name;
+	int CutWidth;
+	int CutHeight;
+	int DisplayWidth;
+	int DisplayHeight;
+};
+
+// @Note A zone plate from the corner, 0..1 in linear light. Its frequency is Rate * r cycles a texel at r texels out, kept under
+// what the crop's texels can hold, so anything that shrinks it has to filter it out or alias.
+inline float ZonePlate(float X, float Y, float Rate)
+{
+	// cos(Pi * Rate * r^2)
+	return 0.5f + 0.4f * SinPi(Rate * (X * X + Y * Y) + 0.5f);
+}
+
+// @Note The display as a perfect low-pass would draw it: the zone plate itself wherever the display's pixels
+// can hold its frequency, flat grey past their Nyquist where anything left over can only be aliasing
+internal void DrawScaleReference(bitmap *Reference, scale_case *Case, float Rate)
+{
+	float StepX = (float)Case->CutWidth  / (float)Case->DisplayWidth;
+	float StepY = (float)Case->CutHeight / (float)Case->DisplayHeight;
+	
+	for (int Y = 0; Y < Case->DisplayHeight; ++Y)
+	{
+		u32 *Row = (u32 *)(Reference->Memory + Y * Reference->Pitch);
+		for (int X = 0; X < Case->DisplayWidth; ++X)
+		{
+			float CropX = ((float)X + 0.5f) * StepX;
+			float CropY = ((float)Y + 0.5f) * StepY;
+			
+			// @Note Rate * X cycles a texel across and Rate * Y down, times the texels a pixel covers
+			bool Holds = (Rate * CropX * StepX < 0.5f) && (Rate * CropY * StepY < 0.5f);
+			
+			u32 Grey = (u32)EncodeSRGB(Holds ? ZonePlate(CropX, CropY, Rate) : 0.5f);
+			Row[X] = 0xFF000000 | (Grey << 16) | (Grey << 8) | Grey;
+		}
+	}
+}
+
+// @Note Over the colour channels, 99 dB if they are the same
+internal double GetPSNR(bitmap *A, bitmap *B, int Width, int Height)
+{
+	u64 SquaredSum = 0;
+	for (int Y = 0; Y < Height; ++Y)
+	{
+		u8 *RowA = A->Memory + Y * A->Pitch;
+		u8 *RowB = B->Memory + Y * B->Pitch;
+		for (int X = 0; X < Width * BITMAP_BYTES_PER_PIXEL; ++X)
+		{
+			if ((X & 3) != 3)
+			{
+				int Difference = RowA[X] - RowB[X];
+				SquaredSum += (u64)(Difference * Difference);
+			}
+		}
+	}
+	
+	if (SquaredSum == 0)
+	{
+		return 99.0;
+	}
+	
+	double MeanSquared = (double)SquaredSum / ((double)Width * Height * 3);
+	return 10.0 * 0.30103 * (double)Log2((float)(255.0 * 255.0 / MeanSquared));
+}
+
+internal int GetMaxDifference(bitmap *A, bitmap *B, int Width, int Height)
+{
+	int MaxDifference = 0;
+	for (int Y = 0; Y < Height; ++Y)
+	{
+		u8 *RowA = A->Memory + Y * A->Pitch;
+		u8 *RowB = B->Memory + Y * B->Pitch;
+		for (int X = 0; X < Width * BITMAP_BYTES_PER_PIXEL; ++X)
+		{
+			int Difference = (RowA[X] > RowB[X]) ? (RowA[X] - RowB[X]) : (RowB[X] - RowA[X]);
+			MaxDifference = Max(MaxDifference, Difference);
+		}
+	}
+	
+	return MaxDifference;
+}
+
+internal bool BenchmarkScale()
+{
+	scale_case Cases[] =
+	{
+		{ "1920x1080 -> 480x270",  1920, 1080, 480,  270  },
+		{ "1280x720 -> 400x300",   1280, 720,  400,  300  },
+		{ "800x600 -> 600x450",    800,  600,  600,  450  },
+		{ "400x300 1:1",           400,  300,  400,  300  },
+		{ "160x120 -> 480x360",    160,  120,  480,  360  },
+		{ "320x240 -> 480x360",    320,  240,  480,  360  },
+	};
+	
+	int MaxTexture = 2048;
+	int MaxTarget  = 1024;
+	size_t TextureSize = (size_t)MaxTexture * MaxTexture * BITMAP_BYTES_PER_PIXEL;
+	size_t TargetSize  = (size_t)MaxTarget  * MaxTarget  * BITMAP_BYTES_PER_PIXEL;
+	
+	bitmap Texture   = { (u8 *)LinuxAllocateMemory(TextureSize), MaxTexture, MaxTexture, MaxTexture * BITMAP_BYTES_PER_PIXEL };
+	bitmap Reference = { (u8 *)LinuxAllocateMemory(TargetSize),  MaxTarget,  MaxTarget,  MaxTarget  * BITMAP_BYTES_PER_PIXEL };
+	bitmap Target    = { (u8 *)LinuxAllocateMemory(TargetSize),  MaxTarget,  MaxTarget,  MaxTarget  * BITMAP_BYTES_PER_PIXEL };
+	bitmap Check     = { (u8 *)LinuxAllocateMemory(TargetSize),  MaxTarget,  MaxTarget,  MaxTarget  * BITMAP_BYTES_PER_PIXEL };
+	if (!Texture.Memory || !Reference.Memory || !Target.Memory || !Check.Memory)
+	{
+		Error("Scale benchmark memory");
+	}
+	
+	scaler Scaler;
+	InitializeScaler(&Scaler, LinuxAllocateMemory, LinuxFreeMemory);
+	
+	// @Note Straight copies so the PSNR is about the filter only
+	shade_params Shade = {};
+	Shade.Alpha  = 1.0f;
+	Shade.Darken = 0.0f;
+	Shade.Scale  = ScaleMode_Bilinear;
+	
+	shade_row_function *ShadeRow = GetShadeRow(GetBestShadeKernel());
+	
+	bool AllGood = true;
+	for (u32 CaseIndex = 0; CaseIndex < GetArrayCount(Cases); ++CaseIndex)
+	{
+		scale_case *Case = &Cases[CaseIndex];
+		box CropSlot = { 0, 0, Case->CutWidth, Case->CutHeight };
+		v2 DestinationMin = { 0.0f, 0.0f };
+		v2 DestinationMax = { (float)Case->DisplayWidth, (float)Case->DisplayHeight };
+		
+		// @Note The diagonal is at most the two sides, so the far corner stays under 0.4 cycles a texel
+		float Rate = 0.5f / (float)(Case->CutWidth + Case->CutHeight);
+		
+		for (int Y = 0; Y < Case->CutHeight; ++Y)
+		{
+			u32 *Row = (u32 *)(Texture.Memory + Y * Texture.Pitch);
+			for (int X = 0; X < Case->CutWidth; ++X)
+			{
+				u32 Grey = (u32)EncodeSRGB(ZonePlate((float)X + 0.5f, (float)Y + 0.5f, Rate));
+				Row[X] = 0xFF000000 | (Grey << 16) | (Grey << 8) | Grey;
+			}
+		}
+		
+		DrawScaleReference(&Reference, Case, Rate);
+		
+		u64 PixelCount = (u64)Case->DisplayWidth * Case->DisplayHeight;
+		int Repeats = (int)Max(SCALE_BENCH_PIXELS / PixelCount, (u64)1);
+		
+		double Quality[ScaleMode_Count];
+		u64 Times[ScaleMode_Count];
+		for (int Mode = 0; Mode < ScaleMode_Count; ++Mode)
+		{
+			shade_setup Setup;
+			SetupShadePiece(&Setup, &Target, DestinationMin, DestinationMax, &Texture, CropSlot, GetRotationUV(DisplayRotation_Identity), Shade);
+			
+			// @Note Every frame a whole new crop, so the mip chain rebuilds all of it. The weight tables stay cached.
+			u64 BuildCount = Scaler.TableBuildCount;
+			u64 StartTime = GetNanoseconds();
+			for (int Repeat = 0; Repeat < Repeats; ++Repeat)
+			{
+				MarkScaleDirty(&Scaler, CropSlot);
+				ShadeScaledPiece(&Scaler, (scale_mode)Mode, &Setup, &Target, ShadeRow);
+			}
+			u64 Elapsed = GetNanoseconds() - StartTime;
+			u64 Built = Scaler.TableBuildCount - BuildCount;
+			Times[Mode] = Elapsed;
+			
+			Quality[Mode] = GetPSNR(&Reference, &Target, Case->DisplayWidth, Case->DisplayHeight);
+			
+			// @Note Only the first frame of a new mapping builds its two tables
+			bool Cached = (Built <= 2);
+			AllGood &= Cached;
+			
+			printf("scale %-22s %-8s %9.2f ms a frame, %8.1f Mpixel/s, PSNR %5.2f dB%s\n", Case->Name, ScaleModeNames[Mode],
+				   (double)Elapsed / Repeats / 1000000.0, (double)PixelCount * Repeats * 1000.0 / (double)Elapsed, Quality[Mode],
+				   Cached ? "" : " TABLES REBUILT");
+		}
+		
+		// @Note Shrinking is what the other modes are for, every one of them has to beat bilinear at it
+		bool Shrinks = (Case->DisplayWidth * 3 <= Case->CutWidth * 2);
+		for (int Mode = ScaleMode_Mip; Shrinks && (Mode < ScaleMode_Count); ++Mode)
+		{
+			if (Quality[Mode] <= Quality[ScaleMode_Bilinear])
+			{
+				printf("scale %-22s %-8s NO BETTER THAN BILINEAR\n", Case->Name, ScaleModeNames[Mode]);
+				AllGood = false;
+			}
+		}
+		
+		// @Note At 1:1 on the pixel grid every mode lands on the texel centers and gives back the crop
+		if (Case->DisplayWidth == Case->CutWidth)
+		{
+			shade_setup Setup;
+			SetupShadePiece(&Setup, &Check, DestinationMin, DestinationMax, &Texture, CropSlot, GetRotationUV(DisplayRotation_Identity), Shade);
+			ShadeRect(&Setup, &Check, Setup.Rect, ShadeRowScalar);
+			for (int Mode = ScaleMode_Nearest; Mode < ScaleMode_Count; ++Mode)
+			{
+				ShadeScaledPiece(&Scaler, (scale_mode)Mode, &Setup, &Target, ShadeRow);
+				int MaxDifference = GetMaxDifference(&Check, &Target, Case->DisplayWidth, Case->DisplayHeight);
+				if (MaxDifference > 1)
+				{
+					printf("scale %-22s %-8s MISMATCH at 1:1, max diff %d\n", Case->Name, ScaleModeNames[Mode], MaxDifference);
+					AllGood = false;
+				}
+			}
+		}
+		
+		// @Note The whole ratio fast path against the per pixel nearest, the same texels wherever the ratio is exact in floats.
+		// It is a stride through the rows and a table lookup a channel, it has to beat bilinear's four texels.
+		shade_setup Setup;
+		SetupShadePiece(&Setup, &Target, DestinationMin, DestinationMax, &Texture, CropSlot, GetRotationUV(DisplayRotation_Identity), Shade);
+		PrepareScale(&Scaler, ScaleMode_Nearest, &Setup, 1);
+		if (Scaler.Pieces[0].IsWholeRatio)
+		{
+			ShadeScaledRect(&Scaler, 0, &Target, Setup.Rect);
+			Scaler.Pieces[0].IsWholeRatio = false;
+			ShadeScaledRect(&Scaler, 0, &Check, Setup.Rect);
+			
+			int MaxDifference = GetMaxDifference(&Check, &Target, Case->DisplayWidth, Case->DisplayHeight);
+			bool Faster = (Times[ScaleMode_Nearest] < Times[ScaleMode_Bilinear]);
+			printf("scale %-22s nearest whole ratio fast path, max diff %d against per pixel, %.2fx bilinear%s%s\n", Case->Name, MaxDifference,
+				   (double)Times[ScaleMode_Bilinear] / (double)Times[ScaleMode_Nearest], MaxDifference ? " MISMATCH" : "",
+				   Faster ? "" : " SLOWER THAN BILINEAR");
+			AllGood &= (MaxDifference == 0) && Faster;
+		}
+	}
+	
+	FreeScaler(&Scaler);
+	LinuxFreeMemory(Texture.Memory, TextureSize);
+	LinuxFreeMemory(Reference.Memory, TargetSize);
+	LinuxFreeMemory(Target.Memory, TargetSize);
+	LinuxFreeMemory(Check.Memory, TargetSize);
+	
+	return AllGood;
+}
+
+//
+// Colour: the tables against the curves they come from, FP16 both ways, and every convert kernel against the scalar one
+//
+
+#define COLOUR_BENCH_WIDTH  1917 // Not a multiple of any kernel's width, so the tails get checked
+#define COLOUR_BENCH_HEIGHT 64
+#define COLOUR_BENCH_PIXELS 50000000
+
+// @Note Mostly what a desktop has, up to 1000 nits, and every so often any half at all: negatives, denormals, inf and NaN
+internal u16 RandomScRGBHalf(u32 *Series)
+{
+	u32 Random = NextRandom(Series);
+	if ((Random & 7) == 0)
+	{
+		return (u16)(Random >> 16);
+	}
+	
+	return FloatToHalf((float)(Random >> 8) * (12.5f / 16777216.0f));
+}
+
+internal int GetMaxByteDifference(u8 *A, u8 *B, size_t Size)
+{
+	int MaxDifference = 0;
+	for (size_t Index = 0; Index < Size; ++Index)
+	{
+		int Difference = (A[Index] > B[Index]) ? (A[Index] - B[Index]) : (B[Index] - A[Index]);
+		MaxDifference = Max(MaxDifference, Difference);
+	}
+	
+	return MaxDifference;
+}
+
+// @Note Every 8-bit grey out to Format at WhiteNits and back through the crop's conversion. Up to the knee it has to come
+// back as it went out, within a code for PQ's 10 bits, and past it the tone map can only pull it down, never reorder it.
+internal bool CheckColourRoundTrip(surface_format Format, float WhiteNits, convert_row_function *Expand, convert_row_function *Convert)
+{
+	u32 Greys[256];
+	u8 Encoded[256 * 8];
+	u32 Back[256];
+	for (u32 Code = 0; Code < 256; ++Code)
+	{
+		Greys[Code] = 0xFF000000 | (Code << 16) | (Code << 8) | Code;
+	}
+	
+	colour_convert ExpandScale  = GetColourExpand(Format, WhiteNits);
+	colour_convert ConvertScale = GetColourConvert(Format, WhiteNits);
+	Expand(&ExpandScale, (u8 *)Greys, Encoded, 0, 256);
+	Convert(&ConvertScale, Encoded, (u8 *)Back, 0, 256);
+	
+	int Tolerance = (Format == SurfaceFormat_RGB10A2) ? 1 : 0;
+	int KneeCode = (int)EncodeSRGB(TONE_MAP_KNEE);
+	int MaxDifference = 0;
+	bool Monotonic = true;
+	for (int Code = 0; Code < 256; ++Code)
+	{
+		int Red   = (Back[Code] >> 16) & 0xFF;
+		int Green = (Back[Code] >> 8) & 0xFF;
+		int Blue  = Back[Code] & 0xFF;
+		Monotonic &= (Red == Green) && (Green == Blue);
+		if (Code > 0)
+		{
+			Monotonic &= (Red >= (int)((Back[Code - 1] >> 16) & 0xFF));
+		}
+		
+		if (Code < KneeCode)
+		{
+			MaxDifference = Max(MaxDifference, (Red > Code) ? (Red - Code) : (Code - Red));
+		}
+		else
+		{
+			Monotonic &= (Red <= Code);
+		}
+	}
+	
+	bool Good = Monotonic && (MaxDifference <= Tolerance);
+	printf("colour %-8s %4.0f nits white, round trip max diff %d below code %d, %s past it%s\n", (Format == SurfaceFormat_RGBA16F) ? "scRGB" : "PQ",
+		   WhiteNits, MaxDifference, KneeCode, Monotonic ? "monotonic" : "OUT OF ORDER", Good ? "" : " MISMATCH");
+	
+	return Good;
+}
+
+internal bool BenchmarkColour()
+{
+	InitializeColourTables();
+	bool AllGood = true;
+	
+	// @Note The tables against the curves
+	int CodeMisses = 0;
+	for (int Code = 0; Code < 256; ++Code)
+	{
+		CodeMisses += ((int)EncodeSRGB(ColourTables.SRGBDecode[Code]) != Code);
+	}
+	
+	float MaxCodeError = 0.0f;
+	for (int Step = 0; Step <= 65536; ++Step)
+	{
+		float Linear = (float)Step / 65536.0f;
+		MaxCodeError = Max(MaxCodeError, AbsF(EncodeSRGB(Linear) - LinearToSRGB(Linear) * 255.0f));
+	}
+	
+	bool TablesGood = (CodeMisses == 0) && (MaxCodeError <= 1.0f);
+	AllGood &= TablesGood;
+	printf("colour sRGB tables, %d of 256 codes don't make it back, encode at most %.3f codes off the curve%s\n", CodeMisses,
+		   (double)MaxCodeError, TablesGood ? "" : " MISMATCH");
+	
+	// @Note Every half that isn't a NaN makes it back, NaNs come back as the one quiet NaN
+	int HalfMisses = 0;
+	int HalfSSE2Misses = 0;
+	for (u32 Half = 0; Half < 65536; ++Half)
+	{
+		bool IsNaN = ((Half & 0x7FFF) > 0x7C00);
+		float Value = HalfToFloat((u16)Half);
+		HalfMisses += !IsNaN && (FloatToHalf(Value) != Half);
+
+#if defined(SHADE_X86)
+		__m128 Wide = HalfToFloatSSE2(_mm_set1_epi32((int)Half));
+		u16 Narrow = (u16)_mm_cvtsi128_si32(FloatToHalfSSE2(Wide));
+		HalfSSE2Misses += (FloatToBits(_mm_cvtss_f32(Wide)) != FloatToBits(Value)) || (Narrow != FloatToHalf(Value));
+#endif
+	}
+	
+	// @Note And the rounding of floats that aren't halves, all the way through the denormals
+	u32 Series = 0x2468ACE1;
+	for (int Sample = 0; Sample < 1000000; ++Sample)
+	{
+		float Value = BitsToFloat(NextRandom(&Series) & 0xC7FFFFFF);
+#if defined(SHADE_X86)
+		HalfSSE2Misses += ((u16)_mm_cvtsi128_si32(FloatToHalfSSE2(_mm_set1_ps(Value))) != FloatToHalf(Value));
+#endif
+		HalfMisses += (FloatToHalf(Value) != FloatToHalf(HalfToFloat(FloatToHalf(Value))));
+	}
+	
+	bool HalvesGood = (HalfMisses == 0) && (HalfSSE2Misses == 0);
+	AllGood &= HalvesGood;
+	printf("colour FP16 round trips, %d missed, %d SSE2 conversions off the scalar ones%s\n", HalfMisses, HalfSSE2Misses,
+		   HalvesGood ? "" : " MISMATCH");
+	
+	// @Note Rows of each source format through every kernel, against the scalar row
+	size_t SourcePitch = (size_t)COLOUR_BENCH_WIDTH * 8;
+	size_t DestPitch   = (size_t)COLOUR_BENCH_WIDTH * 8;
+	size_t BlockSize   = SourcePitch * COLOUR_BENCH_HEIGHT;
+	u8 *Source    = (u8 *)LinuxAllocateMemory(BlockSize);
+	u8 *Reference = (u8 *)LinuxAllocateMemory(BlockSize);
+	u8 *Target    = (u8 *)LinuxAllocateMemory(BlockSize);
+	if (!Source || !Reference || !Target)
+	{
+		Error("Colour benchmark memory");
+	}
+	
+	const char *RowNames[] = { "scRGB", "PQ", "expand" };
+	for (int RowIndex = 0; RowIndex < 3; ++RowIndex)
+	{
+		surface_format Format = (RowIndex == 1) ? SurfaceFormat_RGB10A2 : SurfaceFormat_RGBA16F;
+		bool IsExpand = (RowIndex == 2);
+		size_t RowSize = (size_t)COLOUR_BENCH_WIDTH * ((RowIndex == 0) ? 8 : 4);
+		size_t OutSize = (size_t)COLOUR_BENCH_WIDTH * (IsExpand ? 8 : 4);
+		
+		for (int Y = 0; Y < COLOUR_BENCH_HEIGHT; ++Y)
+		{
+			u8 *Row = Source + Y * SourcePitch;
+			for (size_t Byte = 0; Byte < RowSize; Byte += 2)
+			{
+				u16 Value = (RowIndex == 0) ? RandomScRGBHalf(&Series) : (u16)NextRandom(&Series);
+				*(u16 *)(Row + Byte) = Value;
+			}
+		}
+		
+		// @Note A brighter white than the default so the tone map and the expand both do something
+		colour_convert Convert = IsExpand ? GetColourExpand(Format, 240.0f) : GetColourConvert(Format, 240.0f);
+		
+		u64 ScalarElapsed = 0;
+		for (int Kernel = 0; Kernel < ShadeKernel_Count; ++Kernel)
+		{
+			convert_row_function *ConvertRow = IsExpand ? GetExpandRow((shade_kernel)Kernel) : GetConvertRow(Format, (shade_kernel)Kernel);
+			if (!ConvertRow)
+			{
+				continue;
+			}
+			
+			u8 *Output = (Kernel == ShadeKernel_Scalar) ? Reference : Target;
+			int Repeats = COLOUR_BENCH_PIXELS / (COLOUR_BENCH_WIDTH * COLOUR_BENCH_HEIGHT);
+			u64 StartTime = GetNanoseconds();
+			for (int Repeat = 0; Repeat < Repeats; ++Repeat)
+			{
+				for (int Y = 0; Y < COLOUR_BENCH_HEIGHT; ++Y)
+				{
+					ConvertRow(&Convert, Source + Y * SourcePitch, Output + Y * DestPitch, 0, COLOUR_BENCH_WIDTH);
+				}
+			}
+			u64 Elapsed = GetNanoseconds() - StartTime;
+			if (Kernel == ShadeKernel_Scalar)
+			{
+				ScalarElapsed = Elapsed;
+			}
+			
+			int MaxDifference = 0;
+			for (int Y = 0; Y < COLOUR_BENCH_HEIGHT; ++Y)
+			{
+				MaxDifference = Max(MaxDifference, GetMaxByteDifference(Reference + Y * DestPitch, Output + Y * DestPitch, OutSize));
+			}
+			
+			// @Note Bit exact on x86, one off allowed for the fused multiply-adds on ARM. The expand's halves have to be exact.
+			bool Matches = IsExpand ? (MaxDifference == 0) : (MaxDifference <= 1);
+			AllGood &= Matches;
+			
+			printf("colour %-8s %-6s %8.1f Mpixel/s, %6.2fx scalar, max diff %d%s\n", RowNames[RowIndex], ShadeKernelNames[Kernel],
+				   (double)COLOUR_BENCH_WIDTH * COLOUR_BENCH_HEIGHT * Repeats * 1000.0 / (double)Elapsed, (double)ScalarElapsed / (double)Elapsed,
+				   MaxDifference, Matches ? "" : " MISMATCH");
+		}
+	}
+	
+	LinuxFreeMemory(Source, BlockSize);
+	LinuxFreeMemory(Reference, BlockSize);
+	LinuxFreeMemory(Target, BlockSize);
+	
+	// @Note The way the synthetic source puts SDR on an HDR desktop and the crop takes it back off
+	float WhiteLevels[] = { 80.0f, 203.0f, 480.0f };
+	for (u32 WhiteIndex = 0; WhiteIndex < GetArrayCount(WhiteLevels); ++WhiteIndex)
+	{
+		AllGood &= CheckColourRoundTrip(SurfaceFormat_RGBA16F, WhiteLevels[WhiteIndex], ExpandSRGBRowScalar, ConvertScRGBRowScalar);
+		AllGood &= CheckColourRoundTrip(SurfaceFormat_RGB10A2, WhiteLevels[WhiteIndex], EncodePQRowScalar, ConvertPQRowScalar);
+	}
+	
+	return AllGood;
+}
+
+//
+// Ring: a capture thread writing a capture ring as fast as it can against the render side taking from it,
+// then the serial loop against the pipelined one on a simulated source
+//
+
+#define RING_BENCH_FRAMES 20000
+#define RING_BENCH_WIDTH  64
+#define RING_BENCH_HEIGHT 48
+
+// @Note A 240Hz desktop playing a video, the render side's shade and present are GPU time the CPU only waits on
+#define RING_SOURCE_PERIOD 4166667
+#define RING_RENDER_TIME   6000000
+#define RING_RUN_TIME      1000000000
+
+internal void SleepUntil(u64 Nanoseconds)
+{
+	timespec Time;
+	Time.tv_sec  = (time_t)(Nanoseconds / 1000000000);
+	Time.tv_nsec = (long)(Nanoseconds % 1000000000);
+	while (clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &Time, NULL) != 0)
+	{
+	}
+}
+
+internal void CopyBitmapBox(bitmap *Dest, bitmap *Source, box Box)
+{
+	for (int Y = Box.Top; Y < Box.Bottom; ++Y)
+	{
+		memcpy(Dest->Memory + (size_t)Y * Dest->Pitch + Box.Left * BITMAP_BYTES_PER_PIXEL,
+			   Source->Memory + (size_t)Y * Source->Pitch + Box.Left * BITMAP_BYTES_PER_PIXEL, (size_t)GetBoxWidth(Box) * BITMAP_BYTES_PER_PIXEL);
+	}
+}
+
+inline u64 HashBitmap(bitmap *Bitmap)
+{
+	return HashBytes(Bitmap->Memory, (size_t)Bitmap->Pitch * Bitmap->Height);
+}
+
+struct ring_stress
+{
+	capture_ring *Ring;
+	bitmap *Source;
+	
+	// @Note By sequence, written before the frame is handed over so the render side can check what it got
+	u64 *SourceHashes;
+	
+	u32 WrongResults;
+	u32 volatile IsDone;
+};
+
+internal void *RingStressWriter(void *Parameter)
+{
+	ring_stress *Stress = (ring_stress *)Parameter;
+	bitmap *Source = Stress->Source;
+	
+	box DirtyRects[3];
+	captured_frame Frame = {};
+	Frame.Surface         = Source;
+	Frame.Format          = SurfaceFormat_BGRA8;
+	Frame.Rotation        = DisplayRotation_Identity;
+	Frame.DesktopWidth    = Source->Width;
+	Frame.DesktopHeight   = Source->Height;
+	Frame.MetadataIsValid = true;
+	Frame.DirtyRects      = DirtyRects;
+	
+	u32 Series = 0x87654321;
+	for (u32 FrameIndex = 0; FrameIndex < RING_BENCH_FRAMES; ++FrameIndex)
+	{
+		// @Note Every so often the source starts over, or only the mouse moved
+		Frame.SourceWasReset = (FrameIndex == 0) || ((NextRandom(&Series) % 512) == 0);
+		bool MouseOnly = !Frame.SourceWasReset && ((NextRandom(&Series) % 16) == 0);
+		
+		Frame.LastPresentTime = MouseOnly ? 0 : FrameIndex + 1;
+		Frame.DirtyRectCount  = MouseOnly ? 0 : (u32)RandomBetween(&Series, 1, GetArrayCount(DirtyRects));
+		for (u32 DirtyIndex = 0; DirtyIndex < Frame.DirtyRectCount; ++DirtyIndex)
+		{
+			box Dirty;
+			Dirty.Left = RandomBetween(&Series, 0, Source->Width - 1);
+			Dirty.Top = RandomBetween(&Series, 0, Source->Height - 1);
+			Dirty.Right = RandomBetween(&Series, Dirty.Left + 1, Source->Width);
+			Dirty.Bottom = RandomBetween(&Series, Dirty.Top + 1, Source->Height);
+			DirtyRects[DirtyIndex] = Dirty;
+			
+			u32 Colour = NextRandom(&Series);
+			for (int Y = Dirty.Top; Y < Dirty.Bottom; ++Y)
+			{
+				u32 *Row = (u32 *)(Source->Memory + (size_t)Y * Source->Pitch);
+				for (int X = Dirty.Left; X < Dirty.Right; ++X)
+				{
+					Row[X] = Colour++;
+				}
+			}
+		}
+		
+		if (!MouseOnly)
+		{
+			Stress->SourceHashes[Stress->Ring->Sequence + 1] = HashBitmap(Source);
+		}
+		
+		if (WriteCaptureRing(Stress->Ring, &Frame) == MouseOnly)
+		{
+			++Stress->WrongResults;
+		}
+	}
+	
+	AtomicStoreU32(&Stress->IsDone, 1);
+	return NULL;
+}
+
+internal bool StressCaptureRing(software_ring_copier *Copier)
+{
+	memory_arena Arena;
+	size_t MemorySize = Megabytes(1);
+	InitializeArena(&Arena, LinuxAllocateMemory(MemorySize), MemorySize);
+	
+	ring_stress *Stress = PushStruct(&Arena, ring_stress);
+	Stress->Ring   = PushStruct(&Arena, capture_ring);
+	Stress->Source = PushStruct(&Arena, bitmap);
+	Stress->SourceHashes = PushArray(&Arena, RING_BENCH_FRAMES + 1, u64);
+	Stress->WrongResults = 0;
+	Stress->IsDone = 0;
+	*Stress->Source = PushBitmap(&Arena, RING_BENCH_WIDTH, RING_BENCH_HEIGHT);
+	InitializeCaptureRing(Stress->Ring, SoftwareRingCopy, Copier);
+	
+	// @Note What the render side builds from the changes it is handed, the display texture in the real thing
+	bitmap Mirror = PushBitmap(&Arena, RING_BENCH_WIDTH, RING_BENCH_HEIGHT);
+	
+	u64 StartTime = GetNanoseconds();
+	pthread_t Thread;
+	if (pthread_create(&Thread, NULL, RingStressWriter, Stress) != 0)
+	{
+		Error("pthread_create");
+	}
+	
+	capture_ring *Ring = Stress->Ring;
+	u32 LastSequence = 0;
+	u32 TakenCount = 0;
+	u32 WrongCopies = 0;
+	u32 WrongChanges = 0;
+	u32 Backwards = 0;
+	for (;;)
+	{
+		// @Note Done before the take, so the last copy still gets taken
+		bool WriterIsDone = (AtomicLoadU32(&Stress->IsDone) != 0);
+		
+		captured_frame Frame;
+		if (TakeCaptureRing(Ring, &Frame))
+		{
+			u32 Sequence = Ring->Slots[Ring->Exchange.ReadIndex].Sequence;
+			Backwards += (Sequence <= LastSequence);
+			LastSequence = Sequence;
+			
+			bitmap *Copy = (bitmap *)Frame.Surface;
+			u64 Hash = HashBitmap(Copy);
+			WrongCopies += (Hash != Stress->SourceHashes[Sequence]);
+			
+			if (Frame.SourceWasReset)
+			{
+				CopyBitmapBox(&Mirror, Copy, GetSurfaceBounds(&Frame));
+			}
+			else
+			{
+				for (u32 DirtyIndex = 0; DirtyIndex < Frame.DirtyRectCount; ++DirtyIndex)
+				{
+					CopyBitmapBox(&Mirror, Copy, Frame.DirtyRects[DirtyIndex]);
+				}
+			}
+			WrongChanges += (HashBitmap(&Mirror) != Hash);
+			
+			++TakenCount;
+		}
+		else if (WriterIsDone)
+		{
+			break;
+		}
+		else
+		{
+			sched_yield();
+		}
+	}
+	
+	pthread_join(Thread, NULL);
+	double Time = (double)(GetNanoseconds() - StartTime) / 1000000.0;
+	
+	// @Note Every copy handed over is either taken or replaced before it was
+	bool AllAccounted = (TakenCount + Ring->DroppedCount == Ring->WrittenCount) && (LastSequence == Ring->Sequence);
+	bool AllGood = AllAccounted && (WrongCopies == 0) && (WrongChanges == 0) && (Backwards == 0) && (Stress->WrongResults == 0);
+	
+	printf("ring stress %u frames in %.1fms, %llu copies written, %u taken, %llu dropped, %u wrong copies, %u wrong changes, %u backwards, %s\n",
+		   RING_BENCH_FRAMES, Time, (unsigned long long)Ring->WrittenCount, TakenCount, (unsigned long long)Ring->DroppedCount, WrongCopies,
+		   WrongChanges, Backwards, AllGood ? "ok" : "BROKEN");
+	
+	LinuxFreeMemory(Arena.Base, MemorySize);
+	return AllGood;
+}
+
+// @Note Frames come every period whether anyone takes them or not, the ones nobody acquired in time
+// are folded into the next one like DXGI does. The video box changes every frame.
+struct ring_source
+{
+	bitmap Desktop;
+	box Video;
+	u64 StartTime;
+	u64 LastTick;
+};
+
+internal void AcquireRingSourceFrame(ring_source *Source, captured_frame *Frame)
+{
+	u64 Tick = (GetNanoseconds() - Source->StartTime) / RING_SOURCE_PERIOD;
+	if (Tick <= Source->LastTick)
+	{
+		Tick = Source->LastTick + 1;
+		SleepUntil(Source->StartTime + Tick * RING_SOURCE_PERIOD);
+	}
+	Source->LastTick = Tick;
+	
+	for (int Y = Source->Video.Top; Y < Source->Video.Bottom; ++Y)
+	{
+		u32 *Row = (u32 *)(Source->Desktop.Memory + (size_t)Y * Source->Desktop.Pitch);
+		for (int X = Source->Video.Left; X < Source->Video.Right; ++X)
+		{
+			Row[X] = (u32)Tick * 2654435761u + (u32)X;
+		}
+	}
+	
+	*Frame = {};
+	Frame->Surface         = &Source->Desktop;
+	Frame->Format          = SurfaceFormat_BGRA8;
+	Frame->Rotation        = DisplayRotation_Identity;
+	Frame->DesktopWidth    = Source->Desktop.Width;
+	Frame->DesktopHeight   = Source->Desktop.Height;
+	Frame->SourceWasReset  = (Tick == 0);
+	Frame->LastPresentTime = (s64)(Source->StartTime + Tick * RING_SOURCE_PERIOD);
+	Frame->MetadataIsValid = true;
+	Frame->DirtyRectCount  = 1;
+	Frame->DirtyRects      = &Source->Video;
+}
+
+struct ring_pipeline
+{
+	ring_source *Source;
+	capture_ring *Ring;
+	void *FrameEvent;
+	u32 volatile Stop;
+};
+
+internal void *RingCaptureThread(void *Parameter)
+{
+	ring_pipeline *Pipeline = (ring_pipeline *)Parameter;
+	while (!AtomicLoadU32(&Pipeline->Stop))
+	{
+		captured_frame Frame;
+		AcquireRingSourceFrame(Pipeline->Source, &Frame);
+		if (WriteCaptureRing(Pipeline->Ring, &Frame))
+		{
+			LinuxSignalEvent(Pipeline->FrameEvent);
+		}
+	}
+	
+	return NULL;
+}
+
+struct ring_run
+{
+	u32 PresentCount;
+	u64 TotalLatency;
+	u64 MaxLatency;
+};
+
+inline void PresentRingFrame(ring_run *Run, captured_frame *Frame)
+{
+	SleepUntil(GetNanoseconds() + RING_RENDER_TIME);
+	
+	u64 Latency = GetNanoseconds() - (u64)Frame->LastPresentTime;
+	Run->TotalLatency += Latency;
+	Run->MaxLatency = Max(Run->MaxLatency, Latency);
+	++Run->PresentCount;
+}
+
+internal void PrintRingRun(const char *Name, ring_run *Run, u64 AcquiredCount)
+{
+	double Seconds = (double)RING_RUN_TIME / 1000000000.0;
+	printf("ring %-9s %6.1f presents/s, %6.1f frames/s acquired, latency %.2fms mean %.2fms max\n", Name, Run->PresentCount / Seconds,
+		   AcquiredCount / Seconds, (double)Run->TotalLatency / Max(Run->PresentCount, 1u) / 1000000.0, (double)Run->MaxLatency / 1000000.0);
+}
+
+internal bool BenchmarkRing()
+{
+	software_ring_copier Copier = { LinuxAllocateMemory, LinuxFreeMemory };
+	bool AllGood = StressCaptureRing(&Copier);
+	
+	memory_arena Arena;
+	size_t MemorySize = Megabytes(1) + (size_t)1920 * 1080 * BITMAP_BYTES_PER_PIXEL;
+	InitializeArena(&Arena, LinuxAllocateMemory(MemorySize), MemorySize);
+	
+	ring_source *Source = PushStruct(&Arena, ring_source);
+	Source->Desktop = PushBitmap(&Arena, 1920, 1080);
+	Source->Video   = box{ 320, 180, 960, 540 };
+	memset(Source->Desktop.Memory, 0x80, (size_t)Source->Desktop.Pitch * Source->Desktop.Height);
+	
+	printf("ring source %.0fHz, %dx%d changing, render and present %.1fms\n", 1000000000.0 / RING_SOURCE_PERIOD, GetBoxWidth(Source->Video),
+		   GetBoxHeight(Source->Video), RING_RENDER_TIME / 1000000.0);
+	
+	//
+	// Serial: acquire, copy, release, render, present, and only then the next acquire
+	//
+	
+	ring_run Serial = {};
+	void *SerialCopy = NULL;
+	
+	Source->StartTime = GetNanoseconds();
+	Source->LastTick  = (u64)-1;
+	u64 SerialAcquired = 0;
+	while (GetNanoseconds() - Source->StartTime < RING_RUN_TIME)
+	{
+		captured_frame Frame;
+		AcquireRingSourceFrame(Source, &Frame);
+		++SerialAcquired;
+		
+		// @Note The first copy is made whole, that covers the reset
+		SoftwareRingCopy(&Copier, &Frame, &SerialCopy, Frame.DirtyRects, Frame.DirtyRectCount);
+		PresentRingFrame(&Serial, &Frame);
+	}
+	
+	//
+	// Pipelined: the capture thread copies into the ring and acquires again, the render side takes the newest
+	//
+	
+	ring_pipeline *Pipeline = PushStruct(&Arena, ring_pipeline);
+	Pipeline->Source     = Source;
+	Pipeline->Ring       = PushStruct(&Arena, capture_ring);
+	Pipeline->FrameEvent = LinuxCreateEvent();
+	Pipeline->Stop       = 0;
+	InitializeCaptureRing(Pipeline->Ring, SoftwareRingCopy, &Copier);
+	
+	Source->StartTime = GetNanoseconds();
+	Source->LastTick  = (u64)-1;
+	
+	pthread_t Thread;
+	if (pthread_create(&Thread, NULL, RingCaptureThread, Pipeline) != 0)
+	{
+		Error("pthread_create");
+	}
+	
+	ring_run Pipelined = {};
+	while (GetNanoseconds() - Source->StartTime < RING_RUN_TIME)
+	{
+		captured_frame Frame;
+		if (TakeCaptureRing(Pipeline->Ring, &Frame))
+		{
+			PresentRingFrame(&Pipelined, &Frame);
+		}
+		else
+		{
+			LinuxWaitEvent(Pipeline->FrameEvent, WAIT_SLICE_MS);
+		}
+	}
+	
+	AtomicStoreU32(&Pipeline->Stop, 1);
+	pthread_join(Thread, NULL);
+	
+	PrintRingRun("serial", &Serial, SerialAcquired);
+	PrintRingRun("pipelined", &Pipelined, Pipeline->Ring->WrittenCount);
+	printf("ring pipelined %llu dropped, %.1fKB copied per frame, %.2fx the presents\n", (unsigned long long)Pipeline->Ring->DroppedCount,
+		   GetKilobytes(Pipeline->Ring->CopiedBytes) / Max(Pipeline->Ring->WrittenCount, 1ull),
+		   (double)Pipelined.PresentCount / Max(Serial.PresentCount, 1u));
+	
+	// @Note The copies and the event stay around, the process is about to end anyway
+	AllGood &= (Pipelined.PresentCount > Serial.PresentCount);
+	return AllGood;
+}
+
+//
+// Device: the D3D11 compositor's resource graph on a mock device that gets lost, again and again and
+// in the middle of rebuilds too, checking the order everything is released and made in
+//
+
+#define DEVICE_BENCH_LOSSES   10000
+#define DEVICE_BENCH_ATTEMPTS 100   // Rebuilds tried after a loss before giving up on it
+#define DEVICE_BENCH_FAULTS   24    // One create in this many loses the device
+
+enum mock_resource
+{
+	MockResource_Device,
+	MockResource_Shaders,
+	MockResource_ConvertShaders,
+	MockResource_ConstantBuffers,
+	MockResource_Samplers,
+	MockResource_SampledView,
+	MockResource_SwapChain,
+	MockResource_BackBufferView,
+	MockResource_Composition,
+	MockResource_DisplayTexture,
+	MockResource_Bindings,
+	MockResource_GpuTimers,
+	
+	MockResource_Count,
+};
+
+struct mock_device
+{
+	device_registry *Registry;
+	
+	// @Note Bumped every time the device is made, every resource remembers the one it was made on
+	u32 Generation;
+	bool IsLost;
+	bool InjectFaults;
+	u32 Series;
+	
+	u32 MadeOn[MockResource_Count]; // Zero when not live
+	u32 LiveCount;
+	
+	u32 OutOfOrder;   // Made before what it depends on, or released after something made from it
+	u32 StaleParents; // Made from something that belongs to an older device
+	u32 CreateCount;
+};
+
+internal DEVICE_RESOURCE_CREATE(MockCreate)
+{
+	mock_device *Mock = (mock_device *)Context;
+	u32 ResourceIndex = (u32)(Resource - Mock->Registry->Resources);
+	
+	++Mock->CreateCount;
+	if (ResourceIndex == MockResource_Device)
+	{
+		// @Note The driver can still be coming back, then there is no device to be had
+		if (Mock->InjectFaults && ((NextRandom(&Mock->Series) % DEVICE_BENCH_FAULTS) == 0))
+		{
+			return false;
+		}
+		
+		++Mock->Generation;
+		Mock->IsLost = false;
+	}
+	else if (Mock->IsLost)
+	{
+		return false;
+	}
+	else if (Mock->InjectFaults && ((NextRandom(&Mock->Series) % DEVICE_BENCH_FAULTS) == 0))
+	{
+		// @Note Lost again half way through
+		Mock->IsLost = true;
+		return false;
+	}
+	
+	for (u32 DependencyIndex = 0; DependencyIndex < MockResource_Count; ++DependencyIndex)
+	{
+		if (Resource->DependsOn & GetDeviceResourceBit(DependencyIndex))
+		{
+			Mock->OutOfOrder   += (Mock->MadeOn[DependencyIndex] == 0);
+			Mock->StaleParents += (Mock->MadeOn[DependencyIndex] != 0) && (Mock->MadeOn[DependencyIndex] != Mock->Generation);
+		}
+	}
+	
+	Mock->OutOfOrder += (Mock->MadeOn[ResourceIndex] != 0);
+	Mock->MadeOn[ResourceIndex] = Mock->Generation;
+	++Mock->LiveCount;
+	
+	return true;
+}
+
+internal DEVICE_RESOURCE_RELEASE(MockRelease)
+{
+	mock_device *Mock = (mock_device *)Context;
+	device_registry *Registry = Mock->Registry;
+	u32 ResourceIndex = (u32)(Resource - Registry->Resources);
+	
+	for (u32 DependentIndex = 0; DependentIndex < Registry->ResourceCount; ++DependentIndex)
+	{
+		bool IsDependent = (Registry->Resources[DependentIndex].DependsOn & GetDeviceResourceBit(ResourceIndex)) != 0;
+		Mock->OutOfOrder += IsDependent && (Mock->MadeOn[DependentIndex] != 0);
+	}
+	
+	Mock->OutOfOrder += (Mock->MadeOn[ResourceIndex] == 0);
+	Mock->MadeOn[ResourceIndex] = 0;
+	--Mock->LiveCount;
+}
+
+internal bool BenchmarkDevice()
+{
+	device_registry *Registry = (device_registry *)LinuxAllocateMemory(sizeof(device_registry));
+	mock_device *Mock = (mock_device *)LinuxAllocateMemory(sizeof(mock_device));
+	if (!Registry || !Mock)
+	{
+		Error("Device benchmark memory");
+	}
+	
+	*Mock = {};
+	Mock->Registry = Registry;
+	Mock->Series   = 0x12345678;
+	InitializeDeviceRegistry(Registry, Mock, GetNanoseconds);
+	
+	// @Note Same graph as the D3D11 compositor registers, see InitializeD3D11Compositor
+	u32 Device    = GetDeviceResourceBit(MockResource_Device);
+	u32 SwapChain = GetDeviceResourceBit(MockResource_SwapChain);
+	u32 Bindings  = GetDeviceResourceBit(MockResource_Shaders) | GetDeviceResourceBit(MockResource_ConstantBuffers) |
+		GetDeviceResourceBit(MockResource_DisplayTexture);
+	
+	AddDeviceResource(Registry, "Device",          MockCreate, MockRelease, NULL, 0);
+	AddDeviceResource(Registry, "Shaders",         MockCreate, MockRelease, NULL, Device);
+	AddDeviceResource(Registry, "ConvertShaders",  MockCreate, MockRelease, NULL, Device);
+	AddDeviceResource(Registry, "ConstantBuffers", MockCreate, MockRelease, NULL, Device);
+	AddDeviceResource(Registry, "Samplers",        MockCreate, MockRelease, NULL, Device);
+	AddDeviceResource(Registry, "SampledView",     MockCreate, MockRelease, NULL, Device);
+	AddDeviceResource(Registry, "SwapChain",       MockCreate, MockRelease, NULL, Device);
+	AddDeviceResource(Registry, "BackBufferView",  MockCreate, MockRelease, NULL, SwapChain);
+	AddDeviceResource(Registry, "Composition",     MockCreate, MockRelease, NULL, Device | SwapChain);
+	AddDeviceResource(Registry, "DisplayTexture",  MockCreate, MockRelease, NULL, Device);
+	AddDeviceResource(Registry, "Bindings",        MockCreate, MockRelease, NULL, Bindings);
+	
+	bool AllGood = BuildDeviceResources(Registry);
+	
+	// @Note Timers come later, when latency reporting is turned on, and are built on their own
+	AddDeviceResource(Registry, "GpuTimers", MockCreate, MockRelease, NULL, Device);
+	AllGood &= BuildDeviceResources(Registry);
+	
+	Mock->InjectFaults = true;
+	u32 GaveUp = 0;
+	u32 MaxAttempts = 0;
+	for (u32 LossIndex = 0; LossIndex < DEVICE_BENCH_LOSSES; ++LossIndex)
+	{
+		Mock->IsLost = true;
+		u32 Generation = Registry->Generation;
+		
+		u32 Attempts = 1;
+		while (!RebuildDeviceResources(Registry))
+		{
+			// @Note A failed rebuild leaves nothing behind
+			AllGood &= (Mock->LiveCount == 0);
+			if (++Attempts > DEVICE_BENCH_ATTEMPTS)
+			{
+				++GaveUp;
+				break;
+			}
+		}
+		MaxAttempts = Max(MaxAttempts, Attempts);
+		
+		// @Note Every resource made again, all of them on the newest device
+		bool AllCurrent = DeviceResourcesAreLive(Registry) && (Mock->LiveCount == MockResource_Count) &&
+			(Registry->Generation == Generation + 1);
+		for (u32 ResourceIndex = 0; ResourceIndex < MockResource_Count; ++ResourceIndex)
+		{
+			AllCurrent &= (Mock->MadeOn[ResourceIndex] == Mock->Generation);
+		}
+		AllGood &= AllCurrent;
+	}
+	
+	ReleaseDeviceResources(Registry);
+	AllGood &= (Mock->LiveCount == 0) && (Mock->OutOfOrder == 0) && (Mock->StaleParents == 0) && (GaveUp == 0);
+	
+	double MeanRecovery = (double)Registry->TotalRecoveryTime / Max(Registry->RebuildCount, 1u);
+	printf("device %u losses, %u rebuilds, %u failed part way (at most %u tries), %u creates, %u out of order, %u made from stale, %s\n",
+		   DEVICE_BENCH_LOSSES, Registry->RebuildCount, Registry->FailedRebuildCount, MaxAttempts, Mock->CreateCount, Mock->OutOfOrder,
+		   Mock->StaleParents, AllGood ? "ok" : "BROKEN");
+	printf("device recovery %.2fus mean, %.2fus max, registry bookkeeping only, the mock makes nothing\n", MeanRecovery / 1000.0,
+		   (double)Registry->MaxRecoveryTime / 1000.0);
+	
+	LinuxFreeMemory(Registry, sizeof(device_registry));
+	LinuxFreeMemory(Mock, sizeof(mock_device));
+	
+	return AllGood;
+}
+
+//
+// Cache: the shader cache on a real directory with a stand-in compiler, cold start against warm, and what
+// it does with damaged entries, writers racing each other and a full budget
+//
+
+// @Note What D3DCompile takes for one of our permutations, about. The stand-in only sleeps it off.
+#define CACHE_BENCH_COMPILE_NS 15000000
+#define CACHE_BENCH_PERMUTATIONS (2 + ScaleMode_Count + SurfaceFormat_Count - 1) // Same count as LoadD3D11Shaders
+#define CACHE_BENCH_WARM_RUNS 50
+#define CACHE_BENCH_STRESS_THREADS 4
+#define CACHE_BENCH_STRESS_NS 300000000
+
+struct cache_permutation
+{
+	const char *EntryPoint;
+	const char *Define;
+};
+
+global cache_permutation CachePermutations[CACHE_BENCH_PERMUTATIONS] =
+{
+	{ "VertexMain", "SCALE_MODE=0" },
+	{ "PixelMain",  "SCALE_MODE=0" }, { "PixelMain", "SCALE_MODE=1" }, { "PixelMain", "SCALE_MODE=2" },
+	{ "PixelMain",  "SCALE_MODE=3" }, { "PixelMain", "SCALE_MODE=4" },
+	{ "VertexMain", "COLOUR_SOURCE=1" },
+	{ "PixelMain",  "COLOUR_SOURCE=1" }, { "PixelMain", "COLOUR_SOURCE=2" },
+};
+
+internal shader_key GetBenchShaderKey(const char *Source, cache_permutation *Permutation)
+{
+	shader_key Key = StartShaderKey();
+	MixShaderKey(&Key, (void *)Source, strlen(Source));
+	MixShaderKeyString(&Key, Permutation->EntryPoint);
+	MixShaderKeyString(&Key, Permutation->Define);
+	
+	return Key;
+}
+
+// @Note Bytecode that can only have come from this key, a few KB like the real thing
+internal u32 MockShaderBytes(shader_key Key, u8 *Bytes)
+{
+	u32 Series = (u32)(Key.Low ^ Key.High) | 1;
+	u32 Size = 2048 + (NextRandom(&Series) % 4096);
+	for (u32 Index = 0; Index < Size; ++Index)
+	{
+		Bytes[Index] = (u8)NextRandom(&Series);
+	}
+	
+	return Size;
+}
+
+struct cache_start
+{
+	u32 Embedded;
+	u32 Cached;
+	u32 Compiled;
+	u32 Wrong; // Bytecode that isn't what the key compiles to
+	u64 Time;
+};
+
+// @Note What the D3D11 compositor does at startup, see LoadShader
+internal cache_start StartWithCache(shader_cache *Cache, const char *Source, embedded_shader *Embedded, u32 EmbeddedCount)
+{
+	cache_start Start = {};
+	
+	// @Note Only the loading counts, the check after it doesn't
+	u8 Expected[8192];
+	u8 Compiled[8192];
+	for (u32 Index = 0; Index < CACHE_BENCH_PERMUTATIONS; ++Index)
+	{
+		u64 StartTime = GetNanoseconds();
+		shader_key Key = GetBenchShaderKey(Source, &CachePermutations[Index]);
+		
+		shader_blob Shader = FindEmbeddedShader(Embedded, EmbeddedCount, Key);
+		bool IsCached = false;
+		if (Shader.Data)
+		{
+			++Start.Embedded;
+		}
+		else if ((Shader = LookupShaderCache(Cache, Key)).Data)
+		{
+			IsCached = true;
+			++Start.Cached;
+		}
+		else
+		{
+			SleepUntil(GetNanoseconds() + CACHE_BENCH_COMPILE_NS);
+			Shader.Data = Compiled;
+			Shader.Size = MockShaderBytes(Key, Compiled);
+			StoreShaderCache(Cache, Key, Shader.Data, Shader.Size);
+			++Start.Compiled;
+		}
+		Start.Time += GetNanoseconds() - StartTime;
+		
+		u32 ExpectedSize = MockShaderBytes(Key, Expected);
+		Start.Wrong += (Shader.Size != ExpectedSize) || (memcmp(Shader.Data, Expected, ExpectedSize) != 0);
+		
+		if (IsCached)
+		{
+			ReleaseCachedShader(Cache, Shader);
+		}
+	}
+	
+	return Start;
+}
+
+internal void BuildBenchCachePath(const char *Directory, shader_key Key, char *Path)
+{
+	snprintf(Path, SHADER_CACHE_MAX_PATH, "%s/%016llx%016llx.bin", Directory, (unsigned long long)Key.High,
+			 (unsigned long long)Key.Low);
+}
+
+// @Note Flips a byte at Offset, or cuts the file there when Truncate
+internal void DamageCacheEntry(const char *Path, size_t Offset, bool Truncate)
+{
+	if (Truncate)
+	{
+		truncate(Path, (off_t)Offset);
+		return;
+	}
+	
+	int File = open(Path, O_RDWR);
+	u8 Byte = 0;
+	pread(File, &Byte, 1, (off_t)Offset);
+	Byte ^= 0x5A;
+	pwrite(File, &Byte, 1, (off_t)Offset);
+	close(File);
+}
+
+struct cache_stress
+{
+	const char *Directory;
+	const char *Source;
+	u32 ThreadIndex;
+	u32 volatile *IsDone;
+	
+	u32 Reads;
+	u32 Hits;
+	u32 Wrong;
+	u32 Rejected;
+};
+
+// @Note Every thread writes the same keys under its own writer ID and reads them straight back
+internal void *CacheStressThread(void *Parameter)
+{
+	cache_stress *Stress = (cache_stress *)Parameter;
+	
+	shader_cache Cache;
+	InitializeShaderCache(&Cache, &LinuxFiles, LinuxAllocateMemory, LinuxFreeMemory, (char *)Stress->Directory, Megabytes(64),
+						  Stress->ThreadIndex + 1);
+	
+	u8 Expected[8192];
+	u32 Series = 0x9E3779B9u * (Stress->ThreadIndex + 1);
+	while (!AtomicLoadU32(Stress->IsDone))
+	{
+		shader_key Key = GetBenchShaderKey(Stress->Source, &CachePermutations[NextRandom(&Series) % CACHE_BENCH_PERMUTATIONS]);
+		u32 ExpectedSize = MockShaderBytes(Key, Expected);
+		
+		if (NextRandom(&Series) & 1)
+		{
+			StoreShaderCache(&Cache, Key, Expected, ExpectedSize);
+		}
+		else
+		{
+			shader_blob Shader = LookupShaderCache(&Cache, Key);
+			++Stress->Reads;
+			if (Shader.Data)
+			{
+				++Stress->Hits;
+				Stress->Wrong += (Shader.Size != ExpectedSize) || (memcmp(Shader.Data, Expected, ExpectedSize) != 0);
+				ReleaseCachedShader(&Cache, Shader);
+			}
+		}
+	}
+	
+	Stress->Rejected = Cache.RejectedCount;
+	return NULL;
+}
+
+internal void EmptyCacheDirectory(const char *Directory)
+{
+	platform_file_info Files[SHADER_CACHE_MAX_FILES];
+	u32 FileCount = LinuxListFiles((char *)Directory, Files, SHADER_CACHE_MAX_FILES);
+	for (u32 FileIndex = 0; FileIndex < FileCount; ++FileIndex)
+	{
+		char Path[SHADER_CACHE_MAX_PATH];
+		snprintf(Path, sizeof(Path), "%.190s/%.63s", Directory, Files[FileIndex].Name);
+		unlink(Path);
+	}
+}
+
+internal bool BenchmarkCache()
+{
+	char Directory[] = "/tmp/overlay_cache_XXXXXX";
+	if (!mkdtemp(Directory))
+	{
+		Error("mkdtemp");
+	}
+	
+	const char *Source  = "float4 PixelMain() : SV_TARGET { return float4(SCALE_MODE, COLOUR_SOURCE, 0, 1); }";
+	const char *Edited  = "float4 PixelMain() : SV_TARGET { return float4(SCALE_MODE, COLOUR_SOURCE, 1, 1); }";
+	bool AllGood = true;
+	
+	//
+	// Cold, warm, embedded
+	//
+	
+	shader_cache Cache;
+	InitializeShaderCache(&Cache, &LinuxFiles, LinuxAllocateMemory, LinuxFreeMemory, Directory, Megabytes(8), 1);
+	cache_start Cold = StartWithCache(&Cache, Source, NULL, 0);
+	AllGood &= (Cold.Compiled == CACHE_BENCH_PERMUTATIONS) && (Cold.Wrong == 0) && (Cache.StoredCount == CACHE_BENCH_PERMUTATIONS);
+	
+	u64 WarmTime = 0;
+	for (u32 Run = 0; Run < CACHE_BENCH_WARM_RUNS; ++Run)
+	{
+		InitializeShaderCache(&Cache, &LinuxFiles, LinuxAllocateMemory, LinuxFreeMemory, Directory, Megabytes(8), 1);
+		cache_start Warm = StartWithCache(&Cache, Source, NULL, 0);
+		AllGood &= (Warm.Cached == CACHE_BENCH_PERMUTATIONS) && (Warm.Wrong == 0);
+		WarmTime += Warm.Time;
+	}
+	WarmTime /= CACHE_BENCH_WARM_RUNS;
+	
+	// @Note What a BAKE_SHADERS build writes, checked by reading the bytes back out of the text
+	embedded_shader Embedded[CACHE_BENCH_PERMUTATIONS];
+	u8 *EmbeddedBytes = (u8 *)LinuxAllocateMemory(CACHE_BENCH_PERMUTATIONS * 8192);
+	for (u32 Index = 0; Index < CACHE_BENCH_PERMUTATIONS; ++Index)
+	{
+		Embedded[Index].Key  = GetBenchShaderKey(Source, &CachePermutations[Index]);
+		Embedded[Index].Data = EmbeddedBytes + Index * 8192;
+		Embedded[Index].Size = MockShaderBytes(Embedded[Index].Key, Embedded[Index].Data);
+	}
+	
+	text_buffer Text;
+	Text.Size   = Megabytes(1);
+	Text.Used   = 0;
+	Text.Memory = (char *)LinuxAllocateMemory(Text.Size);
+	WriteEmbeddedShaders(&Text, Embedded, CACHE_BENCH_PERMUTATIONS);
+	AllGood &= (Text.Used < Text.Size);
+	
+	u32 EmbeddedWrong = 0;
+	const char *Table = strstr(Text.Memory, "global embedded_shader");
+	for (u32 Index = 0; Index < CACHE_BENCH_PERMUTATIONS; ++Index)
+	{
+		char Name[64];
+		snprintf(Name, sizeof(Name), "EmbeddedShader%u[] =", Index);
+		char *At = strstr(Text.Memory, Name);
+		for (u32 ByteIndex = 0; At && (ByteIndex < Embedded[Index].Size); ++ByteIndex)
+		{
+			At = strstr(At + 1, "0x");
+			EmbeddedWrong += !At || ((u8)strtoul(At, NULL, 16) != Embedded[Index].Data[ByteIndex]);
+		}
+		
+		char KeyText[64];
+		snprintf(KeyText, sizeof(KeyText), "{ { 0x%016llxull, 0x%016llxull }", (unsigned long long)Embedded[Index].Key.Low,
+				 (unsigned long long)Embedded[Index].Key.High);
+		EmbeddedWrong += !At || !Table || !strstr(Table, KeyText);
+	}
+	AllGood &= (EmbeddedWrong == 0);
+	
+	cache_start Baked = StartWithCache(&Cache, Source, Embedded, CACHE_BENCH_PERMUTATIONS);
+	AllGood &= (Baked.Embedded == CACHE_BENCH_PERMUTATIONS) && (Baked.Wrong == 0);
+	
+	printf("cache cold %.1fms, %u compiled at %.0fms each\n", (double)Cold.Time / 1e6, Cold.Compiled, CACHE_BENCH_COMPILE_NS / 1e6);
+	printf("cache warm %.3fms from the cache (%.0fx), %.4fms embedded, header %.1fKB for %u shaders\n", (double)WarmTime / 1e6,
+		   (double)Cold.Time / (double)Max(WarmTime, (u64)1), (double)Baked.Time / 1e6, GetKilobytes(Text.Used), CACHE_BENCH_PERMUTATIONS);
+	
+	//
+	// An edited source misses, the old entries stay good
+	//
+	
+	InitializeShaderCache(&Cache, &LinuxFiles, LinuxAllocateMemory, LinuxFreeMemory, Directory, Megabytes(8), 1);
+	cache_start EditedStart = StartWithCache(&Cache, Edited, Embedded, CACHE_BENCH_PERMUTATIONS);
+	AllGood &= (EditedStart.Compiled == CACHE_BENCH_PERMUTATIONS) && (EditedStart.Wrong == 0);
+	
+	//
+	// Damaged entries: a flipped byte in the bytecode, in the key, a cut off file, another version
+	//
+	
+	char Path[SHADER_CACHE_MAX_PATH];
+	size_t Damage[4][2] =
+	{
+		{ sizeof(shader_cache_header) + 100, 0 },
+		{ 8, 0 },
+		{ sizeof(shader_cache_header) + 10, 1 },
+		{ 4, 0 },
+	};
+	for (u32 Index = 0; Index < GetArrayCount(Damage); ++Index)
+	{
+		BuildBenchCachePath(Directory, GetBenchShaderKey(Source, &CachePermutations[Index]), Path);
+		DamageCacheEntry(Path, Damage[Index][0], Damage[Index][1] != 0);
+	}
+	
+	InitializeShaderCache(&Cache, &LinuxFiles, LinuxAllocateMemory, LinuxFreeMemory, Directory, Megabytes(8), 1);
+	cache_start Damaged = StartWithCache(&Cache, Source, NULL, 0);
+	u32 DamagedRejected = Cache.RejectedCount;
+	AllGood &= (Damaged.Compiled == GetArrayCount(Damage)) && (DamagedRejected == GetArrayCount(Damage)) && (Damaged.Wrong == 0);
+	
+	InitializeShaderCache(&Cache, &LinuxFiles, LinuxAllocateMemory, LinuxFreeMemory, Directory, Megabytes(8), 1);
+	cache_start Repaired = StartWithCache(&Cache, Source, NULL, 0);
+	AllGood &= (Repaired.Cached == CACHE_BENCH_PERMUTATIONS) && (Repaired.Wrong == 0);
+	
+	//
+	// Writers racing each other over the same entries, every read must be whole
+	//
+	
+	EmptyCacheDirectory(Directory);
+	
+	u32 volatile IsDone = 0;
+	cache_stress Stress[CACHE_BENCH_STRESS_THREADS] = {};
+	pthread_t Threads[CACHE_BENCH_STRESS_THREADS];
+	for (u32 ThreadIndex = 0; ThreadIndex < CACHE_BENCH_STRESS_THREADS; ++ThreadIndex)
+	{
+		Stress[ThreadIndex].Directory   = Directory;
+		Stress[ThreadIndex].Source      = Source;
+		Stress[ThreadIndex].ThreadIndex = ThreadIndex;
+		Stress[ThreadIndex].IsDone      = &IsDone;
+		pthread_create(&Threads[ThreadIndex], NULL, CacheStressThread, &Stress[ThreadIndex]);
+	}
+	
+	SleepUntil(GetNanoseconds() + CACHE_BENCH_STRESS_NS);
+	AtomicStoreU32(&IsDone, 1);
+	
+	u32 StressReads = 0;
+	u32 StressHits = 0;
+	u32 StressWrong = 0;
+	u32 StressRejected = 0;
+	for (u32 ThreadIndex = 0; ThreadIndex < CACHE_BENCH_STRESS_THREADS; ++ThreadIndex)
+	{
+		pthread_join(Threads[ThreadIndex], NULL);
+		StressReads    += Stress[ThreadIndex].Reads;
+		StressHits     += Stress[ThreadIndex].Hits;
+		StressWrong    += Stress[ThreadIndex].Wrong;
+		StressRejected += Stress[ThreadIndex].Rejected;
+	}
+	
+	// @Note Every temp file was renamed or deleted
+	platform_file_info Files[SHADER_CACHE_MAX_FILES];
+	u32 FileCount = LinuxListFiles(Directory, Files, SHADER_CACHE_MAX_FILES);
+	AllGood &= (StressWrong == 0) && (StressRejected == 0) && (StressHits > 0) && (FileCount <= CACHE_BENCH_PERMUTATIONS);
+	
+	//
+	// Budget: the oldest go, the newest stay, and a temp file a writer left behind an hour ago goes too
+	//
+	
+	EmptyCacheDirectory(Directory);
+	
+	snprintf(Path, sizeof(Path), "%s/%032u.0000000a-1.tmp", Directory, 0);
+	int Left = open(Path, O_WRONLY | O_CREAT, 0644);
+	close(Left);
+	timespec Old[2] = { { time(NULL) - 7200, 0 }, { time(NULL) - 7200, 0 } };
+	utimensat(AT_FDCWD, Path, Old, 0);
+	
+	u32 BudgetEntries = 4;
+	InitializeShaderCache(&Cache, &LinuxFiles, LinuxAllocateMemory, LinuxFreeMemory, Directory, BudgetEntries * 8192, 1);
+	
+	u8 Bytes[8192];
+	u32 StoredCount = 3 * CACHE_BENCH_PERMUTATIONS;
+	shader_key Newest;
+	for (u32 Index = 0; Index < StoredCount; ++Index)
+	{
+		shader_key Key = GetBenchShaderKey((Index < CACHE_BENCH_PERMUTATIONS) ? Source : Edited,
+										   &CachePermutations[Index % CACHE_BENCH_PERMUTATIONS]);
+		Key.High ^= Index;
+		StoreShaderCache(&Cache, Key, Bytes, MockShaderBytes(Key, Bytes));
+		Newest = Key;
+	}
+	
+	u64 KeptBytes = 0;
+	bool LeftBehind = false;
+	FileCount = LinuxListFiles(Directory, Files, SHADER_CACHE_MAX_FILES);
+	for (u32 FileIndex = 0; FileIndex < FileCount; ++FileIndex)
+	{
+		KeptBytes  += Files[FileIndex].Size;
+		LeftBehind |= (strstr(Files[FileIndex].Name, ".tmp") != NULL);
+	}
+	
+	shader_blob Kept = LookupShaderCache(&Cache, Newest);
+	AllGood &= (KeptBytes <= Cache.MaxBytes) && !LeftBehind && (Kept.Data != NULL) &&
+		(Cache.EvictedCount == StoredCount - FileCount);
+	ReleaseCachedShader(&Cache, Kept);
+	
+	printf("cache edited source %u missed, %u damaged entries rejected and compiled again, %u writers %u reads %u hits %u torn, "
+		   "%u evicted %u kept %.1fKB of %.1fKB, %s\n", EditedStart.Compiled, DamagedRejected, CACHE_BENCH_STRESS_THREADS, StressReads,
+		   StressHits, StressWrong + StressRejected, Cache.EvictedCount, FileCount, GetKilobytes(KeptBytes), GetKilobytes(Cache.MaxBytes),
+		   AllGood ? "ok" : "BROKEN");
+	
+	EmptyCacheDirectory(Directory);
+	rmdir(Directory);
+	LinuxFreeMemory(Text.Memory, Text.Size);
+	LinuxFreeMemory(EmbeddedBytes, CACHE_BENCH_PERMUTATIONS * 8192);
+	
+	return AllGood;
+}
+
+#define X11_BENCH_FRAMES 200
+#define X11_BENCH_WINDOW 256
+#define X11_BENCH_SQUARE 32
+
+// @Note Needs an X server with MIT-SHM in $DISPLAY, "Xvfb :1 -screen 0 1920x1080x24" is one. Another client
+// draws squares into a window of its own, so the damage comes from the server like any other program's, and
+// every frame is timed from the draw landing to it being in the captured surface.
+internal bool BenchmarkX11()
+{
+#if X11_CAPTURE
+	x11_source Source;
+	if (!InitializeX11Source(&Source, NULL))
+	{
+		printf("x11 skipped, no X display with MIT-SHM in $DISPLAY\n");
+		return true;
+	}
+	
+	frame_source Frames = X11FrameSource(&Source);
+	captured_frame Frame;
+	bool AllGood = true;
+	
+	u64 WholeStart = GetNanoseconds();
+	AllGood &= (Frames.Acquire(Frames.Context, 100, &Frame) == AcquireResult_Frame) && Frame.SourceWasReset;
+	u64 WholeTime = GetNanoseconds() - WholeStart;
+	
+	Display *Painter = XOpenDisplay(NULL);
+	if (!Painter)
+	{
+		Error("XOpenDisplay");
+	}
+	
+	XSetWindowAttributes Attributes = {};
+	Attributes.override_redirect = True;
+	Attributes.background_pixel  = 0;
+	Window Target = XCreateWindow(Painter, DefaultRootWindow(Painter), 64, 64, X11_BENCH_WINDOW, X11_BENCH_WINDOW, 0,
+								  CopyFromParent, InputOutput, CopyFromParent, CWOverrideRedirect | CWBackPixel, &Attributes);
+	GC Context = XCreateGC(Painter, Target, 0, NULL);
+	XMapRaised(Painter, Target);
+	XSync(Painter, False);
+	
+	// @Note Whatever mapping the window damaged
+	while (Frames.Acquire(Frames.Context, 50, &Frame) == AcquireResult_Frame)
+	{
+	}
+	
+	u64 BandsBefore   = Source.BandCount;
+	u64 FetchedBefore = Source.FetchedBytes;
+	u64 CPUTime = 0;
+	latency_histogram Latency = {};
+	u32 MissedCount = 0;
+	u32 WrongCount  = 0;
+	
+	for (u32 FrameIndex = 0; FrameIndex < X11_BENCH_FRAMES; ++FrameIndex)
+	{
+		int X = (int)((FrameIndex * 13) % (X11_BENCH_WINDOW - X11_BENCH_SQUARE));
+		int Y = (int)((FrameIndex * 7)  % (X11_BENCH_WINDOW - X11_BENCH_SQUARE));
+		u32 Colour = (0x010203u * (FrameIndex + 1)) & 0x00FFFFFF;
+		
+		XSetForeground(Painter, Context, Colour);
+		XFillRectangle(Painter, Target, Context, X, Y, X11_BENCH_SQUARE, X11_BENCH_SQUARE);
+		XSync(Painter, False);
+		
+		timespec CPUStart;
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &CPUStart);
+		u64 DrawTime = GetNanoseconds();
+		
+		acquire_result Result = Frames.Acquire(Frames.Context, 100, &Frame);
+		
+		u64 FrameTime = GetNanoseconds();
+		timespec CPUEnd;
+		clock_gettime(CLOCK_THREAD_CPUTIME_ID, &CPUEnd);
+		
+		if (Result != AcquireResult_Frame)
+		{
+			++MissedCount;
+			continue;
+		}
+		
+		RecordLatency(&Latency, (u32)Min(FrameTime - DrawTime, 0xFFFFFFFFull));
+		CPUTime += (u64)(CPUEnd.tv_sec - CPUStart.tv_sec) * 1000000000 + CPUEnd.tv_nsec - CPUStart.tv_nsec;
+		
+		// @Note The middle of the square, in the surface and in a dirty rect
+		int CentreX = 64 + X + X11_BENCH_SQUARE / 2;
+		int CentreY = 64 + Y + X11_BENCH_SQUARE / 2;
+		u32 Pixel = *(u32 *)(Source.Surface.Memory + CentreY * Source.Surface.Pitch + CentreX * BITMAP_BYTES_PER_PIXEL);
+		
+		bool Reported = !Frame.MetadataIsValid;
+		for (u32 RectIndex = 0; RectIndex < Frame.DirtyRectCount; ++RectIndex)
+		{
+			Reported |= BoxContains(Frame.DirtyRects[RectIndex], box{ CentreX, CentreY, CentreX + 1, CentreY + 1 });
+		}
+		
+		WrongCount += ((Pixel & 0x00FFFFFF) != Colour) || !Reported;
+		Frames.Release(Frames.Context, &Frame);
+	}
+	
+	u32 FrameCount = Max(X11_BENCH_FRAMES - MissedCount, 1u);
+	u64 WholeBytes = (u64)Source.Surface.Pitch * Source.Surface.Height;
+	u64 FetchedPerFrame = (Source.FetchedBytes - FetchedBefore) / FrameCount;
+	AllGood &= (MissedCount == 0) && (WrongCount == 0);
+	
+	printf("x11 %dx%d %s, whole grab %.2fms %.1fKB, %u frames: damage to frame p50 %.1fus p99 %.1fus, %.1fus CPU, "
+		   "%.1f bands %.1fKB fetched a frame (%.2f%% of whole), %u missed %u wrong, %s\n", Source.Surface.Width, Source.Surface.Height,
+		   Source.DamageLibrary ? "XDamage" : "polling", WholeTime / 1000000.0, GetKilobytes(WholeBytes), X11_BENCH_FRAMES,
+		   GetLatencyPercentile(&Latency, 5000) / 1000.0, GetLatencyPercentile(&Latency, 9900) / 1000.0, (double)CPUTime / FrameCount / 1000.0,
+		   (double)(Source.BandCount - BandsBefore) / FrameCount, GetKilobytes(FetchedPerFrame), 100.0 * FetchedPerFrame / WholeBytes,
+		   MissedCount, WrongCount, AllGood ? "ok" : "BROKEN");
+	
+	XFreeGC(Painter, Context);
+	XDestroyWindow(Painter, Target);
+	XCloseDisplay(Painter);
+	CloseX11Source(&Source);
+	
+	return AllGood;
+#else
+	printf("x11 skipped, built without X11 capture\n");
+	return true;
+#endif
+}
+
+//
+// OpenGL: the GL compositor against the software one, the same frames through both and the back buffers compared,
+// and in some the context lost and made again before the last one
+//
+
+#define OPENGL_BENCH_FRAMES 30
+#define OPENGL_BENCH_WIDTH  1280
+#define OPENGL_BENCH_HEIGHT 720
+
+// @Note A channel this many levels off makes the pixel different. Rounding of the sRGB curves and the filters in
+// float against the software compositor's tables, and the odd edge pixel the rasterizer puts the other way.
+#define OPENGL_BENCH_TOLERANCE 2
+#define OPENGL_BENCH_MAX_DIFFERENT 1.0 // Percent of the back buffer
+
+struct opengl_case
+{
+	const char *Name;
+	display_rotation Rotation;
+	surface_format Format;
+	scale_mode Scale;
+	int CutWidth;
+	int CutHeight;
+	int DisplayWidth;
+	int DisplayHeight;
+	int OverlayCount;
+	u32 EffectKey;
+	bool LoseContext;
+};
+
+// @Note Every piece cropped whole and drawn, like the first frame after a layout change
+internal void DrawOpenGLBenchFrame(compositor *Compositor, render_state *State, captured_frame *Frame, crop_piece *Pieces, u32 PieceCount)
+{
+	for (u32 PieceIndex = 0; PieceIndex < PieceCount; ++PieceIndex)
+	{
+		box CutBox = Pieces[PieceIndex].Mapping.SurfaceBox;
+		Compositor->Crop(Compositor->Context, Frame, PieceIndex, CutBox, &CutBox, 1);
+		Pieces[PieceIndex].HasImage = true;
+	}
+	
+	if (Compositor->Wait)
+	{
+		Compositor->Wait(Compositor->Context, 1000);
+	}
+	
+	Compositor->Shade(Compositor->Context, State, Pieces, PieceCount);
+	Compositor->Present(Compositor->Context);
+}
+
+// @Note Pixels with any channel more than Tolerance off
+internal u64 GetDifferentPixelCount(bitmap *A, bitmap *B, int Width, int Height, int Tolerance)
+{
+	u64 DifferentCount = 0;
+	for (int Y = 0; Y < Height; ++Y)
+	{
+		u8 *RowA = A->Memory + Y * A->Pitch;
+		u8 *RowB = B->Memory + Y * B->Pitch;
+		for (int X = 0; X < Width * BITMAP_BYTES_PER_PIXEL; X += BITMAP_BYTES_PER_PIXEL)
+		{
+			bool IsDifferent = false;
+			for (int Channel = 0; Channel < BITMAP_BYTES_PER_PIXEL; ++Channel)
+			{
+				int Difference = RowA[X + Channel] - RowB[X + Channel];
+				IsDifferent |= (Difference > Tolerance) || (Difference < -Tolerance);
+			}
+			
+			DifferentCount += IsDifferent ? 1 : 0;
+		}
+	}
+	
+	return DifferentCount;
+}
+
+internal bool BenchmarkOpenGL()
+{
+#if OPENGL_COMPOSITOR
+	linux_opengl OpenGL;
+	const char *FailedStep = InitializeLinuxOpenGL(&OpenGL, false);
+	if (FailedStep)
+	{
+		printf("opengl skipped, no GL 3.3 core context through EGL (%s)\n", FailedStep);
+		return true;
+	}
+	
+	opengl_functions *GL = &OpenGL.Functions;
+	opengl_platform Platform = LinuxOpenGLPlatform(&OpenGL);
+	opengl_compositor *Accelerated = (opengl_compositor *)LinuxAllocateMemory(sizeof(opengl_compositor));
+	if (!InitializeOpenGLCompositor(Accelerated, &Platform))
+	{
+		printf("opengl can't make the %s:\n%s\n", Accelerated->FailedName, Accelerated->ShaderLog);
+		return false;
+	}
+	
+	// @Note As many threads as llvmpipe gets, so it is one CPU renderer against another
+	long CoreCount = sysconf(_SC_NPROCESSORS_ONLN);
+	size_t PoolMemorySize = Megabytes(1);
+	memory_arena PoolArena;
+	InitializeArena(&PoolArena, LinuxAllocateMemory(PoolMemorySize), PoolMemorySize);
+	
+	software_compositor *Reference = (software_compositor *)LinuxAllocateMemory(sizeof(software_compositor));
+	InitializeSoftwareCompositor(Reference, LinuxAllocateMemory, LinuxFreeMemory);
+	Reference->TilePool  = CreateTilePool(&PoolArena, (u32)Min(Max(CoreCount, 1L), (long)MAX_TILE_WORKERS), false);
+	Reference->HashTiles = false;
+	
+	compositor Compositors[2] = { SoftwareCompositor(Reference), OpenGLCompositor(Accelerated) };
+	
+	printf("opengl %s, %s, against the %s software compositor on %ld cores\n", (const char *)GL->GetString(GL_RENDERER),
+		   (const char *)GL->GetString(GL_VERSION), ShadeKernelNames[Reference->ShadeKernel], CoreCount);
+	
+	opengl_case Cases[] =
+	{
+		{ "bilinear",     DisplayRotation_Identity, SurfaceFormat_BGRA8,   ScaleMode_Bilinear, 480, 270, 480, 270, 1, 0, false },
+		{ "bilinear up",  DisplayRotation_Identity, SurfaceFormat_BGRA8,   ScaleMode_Bilinear, 320, 180, 720, 405, 1, 0, true  },
+		{ "nearest up",   DisplayRotation_Identity, SurfaceFormat_BGRA8,   ScaleMode_Nearest,  320, 180, 720, 405, 1, 0, false },
+		{ "mip down",     DisplayRotation_Identity, SurfaceFormat_BGRA8,   ScaleMode_Mip,      960, 540, 320, 180, 1, 0, false },
+		{ "bicubic up",   DisplayRotation_Identity, SurfaceFormat_BGRA8,   ScaleMode_Bicubic,  320, 180, 720, 405, 1, 0, false },
+		{ "lanczos down", DisplayRotation_Identity, SurfaceFormat_BGRA8,   ScaleMode_Lanczos,  960, 540, 400, 225, 1, 0, false },
+		{ "rotated 90",   DisplayRotation_90,       SurfaceFormat_BGRA8,   ScaleMode_Bilinear, 480, 270, 480, 270, 1, 0, false },
+		{ "rotated 270",  DisplayRotation_270,      SurfaceFormat_BGRA8,   ScaleMode_Bicubic,  480, 270, 600, 338, 1, 0, false },
+		{ "4 overlays",   DisplayRotation_Identity, SurfaceFormat_BGRA8,   ScaleMode_Bilinear, 400, 240, 400, 240, 4, 0, false },
+		{ "scRGB",        DisplayRotation_Identity, SurfaceFormat_RGBA16F, ScaleMode_Bilinear, 480, 270, 480, 270, 1, 0, true  },
+		{ "HDR10 PQ",     DisplayRotation_180,      SurfaceFormat_RGB10A2, ScaleMode_Bilinear, 480, 270, 480, 270, 1, 0, false },
+		{ "effects up",   DisplayRotation_Identity, SurfaceFormat_BGRA8,   ScaleMode_Bilinear, 320, 180, 720, 405, 1, EffectKey_Count - 1, true  },
+		{ "effects 90",   DisplayRotation_90,       SurfaceFormat_BGRA8,   ScaleMode_Lanczos,  480, 270, 400, 225, 1, Effect_Grayscale | Effect_Edges, false },
+	};
+	
+	bool AllGood = true;
+	for (u32 CaseIndex = 0; CaseIndex < GetArrayCount(Cases); ++CaseIndex)
+	{
+		opengl_case *Case = &Cases[CaseIndex];
+		
+		// @Note The desktop, its HDR surface and a readback of the back buffer
+		memory_arena Arena;
+		size_t MemorySize = Megabytes(4) + (size_t)OPENGL_BENCH_WIDTH * OPENGL_BENCH_HEIGHT * (BITMAP_BYTES_PER_PIXEL + 8);
+		InitializeArena(&Arena, LinuxAllocateMemory(MemorySize), MemorySize);
+		
+		synthetic_source *Source = PushStruct(&Arena, synthetic_source);
+		InitializeSyntheticSource(Source, &Arena, OPENGL_BENCH_WIDTH, OPENGL_BENCH_HEIGHT, Case->Rotation, 0, 0);
+		SetSyntheticFormat(Source, &Arena, Case->Format, 200.0f, Reference->ShadeKernel);
+		
+		box Output = { 0, 0, OPENGL_BENCH_WIDTH, OPENGL_BENCH_HEIGHT };
+		render_state State = DefaultRenderState(&Output, 1, Case->CutWidth, Case->CutHeight);
+		State.Overlays[0].DisplayWidth  = Case->DisplayWidth;
+		State.Overlays[0].DisplayHeight = Case->DisplayHeight;
+		State.Shade.Scale = Case->Scale;
+		State.Shade.Effects.Key = Case->EffectKey;
+		
+		// @Note The rest go left along the bottom, each a bit smaller so the atlases have mixed sizes
+		for (int OverlayIndex = 1; OverlayIndex < Case->OverlayCount; ++OverlayIndex)
+		{
+			int Width  = Case->CutWidth  - OverlayIndex * 16;
+			int Height = Case->CutHeight - OverlayIndex * 8;
+			box CutBox = { 0, 0, Width, Height };
+			CutBox.Right  = OPENGL_BENCH_WIDTH - OverlayIndex * Case->CutWidth;
+			CutBox.Left   = CutBox.Right - Width;
+			CutBox.Top    = OPENGL_BENCH_HEIGHT - Height;
+			CutBox.Bottom = OPENGL_BENCH_HEIGHT;
+			
+			AddOverlay(&State, CutBox, Width + OverlayIndex * 8, Height + OverlayIndex * 4);
+		}
+		
+		output_geometry Geometry[MAX_OUTPUTS];
+		Geometry[0].Rotation      = Case->Rotation;
+		Geometry[0].DesktopWidth  = OPENGL_BENCH_WIDTH;
+		Geometry[0].DesktopHeight = OPENGL_BENCH_HEIGHT;
+		
+		// @Note Nothing is drawn straight from the surface here, the pipeline sets that per frame
+		crop_piece Pieces[MAX_CROP_PIECES] = {};
+		u32 PieceCount = BuildCropPieces(&State, Geometry, Pieces);
+		
+		bool SlotMoved[MAX_CROP_PIECES];
+		for (u32 CompositorIndex = 0; CompositorIndex < GetArrayCount(Compositors); ++CompositorIndex)
+		{
+			Compositors[CompositorIndex].Layout(Compositors[CompositorIndex].Context, &State, Pieces, PieceCount, SlotMoved);
+		}
+		
+		// @Note The GPU time is in there too, every frame is waited for
+		u64 FrameTimes[2] = {};
+		captured_frame Frame = {};
+		for (int FrameIndex = 0; FrameIndex < OPENGL_BENCH_FRAMES; ++FrameIndex)
+		{
+			SyntheticAcquire(Source, 0, &Frame);
+			
+			for (u32 CompositorIndex = 0; CompositorIndex < GetArrayCount(Compositors); ++CompositorIndex)
+			{
+				u64 StartTime = GetNanoseconds();
+				DrawOpenGLBenchFrame(&Compositors[CompositorIndex], &State, &Frame, Pieces, PieceCount);
+				if (CompositorIndex == 1)
+				{
+					GL->Finish();
+				}
+				
+				FrameTimes[CompositorIndex] += GetNanoseconds() - StartTime;
+			}
+		}
+		
+		// @Note Lost after the last frame, everything made again in a new context. The frame drawn across it isn't
+		// presented, the one after crops every piece again and has to come out like the software compositor's.
+		device_registry *Registry = &Accelerated->Registry;
+		bool Recovered = true;
+		if (Case->LoseContext)
+		{
+			u32 RebuildCount  = Registry->RebuildCount;
+			u64 PresentCount  = Accelerated->PresentCount;
+			Accelerated->ContextIsLost = true;
+			
+			DrawOpenGLBenchFrame(&Compositors[1], &State, &Frame, Pieces, PieceCount);
+			bool WasNotPresented = (Accelerated->PresentCount == PresentCount);
+			
+			DrawOpenGLBenchFrame(&Compositors[1], &State, &Frame, Pieces, PieceCount);
+			GL->Finish();
+			
+			Recovered = WasNotPresented && (Accelerated->PresentCount == PresentCount + 1) && (Registry->RebuildCount == RebuildCount + 1);
+			AllGood &= Recovered;
+		}
+		
+		bitmap *Expected = &Reference->BackBuffer;
+		bitmap Drawn = PushBitmap(&Arena, Accelerated->BackBufferWidth, Accelerated->BackBufferHeight);
+		bool WasRead = ReadOpenGLBackBuffer(Accelerated, &Drawn) && (Drawn.Width == Expected->Width) && (Drawn.Height == Expected->Height);
+		
+		int MaxDifference = WasRead ? GetMaxDifference(Expected, &Drawn, Drawn.Width, Drawn.Height) : 255;
+		u64 DifferentCount = WasRead ? GetDifferentPixelCount(Expected, &Drawn, Drawn.Width, Drawn.Height, OPENGL_BENCH_TOLERANCE) : 0;
+		double DifferentPercent = WasRead ? 100.0 * DifferentCount / ((double)Drawn.Width * Drawn.Height) : 100.0;
+		bool Matches = (DifferentPercent <= OPENGL_BENCH_MAX_DIFFERENT);
+		AllGood &= Matches;
+		
+		printf("opengl %-12s %4dx%-4d software %8.1fus, opengl %8.1fus per frame, max diff %3d, %6.3f%% pixels off by more than %d, %s\n",
+			   Case->Name, Drawn.Width, Drawn.Height, (double)FrameTimes[0] / OPENGL_BENCH_FRAMES / 1000.0,
+			   (double)FrameTimes[1] / OPENGL_BENCH_FRAMES / 1000.0, MaxDifference, DifferentPercent, OPENGL_BENCH_TOLERANCE,
+			   Matches ? "matches" : "DIFFERENT IMAGE");
+		if (Case->LoseContext)
+		{
+			printf("opengl %-12s context lost and %u resources made again in %.1fms, %s\n", Case->Name, Registry->ResourceCount,
+				   (double)Registry->LastRecoveryTime / 1000000.0, Recovered ? "recovered" : "NOT RECOVERED");
+		}
+		
+		LinuxFreeMemory(Arena.Base, MemorySize);
+	}
+	
+	// @Note The worker threads stay parked, the process is about to end anyway
+	CloseLinuxOpenGL(&OpenGL);
+	
+	return AllGood;
+#else
+	printf("opengl skipped, built without the GL compositor\n");
+	return true;
+#endif
+}
+
+//
+// Export: the render thread's side publishing into a ring in POSIX shared memory as fast as it can, against
+// readers that each map it by name, read only, the way another process would
+//
+
+#define EXPORT_BENCH_WIDTH  1280
+#define EXPORT_BENCH_HEIGHT 720
+#define EXPORT_BENCH_TIME   400000000
+#define EXPORT_BENCH_NAME   "/overlay_export_bench"
+
+// @Note Every this many pixels the writer stamps the frame's sequence, a reader checks every stamp
+#define EXPORT_BENCH_STAMP_SPACING 1024
+
+#define EXPORT_BENCH_MAX_READERS 8
+
+struct export_bench_reader
+{
+	// @Note Zero reads as fast as it can, anything else keeps every read open that long like a stalled consumer
+	u64 HoldTime;
+	bool Copies;
+	
+	u32 volatile *Stop;
+	
+	bool Opened;
+	export_reader Reader;
+	u64 TornCount; // Read whole as far as EndExportRead could tell, with a stamp that didn't match
+};
+
+internal bool ExportFrameIsStamped(export_frame *Frame, u8 *Pixels)
+{
+	u32 *Stamps = (u32 *)Pixels;
+	u32 PixelCount = Frame->Width * Frame->Height;
+	
+	bool Stamped = (Frame->Width == EXPORT_BENCH_WIDTH) && (Frame->Height == EXPORT_BENCH_HEIGHT) && (Frame->PieceCount == 1) &&
+		(Frame->Pieces[0].SurfaceBox.Left == (int)(Frame->Sequence & 0xFFFF));
+	for (u32 Index = 0; Stamped && (Index < PixelCount); Index += EXPORT_BENCH_STAMP_SPACING)
+	{
+		Stamped = (Stamps[Index] == (u32)Frame->Sequence);
+	}
+	
+	return Stamped;
+}
+
+internal void *ExportBenchReader(void *Parameter)
+{
+	export_bench_reader *Bench = (export_bench_reader *)Parameter;
+	
+	size_t Size;
+	void *Memory = OpenLinuxSharedMemory(EXPORT_BENCH_NAME, &Size);
+	Bench->Opened = Memory && OpenExportReader(&Bench->Reader, Memory, Size);
+	if (!Bench->Opened)
+	{
+		return NULL;
+	}
+	
+	u8 *Copy = NULL;
+	if (Bench->Copies)
+	{
+		Copy = (u8 *)LinuxAllocateMemory(Bench->Reader.Header->PixelBytes);
+	}
+	
+	export_reader *Reader = &Bench->Reader;
+	while (!AtomicLoadU32(Bench->Stop))
+	{
+		export_frame Frame;
+		if (Bench->Copies)
+		{
+			if (ReadExportRing(Reader, &Frame, Copy))
+			{
+				Bench->TornCount += !ExportFrameIsStamped(&Frame, Copy);
+			}
+			else
+			{
+				sched_yield();
+			}
+			continue;
+		}
+		
+		// @Note Zero copy, the stamps are checked where they lie
+		u8 *Pixels = BeginExportRead(Reader, &Frame);
+		if (!Pixels)
+		{
+			sched_yield();
+			continue;
+		}
+		
+		bool Stamped = ExportFrameIsStamped(&Frame, Pixels);
+		if (Bench->HoldTime)
+		{
+			SleepUntil(GetNanoseconds() + Bench->HoldTime);
+		}
+		
+		if (EndExportRead(Reader) && !Stamped)
+		{
+			++Bench->TornCount;
+		}
+	}
+	
+	if (Copy)
+	{
+		LinuxFreeMemory(Copy, Bench->Reader.Header->PixelBytes);
+	}
+	munmap(Memory, Size);
+	
+	return NULL;
+}
+
+struct export_case
+{
+	const char *Name;
+	u32 ReaderCount;
+	bool Copies;
+	u32 StalledCount; // On top, each holding every read open for 20ms
+};
+
+internal bool BenchmarkExport()
+{
+	export_case Cases[] =
+	{
+		{ "no readers",             0, false, 0 },
+		{ "1 reader",               1, false, 0 },
+		{ "4 readers",              4, false, 0 },
+		{ "4 readers copying",      4, true,  0 },
+		{ "4 readers + 2 stalled",  4, false, 2 },
+		{ "writer + 2 stalled",     0, false, 2 },
+	};
+	
+	u64 PixelBytes = (u64)EXPORT_BENCH_WIDTH * EXPORT_BENCH_HEIGHT * BITMAP_BYTES_PER_PIXEL;
+	u64 Size = GetExportRingSize(EXPORT_RING_SLOT_COUNT, PixelBytes);
+	
+	memory_arena Arena;
+	size_t MemorySize = (size_t)PixelBytes + Megabytes(1);
+	InitializeArena(&Arena, LinuxAllocateMemory(MemorySize), MemorySize);
+	
+	// @Note Stands in for the display texture
+	bitmap Image = PushBitmap(&Arena, EXPORT_BENCH_WIDTH, EXPORT_BENCH_HEIGHT);
+	u32 Series = 0x13572468;
+	for (int Index = 0; Index < EXPORT_BENCH_WIDTH * EXPORT_BENCH_HEIGHT; ++Index)
+	{
+		((u32 *)Image.Memory)[Index] = NextRandom(&Series);
+	}
+	
+	bool AllGood = true;
+	double AloneRate = 0.0;
+	for (u32 CaseIndex = 0; CaseIndex < GetArrayCount(Cases); ++CaseIndex)
+	{
+		export_case *Case = &Cases[CaseIndex];
+		
+		shm_unlink(EXPORT_BENCH_NAME);
+		void *Memory = CreateLinuxSharedMemory(EXPORT_BENCH_NAME, Size);
+		if (!Memory)
+		{
+			Error("Can't make the shared memory for the export ring");
+		}
+		
+		export_ring Ring;
+		InitializeExportRing(&Ring, Memory, EXPORT_RING_SLOT_COUNT, PixelBytes);
+		
+		u32 volatile Stop = 0;
+		u32 ThreadCount = Case->ReaderCount + Case->StalledCount;
+		export_bench_reader Readers[EXPORT_BENCH_MAX_READERS] = {};
+		pthread_t Threads[EXPORT_BENCH_MAX_READERS];
+		for (u32 ReaderIndex = 0; ReaderIndex < ThreadCount; ++ReaderIndex)
+		{
+			export_bench_reader *Reader = &Readers[ReaderIndex];
+			Reader->HoldTime = (ReaderIndex < Case->ReaderCount) ? 0 : 20000000;
+			Reader->Copies   = (ReaderIndex < Case->ReaderCount) && Case->Copies;
+			Reader->Stop     = &Stop;
+			
+			if (pthread_create(&Threads[ReaderIndex], NULL, ExportBenchReader, Reader) != 0)
+			{
+				Error("pthread_create");
+			}
+		}
+		
+		export_frame Frame = {};
+		Frame.PieceCount = 1;
+		Frame.Pieces[0].Slot = box{ 0, 0, EXPORT_BENCH_WIDTH, EXPORT_BENCH_HEIGHT };
+		
+		u64 MaxWriteTime = 0;
+		u64 StartTime = GetNanoseconds();
+		u64 EndTime   = StartTime + EXPORT_BENCH_TIME;
+		u64 Now = StartTime;
+		while (Now < EndTime)
+		{
+			u32 Sequence = (u32)(Ring.Sequence + 1);
+			for (int Index = 0; Index < EXPORT_BENCH_WIDTH * EXPORT_BENCH_HEIGHT; Index += EXPORT_BENCH_STAMP_SPACING)
+			{
+				((u32 *)Image.Memory)[Index] = Sequence;
+			}
+			Frame.Timestamp = Now / 1000;
+			Frame.Pieces[0].SurfaceBox.Left = (int)(Sequence & 0xFFFF);
+			
+			WriteExportRing(&Ring, &Frame, &Image);
+			
+			u64 Written = GetNanoseconds();
+			MaxWriteTime = Max(MaxWriteTime, Written - Now);
+			Now = Written;
+		}
+		
+		AtomicStoreU32(&Stop, 1);
+		for (u32 ReaderIndex = 0; ReaderIndex < ThreadCount; ++ReaderIndex)
+		{
+			pthread_join(Threads[ReaderIndex], NULL);
+		}
+		
+		double Seconds = (double)(Now - StartTime) / 1000000000.0;
+		double Rate = (double)Ring.WrittenCount / Seconds;
+		if (CaseIndex == 0)
+		{
+			AloneRate = Rate;
+		}
+		
+		// @Note A stalled reader gets lapped on every read and must still never see a torn frame
+		bool CaseIsGood = true;
+		u64 ReadCount = 0;
+		u64 StalledReadCount = 0;
+		u64 OverwrittenCount = 0;
+		u64 TornCount = 0;
+		for (u32 ReaderIndex = 0; ReaderIndex < ThreadCount; ++ReaderIndex)
+		{
+			export_bench_reader *Reader = &Readers[ReaderIndex];
+			bool IsStalled = (ReaderIndex >= Case->ReaderCount);
+			CaseIsGood &= Reader->Opened && (IsStalled || (Reader->Reader.ReadCount > 0));
+			
+			ReadCount        += IsStalled ? 0 : Reader->Reader.ReadCount;
+			StalledReadCount += IsStalled ? Reader->Reader.ReadCount : 0;
+			OverwrittenCount += Reader->Reader.OverwrittenCount;
+			TornCount        += Reader->TornCount;
+		}
+		CaseIsGood &= (TornCount == 0);
+		AllGood &= CaseIsGood;
+		
+		printf("export %-22s %dx%d, writer %7.1f frames/s (%3.0f%% of alone), %6.2fGB/s, worst write %6.2fms, "
+			   "%llu whole reads, %llu stalled, %llu overwritten, %llu torn, %s\n",
+			   Case->Name, EXPORT_BENCH_WIDTH, EXPORT_BENCH_HEIGHT, Rate, 100.0 * Rate / AloneRate,
+			   (double)Ring.WrittenBytes / Seconds / (1024.0 * 1024.0 * 1024.0), (double)MaxWriteTime / 1000000.0,
+			   (unsigned long long)ReadCount, (unsigned long long)StalledReadCount, (unsigned long long)OverwrittenCount,
+			   (unsigned long long)TornCount, CaseIsGood ? "ok" : "BROKEN");
+		
+		munmap(Memory, Size);
+	}
+	
+	shm_unlink(EXPORT_BENCH_NAME);
+	printf("export ring %u slots, %.1fKB in /dev/shm, readers map it read only\n", EXPORT_RING_SLOT_COUNT, GetKilobytes(Size));
+	
+	LinuxFreeMemory(Arena.Base, MemorySize);
+	return AllGood;
+}
+
+//
+// YUV: the scalar conversion against the float matrix, every kernel against the scalar one, how fast each is
+// over a whole frame, and converting only the changed tiles against converting the whole of it
+//
+
+#define YUV_BENCH_CHECK_WIDTH  1917 // Odd both ways, so the kernels' tails and the repeated edge get checked
+#define YUV_BENCH_CHECK_HEIGHT 243
+#define YUV_BENCH_WIDTH        1920
+#define YUV_BENCH_HEIGHT       1080
+#define YUV_BENCH_PIXELS       200000000 // Pixels per kernel and layout
+#define YUV_BENCH_FRAMES       300
+#define YUV_BENCH_MOVER_WIDTH  480 // What changes every frame, somewhere that isn't on a tile edge
+#define YUV_BENCH_MOVER_HEIGHT 270
+
+inline u8 RoundYUVReference(float Value)
+{
+	Value = (Value < 0.0f) ? 0.0f : ((Value > 255.0f) ? 255.0f : Value);
+	return (u8)(Value + 0.5f);
+}
+
+// @Note Every Y, U and V of Image against the float matrix on Texture's pixels, the odd edge repeated like the kernels do it.
+// Returns the largest difference, OffCount is how many were off at all and GreyMisses how many grey blocks got any colour.
+internal int CheckYUVReference(bitmap *Texture, yuv_image *Image, u64 *OffCount, u64 *GreyMisses)
+{
+	float Y[3];
+	float U[3];
+	float V[3];
+	float Offsets[2];
+	GetYUVMatrix(Image->Format, Y, U, V, Offsets);
+	
+	int ChromaStep = (Image->Format.Layout == YUVLayout_NV12) ? 2 : 1;
+	int MaxDifference = 0;
+	for (int Row = 0; Row < Texture->Height; Row += 2)
+	{
+		for (int Column = 0; Column < Texture->Width; Column += 2)
+		{
+			float Sums[3] = {};
+			bool Grey = true;
+			for (int Corner = 0; Corner < 4; ++Corner)
+			{
+				int X = Min(Column + (Corner & 1), Texture->Width  - 1);
+				int Y0 = Min(Row + (Corner >> 1), Texture->Height - 1);
+				u8 *Pixel = Texture->Memory + Y0 * Texture->Pitch + X * BITMAP_BYTES_PER_PIXEL;
+				
+				float Luma = Offsets[0] + Y[0] * Pixel[0] + Y[1] * Pixel[1] + Y[2] * Pixel[2];
+				u8 Got = Image->Planes[0][(Row + (Corner >> 1)) * Image->Pitches[0] + Column + (Corner & 1)];
+				int Difference = Got - RoundYUVReference(Luma);
+				Difference = (Difference < 0) ? -Difference : Difference;
+				MaxDifference = Max(MaxDifference, Difference);
+				*OffCount += (Difference != 0);
+				
+				for (int Channel = 0; Channel < 3; ++Channel)
+				{
+					Sums[Channel] += (float)Pixel[Channel] * 0.25f;
+				}
+				Grey &= (Pixel[0] == Pixel[1]) && (Pixel[1] == Pixel[2]);
+			}
+			
+			int ChromaIndex = (Row / 2) * Image->Pitches[1] + (Column / 2) * ChromaStep;
+			u8 GotU = Image->Planes[1][ChromaIndex];
+			u8 GotV = Image->Planes[2][ChromaIndex];
+			for (int Plane = 0; Plane < 2; ++Plane)
+			{
+				float *Weights = Plane ? V : U;
+				float Chroma = Offsets[1] + Weights[0] * Sums[0] + Weights[1] * Sums[1] + Weights[2] * Sums[2];
+				int Difference = (Plane ? GotV : GotU) - RoundYUVReference(Chroma);
+				Difference = (Difference < 0) ? -Difference : Difference;
+				MaxDifference = Max(MaxDifference, Difference);
+				*OffCount += (Difference != 0);
+			}
+			
+			*GreyMisses += Grey && ((GotU != 128) || (GotV != 128));
+		}
+	}
+	
+	return MaxDifference;
+}
+
+// @Note Random pixels, with every grey as a band of 2x2 blocks across the top and a few flat colours below it
+internal void DrawYUVCheckTexture(bitmap *Texture, u32 *Series)
+{
+	for (int Row = 0; Row < Texture->Height; ++Row)
+	{
+		u32 *Pixels = (u32 *)(Texture->Memory + Row * Texture->Pitch);
+		for (int Column = 0; Column < Texture->Width; ++Column)
+		{
+			u32 Pixel = NextRandom(Series);
+			if (Row < 2)
+			{
+				u32 Grey = (u32)(Column / 2) & 0xFF;
+				Pixel = (Pixel & 0xFF000000) | (Grey << 16) | (Grey << 8) | Grey;
+			}
+			else if (Row < 32)
+			{
+				u32 Flats[] = { 0xFF000000, 0xFFFFFFFF, 0xFFFF0000, 0xFF00FF00, 0xFF0000FF, 0xFFFFFF00, 0xFF00FFFF, 0xFFFF00FF };
+				Pixel = Flats[(Column / 64) % GetArrayCount(Flats)];
+			}
+			Pixels[Column] = Pixel;
+		}
+	}
+}
+
+internal bool BenchmarkYUV()
+{
+	size_t CheckSize = (size_t)YUV_BENCH_CHECK_WIDTH * YUV_BENCH_CHECK_HEIGHT * BITMAP_BYTES_PER_PIXEL;
+	size_t FrameSize = (size_t)YUV_BENCH_WIDTH * YUV_BENCH_HEIGHT * BITMAP_BYTES_PER_PIXEL;
+	bitmap Check = { (u8 *)LinuxAllocateMemory(CheckSize), YUV_BENCH_CHECK_WIDTH, YUV_BENCH_CHECK_HEIGHT, YUV_BENCH_CHECK_WIDTH * BITMAP_BYTES_PER_PIXEL };
+	bitmap Frame = { (u8 *)LinuxAllocateMemory(FrameSize), YUV_BENCH_WIDTH, YUV_BENCH_HEIGHT, YUV_BENCH_WIDTH * BITMAP_BYTES_PER_PIXEL };
+	if (!Check.Memory || !Frame.Memory)
+	{
+		Error("YUV benchmark memory");
+	}
+	
+	u32 Series = 0x5EED1234;
+	DrawYUVCheckTexture(&Check, &Series);
+	DrawYUVCheckTexture(&Frame, &Series);
+	
+	bool AllGood = true;
+	
+	// @Note Every layout, matrix and range. The scalar one within a code of the float matrix and grey without colour,
+	// the other kernels the same as it to the byte.
+	box CheckBox = { 0, 0, Check.Width, Check.Height };
+	for (int FormatIndex = 0; FormatIndex < YUVLayout_Count * YUVMatrix_Count * YUVRange_Count; ++FormatIndex)
+	{
+		yuv_format Format;
+		Format.Layout = (yuv_layout)(FormatIndex % YUVLayout_Count);
+		Format.Matrix = (yuv_matrix)((FormatIndex / YUVLayout_Count) % YUVMatrix_Count);
+		Format.Range  = (yuv_range)(FormatIndex / (YUVLayout_Count * YUVMatrix_Count));
+		
+		yuv_converter Reference;
+		InitializeYUVConverter(&Reference, LinuxAllocateMemory, LinuxFreeMemory, Format, ShadeKernel_Scalar);
+		ConvertToYUV(&Reference, &Check, &CheckBox, 1, NULL);
+		
+		u64 OffCount = 0;
+		u64 GreyMisses = 0;
+		int MaxDifference = CheckYUVReference(&Check, &Reference.Image, &OffCount, &GreyMisses);
+		bool Good = (MaxDifference <= 1) && (GreyMisses == 0);
+		
+		char KernelResults[128] = "";
+		for (int Kernel = ShadeKernel_Scalar + 1; Kernel < ShadeKernel_Count; ++Kernel)
+		{
+			if (!GetYUVRows((shade_kernel)Kernel))
+			{
+				continue;
+			}
+			
+			yuv_converter Converter;
+			InitializeYUVConverter(&Converter, LinuxAllocateMemory, LinuxFreeMemory, Format, (shade_kernel)Kernel);
+			ConvertToYUV(&Converter, &Check, &CheckBox, 1, NULL);
+			
+			bool Same = (memcmp(Converter.Image.Memory, Reference.Image.Memory, Reference.Image.Size) == 0);
+			Good &= Same;
+			
+			size_t Length = strlen(KernelResults);
+			snprintf(KernelResults + Length, sizeof(KernelResults) - Length, ", %s %s", ShadeKernelNames[Kernel], Same ? "same" : "DIFFERENT");
+			FreeYUVConverter(&Converter);
+		}
+		
+		printf("yuv %s %s %-7s max diff %d from the float matrix, %.2f%% one off, %llu grey blocks with colour%s%s\n",
+			   YUVLayoutNames[Format.Layout], YUVMatrixNames[Format.Matrix], YUVRangeNames[Format.Range], MaxDifference,
+			   100.0 * OffCount / ((double)Check.Width * Check.Height * 1.5), (unsigned long long)GreyMisses, KernelResults,
+			   Good ? "" : " MISMATCH");
+		
+		AllGood &= Good;
+		FreeYUVConverter(&Reference);
+	}
+	
+	// @Note A whole 1080p frame over and over, every tile converted every time
+	box FrameBox = { 0, 0, Frame.Width, Frame.Height };
+	int Repeats = YUV_BENCH_PIXELS / (YUV_BENCH_WIDTH * YUV_BENCH_HEIGHT);
+	double WholeTime = 0.0;
+	for (int Layout = 0; Layout < YUVLayout_Count; ++Layout)
+	{
+		yuv_format Format = { (yuv_layout)Layout, YUVMatrix_BT709, YUVRange_Limited };
+		
+		u64 ScalarElapsed = 0;
+		for (int Kernel = 0; Kernel < ShadeKernel_Count; ++Kernel)
+		{
+			if (!GetYUVRows((shade_kernel)Kernel))
+			{
+				continue;
+			}
+			
+			yuv_converter Converter;
+			InitializeYUVConverter(&Converter, LinuxAllocateMemory, LinuxFreeMemory, Format, (shade_kernel)Kernel);
+			ConvertToYUV(&Converter, &Frame, &FrameBox, 1, NULL);
+			
+			u64 StartTime = GetNanoseconds();
+			for (int Repeat = 0; Repeat < Repeats; ++Repeat)
+			{
+				ConvertToYUV(&Converter, &Frame, &FrameBox, 1, NULL);
+			}
+			u64 Elapsed = GetNanoseconds() - StartTime;
+			if (Kernel == ShadeKernel_Scalar)
+			{
+				ScalarElapsed = Elapsed;
+			}
+			
+			if ((Layout == YUVLayout_NV12) && (Kernel == GetBestShadeKernel()))
+			{
+				WholeTime = (double)Elapsed / Repeats / 1000.0;
+			}
+			
+			printf("yuv %s 1920x1080 %-6s %8.1f Mpixel/s, %6.2fx scalar, %7.2fus a frame\n", YUVLayoutNames[Layout], ShadeKernelNames[Kernel],
+				   (double)YUV_BENCH_WIDTH * YUV_BENCH_HEIGHT * Repeats * 1000.0 / (double)Elapsed, (double)ScalarElapsed / (double)Elapsed,
+				   (double)Elapsed / Repeats / 1000.0);
+			FreeYUVConverter(&Converter);
+		}
+	}
+	
+	// @Note A rectangle moving about the frame, the change detector hashing what the crop would have and the conversion
+	// taking only the tiles it says changed. At the end the image has to be what converting the whole frame gives.
+	change_detector Detector;
+	InitializeChangeDetector(&Detector, LinuxAllocateMemory, LinuxFreeMemory, GetBestShadeKernel());
+	ResizeChangeDetector(&Detector, Frame.Width, Frame.Height);
+	DetectChanges(&Detector, &Frame, FrameBox);
+	
+	yuv_format Format = { YUVLayout_NV12, YUVMatrix_BT709, YUVRange_Limited };
+	yuv_converter Converter;
+	InitializeYUVConverter(&Converter, LinuxAllocateMemory, LinuxFreeMemory, Format, GetBestShadeKernel());
+	ConvertToYUV(&Converter, &Frame, &FrameBox, 1, &Detector);
+	
+	u64 TilesBefore = Converter.ConvertedTileCount;
+	u64 ConvertElapsed = 0;
+	for (int FrameIndex = 0; FrameIndex < YUV_BENCH_FRAMES; ++FrameIndex)
+	{
+		int Left = RandomBetween(&Series, 0, YUV_BENCH_WIDTH  - YUV_BENCH_MOVER_WIDTH);
+		int Top  = RandomBetween(&Series, 0, YUV_BENCH_HEIGHT - YUV_BENCH_MOVER_HEIGHT);
+		for (int Row = Top; Row < Top + YUV_BENCH_MOVER_HEIGHT; ++Row)
+		{
+			u32 *Pixels = (u32 *)(Frame.Memory + Row * Frame.Pitch) + Left;
+			for (int Column = 0; Column < YUV_BENCH_MOVER_WIDTH; ++Column)
+			{
+				Pixels[Column] = NextRandom(&Series);
+			}
+		}
+		
+		ClearChangedTiles(&Detector);
+		box Moved = { Left, Top, Left + YUV_BENCH_MOVER_WIDTH, Top + YUV_BENCH_MOVER_HEIGHT };
+		DetectChanges(&Detector, &Frame, Moved);
+		
+		u64 StartTime = GetNanoseconds();
+		ConvertToYUV(&Converter, &Frame, &FrameBox, 1, &Detector);
+		ConvertElapsed += GetNanoseconds() - StartTime;
+	}
+	
+	yuv_converter Whole;
+	InitializeYUVConverter(&Whole, LinuxAllocateMemory, LinuxFreeMemory, Format, ShadeKernel_Scalar);
+	ConvertToYUV(&Whole, &Frame, &FrameBox, 1, NULL);
+	bool Same = (memcmp(Whole.Image.Memory, Converter.Image.Memory, Whole.Image.Size) == 0);
+	AllGood &= Same;
+	
+	u32 TileCount = Detector.TilesAcross * Detector.TilesDown;
+	double ChangedTime = (double)ConvertElapsed / YUV_BENCH_FRAMES / 1000.0;
+	printf("yuv nv12 1920x1080 %dx%d mover, %.1f%% of the tiles converted a frame, %.2fus a frame, %.2fx whole, %s a whole conversion%s\n",
+		   YUV_BENCH_MOVER_WIDTH, YUV_BENCH_MOVER_HEIGHT, 100.0 * (Converter.ConvertedTileCount - TilesBefore) / YUV_BENCH_FRAMES / TileCount,
+		   ChangedTime, WholeTime / ChangedTime, Same ? "same as" : "NOT", Same ? "" : " MISMATCH");
+	
+	FreeYUVConverter(&Whole);
+	FreeYUVConverter(&Converter);
+	FreeChangeDetector(&Detector);
+	LinuxFreeMemory(Check.Memory, CheckSize);
+	LinuxFreeMemory(Frame.Memory, FrameSize);
+	
+	return AllGood;
+}
+
+//
+// Effects: every key's specialized row against the one that tests the key per pixel and against the scalar one, and
+// what the key costs over the plain shade
+//
+
+#define EFFECTS_BENCH_PIXELS 3000000 // Destination pixels per row, key and trial
+#define EFFECTS_BENCH_TRIALS 5       // Taking turns, the fastest of each row counts so a busy moment doesn't
+#define EFFECTS_BENCH_BLOCK  16
+
+// @Note "none" or the names of the effects joined with +
+internal void GetEffectKeyName(u32 Key, char *Name, size_t NameSize)
+{
+	Name[0] = 0;
+	for (u32 Effect = 0; Effect < GetArrayCount(EffectNames); ++Effect)
+	{
+		if (Key & (1 << Effect))
+		{
+			size_t Used = strlen(Name);
+			snprintf(Name + Used, NameSize - Used, "%s%s", Used ? "+" : "", EffectNames[Effect]);
+		}
+	}
+	
+	if (Name[0] == 0)
+	{
+		snprintf(Name, NameSize, "none");
+	}
+}
+
+// @Note Pixels of Rect the colour key took out, the only ones with no alpha
+internal u64 GetKeyedPixelCount(bitmap *Target, box Rect)
+{
+	u64 KeyedCount = 0;
+	for (int Y = Rect.Top; Y < Rect.Bottom; ++Y)
+	{
+		u32 *Row = (u32 *)(Target->Memory + Y * Target->Pitch);
+		for (int X = Rect.Left; X < Rect.Right; ++X)
+		{
+			KeyedCount += ((Row[X] >> 24) == 0);
+		}
+	}
+	
+	return KeyedCount;
+}
+
+internal bool BenchmarkEffects()
+{
+	shade_case Cases[] =
+	{
+		{ "960x540 -> 1920x1080",   960, 540, 1920, 1080, false },
+		{ "641x479 -> 479x641 rot", 641, 479, 479,  641,  true  },
+	};
+	
+	int TextureSide = 1024;
+	int TargetSide  = 2048;
+	size_t TextureSize = (size_t)TextureSide * TextureSide * BITMAP_BYTES_PER_PIXEL;
+	size_t TargetSize  = (size_t)TargetSide  * TargetSide  * BITMAP_BYTES_PER_PIXEL;
+	
+	bitmap Texture   = { (u8 *)LinuxAllocateMemory(TextureSize), TextureSide, TextureSide, TextureSide * BITMAP_BYTES_PER_PIXEL };
+	bitmap Reference = { (u8 *)LinuxAllocateMemory(TargetSize),  TargetSide,  TargetSide,  TargetSide  * BITMAP_BYTES_PER_PIXEL };
+	bitmap Target    = { (u8 *)LinuxAllocateMemory(TargetSize),  TargetSide,  TargetSide,  TargetSide  * BITMAP_BYTES_PER_PIXEL };
+	if (!Texture.Memory || !Reference.Memory || !Target.Memory)
+	{
+		Error("Effects benchmark memory");
+	}
+	
+	// @Note Blocks of black for the key, flat colours and noise, so every stage has something to do
+	u32 Series = 0x2468ACE1;
+	for (int BlockY = 0; BlockY < TextureSide; BlockY += EFFECTS_BENCH_BLOCK)
+	{
+		for (int BlockX = 0; BlockX < TextureSide; BlockX += EFFECTS_BENCH_BLOCK)
+		{
+			u32 Kind   = NextRandom(&Series) % 3;
+			u32 Colour = NextRandom(&Series);
+			for (int Y = BlockY; Y < BlockY + EFFECTS_BENCH_BLOCK; ++Y)
+			{
+				u32 *Row = (u32 *)(Texture.Memory + Y * Texture.Pitch);
+				for (int X = BlockX; X < BlockX + EFFECTS_BENCH_BLOCK; ++X)
+				{
+					Row[X] = ((Kind == 0) ? 0 : ((Kind == 1) ? Colour : NextRandom(&Series))) | 0xFF000000;
+				}
+			}
+		}
+	}
+	
+	// @Note Fully opaque so the effects aren't lost in the rounding of a faint overlay
+	box Output = { 0, 0, 1920, 1080 };
+	render_state Defaults = DefaultRenderState(&Output, 1, 400, 300);
+	shade_params Shade = Defaults.Shade;
+	Shade.Alpha = 1.0f;
+	
+	bool AllGood = true;
+	for (u32 CaseIndex = 0; CaseIndex < GetArrayCount(Cases); ++CaseIndex)
+	{
+		shade_case *Case = &Cases[CaseIndex];
+		bool IsTimed = (CaseIndex == 0);
+		
+		box CropSlot = { 3, 5, 3 + Case->CutWidth, 5 + Case->CutHeight };
+		
+		uv_transform UV;
+		UV.Origin = v2{ 0.0f, 0.0f };
+		UV.AxisX  = v2{ 1.0f, 0.0f };
+		UV.AxisY  = v2{ 0.0f, 1.0f };
+		if (Case->Rotated)
+		{
+			UV.Origin = v2{ 1.0f, 0.0f };
+			UV.AxisX  = v2{ 0.0f, 1.0f };
+			UV.AxisY  = v2{ -1.0f, 0.0f };
+		}
+		
+		v2 DestinationMin = { 1.25f, 2.5f };
+		v2 DestinationMax = { 1.25f + (float)Case->DisplayWidth, 2.5f + (float)Case->DisplayHeight };
+		box Drawn = { 1, 2, 1 + Case->DisplayWidth, 2 + Case->DisplayHeight };
+		u64 PixelCount = (u64)Case->DisplayWidth * Case->DisplayHeight;
+		int Repeats = IsTimed ? (int)Max(EFFECTS_BENCH_PIXELS / PixelCount, (u64)1) : 1;
+		
+		for (int Kernel = 0; Kernel < ShadeKernel_Count; ++Kernel)
+		{
+			// @Note NEON has no effect rows, SetShadeRows gives it the scalar one
+			shade_row_function *PlainRow = GetShadeRow((shade_kernel)Kernel);
+			shade_row_function *BranchingRow = GetBranchingEffectRow((shade_kernel)Kernel);
+			if (!PlainRow || !BranchingRow)
+			{
+				continue;
+			}
+			
+			double SpeedupSum = 0.0;
+			double CostSum = 0.0;
+			for (u32 Key = 0; Key < EffectKey_Count; ++Key)
+			{
+				Shade.Effects.Key = Key;
+				
+				// @Note Key 0 has the plain row in GetEffectRow, the reference is the template's so the two get compared
+				FillBox(&Reference, box{ 0, 0, TargetSide, TargetSide }, 0);
+				ShadePiece(&Reference, DestinationMin, DestinationMax, &Texture, CropSlot, UV, Shade, EffectRowsScalar[Key]);
+				
+				shade_row_function *Rows[3] = { GetEffectRow((shade_kernel)Kernel, Key), BranchingRow, PlainRow };
+				u64 Elapsed[3] = { ~0ull, ~0ull, ~0ull };
+				int MaxDifference = 0;
+				for (int Trial = 0; Trial < (IsTimed ? EFFECTS_BENCH_TRIALS : 1); ++Trial)
+				{
+					for (int RowIndex = 0; RowIndex < (IsTimed ? 3 : 2); ++RowIndex)
+					{
+						FillBox(&Target, box{ 0, 0, TargetSide, TargetSide }, 0);
+						
+						u64 StartTime = GetNanoseconds();
+						for (int Repeat = 0; Repeat < Repeats; ++Repeat)
+						{
+							ShadePiece(&Target, DestinationMin, DestinationMax, &Texture, CropSlot, UV, Shade, Rows[RowIndex]);
+						}
+						u64 TrialElapsed = GetNanoseconds() - StartTime;
+						Elapsed[RowIndex] = Min(Elapsed[RowIndex], TrialElapsed);
+						
+						// @Note Bit exact on x86, one off allowed for the fused multiply-adds on ARM. The plain row is only timed.
+						if (RowIndex < 2)
+						{
+							int Difference = GetMaxDifference(&Reference, &Target, Drawn.Right + 1, Drawn.Bottom + 1);
+							MaxDifference = Max(MaxDifference, Difference);
+						}
+					}
+				}
+				
+				// @Note Black is a third of the texture, the key has to take some of it out and nothing else does
+				u64 KeyedCount = GetKeyedPixelCount(&Reference, Drawn);
+				bool Keyed = (Key & Effect_ColourKey) ? (KeyedCount > PixelCount / 10) : (KeyedCount == 0);
+				bool Matches = (MaxDifference <= 1);
+				AllGood &= Matches && Keyed;
+				
+				double Speedup = (double)Elapsed[1] / (double)Elapsed[0];
+				double Cost = (double)Elapsed[0] / (double)Elapsed[2];
+				SpeedupSum += Speedup;
+				CostSum += Cost;
+				
+				char KeyName[64];
+				GetEffectKeyName(Key, KeyName, sizeof(KeyName));
+				if (IsTimed)
+				{
+					double Repeated = (double)PixelCount * Repeats * 1000.0;
+					printf("effects %-24s %-6s %-29s %7.1f Mpixel/s, branching %7.1f, %5.2fx, plain %7.1f, %5.2fx the time, %4.1f%% keyed, max diff %d%s\n",
+						   Case->Name, ShadeKernelNames[Kernel], KeyName, Repeated / (double)Elapsed[0], Repeated / (double)Elapsed[1], Speedup,
+						   Repeated / (double)Elapsed[2], Cost, 100.0 * KeyedCount / (double)PixelCount, MaxDifference,
+						   (Matches && Keyed) ? "" : " MISMATCH");
+				}
+				else if (!Matches || !Keyed)
+				{
+					printf("effects %-24s %-6s %-29s max diff %d, %4.1f%% keyed MISMATCH\n", Case->Name, ShadeKernelNames[Kernel], KeyName,
+						   MaxDifference, 100.0 * KeyedCount / (double)PixelCount);
+				}
+			}
+			
+			if (IsTimed)
+			{
+				printf("effects %-24s %-6s specialized rows %.2fx the branching one and %.2fx the time of the plain shade on average\n",
+					   Case->Name, ShadeKernelNames[Kernel], SpeedupSum / EffectKey_Count, CostSum / EffectKey_Count);
+			}
+		}
+		
+		if (!IsTimed)
+		{
+			printf("effects %-24s every kernel and key checked against scalar\n", Case->Name);
+		}
+	}
+	
+	LinuxFreeMemory(Texture.Memory, TextureSize);
+	LinuxFreeMemory(Reference.Memory, TargetSize);
+	LinuxFreeMemory(Target.Memory, TargetSize);
+	
+	return AllGood;
+}
+
+//
+// Damage: scripted dirty and move rect streams through a mock duplication source, the crop damage checked
+// against a full diff of every cut box
+//
+
+#define DAMAGE_BENCH_WIDTH  1920
+#define DAMAGE_BENCH_HEIGHT 1080
+#define DAMAGE_BENCH_FRAMES 300
+#define DAMAGE_BENCH_CUTS   4
+
+// @Note The patterns a duplication reports: a few glyphs and a caret, a scrolled window as one move and the strip
+// it uncovers, a dragged window as a move and the strips left behind, a video, and DWM's overlapping reports where
+// the small rects come before the one that holds them all. Every few frames only the mouse moves or the metadata is gone.
+enum damage_stream
+{
+	DamageStream_Typing,
+	DamageStream_Scrolling,
+	DamageStream_Dragging,
+	DamageStream_Video,
+	DamageStream_Overlapping,
+	
+	DamageStream_Count,
+};
+
+global const char *DamageStreamNames[DamageStream_Count] = { "typing", "scrolling", "dragging", "video", "overlapping" };
+
+struct damage_source
+{
+	bitmap Desktop;
+	bitmap Scratch;
+	u32 Series;
+	int FrameIndex;
+	box Window;
+	
+	move_rect MoveRects[1];
+	box DirtyRects[8];
+};
+
+inline void PaintDamageBox(damage_source *Source, box Box)
+{
+	u32 Colour = NextRandom(&Source->Series);
+	for (int Y = Box.Top; Y < Box.Bottom; ++Y)
+	{
+		u32 *Row = (u32 *)(Source->Desktop.Memory + (size_t)Y * Source->Desktop.Pitch);
+		for (int X = Box.Left; X < Box.Right; ++X)
+		{
+			Row[X] = Colour ^ (u32)(X * 31 + Y * 17);
+		}
+	}
+}
+
+// @Note Same order as DXGI: the moves take from the image as it was, then the dirty rects are drawn over it
+internal void MoveDamageBox(damage_source *Source, move_rect Move)
+{
+	box Destination = Move.Destination;
+	box From = { Move.SourceX, Move.SourceY, Move.SourceX + GetBoxWidth(Destination), Move.SourceY + GetBoxHeight(Destination) };
+	
+	CopyBitmapBox(&Source->Scratch, &Source->Desktop, From);
+	for (int Y = 0; Y < GetBoxHeight(Destination); ++Y)
+	{
+		memcpy(Source->Desktop.Memory + (size_t)(Destination.Top + Y) * Source->Desktop.Pitch + Destination.Left * BITMAP_BYTES_PER_PIXEL,
+			   Source->Scratch.Memory + (size_t)(From.Top + Y) * Source->Scratch.Pitch + From.Left * BITMAP_BYTES_PER_PIXEL,
+			   (size_t)GetBoxWidth(Destination) * BITMAP_BYTES_PER_PIXEL);
+	}
+}
+
+internal void AcquireDamageFrame(damage_source *Source, damage_stream Stream, captured_frame *Frame)
+{
+	int FrameIndex = Source->FrameIndex++;
+	
+	*Frame = {};
+	Frame->Surface         = &Source->Desktop;
+	Frame->Format          = SurfaceFormat_BGRA8;
+	Frame->Rotation        = DisplayRotation_Identity;
+	Frame->DesktopWidth    = DAMAGE_BENCH_WIDTH;
+	Frame->DesktopHeight   = DAMAGE_BENCH_HEIGHT;
+	Frame->LastPresentTime = FrameIndex + 1;
+	Frame->MetadataIsValid = true;
+	Frame->MoveRects       = Source->MoveRects;
+	Frame->DirtyRects      = Source->DirtyRects;
+	
+	if ((FrameIndex % 13) == 12)
+	{
+		Frame->LastPresentTime = 0;
+		return;
+	}
+	
+	box Window = Source->Window;
+	switch (Stream)
+	{
+		case DamageStream_Typing:
+		{
+			// @Note A line of glyphs across the window, then the next line down
+			int Column = FrameIndex % 80;
+			int Line   = (FrameIndex / 80) % 40;
+			box Glyph = { Window.Left + 8 + Column * 9, Window.Top + 8 + Line * 16, Window.Left + 17 + Column * 9, Window.Top + 24 + Line * 16 };
+			box Caret = { Glyph.Right, Glyph.Top, Glyph.Right + 2, Glyph.Bottom };
+			
+			Source->DirtyRects[Frame->DirtyRectCount++] = Glyph;
+			Source->DirtyRects[Frame->DirtyRectCount++] = Caret;
+		} break;
+		
+		case DamageStream_Scrolling:
+		{
+			int Step = RandomBetween(&Source->Series, 8, 48);
+			move_rect Move;
+			Move.SourceX     = Window.Left;
+			Move.SourceY     = Window.Top + Step;
+			Move.Destination = box{ Window.Left, Window.Top, Window.Right, Window.Bottom - Step };
+			
+			Source->MoveRects[Frame->MoveRectCount++]   = Move;
+			Source->DirtyRects[Frame->DirtyRectCount++] = box{ Window.Left, Window.Bottom - Step, Window.Right, Window.Bottom };
+		} break;
+		
+		case DamageStream_Dragging:
+		{
+			// @Note Bounces around the desktop, what it leaves behind is the wallpaper drawn again
+			int DeltaX = ((FrameIndex / 60) & 1) ? -RandomBetween(&Source->Series, 1, 12) : RandomBetween(&Source->Series, 1, 12);
+			int DeltaY = ((FrameIndex / 45) & 1) ? -RandomBetween(&Source->Series, 0, 8)  : RandomBetween(&Source->Series, 0, 8);
+			DeltaX = Max(-Window.Left, Min(DAMAGE_BENCH_WIDTH  - Window.Right,  DeltaX));
+			DeltaY = Max(-Window.Top,  Min(DAMAGE_BENCH_HEIGHT - Window.Bottom, DeltaY));
+			box Moved = { Window.Left + DeltaX, Window.Top + DeltaY, Window.Right + DeltaX, Window.Bottom + DeltaY };
+			
+			move_rect Move;
+			Move.SourceX     = Window.Left;
+			Move.SourceY     = Window.Top;
+			Move.Destination = Moved;
+			Source->MoveRects[Frame->MoveRectCount++] = Move;
+			
+			box Uncovered[2] =
+			{
+				(DeltaX > 0) ? box{ Window.Left, Window.Top, Moved.Left, Window.Bottom } : box{ Moved.Right, Window.Top, Window.Right, Window.Bottom },
+				(DeltaY > 0) ? box{ Window.Left, Window.Top, Window.Right, Moved.Top }   : box{ Window.Left, Moved.Bottom, Window.Right, Window.Bottom },
+			};
+			
+			for (u32 Index = 0; Index < GetArrayCount(Uncovered); ++Index)
+			{
+				if (!BoxIsEmpty(Uncovered[Index]))
+				{
+					Source->DirtyRects[Frame->DirtyRectCount++] = Uncovered[Index];
+				}
+			}
+			
+			Source->Window = Moved;
+		} break;
+		
+		case DamageStream_Video:
+		{
+			Frame->MetadataIsValid = ((FrameIndex % 50) != 49);
+			Source->DirtyRects[Frame->DirtyRectCount++] = box{ Window.Left, Window.Top, Window.Left + 640, Window.Top + 360 };
+		} break;
+		
+		case DamageStream_Overlapping:
+		{
+			// @Note A toolbar and some of its buttons, reported again as a whole once they are all there
+			box Toolbar = { Window.Left, Window.Top, Window.Right, Window.Top + 40 };
+			int ButtonCount = RandomBetween(&Source->Series, 2, 6);
+			for (int Button = 0; Button < ButtonCount; ++Button)
+			{
+				int Left = Toolbar.Left + RandomBetween(&Source->Series, 0, GetBoxWidth(Toolbar) - 32);
+				Source->DirtyRects[Frame->DirtyRectCount++] = box{ Left, Toolbar.Top + 4, Left + 32, Toolbar.Bottom - 4 };
+			}
+			
+			Source->DirtyRects[Frame->DirtyRectCount++] = Toolbar;
+			Source->DirtyRects[Frame->DirtyRectCount++] = box{ Toolbar.Left + 100, Toolbar.Top + 4, Toolbar.Left + 132, Toolbar.Bottom - 4 };
+		} break;
+		
+		default: break;
+	}
+	
+	for (u32 MoveIndex = 0; MoveIndex < Frame->MoveRectCount; ++MoveIndex)
+	{
+		MoveDamageBox(Source, Source->MoveRects[MoveIndex]);
+	}
+	
+	for (u32 DirtyIndex = 0; DirtyIndex < Frame->DirtyRectCount; ++DirtyIndex)
+	{
+		PaintDamageBox(Source, Source->DirtyRects[DirtyIndex]);
+	}
+	
+	// @Note Without the metadata the whole desktop may have changed, some of it does
+	if (!Frame->MetadataIsValid)
+	{
+		PaintDamageBox(Source, box{ 0, 0, DAMAGE_BENCH_WIDTH / 2, DAMAGE_BENCH_HEIGHT / 3 });
+	}
+}
+
+// @Note Pixels of Box that aren't the same in A and B
+internal u64 GetChangedPixelCount(bitmap *A, bitmap *B, box Box)
+{
+	u64 ChangedCount = 0;
+	for (int Y = Box.Top; Y < Box.Bottom; ++Y)
+	{
+		u32 *RowA = (u32 *)(A->Memory + (size_t)Y * A->Pitch);
+		u32 *RowB = (u32 *)(B->Memory + (size_t)Y * B->Pitch);
+		for (int X = Box.Left; X < Box.Right; ++X)
+		{
+			ChangedCount += (RowA[X] != RowB[X]) ? 1 : 0;
+		}
+	}
+	
+	return ChangedCount;
+}
+
+// @Note Every region inside the cut box and not empty, none holding another one
+internal bool DamageIsWellFormed(crop_damage *Damage, box CutBox)
+{
+	for (u32 RegionIndex = 0; RegionIndex < Damage->RegionCount; ++RegionIndex)
+	{
+		box Region = Damage->Regions[RegionIndex];
+		if (BoxIsEmpty(Region) || !BoxContains(CutBox, Region))
+		{
+			return false;
+		}
+		
+		for (u32 OtherIndex = 0; OtherIndex < Damage->RegionCount; ++OtherIndex)
+		{
+			if ((OtherIndex != RegionIndex) && BoxContains(Damage->Regions[OtherIndex], Region))
+			{
+				return false;
+			}
+		}
+	}
+	
+	return true;
+}
+
+internal bool BenchmarkDamage()
+{
+	size_t MemorySize = (size_t)(2 + DAMAGE_BENCH_CUTS) * DAMAGE_BENCH_WIDTH * DAMAGE_BENCH_HEIGHT * BITMAP_BYTES_PER_PIXEL + Megabytes(1);
+	memory_arena Arena;
+	InitializeArena(&Arena, LinuxAllocateMemory(MemorySize), MemorySize);
+	
+	damage_source *Source = PushStruct(&Arena, damage_source);
+	Source->Desktop = PushBitmap(&Arena, DAMAGE_BENCH_WIDTH, DAMAGE_BENCH_HEIGHT);
+	Source->Scratch = PushBitmap(&Arena, DAMAGE_BENCH_WIDTH, DAMAGE_BENCH_HEIGHT);
+	
+	// @Note What each cut box's crop holds when only its damage gets copied, the desktop is the full diff against it
+	bitmap Kept[DAMAGE_BENCH_CUTS];
+	for (int CutIndex = 0; CutIndex < DAMAGE_BENCH_CUTS; ++CutIndex)
+	{
+		Kept[CutIndex] = PushBitmap(&Arena, DAMAGE_BENCH_WIDTH, DAMAGE_BENCH_HEIGHT);
+	}
+	
+	// @Note Over the window, across its edge, somewhere nothing happens, and the whole desktop
+	box CutBoxes[DAMAGE_BENCH_CUTS] =
+	{
+		{ 400, 200, 1000, 700 },
+		{ 150, 100, 500, 400 },
+		{ 1500, 800, 1900, 1060 },
+		{ 0, 0, DAMAGE_BENCH_WIDTH, DAMAGE_BENCH_HEIGHT },
+	};
+	
+	bool AllGood = true;
+	for (int Stream = 0; Stream < DamageStream_Count; ++Stream)
+	{
+		Source->Series     = 0x12345678 + Stream;
+		Source->FrameIndex = 0;
+		Source->Window     = box{ 300, 150, 1100, 800 };
+		PaintDamageBox(Source, box{ 0, 0, DAMAGE_BENCH_WIDTH, DAMAGE_BENCH_HEIGHT });
+		
+		for (int CutIndex = 0; CutIndex < DAMAGE_BENCH_CUTS; ++CutIndex)
+		{
+			CopyBitmapBox(&Kept[CutIndex], &Source->Desktop, CutBoxes[CutIndex]);
+		}
+		
+		u64 ChangedArea  = 0;
+		u64 DamageArea   = 0;
+		u64 RegionCount  = 0;
+		u64 MissedPixels = 0;
+		u32 BadFrames    = 0;
+		u64 ComputeTime  = 0;
+		
+		for (int FrameIndex = 0; FrameIndex < DAMAGE_BENCH_FRAMES; ++FrameIndex)
+		{
+			captured_frame Frame;
+			AcquireDamageFrame(Source, (damage_stream)Stream, &Frame);
+			
+			for (int CutIndex = 0; CutIndex < DAMAGE_BENCH_CUTS; ++CutIndex)
+			{
+				box CutBox = CutBoxes[CutIndex];
+				bitmap *Crop = &Kept[CutIndex];
+				
+				u64 StartTime = GetNanoseconds();
+				crop_damage Damage;
+				ComputeCropDamage(&Frame, CutBox, &Damage);
+				ComputeTime += GetNanoseconds() - StartTime;
+				
+				ChangedArea += GetChangedPixelCount(Crop, &Source->Desktop, CutBox);
+				DamageArea  += GetDamageArea(&Damage);
+				RegionCount += Damage.RegionCount;
+				
+				for (u32 RegionIndex = 0; RegionIndex < Damage.RegionCount; ++RegionIndex)
+				{
+					CopyBitmapBox(Crop, &Source->Desktop, Damage.Regions[RegionIndex]);
+				}
+				
+				// @Note Anything still different changed outside the damage, the crop would show the old pixels
+				u64 Missed = GetChangedPixelCount(Crop, &Source->Desktop, CutBox);
+				bool IsBad = (Missed > 0) || !DamageIsWellFormed(&Damage, CutBox) || ((Frame.LastPresentTime == 0) && Damage.RegionCount);
+				
+				MissedPixels += Missed;
+				BadFrames    += IsBad ? 1 : 0;
+				
+				// @Note So one miss doesn't show up again in every frame after it
+				if (Missed)
+				{
+					CopyBitmapBox(Crop, &Source->Desktop, CutBox);
+				}
+			}
+		}
+		
+		u32 CropCount = DAMAGE_BENCH_FRAMES * DAMAGE_BENCH_CUTS;
+		AllGood &= (BadFrames == 0);
+		
+		printf("damage %-12s %d frames x %d cut boxes, %5.2f regions a crop, copied %6.2fx the changed pixels, %5.1fns a crop, "
+			   "%llu pixels missed, %u bad crops, %s\n", DamageStreamNames[Stream], DAMAGE_BENCH_FRAMES, DAMAGE_BENCH_CUTS,
+			   (double)RegionCount / CropCount, ChangedArea ? (double)DamageArea / ChangedArea : 0.0, (double)ComputeTime / CropCount,
+			   (unsigned long long)MissedPixels, BadFrames, (BadFrames == 0) ? "ok" : "BROKEN");
+	}
+	
+	LinuxFreeMemory(Arena.Base, MemorySize);
+	return AllGood;
+}
+
+//
+// Exchange: the window thread publishing render states as fast as it can against the render thread reading them,
+// every state filled from its version so a read that mixes two of them shows up
+//
+
+#define EXCHANGE_BENCH_TIME 1000000000 // Nanoseconds the writer keeps publishing
+
+#define EXCHANGE_BENCH_WORDS ((sizeof(render_state) - sizeof(int)) / sizeof(u32))
+
+// @Note Every word but the version comes from it, it is written last like the window thread bumps it last
+internal void FillExchangeBenchState(render_state *State, int Version)
+{
+	u32 *Words = (u32 *)State;
+	u32 Series = (u32)Version * 2654435761u + 1;
+	for (size_t WordIndex = 0; WordIndex < EXCHANGE_BENCH_WORDS; ++WordIndex)
+	{
+		Words[WordIndex] = NextRandom(&Series);
+	}
+	
+	State->Version = Version;
+}
+
+internal bool ExchangeBenchStateIsWhole(render_state *State)
+{
+	u32 *Words = (u32 *)State;
+	u32 Series = (u32)State->Version * 2654435761u + 1;
+	for (size_t WordIndex = 0; WordIndex < EXCHANGE_BENCH_WORDS; ++WordIndex)
+	{
+		if (Words[WordIndex] != NextRandom(&Series))
+		{
+			return false;
+		}
+	}
+	
+	return true;
+}
+
+struct exchange_stress
+{
+	render_state_exchange *Exchange;
+	u64 PublishTime;
+	int LastVersion;
+	u32 volatile IsDone;
+};
+
+internal void *ExchangeStressWriter(void *Parameter)
+{
+	exchange_stress *Stress = (exchange_stress *)Parameter;
+	
+	render_state State;
+	u64 StartTime = GetNanoseconds();
+	u64 PublishTime = 0;
+	int Version = 1;
+	for (; (GetNanoseconds() - StartTime) < EXCHANGE_BENCH_TIME; ++Version)
+	{
+		FillExchangeBenchState(&State, Version);
+		
+		u64 PublishStart = GetNanoseconds();
+		PublishRenderState(Stress->Exchange, &State);
+		PublishTime += GetNanoseconds() - PublishStart;
+	}
+	
+	Stress->PublishTime = PublishTime;
+	Stress->LastVersion = Version - 1;
+	AtomicStoreU32(&Stress->IsDone, 1);
+	return NULL;
+}
+
+internal bool BenchmarkExchange()
+{
+	memory_arena Arena;
+	size_t MemorySize = Megabytes(1);
+	InitializeArena(&Arena, LinuxAllocateMemory(MemorySize), MemorySize);
+	
+	exchange_stress *Stress = PushStruct(&Arena, exchange_stress);
+	Stress->Exchange = PushStruct(&Arena, render_state_exchange);
+	Stress->IsDone   = 0;
+	
+	render_state State;
+	FillExchangeBenchState(&State, 0);
+	InitializeRenderStateExchange(Stress->Exchange, &State);
+	
+	pthread_t Thread;
+	if (pthread_create(&Thread, NULL, ExchangeStressWriter, Stress) != 0)
+	{
+		Error("pthread_create");
+	}
+	
+	// @Note A new state has to be newer than the last one, and the same one again when nothing new came
+	int LastVersion = 0;
+	u64 ReadCount  = 0;
+	u64 NewCount   = 0;
+	u64 TornCount  = 0;
+	u64 OutOfOrder = 0;
+	u64 ReadTime   = 0;
+	for (bool WriterIsDone = false; !WriterIsDone; )
+	{
+		WriterIsDone = (AtomicLoadU32(&Stress->IsDone) != 0);
+		
+		u64 ReadStart = GetNanoseconds();
+		bool IsNew = ReadRenderState(Stress->Exchange, &State);
+		ReadTime += GetNanoseconds() - ReadStart;
+		
+		++ReadCount;
+		NewCount   += IsNew ? 1 : 0;
+		TornCount  += ExchangeBenchStateIsWhole(&State) ? 0 : 1;
+		OutOfOrder += (IsNew ? (State.Version <= LastVersion) : (State.Version != LastVersion)) ? 1 : 0;
+		LastVersion = State.Version;
+	}
+	
+	pthread_join(Thread, NULL);
+	
+	// @Note The writer is done, so the last state it published has to be what the reader ends up with
+	ReadRenderState(Stress->Exchange, &State);
+	bool GotLast = (State.Version == Stress->LastVersion) && ExchangeBenchStateIsWhole(&State);
+	
+	// @Note On one core the two only meet where the scheduler cuts one off, there are far fewer handoffs
+	bool AllGood = (TornCount == 0) && (OutOfOrder == 0) && GotLast;
+	printf("exchange %ld cores, %zu byte states, %d published at %.1fns each, %llu reads at %.1fns each, %llu new (%.1f%% of published), "
+		   "%llu torn, %llu out of order, %s the last one, %s\n", sysconf(_SC_NPROCESSORS_ONLN), sizeof(render_state), Stress->LastVersion,
+		   (double)Stress->PublishTime / Stress->LastVersion, (unsigned long long)ReadCount, (double)ReadTime / ReadCount,
+		   (unsigned long long)NewCount, 100.0 * NewCount / Stress->LastVersion, (unsigned long long)TornCount,
+		   (unsigned long long)OutOfOrder, GotLast ? "got" : "MISSED", AllGood ? "ok" : "BROKEN");
+	
+	LinuxFreeMemory(Arena.Base, MemorySize);
+	return AllGood;
+}
+
+//
+// Queue: window thread commands through the render command queue and RunOverlayFrame, on a made-up clock.
+// Every command's state has to reach the screen, in order and within what the wait and the pacing allow.
+//
+
+#define QUEUE_BENCH_COMMANDS 4000000 // Straight through the queue from another thread
+#define QUEUE_BENCH_TIME     60000000 // Microseconds of made-up time per case
+#define QUEUE_BENCH_TIMEOUT  8        // Milliseconds, same slice as the render loop
+#define QUEUE_BENCH_BURST    100      // Commands issued at once now and then, more than the queue holds
+#define QUEUE_BENCH_PRESENT  500      // Microseconds Present takes
+#define QUEUE_BENCH_MAX_ISSUED   16384
+#define QUEUE_BENCH_MAX_PRESENTS 65536
+
+struct queue_stress
+{
+	render_command_queue *Queue;
+	u64 RefusedCount;
+};
+
+// @Note Issue times are just 1, 2, 3... so the other side can tell one went missing or came out of turn
+internal void *QueueStressWriter(void *Parameter)
+{
+	queue_stress *Stress = (queue_stress *)Parameter;
+	
+	for (u64 Sequence = 1; Sequence <= QUEUE_BENCH_COMMANDS; )
+	{
+		render_command Command;
+		Command.Type      = RenderCommand_StateChanged;
+		Command.IssueTime = Sequence;
+		if (PushRenderCommand(Stress->Queue, Command))
+		{
+			++Sequence;
+		}
+		else
+		{
+			++Stress->RefusedCount;
+			sched_yield();
+		}
+	}
+	
+	return NULL;
+}
+
+struct queue_case
+{
+	const char *Name;
+	u64 FrameInterval; // Microseconds between desktop updates, zero for a still desktop
+	u64 SwapInterval;  // Microseconds the swap chain is busy after a present, zero for never
+	pacing_params Pacing;
+};
+
+struct queue_world
+{
+	queue_case *Case;
+	u64 Now; // Microseconds
+	u32 Series;
+	
+	// @Note The window thread, which only gets to run while the render thread is waiting
+	render_state WindowState;
+	render_state_exchange *Exchange;
+	render_command_queue *Commands;
+	u64 NextCommandTime;
+	u64 StopTime;
+	u32 BurstLeft;
+	u32 IssuedCount;
+	u32 RefusedCount;
+	u64 *IssueTimes;
+	int *IssueVersions;
+	
+	// @Note The desktop
+	u64 NextFrameTime;
+	bool IsInvalid;
+	box DirtyRect;
+	
+	// @Note The swap chain and the screen
+	u64 BusyUntil;
+	int ShadedVersion;
+	u32 PresentCount;
+	u64 *PresentTimes;
+	int *PresentVersions;
+};
+
+internal OVERLAY_CLOCK_NOW(QueueBenchNow)
+{
+	queue_world *World = (queue_world *)Context;
+	return World->Now;
+}
+
+// @Note Everything the window thread does up to Until, at the time it does it
+internal void RunQueueWindowThread(queue_world *World, u64 Until)
+{
+	while ((World->NextCommandTime <= Until) && (World->NextCommandTime < World->StopTime) && (World->IssuedCount < QUEUE_BENCH_MAX_ISSUED))
+	{
+		World->Now = Max(World->Now, World->NextCommandTime);
+		
+		// @Note Nudge the cut box like a drag would
+		box *CutBox = &World->WindowState.Overlays[0].CutBox;
+		int Offset = (NextRandom(&World->Series) & 1) ? -1 : 1;
+		CutBox->Left  += Offset;
+		CutBox->Right += Offset;
+		World->WindowState.Version++;
+		PublishRenderState(World->Exchange, &World->WindowState);
+		
+		render_command Command;
+		Command.Type      = RenderCommand_StateChanged;
+		Command.IssueTime = World->Now;
+		if (!PushRenderCommand(World->Commands, Command))
+		{
+			++World->RefusedCount;
+		}
+		
+		World->IssueTimes[World->IssuedCount]    = World->Now;
+		World->IssueVersions[World->IssuedCount] = World->WindowState.Version;
+		++World->IssuedCount;
+		
+		if (World->BurstLeft)
+		{
+			--World->BurstLeft;
+		}
+		else
+		{
+			if ((NextRandom(&World->Series) % 40) == 0)
+			{
+				World->BurstLeft = QUEUE_BENCH_BURST;
+			}
+			
+			World->NextCommandTime += RandomBetween(&World->Series, 1, 100000);
+		}
+	}
+	
+	World->Now = Max(World->Now, Until);
+}
+
+internal FRAME_SOURCE_ACQUIRE(QueueBenchAcquire)
+{
+	queue_world *World = (queue_world *)Context;
+	
+	// @Note A new duplication hands over its whole image right away, like the first one
+	if (!World->IsInvalid)
+	{
+		u64 Deadline = World->Now + (u64)TimeoutMS * 1000;
+		if (!World->Case->FrameInterval || (World->NextFrameTime > Deadline))
+		{
+			RunQueueWindowThread(World, Deadline);
+			return AcquireResult_Timeout;
+		}
+		
+		RunQueueWindowThread(World, World->NextFrameTime);
+	}
+	
+	Frame->Surface           = NULL;
+	Frame->Format            = SurfaceFormat_BGRA8;
+	Frame->WhiteNits         = 80.0f;
+	Frame->OutputIndex       = 0;
+	Frame->SourceWasReset    = World->IsInvalid;
+	Frame->Rotation          = DisplayRotation_Identity;
+	Frame->DesktopWidth      = World->WindowState.Outputs[0].Right;
+	Frame->DesktopHeight     = World->WindowState.Outputs[0].Bottom;
+	Frame->LastPresentTime   = (s64)World->Now;
+	Frame->AccumulatedFrames = 1;
+	Frame->MetadataIsValid   = !World->IsInvalid;
+	Frame->MoveRectCount     = 0;
+	Frame->MoveRects         = NULL;
+	Frame->DirtyRectCount    = 1;
+	Frame->DirtyRects        = &World->DirtyRect;
+	
+	World->IsInvalid = false;
+	if (World->Case->FrameInterval)
+	{
+		World->NextFrameTime = Max(World->NextFrameTime + World->Case->FrameInterval, World->Now);
+	}
+	
+	return AcquireResult_Frame;
+}
+
+internal FRAME_SOURCE_RELEASE(QueueBenchRelease)
+{
+	return true;
+}
+
+internal FRAME_SOURCE_INVALIDATE(QueueBenchInvalidate)
+{
+	queue_world *World = (queue_world *)Context;
+	World->IsInvalid = true;
+}
+
+internal COMPOSITOR_LAYOUT(QueueBenchLayout)
+{
+	for (u32 PieceIndex = 0; PieceIndex < PieceCount; ++PieceIndex)
+	{
+		SlotMoved[PieceIndex] = false;
+	}
+}
+
+internal COMPOSITOR_CROP(QueueBenchCrop)
+{
+	return true;
+}
+
+internal COMPOSITOR_SHADE(QueueBenchShade)
+{
+	queue_world *World = (queue_world *)Context;
+	World->ShadedVersion = State->Version;
+}
+
+// @Note The window thread keeps going while the render thread waits on the swap chain
+internal COMPOSITOR_WAIT(QueueBenchWait)
+{
+	queue_world *World = (queue_world *)Context;
+	
+	u64 Until = Min(World->BusyUntil, World->Now + (u64)TimeoutMS * 1000);
+	if (Until > World->Now)
+	{
+		RunQueueWindowThread(World, Until);
+	}
+	
+	return (World->Now >= World->BusyUntil);
+}
+
+internal COMPOSITOR_PRESENT(QueueBenchPresent)
+{
+	queue_world *World = (queue_world *)Context;
+	
+	World->Now += QUEUE_BENCH_PRESENT;
+	World->BusyUntil = World->Now + World->Case->SwapInterval;
+	
+	if (World->PresentCount < QUEUE_BENCH_MAX_PRESENTS)
+	{
+		World->PresentTimes[World->PresentCount]    = World->Now;
+		World->PresentVersions[World->PresentCount] = World->ShadedVersion;
+		++World->PresentCount;
+	}
+	
+	return true;
+}
+
+// @Note Commands issued right after the render thread popped the queue wait out one acquire, then the frame
+// they ride on waits for its turn from the pacer and for the swap chain. The millisecond is the acquire
+// timeout rounding up the pacer's delay.
+internal u64 GetQueueLatencyBound(queue_case *Case)
+{
+	u64 CapInterval = (Case->Pacing.Mode == PacingMode_FixedCap) ? (1000000 / Case->Pacing.CapRate) : 0;
+	return (u64)QUEUE_BENCH_TIMEOUT * 1000 + CapInterval + Case->SwapInterval + 2 * QUEUE_BENCH_PRESENT + 1000;
+}
+
+internal bool BenchmarkQueueCase(queue_case *Case, memory_arena *Arena, u32 *Series)
+{
+	// @Note Every case starts from the same spot in the arena
+	size_t ArenaUsed = Arena->Used;
+	
+	queue_world *World = PushStruct(Arena, queue_world);
+	*World = {};
+	World->Case   = Case;
+	World->Now    = 1000000; // Zero is no command pending to the pipeline
+	World->Series = NextRandom(Series);
+	
+	World->Exchange        = PushStruct(Arena, render_state_exchange);
+	World->Commands        = PushStruct(Arena, render_command_queue);
+	*World->Commands       = {};
+	World->IssueTimes      = PushArray(Arena, QUEUE_BENCH_MAX_ISSUED, u64);
+	World->IssueVersions   = PushArray(Arena, QUEUE_BENCH_MAX_ISSUED, int);
+	World->PresentTimes    = PushArray(Arena, QUEUE_BENCH_MAX_PRESENTS, u64);
+	World->PresentVersions = PushArray(Arena, QUEUE_BENCH_MAX_PRESENTS, int);
+	
+	box Output = { 0, 0, 1920, 1080 };
+	World->WindowState = DefaultRenderState(&Output, 1, 400, 300);
+	World->WindowState.Pacing = Case->Pacing;
+	World->DirtyRect = box{ 1000, 600, 1800, 1000 };
+	World->IsInvalid = true;
+	World->NextCommandTime = World->Now + 50000;
+	World->StopTime        = World->Now + QUEUE_BENCH_TIME;
+	World->NextFrameTime   = World->Now;
+	InitializeRenderStateExchange(World->Exchange, &World->WindowState);
+	
+	overlay_pipeline *Pipeline = PushStruct(Arena, overlay_pipeline);
+	*Pipeline = {};
+	Pipeline->Source.Context    = World;
+	Pipeline->Source.Acquire    = QueueBenchAcquire;
+	Pipeline->Source.Release    = QueueBenchRelease;
+	Pipeline->Source.Invalidate = QueueBenchInvalidate;
+	Pipeline->Source.Select     = NULL;
+	
+	compositor *Compositor = &Pipeline->Compositor;
+	Compositor->Context = World;
+	Compositor->Layout  = QueueBenchLayout;
+	Compositor->Crop    = QueueBenchCrop;
+	Compositor->Sample  = NULL;
+	Compositor->Shade   = QueueBenchShade;
+	Compositor->Wait    = Case->SwapInterval ? QueueBenchWait : NULL;
+	Compositor->Present = QueueBenchPresent;
+	Compositor->Memory  = NULL;
+	Compositor->Traffic = NULL;
+	
+	Pipeline->Clock.Context = World;
+	Pipeline->Clock.Now     = QueueBenchNow;
+	Pipeline->StateExchange = World->Exchange;
+	Pipeline->Commands      = World->Commands;
+	
+	// @Note Past the last command by more than it may take, so the last ones get their chance too
+	u64 Bound = GetQueueLatencyBound(Case);
+	while (World->Now < World->StopTime + 2 * Bound)
+	{
+		RunOverlayFrame(Pipeline, QUEUE_BENCH_TIMEOUT);
+	}
+	
+	// @Note The screen never goes back to an older state
+	u32 OutOfOrder = 0;
+	for (u32 PresentIndex = 1; PresentIndex < World->PresentCount; ++PresentIndex)
+	{
+		if (World->PresentVersions[PresentIndex] < World->PresentVersions[PresentIndex - 1])
+		{
+			++OutOfOrder;
+		}
+	}
+	
+	// @Note Every command's state shows up on the first present after it that has it, or a later state.
+	// Both go up, so one pass does it.
+	u32 LostCount = 0;
+	u32 LateCount = 0;
+	u64 LatencyTotal = 0;
+	u64 LatencyMax   = 0;
+	u32 PresentIndex = 0;
+	for (u32 IssueIndex = 0; IssueIndex < World->IssuedCount; ++IssueIndex)
+	{
+		u64 IssueTime = World->IssueTimes[IssueIndex];
+		int Version   = World->IssueVersions[IssueIndex];
+		while ((PresentIndex < World->PresentCount) &&
+			   ((World->PresentTimes[PresentIndex] < IssueTime) || (World->PresentVersions[PresentIndex] < Version)))
+		{
+			++PresentIndex;
+		}
+		
+		if (PresentIndex == World->PresentCount)
+		{
+			++LostCount;
+			continue;
+		}
+		
+		u64 Latency = World->PresentTimes[PresentIndex] - IssueTime;
+		LatencyTotal += Latency;
+		LatencyMax    = Max(LatencyMax, Latency);
+		LateCount    += (Latency > Bound) ? 1 : 0;
+	}
+	
+	// @Note The pipeline's own count goes from the oldest command it popped to the present after
+	bool AllGood = (World->IssuedCount > 0) && (World->PresentCount < QUEUE_BENCH_MAX_PRESENTS) && (OutOfOrder == 0) &&
+		(LostCount == 0) && (LateCount == 0) && (Pipeline->CommandCount > 0) && (Pipeline->CommandLatencyMax <= Bound);
+	printf("queue %-22s %5u commands (%4u refused by a full queue), %6u presents, latency %6.2fms mean %6.2fms max, "
+		   "pipeline %6.2fms mean %6.2fms max over %5llu, bound %6.2fms, %u lost, %u late, %u out of order, %s\n", Case->Name,
+		   World->IssuedCount, World->RefusedCount, World->PresentCount,
+		   World->IssuedCount ? (double)LatencyTotal / 1000.0 / World->IssuedCount : 0.0, (double)LatencyMax / 1000.0,
+		   Pipeline->CommandCount ? (double)Pipeline->CommandLatencyTotal / 1000.0 / Pipeline->CommandCount : 0.0,
+		   (double)Pipeline->CommandLatencyMax / 1000.0, (unsigned long long)Pipeline->CommandCount, (double)Bound / 1000.0,
+		   LostCount, LateCount, OutOfOrder, AllGood ? "ok" : "BROKEN");
+	
+	Arena->Used = ArenaUsed;
+	return AllGood;
+}
+
+internal bool BenchmarkQueue()
+{
+	memory_arena Arena;
+	size_t MemorySize = Megabytes(4);
+	InitializeArena(&Arena, LinuxAllocateMemory(MemorySize), MemorySize);
+	
+	//
+	// The queue on its own, another thread pushing as fast as it can
+	//
+	
+	queue_stress *Stress = PushStruct(&Arena, queue_stress);
+	Stress->Queue = PushStruct(&Arena, render_command_queue);
+	*Stress->Queue = {};
+	Stress->RefusedCount = 0;
+	
+	u64 StartTime = GetNanoseconds();
+	
+	pthread_t Thread;
+	if (pthread_create(&Thread, NULL, QueueStressWriter, Stress) != 0)
+	{
+		Error("pthread_create");
+	}
+	
+	u64 Expected = 1;
+	u64 OutOfOrder = 0;
+	while (Expected <= QUEUE_BENCH_COMMANDS)
+	{
+		render_command Command;
+		if (!PopRenderCommand(Stress->Queue, &Command))
+		{
+			sched_yield();
+			continue;
+		}
+		
+		if (Command.IssueTime != Expected)
+		{
+			++OutOfOrder;
+		}
+		
+		Expected = Command.IssueTime + 1;
+	}
+	
+	pthread_join(Thread, NULL);
+	
+	u64 ElapsedTime = GetNanoseconds() - StartTime;
+	
+	// @Note A full queue turns the next one away, and hands back what it holds in the order it went in
+	render_command Command = {};
+	u32 Accepted = 0;
+	for (u32 CommandIndex = 0; CommandIndex <= RENDER_COMMAND_QUEUE_SIZE; ++CommandIndex)
+	{
+		Command.IssueTime = CommandIndex + 1;
+		Accepted += PushRenderCommand(Stress->Queue, Command) ? 1 : 0;
+	}
+	
+	u32 Popped = 0;
+	while (PopRenderCommand(Stress->Queue, &Command))
+	{
+		OutOfOrder += (Command.IssueTime != Popped + 1) ? 1 : 0;
+		++Popped;
+	}
+	
+	bool FullIsRight = (Accepted == RENDER_COMMAND_QUEUE_SIZE) && (Popped == RENDER_COMMAND_QUEUE_SIZE);
+	bool AllGood = (OutOfOrder == 0) && FullIsRight;
+	printf("queue threads %d commands at %.1fns each, %llu pushes refused by a full queue, %llu lost or out of order, "
+		   "%u of %u taken when full, %s\n", QUEUE_BENCH_COMMANDS, (double)ElapsedTime / QUEUE_BENCH_COMMANDS,
+		   (unsigned long long)Stress->RefusedCount, (unsigned long long)OutOfOrder, Accepted, RENDER_COMMAND_QUEUE_SIZE + 1,
+		   AllGood ? "ok" : "BROKEN");
+	
+	//
+	// Through the pipeline, with the window thread running while the render thread waits
+	//
+	
+	queue_case Cases[] =
+	{
+		{ "still desktop",         0,     0,     { PacingMode_LowestLatency, 0 } },
+		{ "60Hz desktop",          16667, 0,     { PacingMode_LowestLatency, 0 } },
+		{ "60Hz desktop, vsync",   16667, 16667, { PacingMode_LowestLatency, 0 } },
+		{ "144Hz desktop, vsync",  6944,  16667, { PacingMode_LowestLatency, 0 } },
+		{ "still desktop, cap 30", 0,     0,     { PacingMode_FixedCap, 30 } },
+		{ "144Hz desktop, cap 30", 6944,  6944,  { PacingMode_FixedCap, 30 } },
+	};
+	
+	u32 Series = 0x9E3779B9;
+	for (u32 CaseIndex = 0; CaseIndex < GetArrayCount(Cases); ++CaseIndex)
+	{
+		AllGood &= BenchmarkQueueCase(&Cases[CaseIndex], &Arena, &Series);
+	}
+	
+	LinuxFreeMemory(Arena.Base, MemorySize);
+	return AllGood;
+}
+
+//
+// Mapping: cut boxes from the window thread through the DPI scale and the rotation to the surface and back,
+// for every resolution, scale and rotation here, against a reference that goes one pixel at a time
+//
+
+#define MAPPING_BENCH_BOXES 4000 // Random cut boxes per resolution, scale and rotation
+
+struct mapping_resolution
+{
+	int Width; // Physical pixels, upright
+	int Height;
+};
+
+// @Note Where desktop pixel X, Y is on the surface. The surface is the desktop turned back, for 90 the
+// desktop's top row is the surface's left column and its left column the surface's bottom row.
+internal void GetReferenceSurfacePixel(int X, int Y, int DesktopWidth, int DesktopHeight, display_rotation Rotation,
+									   int *SurfaceX, int *SurfaceY)
+{
+	switch (Rotation)
+	{
+		case DisplayRotation_90:  { *SurfaceX = Y;                     *SurfaceY = DesktopWidth - 1 - X;  } break;
+		case DisplayRotation_180: { *SurfaceX = DesktopWidth - 1 - X;  *SurfaceY = DesktopHeight - 1 - Y; } break;
+		case DisplayRotation_270: { *SurfaceX = DesktopHeight - 1 - Y; *SurfaceY = X;                     } break;
+		default:                  { *SurfaceX = X;                     *SurfaceY = Y;                     } break;
+	}
+}
+
+// @Note Window thread coordinates times desktop over monitor size on that axis, rounded half away from zero, in integers
+internal int GetReferenceDesktopCoordinate(int Value, int DesktopSize, int MonitorSize)
+{
+	s64 Twice = 2 * (s64)Value * DesktopSize;
+	s64 Rounded = (Twice >= 0) ? ((Twice + MonitorSize) / (2 * MonitorSize)) : -((-Twice + MonitorSize) / (2 * MonitorSize));
+	return (int)Rounded;
+}
+
+// @Note The surface box the desktop box has to come out as, from where its first and last pixels go
+internal box GetReferenceSurfaceBox(box DesktopBox, int DesktopWidth, int DesktopHeight, display_rotation Rotation)
+{
+	int FirstX, FirstY, LastX, LastY;
+	GetReferenceSurfacePixel(DesktopBox.Left, DesktopBox.Top, DesktopWidth, DesktopHeight, Rotation, &FirstX, &FirstY);
+	GetReferenceSurfacePixel(DesktopBox.Right - 1, DesktopBox.Bottom - 1, DesktopWidth, DesktopHeight, Rotation, &LastX, &LastY);
+	
+	box Result;
+	Result.Left   = Min(FirstX, LastX);
+	Result.Top    = Min(FirstY, LastY);
+	Result.Right  = Max(FirstX, LastX) + 1;
+	Result.Bottom = Max(FirstY, LastY) + 1;
+	
+	return Result;
+}
+
+// @Note Where the draw samples display pixel X, Y of a crop drawn one to one, the way the shade does it with the UVs.
+// The texture coordinates are never negative, so the casts round down.
+internal void GetSampledSurfacePixel(coordinate_mapping *Mapping, int X, int Y, int DisplayWidth, int DisplayHeight,
+									 int *SurfaceX, int *SurfaceY)
+{
+	uv_transform UV = Mapping->UV;
+	float U = ((float)X + 0.5f) / (float)DisplayWidth;
+	float V = ((float)Y + 0.5f) / (float)DisplayHeight;
+	
+	float TextureU = UV.Origin.X + U * UV.AxisX.X + V * UV.AxisY.X;
+	float TextureV = UV.Origin.Y + U * UV.AxisX.Y + V * UV.AxisY.Y;
+	
+	*SurfaceX = Mapping->SurfaceBox.Left + (int)(TextureU * (float)GetBoxWidth(Mapping->SurfaceBox));
+	*SurfaceY = Mapping->SurfaceBox.Top  + (int)(TextureV * (float)GetBoxHeight(Mapping->SurfaceBox));
+}
+
+// Returns the number of mismatches, every desktop pixel both ways
+internal u64 CheckMappingPixels(int DesktopWidth, int DesktopHeight, display_rotation Rotation)
+{
+	u64 Mismatches = 0;
+	for (int Y = 0; Y < DesktopHeight; ++Y)
+	{
+		for (int X = 0; X < DesktopWidth; ++X)
+		{
+			box Pixel = box{ X, Y, X + 1, Y + 1 };
+			box Surface = DesktopToSurfaceBox(Pixel, DesktopWidth, DesktopHeight, Rotation);
+			
+			int SurfaceX, SurfaceY;
+			GetReferenceSurfacePixel(X, Y, DesktopWidth, DesktopHeight, Rotation, &SurfaceX, &SurfaceY);
+			
+			bool Match = BoxesAreEqual(Surface, box{ SurfaceX, SurfaceY, SurfaceX + 1, SurfaceY + 1 }) &&
+				BoxesAreEqual(SurfaceToDesktopBox(Surface, DesktopWidth, DesktopHeight, Rotation), Pixel);
+			Mismatches += Match ? 0 : 1;
+		}
+	}
+	
+	return Mismatches;
+}
+
+// Returns the number of cut boxes that didn't come out right
+internal u64 CheckMappingBoxes(int DesktopWidth, int DesktopHeight, display_rotation Rotation, int MonitorWidth, int MonitorHeight, u32 *Series)
+{
+	v2 DpiScale;
+	DpiScale.X = GetDpiScale(DesktopWidth,  MonitorWidth);
+	DpiScale.Y = GetDpiScale(DesktopHeight, MonitorHeight);
+	box Desktop = box{ 0, 0, DesktopWidth, DesktopHeight };
+	box SurfaceBounds = RotationSwapsAxes(Rotation) ? box{ 0, 0, DesktopHeight, DesktopWidth } : Desktop;
+	
+	u64 Mismatches = 0;
+	for (int BoxIndex = 0; BoxIndex <= MAPPING_BENCH_BOXES; ++BoxIndex)
+	{
+		// @Note The first one is the whole monitor, the rest hang off its edges now and then or miss it altogether
+		box CutBox = box{ 0, 0, MonitorWidth, MonitorHeight };
+		if (BoxIndex > 0)
+		{
+			CutBox.Left   = RandomBetween(Series, -MonitorWidth / 4, MonitorWidth);
+			CutBox.Top    = RandomBetween(Series, -MonitorHeight / 4, MonitorHeight);
+			CutBox.Right  = CutBox.Left + RandomBetween(Series, 1, MonitorWidth / 2);
+			CutBox.Bottom = CutBox.Top  + RandomBetween(Series, 1, MonitorHeight / 2);
+		}
+		
+		box Expected;
+		Expected.Left   = GetReferenceDesktopCoordinate(CutBox.Left,   DesktopWidth, MonitorWidth);
+		Expected.Top    = GetReferenceDesktopCoordinate(CutBox.Top,    DesktopHeight, MonitorHeight);
+		Expected.Right  = GetReferenceDesktopCoordinate(CutBox.Right,  DesktopWidth, MonitorWidth);
+		Expected.Bottom = GetReferenceDesktopCoordinate(CutBox.Bottom, DesktopHeight, MonitorHeight);
+		Expected = IntersectBoxes(Expected, Desktop);
+		if (BoxIndex == 0)
+		{
+			Expected = Desktop;
+		}
+		
+		int DisplayWidth  = BoxIsEmpty(Expected) ? 64 : GetBoxWidth(Expected);
+		int DisplayHeight = BoxIsEmpty(Expected) ? 64 : GetBoxHeight(Expected);
+		coordinate_mapping Mapping = MapCoordinates(DesktopWidth, DesktopHeight, Rotation, DpiScale, CutBox, DisplayWidth, DisplayHeight);
+		
+		bool Match;
+		if (BoxIsEmpty(Expected))
+		{
+			Match = BoxIsEmpty(Mapping.SurfaceBox) && (Mapping.TextureWidth == 1) && (Mapping.TextureHeight == 1);
+		}
+		else
+		{
+			box SurfaceBox = GetReferenceSurfaceBox(Expected, DesktopWidth, DesktopHeight, Rotation);
+			Match = BoxesAreEqual(Mapping.SurfaceBox, SurfaceBox) &&
+				BoxesAreEqual(IntersectBoxes(SurfaceBox, SurfaceBounds), SurfaceBox) &&
+				(Mapping.TextureWidth == GetBoxWidth(SurfaceBox)) && (Mapping.TextureHeight == GetBoxHeight(SurfaceBox)) &&
+				(Mapping.TexelsPerPixel.X == 1.0f) && (Mapping.TexelsPerPixel.Y == 1.0f) &&
+				BoxesAreEqual(SurfaceToDesktopBox(Mapping.SurfaceBox, DesktopWidth, DesktopHeight, Rotation), Expected);
+			
+			// @Note Drawn one to one, the corners and the middle of the display have to sample the desktop pixel under them
+			int Xs[3] = { 0, DisplayWidth / 2, DisplayWidth - 1 };
+			int Ys[3] = { 0, DisplayHeight / 2, DisplayHeight - 1 };
+			for (int Corner = 0; Corner < 9; ++Corner)
+			{
+				int X = Xs[Corner % 3];
+				int Y = Ys[Corner / 3];
+				
+				int SampledX, SampledY, SurfaceX, SurfaceY;
+				GetSampledSurfacePixel(&Mapping, X, Y, DisplayWidth, DisplayHeight, &SampledX, &SampledY);
+				GetReferenceSurfacePixel(Expected.Left + X, Expected.Top + Y, DesktopWidth, DesktopHeight, Rotation, &SurfaceX, &SurfaceY);
+				Match = Match && (SampledX == SurfaceX) && (SampledY == SurfaceY);
+			}
+			
+			// @Note A cut box on the monitor comes back from the desktop as it went in, the scale only ever goes up
+			if ((DpiScale.X >= 1.0f) && (DpiScale.Y >= 1.0f) && BoxesAreEqual(IntersectBoxes(CutBox, box{ 0, 0, MonitorWidth, MonitorHeight }), CutBox))
+			{
+				v2 Back;
+				Back.X = GetDpiScale(MonitorWidth,  DesktopWidth);
+				Back.Y = GetDpiScale(MonitorHeight, DesktopHeight);
+				Match = Match && BoxesAreEqual(WindowToDesktopBox(Expected, Back), CutBox);
+			}
+		}
+		
+		Mismatches += Match ? 0 : 1;
+	}
+	
+	return Mismatches;
+}
+
+internal bool BenchmarkMapping()
+{
+	mapping_resolution Resolutions[] =
+	{
+		{ 1280, 720 }, { 1366, 768 }, { 1920, 1080 }, { 1920, 1200 }, { 2560, 1440 }, { 3440, 1440 }, { 3840, 2160 },
+	};
+	
+	// @Note What the display settings offer, the monitor is the desktop divided by it and rounded like Windows does
+	float Scales[] = { 1.0f, 1.25f, 1.5f, 1.75f, 2.0f, 2.25f, 2.5f, 3.0f };
+	
+	u32 Series = 0x2545F491;
+	bool AllGood = true;
+	for (u32 ResolutionIndex = 0; ResolutionIndex < GetArrayCount(Resolutions); ++ResolutionIndex)
+	{
+		mapping_resolution *Resolution = &Resolutions[ResolutionIndex];
+		
+		u64 PixelCount = 0;
+		u64 BoxCount   = 0;
+		u64 PixelMismatches = 0;
+		u64 BoxMismatches   = 0;
+		u64 StartTime = GetNanoseconds();
+		for (int RotationIndex = 0; RotationIndex < 4; ++RotationIndex)
+		{
+			display_rotation Rotation = (display_rotation)RotationIndex;
+			bool Swap = RotationSwapsAxes(Rotation);
+			int DesktopWidth  = Swap ? Resolution->Height : Resolution->Width;
+			int DesktopHeight = Swap ? Resolution->Width  : Resolution->Height;
+			
+			PixelMismatches += CheckMappingPixels(DesktopWidth, DesktopHeight, Rotation);
+			PixelCount += (u64)DesktopWidth * DesktopHeight;
+			
+			for (u32 ScaleIndex = 0; ScaleIndex < GetArrayCount(Scales); ++ScaleIndex)
+			{
+				int MonitorWidth  = (int)((float)DesktopWidth  / Scales[ScaleIndex] + 0.5f);
+				int MonitorHeight = (int)((float)DesktopHeight / Scales[ScaleIndex] + 0.5f);
+				
+				BoxMismatches += CheckMappingBoxes(DesktopWidth, DesktopHeight, Rotation, MonitorWidth, MonitorHeight, &Series);
+				BoxCount += MAPPING_BENCH_BOXES + 1;
+			}
+		}
+		
+		bool Good = (PixelMismatches == 0) && (BoxMismatches == 0);
+		printf("mapping %4dx%-4d 4 rotations x %u scales: %9llu pixels %llu wrong, %6llu cut boxes %llu wrong, %.0fms, %s\n",
+			   Resolution->Width, Resolution->Height, (u32)GetArrayCount(Scales), (unsigned long long)PixelCount,
+			   (unsigned long long)PixelMismatches, (unsigned long long)BoxCount, (unsigned long long)BoxMismatches,
+			   (double)(GetNanoseconds() - StartTime) / 1000000.0, Good ? "ok" : "BROKEN");
+		
+		AllGood &= Good;
+	}
+	
+	return AllGood;
+}
+
+//
+// Stitch: cut boxes over several outputs at mixed positions, rotations and DPI scales, split into pieces.
+// Every display pixel has to come from the output under it, sampled where the desktop has it.
+//
+
+#define STITCH_BENCH_BOXES   2000
+#define STITCH_BENCH_DISPLAY 97 // Display pixels a side, odd so the piece edges fall between them unevenly
+
+struct stitch_output
+{
+	int Left; // Window thread coordinates, the monitor's size there is the desktop's over the scale
+	int Top;
+	int DesktopWidth; // Physical pixels, as the user sees them
+	int DesktopHeight;
+	display_rotation Rotation;
+	float Scale;
+};
+
+struct stitch_layout
+{
+	const char *Name;
+	u32 OutputCount;
+	stitch_output Outputs[4];
+};
+
+// @Note Which output window point X, Y is on, -1 for none
+internal int GetStitchOutput(render_state *State, double X, double Y)
+{
+	for (u32 OutputIndex = 0; OutputIndex < State->OutputCount; ++OutputIndex)
+	{
+		box Output = State->Outputs[OutputIndex];
+		if ((X >= Output.Left) && (X < Output.Right) && (Y >= Output.Top) && (Y < Output.Bottom))
+		{
+			return (int)OutputIndex;
+		}
+	}
+	
+	return -1;
+}
+
+internal bool BenchmarkStitchLayout(stitch_layout *Layout, u32 *Series)
+{
+	render_state State = {};
+	output_geometry Geometry[MAX_OUTPUTS];
+	box Bounds = { 0, 0, 0, 0 };
+	
+	State.OutputCount = Layout->OutputCount;
+	for (u32 OutputIndex = 0; OutputIndex < Layout->OutputCount; ++OutputIndex)
+	{
+		stitch_output *Output = &Layout->Outputs[OutputIndex];
+		
+		box *Rect = &State.Outputs[OutputIndex];
+		Rect->Left   = Output->Left;
+		Rect->Top    = Output->Top;
+		Rect->Right  = Output->Left + (int)((float)Output->DesktopWidth  / Output->Scale + 0.5f);
+		Rect->Bottom = Output->Top  + (int)((float)Output->DesktopHeight / Output->Scale + 0.5f);
+		
+		Geometry[OutputIndex].Rotation      = Output->Rotation;
+		Geometry[OutputIndex].DesktopWidth  = Output->DesktopWidth;
+		Geometry[OutputIndex].DesktopHeight = Output->DesktopHeight;
+		
+		Bounds = (OutputIndex == 0) ? *Rect : UnionBoxes(Bounds, *Rect);
+	}
+	
+	State.OverlayCount = 1;
+	overlay_region *Overlay = &State.Overlays[0];
+	Overlay->DisplayWidth  = STITCH_BENCH_DISPLAY;
+	Overlay->DisplayHeight = STITCH_BENCH_DISPLAY;
+	
+	u64 PieceTotal  = 0;
+	u64 WrongPieces = 0;
+	u64 WrongPixels = 0;
+	u64 OffPixels   = 0;
+	for (int BoxIndex = 0; BoxIndex < STITCH_BENCH_BOXES; ++BoxIndex)
+	{
+		// @Note Anywhere over the layout and a bit past it, from a sliver to most of it
+		int BoundsWidth  = GetBoxWidth(Bounds);
+		int BoundsHeight = GetBoxHeight(Bounds);
+		box CutBox;
+		CutBox.Left   = RandomBetween(Series, Bounds.Left - BoundsWidth / 8, Bounds.Right);
+		CutBox.Top    = RandomBetween(Series, Bounds.Top - BoundsHeight / 8, Bounds.Bottom);
+		CutBox.Right  = CutBox.Left + RandomBetween(Series, 1, BoundsWidth * 3 / 4);
+		CutBox.Bottom = CutBox.Top  + RandomBetween(Series, 1, BoundsHeight * 3 / 4);
+		Overlay->CutBox = CutBox;
+		
+		crop_piece Pieces[MAX_CROP_PIECES];
+		u32 PieceCount = BuildCropPieces(&State, Geometry, Pieces);
+		PieceTotal += PieceCount;
+		
+		// @Note One piece per output the cut box covers, with the surface box of its part
+		u32 Expected = 0;
+		for (u32 OutputIndex = 0; OutputIndex < State.OutputCount; ++OutputIndex)
+		{
+			box Output = State.Outputs[OutputIndex];
+			box Part = IntersectBoxes(CutBox, Output);
+			if (BoxIsEmpty(Part))
+			{
+				continue;
+			}
+			
+			crop_piece *Piece = NULL;
+			for (u32 PieceIndex = 0; PieceIndex < PieceCount; ++PieceIndex)
+			{
+				if (Pieces[PieceIndex].OutputIndex == OutputIndex)
+				{
+					Piece = &Pieces[PieceIndex];
+				}
+			}
+			
+			++Expected;
+			if (!Piece)
+			{
+				++WrongPieces;
+				continue;
+			}
+			
+			stitch_output *Stitch = &Layout->Outputs[OutputIndex];
+			int MonitorWidth  = GetBoxWidth(Output);
+			int MonitorHeight = GetBoxHeight(Output);
+			
+			box DesktopBox;
+			DesktopBox.Left   = GetReferenceDesktopCoordinate(Part.Left   - Output.Left, Stitch->DesktopWidth,  MonitorWidth);
+			DesktopBox.Top    = GetReferenceDesktopCoordinate(Part.Top    - Output.Top,  Stitch->DesktopHeight, MonitorHeight);
+			DesktopBox.Right  = GetReferenceDesktopCoordinate(Part.Right  - Output.Left, Stitch->DesktopWidth,  MonitorWidth);
+			DesktopBox.Bottom = GetReferenceDesktopCoordinate(Part.Bottom - Output.Top,  Stitch->DesktopHeight, MonitorHeight);
+			DesktopBox = IntersectBoxes(DesktopBox, box{ 0, 0, Stitch->DesktopWidth, Stitch->DesktopHeight });
+			
+			bool Good = (Piece->OverlayIndex == 0) && !BoxIsEmpty(DesktopBox) &&
+				BoxesAreEqual(Piece->Mapping.SurfaceBox,
+							  GetReferenceSurfaceBox(DesktopBox, Stitch->DesktopWidth, Stitch->DesktopHeight, Stitch->Rotation));
+			WrongPieces += Good ? 0 : 1;
+		}
+		
+		if (PieceCount != Expected)
+		{
+			++WrongPieces;
+		}
+		
+		// @Note Each display pixel is drawn by the piece of the output under its centre and by no other, and samples
+		// the surface pixel the desktop has there. Scaling a piece onto its part of the display can be half a pixel
+		// off each way at its edges, so one pixel of slack. The centre in window coordinates is worked out exactly,
+		// a centre right on an output's edge belongs to the one it starts, like the piece edges in the draw.
+		for (int DisplayY = 0; DisplayY < STITCH_BENCH_DISPLAY; ++DisplayY)
+		{
+			for (int DisplayX = 0; DisplayX < STITCH_BENCH_DISPLAY; ++DisplayX)
+			{
+				float U = ((float)DisplayX + 0.5f) / STITCH_BENCH_DISPLAY;
+				float V = ((float)DisplayY + 0.5f) / STITCH_BENCH_DISPLAY;
+				double WindowX = CutBox.Left + (2.0 * DisplayX + 1.0) * GetBoxWidth(CutBox)  / (2.0 * STITCH_BENCH_DISPLAY);
+				double WindowY = CutBox.Top  + (2.0 * DisplayY + 1.0) * GetBoxHeight(CutBox) / (2.0 * STITCH_BENCH_DISPLAY);
+				int OutputIndex = GetStitchOutput(&State, WindowX, WindowY);
+				
+				crop_piece *Drawn = NULL;
+				u32 DrawnCount = 0;
+				for (u32 PieceIndex = 0; PieceIndex < PieceCount; ++PieceIndex)
+				{
+					crop_piece *Piece = &Pieces[PieceIndex];
+					if ((U >= Piece->DisplayMin.X) && (U < Piece->DisplayMax.X) && (V >= Piece->DisplayMin.Y) && (V < Piece->DisplayMax.Y))
+					{
+						Drawn = Piece;
+						++DrawnCount;
+					}
+				}
+				
+				if ((OutputIndex < 0) ? (DrawnCount != 0) : ((DrawnCount != 1) || (Drawn->OutputIndex != (u32)OutputIndex)))
+				{
+					++WrongPixels;
+					continue;
+				}
+				
+				if (OutputIndex < 0)
+				{
+					continue;
+				}
+				
+				stitch_output *Stitch = &Layout->Outputs[OutputIndex];
+				box Output = State.Outputs[OutputIndex];
+				double DesktopX = (WindowX - Output.Left) * Stitch->DesktopWidth  / GetBoxWidth(Output);
+				double DesktopY = (WindowY - Output.Top)  * Stitch->DesktopHeight / GetBoxHeight(Output);
+				
+				int SurfaceX, SurfaceY;
+				GetReferenceSurfacePixel((int)DesktopX, (int)DesktopY, Stitch->DesktopWidth, Stitch->DesktopHeight,
+										 Stitch->Rotation, &SurfaceX, &SurfaceY);
+				
+				// @Note Same as the draw, the piece's own 0..1 through its UVs onto its surface box
+				coordinate_mapping *Mapping = &Drawn->Mapping;
+				float PieceU = (U - Drawn->DisplayMin.X) / (Drawn->DisplayMax.X - Drawn->DisplayMin.X);
+				float PieceV = (V - Drawn->DisplayMin.Y) / (Drawn->DisplayMax.Y - Drawn->DisplayMin.Y);
+				float TextureU = Mapping->UV.Origin.X + PieceU * Mapping->UV.AxisX.X + PieceV * Mapping->UV.AxisY.X;
+				float TextureV = Mapping->UV.Origin.Y + PieceU * Mapping->UV.AxisX.Y + PieceV * Mapping->UV.AxisY.Y;
+				int SampledX = Mapping->SurfaceBox.Left + (int)(TextureU * (float)GetBoxWidth(Mapping->SurfaceBox));
+				int SampledY = Mapping->SurfaceBox.Top  + (int)(TextureV * (float)GetBoxHeight(Mapping->SurfaceBox));
+				
+				if ((SampledX < SurfaceX - 1) || (SampledX > SurfaceX + 1) || (SampledY < SurfaceY - 1) || (SampledY > SurfaceY + 1))
+				{
+					++OffPixels;
+				}
+			}
+		}
+	}
+	
+	bool AllGood = (WrongPieces == 0) && (WrongPixels == 0) && (OffPixels == 0);
+	printf("stitch %-34s %u outputs, %d cut boxes, %6llu pieces %llu wrong, display pixels %llu on the wrong output, %llu sampled off, %s\n",
+		   Layout->Name, Layout->OutputCount, STITCH_BENCH_BOXES, (unsigned long long)PieceTotal, (unsigned long long)WrongPieces,
+		   (unsigned long long)WrongPixels, (unsigned long long)OffPixels, AllGood ? "ok" : "BROKEN");
+	
+	return AllGood;
+}
+
+internal bool BenchmarkStitch()
+{
+	// @Note Window thread positions are what Windows would report for a process that isn't DPI aware
+	stitch_layout Layouts[] =
+	{
+		{ "side by side, 100% and 150%", 2,
+			{ { 0, 0, 1920, 1080, DisplayRotation_Identity, 1.0f }, { 1920, 0, 2560, 1440, DisplayRotation_Identity, 1.5f } } },
+		{ "portrait left, upside down right", 3,
+			{ { 0, 0, 3840, 2160, DisplayRotation_Identity, 2.0f }, { -1080, -420, 1080, 1920, DisplayRotation_90, 1.0f },
+			  { 1920, 233, 1366, 768, DisplayRotation_180, 1.25f } } },
+		{ "stacked with a gap, 125% over 270", 2,
+			{ { 0, -1152, 2560, 1440, DisplayRotation_Identity, 1.25f }, { 424, 0, 1200, 1920, DisplayRotation_270, 1.0f } } },
+		{ "four in a square, every rotation", 4,
+			{ { 0, 0, 1920, 1080, DisplayRotation_Identity, 1.0f }, { 1920, 0, 1080, 1920, DisplayRotation_90, 1.75f },
+			  { 0, 1080, 2560, 1440, DisplayRotation_180, 1.5f }, { 1920, 1097, 1920, 1200, DisplayRotation_270, 2.25f } } },
+	};
+	
+	u32 Series = 0x6C078965;
+	bool AllGood = true;
+	for (u32 LayoutIndex = 0; LayoutIndex < GetArrayCount(Layouts); ++LayoutIndex)
+	{
+		AllGood &= BenchmarkStitchLayout(&Layouts[LayoutIndex], &Series);
+	}
+	
+	return AllGood;
+}
+
+internal bool RunBenchmark(const char *Name)
+{
+	if (strcmp(Name, "atlas") == 0)
+	{
+		return BenchmarkAtlas();
+	}
+	
+	if (strcmp(Name, "pacing") == 0)
+	{
+		return BenchmarkPacing();
+	}
+	
+	if (strcmp(Name, "latency") == 0)
+	{
+		return BenchmarkLatency();
+	}
+	
+	if (strcmp(Name, "shade") == 0)
+	{
+		return BenchmarkShade();
+	}
+	
+	if (strcmp(Name, "tiles") == 0)
+	{
+		return BenchmarkTiles();
+	}
+	
+	if (strcmp(Name, "record") == 0)
+	{
+		return BenchmarkRecord();
+	}
+	
+	if (strcmp(Name, "hash") == 0)
+	{
+		return BenchmarkHash();
+	}
+	
+	if (strcmp(Name, "scale") == 0)
+	{
+		return BenchmarkScale();
+	}
+	
+	if (strcmp(Name, "colour") == 0)
+	{
+		return BenchmarkColour();
+	}
+	
+	if (strcmp(Name, "ring") == 0)
+	{
+		return BenchmarkRing();
+	}
+	
+	if (strcmp(Name, "device") == 0)
+	{
+		return BenchmarkDevice();
+	}
+	
+	if (strcmp(Name, "cache") == 0)
+	{
+		return BenchmarkCache();
+	}
+	
+	if (strcmp(Name, "x11") == 0)
+	{
+		return BenchmarkX11();
+	}
+	
+	if (strcmp(Name, "opengl") == 0)
+	{
+		return BenchmarkOpenGL();
+	}
+	
+	if (strcmp(Name, "export") == 0)
+	{
+		return BenchmarkExport();
+	}
+	
+	if (strcmp(Name, "yuv") == 0)
+	{
+		return BenchmarkYUV();
+	}
+	
+	if (strcmp(Name, "effects") == 0)
+	{
+		return BenchmarkEffects();
+	}
+	
+	if (strcmp(Name, "damage") == 0)
+	{
+		return BenchmarkDamage();
+	}
+	
+	if (strcmp(Name, "exchange") == 0)
+	{
+		return BenchmarkExchange();
+	}
+	
+	if (strcmp(Name, "queue") == 0)
+	{
+		return BenchmarkQueue();
+	}
+	
+	if (strcmp(Name, "mapping") == 0)
+	{
+		return BenchmarkMapping();
+	}
+	
+	if (strcmp(Name, "stitch") == 0)
+	{
+		return BenchmarkStitch();
+	}
+	
+	fprintf(stderr, "Unknown benchmark %s, try: atlas pacing latency shade tiles record hash scale colour ring device cache x11 opengl export yuv effects damage exchange queue mapping stitch\n", Name);
+	return false;
+}
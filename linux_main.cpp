@@ -0,0 +1,1386 @@
+//
+// Headless Linux platform layer: synthetic source + software compositor, reports the per-frame cost
+//
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <pthread.h>
+#include <sched.h>
+#include <unistd.h>
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <dirent.h>
+
+#include "overlay.cpp"
+#include "overlay_software.cpp"
+
+#if OPENGL_COMPOSITOR
+#include "overlay_opengl.cpp"
+#endif
+
+// @Note Same slice the render thread uses on Windows, the longest a command waits on a static desktop
+#define WAIT_SLICE_MS 8
+
+// @Note Frames between drains of the latency ring, well under what fills it
+#define LATENCY_DRAIN_FRAMES 64
+
+internal u64 GetMicroseconds()
+{
+	timespec Time;
+	clock_gettime(CLOCK_MONOTONIC, &Time);
+	
+	return (u64)Time.tv_sec * 1000000 + (u64)Time.tv_nsec / 1000;
+}
+
+internal PLATFORM_GET_NANOSECONDS(GetNanoseconds)
+{
+	timespec Time;
+	clock_gettime(CLOCK_MONOTONIC, &Time);
+	
+	return (u64)Time.tv_sec * 1000000000 + (u64)Time.tv_nsec;
+}
+
+internal void Error(const char *ErrorCause)
+{
+	fprintf(stderr, "ERROR: %s\n", ErrorCause);
+	exit(1);
+}
+
+// @Note Every allocation the backends ask for, so a run can show it made none per frame
+global u64 AllocationCount;
+
+internal PLATFORM_ALLOCATE_MEMORY(LinuxAllocateMemory)
+{
+	++AllocationCount;
+	void *Memory = mmap(NULL, Size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	return (Memory == MAP_FAILED) ? NULL : Memory;
+}
+
+internal PLATFORM_FREE_MEMORY(LinuxFreeMemory)
+{
+	munmap(Memory, Size);
+}
+
+inline double GetKilobytes(u64 Bytes)
+{
+	return (double)Bytes / 1024.0;
+}
+
+//
+// Events and threads, for the tile pool
+//
+
+// @Note Auto-reset like a Win32 event, a wait that succeeds clears it
+struct linux_event
+{
+	pthread_mutex_t Mutex;
+	pthread_cond_t Condition;
+	bool IsSet;
+};
+
+internal void *LinuxCreateEvent()
+{
+	linux_event *Event = (linux_event *)LinuxAllocateMemory(sizeof(linux_event));
+	if (!Event)
+	{
+		Error("Event memory");
+	}
+	
+	pthread_condattr_t Attributes;
+	pthread_condattr_init(&Attributes);
+	pthread_condattr_setclock(&Attributes, CLOCK_MONOTONIC);
+	
+	pthread_mutex_init(&Event->Mutex, NULL);
+	pthread_cond_init(&Event->Condition, &Attributes);
+	Event->IsSet = false;
+	
+	return Event;
+}
+
+internal PLATFORM_WAIT_EVENT(LinuxWaitEvent)
+{
+	linux_event *Linux = (linux_event *)Event;
+	
+	timespec Deadline;
+	clock_gettime(CLOCK_MONOTONIC, &Deadline);
+	Deadline.tv_sec  += TimeoutMS / 1000;
+	Deadline.tv_nsec += (long)(TimeoutMS % 1000) * 1000000;
+	if (Deadline.tv_nsec >= 1000000000)
+	{
+		Deadline.tv_sec  += 1;
+		Deadline.tv_nsec -= 1000000000;
+	}
+	
+	pthread_mutex_lock(&Linux->Mutex);
+	while (!Linux->IsSet && (pthread_cond_timedwait(&Linux->Condition, &Linux->Mutex, &Deadline) == 0))
+	{
+	}
+	
+	bool WasSet = Linux->IsSet;
+	Linux->IsSet = false;
+	pthread_mutex_unlock(&Linux->Mutex);
+	
+	return WasSet;
+}
+
+internal PLATFORM_SIGNAL_EVENT(LinuxSignalEvent)
+{
+	linux_event *Linux = (linux_event *)Event;
+	
+	pthread_mutex_lock(&Linux->Mutex);
+	Linux->IsSet = true;
+	pthread_cond_signal(&Linux->Condition);
+	pthread_mutex_unlock(&Linux->Mutex);
+}
+
+// @Note Worker N goes on core N, the render thread keeps core 0. Past the last core they wrap around.
+internal void PinToCore(pthread_t Thread, u32 Core)
+{
+	long CoreCount = sysconf(_SC_NPROCESSORS_ONLN);
+	
+	cpu_set_t Cores;
+	CPU_ZERO(&Cores);
+	CPU_SET(Core % (u32)Max(CoreCount, 1L), &Cores);
+	pthread_setaffinity_np(Thread, sizeof(Cores), &Cores);
+}
+
+internal void *TileWorkerThread(void *Parameter)
+{
+	RunTileWorker((tile_worker *)Parameter);
+	return NULL;
+}
+
+// @Note WorkerCount counts the calling thread, 1 is no pool at all
+internal tile_pool *CreateTilePool(memory_arena *Arena, u32 WorkerCount, bool Pin)
+{
+	if (WorkerCount <= 1)
+	{
+		return NULL;
+	}
+	
+	tile_pool *Pool = PushStruct(Arena, tile_pool);
+	InitializeTilePool(Pool, LinuxWaitEvent, LinuxSignalEvent, LinuxCreateEvent());
+	
+	if (Pin)
+	{
+		PinToCore(pthread_self(), 0);
+	}
+	
+	for (u32 WorkerIndex = 1; WorkerIndex < WorkerCount; ++WorkerIndex)
+	{
+		tile_worker *Worker = AddTileWorker(Pool, LinuxCreateEvent());
+		
+		pthread_t Thread;
+		if (pthread_create(&Thread, NULL, TileWorkerThread, Worker) != 0)
+		{
+			Error("pthread_create");
+		}
+		
+		if (Pin)
+		{
+			PinToCore(Thread, WorkerIndex);
+		}
+		
+		pthread_detach(Thread);
+	}
+	
+	return Pool;
+}
+
+//
+// Files, for the shader cache
+//
+
+internal PLATFORM_READ_FILE(LinuxReadFile)
+{
+	int File = open(Path, O_RDONLY);
+	if (File < 0)
+	{
+		return false;
+	}
+	
+	struct stat Status;
+	bool Read = (fstat(File, &Status) == 0);
+	*FileSize = Read ? (size_t)Status.st_size : 0;
+	
+	size_t ReadSize = Min(MemorySize, *FileSize);
+	size_t BytesRead = 0;
+	while (Read && (BytesRead < ReadSize))
+	{
+		ssize_t Count = read(File, (u8 *)Memory + BytesRead, ReadSize - BytesRead);
+		Read = (Count > 0);
+		BytesRead += Read ? (size_t)Count : 0;
+	}
+	
+	close(File);
+	return Read;
+}
+
+// @Note Synced before it is closed, so the rename that follows never lands ahead of the contents
+internal PLATFORM_WRITE_FILE(LinuxWriteFile)
+{
+	int File = open(Path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+	if (File < 0)
+	{
+		return false;
+	}
+	
+	size_t Written = 0;
+	bool Wrote = true;
+	while (Wrote && (Written < Size))
+	{
+		ssize_t Count = write(File, (u8 *)Memory + Written, Size - Written);
+		Wrote = (Count > 0);
+		Written += Wrote ? (size_t)Count : 0;
+	}
+	
+	Wrote &= (fdatasync(File) == 0);
+	close(File);
+	return Wrote;
+}
+
+internal PLATFORM_REPLACE_FILE(LinuxReplaceFile)
+{
+	return rename(From, To) == 0;
+}
+
+internal PLATFORM_DELETE_FILE(LinuxDeleteFile)
+{
+	unlink(Path);
+}
+
+internal PLATFORM_LIST_FILES(LinuxListFiles)
+{
+	DIR *Listing = opendir(Directory);
+	if (!Listing)
+	{
+		return 0;
+	}
+	
+	u32 FileCount = 0;
+	dirent *Entry;
+	while ((FileCount < MaxCount) && (Entry = readdir(Listing)))
+	{
+		platform_file_info *File = &Files[FileCount];
+		size_t NameLength = strlen(Entry->d_name);
+		
+		struct stat Status;
+		if ((NameLength >= sizeof(File->Name)) || (fstatat(dirfd(Listing), Entry->d_name, &Status, 0) != 0) ||
+			!S_ISREG(Status.st_mode))
+		{
+			continue;
+		}
+		
+		memcpy(File->Name, Entry->d_name, NameLength + 1);
+		File->Size      = (u64)Status.st_size;
+		File->WriteTime = (u64)Status.st_mtim.tv_sec * 1000000000 + (u64)Status.st_mtim.tv_nsec;
+		++FileCount;
+	}
+	
+	closedir(Listing);
+	return FileCount;
+}
+
+global platform_file_api LinuxFiles =
+{
+	LinuxReadFile,
+	LinuxWriteFile,
+	LinuxReplaceFile,
+	LinuxDeleteFile,
+	LinuxListFiles,
+};
+
+//
+// Shared memory, for the export ring
+//
+
+// @Note Name is "/something" like shm_open wants. Made if it isn't there yet, and sized to Size.
+internal void *CreateLinuxSharedMemory(const char *Name, size_t Size)
+{
+	int File = shm_open(Name, O_RDWR | O_CREAT, 0644);
+	if (File < 0)
+	{
+		return NULL;
+	}
+	
+	void *Memory = MAP_FAILED;
+	if (ftruncate(File, (off_t)Size) == 0)
+	{
+		Memory = mmap(NULL, Size, PROT_READ | PROT_WRITE, MAP_SHARED, File, 0);
+	}
+	close(File);
+	
+	return (Memory == MAP_FAILED) ? NULL : Memory;
+}
+
+// @Note Read only, the way a reader of the ring maps it. Size is zero if it couldn't.
+internal void *OpenLinuxSharedMemory(const char *Name, size_t *Size)
+{
+	*Size = 0;
+	
+	int File = shm_open(Name, O_RDONLY, 0);
+	if (File < 0)
+	{
+		return NULL;
+	}
+	
+	struct stat Status;
+	void *Memory = MAP_FAILED;
+	if ((fstat(File, &Status) == 0) && (Status.st_size > 0))
+	{
+		Memory = mmap(NULL, (size_t)Status.st_size, PROT_READ, MAP_SHARED, File, 0);
+	}
+	close(File);
+	
+	if (Memory == MAP_FAILED)
+	{
+		return NULL;
+	}
+	
+	*Size = (size_t)Status.st_size;
+	return Memory;
+}
+
+internal bool ParseSize(const char *String, int *Width, int *Height)
+{
+	return (sscanf(String, "%dx%d", Width, Height) == 2) && (*Width > 0) && (*Height > 0);
+}
+
+// @Note Names from EffectNames separated by commas, in any order
+internal bool ParseEffects(const char *String, u32 *Key)
+{
+	*Key = 0;
+	for (const char *At = String; *At; )
+	{
+		size_t Length = strcspn(At, ",");
+		
+		u32 Bit = 0;
+		while ((Bit < GetArrayCount(EffectNames)) && ((strlen(EffectNames[Bit]) != Length) || (strncmp(At, EffectNames[Bit], Length) != 0)))
+		{
+			++Bit;
+		}
+		
+		if (Bit == GetArrayCount(EffectNames))
+		{
+			return false;
+		}
+		
+		*Key |= 1u << Bit;
+		At += Length + (At[Length] == ',');
+	}
+	
+	return *Key != 0;
+}
+
+// @Note The wall clock, for a source that isn't synthetic
+internal OVERLAY_CLOCK_NOW(LinuxClockNow)
+{
+	return GetMicroseconds();
+}
+
+#if X11_CAPTURE
+#include "linux_x11.cpp"
+#endif
+
+#if OPENGL_COMPOSITOR
+#include "linux_opengl.cpp"
+#endif
+
+#include "linux_bench.cpp"
+
+// @Note Maps the whole file, the reader only ever looks at it. Size is zero if it couldn't.
+internal u8 *MapFile(const char *Path, size_t *Size)
+{
+	*Size = 0;
+	
+	int File = open(Path, O_RDONLY);
+	if (File < 0)
+	{
+		return NULL;
+	}
+	
+	struct stat Status;
+	void *Memory = MAP_FAILED;
+	if ((fstat(File, &Status) == 0) && (Status.st_size > 0))
+	{
+		Memory = mmap(NULL, (size_t)Status.st_size, PROT_READ, MAP_PRIVATE, File, 0);
+	}
+	close(File);
+	
+	if (Memory == MAP_FAILED)
+	{
+		return NULL;
+	}
+	
+	*Size = (size_t)Status.st_size;
+	return (u8 *)Memory;
+}
+
+// @Note Plays a recording back through the compositor, every frame in order and then a seek back to the middle
+internal int ReplayRecording(const char *Path, software_compositor *Compositor)
+{
+	size_t Size;
+	u8 *Memory = MapFile(Path, &Size);
+	if (!Memory)
+	{
+		Error("Can't map the recording");
+	}
+	
+	u32 FrameCount = ScanRecording(Memory, Size, NULL, 0);
+	u64 *FrameOffsets = (u64 *)LinuxAllocateMemory(Max(FrameCount, 1u) * sizeof(u64));
+	
+	recording_reader Reader;
+	if (!FrameOffsets || !InitializeRecordingReader(&Reader, Memory, Size, FrameOffsets, FrameCount, LinuxAllocateMemory, LinuxFreeMemory))
+	{
+		Error("Not a recording, or not one frame of it is whole");
+	}
+	
+	u64 FirstTimestamp = 0;
+	u64 DecodeTime = 0;
+	u64 ReplayTime = 0;
+	u64 MiddleHash = 0;
+	u32 MiddleFrame = FrameCount / 2;
+	for (u32 FrameIndex = 0; FrameIndex < FrameCount; ++FrameIndex)
+	{
+		u64 StartTime = GetNanoseconds();
+		if (!SeekRecording(&Reader, FrameIndex))
+		{
+			fprintf(stderr, "Recording is damaged at frame %u, stopping there\n", FrameIndex);
+			FrameCount = FrameIndex;
+			break;
+		}
+		
+		u64 DecodedTime = GetNanoseconds();
+		if (!SoftwareReplay(Compositor, &Reader))
+		{
+			Error("No memory for the replay");
+		}
+		
+		DecodeTime += DecodedTime - StartTime;
+		ReplayTime += GetNanoseconds() - DecodedTime;
+		
+		if (FrameIndex == 0)
+		{
+			FirstTimestamp = Reader.Timestamp;
+		}
+		
+		if (FrameIndex == MiddleFrame)
+		{
+			bitmap *Target = &Compositor->BackBuffer;
+			MiddleHash = HashBytes(Target->Memory, (size_t)Target->Pitch * Target->Height);
+		}
+	}
+	
+	if (FrameCount == 0)
+	{
+		return 1;
+	}
+	
+	bitmap *Target = &Compositor->BackBuffer;
+	u64 LastHash = HashBytes(Target->Memory, (size_t)Target->Pitch * Target->Height);
+	u64 Duration = Reader.Timestamp - FirstTimestamp;
+	printf("replay %u frames over %.2fs, %.1fKB, decode avg %.2fus, draw avg %.2fus, last frame %016llx\n", FrameCount,
+		   (double)Duration / 1000000.0, GetKilobytes(Size), (double)DecodeTime / FrameCount / 1000.0,
+		   (double)ReplayTime / FrameCount / 1000.0, (unsigned long long)LastHash);
+	
+	// @Note From the last frame back to the middle goes through the keyframe before it, and has to land on the same picture
+	bool SeekMatches = false;
+	u64 StartTime = GetNanoseconds();
+	if (SeekRecording(&Reader, MiddleFrame) && SoftwareReplay(Compositor, &Reader))
+	{
+		SeekMatches = (HashBytes(Target->Memory, (size_t)Target->Pitch * Target->Height) == MiddleHash);
+	}
+	printf("replay seek to frame %u in %.2fus, %s\n", MiddleFrame, (double)(GetNanoseconds() - StartTime) / 1000.0,
+		   SeekMatches ? "same image" : "DIFFERENT IMAGE");
+	
+	return SeekMatches ? 0 : 1;
+}
+
+int main(int ArgCount, char **Args)
+{
+	int FrameCount    = 1000;
+	int MonitorWidth  = 1920;
+	int MonitorHeight = 1080;
+	int DisplayWidth  = 200;
+	int DisplayHeight = 200;
+	bool IsStatic     = false;
+	bool Coarse       = false;
+	bool HashTiles    = true;
+	int DragEvery     = 0;
+	int ResizeEvery   = 0;
+	int RotationAngle = 0;
+	float DpiScale    = 1.0f;
+	int OverlayCount  = 1;
+	int OutputCount   = 1;
+	bool Span         = false;
+	char *LatencyPath = NULL;
+	char *KernelName  = NULL;
+	char *ScaleName   = NULL;
+	char *EffectList  = NULL;
+	u32 EffectKey     = 0;
+	char *RecordPath  = NULL;
+	char *ReplayPath  = NULL;
+	char *ExportName  = NULL;
+	bool ConvertYUV   = false;
+	yuv_format YUVFormat = { YUVLayout_NV12, YUVMatrix_BT601, YUVRange_Limited };
+	int ThreadCount   = 1;
+	bool Pin          = false;
+	bool Direct       = false;
+	bool CaptureRings = false;
+	bool CaptureX11   = false;
+	bool DrawWithOpenGL = false;
+	bool ShowWindows = false;
+	surface_format Format = SurfaceFormat_BGRA8;
+	float WhiteNits   = SCRGB_WHITE_NITS;
+	
+	// @Note The benchmarks use them too
+	InitializeColourTables();
+	
+	pacing_params Pacing;
+	Pacing.Mode    = PacingMode_LowestLatency;
+	Pacing.CapRate = 30;
+	
+	for (int ArgIndex = 1; ArgIndex < ArgCount; ++ArgIndex)
+	{
+		char *Arg  = Args[ArgIndex];
+		char *Next = (ArgIndex + 1 < ArgCount) ? Args[ArgIndex + 1] : NULL;
+		
+		if ((strcmp(Arg, "-frames") == 0) && Next)
+		{
+			FrameCount = atoi(Next);
+			++ArgIndex;
+		}
+		else if ((strcmp(Arg, "-monitor") == 0) && Next && ParseSize(Next, &MonitorWidth, &MonitorHeight))
+		{
+			++ArgIndex;
+		}
+		else if ((strcmp(Arg, "-display") == 0) && Next && ParseSize(Next, &DisplayWidth, &DisplayHeight))
+		{
+			++ArgIndex;
+		}
+		else if (strcmp(Arg, "-static") == 0)
+		{
+			IsStatic = true;
+		}
+		else if (strcmp(Arg, "-coarse") == 0)
+		{
+			Coarse = true;
+		}
+		else if (strcmp(Arg, "-nohash") == 0)
+		{
+			HashTiles = false;
+		}
+		else if ((strcmp(Arg, "-drag") == 0) && Next)
+		{
+			DragEvery = atoi(Next);
+			++ArgIndex;
+		}
+		else if ((strcmp(Arg, "-resize") == 0) && Next)
+		{
+			ResizeEvery = atoi(Next);
+			++ArgIndex;
+		}
+		else if ((strcmp(Arg, "-rotate") == 0) && Next && ((atoi(Next) % 90) == 0))
+		{
+			RotationAngle = atoi(Next);
+			++ArgIndex;
+		}
+		else if ((strcmp(Arg, "-dpi") == 0) && Next && (atof(Next) >= 1.0))
+		{
+			DpiScale = (float)atof(Next);
+			++ArgIndex;
+		}
+		else if ((strcmp(Arg, "-overlays") == 0) && Next && (atoi(Next) >= 1) && (atoi(Next) <= MAX_OVERLAYS))
+		{
+			OverlayCount = atoi(Next);
+			++ArgIndex;
+		}
+		else if ((strcmp(Arg, "-outputs") == 0) && Next && (atoi(Next) >= 1) && (atoi(Next) <= MAX_OUTPUTS))
+		{
+			OutputCount = atoi(Next);
+			++ArgIndex;
+		}
+		else if (strcmp(Arg, "-span") == 0)
+		{
+			Span = true;
+		}
+		else if ((strcmp(Arg, "-pace") == 0) && Next && ((strcmp(Next, "latency") == 0) || (strcmp(Next, "source") == 0) || (atoi(Next) > 0)))
+		{
+			// @Note A number is a cap in frames a second
+			Pacing.Mode    = (strcmp(Next, "latency") == 0) ? PacingMode_LowestLatency : (strcmp(Next, "source") == 0) ? PacingMode_MatchSource : PacingMode_FixedCap;
+			Pacing.CapRate = (Pacing.Mode == PacingMode_FixedCap) ? (u32)atoi(Next) : Pacing.CapRate;
+			++ArgIndex;
+		}
+		else if ((strcmp(Arg, "-latency") == 0) && Next)
+		{
+			LatencyPath = Next;
+			++ArgIndex;
+		}
+		else if ((strcmp(Arg, "-record") == 0) && Next)
+		{
+			RecordPath = Next;
+			++ArgIndex;
+		}
+		else if ((strcmp(Arg, "-replay") == 0) && Next)
+		{
+			ReplayPath = Next;
+			++ArgIndex;
+		}
+		else if ((strcmp(Arg, "-export") == 0) && Next && (Next[0] == '/'))
+		{
+			ExportName = Next;
+			++ArgIndex;
+		}
+		else if ((strcmp(Arg, "-yuv") == 0) && Next && ((strcmp(Next, "nv12") == 0) || (strcmp(Next, "i420") == 0)))
+		{
+			ConvertYUV = true;
+			YUVFormat.Layout = (strcmp(Next, "nv12") == 0) ? YUVLayout_NV12 : YUVLayout_I420;
+			++ArgIndex;
+		}
+		else if (strcmp(Arg, "-bt709") == 0)
+		{
+			YUVFormat.Matrix = YUVMatrix_BT709;
+		}
+		else if (strcmp(Arg, "-fullrange") == 0)
+		{
+			YUVFormat.Range = YUVRange_Full;
+		}
+		else if ((strcmp(Arg, "-threads") == 0) && Next && (atoi(Next) >= 1) && (atoi(Next) <= MAX_TILE_WORKERS))
+		{
+			ThreadCount = atoi(Next);
+			++ArgIndex;
+		}
+		else if (strcmp(Arg, "-affinity") == 0)
+		{
+			Pin = true;
+		}
+		else if ((strcmp(Arg, "-kernel") == 0) && Next)
+		{
+			KernelName = Next;
+			++ArgIndex;
+		}
+		else if ((strcmp(Arg, "-scale") == 0) && Next)
+		{
+			ScaleName = Next;
+			++ArgIndex;
+		}
+		else if ((strcmp(Arg, "-effects") == 0) && Next && ParseEffects(Next, &EffectKey))
+		{
+			EffectList = Next;
+			++ArgIndex;
+		}
+		else if ((strcmp(Arg, "-hdr") == 0) && Next && ((strcmp(Next, "scrgb") == 0) || (strcmp(Next, "pq") == 0)))
+		{
+			Format = (strcmp(Next, "scrgb") == 0) ? SurfaceFormat_RGBA16F : SurfaceFormat_RGB10A2;
+			++ArgIndex;
+		}
+		else if ((strcmp(Arg, "-white") == 0) && Next && (atof(Next) >= 1.0))
+		{
+			// @Note Nits, what Windows calls the SDR content brightness
+			WhiteNits = (float)atof(Next);
+			++ArgIndex;
+		}
+		else if (strcmp(Arg, "-direct") == 0)
+		{
+			Direct = true;
+		}
+		else if (strcmp(Arg, "-ring") == 0)
+		{
+			CaptureRings = true;
+		}
+#if X11_CAPTURE
+		else if (strcmp(Arg, "-x11") == 0)
+		{
+			CaptureX11 = true;
+		}
+#endif
+#if OPENGL_COMPOSITOR
+		else if (strcmp(Arg, "-gl") == 0)
+		{
+			DrawWithOpenGL = true;
+		}
+#endif
+#if OPENGL_COMPOSITOR && X11_CAPTURE
+		else if (strcmp(Arg, "-window") == 0)
+		{
+			DrawWithOpenGL = true;
+			ShowWindows = true;
+		}
+#endif
+		else if ((strcmp(Arg, "-bench") == 0) && Next)
+		{
+			return RunBenchmark(Next) ? 0 : 1;
+		}
+		else
+		{
+			fprintf(stderr, "Usage: %s [-frames N] [-monitor WxH] [-display WxH] [-static] [-drag N] [-resize N] [-rotate 0|90|180|270] [-dpi S] [-overlays N]\n"
+					"       %*s [-outputs N] [-span] [-pace latency|source|FPS] [-latency FILE.csv|FILE.json]\n"
+					"       %*s [-kernel scalar|sse2|avx2|neon] [-threads N] [-affinity] [-coarse] [-nohash] [-record FILE] [-export /NAME]\n"
+					"       %*s [-yuv nv12|i420] [-bt709] [-fullrange]\n"
+					"       %*s [-scale bilinear|nearest|mip|bicubic|lanczos] [-effects key,grayscale,contrast,edges]\n"
+					"       %*s [-hdr scrgb|pq] [-white NITS] [-direct] [-ring] [-x11] [-gl] [-window]\n"
+					"       %s -replay FILE [-kernel NAME] [-threads N] [-affinity]\n"
+					"       %s -bench atlas|pacing|latency|shade|tiles|record|hash|scale|colour|ring|device|cache|x11|opengl|export|yuv|effects|damage|exchange|queue|mapping|stitch\n", Args[0], (int)strlen(Args[0]), "", (int)strlen(Args[0]), "",
+					(int)strlen(Args[0]), "", (int)strlen(Args[0]), "", (int)strlen(Args[0]), "", Args[0], Args[0]);
+			return 1;
+		}
+	}
+	
+	// @Note -monitor is the desktop as the user sees it in physical pixels, the window thread
+	// sees it shrunk by the DPI scale the way a process that isn't DPI aware does
+	display_rotation Rotation = (display_rotation)((RotationAngle / 90) & 3);
+	int LogicalWidth  = (int)((float)MonitorWidth  / DpiScale);
+	int LogicalHeight = (int)((float)MonitorHeight / DpiScale);
+	
+	if ((DisplayWidth > LogicalWidth) || (DisplayHeight > LogicalHeight))
+	{
+		Error("Display must fit on the monitor");
+	}
+	
+	// @Note -resize shrinks the cut box and grows the display by this much and back, like a drag and a Ctrl-drag would
+	int ResizeStep = 64;
+	if (ResizeEvery && ((DisplayWidth + ResizeStep > LogicalWidth) || (DisplayHeight + ResizeStep > LogicalHeight) ||
+						(DisplayWidth <= ResizeStep) || (DisplayHeight <= ResizeStep)))
+	{
+		Error("Display has to stay on the monitor and bigger than the resize step");
+	}
+	
+	if (Span && (OutputCount < 2))
+	{
+		Error("Spanning needs a second output");
+	}
+	
+	// @Note A recording, the export ring and the YUV are of the software compositor's display texture, and a replay draws with it
+	if (DrawWithOpenGL && (RecordPath || ReplayPath || ExportName || ConvertYUV))
+	{
+		Error("-gl can't record, replay, export or convert to YUV");
+	}
+
+#if X11_CAPTURE
+	// @Note -x11 captures the X display in $DISPLAY instead of the synthetic desktop. Its root is the one output,
+	// so the monitor is whatever size that is and the rest of the synthetic desktop's options don't apply.
+	x11_source X11Source;
+	if (CaptureX11)
+	{
+		if ((OutputCount > 1) || Rotation || (DpiScale != 1.0f) || (Format != SurfaceFormat_BGRA8) || IsStatic || Coarse)
+		{
+			Error("-x11 is one unrotated SDR output at 1x");
+		}
+		
+		if (!InitializeX11Source(&X11Source, NULL))
+		{
+			Error("Can't capture the X display, it needs MIT-SHM and 32 bits a pixel");
+		}
+		
+		MonitorWidth  = LogicalWidth  = X11Source.Surface.Width;
+		MonitorHeight = LogicalHeight = X11Source.Surface.Height;
+		if ((DisplayWidth > LogicalWidth) || (DisplayHeight > LogicalHeight))
+		{
+			Error("Display must fit on the X display");
+		}
+	}
+#endif
+	
+	//
+	// Memory
+	//
+	
+	// @Note An HDR output has its encoded surface next to the desktop
+	size_t PixelSize  = BITMAP_BYTES_PER_PIXEL + ((Format != SurfaceFormat_BGRA8) ? GetSurfaceBytesPerPixel(Format) : 0);
+	size_t MemorySize = Megabytes(16) + (size_t)OutputCount * MonitorWidth * MonitorHeight * PixelSize;
+	void *Memory = mmap(NULL, MemorySize, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+	if (Memory == MAP_FAILED)
+	{
+		Error("mmap");
+	}
+	
+	memory_arena Arena;
+	InitializeArena(&Arena, Memory, MemorySize);
+	
+	//
+	// Pipeline
+	//
+	
+	// @Note -outputs puts that many of the same monitor side by side, left to right, the first one is the primary.
+	// No events, so the workers get stepped on the render thread and every run is the same.
+	synthetic_desktop *Desktop = PushStruct(&Arena, synthetic_desktop);
+	Desktop->OutputCount = (u32)OutputCount;
+	
+	multi_output_source *Multi = PushStruct(&Arena, multi_output_source);
+	InitializeMultiOutputSource(Multi, NULL, NULL, NULL);
+	
+	software_ring_copier *Copier = PushStruct(&Arena, software_ring_copier);
+	Copier->AllocateMemory = LinuxAllocateMemory;
+	Copier->FreeMemory     = LinuxFreeMemory;
+	
+	box Outputs[MAX_OUTPUTS];
+	for (int OutputIndex = 0; OutputIndex < OutputCount; ++OutputIndex)
+	{
+		synthetic_source *Source = &Desktop->Outputs[OutputIndex];
+		InitializeSyntheticSource(Source, &Arena, MonitorWidth, MonitorHeight, Rotation, OutputIndex * MonitorWidth, 0);
+		Source->IsStatic         = IsStatic;
+		Source->CoarseDirtyRects = Coarse;
+		
+		frame_source OutputSource = SyntheticFrameSource(Source);
+#if X11_CAPTURE
+		if (CaptureX11)
+		{
+			OutputSource = X11FrameSource(&X11Source);
+		}
+#endif
+		
+		output_worker *Worker = AddOutputWorker(Multi, OutputSource, NULL);
+		if (CaptureRings)
+		{
+			Worker->CaptureRing = PushStruct(&Arena, capture_ring);
+			InitializeCaptureRing(Worker->CaptureRing, SoftwareRingCopy, Copier);
+		}
+		
+		Outputs[OutputIndex] = box{ OutputIndex * LogicalWidth, 0, (OutputIndex + 1) * LogicalWidth, LogicalHeight };
+	}
+	
+	software_compositor *Compositor = PushStruct(&Arena, software_compositor);
+	InitializeSoftwareCompositor(Compositor, LinuxAllocateMemory, LinuxFreeMemory);
+	
+	Compositor->TilePool  = CreateTilePool(&Arena, (u32)ThreadCount, Pin);
+	Compositor->HashTiles = HashTiles;
+	
+	if (KernelName)
+	{
+		int Kernel = 0;
+		while ((Kernel < ShadeKernel_Count) && (strcmp(KernelName, ShadeKernelNames[Kernel]) != 0))
+		{
+			++Kernel;
+		}
+		
+		if ((Kernel == ShadeKernel_Count) || !SetShadeKernel(Compositor, (shade_kernel)Kernel))
+		{
+			Error("No such shade kernel on this machine");
+		}
+	}
+	
+	// @Note After the kernel, the source encodes with the same one
+	for (int OutputIndex = 0; OutputIndex < OutputCount; ++OutputIndex)
+	{
+		SetSyntheticFormat(&Desktop->Outputs[OutputIndex], &Arena, Format, WhiteNits, Compositor->ShadeKernel);
+	}
+	
+	if (ReplayPath)
+	{
+		return ReplayRecording(ReplayPath, Compositor);
+	}
+
+#if OPENGL_COMPOSITOR
+	// @Note -gl draws with the GL compositor instead, the software one is only there for the synthetic source's kernel.
+	// -window does too and shows every overlay in a window on the X display.
+	linux_opengl OpenGL;
+	opengl_platform GLPlatform;
+	opengl_compositor *GLCompositor = NULL;
+	if (DrawWithOpenGL)
+	{
+		const char *FailedStep = InitializeLinuxOpenGL(&OpenGL, ShowWindows);
+		if (FailedStep)
+		{
+			fprintf(stderr, "%s\n", FailedStep);
+			Error("No GL 3.3 core context through EGL");
+		}
+		
+		GLPlatform   = LinuxOpenGLPlatform(&OpenGL);
+		GLCompositor = PushStruct(&Arena, opengl_compositor);
+		if (!InitializeOpenGLCompositor(GLCompositor, &GLPlatform))
+		{
+			fprintf(stderr, "%s: %s\n", GLCompositor->FailedName, GLCompositor->ShaderLog);
+			Error("Can't make the GL compositor");
+		}
+	}
+#endif
+	
+	// @Note Stands in for the window thread
+	render_state WindowState = DefaultRenderState(Outputs, (u32)OutputCount, DisplayWidth, DisplayHeight);
+	WindowState.Pacing = Pacing;
+	
+	if (ScaleName)
+	{
+		int Scale = 0;
+		while ((Scale < ScaleMode_Count) && (strcmp(ScaleName, ScaleModeNames[Scale]) != 0))
+		{
+			++Scale;
+		}
+		
+		if (Scale == ScaleMode_Count)
+		{
+			Error("No such scaling mode");
+		}
+		
+		WindowState.Shade.Scale = (scale_mode)Scale;
+	}
+	
+	// @Note The chain draws bilinear whatever the scaling mode, see GetShadeScale
+	WindowState.Shade.Effects.Key = EffectKey;
+	
+	if (Span)
+	{
+		// @Note Half on the primary, half on the one to its right
+		box *CutBox = &WindowState.Overlays[0].CutBox;
+		CutBox->Right = LogicalWidth + DisplayWidth / 2;
+		CutBox->Left  = CutBox->Right - DisplayWidth;
+	}
+	
+	// @Note The rest go left along the bottom then up a row, each a bit smaller so the atlas has mixed sizes
+	for (int OverlayIndex = 1; OverlayIndex < OverlayCount; ++OverlayIndex)
+	{
+		int Width  = Max(DisplayWidth  - OverlayIndex * 16, 16);
+		int Height = Max(DisplayHeight - OverlayIndex * 8,  16);
+		int Column = OverlayIndex % 4;
+		int Row    = OverlayIndex / 4;
+		
+		box CutBox;
+		CutBox.Right  = Max(LogicalWidth  - Column * DisplayWidth, Width);
+		CutBox.Bottom = Max(LogicalHeight - Row * DisplayHeight, Height);
+		CutBox.Left   = CutBox.Right  - Width;
+		CutBox.Top    = CutBox.Bottom - Height;
+		
+		AddOverlay(&WindowState, CutBox, Width, Height);
+	}
+	
+	render_state_exchange *StateExchange = PushStruct(&Arena, render_state_exchange);
+	InitializeRenderStateExchange(StateExchange, &WindowState);
+	
+	render_command_queue *Commands = PushStruct(&Arena, render_command_queue);
+	*Commands = {};
+	
+	overlay_pipeline Pipeline = {};
+	Pipeline.Source        = MultiOutputFrameSource(Multi);
+	Pipeline.Compositor    = SoftwareCompositor(Compositor);
+	Pipeline.Clock         = SyntheticClock(Desktop);
+	Pipeline.StateExchange = StateExchange;
+
+#if OPENGL_COMPOSITOR
+	if (GLCompositor)
+	{
+		Pipeline.Compositor = OpenGLCompositor(GLCompositor);
+	}
+#endif
+	
+	if (CaptureX11)
+	{
+		Pipeline.Clock.Context = NULL;
+		Pipeline.Clock.Now     = LinuxClockNow;
+	}
+	Pipeline.Commands      = Commands;
+	
+	// @Note The recording, the export and the YUV are of the display texture, which a sampled frame never goes through
+	Pipeline.SampleSurfaces = Direct && !RecordPath && !ExportName && !ConvertYUV;
+	
+	// @Note Workers get stepped on the render thread here, so they can share its ring. The drain happens
+	// between frames outside the timing, on Windows a thread of its own does it.
+	latency_recorder *LatencyRecorder = NULL;
+	if (LatencyPath)
+	{
+		latency_ring *LatencyRing = PushStruct(&Arena, latency_ring);
+		InitializeLatencyRing(LatencyRing, GetNanoseconds);
+		
+		LatencyRecorder = PushStruct(&Arena, latency_recorder);
+		InitializeLatencyRecorder(LatencyRecorder);
+		AddLatencyRing(LatencyRecorder, LatencyRing);
+		
+		Pipeline.LatencyRing = LatencyRing;
+		for (u32 WorkerIndex = 0; WorkerIndex < Multi->WorkerCount; ++WorkerIndex)
+		{
+			Multi->Workers[WorkerIndex].LatencyRing = LatencyRing;
+		}
+	}
+	
+	// @Note Every presented frame's display texture goes to the file, timed apart from the frame
+	recording_writer *Recorder = NULL;
+	FILE *RecordFile = NULL;
+	u64 RecordTime = 0;
+	if (RecordPath)
+	{
+		Recorder = PushStruct(&Arena, recording_writer);
+		InitializeRecordingWriter(Recorder, LinuxAllocateMemory, LinuxFreeMemory);
+		
+		recording_header Header = GetRecordingHeader();
+		RecordFile = fopen(RecordPath, "wb");
+		if (!RecordFile || (fwrite(&Header, sizeof(Header), 1, RecordFile) != 1))
+		{
+			Error("Can't write the recording");
+		}
+	}
+	
+	// @Note Every presented frame's display texture goes into the ring for other processes, a slot takes a monitor's
+	// worth of pixels an output. A loop frame that presented more than once only has the last one left to export.
+	export_ring *Exporter = NULL;
+	u64 ExportSize = 0;
+	u64 ExportedCount = 0;
+	u64 ExportTime = 0;
+	if (ExportName)
+	{
+		u64 PixelBytes = (u64)OutputCount * MonitorWidth * MonitorHeight * BITMAP_BYTES_PER_PIXEL;
+		ExportSize = GetExportRingSize(EXPORT_RING_SLOT_COUNT, PixelBytes);
+		
+		void *ExportMemory = CreateLinuxSharedMemory(ExportName, ExportSize);
+		if (!ExportMemory)
+		{
+			Error("Can't make the shared memory for the export ring");
+		}
+		
+		Exporter = PushStruct(&Arena, export_ring);
+		InitializeExportRing(Exporter, ExportMemory, EXPORT_RING_SLOT_COUNT, PixelBytes);
+	}
+	
+	// @Note The presented crops converted to YUV by the shade kernel's instruction set, only the tiles the change
+	// detector says are new. With an export ring it is the YUV that goes into it, the BGRA never does.
+	yuv_converter *Converter = NULL;
+	u64 ConvertTime = 0;
+	if (ConvertYUV)
+	{
+		Converter = PushStruct(&Arena, yuv_converter);
+		InitializeYUVConverter(Converter, LinuxAllocateMemory, LinuxFreeMemory, YUVFormat, Compositor->ShadeKernel);
+	}
+	
+	//
+	// Render loop
+	//
+	
+	u64 TotalTime = 0;
+	u64 MinTime   = (u64)-1;
+	u64 MaxTime   = 0;
+	
+	// @Note The first frame sizes everything, what comes after should not need to allocate
+	u64 FirstFrameAllocations = 0;
+	
+	for (int FrameIndex = 0; FrameIndex < FrameCount; ++FrameIndex)
+	{
+		if (DragEvery && (FrameIndex > 0) && ((FrameIndex % DragEvery) == 0))
+		{
+			// @Note Nudge the cut box back and forth like a drag on the window thread would
+			int Offset = ((FrameIndex / DragEvery) & 1) ? -1 : 1;
+			WindowState.Overlays[0].CutBox.Left  += Offset;
+			WindowState.Overlays[0].CutBox.Right += Offset;
+			WindowState.Version++;
+			PublishRenderState(StateExchange, &WindowState);
+			
+			render_command Command;
+			Command.Type      = RenderCommand_StateChanged;
+			Command.IssueTime = Pipeline.Clock.Now(Pipeline.Clock.Context);
+			PushRenderCommand(Commands, Command);
+		}
+		
+		if (ResizeEvery && (FrameIndex > 0) && ((FrameIndex % ResizeEvery) == 0))
+		{
+			// @Note Odd steps resize the cut box, even ones the display, each goes back two steps later
+			int Step = FrameIndex / ResizeEvery;
+			int Grow = ((Step / 2) & 1) ? ResizeStep : -ResizeStep;
+			if ((Step & 1) == 0)
+			{
+				WindowState.Overlays[0].DisplayWidth  += Grow;
+				WindowState.Overlays[0].DisplayHeight += Grow;
+			}
+			else
+			{
+				WindowState.Overlays[0].CutBox.Left -= Grow;
+				WindowState.Overlays[0].CutBox.Top  -= Grow;
+			}
+			
+			WindowState.Version++;
+			PublishRenderState(StateExchange, &WindowState);
+			
+			render_command Command;
+			Command.Type      = RenderCommand_StateChanged;
+			Command.IssueTime = Pipeline.Clock.Now(Pipeline.Clock.Context);
+			PushRenderCommand(Commands, Command);
+		}
+		
+		u64 StartTime = GetMicroseconds();
+		RunOverlayFrame(&Pipeline, WAIT_SLICE_MS);
+		u64 FrameTime = GetMicroseconds() - StartTime;
+		
+		TotalTime += FrameTime;
+		MinTime    = Min(MinTime, FrameTime);
+		MaxTime    = Max(MaxTime, FrameTime);
+		
+		if (FrameIndex == 0)
+		{
+			FirstFrameAllocations = AllocationCount;
+		}
+		
+		if (Recorder && (Compositor->PresentCount > Recorder->FrameCount))
+		{
+			u64 RecordStart = GetNanoseconds();
+			software_shade_batch *Batch = &Compositor->ShadeBatch;
+			size_t Size = EncodeRecordingFrame(Recorder, &Compositor->DisplayTexture, Pipeline.Clock.Now(Pipeline.Clock.Context),
+											   Batch->Setups, Batch->SetupCount, Batch->ScaleMode, Compositor->BackBuffer.Width, Compositor->BackBuffer.Height);
+			if (!Size || (fwrite(Recorder->Buffer, 1, Size, RecordFile) != Size))
+			{
+				Error("Can't write the recording");
+			}
+			RecordTime += GetNanoseconds() - RecordStart;
+		}
+		
+		if ((Exporter || Converter) && (Pipeline.PresentedFrameCount > ExportedCount))
+		{
+			ExportedCount = Pipeline.PresentedFrameCount;
+			
+			export_frame Frame;
+			GetExportFrame(&Frame, Pipeline.Pieces, Pipeline.PieceCount, Compositor->CropAtlas.Slots, Pipeline.Clock.Now(Pipeline.Clock.Context));
+			
+			if (Converter)
+			{
+				u64 ConvertStart = GetNanoseconds();
+				box Regions[MAX_CROP_PIECES];
+				for (u32 PieceIndex = 0; PieceIndex < Frame.PieceCount; ++PieceIndex)
+				{
+					Regions[PieceIndex] = Frame.Pieces[PieceIndex].Slot;
+				}
+				
+				ConvertToYUV(Converter, &Compositor->DisplayTexture, Regions, Frame.PieceCount, &Compositor->Changes);
+				ConvertTime += GetNanoseconds() - ConvertStart;
+			}
+			
+			if (Exporter)
+			{
+				u64 ExportStart = GetNanoseconds();
+				if (Converter)
+				{
+					WriteExportRingYUV(Exporter, &Frame, &Converter->Image);
+				}
+				else
+				{
+					WriteExportRing(Exporter, &Frame, &Compositor->DisplayTexture);
+				}
+				ExportTime += GetNanoseconds() - ExportStart;
+			}
+		}
+		
+		if (LatencyRecorder && ((FrameIndex % LATENCY_DRAIN_FRAMES) == 0))
+		{
+			DrainLatencyRings(LatencyRecorder);
+		}
+	}
+	
+	overlay_region *Overlay = &WindowState.Overlays[0];
+	box SurfaceBox = Pipeline.Pieces[0].Mapping.SurfaceBox;
+	printf("%d x monitor %dx%d rotated %d at %.2fx, %d overlays, first cut %dx%d -> surface %d,%d %dx%d -> display %dx%d\n",
+		   OutputCount, MonitorWidth, MonitorHeight, RotationAngle % 360, DpiScale, OverlayCount,
+		   GetBoxWidth(Overlay->CutBox), GetBoxHeight(Overlay->CutBox), SurfaceBox.Left, SurfaceBox.Top,
+		   GetBoxWidth(SurfaceBox), GetBoxHeight(SurfaceBox), Overlay->DisplayWidth, Overlay->DisplayHeight);
+	printf("frames %llu acquired, %llu presented, %llu skipped, %llu pixels cropped\n",
+		   (unsigned long long)Pipeline.AcquiredFrameCount, (unsigned long long)Pipeline.PresentedFrameCount,
+		   (unsigned long long)Pipeline.SkippedFrameCount, (unsigned long long)Pipeline.CroppedPixelCount);
+	
+	if (OutputCount > 1)
+	{
+		printf("outputs %u pieces, frames per output", Pipeline.PieceCount);
+		for (int OutputIndex = 0; OutputIndex < OutputCount; ++OutputIndex)
+		{
+			printf(" %llu", (unsigned long long)Multi->FrameCount[OutputIndex]);
+		}
+		printf("\n");
+	}
+	
+	if (CaptureRings)
+	{
+		u64 WrittenCount = 0;
+		u64 DroppedCount = 0;
+		u64 CopiedBytes  = 0;
+		for (u32 WorkerIndex = 0; WorkerIndex < Multi->WorkerCount; ++WorkerIndex)
+		{
+			capture_ring *Ring = Multi->Workers[WorkerIndex].CaptureRing;
+			WrittenCount += Ring->WrittenCount;
+			DroppedCount += Ring->DroppedCount;
+			CopiedBytes  += Ring->CopiedBytes;
+		}
+		
+		printf("ring %llu copies written, %llu dropped, %.1fKB copied into the ring, frames released right after the copy\n",
+			   (unsigned long long)WrittenCount, (unsigned long long)DroppedCount, GetKilobytes(CopiedBytes));
+	}
+
+#if X11_CAPTURE
+	if (CaptureX11)
+	{
+		u64 WholeBytes = (u64)X11Source.Surface.Pitch * X11Source.Surface.Height;
+		printf("x11 %dx%d, %s, %llu frames (%llu whole), %llu damage events, %llu bands, %.1fKB fetched, %.1f%% of whole grabs\n",
+			   X11Source.Surface.Width, X11Source.Surface.Height, X11Source.DamageLibrary ? "XDamage" : "polling without XDamage",
+			   (unsigned long long)X11Source.FrameCount, (unsigned long long)X11Source.WholeFrameCount,
+			   (unsigned long long)X11Source.DamageEventCount, (unsigned long long)X11Source.BandCount,
+			   GetKilobytes(X11Source.FetchedBytes), 100.0 * X11Source.FetchedBytes / Max(WholeBytes * X11Source.FrameCount, 1ull));
+		
+		CloseX11Source(&X11Source);
+	}
+#endif
+	
+	frame_pacer *Pacer = &Pipeline.Pacer;
+	printf("pacing %s", GetPacingModeName(Pacing.Mode));
+	if (Pacing.Mode == PacingMode_FixedCap)
+	{
+		printf(" %ufps", Pacing.CapRate);
+	}
+	printf(", %llu dropped, jitter avg %.2fus, max %lluus (source clock)\n", (unsigned long long)Pacer->DroppedFrameCount,
+		   Pacer->JitterCount ? (double)Pacer->JitterTotal / Pacer->JitterCount : 0.0, (unsigned long long)Pacer->JitterMax);
+	
+	if (Pipeline.CommandCount > 0)
+	{
+		printf("commands %llu on screen, latency avg %.2fus, max %lluus (source clock)\n",
+			   (unsigned long long)Pipeline.CommandCount, (double)Pipeline.CommandLatencyTotal / Pipeline.CommandCount,
+			   (unsigned long long)Pipeline.CommandLatencyMax);
+	}
+	
+	if (FrameCount > 0)
+	{
+		printf("frame time avg %.2fus, min %lluus, max %lluus\n", (double)TotalTime / FrameCount,
+			   (unsigned long long)MinTime, (unsigned long long)MaxTime);
+	}
+	
+	if (Recorder)
+	{
+		fclose(RecordFile);
+		
+		bitmap *Target = &Compositor->BackBuffer;
+		u64 FrameTotal = Max(Recorder->FrameCount, 1ull);
+		u64 TileTotal  = Max(Recorder->SameTileCount + Recorder->EncodedTileCount + Recorder->RawTileCount, 1ull);
+		printf("record %llu frames, %llu keyframes, %.1fKB, %.2fKB per frame, tiles %.1f%% same %.1f%% encoded %.1f%% raw\n",
+			   (unsigned long long)Recorder->FrameCount, (unsigned long long)Recorder->KeyframeCount,
+			   GetKilobytes(Recorder->ByteCount + sizeof(recording_header)), GetKilobytes(Recorder->ByteCount) / FrameTotal,
+			   100.0 * Recorder->SameTileCount / TileTotal, 100.0 * Recorder->EncodedTileCount / TileTotal,
+			   100.0 * Recorder->RawTileCount / TileTotal);
+		printf("record encode avg %.2fus, last frame %016llx\n", (double)RecordTime / FrameTotal / 1000.0,
+			   (unsigned long long)HashBytes(Target->Memory, (size_t)Target->Pitch * Target->Height));
+	}
+	
+	if (Converter)
+	{
+		u64 TileTotal = Max(Converter->ConvertedTileCount + Converter->UnchangedTileCount, 1ull);
+		printf("yuv %s %s %s, %llu frames, %llu tiles converted and %llu unchanged (%.1f%% skipped), convert avg %.2fus, %.1f Mpixel/s\n",
+			   YUVLayoutNames[YUVFormat.Layout], YUVMatrixNames[YUVFormat.Matrix], YUVRangeNames[YUVFormat.Range],
+			   (unsigned long long)Converter->FrameCount, (unsigned long long)Converter->ConvertedTileCount,
+			   (unsigned long long)Converter->UnchangedTileCount, 100.0 * Converter->UnchangedTileCount / TileTotal,
+			   (double)ConvertTime / Max(Converter->FrameCount, 1ull) / 1000.0,
+			   (double)Converter->ConvertedPixelCount * 1000.0 / (double)Max(ConvertTime, 1ull));
+		FreeYUVConverter(Converter);
+	}
+	
+	if (Exporter)
+	{
+		// @Note Readers that still have it mapped keep it until they let go
+		printf("export %llu frames into %s, %u slots, %.1fKB shared, %llu too big for a slot, %.1fKB written, write avg %.2fus\n",
+			   (unsigned long long)Exporter->WrittenCount, ExportName, EXPORT_RING_SLOT_COUNT, GetKilobytes(ExportSize),
+			   (unsigned long long)Exporter->TooBigCount, GetKilobytes(Exporter->WrittenBytes),
+			   (double)ExportTime / Max(Exporter->WrittenCount, 1ull) / 1000.0);
+		
+		munmap(Exporter->Header, ExportSize);
+		shm_unlink(ExportName);
+	}
+	
+	if (LatencyRecorder)
+	{
+		DrainLatencyRings(LatencyRecorder);
+		
+		for (u32 Stage = 0; Stage < LatencyStage_Count; ++Stage)
+		{
+			latency_histogram *Histogram = &LatencyRecorder->Histograms[Stage];
+			if (Histogram->Count)
+			{
+				printf("latency %-18s %7llu samples, p50 %8.2fus, p99 %8.2fus, max %8.2fus\n", LatencyStageNames[Stage],
+					   (unsigned long long)Histogram->Count, GetLatencyPercentile(Histogram, 5000) / 1000.0,
+					   GetLatencyPercentile(Histogram, 9900) / 1000.0, Histogram->Max / 1000.0);
+			}
+		}
+		
+		size_t PathLength = strlen(LatencyPath);
+		bool IsJSON = (PathLength >= 5) && (strcmp(LatencyPath + PathLength - 5, ".json") == 0);
+		
+		text_buffer Text;
+		Text.Size   = Megabytes(1);
+		Text.Used   = 0;
+		Text.Memory = (char *)PushSize(&Arena, Text.Size);
+		WriteLatencyReport(LatencyRecorder, IsJSON ? LatencyFormat_JSON : LatencyFormat_CSV, &Text);
+		
+		FILE *File = fopen(LatencyPath, "wb");
+		if (!File || (fwrite(Text.Memory, 1, Text.Used, File) != Text.Used))
+		{
+			Error("Can't write the latency report");
+		}
+		fclose(File);
+	}
+	
+	compositor_memory *Report = Pipeline.Compositor.Memory;
+	u64 MonitorBytes = (u64)MonitorWidth * MonitorHeight * BITMAP_BYTES_PER_PIXEL;
+	printf("memory texture %.1fKB, pool %.1fKB (%u allocated, %u reused), back buffer %.1fKB (%u resizes)\n",
+		   GetKilobytes(Report->TextureBytes), GetKilobytes(Report->PooledBytes), Report->TextureAllocationCount,
+		   Report->TextureReuseCount, GetKilobytes(Report->SwapChainBytes), Report->SwapChainResizeCount);
+	printf("memory total %.1fKB, monitor-sized texture and back buffer per overlay would be %.1fKB\n",
+		   GetKilobytes(Report->PooledBytes + Report->SwapChainBytes), GetKilobytes(2 * MonitorBytes * OverlayCount));
+	compositor_traffic *Traffic = Pipeline.Compositor.Traffic;
+	printf("traffic %llu copies, %.1fKB copied, %.2fKB per present, %llu pieces drawn from the surface",
+		   (unsigned long long)Traffic->CopyCount, GetKilobytes(Traffic->CopiedBytes),
+		   GetKilobytes(Traffic->CopiedBytes) / Max(Pipeline.PresentedFrameCount, 1ull), (unsigned long long)Traffic->SampleCount);
+	if (Pipeline.SampleSurfaces)
+	{
+		printf(", %llu frames composed from the surface, %llu pieces copied to outlive their frame",
+			   (unsigned long long)Pipeline.SampledFrameCount, (unsigned long long)Pipeline.MaterializedCount);
+	}
+	printf("\n");
+	printf("shade kernel %s\n", ShadeKernelNames[Compositor->ShadeKernel]);
+	if (EffectKey)
+	{
+		printf("effects %s, key 0x%x\n", EffectList, EffectKey);
+	}
+	
+	if (Format != SurfaceFormat_BGRA8)
+	{
+		printf("colour %s at %.0f nits white, converted during the crop\n", (Format == SurfaceFormat_RGBA16F) ? "scRGB" : "HDR10 PQ", WhiteNits);
+	}
+
+#if OPENGL_COMPOSITOR
+	// @Note The rest is about the software compositor, which didn't draw anything
+	if (GLCompositor)
+	{
+		opengl_functions *GL = &OpenGL.Functions;
+		printf("opengl %s, %s, %s scaling, %llu presents\n", (const char *)GL->GetString(GL_RENDERER), (const char *)GL->GetString(GL_VERSION),
+			   ScaleModeNames[GetShadeScale(&WindowState.Shade)], (unsigned long long)GLCompositor->PresentCount);
+		
+		device_registry *Registry = &GLCompositor->Registry;
+		printf("opengl context %s, %u resets recovered (%u attempts failed), slowest %.1fms\n",
+			   OpenGL.IsRobust ? "lost on a reset" : "without robustness", Registry->RebuildCount, Registry->FailedRebuildCount,
+			   (double)Registry->MaxRecoveryTime / 1000000.0);
+		printf("atlas crops %dx%d (%u rebuilds), displays %dx%d (%u rebuilds)\n",
+			   GLCompositor->CropAtlas.Packer.Width, GLCompositor->CropAtlas.Packer.Height, GLCompositor->CropAtlas.RebuildCount,
+			   GLCompositor->BackBufferWidth, GLCompositor->BackBufferHeight, GLCompositor->DisplayAtlas.RebuildCount);
+		
+		CloseLinuxOpenGL(&OpenGL);
+		return 0;
+	}
+#endif
+	
+	if (GetShadeScale(&WindowState.Shade) != ScaleMode_Bilinear)
+	{
+		scaler *Scaler = &Compositor->Scaler;
+		printf("scale %s, %llu weight tables built and %llu reused, %llu mip texels built\n", ScaleModeNames[WindowState.Shade.Scale],
+			   (unsigned long long)Scaler->TableBuildCount, (unsigned long long)Scaler->TableHitCount, (unsigned long long)Scaler->MipTexelCount);
+	}
+	
+	if (Pipeline.UnchangedCropCount)
+	{
+		change_detector *Changes = &Compositor->Changes;
+		printf("hash %llu crops came out unchanged and weren't drawn, %llu of %llu tiles hashed changed\n",
+			   (unsigned long long)Pipeline.UnchangedCropCount, (unsigned long long)Changes->ChangedTileCount,
+			   (unsigned long long)Changes->HashedTileCount);
+	}
+	
+	if (Compositor->TilePool)
+	{
+		tile_pool *Pool = Compositor->TilePool;
+		printf("tiles %u threads%s, %llu batches, %llu tiles stolen, %llu allocations after the first frame\n", Pool->WorkerCount,
+			   Pin ? " pinned" : "", (unsigned long long)Pool->BatchCount, (unsigned long long)GetStolenTileCount(Pool),
+			   (unsigned long long)(AllocationCount - FirstFrameAllocations));
+	}
+	printf("atlas crops %dx%d (%u rebuilds), displays %dx%d (%u rebuilds)\n",
+		   Compositor->CropAtlas.Packer.Width, Compositor->CropAtlas.Packer.Height, Compositor->CropAtlas.RebuildCount,
+		   Compositor->BackBuffer.Width, Compositor->BackBuffer.Height, Compositor->DisplayAtlas.RebuildCount);
+	
+	return 0;
+}
@@ -0,0 +1,509 @@
+//
+// OpenGL context for the GL compositor, through EGL so it needs no window or X server
+//
+// @Note Mesa's surfaceless platform when it is there, which is how llvmpipe runs headless. Anything else gets
+// the default display. The context is current on the calling thread, the render thread. It is made to be lost on a
+// reset where the driver can, and the compositor makes another through LinuxOpenGLPlatform when it is.
+//
+// With windows the display is the X server's instead, and every overlay gets a 32-bit window on it: transparent
+// where the compositing manager blends it, click-through and over everything else, see CreateLinuxOpenGLWindow.
+//
+
+#include <EGL/egl.h>
+#include <EGL/eglext.h>
+
+#if X11_CAPTURE
+// @Note Away from the screen's top right corner, where overlays go with nothing to place them
+#define OPENGL_WINDOW_MARGIN 16
+
+struct linux_opengl_window
+{
+	Window Handle;
+	EGLSurface Surface;
+	int Left;
+	int Top;
+	int Width;
+	int Height;
+	bool IsMapped;
+};
+#endif
+
+struct linux_opengl
+{
+	EGLDisplay Display;
+	EGLConfig  Config;
+	EGLContext Context;
+	
+	// @Note The driver can lose it on a reset and tell, see OpenGLContextWasReset
+	bool IsRobust;
+	bool CanBeRobust;
+	
+	opengl_functions Functions;
+
+#if X11_CAPTURE
+	// @Note Only with windows, the X connection is ours and only the render thread talks on it
+	::Display *Connection;
+	Visual *WindowVisual;
+	Colormap WindowColormap;
+	int NextWindowTop;
+	linux_opengl_window Windows[MAX_OVERLAYS];
+#endif
+};
+
+internal PLATFORM_GET_OPENGL_FUNCTION(LinuxGetOpenGLFunction)
+{
+	return (void *)eglGetProcAddress(FunctionName);
+}
+
+internal bool HasEGLExtension(const char *Extensions, const char *Name)
+{
+	size_t NameLength = strlen(Name);
+	for (const char *At = Extensions; At && (At = strstr(At, Name)); At += NameLength)
+	{
+		bool StartsWord = (At == Extensions) || (At[-1] == ' ');
+		bool EndsWord   = (At[NameLength] == ' ') || (At[NameLength] == 0);
+		if (StartsWord && EndsWord)
+		{
+			return true;
+		}
+	}
+	
+	return false;
+}
+
+internal void CloseLinuxOpenGL(linux_opengl *OpenGL)
+{
+	if (OpenGL->Display != EGL_NO_DISPLAY)
+	{
+		eglMakeCurrent(OpenGL->Display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		if (OpenGL->Context != EGL_NO_CONTEXT)
+		{
+			eglDestroyContext(OpenGL->Display, OpenGL->Context);
+		}
+
+#if X11_CAPTURE
+		for (u32 WindowIndex = 0; WindowIndex < MAX_OVERLAYS; ++WindowIndex)
+		{
+			linux_opengl_window *Window = &OpenGL->Windows[WindowIndex];
+			if (Window->Surface != EGL_NO_SURFACE)
+			{
+				eglDestroySurface(OpenGL->Display, Window->Surface);
+			}
+			
+			if (Window->Handle)
+			{
+				XDestroyWindow(OpenGL->Connection, Window->Handle);
+			}
+			
+			*Window = {};
+		}
+#endif
+		
+		eglTerminate(OpenGL->Display);
+	}
+
+#if X11_CAPTURE
+	if (OpenGL->Connection)
+	{
+		if (OpenGL->WindowColormap)
+		{
+			XFreeColormap(OpenGL->Connection, OpenGL->WindowColormap);
+		}
+		
+		XCloseDisplay(OpenGL->Connection);
+	}
+	
+	OpenGL->Connection     = NULL;
+	OpenGL->WindowColormap = 0;
+#endif
+	
+	OpenGL->Display = EGL_NO_DISPLAY;
+	OpenGL->Context = EGL_NO_CONTEXT;
+}
+
+// @Note Robust where the driver can, without it where it can't, a context that can't say it was reset beats none
+internal const char *CreateLinuxOpenGLContext(linux_opengl *OpenGL)
+{
+	EGLint RobustAttributes[] =
+	{
+		EGL_CONTEXT_MAJOR_VERSION, 3,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_CONTEXT_FLAGS_KHR, EGL_CONTEXT_OPENGL_ROBUST_ACCESS_BIT_KHR,
+		EGL_CONTEXT_OPENGL_RESET_NOTIFICATION_STRATEGY_KHR, EGL_LOSE_CONTEXT_ON_RESET_KHR,
+		EGL_NONE,
+	};
+	
+	EGLint ContextAttributes[] =
+	{
+		EGL_CONTEXT_MAJOR_VERSION, 3,
+		EGL_CONTEXT_MINOR_VERSION, 3,
+		EGL_CONTEXT_OPENGL_PROFILE_MASK, EGL_CONTEXT_OPENGL_CORE_PROFILE_BIT,
+		EGL_NONE,
+	};
+	
+	OpenGL->Context  = EGL_NO_CONTEXT;
+	OpenGL->IsRobust = false;
+	if (OpenGL->CanBeRobust)
+	{
+		OpenGL->Context  = eglCreateContext(OpenGL->Display, OpenGL->Config, EGL_NO_CONTEXT, RobustAttributes);
+		OpenGL->IsRobust = (OpenGL->Context != EGL_NO_CONTEXT);
+	}
+	
+	if (OpenGL->Context == EGL_NO_CONTEXT)
+	{
+		OpenGL->Context = eglCreateContext(OpenGL->Display, OpenGL->Config, EGL_NO_CONTEXT, ContextAttributes);
+	}
+	
+	if (OpenGL->Context == EGL_NO_CONTEXT)
+	{
+		return "eglCreateContext";
+	}
+	
+	if (!eglMakeCurrent(OpenGL->Display, EGL_NO_SURFACE, EGL_NO_SURFACE, OpenGL->Context))
+	{
+		eglDestroyContext(OpenGL->Display, OpenGL->Context);
+		OpenGL->Context = EGL_NO_CONTEXT;
+		return "eglMakeCurrent";
+	}
+	
+	const char *MissingName = LoadOpenGLFunctions(&OpenGL->Functions, LinuxGetOpenGLFunction, OpenGL->IsRobust);
+	if (MissingName)
+	{
+		eglMakeCurrent(OpenGL->Display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		eglDestroyContext(OpenGL->Display, OpenGL->Context);
+		OpenGL->Context = EGL_NO_CONTEXT;
+	}
+	
+	return MissingName;
+}
+
+#if X11_CAPTURE
+// @Note The input region is empty so every click goes to whatever is under the window, and override-redirect keeps
+// the window manager from framing, placing or lowering it. Raised again on every present, anything mapped since can
+// have gone over it.
+internal bool CreateLinuxOpenGLWindow(linux_opengl *OpenGL, linux_opengl_window *Window)
+{
+	Display *Connection = OpenGL->Connection;
+	
+	XSetWindowAttributes Attributes = {};
+	Attributes.colormap          = OpenGL->WindowColormap;
+	Attributes.background_pixel  = 0;
+	Attributes.border_pixel      = 0;
+	Attributes.override_redirect = True;
+	
+	unsigned long AttributeMask = CWColormap | CWBackPixel | CWBorderPixel | CWOverrideRedirect;
+	Window->Handle = XCreateWindow(Connection, DefaultRootWindow(Connection), Window->Left, Window->Top,
+		Window->Width, Window->Height, 0, 32, InputOutput, OpenGL->WindowVisual, AttributeMask, &Attributes);
+	if (!Window->Handle)
+	{
+		return false;
+	}
+	
+	XShapeCombineRectangles(Connection, Window->Handle, ShapeInput, 0, 0, NULL, 0, ShapeSet, Unsorted);
+	XStoreName(Connection, Window->Handle, "Overlay");
+	
+	Window->Surface = eglCreateWindowSurface(OpenGL->Display, OpenGL->Config, (EGLNativeWindowType)Window->Handle, NULL);
+	if (Window->Surface == EGL_NO_SURFACE)
+	{
+		XDestroyWindow(Connection, Window->Handle);
+		Window->Handle = 0;
+		
+		return false;
+	}
+	
+	// @Note The fence paces the frames, a swap never waits for the vertical blank
+	eglMakeCurrent(OpenGL->Display, Window->Surface, Window->Surface, OpenGL->Context);
+	eglSwapInterval(OpenGL->Display, 0);
+	
+	return true;
+}
+
+// @Note The X server's EGL display, with a config that draws into its 32-bit visual. Transparent only where a
+// compositing manager runs, without one what is see-through comes out black.
+internal const char *OpenLinuxOpenGLWindows(linux_opengl *OpenGL, const char *ClientExtensions,
+	PFNEGLGETPLATFORMDISPLAYEXTPROC GetPlatformDisplay, XVisualInfo *VisualInfo)
+{
+	OpenGL->Connection = XOpenDisplay(NULL);
+	if (!OpenGL->Connection)
+	{
+		return "XOpenDisplay";
+	}
+	
+	int ShapeEventBase, ShapeErrorBase;
+	int ShapeMajor = 0, ShapeMinor = 0;
+	if (!XShapeQueryExtension(OpenGL->Connection, &ShapeEventBase, &ShapeErrorBase) ||
+		!XShapeQueryVersion(OpenGL->Connection, &ShapeMajor, &ShapeMinor) || ((ShapeMajor == 1) && (ShapeMinor < 1)))
+	{
+		return "SHAPE 1.1";
+	}
+	
+	if (!XMatchVisualInfo(OpenGL->Connection, DefaultScreen(OpenGL->Connection), 32, TrueColor, VisualInfo))
+	{
+		return "XMatchVisualInfo";
+	}
+	
+	OpenGL->WindowVisual   = VisualInfo->visual;
+	OpenGL->WindowColormap = XCreateColormap(OpenGL->Connection, DefaultRootWindow(OpenGL->Connection), VisualInfo->visual, AllocNone);
+	
+	if (GetPlatformDisplay && HasEGLExtension(ClientExtensions, "EGL_EXT_platform_x11"))
+	{
+		OpenGL->Display = GetPlatformDisplay(EGL_PLATFORM_X11_EXT, OpenGL->Connection, NULL);
+	}
+	
+	if (OpenGL->Display == EGL_NO_DISPLAY)
+	{
+		OpenGL->Display = eglGetDisplay((EGLNativeDisplayType)OpenGL->Connection);
+	}
+	
+	return NULL;
+}
+
+// @Note Any 8-bit RGBA config can come out on a 24-bit visual, only the one on the visual the windows are made with
+// keeps the alpha
+internal bool ChooseLinuxOpenGLWindowConfig(linux_opengl *OpenGL, XVisualInfo *VisualInfo, EGLConfig *Config)
+{
+	EGLint ConfigAttributes[] =
+	{
+		EGL_SURFACE_TYPE, EGL_WINDOW_BIT,
+		EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT,
+		EGL_RED_SIZE, 8,
+		EGL_GREEN_SIZE, 8,
+		EGL_BLUE_SIZE, 8,
+		EGL_ALPHA_SIZE, 8,
+		EGL_NONE,
+	};
+	
+	EGLConfig Configs[64];
+	EGLint ConfigCount;
+	if (!eglChooseConfig(OpenGL->Display, ConfigAttributes, Configs, GetArrayCount(Configs), &ConfigCount))
+	{
+		return false;
+	}
+	
+	for (EGLint ConfigIndex = 0; ConfigIndex < ConfigCount; ++ConfigIndex)
+	{
+		EGLint NativeVisualID;
+		if (eglGetConfigAttrib(OpenGL->Display, Configs[ConfigIndex], EGL_NATIVE_VISUAL_ID, &NativeVisualID) &&
+			((VisualID)NativeVisualID == VisualInfo->visualid))
+		{
+			*Config = Configs[ConfigIndex];
+			return true;
+		}
+	}
+	
+	return false;
+}
+#endif
+
+// Returns the step that didn't go through, NULL with a 3.3 core context current and every function loaded. With
+// windows, LinuxOpenGLPlatform gives the compositor the hooks that put every overlay in one.
+internal const char *InitializeLinuxOpenGL(linux_opengl *OpenGL, bool WithWindows)
+{
+	*OpenGL = {};
+	OpenGL->Display = EGL_NO_DISPLAY;
+	OpenGL->Context = EGL_NO_CONTEXT;
+	
+	const char *ClientExtensions = eglQueryString(EGL_NO_DISPLAY, EGL_EXTENSIONS);
+	PFNEGLGETPLATFORMDISPLAYEXTPROC GetPlatformDisplay = (PFNEGLGETPLATFORMDISPLAYEXTPROC)eglGetProcAddress("eglGetPlatformDisplayEXT");
+
+#if X11_CAPTURE
+	XVisualInfo VisualInfo = {};
+	if (WithWindows)
+	{
+		const char *FailedStep = OpenLinuxOpenGLWindows(OpenGL, ClientExtensions, GetPlatformDisplay, &VisualInfo);
+		if (FailedStep)
+		{
+			CloseLinuxOpenGL(OpenGL);
+			return FailedStep;
+		}
+	}
+#else
+	if (WithWindows)
+	{
+		return "X11";
+	}
+#endif
+	
+	if (!WithWindows && GetPlatformDisplay && HasEGLExtension(ClientExtensions, "EGL_MESA_platform_surfaceless"))
+	{
+		OpenGL->Display = GetPlatformDisplay(EGL_PLATFORM_SURFACELESS_MESA, EGL_DEFAULT_DISPLAY, NULL);
+	}
+	
+	if (!WithWindows && (OpenGL->Display == EGL_NO_DISPLAY))
+	{
+		OpenGL->Display = eglGetDisplay(EGL_DEFAULT_DISPLAY);
+	}
+	
+	if ((OpenGL->Display == EGL_NO_DISPLAY) || !eglInitialize(OpenGL->Display, NULL, NULL))
+	{
+		OpenGL->Display = EGL_NO_DISPLAY;
+		CloseLinuxOpenGL(OpenGL);
+		return "eglInitialize";
+	}
+	
+	// @Note Everything draws into our own framebuffers, the context only needs a surface to copy them into a window
+	const char *DisplayExtensions = eglQueryString(OpenGL->Display, EGL_EXTENSIONS);
+	if (!HasEGLExtension(DisplayExtensions, "EGL_KHR_surfaceless_context") || !eglBindAPI(EGL_OPENGL_API))
+	{
+		CloseLinuxOpenGL(OpenGL);
+		return "EGL_KHR_surfaceless_context";
+	}
+	
+	EGLConfig Config = EGL_NO_CONFIG_KHR;
+#if X11_CAPTURE
+	if (WithWindows && !ChooseLinuxOpenGLWindowConfig(OpenGL, &VisualInfo, &Config))
+	{
+		CloseLinuxOpenGL(OpenGL);
+		return "eglChooseConfig";
+	}
+#endif
+	
+	if (!WithWindows && !HasEGLExtension(DisplayExtensions, "EGL_KHR_no_config_context"))
+	{
+		EGLint ConfigAttributes[] = { EGL_RENDERABLE_TYPE, EGL_OPENGL_BIT, EGL_NONE };
+		EGLint ConfigCount;
+		if (!eglChooseConfig(OpenGL->Display, ConfigAttributes, &Config, 1, &ConfigCount) || (ConfigCount == 0))
+		{
+			CloseLinuxOpenGL(OpenGL);
+			return "eglChooseConfig";
+		}
+	}
+	
+	OpenGL->Config      = Config;
+	OpenGL->CanBeRobust = HasEGLExtension(DisplayExtensions, "EGL_KHR_create_context");
+	
+	const char *FailedStep = CreateLinuxOpenGLContext(OpenGL);
+	if (FailedStep)
+	{
+		CloseLinuxOpenGL(OpenGL);
+		return FailedStep;
+	}
+	
+	return NULL;
+}
+
+//
+// The compositor's hooks for a new context after a reset
+//
+
+// @Note The first build takes the context InitializeLinuxOpenGL made
+internal PLATFORM_OPEN_OPENGL_CONTEXT(LinuxOpenOpenGLContext)
+{
+	linux_opengl *OpenGL = (linux_opengl *)Platform;
+	if (OpenGL->Context != EGL_NO_CONTEXT)
+	{
+		return true;
+	}
+	
+	return (CreateLinuxOpenGLContext(OpenGL) == NULL);
+}
+
+internal PLATFORM_CLOSE_OPENGL_CONTEXT(LinuxCloseOpenGLContext)
+{
+	linux_opengl *OpenGL = (linux_opengl *)Platform;
+	if (OpenGL->Context != EGL_NO_CONTEXT)
+	{
+		eglMakeCurrent(OpenGL->Display, EGL_NO_SURFACE, EGL_NO_SURFACE, EGL_NO_CONTEXT);
+		eglDestroyContext(OpenGL->Display, OpenGL->Context);
+		OpenGL->Context = EGL_NO_CONTEXT;
+	}
+}
+
+#if X11_CAPTURE
+//
+// The compositor's hooks for the windows
+//
+
+// @Note Down from the screen's top right corner one under the other in overlay order, there is no window thread
+// here that knows where the overlays' regions are
+internal PLATFORM_SELECT_OPENGL_WINDOW(LinuxSelectOpenGLWindow)
+{
+	linux_opengl *OpenGL = (linux_opengl *)Platform;
+	linux_opengl_window *Window = &OpenGL->Windows[WindowIndex];
+	Display *Connection = OpenGL->Connection;
+	
+	if ((Width <= 0) || (Height <= 0))
+	{
+		if (Window->IsMapped)
+		{
+			XUnmapWindow(Connection, Window->Handle);
+			XFlush(Connection);
+			Window->IsMapped = false;
+		}
+		
+		return false;
+	}
+	
+	if (WindowIndex == 0)
+	{
+		OpenGL->NextWindowTop = OPENGL_WINDOW_MARGIN;
+	}
+	
+	int Left = WidthOfScreen(DefaultScreenOfDisplay(Connection)) - Width - OPENGL_WINDOW_MARGIN;
+	int Top  = OpenGL->NextWindowTop;
+	OpenGL->NextWindowTop += Height + OPENGL_WINDOW_MARGIN;
+	
+	bool WindowMoved = (Window->Left != Left) || (Window->Top != Top) || (Window->Width != Width) || (Window->Height != Height);
+	Window->Left   = Left;
+	Window->Top    = Top;
+	Window->Width  = Width;
+	Window->Height = Height;
+	
+	if (!Window->Handle)
+	{
+		if (!CreateLinuxOpenGLWindow(OpenGL, Window))
+		{
+			return false;
+		}
+	}
+	else if (WindowMoved)
+	{
+		XMoveResizeWindow(Connection, Window->Handle, Left, Top, Width, Height);
+	}
+	
+	if (!Window->IsMapped)
+	{
+		XMapWindow(Connection, Window->Handle);
+		Window->IsMapped = true;
+	}
+	
+	XRaiseWindow(Connection, Window->Handle);
+	XFlush(Connection);
+	
+	return eglMakeCurrent(OpenGL->Display, Window->Surface, Window->Surface, OpenGL->Context);
+}
+
+internal PLATFORM_SWAP_OPENGL_WINDOW(LinuxSwapOpenGLWindow)
+{
+	linux_opengl *OpenGL = (linux_opengl *)Platform;
+	if (!eglSwapBuffers(OpenGL->Display, OpenGL->Windows[WindowIndex].Surface))
+	{
+		return (eglGetError() != EGL_CONTEXT_LOST);
+	}
+	
+	return true;
+}
+#endif
+
+internal opengl_platform LinuxOpenGLPlatform(linux_opengl *OpenGL)
+{
+	opengl_platform Result;
+	Result.Context        = OpenGL;
+	Result.GL             = &OpenGL->Functions;
+	Result.GetNanoseconds = GetNanoseconds;
+	Result.OpenContext    = LinuxOpenOpenGLContext;
+	Result.CloseContext   = LinuxCloseOpenGLContext;
+	Result.SelectWindow   = NULL;
+	Result.SwapWindow     = NULL;
+
+#if X11_CAPTURE
+	if (OpenGL->Connection)
+	{
+		Result.SelectWindow = LinuxSelectOpenGLWindow;
+		Result.SwapWindow   = LinuxSwapOpenGLWindow;
+	}
+#endif
+	
+	return Result;
+}
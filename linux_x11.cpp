@@ -0,0 +1,488 @@
+//
+// X11 frame source: the root window through MIT-SHM, fetching only the rows XDamage says changed
+//
+// @Note The whole root is one output at 0,0, so a cut box is in root coordinates the same way it is in virtual
+// desktop coordinates on Windows, and spanning monitors needs nothing special. The shared image is the captured
+// surface: XShmGetImage has the server write straight into it and the crop reads it from there, nothing gets
+// copied in between. A band of full-width rows is contiguous in the image, so every damaged band is fetched
+// in place at its row and the rest of the image stays as it was.
+//
+// XDamage is looked up when the source starts, its client library isn't on every machine and we only need three
+// calls. Without it every acquire waits out a poll period and fetches the whole root without metadata, so it's
+// left to the change detector to find out what changed.
+//
+
+#include <X11/Xlib.h>
+#include <X11/Xutil.h>
+#include <X11/extensions/XShm.h>
+#include <X11/extensions/shape.h>
+#include <sys/ipc.h>
+#include <sys/shm.h>
+#include <poll.h>
+#include <dlfcn.h>
+
+// @Note Xlib macros that are names of ours further down, its own uses are all in the headers above
+#undef Below
+#undef Status
+
+// @Note Without XDamage, what a whole grab gets waited for
+#define X11_POLL_MS 16
+
+//
+// XDamage, as declared in Xdamage.h which we don't need to build
+//
+
+typedef XID x11_damage;
+
+#define X11_DAMAGE_NOTIFY 0
+#define X11_DAMAGE_REPORT_RAW_RECTANGLES 0
+
+struct x11_damage_notify_event
+{
+	int Type;
+	unsigned long Serial;
+	Bool SendEvent;
+	Display *EventDisplay;
+	Drawable DamagedDrawable;
+	x11_damage Damage;
+	int Level;
+	Bool More;
+	Time Timestamp;
+	XRectangle Area;
+	XRectangle Geometry;
+};
+
+#define X_DAMAGE_QUERY_EXTENSION(Name) Bool Name(Display *Connection, int *EventBase, int *ErrorBase)
+typedef X_DAMAGE_QUERY_EXTENSION(x_damage_query_extension);
+
+#define X_DAMAGE_CREATE(Name) x11_damage Name(Display *Connection, Drawable Target, int Level)
+typedef X_DAMAGE_CREATE(x_damage_create);
+
+#define X_DAMAGE_DESTROY(Name) void Name(Display *Connection, x11_damage Damage)
+typedef X_DAMAGE_DESTROY(x_damage_destroy);
+
+//
+// Source
+//
+
+struct x11_source
+{
+	Display *Connection;
+	Window Root;
+	Visual *RootVisual;
+	int Depth;
+	
+	// @Note Image data is the shared segment, Surface is the same memory
+	XShmSegmentInfo Segment;
+	XImage *Image;
+	bitmap Surface;
+	
+	void *DamageLibrary;
+	x_damage_create  *DamageCreate;
+	x_damage_destroy *DamageDestroy;
+	x11_damage Damage;
+	int DamageEventBase;
+	
+	// @Note The next acquire fetches the whole root straight away, the first one does too.
+	// Resized has it make the image again first.
+	bool IsInvalid;
+	bool RootResized;
+	
+	// @Note Root coordinates, what the damage events told us since the last frame and when the first of them came in
+	crop_damage Pending;
+	u64 PendingTime;
+	
+	box DirtyRects[MAX_CROP_REGIONS];
+	
+	u64 FrameCount;
+	u64 WholeFrameCount;
+	u64 DamageEventCount;
+	u64 BandCount;
+	u64 FetchedBytes;
+	u64 ResizeCount;
+};
+
+// @Note Xlib's default handler exits the process, a failed request shows up as a false return instead
+global int volatile X11ErrorCount;
+
+internal int HandleX11Error(Display *Connection, XErrorEvent *Event)
+{
+	++X11ErrorCount;
+	return 0;
+}
+
+internal void DestroyX11Image(x11_source *Source)
+{
+	if (Source->Image)
+	{
+		XShmDetach(Source->Connection, &Source->Segment);
+		XSync(Source->Connection, False);
+		
+		// @Note Frees the XImage only, the data is the segment
+		XDestroyImage(Source->Image);
+		shmdt(Source->Segment.shmaddr);
+		
+		Source->Image = NULL;
+		Source->Surface = {};
+	}
+}
+
+// @Note Root-sized, made again whenever the root changes size
+internal bool CreateX11Image(x11_source *Source)
+{
+	DestroyX11Image(Source);
+	
+	XWindowAttributes Attributes;
+	if (!XGetWindowAttributes(Source->Connection, Source->Root, &Attributes))
+	{
+		return false;
+	}
+	
+	XImage *Image = XShmCreateImage(Source->Connection, Source->RootVisual, Source->Depth, ZPixmap, NULL, &Source->Segment,
+									Attributes.width, Attributes.height);
+	if (!Image)
+	{
+		return false;
+	}
+	
+	// @Note Little-endian 0x00RRGGBB is B8G8R8X8, the crop never reads the alpha
+	if ((Image->bits_per_pixel != 32) || (Image->red_mask != 0xFF0000) || (Image->green_mask != 0xFF00) ||
+		(Image->blue_mask != 0xFF) || (Image->byte_order != LSBFirst))
+	{
+		XDestroyImage(Image);
+		return false;
+	}
+	
+	size_t Size = (size_t)Image->bytes_per_line * Image->height;
+	Source->Segment.shmid = shmget(IPC_PRIVATE, Size, IPC_CREAT | 0600);
+	if (Source->Segment.shmid < 0)
+	{
+		XDestroyImage(Image);
+		return false;
+	}
+	
+	Source->Segment.shmaddr  = (char *)shmat(Source->Segment.shmid, NULL, 0);
+	Source->Segment.readOnly = False;
+	
+	int ErrorCount = X11ErrorCount;
+	bool Attached = (Source->Segment.shmaddr != (char *)-1) && XShmAttach(Source->Connection, &Source->Segment);
+	XSync(Source->Connection, False);
+	
+	// @Note Goes away once both sides let go of it, whatever happens to us
+	shmctl(Source->Segment.shmid, IPC_RMID, NULL);
+	
+	if (!Attached || (X11ErrorCount != ErrorCount))
+	{
+		if (Source->Segment.shmaddr != (char *)-1)
+		{
+			shmdt(Source->Segment.shmaddr);
+		}
+		
+		XDestroyImage(Image);
+		return false;
+	}
+	
+	Image->data = Source->Segment.shmaddr;
+	
+	Source->Image = Image;
+	Source->Surface.Memory = (u8 *)Image->data;
+	Source->Surface.Width  = Image->width;
+	Source->Surface.Height = Image->height;
+	Source->Surface.Pitch  = Image->bytes_per_line;
+	
+	return true;
+}
+
+internal void LoadX11Damage(x11_source *Source)
+{
+	void *Library = dlopen("libXdamage.so.1", RTLD_NOW | RTLD_LOCAL);
+	if (!Library)
+	{
+		return;
+	}
+	
+	x_damage_query_extension *QueryExtension = (x_damage_query_extension *)dlsym(Library, "XDamageQueryExtension");
+	Source->DamageCreate  = (x_damage_create *)dlsym(Library, "XDamageCreate");
+	Source->DamageDestroy = (x_damage_destroy *)dlsym(Library, "XDamageDestroy");
+	
+	int ErrorBase;
+	if (!QueryExtension || !Source->DamageCreate || !Source->DamageDestroy ||
+		!QueryExtension(Source->Connection, &Source->DamageEventBase, &ErrorBase))
+	{
+		dlclose(Library);
+		Source->DamageCreate  = NULL;
+		Source->DamageDestroy = NULL;
+		return;
+	}
+	
+	// @Note Raw rectangles are reported as they happen and never have to be subtracted
+	Source->DamageLibrary = Library;
+	Source->Damage = Source->DamageCreate(Source->Connection, Source->Root, X11_DAMAGE_REPORT_RAW_RECTANGLES);
+}
+
+// Opens the display named by DisplayName, or $DISPLAY when it's NULL. Returns false if there is none,
+// or it has no MIT-SHM, or its root isn't 32 bits a pixel.
+internal bool InitializeX11Source(x11_source *Source, const char *DisplayName)
+{
+	*Source = {};
+	
+	XSetErrorHandler(HandleX11Error);
+	
+	Source->Connection = XOpenDisplay(DisplayName);
+	if (!Source->Connection)
+	{
+		return false;
+	}
+	
+	int Screen = DefaultScreen(Source->Connection);
+	Source->Root   = RootWindow(Source->Connection, Screen);
+	Source->RootVisual = DefaultVisual(Source->Connection, Screen);
+	Source->Depth  = DefaultDepth(Source->Connection, Screen);
+	
+	if (!XShmQueryExtension(Source->Connection) || !CreateX11Image(Source))
+	{
+		XCloseDisplay(Source->Connection);
+		Source->Connection = NULL;
+		
+		return false;
+	}
+	
+	// @Note For the root changing size
+	XSelectInput(Source->Connection, Source->Root, StructureNotifyMask);
+	
+	LoadX11Damage(Source);
+	XSync(Source->Connection, False);
+	
+	Source->IsInvalid = true;
+	
+	return true;
+}
+
+internal void CloseX11Source(x11_source *Source)
+{
+	if (Source->Connection)
+	{
+		if (Source->DamageLibrary)
+		{
+			Source->DamageDestroy(Source->Connection, Source->Damage);
+		}
+		
+		DestroyX11Image(Source);
+		XCloseDisplay(Source->Connection);
+		Source->Connection = NULL;
+	}
+	
+	if (Source->DamageLibrary)
+	{
+		dlclose(Source->DamageLibrary);
+		Source->DamageLibrary = NULL;
+	}
+}
+
+inline box GetX11Bounds(x11_source *Source)
+{
+	return box{ 0, 0, Source->Surface.Width, Source->Surface.Height };
+}
+
+// @Note Takes what has already come in and returns straight away if there was anything, otherwise waits
+// at most TimeoutMS for the connection to have something
+internal void PumpX11Events(x11_source *Source, u32 TimeoutMS)
+{
+	Display *Connection = Source->Connection;
+	if (!XPending(Connection))
+	{
+		pollfd Socket = { ConnectionNumber(Connection), POLLIN, 0 };
+		if ((poll(&Socket, 1, (int)TimeoutMS) <= 0) || !XPending(Connection))
+		{
+			return;
+		}
+	}
+	
+	while (XPending(Connection))
+	{
+		XEvent Event;
+		XNextEvent(Connection, &Event);
+		
+		if (Source->DamageLibrary && (Event.type == Source->DamageEventBase + X11_DAMAGE_NOTIFY))
+		{
+			x11_damage_notify_event *Notify = (x11_damage_notify_event *)&Event;
+			
+			box Area;
+			Area.Left   = Notify->Area.x;
+			Area.Top    = Notify->Area.y;
+			Area.Right  = Notify->Area.x + Notify->Area.width;
+			Area.Bottom = Notify->Area.y + Notify->Area.height;
+			
+			if (Source->Pending.RegionCount == 0)
+			{
+				Source->PendingTime = GetMicroseconds();
+			}
+			
+			AddDamage(&Source->Pending, GetX11Bounds(Source), Area);
+			++Source->DamageEventCount;
+		}
+		else if ((Event.type == ConfigureNotify) && (Event.xconfigure.window == Source->Root) &&
+				 ((Event.xconfigure.width != Source->Surface.Width) || (Event.xconfigure.height != Source->Surface.Height)))
+		{
+			// @Note Whatever was damaged before goes with the old image
+			Source->IsInvalid   = true;
+			Source->RootResized = true;
+		}
+	}
+}
+
+// @Note Rows Top to Bottom of the root into the same rows of the image
+internal bool FetchX11Rows(x11_source *Source, int Top, int Bottom)
+{
+	XImage Band = *Source->Image;
+	Band.height = Bottom - Top;
+	Band.data   = Source->Image->data + (size_t)Top * Source->Image->bytes_per_line;
+	
+	int ErrorCount = X11ErrorCount;
+	if (!XShmGetImage(Source->Connection, Source->Root, &Band, 0, Top, AllPlanes) || (X11ErrorCount != ErrorCount))
+	{
+		return false;
+	}
+	
+	++Source->BandCount;
+	Source->FetchedBytes += (u64)Band.height * Band.bytes_per_line;
+	
+	return true;
+}
+
+// @Note Every row any of the boxes touches, as few bands as there can be
+internal bool FetchX11Bands(x11_source *Source, box *Boxes, u32 BoxCount)
+{
+	int Tops[MAX_CROP_REGIONS];
+	int Bottoms[MAX_CROP_REGIONS];
+	for (u32 BoxIndex = 0; BoxIndex < BoxCount; ++BoxIndex)
+	{
+		// @Note Sorted by top as they go in, there are never more than a handful
+		u32 Index = BoxIndex;
+		while ((Index > 0) && (Tops[Index - 1] > Boxes[BoxIndex].Top))
+		{
+			Tops[Index]    = Tops[Index - 1];
+			Bottoms[Index] = Bottoms[Index - 1];
+			--Index;
+		}
+		
+		Tops[Index]    = Boxes[BoxIndex].Top;
+		Bottoms[Index] = Boxes[BoxIndex].Bottom;
+	}
+	
+	u32 BoxIndex = 0;
+	while (BoxIndex < BoxCount)
+	{
+		int Top    = Tops[BoxIndex];
+		int Bottom = Bottoms[BoxIndex++];
+		while ((BoxIndex < BoxCount) && (Tops[BoxIndex] <= Bottom))
+		{
+			Bottom = Max(Bottom, Bottoms[BoxIndex++]);
+		}
+		
+		if (!FetchX11Rows(Source, Top, Bottom))
+		{
+			return false;
+		}
+	}
+	
+	return true;
+}
+
+internal FRAME_SOURCE_ACQUIRE(X11Acquire)
+{
+	x11_source *Source = (x11_source *)Context;
+	
+	bool Whole = Source->IsInvalid;
+	if (!Whole)
+	{
+		PumpX11Events(Source, Source->DamageLibrary ? TimeoutMS : Min(TimeoutMS, (u32)X11_POLL_MS));
+		
+		if (Source->DamageLibrary && !Source->IsInvalid && (Source->Pending.RegionCount == 0))
+		{
+			return AcquireResult_Timeout;
+		}
+		
+		Whole = Source->IsInvalid || !Source->DamageLibrary;
+	}
+	
+	if (Source->RootResized)
+	{
+		if (!CreateX11Image(Source))
+		{
+			return AcquireResult_Lost;
+		}
+		
+		Source->RootResized = false;
+		++Source->ResizeCount;
+	}
+	
+	box Bounds = GetX11Bounds(Source);
+	bool Fetched = Whole ? FetchX11Rows(Source, 0, Bounds.Bottom) : FetchX11Bands(Source, Source->Pending.Regions, Source->Pending.RegionCount);
+	if (!Fetched)
+	{
+		// @Note Most likely the root changed size under us, look again before the next one
+		Source->IsInvalid   = true;
+		Source->RootResized = true;
+		return AcquireResult_Lost;
+	}
+	
+	Frame->Surface       = &Source->Surface;
+	Frame->Format        = SurfaceFormat_BGRA8;
+	Frame->WhiteNits     = SCRGB_WHITE_NITS;
+	Frame->Rotation      = DisplayRotation_Identity;
+	Frame->DesktopWidth  = Bounds.Right;
+	Frame->DesktopHeight = Bounds.Bottom;
+	
+	Frame->SourceWasReset    = Source->IsInvalid;
+	Frame->LastPresentTime   = (Source->Pending.RegionCount > 0) ? Source->PendingTime : GetMicroseconds();
+	Frame->AccumulatedFrames = 1;
+	Frame->MoveRectCount     = 0;
+	Frame->MoveRects         = NULL;
+	
+	// @Note Polling knows nothing about what changed
+	Frame->MetadataIsValid = !Whole || Source->IsInvalid;
+	Frame->DirtyRectCount  = 0;
+	Frame->DirtyRects      = Source->DirtyRects;
+	if (Frame->MetadataIsValid)
+	{
+		Frame->DirtyRectCount = Whole ? 1 : Source->Pending.RegionCount;
+		Source->DirtyRects[0] = Bounds;
+		for (u32 RegionIndex = 0; !Whole && (RegionIndex < Source->Pending.RegionCount); ++RegionIndex)
+		{
+			Source->DirtyRects[RegionIndex] = Source->Pending.Regions[RegionIndex];
+		}
+	}
+	
+	Source->IsInvalid = false;
+	Source->Pending.RegionCount = 0;
+	
+	++Source->FrameCount;
+	Source->WholeFrameCount += Whole;
+	
+	return AcquireResult_Frame;
+}
+
+// @Note Nothing to give back, the image is only written by the next acquire
+internal FRAME_SOURCE_RELEASE(X11Release)
+{
+	return true;
+}
+
+internal FRAME_SOURCE_INVALIDATE(X11Invalidate)
+{
+	x11_source *Source = (x11_source *)Context;
+	Source->IsInvalid = true;
+}
+
+internal frame_source X11FrameSource(x11_source *Source)
+{
+	frame_source Result;
+	Result.Context    = Source;
+	Result.Acquire    = X11Acquire;
+	Result.Release    = X11Release;
+	Result.Invalidate = X11Invalidate;
+	Result.Select     = NULL;
+	
+	return Result;
+}
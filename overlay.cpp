@@ -0,0 +1,575 @@
+//
+// Portable overlay pipeline, included by the platform layer (unity build)
+//
+
+#include "overlay.h"
+#include "overlay_damage.cpp"
+#include "overlay_exchange.cpp"
+#include "overlay_queue.cpp"
+#include "overlay_pool.cpp"
+#include "overlay_device.cpp"
+#include "overlay_mapping.cpp"
+#include "overlay_atlas.cpp"
+#include "overlay_colour.cpp"
+#include "overlay_shade.cpp"
+#include "overlay_convert.cpp"
+#include "overlay_scale.cpp"
+#include "overlay_effects.cpp"
+#include "overlay_hash.cpp"
+#include "overlay_yuv.cpp"
+#include "overlay_recording.cpp"
+#include "overlay_latency.cpp"
+#include "overlay_cache.cpp"
+#include "overlay_ring.cpp"
+#include "overlay_export.cpp"
+#include "overlay_outputs.cpp"
+#include "overlay_tiles.cpp"
+#include "overlay_pacing.cpp"
+
+// @Note Outputs[0] is the primary monitor
+internal render_state DefaultRenderState(box *Outputs, u32 OutputCount, int DisplayWidth, int DisplayHeight)
+{
+	render_state State;
+	
+	Assert((OutputCount > 0) && (OutputCount <= MAX_OUTPUTS));
+	State.OutputCount = OutputCount;
+	for (u32 OutputIndex = 0; OutputIndex < OutputCount; ++OutputIndex)
+	{
+		State.Outputs[OutputIndex] = Outputs[OutputIndex];
+	}
+	
+	// @Note Default cut area is the bottom right corner of the primary, where the minimap lives
+	box Primary = Outputs[0];
+	overlay_region *Overlay = &State.Overlays[0];
+	Overlay->CutBox.Left   = Primary.Right  - DisplayWidth;
+	Overlay->CutBox.Top    = Primary.Bottom - DisplayHeight;
+	Overlay->CutBox.Right  = Primary.Right;
+	Overlay->CutBox.Bottom = Primary.Bottom;
+	
+	Overlay->DisplayWidth  = DisplayWidth;
+	Overlay->DisplayHeight = DisplayHeight;
+	
+	State.OverlayCount = 1;
+	
+	State.Shade.Alpha  = 0.1f;
+	State.Shade.Darken = 0.1f;
+	State.Shade.Scale  = ScaleMode_Bilinear;
+	
+	// @Note All off, the rest is what each one does when it is turned on
+	effect_params *Effects = &State.Shade.Effects;
+	Effects->Key           = 0;
+	Effects->Contrast      = 1.5f;
+	Effects->EdgeStrength  = 4.0f;
+	Effects->EdgeColour[0] = 1.0f;
+	Effects->EdgeColour[1] = 0.8f;
+	Effects->EdgeColour[2] = 0.2f;
+	Effects->KeyColour[0]  = 0.0f;
+	Effects->KeyColour[1]  = 0.0f;
+	Effects->KeyColour[2]  = 0.0f;
+	Effects->KeyTolerance  = 0.02f;
+	
+	State.Pacing.Mode    = PacingMode_LowestLatency;
+	State.Pacing.CapRate = 30;
+	
+	State.Version = 0;
+	
+	return State;
+}
+
+// Returns the index of the new overlay, -1 if there is no room for another one
+internal int AddOverlay(render_state *State, box CutBox, int DisplayWidth, int DisplayHeight)
+{
+	if (State->OverlayCount >= MAX_OVERLAYS)
+	{
+		return -1;
+	}
+	
+	int OverlayIndex = (int)State->OverlayCount++;
+	
+	overlay_region *Overlay = &State->Overlays[OverlayIndex];
+	Overlay->CutBox        = CutBox;
+	Overlay->DisplayWidth  = DisplayWidth;
+	Overlay->DisplayHeight = DisplayHeight;
+	
+	return OverlayIndex;
+}
+
+// @Note The ones after it move down one index
+internal void RemoveOverlay(render_state *State, u32 OverlayIndex)
+{
+	if (OverlayIndex >= State->OverlayCount)
+	{
+		return;
+	}
+	
+	for (u32 Index = OverlayIndex; Index + 1 < State->OverlayCount; ++Index)
+	{
+		State->Overlays[Index] = State->Overlays[Index + 1];
+	}
+	
+	--State->OverlayCount;
+}
+
+// @Note Whatever the slots hold from these outputs is gone, they get cropped whole from the next frame
+internal void InvalidateSlots(overlay_pipeline *Pipeline, u32 OutputMask)
+{
+	for (u32 SlotIndex = 0; SlotIndex < MAX_CROP_PIECES; ++SlotIndex)
+	{
+		crop_slot_contents *Contents = &Pipeline->SlotContents[SlotIndex];
+		if (OutputMask & (1u << Contents->OutputIndex))
+		{
+			Contents->IsValid = false;
+		}
+	}
+}
+
+// @Note Tell the source which outputs the cut boxes need, the newly selected ones come with a whole image anyway
+internal void SelectOutputs(overlay_pipeline *Pipeline)
+{
+	frame_source *Source = &Pipeline->Source;
+	
+	u32 Touched = GetTouchedOutputs(&Pipeline->State);
+	if (Touched != Pipeline->SelectedOutputs)
+	{
+		if (Source->Select)
+		{
+			Source->Select(Source->Context, Touched);
+		}
+		
+		Pipeline->InvalidatedOutputs |= Touched & ~Pipeline->SelectedOutputs;
+		Pipeline->SelectedOutputs     = Touched;
+	}
+}
+
+//
+// Shade -> present what the display texture holds, once the pacer and the swap chain are ready for it.
+// Waits at most WaitMS for the swap chain. Returns true if it was presented.
+//
+internal bool DrawPendingFrame(overlay_pipeline *Pipeline, u32 WaitMS)
+{
+	compositor   *Compositor  = &Pipeline->Compositor;
+	frame_pacer  *Pacer       = &Pipeline->Pacer;
+	latency_ring *LatencyRing = Pipeline->LatencyRing;
+	
+	if (!Pipeline->PresentPending || GetPresentDelay(Pacer, Pipeline->Clock.Now(Pipeline->Clock.Context)) > 0)
+	{
+		return false;
+	}
+	
+	if (Compositor->Wait)
+	{
+		u64 WaitStart = StartLatency(LatencyRing);
+		bool CanPresent = Compositor->Wait(Compositor->Context, WaitMS);
+		EndLatency(LatencyRing, LatencyStage_SwapChainWait, WaitStart);
+		
+		if (!CanPresent)
+		{
+			return false;
+		}
+	}
+	
+	u64 ShadeStart = StartLatency(LatencyRing);
+	Compositor->Shade(Compositor->Context, &Pipeline->State, Pipeline->Pieces, Pipeline->PieceCount);
+	EndLatency(LatencyRing, LatencyStage_Shade, ShadeStart);
+	
+	Pipeline->PresentPending = false;
+	
+	u64 PresentStart = StartLatency(LatencyRing);
+	bool Presented = Compositor->Present(Compositor->Context);
+	EndLatency(LatencyRing, LatencyStage_Present, PresentStart);
+	
+	if (Presented)
+	{
+		if (Pipeline->ComposedFrameTime)
+		{
+			EndLatency(LatencyRing, LatencyStage_AcquireToPresent, Pipeline->ComposedFrameTime);
+			Pipeline->ComposedFrameTime = 0;
+		}
+		
+		u64 Now = Pipeline->Clock.Now(Pipeline->Clock.Context);
+		NotePresent(Pacer, Now);
+		
+		++Pipeline->PresentedFrameCount;
+		
+		Pipeline->DrawnVersion = Pipeline->ComposedVersion;
+		
+		if (Pipeline->PendingCommandTime)
+		{
+			u64 Latency = Now - Pipeline->PendingCommandTime;
+			
+			++Pipeline->CommandCount;
+			Pipeline->CommandLatencyTotal += Latency;
+			Pipeline->CommandLatencyMax    = Max(Pipeline->CommandLatencyMax, Latency);
+			Pipeline->PendingCommandTime   = 0;
+		}
+	}
+	else
+	{
+		// @Note The device went away, nothing we put in the texture survived
+		InvalidateSlots(Pipeline, ~0u);
+	}
+	
+	return Presented;
+}
+
+//
+// Crop -> shade -> present for one captured frame
+//
+// Only what changed inside the cut boxes gets copied, and if nothing changed and the
+// window thread didn't touch anything either we don't draw or present at all.
+// A repeat is a frame we already composed once, only render state changes count for it.
+// The present itself waits for the pacer, see DrawPendingFrame.
+//
+// @Note A frame is from one output. Pieces on the other outputs keep what their slots hold,
+// and if a slot lost its contents that output is asked for a whole image.
+//
+// @Note With SampleSurfaces the pieces are drawn straight from the frame and nothing is cropped, as long
+// as they are all on its output and the compositor can sample every one of them. The dirty rects still
+// decide whether to draw, against whatever was drawn last, sampled or cropped.
+//
+internal bool ComposeFrame(overlay_pipeline *Pipeline, captured_frame *Frame, bool IsRepeat, u32 TimeoutMS)
+{
+	compositor   *Compositor = &Pipeline->Compositor;
+	render_state *State      = &Pipeline->State;
+	
+	UpdatePacingParams(&Pipeline->Pacer, State->Pacing);
+	
+	u32 FrameOutput = Frame->OutputIndex;
+	u32 FrameBit    = 1u << FrameOutput;
+	
+	output_geometry *Geometry = &Pipeline->OutputGeometry[FrameOutput];
+	Geometry->Rotation      = Frame->Rotation;
+	Geometry->DesktopWidth  = Frame->DesktopWidth;
+	Geometry->DesktopHeight = Frame->DesktopHeight;
+	
+	if (!IsRepeat)
+	{
+		if (Frame->SourceWasReset)
+		{
+			InvalidateSlots(Pipeline, FrameBit);
+		}
+		
+		Pipeline->InvalidatedOutputs &= ~FrameBit;
+	}
+	
+	latency_ring *LatencyRing = Pipeline->LatencyRing;
+	u64 LayoutStart = StartLatency(LatencyRing);
+	
+	Pipeline->PieceCount = BuildCropPieces(State, Pipeline->OutputGeometry, Pipeline->Pieces);
+	
+	bool SlotMoved[MAX_CROP_PIECES];
+	Compositor->Layout(Compositor->Context, State, Pipeline->Pieces, Pipeline->PieceCount, SlotMoved);
+	
+	EndLatency(LatencyRing, LatencyStage_Layout, LayoutStart);
+	u64 CropStart = StartLatency(LatencyRing);
+	
+	// @Note One draw can't take some pieces from the surface and some from the display texture. A frame the pacer
+	// is going to hold back gets cropped, it would have to be once the frame is released anyway, see KeepSampledPieces.
+	// Under a cap that's most of them, and every sampled one leaves its slot to be cropped whole by the next.
+	bool Sample = Pipeline->SampleSurfaces && (Compositor->Sample != NULL) && (State->Pacing.Mode != PacingMode_FixedCap) &&
+		(GetPresentDelay(&Pipeline->Pacer, Pipeline->Clock.Now(Pipeline->Clock.Context)) == 0);
+	for (u32 PieceIndex = 0; Sample && (PieceIndex < Pipeline->PieceCount); ++PieceIndex)
+	{
+		crop_piece *Piece = &Pipeline->Pieces[PieceIndex];
+		Sample = (Piece->OutputIndex == FrameOutput) &&
+			Compositor->Sample(Compositor->Context, State, Frame, PieceIndex, Piece->Mapping.SurfaceBox);
+	}
+	
+	// @Note Every overlay on this output crops from the same frame, one acquire feeds all of them
+	bool HaveCrops  = false;
+	bool HaveDamage = false;
+	u32 MissingOutputs = 0;
+	for (u32 PieceIndex = 0; PieceIndex < Pipeline->PieceCount; ++PieceIndex)
+	{
+		crop_piece *Piece = &Pipeline->Pieces[PieceIndex];
+		crop_slot_contents *Contents = &Pipeline->SlotContents[PieceIndex];
+		box CutBox = Piece->Mapping.SurfaceBox;
+		
+		bool SameBox = Contents->IsValid &&
+			(Contents->OutputIndex == Piece->OutputIndex) && BoxesAreEqual(Contents->SurfaceBox, CutBox);
+		bool SlotIsCurrent = SameBox && !Contents->IsSampled && !SlotMoved[PieceIndex];
+		
+		// @Note A sampled slot holds nothing, but what was drawn from the surface only differs from this frame by its dirty rects
+		bool DrawnIsCurrent = SameBox && (Contents->IsSampled || !SlotMoved[PieceIndex]);
+		
+		Piece->SamplesSurface = false;
+		
+		if (Piece->OutputIndex != FrameOutput)
+		{
+			if (!SlotIsCurrent)
+			{
+				Contents->IsValid = false;
+				MissingOutputs |= (1u << Piece->OutputIndex);
+			}
+			
+			Piece->HasImage = SlotIsCurrent;
+			continue;
+		}
+		
+		crop_damage Damage;
+		Damage.RegionCount = 0;
+		
+		if (!DrawnIsCurrent)
+		{
+			Damage.RegionCount = 1;
+			Damage.Regions[0]  = CutBox;
+		}
+		else if (!IsRepeat)
+		{
+			ComputeCropDamage(Frame, CutBox, &Damage);
+		}
+		
+		if (Sample)
+		{
+			Contents->IsValid     = true;
+			Contents->IsSampled   = true;
+			Contents->OutputIndex = FrameOutput;
+			Contents->SurfaceBox  = CutBox;
+			
+			Piece->SamplesSurface = true;
+			Piece->HasImage       = true;
+			
+			if (Damage.RegionCount)
+			{
+				HaveDamage = true;
+			}
+			
+			continue;
+		}
+		
+		bool Dirty = (Damage.RegionCount > 0);
+		if (!SlotIsCurrent)
+		{
+			Damage.RegionCount = 1;
+			Damage.Regions[0]  = CutBox;
+		}
+		
+		if (Damage.RegionCount)
+		{
+			bool Changed = Compositor->Crop(Compositor->Context, Frame, PieceIndex, CutBox, Damage.Regions, Damage.RegionCount);
+			
+			Contents->IsValid     = true;
+			Contents->IsSampled   = false;
+			Contents->OutputIndex = FrameOutput;
+			Contents->SurfaceBox  = CutBox;
+			
+			Pipeline->CroppedPixelCount += GetDamageArea(&Damage);
+			HaveCrops = true;
+			
+			// @Note Only the dirty rects can be wrong about a change. A slot copied whole may be showing
+			// another part of the surface than it did, so it gets drawn whatever it holds, unless it was
+			// last drawn from the surface and the dirty rects say that's still right.
+			if (SlotIsCurrent ? Changed : Dirty)
+			{
+				HaveDamage = true;
+			}
+			else if (SlotIsCurrent)
+			{
+				++Pipeline->UnchangedCropCount;
+			}
+		}
+		
+		Piece->HasImage = true;
+	}
+	
+	if (HaveCrops)
+	{
+		EndLatency(LatencyRing, LatencyStage_Crop, CropStart);
+	}
+	
+	// @Note Only ask once, the output stays invalidated until a frame from it shows up
+	MissingOutputs &= ~Pipeline->InvalidatedOutputs;
+	if (MissingOutputs)
+	{
+		Pipeline->Source.Invalidate(Pipeline->Source.Context, MissingOutputs);
+		Pipeline->InvalidatedOutputs |= MissingOutputs;
+	}
+	
+	bool StateChanged = (Pipeline->DrawnVersion != State->Version);
+	if (!HaveDamage && !StateChanged && !Pipeline->PresentPending)
+	{
+		++Pipeline->SkippedFrameCount;
+		
+		// @Note Nothing the command asked for is visible, don't count it as waiting for a present
+		Pipeline->PendingCommandTime = 0;
+		return false;
+	}
+	
+	// @Note What was waiting never made it to the screen, this one replaces it
+	if (HaveDamage && Pipeline->PresentPending)
+	{
+		++Pipeline->Pacer.DroppedFrameCount;
+	}
+	
+	Pipeline->PresentPending  = true;
+	Pipeline->ComposedVersion = State->Version;
+	
+	if (Sample)
+	{
+		++Pipeline->SampledFrameCount;
+	}
+	
+	// @Note Whatever was held back and got replaced counts from the newer frame, that's the one we show
+	if (HaveDamage && !IsRepeat)
+	{
+		Pipeline->ComposedFrameTime = Pipeline->AcquiredFrameTime;
+	}
+	
+	return DrawPendingFrame(Pipeline, TimeoutMS);
+}
+
+// @Note The held frame is about to go and the sampled pieces with it. If their draw is still waiting on the
+// pacer or the swap chain they get cropped into their slots after all, otherwise the screen has them already.
+internal void KeepSampledPieces(overlay_pipeline *Pipeline)
+{
+	compositor *Compositor = &Pipeline->Compositor;
+	
+	for (u32 PieceIndex = 0; PieceIndex < Pipeline->PieceCount; ++PieceIndex)
+	{
+		crop_piece *Piece = &Pipeline->Pieces[PieceIndex];
+		if (!Piece->SamplesSurface)
+		{
+			continue;
+		}
+		
+		Piece->SamplesSurface = false;
+		
+		if (Pipeline->PresentPending)
+		{
+			box CutBox = Piece->Mapping.SurfaceBox;
+			Compositor->Crop(Compositor->Context, &Pipeline->HeldFrame, PieceIndex, CutBox, &CutBox, 1);
+			
+			Pipeline->SlotContents[PieceIndex].IsSampled = false;
+			Pipeline->CroppedPixelCount += (u64)GetBoxWidth(CutBox) * (u64)GetBoxHeight(CutBox);
+			++Pipeline->MaterializedCount;
+		}
+		else
+		{
+			Piece->HasImage = false;
+		}
+	}
+}
+
+//
+// One iteration of the render loop: commands -> release -> acquire -> crop -> shade -> present
+//
+// The acquire waits at most TimeoutMS so commands from the window thread get looked at
+// even when the desktop is static. They get drawn from the frame we are still holding, or
+// if we are not holding one the source is told to hand over the current image right away,
+// either way without waiting for the desktop to change.
+//
+// A frame the pacer held back gets presented when its turn comes, the acquire doesn't wait past that.
+//
+// Returns true if anything was presented.
+//
+internal bool RunOverlayFrame(overlay_pipeline *Pipeline, u32 TimeoutMS)
+{
+	frame_source *Source = &Pipeline->Source;
+	bool Presented = false;
+	
+	//
+	// Held back present
+	//
+	
+	u32 AcquireTimeoutMS = TimeoutMS;
+	if (Pipeline->PresentPending)
+	{
+		Presented |= DrawPendingFrame(Pipeline, 0);
+		
+		// @Note Still waiting means the pacer wants it later or the swap chain is full, look again by then
+		if (Pipeline->PresentPending)
+		{
+			u64 Delay = GetPresentDelay(&Pipeline->Pacer, Pipeline->Clock.Now(Pipeline->Clock.Context));
+			AcquireTimeoutMS = (u32)Min((u64)TimeoutMS, Max((Delay + 999) / 1000, (u64)1));
+		}
+	}
+	
+	//
+	// Commands
+	//
+	
+	render_command Command;
+	bool HaveCommands = false;
+	while (PopRenderCommand(Pipeline->Commands, &Command))
+	{
+		HaveCommands = true;
+		if ((Pipeline->PendingCommandTime == 0) || (Command.IssueTime < Pipeline->PendingCommandTime))
+		{
+			Pipeline->PendingCommandTime = Command.IssueTime;
+		}
+	}
+	
+	ReadRenderState(Pipeline->StateExchange, &Pipeline->State);
+	SelectOutputs(Pipeline);
+	
+	if (HaveCommands)
+	{
+		if (Pipeline->HoldingFrame)
+		{
+			Presented |= ComposeFrame(Pipeline, &Pipeline->HeldFrame, true, TimeoutMS);
+		}
+		else
+		{
+			Source->Invalidate(Source->Context, Pipeline->SelectedOutputs);
+			InvalidateSlots(Pipeline, ~0u);
+			Pipeline->InvalidatedOutputs |= Pipeline->SelectedOutputs;
+		}
+	}
+	
+	//
+	// Next frame
+	//
+	
+	// @Note Release right before acquiring, DXGI can't hand us a new frame while we hold one anyway.
+	// The source can get lost on release, the texture is still good but we start over with a full copy.
+	if (Pipeline->HoldingFrame)
+	{
+		KeepSampledPieces(Pipeline);
+		
+		Pipeline->HoldingFrame = false;
+		if (!Source->Release(Source->Context, &Pipeline->HeldFrame))
+		{
+			InvalidateSlots(Pipeline, 1u << Pipeline->HeldFrame.OutputIndex);
+		}
+	}
+	
+	// @Note Only a wait that ended in a frame counts, timeouts are the desktop being still
+	u64 AcquireStart = StartLatency(Pipeline->LatencyRing);
+	acquire_result AcquireResult = Source->Acquire(Source->Context, AcquireTimeoutMS, &Pipeline->HeldFrame);
+	if (AcquireResult != AcquireResult_Frame)
+	{
+		if (AcquireResult == AcquireResult_Lost)
+		{
+			InvalidateSlots(Pipeline, ~0u);
+		}
+		else
+		{
+			Presented |= DrawPendingFrame(Pipeline, 0);
+		}
+		
+		return Presented;
+	}
+	
+	if (Pipeline->LatencyRing)
+	{
+		Pipeline->AcquiredFrameTime = Pipeline->LatencyRing->GetNanoseconds();
+		PushLatencySample(Pipeline->LatencyRing, LatencyStage_Acquire, Pipeline->AcquiredFrameTime - AcquireStart);
+	}
+	
+	++Pipeline->AcquiredFrameCount;
+	Pipeline->HoldingFrame = true;
+	
+	// @Note Only a desktop update tells us about the source's rate, a mouse move doesn't
+	if (Pipeline->HeldFrame.LastPresentTime != 0)
+	{
+		NoteSourceFrame(&Pipeline->Pacer, Pipeline->Clock.Now(Pipeline->Clock.Context));
+	}
+	
+	// @Note The state may have moved on while we were waiting
+	ReadRenderState(Pipeline->StateExchange, &Pipeline->State);
+	SelectOutputs(Pipeline);
+	
+	Presented |= ComposeFrame(Pipeline, &Pipeline->HeldFrame, false, TimeoutMS);
+	
+	return Presented;
+}
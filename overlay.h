@@ -0,0 +1,649 @@
+#if !defined(OVERLAY_H)
+#define OVERLAY_H
+
+//
+// Portable overlay core: capture -> crop -> shade -> present
+//
+// @Note Nothing in here touches the OS or the CRT. The platform layer (win32_main.cpp,
+// linux_main.cpp) hands us memory and plugs the backends into the stage tables below.
+//
+
+#include <stddef.h>
+#include <stdint.h>
+
+#if !defined(DEBUG_BUILD)
+#define DEBUG_BUILD 0
+#endif
+
+#define internal	static
+#define global		static
+
+#define GetArrayCount(Array)	(sizeof(Array) / sizeof((Array)[0]))
+#define Min(A, B)				((A) < (B) ? (A) : (B))
+#define Max(A, B)				((A) > (B) ? (A) : (B))
+
+#if DEBUG_BUILD
+#define Assert(Expression) if (!(Expression)) { *(volatile int *)0 = 0; }
+#else
+#define Assert(Expression)
+#endif
+
+#define Kilobytes(Value) ((size_t)(Value) * 1024)
+#define Megabytes(Value) (Kilobytes(Value) * 1024)
+
+// @Note For handing our constants to the shaders as defines
+#define STRINGIFY_(Value)	#Value
+#define STRINGIFY(Value)	STRINGIFY_(Value)
+
+typedef uint8_t  u8;
+typedef uint16_t u16;
+typedef uint32_t u32;
+typedef uint64_t u64;
+typedef int32_t  s32;
+typedef int64_t  s64;
+
+#include "overlay_atomics.h"
+
+struct v2
+{
+	float X;
+	float Y;
+};
+
+// @Note Same meaning as D3D11_BOX left/top/right/bottom, right and bottom are exclusive
+struct box
+{
+	int Left;
+	int Top;
+	int Right;
+	int Bottom;
+};
+
+inline int GetBoxWidth(box Box)  { return Box.Right  - Box.Left; }
+inline int GetBoxHeight(box Box) { return Box.Bottom - Box.Top;  }
+
+// @Note B8G8R8A8, same as DXGI_FORMAT_B8G8R8A8_UNORM, unless a captured frame's Format says otherwise
+struct bitmap
+{
+	u8 *Memory;
+	int Width;
+	int Height;
+	int Pitch;
+};
+
+#define BITMAP_BYTES_PER_PIXEL 4
+
+//
+// Memory
+//
+
+struct memory_arena
+{
+	u8    *Base;
+	size_t Size;
+	size_t Used;
+};
+
+internal void InitializeArena(memory_arena *Arena, void *Base, size_t Size)
+{
+	Arena->Base = (u8 *)Base;
+	Arena->Size = Size;
+	Arena->Used = 0;
+}
+
+// @Note 64 byte alignment so every push starts on its own cache line and is good for any SIMD width
+internal void *PushSize(memory_arena *Arena, size_t Size, size_t Alignment = 64)
+{
+	size_t Address = (size_t)(Arena->Base + Arena->Used);
+	size_t Offset  = (Alignment - (Address & (Alignment - 1))) & (Alignment - 1);
+	
+	Assert((Arena->Used + Offset + Size) <= Arena->Size);
+	
+	void *Result = Arena->Base + Arena->Used + Offset;
+	Arena->Used += Offset + Size;
+	
+	return Result;
+}
+
+#define PushStruct(Arena, type)			(type *)PushSize(Arena, sizeof(type))
+#define PushArray(Arena, Count, type)	(type *)PushSize(Arena, (Count) * sizeof(type))
+
+internal void CopyBytes(void *Destination, void *Source, size_t Size)
+{
+	u8 *Dest = (u8 *)Destination;
+	u8 *Src  = (u8 *)Source;
+	while (Size--)
+	{
+		*Dest++ = *Src++;
+	}
+}
+
+internal size_t GetStringLength(const char *String)
+{
+	size_t Length = 0;
+	for (; String[Length] != '\0'; ++Length)
+	{
+		// Do nothing
+	}
+	
+	return Length;
+}
+
+// @Note For the things that get resized while running, everything else comes out of an arena
+#define PLATFORM_ALLOCATE_MEMORY(Name) void *Name(size_t Size)
+typedef PLATFORM_ALLOCATE_MEMORY(platform_allocate_memory);
+
+#define PLATFORM_FREE_MEMORY(Name) void Name(void *Memory, size_t Size)
+typedef PLATFORM_FREE_MEMORY(platform_free_memory);
+
+// @Note Monotonic, for measuring on the machine itself, never mixed with an overlay_clock
+#define PLATFORM_GET_NANOSECONDS(Name) u64 Name()
+typedef PLATFORM_GET_NANOSECONDS(platform_get_nanoseconds);
+
+internal bitmap PushBitmap(memory_arena *Arena, int Width, int Height)
+{
+	bitmap Result;
+	Result.Width  = Width;
+	Result.Height = Height;
+	Result.Pitch  = Width * BITMAP_BYTES_PER_PIXEL;
+	Result.Memory = (u8 *)PushSize(Arena, (size_t)Result.Pitch * Height);
+	
+	return Result;
+}
+
+//
+// Render state, everything the window thread controls
+//
+
+// @Note How a crop gets scaled to its display, see overlay_scale.cpp
+enum scale_mode
+{
+	ScaleMode_Bilinear, // Straight from the crop, blurs and aliases when it shrinks a lot
+	ScaleMode_Nearest,  // Blocky, exact for pixel art scaled by a whole number
+	ScaleMode_Mip,      // Trilinear from a box filtered mip chain of the crop
+	ScaleMode_Bicubic,  // Catmull-Rom, separable, widened when it shrinks
+	ScaleMode_Lanczos,  // Lanczos 3, separable, widened when it shrinks
+	
+	ScaleMode_Count,
+};
+
+// @Note Bits of an effect key, see overlay_effects.cpp. Whichever are on run in this order, after the sample and
+// before the darken. A chain draws bilinear whatever the scaling mode, the edges come from its 2x2 texels.
+enum effect_flag
+{
+	Effect_ColourKey = 0x1, // Samples close to KeyColour come out fully transparent
+	Effect_Grayscale = 0x2, // BT.709 luminance in every channel
+	Effect_Contrast  = 0x4, // Stretched away from mid grey
+	Effect_Edges     = 0x8, // EdgeColour added where the luminance changes across the texels
+	
+	EffectKey_Count = 0x10,
+};
+
+// @Note Contrast pivots on 0.5 in sRGB, in linear light
+#define EFFECT_CONTRAST_PIVOT 0.21404114f
+
+// @Note What the effects do when they are on, colours in sRGB units like Darken
+struct effect_params
+{
+	u32 Key; // effect_flag bits, 0 for none
+	
+	float Contrast;     // 1 leaves it alone
+	float EdgeStrength; // Times the luminance gradient, 1 is faint
+	float EdgeColour[3];
+	float KeyColour[3];
+	float KeyTolerance; // Summed difference of the three channels in linear light
+};
+
+struct shade_params
+{
+	float Alpha;
+	float Darken; // In sRGB units, the shading takes it to linear
+	scale_mode Scale;
+	effect_params Effects;
+};
+
+// @Note How often the overlay presents, see overlay_pacing.cpp
+enum pacing_mode
+{
+	PacingMode_LowestLatency, // Whenever there is something new and the swap chain can take it
+	PacingMode_FixedCap,      // At most CapRate frames a second, evenly spaced
+	PacingMode_MatchSource,   // At the rate the desktop updates, evenly spaced
+	
+	PacingMode_Count,
+};
+
+struct pacing_params
+{
+	pacing_mode Mode;
+	u32 CapRate; // Frames a second for PacingMode_FixedCap
+};
+
+// @Note One window per overlay, all of them cut from the same captured frames
+#define MAX_OVERLAYS 8
+
+// @Note Every monitor on every adapter, each one captured on its own
+#define MAX_OUTPUTS 8
+
+struct overlay_region
+{
+	box CutBox;
+	
+	int DisplayWidth;
+	int DisplayHeight;
+};
+
+struct render_state
+{
+	// @Note Window thread coordinates of every output, the virtual desktop as it sees it. That is logical
+	// pixels when the process is not DPI aware, the render thread works out each output's scale from its
+	// real desktop. Cut boxes are in the same space and can cover more than one output.
+	u32 OutputCount;
+	box Outputs[MAX_OUTPUTS];
+	
+	u32 OverlayCount;
+	overlay_region Overlays[MAX_OVERLAYS];
+	
+	shade_params Shade;
+	pacing_params Pacing;
+	
+	// @Note Bumped by the window thread every time anything above changes
+	int Version;
+};
+
+//
+// Coordinate mapping, see overlay_mapping.cpp
+//
+
+// @Note Same order as DXGI_MODE_ROTATION minus UNSPECIFIED. The desktop the user sees is the
+// captured surface turned clockwise by this much.
+enum display_rotation
+{
+	DisplayRotation_Identity,
+	DisplayRotation_90,
+	DisplayRotation_180,
+	DisplayRotation_270,
+};
+
+// UV = Origin + X * AxisX + Y * AxisY, X and Y go 0..1 across the display left to right, top to bottom
+struct uv_transform
+{
+	v2 Origin;
+	v2 AxisX;
+	v2 AxisY;
+};
+
+struct coordinate_mapping
+{
+	// @Note The cut box in the captured surface, clamped to it. This is what gets cropped and
+	// what dirty rects get compared against, and the display texture is exactly this size.
+	box SurfaceBox;
+	int TextureWidth;
+	int TextureHeight;
+	
+	uv_transform UV;
+	
+	// @Note Texels under one display pixel along the display axes, below 1 is magnification
+	v2 TexelsPerPixel;
+};
+
+// @Note A cut box is cropped one output at a time, these are the parts of it. The display
+// texture has a slot per piece and every piece is drawn into its part of the overlay's display.
+#define MAX_CROP_PIECES 16
+
+struct crop_piece
+{
+	u32 OverlayIndex;
+	u32 OutputIndex;
+	
+	// @Note Where the piece goes in the overlay's display, 0..1 from the top-left. Neighbouring
+	// pieces share their edges exactly so the stitched display has no seams.
+	v2 DisplayMin;
+	v2 DisplayMax;
+	
+	// @Note Surface box and rotation on the piece's own output
+	coordinate_mapping Mapping;
+	
+	// @Note False until its slot has been cropped from a frame of its output, it isn't drawn before that
+	bool HasImage;
+	
+	// @Note Drawn straight from the acquired surface instead of its slot, see COMPOSITOR_SAMPLE
+	bool SamplesSurface;
+};
+
+// @Note The last thing an output told us about itself, from its most recent frame
+struct output_geometry
+{
+	display_rotation Rotation;
+	int DesktopWidth;
+	int DesktopHeight;
+};
+
+//
+// Stages
+//
+// @Note Function tables and not virtual classes, we link without the CRT (/NODEFAULTLIB)
+// so there is no _purecall for abstract interfaces.
+//
+
+enum acquire_result
+{
+	AcquireResult_Frame,
+	AcquireResult_Timeout,
+	AcquireResult_Lost, // The source was lost and will be recreated, try again
+};
+
+struct move_rect
+{
+	int SourceX;
+	int SourceY;
+	box Destination;
+};
+
+// @Note What the surface holds. An HDR output duplicates as FP16 or 10-bit, see overlay_colour.cpp
+enum surface_format
+{
+	SurfaceFormat_BGRA8,   // sRGB, the SDR desktop
+	SurfaceFormat_RGBA16F, // scRGB, linear BT.709 with 1.0 at 80 nits, can go past 1 and below 0
+	SurfaceFormat_RGB10A2, // HDR10, PQ encoded BT.2020
+	
+	SurfaceFormat_Count,
+};
+
+struct captured_frame
+{
+	void *Surface; // ID3D11Texture2D for DXGI, bitmap for the software source
+	
+	// @Note The crop converts anything but BGRA8 to it on the way into the display texture.
+	// White is the output's SDR white level in nits, HDR content brighter than it gets tone mapped.
+	surface_format Format;
+	float WhiteNits;
+	
+	// @Note Index into render_state Outputs
+	u32 OutputIndex;
+	
+	// @Note The source was created again (first frame, lost, invalidated) and this is its whole image,
+	// nothing we took from this output before is any good
+	bool SourceWasReset;
+	
+	// @Note The surface is in the output's native orientation, the desktop is what the user sees.
+	// Desktop size is in physical pixels and already rotated.
+	display_rotation Rotation;
+	int DesktopWidth;
+	int DesktopHeight;
+	
+	// @Note Zero when only the mouse moved and the desktop image is the same as last time
+	s64 LastPresentTime;
+	u32 AccumulatedFrames;
+	
+	// @Note Surface space, same as DXGI_OUTDUPL_MOVE_RECT and the dirty RECTs.
+	// When the metadata is not valid we don't know what changed and have to take everything.
+	bool MetadataIsValid;
+	
+	u32 MoveRectCount;
+	move_rect *MoveRects;
+	
+	u32 DirtyRectCount;
+	box *DirtyRects;
+};
+
+#define FRAME_SOURCE_ACQUIRE(Name) acquire_result Name(void *Context, u32 TimeoutMS, captured_frame *Frame)
+typedef FRAME_SOURCE_ACQUIRE(frame_source_acquire);
+
+#define FRAME_SOURCE_RELEASE(Name) bool Name(void *Context, captured_frame *Frame)
+typedef FRAME_SOURCE_RELEASE(frame_source_release);
+
+// The next acquire from each output in the mask has to return its whole current image straight away,
+// even if nothing changed. A source with a single output ignores the mask.
+#define FRAME_SOURCE_INVALIDATE(Name) void Name(void *Context, u32 OutputMask)
+typedef FRAME_SOURCE_INVALIDATE(frame_source_invalidate);
+
+// Only the outputs in the mask have to be captured from now on, the rest can let go of their duplication.
+// A newly selected output starts with its whole image. Optional, a single output source has nothing to select.
+#define FRAME_SOURCE_SELECT(Name) void Name(void *Context, u32 OutputMask)
+typedef FRAME_SOURCE_SELECT(frame_source_select);
+
+struct frame_source
+{
+	void *Context;
+	
+	frame_source_acquire    *Acquire;
+	frame_source_release    *Release;
+	frame_source_invalidate *Invalidate;
+	frame_source_select     *Select;
+};
+
+// Find room for every piece's crop in the display texture atlas and every overlay's display in the back buffer atlas.
+// SlotMoved[i] comes back true when piece i's crop is gone and has to be copied again in full.
+#define COMPOSITOR_LAYOUT(Name) void Name(void *Context, render_state *State, crop_piece *Pieces, u32 PieceCount, bool *SlotMoved)
+typedef COMPOSITOR_LAYOUT(compositor_layout);
+
+// Copy the cut box of the captured surface into the piece's slot of the display texture, which is exactly
+// the size of the cut box. Only the Regions (surface space, inside the cut box) changed, the rest is still good.
+// Returns false if the slot came out exactly as it was, a compositor that can't tell returns true.
+#define COMPOSITOR_CROP(Name) bool Name(void *Context, captured_frame *Frame, u32 PieceIndex, box CutBox, box *Regions, u32 RegionCount)
+typedef COMPOSITOR_CROP(compositor_crop);
+
+// Have the piece drawn straight from the captured surface's cut box instead of its slot of the display texture,
+// so nothing gets copied. The frame has to stay acquired until the draw is submitted. Returns false if the
+// surface can't be drawn from like that (format, scaling mode, no view of it), the piece is cropped instead. Optional.
+#define COMPOSITOR_SAMPLE(Name) bool Name(void *Context, render_state *State, captured_frame *Frame, u32 PieceIndex, box CutBox)
+typedef COMPOSITOR_SAMPLE(compositor_sample);
+
+// Clear the back buffer and draw every piece that has an image into its overlay's display with the overlay look (PixelMain) in one go
+#define COMPOSITOR_SHADE(Name) void Name(void *Context, render_state *State, crop_piece *Pieces, u32 PieceCount)
+typedef COMPOSITOR_SHADE(compositor_shade);
+
+// Wait at most TimeoutMS for the swap chain to have room for a frame, so we never queue one behind another.
+// Returns false on timeout, the room is kept for the next present once it is there. Optional.
+#define COMPOSITOR_WAIT(Name) bool Name(void *Context, u32 TimeoutMS)
+typedef COMPOSITOR_WAIT(compositor_wait);
+
+#define COMPOSITOR_PRESENT(Name) bool Name(void *Context)
+typedef COMPOSITOR_PRESENT(compositor_present);
+
+// @Note Kept up to date by the backend every time it (re)allocates something
+struct compositor_memory
+{
+	u64 TextureBytes;   // The display texture being drawn from
+	u64 PooledBytes;    // Every texture the pool holds on to, the one in use included
+	u64 SwapChainBytes; // All back buffers
+	
+	u32 TextureAllocationCount;
+	u32 TextureReuseCount;
+	u32 SwapChainResizeCount;
+};
+
+// @Note Counted by the backend's crop, what it took to get the surface into the display texture
+struct compositor_traffic
+{
+	u64 CopyCount;   // One per region copied
+	u64 CopiedBytes; // Written to the display texture
+	u64 SampleCount; // Pieces drawn from the surface without a copy
+};
+
+struct compositor
+{
+	void *Context;
+	
+	compositor_layout  *Layout;
+	compositor_crop    *Crop;
+	compositor_sample  *Sample;
+	compositor_shade   *Shade;
+	compositor_wait    *Wait;
+	compositor_present *Present;
+	
+	compositor_memory  *Memory;
+	compositor_traffic *Traffic;
+};
+
+// @Note Same layout as Instance in the shade shaders, 16 byte aligned so an array of them matches both
+// the HLSL cbuffer packing and GLSL std140
+struct overlay_instance
+{
+	float Destination[4];
+	float UVClamp[4];
+	uv_transform UV;
+	float Decode; // 1 when drawn straight from the desktop, which has no sRGB view
+	float Pad;
+};
+
+// @Note Same layout as the Effects constant buffer of the shade shaders, HLSL packing and GLSL std140 alike.
+// Colours are red green blue and in linear light, see GetEffectConstants.
+struct effect_constants
+{
+	float Alpha;
+	float Darken;
+	float Contrast;
+	float EdgeStrength;
+	float EdgeColour[4];
+	float KeyColour[3];
+	float KeyTolerance;
+};
+
+inline bool InstancesAreEqual(overlay_instance *A, overlay_instance *B)
+{
+	u32 *WordsA = (u32 *)A;
+	u32 *WordsB = (u32 *)B;
+	for (u32 WordIndex = 0; WordIndex < sizeof(overlay_instance) / sizeof(u32); ++WordIndex)
+	{
+		if (WordsA[WordIndex] != WordsB[WordIndex])
+		{
+			return false;
+		}
+	}
+	
+	return true;
+}
+
+// @Note Regions an HDR crop converts per draw, one instance each
+#define CONVERT_MAX_REGIONS 64
+
+// @Note For the GPU conversion pass, see ConvertCrop. Already a multiple of 16.
+struct convert_constant_buffer
+{
+	float Regions[CONVERT_MAX_REGIONS][4]; // Surface pixels, left top right bottom
+	float Offset[2];                       // From a surface pixel to its texel in the display texture
+	float TargetScale[2];                  // 2 over the display texture size, texels to clip space
+	float Scale;                           // colour_convert, puts SDR white on 1.0
+	float Pad[3];
+	float Mix[3][4];                       // BT2020To709 with its rows padded out
+};
+
+//
+// Clock
+//
+
+// Microseconds, only ever compared against itself
+#define OVERLAY_CLOCK_NOW(Name) u64 Name(void *Context)
+typedef OVERLAY_CLOCK_NOW(overlay_clock_now);
+
+struct overlay_clock
+{
+	void *Context;
+	
+	overlay_clock_now *Now;
+};
+
+//
+// Frame pacing, see overlay_pacing.cpp
+//
+
+struct frame_pacer
+{
+	pacing_params Params;
+	
+	// @Note Microseconds between presents for the cap, and the earliest the next one can go
+	u64 CapInterval;
+	u64 NextPresentTime;
+	u64 LastPresentTime;
+	
+	// @Note How far apart desktop updates arrive, smoothed, for PacingMode_MatchSource
+	u64 LastSourceTime;
+	u64 SourceInterval;
+	
+	// @Note Frames that were cropped and then replaced by a newer one before their turn to present
+	u64 DroppedFrameCount;
+	
+	// @Note How far each present landed from where the pacing wanted it, back to back presents only
+	u64 JitterCount;
+	u64 JitterTotal;
+	u64 JitterMax;
+};
+
+//
+// Pipeline
+//
+
+struct render_state_exchange;
+struct render_command_queue;
+
+struct crop_slot_contents
+{
+	bool IsValid;
+	u32  OutputIndex;
+	box  SurfaceBox;
+	
+	// @Note The last draw was straight from the surface, the slot itself holds nothing
+	bool IsSampled;
+};
+
+struct latency_ring;
+
+struct overlay_pipeline
+{
+	frame_source  Source;
+	compositor    Compositor;
+	overlay_clock Clock;
+	
+	render_state_exchange *StateExchange;
+	render_command_queue  *Commands;
+	render_state State;
+	
+	u32 PieceCount;
+	crop_piece Pieces[MAX_CROP_PIECES];
+	output_geometry OutputGeometry[MAX_OUTPUTS];
+	
+	// @Note Outputs the cut boxes touch, and the ones we are waiting on for a whole image
+	u32 SelectedOutputs;
+	u32 InvalidatedOutputs;
+	
+	// @Note Draw from the acquired surface when the compositor can, instead of cropping into the display texture
+	bool SampleSurfaces;
+	
+	// @Note The last frame stays acquired until right before we wait for the next one,
+	// so a command from the window thread can be re-cropped from it straight away
+	bool HoldingFrame;
+	captured_frame HeldFrame;
+	
+	// @Note Issue time of the oldest command that is not on screen yet, zero if none
+	u64 PendingCommandTime;
+	
+	// @Note What the display texture currently holds, so we can tell what needs copying and drawing
+	crop_slot_contents SlotContents[MAX_CROP_PIECES];
+	int DrawnVersion;
+	
+	// @Note The display texture has something newer than the screen, waiting for the pacer or the swap chain
+	frame_pacer Pacer;
+	bool PresentPending;
+	int ComposedVersion;
+	
+	// @Note Per-stage timings go here when set, see overlay_latency.cpp
+	latency_ring *LatencyRing;
+	u64 AcquiredFrameTime;
+	u64 ComposedFrameTime;
+	
+	u64 AcquiredFrameCount;
+	u64 PresentedFrameCount;
+	u64 SkippedFrameCount;
+	u64 CroppedPixelCount;
+	u64 UnchangedCropCount; // Damaged, copied, and the same pixels as before
+	u64 SampledFrameCount;  // Composed straight from the surface
+	u64 MaterializedCount;  // Sampled pieces copied after all, to outlive the frame
+	
+	// @Note Command issue -> Present returned, the input to photon latency as far as we can see it
+	u64 CommandCount;
+	u64 CommandLatencyTotal;
+	u64 CommandLatencyMax;
+};
+
+#endif
@@ -0,0 +1,541 @@
+//
+// Shelf packer for the overlay atlases
+//
+// @Note Every crop piece gets a slot in the crop atlas (the display texture) and every overlay one in
+// the display atlas (the swap chain every overlay window shows a part of). Slots come and go one at a time as
+// overlays are added, resized and removed, so the packer takes single inserts and removes instead
+// of packing everything in one go. Shelf heights are rounded up so close sizes share a shelf.
+//
+
+#define ATLAS_MAX_SHELVES	64
+#define ATLAS_MAX_SPANS		32
+#define ATLAS_SHELF_ROUNDING 8
+
+struct atlas_span
+{
+	int X;
+	int Width;
+};
+
+struct atlas_shelf
+{
+	int Y;
+	int Height;
+	
+	u32 AllocationCount;
+	
+	// @Note Sorted by X, neighbours always merged. A shelf never holds more allocations than it
+	// can have free spans, so removing never runs out of room.
+	u32 SpanCount;
+	atlas_span FreeSpans[ATLAS_MAX_SPANS];
+};
+
+struct atlas_packer
+{
+	int Width;
+	int Height;
+	
+	// @Note Shelves are sorted by Y and cover 0..UsedHeight without gaps
+	int UsedHeight;
+	u32 ShelfCount;
+	atlas_shelf Shelves[ATLAS_MAX_SHELVES];
+	
+	u64 UsedArea;
+};
+
+internal void InitializeAtlasPacker(atlas_packer *Packer, int Width, int Height)
+{
+	Packer->Width      = Width;
+	Packer->Height     = Height;
+	Packer->UsedHeight = 0;
+	Packer->ShelfCount = 0;
+	Packer->UsedArea   = 0;
+}
+
+internal void InitializeShelf(atlas_shelf *Shelf, int Y, int Height, int Width)
+{
+	Shelf->Y                     = Y;
+	Shelf->Height                = Height;
+	Shelf->AllocationCount       = 0;
+	Shelf->SpanCount             = 1;
+	Shelf->FreeSpans[0].X        = 0;
+	Shelf->FreeSpans[0].Width    = Width;
+}
+
+inline bool ShelfIsEmpty(atlas_shelf *Shelf)
+{
+	return Shelf->AllocationCount == 0;
+}
+
+// Smallest free span that fits, -1 if none
+internal int FindSpan(atlas_shelf *Shelf, int Width)
+{
+	if (Shelf->AllocationCount >= (ATLAS_MAX_SPANS - 1))
+	{
+		return -1;
+	}
+	
+	int Best = -1;
+	for (u32 SpanIndex = 0; SpanIndex < Shelf->SpanCount; ++SpanIndex)
+	{
+		int SpanWidth = Shelf->FreeSpans[SpanIndex].Width;
+		if ((SpanWidth >= Width) && ((Best < 0) || (SpanWidth < Shelf->FreeSpans[Best].Width)))
+		{
+			Best = (int)SpanIndex;
+		}
+	}
+	
+	return Best;
+}
+
+internal box AllocateFromShelf(atlas_packer *Packer, atlas_shelf *Shelf, int SpanIndex, int Width, int Height)
+{
+	atlas_span *Span = &Shelf->FreeSpans[SpanIndex];
+	
+	box Result;
+	Result.Left   = Span->X;
+	Result.Top    = Shelf->Y;
+	Result.Right  = Span->X + Width;
+	Result.Bottom = Shelf->Y + Height;
+	
+	Span->X     += Width;
+	Span->Width -= Width;
+	if (Span->Width == 0)
+	{
+		for (u32 Index = (u32)SpanIndex; Index + 1 < Shelf->SpanCount; ++Index)
+		{
+			Shelf->FreeSpans[Index] = Shelf->FreeSpans[Index + 1];
+		}
+		--Shelf->SpanCount;
+	}
+	
+	++Shelf->AllocationCount;
+	Packer->UsedArea += (u64)Width * Height;
+	
+	return Result;
+}
+
+// @Note Splits an empty shelf so the top part is exactly Height, the rest stays an empty shelf
+internal void SplitEmptyShelf(atlas_packer *Packer, u32 ShelfIndex, int Height)
+{
+	atlas_shelf *Shelf = &Packer->Shelves[ShelfIndex];
+	if ((Shelf->Height == Height) || (Packer->ShelfCount >= ATLAS_MAX_SHELVES))
+	{
+		return;
+	}
+	
+	for (u32 Index = Packer->ShelfCount; Index > ShelfIndex + 1; --Index)
+	{
+		Packer->Shelves[Index] = Packer->Shelves[Index - 1];
+	}
+	++Packer->ShelfCount;
+	
+	InitializeShelf(&Packer->Shelves[ShelfIndex + 1], Shelf->Y + Height, Shelf->Height - Height, Packer->Width);
+	Shelf->Height = Height;
+}
+
+//
+// Returns false if there is no room, the caller grows the atlas and packs everything again
+//
+internal bool AtlasInsert(atlas_packer *Packer, int Width, int Height, box *Result)
+{
+	if ((Width <= 0) || (Height <= 0) || (Width > Packer->Width) || (Height > Packer->Height))
+	{
+		return false;
+	}
+	
+	int ShelfHeight = Min((Height + ATLAS_SHELF_ROUNDING - 1) & ~(ATLAS_SHELF_ROUNDING - 1), Packer->Height);
+	
+	// @Note A used shelf that isn't much taller than what we need, the least wasteful one first
+	int BestShelf = -1;
+	int BestSpan  = -1;
+	for (u32 ShelfIndex = 0; ShelfIndex < Packer->ShelfCount; ++ShelfIndex)
+	{
+		atlas_shelf *Shelf = &Packer->Shelves[ShelfIndex];
+		if (ShelfIsEmpty(Shelf) || (Shelf->Height < Height) || (Shelf->Height > Height + Height / 2))
+		{
+			continue;
+		}
+		
+		int SpanIndex = FindSpan(Shelf, Width);
+		if ((SpanIndex >= 0) && ((BestShelf < 0) || (Shelf->Height < Packer->Shelves[BestShelf].Height)))
+		{
+			BestShelf = (int)ShelfIndex;
+			BestSpan  = SpanIndex;
+		}
+	}
+	
+	// Then an empty shelf left behind by removals, cut down to size
+	if (BestShelf < 0)
+	{
+		for (u32 ShelfIndex = 0; ShelfIndex < Packer->ShelfCount; ++ShelfIndex)
+		{
+			atlas_shelf *Shelf = &Packer->Shelves[ShelfIndex];
+			if (ShelfIsEmpty(Shelf) && (Shelf->Height >= Height) &&
+				((BestShelf < 0) || (Shelf->Height < Packer->Shelves[BestShelf].Height)))
+			{
+				BestShelf = (int)ShelfIndex;
+			}
+		}
+		
+		if (BestShelf >= 0)
+		{
+			SplitEmptyShelf(Packer, (u32)BestShelf, Min(ShelfHeight, Packer->Shelves[BestShelf].Height));
+			BestSpan = 0;
+		}
+	}
+	
+	// Then a new shelf on top
+	if ((BestShelf < 0) && (Packer->ShelfCount < ATLAS_MAX_SHELVES))
+	{
+		int NewHeight = (Packer->UsedHeight + ShelfHeight <= Packer->Height) ? ShelfHeight : Height;
+		if (Packer->UsedHeight + NewHeight <= Packer->Height)
+		{
+			BestShelf = (int)Packer->ShelfCount++;
+			BestSpan  = 0;
+			
+			InitializeShelf(&Packer->Shelves[BestShelf], Packer->UsedHeight, NewHeight, Packer->Width);
+			Packer->UsedHeight += NewHeight;
+		}
+	}
+	
+	// Last resort, any shelf it fits on no matter how much height goes to waste
+	if (BestShelf < 0)
+	{
+		for (u32 ShelfIndex = 0; ShelfIndex < Packer->ShelfCount; ++ShelfIndex)
+		{
+			atlas_shelf *Shelf = &Packer->Shelves[ShelfIndex];
+			int SpanIndex = (Shelf->Height >= Height) ? FindSpan(Shelf, Width) : -1;
+			if (SpanIndex >= 0)
+			{
+				BestShelf = (int)ShelfIndex;
+				BestSpan  = SpanIndex;
+				break;
+			}
+		}
+	}
+	
+	if ((BestShelf < 0) || (BestSpan < 0))
+	{
+		return false;
+	}
+	
+	*Result = AllocateFromShelf(Packer, &Packer->Shelves[BestShelf], BestSpan, Width, Height);
+	return true;
+}
+
+internal void AtlasRemove(atlas_packer *Packer, box Box)
+{
+	u32 ShelfIndex = 0;
+	while ((ShelfIndex < Packer->ShelfCount) && (Packer->Shelves[ShelfIndex].Y != Box.Top))
+	{
+		++ShelfIndex;
+	}
+	
+	Assert(ShelfIndex < Packer->ShelfCount);
+	if (ShelfIndex == Packer->ShelfCount)
+	{
+		return;
+	}
+	
+	atlas_shelf *Shelf = &Packer->Shelves[ShelfIndex];
+	
+	//
+	// Give the span back, merged with whatever free space is next to it
+	//
+	
+	u32 Insert = 0;
+	while ((Insert < Shelf->SpanCount) && (Shelf->FreeSpans[Insert].X < Box.Left))
+	{
+		++Insert;
+	}
+	
+	atlas_span Span;
+	Span.X     = Box.Left;
+	Span.Width = GetBoxWidth(Box);
+	
+	bool MergesLeft  = (Insert > 0) && (Shelf->FreeSpans[Insert - 1].X + Shelf->FreeSpans[Insert - 1].Width == Span.X);
+	bool MergesRight = (Insert < Shelf->SpanCount) && (Span.X + Span.Width == Shelf->FreeSpans[Insert].X);
+	
+	if (MergesLeft && MergesRight)
+	{
+		Shelf->FreeSpans[Insert - 1].Width += Span.Width + Shelf->FreeSpans[Insert].Width;
+		for (u32 Index = Insert; Index + 1 < Shelf->SpanCount; ++Index)
+		{
+			Shelf->FreeSpans[Index] = Shelf->FreeSpans[Index + 1];
+		}
+		--Shelf->SpanCount;
+	}
+	else if (MergesLeft)
+	{
+		Shelf->FreeSpans[Insert - 1].Width += Span.Width;
+	}
+	else if (MergesRight)
+	{
+		Shelf->FreeSpans[Insert].X      = Span.X;
+		Shelf->FreeSpans[Insert].Width += Span.Width;
+	}
+	else
+	{
+		for (u32 Index = Shelf->SpanCount; Index > Insert; --Index)
+		{
+			Shelf->FreeSpans[Index] = Shelf->FreeSpans[Index - 1];
+		}
+		Shelf->FreeSpans[Insert] = Span;
+		++Shelf->SpanCount;
+	}
+	
+	--Shelf->AllocationCount;
+	Packer->UsedArea -= (u64)GetBoxWidth(Box) * GetBoxHeight(Box);
+	
+	if (!ShelfIsEmpty(Shelf))
+	{
+		return;
+	}
+	
+	//
+	// Empty shelves next to each other become one, and the ones on top go away entirely
+	//
+	
+	if ((ShelfIndex + 1 < Packer->ShelfCount) && ShelfIsEmpty(&Packer->Shelves[ShelfIndex + 1]))
+	{
+		Shelf->Height += Packer->Shelves[ShelfIndex + 1].Height;
+		for (u32 Index = ShelfIndex + 1; Index + 1 < Packer->ShelfCount; ++Index)
+		{
+			Packer->Shelves[Index] = Packer->Shelves[Index + 1];
+		}
+		--Packer->ShelfCount;
+	}
+	
+	if ((ShelfIndex > 0) && ShelfIsEmpty(&Packer->Shelves[ShelfIndex - 1]))
+	{
+		Packer->Shelves[ShelfIndex - 1].Height += Shelf->Height;
+		for (u32 Index = ShelfIndex; Index + 1 < Packer->ShelfCount; ++Index)
+		{
+			Packer->Shelves[Index] = Packer->Shelves[Index + 1];
+		}
+		--Packer->ShelfCount;
+	}
+	
+	if ((Packer->ShelfCount > 0) && ShelfIsEmpty(&Packer->Shelves[Packer->ShelfCount - 1]))
+	{
+		--Packer->ShelfCount;
+		Packer->UsedHeight = Packer->Shelves[Packer->ShelfCount].Y;
+	}
+}
+
+//
+// One slot per crop piece or per overlay display, kept in step with their sizes
+//
+
+#define ATLAS_MIN_SIZE 64
+#define ATLAS_MAX_SLOTS Max(MAX_CROP_PIECES, MAX_OVERLAYS)
+
+struct atlas_layout
+{
+	atlas_packer Packer;
+	int MaxSize;
+	
+	// @Note Empty when the piece or overlay is gone or didn't fit even at MaxSize
+	box Slots[ATLAS_MAX_SLOTS];
+	
+	u32 RebuildCount;
+};
+
+internal void InitializeAtlasLayout(atlas_layout *Layout, int MaxSize)
+{
+	InitializeAtlasPacker(&Layout->Packer, 0, 0);
+	Layout->MaxSize      = MaxSize;
+	Layout->RebuildCount = 0;
+	
+	for (u32 SlotIndex = 0; SlotIndex < ATLAS_MAX_SLOTS; ++SlotIndex)
+	{
+		Layout->Slots[SlotIndex] = box{ 0, 0, 0, 0 };
+	}
+}
+
+inline int RoundUpToMinSize(int Value)
+{
+	return (Value + ATLAS_MIN_SIZE - 1) & ~(ATLAS_MIN_SIZE - 1);
+}
+
+// @Note Doubles the shorter side so the atlas stays close to square, false once both are at MaxSize
+internal bool GrowAtlasSize(int *Width, int *Height, int MaxSize)
+{
+	if ((*Height < *Width) && (*Height < MaxSize))
+	{
+		*Height = Min(*Height * 2, MaxSize);
+	}
+	else if (*Width < MaxSize)
+	{
+		*Width = Min(*Width * 2, MaxSize);
+	}
+	else if (*Height < MaxSize)
+	{
+		*Height = Min(*Height * 2, MaxSize);
+	}
+	else
+	{
+		return false;
+	}
+	
+	return true;
+}
+
+// @Note Tallest first packs shelves tightest
+internal bool PackAll(atlas_layout *Layout, int *Widths, int *Heights, u32 Count)
+{
+	u32 Order[ATLAS_MAX_SLOTS];
+	for (u32 Index = 0; Index < Count; ++Index)
+	{
+		u32 Insert = Index;
+		while ((Insert > 0) && (Heights[Order[Insert - 1]] < Heights[Index]))
+		{
+			Order[Insert] = Order[Insert - 1];
+			--Insert;
+		}
+		Order[Insert] = Index;
+	}
+	
+	bool AllFit = true;
+	for (u32 Index = 0; Index < Count; ++Index)
+	{
+		u32 Slot = Order[Index];
+		if (!AtlasInsert(&Layout->Packer, Widths[Slot], Heights[Slot], &Layout->Slots[Slot]))
+		{
+			Layout->Slots[Slot] = box{ 0, 0, 0, 0 };
+			AllFit = false;
+		}
+	}
+	
+	return AllFit;
+}
+
+//
+// Frees the slots of overlays that went away or changed size, then finds room for the new ones.
+// If that fails the atlas grows and everything gets packed again. SlotMoved[i] comes back true for
+// every slot whose contents are gone, and the function returns true if that was all of them.
+//
+internal bool UpdateAtlasLayout(atlas_layout *Layout, int *Widths, int *Heights, u32 Count, bool *SlotMoved)
+{
+	atlas_packer *Packer = &Layout->Packer;
+	
+	bool NeedsRebuild = (Packer->Width == 0);
+	for (u32 SlotIndex = 0; SlotIndex < ATLAS_MAX_SLOTS; ++SlotIndex)
+	{
+		box *Slot = &Layout->Slots[SlotIndex];
+		SlotMoved[SlotIndex] = false;
+		
+		bool Keep = (SlotIndex < Count) && (GetBoxWidth(*Slot) == Widths[SlotIndex]) && (GetBoxHeight(*Slot) == Heights[SlotIndex]);
+		if (!Keep && !BoxIsEmpty(*Slot))
+		{
+			AtlasRemove(Packer, *Slot);
+			*Slot = box{ 0, 0, 0, 0 };
+		}
+	}
+	
+	for (u32 SlotIndex = 0; (SlotIndex < Count) && !NeedsRebuild; ++SlotIndex)
+	{
+		box *Slot = &Layout->Slots[SlotIndex];
+		if (BoxIsEmpty(*Slot))
+		{
+			SlotMoved[SlotIndex] = true;
+			NeedsRebuild = !AtlasInsert(Packer, Widths[SlotIndex], Heights[SlotIndex], Slot);
+		}
+	}
+	
+	// @Note Once big overlays are gone the atlas would stay at its high water mark, so start over from
+	// the smallest size when less than an eighth of it is in use. Otherwise it only ever grows, starting
+	// from the current size, so a resize drag doesn't shrink and grow it again every other frame.
+	u64 PackerArea = (u64)Packer->Width * Packer->Height;
+	bool Shrink = (Packer->UsedArea * 8 < PackerArea) && (PackerArea > (u64)ATLAS_MIN_SIZE * ATLAS_MIN_SIZE);
+	
+	if (!NeedsRebuild && !Shrink)
+	{
+		return false;
+	}
+	
+	//
+	// Grow until everything fits, starting from the smallest size that could possibly work
+	//
+	
+	int Width  = Shrink ? ATLAS_MIN_SIZE : Max(Packer->Width,  ATLAS_MIN_SIZE);
+	int Height = Shrink ? ATLAS_MIN_SIZE : Max(Packer->Height, ATLAS_MIN_SIZE);
+	u64 Area   = 0;
+	for (u32 SlotIndex = 0; SlotIndex < Count; ++SlotIndex)
+	{
+		Width  = Max(Width,  RoundUpToMinSize(Widths[SlotIndex]));
+		Height = Max(Height, RoundUpToMinSize(Heights[SlotIndex]));
+		Area  += (u64)Widths[SlotIndex] * Heights[SlotIndex];
+	}
+	
+	Width  = Min(Width,  Layout->MaxSize);
+	Height = Min(Height, Layout->MaxSize);
+	
+	// @Note Leave room to grow into after a shrink, or the next resize drag grows it straight back
+	u64 MinArea = Shrink ? 2 * Area : Area;
+	while (((u64)Width * Height < MinArea) && GrowAtlasSize(&Width, &Height, Layout->MaxSize))
+	{
+		// Keep growing
+	}
+	
+	for (;;)
+	{
+		InitializeAtlasPacker(Packer, Width, Height);
+		for (u32 SlotIndex = 0; SlotIndex < ATLAS_MAX_SLOTS; ++SlotIndex)
+		{
+			Layout->Slots[SlotIndex] = box{ 0, 0, 0, 0 };
+		}
+		
+		if (PackAll(Layout, Widths, Heights, Count) || !GrowAtlasSize(&Width, &Height, Layout->MaxSize))
+		{
+			break;
+		}
+	}
+	
+	for (u32 SlotIndex = 0; SlotIndex < ATLAS_MAX_SLOTS; ++SlotIndex)
+	{
+		SlotMoved[SlotIndex] = (SlotIndex < Count);
+	}
+	
+	++Layout->RebuildCount;
+	return true;
+}
+
+// Smallest box from the origin that covers every slot, what the display atlas really needs
+internal box GetAtlasBounds(atlas_layout *Layout)
+{
+	box Result = { 0, 0, 1, 1 };
+	for (u32 SlotIndex = 0; SlotIndex < ATLAS_MAX_SLOTS; ++SlotIndex)
+	{
+		box Slot = Layout->Slots[SlotIndex];
+		if (!BoxIsEmpty(Slot))
+		{
+			Result.Right  = Max(Result.Right,  Slot.Right);
+			Result.Bottom = Max(Result.Bottom, Slot.Bottom);
+		}
+	}
+	
+	return Result;
+}
+
+//
+// Overlay UVs (0..1 over its own crop) -> atlas UVs (0..1 over the whole atlas)
+//
+internal uv_transform GetAtlasUV(uv_transform UV, box Slot, int AtlasWidth, int AtlasHeight)
+{
+	float ScaleX  = (float)GetBoxWidth(Slot)  / (float)AtlasWidth;
+	float ScaleY  = (float)GetBoxHeight(Slot) / (float)AtlasHeight;
+	float OffsetX = (float)Slot.Left / (float)AtlasWidth;
+	float OffsetY = (float)Slot.Top  / (float)AtlasHeight;
+	
+	uv_transform Result;
+	Result.Origin.X = OffsetX + UV.Origin.X * ScaleX;
+	Result.Origin.Y = OffsetY + UV.Origin.Y * ScaleY;
+	Result.AxisX.X  = UV.AxisX.X * ScaleX;
+	Result.AxisX.Y  = UV.AxisX.Y * ScaleY;
+	Result.AxisY.X  = UV.AxisY.X * ScaleX;
+	Result.AxisY.Y  = UV.AxisY.Y * ScaleY;
+	
+	return Result;
+}
@@ -0,0 +1,121 @@
+#if !defined(OVERLAY_ATOMICS_H)
+#define OVERLAY_ATOMICS_H
+
+//
+// Atomics for the threads that share state: MSVC intrinsics or the GCC/Clang __atomic builtins.
+//
+// @Note No <atomic>, it drags the CRT in. Loads are acquire, stores are release, read-modify-writes are full barriers.
+//
+
+#if defined(_MSC_VER)
+
+#include <intrin.h>
+
+#if defined(_M_ARM64)
+#define HardwareBarrier() __dmb(_ARM64_BARRIER_ISH)
+#define SpinPause() __yield()
+#else
+// @Note x64 doesn't reorder loads with loads or stores with stores, keeping the compiler honest is enough
+#define HardwareBarrier() _ReadWriteBarrier()
+#define SpinPause() _mm_pause()
+#endif
+
+#define CompletePreviousReadsBeforeFutureReads()	HardwareBarrier()
+#define CompletePreviousWritesBeforeFutureWrites()	HardwareBarrier()
+
+inline u32 AtomicLoadU32(u32 volatile *Value)
+{
+	u32 Result = *Value;
+	HardwareBarrier();
+	return Result;
+}
+
+inline void AtomicStoreU32(u32 volatile *Value, u32 New)
+{
+	HardwareBarrier();
+	*Value = New;
+}
+
+inline u64 AtomicLoadU64(u64 volatile *Value)
+{
+	u64 Result = *Value;
+	HardwareBarrier();
+	return Result;
+}
+
+inline void AtomicStoreU64(u64 volatile *Value, u64 New)
+{
+	HardwareBarrier();
+	*Value = New;
+}
+
+inline u32 AtomicExchangeU32(u32 volatile *Value, u32 New)
+{
+	return (u32)_InterlockedExchange((long volatile *)Value, (long)New);
+}
+
+// Returns the value before the exchange, it happened if that equals Expected
+inline u32 AtomicCompareExchangeU32(u32 volatile *Value, u32 New, u32 Expected)
+{
+	return (u32)_InterlockedCompareExchange((long volatile *)Value, (long)New, (long)Expected);
+}
+
+inline u64 AtomicCompareExchangeU64(u64 volatile *Value, u64 New, u64 Expected)
+{
+	return (u64)_InterlockedCompareExchange64((__int64 volatile *)Value, (__int64)New, (__int64)Expected);
+}
+
+// Returns the value before the add
+inline u32 AtomicAddU32(u32 volatile *Value, u32 Addend)
+{
+	return (u32)_InterlockedExchangeAdd((long volatile *)Value, (long)Addend);
+}
+
+inline u64 AtomicAddU64(u64 volatile *Value, u64 Addend)
+{
+	return (u64)_InterlockedExchangeAdd64((__int64 volatile *)Value, (__int64)Addend);
+}
+
+#else
+
+#if defined(__x86_64__) || defined(__i386__)
+#define SpinPause() __builtin_ia32_pause()
+#elif defined(__aarch64__)
+#define SpinPause() __asm__ __volatile__("yield")
+#else
+#define SpinPause()
+#endif
+
+#define CompletePreviousReadsBeforeFutureReads()	__atomic_thread_fence(__ATOMIC_ACQUIRE)
+#define CompletePreviousWritesBeforeFutureWrites()	__atomic_thread_fence(__ATOMIC_RELEASE)
+
+inline u32 AtomicLoadU32(u32 volatile *Value)				{ return __atomic_load_n(Value, __ATOMIC_ACQUIRE); }
+inline void AtomicStoreU32(u32 volatile *Value, u32 New)	{ __atomic_store_n(Value, New, __ATOMIC_RELEASE); }
+inline u64 AtomicLoadU64(u64 volatile *Value)				{ return __atomic_load_n(Value, __ATOMIC_ACQUIRE); }
+inline void AtomicStoreU64(u64 volatile *Value, u64 New)	{ __atomic_store_n(Value, New, __ATOMIC_RELEASE); }
+
+inline u32 AtomicExchangeU32(u32 volatile *Value, u32 New)
+{
+	return __atomic_exchange_n(Value, New, __ATOMIC_SEQ_CST);
+}
+
+// Returns the value before the exchange, it happened if that equals Expected
+inline u32 AtomicCompareExchangeU32(u32 volatile *Value, u32 New, u32 Expected)
+{
+	__atomic_compare_exchange_n(Value, &Expected, New, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+	return Expected;
+}
+
+inline u64 AtomicCompareExchangeU64(u64 volatile *Value, u64 New, u64 Expected)
+{
+	__atomic_compare_exchange_n(Value, &Expected, New, false, __ATOMIC_SEQ_CST, __ATOMIC_SEQ_CST);
+	return Expected;
+}
+
+// Returns the value before the add
+inline u32 AtomicAddU32(u32 volatile *Value, u32 Addend)	{ return __atomic_fetch_add(Value, Addend, __ATOMIC_SEQ_CST); }
+inline u64 AtomicAddU64(u64 volatile *Value, u64 Addend)	{ return __atomic_fetch_add(Value, Addend, __ATOMIC_SEQ_CST); }
+
+#endif
+
+#endif
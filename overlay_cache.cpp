@@ -0,0 +1,488 @@
+//
+// Shader cache: compiled shader bytecode on disk, keyed by everything the compile was made from
+//
+// @Note The key is a hash of the source, the entry point, the target, the flags and every define, so an edited
+// shader or another build's defines just miss. Every entry is one file named after its key. A file is written
+// under a name of its own and renamed over the entry, so a reader sees the old entry, the new one or none, never
+// half of one. What is read is checked against its header (key, size, checksum), anything that doesn't check out
+// is deleted and counts as a miss. The directory is kept under a size budget by deleting the oldest entries.
+//
+// The bytecode baked into the binary at build time is looked up by the same key, see FindEmbeddedShader.
+//
+
+#define SHADER_CACHE_MAGIC   0x4353564F // "OVSC"
+#define SHADER_CACHE_VERSION 1
+
+#define SHADER_CACHE_MAX_PATH  260
+#define SHADER_CACHE_MAX_SIZE  Megabytes(1) // Anything bigger isn't bytecode of ours
+#define SHADER_CACHE_MAX_FILES 256          // Looked at per eviction, the rest waits for the next one
+
+// @Note A temp file this much older than the newest file is left over from a writer that died, in nanoseconds
+#define SHADER_CACHE_STALE_TEMP 3600000000000ull
+
+//
+// Files
+//
+
+struct platform_file_info
+{
+	char Name[64];
+	u64 Size;
+	u64 WriteTime; // Nanoseconds, only ever compared with other files'
+};
+
+// Reads at most MemorySize bytes of the file into Memory, *FileSize gets the size of all of it. A MemorySize of
+// zero only asks for the size. Returns false if there is no such file or it can't be read.
+#define PLATFORM_READ_FILE(Name) bool Name(char *Path, void *Memory, size_t MemorySize, size_t *FileSize)
+typedef PLATFORM_READ_FILE(platform_read_file);
+
+// Creates or truncates the file. Returns false if not all of it got written.
+#define PLATFORM_WRITE_FILE(Name) bool Name(char *Path, void *Memory, size_t Size)
+typedef PLATFORM_WRITE_FILE(platform_write_file);
+
+// Renames From over To in one step, To is either the old file or the new one to anybody looking
+#define PLATFORM_REPLACE_FILE(Name) bool Name(char *From, char *To)
+typedef PLATFORM_REPLACE_FILE(platform_replace_file);
+
+#define PLATFORM_DELETE_FILE(Name) void Name(char *Path)
+typedef PLATFORM_DELETE_FILE(platform_delete_file);
+
+// Fills Files with at most MaxCount of the files in Directory, returns how many. Names that don't fit are skipped.
+#define PLATFORM_LIST_FILES(Name) u32 Name(char *Directory, platform_file_info *Files, u32 MaxCount)
+typedef PLATFORM_LIST_FILES(platform_list_files);
+
+struct platform_file_api
+{
+	platform_read_file    *ReadFile;
+	platform_write_file   *WriteFile;
+	platform_replace_file *ReplaceFile;
+	platform_delete_file  *DeleteFile;
+	platform_list_files   *ListFiles;
+};
+
+//
+// Key
+//
+
+struct shader_key
+{
+	u64 Low;  // FNV-1a
+	u64 High; // Multiply-rotate, so one lane colliding doesn't make the key collide
+};
+
+inline shader_key StartShaderKey()
+{
+	shader_key Key;
+	Key.Low  = 14695981039346656037ull;
+	Key.High = 0x9E3779B97F4A7C15ull;
+	
+	return Key;
+}
+
+internal void MixShaderKey(shader_key *Key, void *Data, size_t Size)
+{
+	u8 *Bytes = (u8 *)Data;
+	u64 Low  = Key->Low;
+	u64 High = Key->High;
+	for (size_t Index = 0; Index < Size; ++Index)
+	{
+		Low  = (Low ^ Bytes[Index]) * 1099511628211ull;
+		High = (High ^ Bytes[Index]) * 0xC2B2AE3D27D4EB4Full;
+		High = (High << 29) | (High >> 35);
+	}
+	
+	Key->Low  = Low;
+	Key->High = High;
+}
+
+// @Note The terminator too, so "A" "BC" and "AB" "C" are different keys. NULL mixes in as an empty string.
+internal void MixShaderKeyString(shader_key *Key, const char *Text)
+{
+	char Empty = 0;
+	MixShaderKey(Key, Text ? (void *)Text : (void *)&Empty, Text ? GetStringLength(Text) + 1 : 1);
+}
+
+inline bool ShaderKeysAreEqual(shader_key A, shader_key B)
+{
+	return (A.Low == B.Low) && (A.High == B.High);
+}
+
+internal u32 GetShaderChecksum(void *Data, size_t Size)
+{
+	u8 *Bytes = (u8 *)Data;
+	u32 Check = 2166136261u;
+	for (size_t Index = 0; Index < Size; ++Index)
+	{
+		Check = (Check ^ Bytes[Index]) * 16777619u;
+	}
+	
+	return Check;
+}
+
+//
+// Cache
+//
+
+struct shader_blob
+{
+	void *Data;
+	u32 Size;
+};
+
+// @Note On disk in front of the bytecode, 32 bytes
+struct shader_cache_header
+{
+	u32 Magic;
+	u32 Version;
+	shader_key Key;
+	u32 Size;
+	u32 Check; // GetShaderChecksum of the bytecode
+};
+
+struct shader_cache
+{
+	platform_file_api *Files;
+	platform_allocate_memory *AllocateMemory;
+	platform_free_memory     *FreeMemory;
+	
+	char Directory[SHADER_CACHE_MAX_PATH];
+	u64 MaxBytes;
+	
+	// @Note Tells this writer's temp files from those of another process on the same directory
+	u32 WriterID;
+	u32 TempCount;
+	
+	u32 HitCount;
+	u32 MissCount;
+	u32 RejectedCount; // Found but didn't check out, counted as misses too
+	u32 StoredCount;
+	u32 EvictedCount;
+	u64 EvictedBytes;
+};
+
+internal void InitializeShaderCache(shader_cache *Cache, platform_file_api *Files, platform_allocate_memory *AllocateMemory,
+									platform_free_memory *FreeMemory, char *Directory, u64 MaxBytes, u32 WriterID)
+{
+	*Cache = {};
+	Cache->Files          = Files;
+	Cache->AllocateMemory = AllocateMemory;
+	Cache->FreeMemory     = FreeMemory;
+	Cache->MaxBytes       = MaxBytes;
+	Cache->WriterID       = WriterID;
+	
+	text_buffer Path = { Cache->Directory, SHADER_CACHE_MAX_PATH - 1, 0 };
+	AppendText(&Path, Directory);
+	Path.Memory[Path.Used] = 0;
+}
+
+internal void AppendHex(text_buffer *Buffer, u64 Value, u32 DigitCount)
+{
+	while (DigitCount-- && (Buffer->Used < Buffer->Size))
+	{
+		Buffer->Memory[Buffer->Used++] = "0123456789abcdef"[(Value >> (DigitCount * 4)) & 0xF];
+	}
+}
+
+// @Note Path has room for SHADER_CACHE_MAX_PATH, a path that doesn't fit comes out cut off and just misses
+internal void BuildShaderCachePath(shader_cache *Cache, shader_key Key, bool IsTemp, char *Path)
+{
+	text_buffer Text = { Path, SHADER_CACHE_MAX_PATH - 1, 0 };
+	AppendText(&Text, Cache->Directory);
+	AppendText(&Text, "/");
+	AppendHex(&Text, Key.High, 16);
+	AppendHex(&Text, Key.Low, 16);
+	if (IsTemp)
+	{
+		AppendText(&Text, ".");
+		AppendHex(&Text, Cache->WriterID, 8);
+		AppendText(&Text, "-");
+		AppendNumber(&Text, ++Cache->TempCount);
+		AppendText(&Text, ".tmp");
+	}
+	else
+	{
+		AppendText(&Text, ".bin");
+	}
+	Path[Text.Used] = 0;
+}
+
+inline void *GetCacheEntry(shader_blob Blob)
+{
+	return (u8 *)Blob.Data - sizeof(shader_cache_header);
+}
+
+// @Note Only for what LookupShaderCache returned
+internal void ReleaseCachedShader(shader_cache *Cache, shader_blob Blob)
+{
+	if (Blob.Data)
+	{
+		Cache->FreeMemory(GetCacheEntry(Blob), sizeof(shader_cache_header) + Blob.Size);
+	}
+}
+
+//
+// Returns the bytecode stored under Key, Data is NULL on a miss. The bytecode stays until ReleaseCachedShader.
+//
+internal shader_blob LookupShaderCache(shader_cache *Cache, shader_key Key)
+{
+	shader_blob Blob = { NULL, 0 };
+	
+	char Path[SHADER_CACHE_MAX_PATH];
+	BuildShaderCachePath(Cache, Key, false, Path);
+	
+	shader_cache_header Header;
+	size_t FileSize;
+	if (!Cache->Files->ReadFile(Path, &Header, sizeof(Header), &FileSize))
+	{
+		++Cache->MissCount;
+		return Blob;
+	}
+	
+	// @Note The header is read again with the bytecode, the file can have been replaced in between
+	bool IsValid = (FileSize >= sizeof(Header)) && (FileSize - sizeof(Header) <= SHADER_CACHE_MAX_SIZE);
+	u8 *Entry = NULL;
+	if (IsValid)
+	{
+		Entry = (u8 *)Cache->AllocateMemory(FileSize);
+		size_t ReadSize;
+		IsValid = Entry && Cache->Files->ReadFile(Path, Entry, FileSize, &ReadSize) && (ReadSize == FileSize);
+	}
+	
+	if (IsValid)
+	{
+		Header = *(shader_cache_header *)Entry;
+		IsValid = (Header.Magic == SHADER_CACHE_MAGIC) && (Header.Version == SHADER_CACHE_VERSION) &&
+			ShaderKeysAreEqual(Header.Key, Key) && (Header.Size == FileSize - sizeof(Header)) &&
+			(Header.Check == GetShaderChecksum(Entry + sizeof(Header), Header.Size));
+	}
+	
+	if (!IsValid)
+	{
+		// @Note Torn, truncated or from another version, it gets written again after the compile
+		if (Entry)
+		{
+			Cache->FreeMemory(Entry, FileSize);
+		}
+		Cache->Files->DeleteFile(Path);
+		
+		++Cache->RejectedCount;
+		++Cache->MissCount;
+		return Blob;
+	}
+	
+	Blob.Data = Entry + sizeof(Header);
+	Blob.Size = Header.Size;
+	++Cache->HitCount;
+	
+	return Blob;
+}
+
+// @Note A name the cache made: the 32 digit key, for a temp file the writer and count after it, then Extension
+internal bool IsCacheFile(char *Name, const char *Extension)
+{
+	size_t NameLength = GetStringLength(Name);
+	size_t ExtensionLength = GetStringLength(Extension);
+	if (NameLength < 32 + ExtensionLength)
+	{
+		return false;
+	}
+	
+	for (size_t Index = 0; Index < ExtensionLength; ++Index)
+	{
+		if (Name[NameLength - ExtensionLength + Index] != Extension[Index])
+		{
+			return false;
+		}
+	}
+	
+	return true;
+}
+
+internal void BuildShaderCacheFilePath(shader_cache *Cache, char *Name, char *Path)
+{
+	text_buffer Text = { Path, SHADER_CACHE_MAX_PATH - 1, 0 };
+	AppendText(&Text, Cache->Directory);
+	AppendText(&Text, "/");
+	AppendText(&Text, Name);
+	Path[Text.Used] = 0;
+}
+
+//
+// Deletes the oldest entries until the rest fit in the budget, the newest one always stays. Temp files
+// that are long older than the newest file are left over from a writer that died and go too.
+//
+internal void EvictShaderCache(shader_cache *Cache)
+{
+	size_t ListSize = SHADER_CACHE_MAX_FILES * sizeof(platform_file_info);
+	platform_file_info *Files = (platform_file_info *)Cache->AllocateMemory(ListSize);
+	if (!Files)
+	{
+		return;
+	}
+	
+	u32 FileCount = Cache->Files->ListFiles(Cache->Directory, Files, SHADER_CACHE_MAX_FILES);
+	
+	u64 NewestTime = 0;
+	for (u32 FileIndex = 0; FileIndex < FileCount; ++FileIndex)
+	{
+		NewestTime = Max(NewestTime, Files[FileIndex].WriteTime);
+	}
+	
+	// @Note The entries are packed in front, anything else in the directory is left alone
+	char Path[SHADER_CACHE_MAX_PATH];
+	u64 TotalBytes = 0;
+	u32 EntryCount = 0;
+	for (u32 FileIndex = 0; FileIndex < FileCount; ++FileIndex)
+	{
+		platform_file_info *File = &Files[FileIndex];
+		if (IsCacheFile(File->Name, ".bin"))
+		{
+			TotalBytes += File->Size;
+			Files[EntryCount++] = *File;
+		}
+		else if (IsCacheFile(File->Name, ".tmp") && (File->WriteTime + SHADER_CACHE_STALE_TEMP < NewestTime))
+		{
+			BuildShaderCacheFilePath(Cache, File->Name, Path);
+			Cache->Files->DeleteFile(Path);
+		}
+	}
+	
+	// @Note Oldest first, a selection is plenty for a few hundred files that mostly all stay
+	while ((TotalBytes > Cache->MaxBytes) && (EntryCount > 1))
+	{
+		u32 Oldest = 0;
+		for (u32 EntryIndex = 1; EntryIndex < EntryCount; ++EntryIndex)
+		{
+			if (Files[EntryIndex].WriteTime < Files[Oldest].WriteTime)
+			{
+				Oldest = EntryIndex;
+			}
+		}
+		
+		BuildShaderCacheFilePath(Cache, Files[Oldest].Name, Path);
+		Cache->Files->DeleteFile(Path);
+		TotalBytes -= Files[Oldest].Size;
+		Cache->EvictedBytes += Files[Oldest].Size;
+		++Cache->EvictedCount;
+		
+		Files[Oldest] = Files[--EntryCount];
+	}
+	
+	Cache->FreeMemory(Files, ListSize);
+}
+
+//
+// Stores Data under Key, replacing whatever was there in one step. Returns false if it couldn't be written,
+// the cache is only ever a shortcut so that's never worse than a miss next time.
+//
+internal bool StoreShaderCache(shader_cache *Cache, shader_key Key, void *Data, u32 Size)
+{
+	if (Size > SHADER_CACHE_MAX_SIZE)
+	{
+		return false;
+	}
+	
+	size_t EntrySize = sizeof(shader_cache_header) + Size;
+	u8 *Entry = (u8 *)Cache->AllocateMemory(EntrySize);
+	if (!Entry)
+	{
+		return false;
+	}
+	
+	shader_cache_header *Header = (shader_cache_header *)Entry;
+	Header->Magic   = SHADER_CACHE_MAGIC;
+	Header->Version = SHADER_CACHE_VERSION;
+	Header->Key     = Key;
+	Header->Size    = Size;
+	Header->Check   = GetShaderChecksum(Data, Size);
+	CopyBytes(Entry + sizeof(shader_cache_header), Data, Size);
+	
+	char TempPath[SHADER_CACHE_MAX_PATH];
+	char Path[SHADER_CACHE_MAX_PATH];
+	BuildShaderCachePath(Cache, Key, true, TempPath);
+	BuildShaderCachePath(Cache, Key, false, Path);
+	
+	bool Stored = Cache->Files->WriteFile(TempPath, Entry, EntrySize) && Cache->Files->ReplaceFile(TempPath, Path);
+	if (!Stored)
+	{
+		Cache->Files->DeleteFile(TempPath);
+	}
+	
+	Cache->FreeMemory(Entry, EntrySize);
+	
+	if (Stored)
+	{
+		++Cache->StoredCount;
+		EvictShaderCache(Cache);
+	}
+	
+	return Stored;
+}
+
+//
+// Embedded shaders: bytecode compiled by the build and linked into the binary
+//
+// @Note The build runs once with the compiler, which writes every permutation it compiled out as C++ with its key,
+// and is then built again with that. A shader is only taken from it if the key still matches, so a source or a
+// define that changed since falls through to the cache and the compiler instead of drawing with old bytecode.
+//
+
+struct embedded_shader
+{
+	shader_key Key;
+	u8 *Data;
+	u32 Size;
+};
+
+internal shader_blob FindEmbeddedShader(embedded_shader *Shaders, u32 ShaderCount, shader_key Key)
+{
+	for (u32 ShaderIndex = 0; ShaderIndex < ShaderCount; ++ShaderIndex)
+	{
+		if (ShaderKeysAreEqual(Shaders[ShaderIndex].Key, Key))
+		{
+			return shader_blob{ Shaders[ShaderIndex].Data, Shaders[ShaderIndex].Size };
+		}
+	}
+	
+	return shader_blob{ NULL, 0 };
+}
+
+// @Note The header that holds the table, Text should have room for about six bytes per byte of bytecode
+internal void WriteEmbeddedShaders(text_buffer *Text, embedded_shader *Shaders, u32 ShaderCount)
+{
+	AppendText(Text, "//\r\n// Written by a BAKE_SHADERS build, see build.cmd. Don't edit, build again.\r\n//\r\n\r\n");
+	
+	for (u32 ShaderIndex = 0; ShaderIndex < ShaderCount; ++ShaderIndex)
+	{
+		embedded_shader *Shader = &Shaders[ShaderIndex];
+		
+		AppendText(Text, "global u8 EmbeddedShader");
+		AppendNumber(Text, ShaderIndex);
+		AppendText(Text, "[] =\r\n{");
+		for (u32 ByteIndex = 0; ByteIndex < Shader->Size; ++ByteIndex)
+		{
+			AppendText(Text, ((ByteIndex % 16) == 0) ? "\r\n\t" : " ");
+			AppendText(Text, "0x");
+			AppendHex(Text, Shader->Data[ByteIndex], 2);
+			AppendText(Text, ",");
+		}
+		AppendText(Text, "\r\n};\r\n\r\n");
+	}
+	
+	AppendText(Text, "global embedded_shader EmbeddedShaders[] =\r\n{\r\n");
+	for (u32 ShaderIndex = 0; ShaderIndex < ShaderCount; ++ShaderIndex)
+	{
+		embedded_shader *Shader = &Shaders[ShaderIndex];
+		
+		AppendText(Text, "\t{ { 0x");
+		AppendHex(Text, Shader->Key.Low, 16);
+		AppendText(Text, "ull, 0x");
+		AppendHex(Text, Shader->Key.High, 16);
+		AppendText(Text, "ull }, EmbeddedShader");
+		AppendNumber(Text, ShaderIndex);
+		AppendText(Text, ", sizeof(EmbeddedShader");
+		AppendNumber(Text, ShaderIndex);
+		AppendText(Text, ") },\r\n");
+	}
+	AppendText(Text, "};\r\n");
+}
@@ -0,0 +1,393 @@
+//
+// Colour: the sRGB, scRGB and PQ transfer functions, FP16, and the tone map that brings an HDR desktop into the overlay
+//
+// @Note The overlay is an SDR window that DWM blends in gamma space, so the display texture and the back buffer
+// are 8-bit sRGB. The shade decodes to linear light, filters and darkens there, encodes again and premultiplies
+// by the alpha last. HDR desktops are converted on the way into the display texture, see overlay_convert.cpp.
+// There is no CRT, the curves are written out here and the kernels only go through the tables made from them.
+//
+
+// @Note Linear steps of the encode table. Every 8-bit code makes it back to itself and nothing is more than a code off.
+#define SRGB_ENCODE_STEPS 4095
+
+// @Note scRGB 1.0, also SDR white on Windows until the user moves the slider
+#define SCRGB_WHITE_NITS 80.0f
+
+// @Note PQ 1.0
+#define PQ_MAX_NITS 10000.0f
+
+// @Note In SDR white. HDR content up to here comes through as it is, brighter rolls off towards 1.0.
+#define TONE_MAP_KNEE     0.8f
+#define TONE_MAP_SHOULDER (1.0f - TONE_MAP_KNEE)
+#define TONE_MAP_STRETCH  (1.0f / TONE_MAP_SHOULDER)
+
+union float_bits
+{
+	float Float;
+	u32 Bits;
+};
+
+inline float BitsToFloat(u32 Bits)
+{
+	float_bits Value;
+	Value.Bits = Bits;
+	return Value.Float;
+}
+
+inline u32 FloatToBits(float Float)
+{
+	float_bits Value;
+	Value.Float = Float;
+	return Value.Bits;
+}
+
+inline int FloorToInt(float Value)
+{
+	int Result = (int)Value;
+	return ((float)Result > Value) ? Result - 1 : Result;
+}
+
+// @Note Whole part by halving, the rest from the atanh series, good to about 1e-6. Value has to be above 0.
+internal float Log2(float Value)
+{
+	float Result = 0.0f;
+	while (Value >= 2.0f)
+	{
+		Value *= 0.5f;
+		Result += 1.0f;
+	}
+	
+	while (Value < 1.0f)
+	{
+		Value *= 2.0f;
+		Result -= 1.0f;
+	}
+	
+	float T  = (Value - 1.0f) / (Value + 1.0f);
+	float T2 = T * T;
+	float Log = 2.0f * T * (1.0f + T2 * (1.0f / 3.0f + T2 * (1.0f / 5.0f + T2 * (1.0f / 7.0f + T2 / 9.0f))));
+	
+	return Result + Log * 1.44269504f;
+}
+
+// @Note Whole part straight into the exponent, the rest from the series of e^(X ln 2), good to about 1e-7
+internal float Exp2(float Value)
+{
+	if (Value < -126.0f)
+	{
+		return 0.0f;
+	}
+	
+	int Whole = FloorToInt(Min(Value, 127.0f));
+	float X = (Value - (float)Whole) * 0.693147181f;
+	float Fraction = 1.0f + X * (1.0f + X / 2.0f * (1.0f + X / 3.0f * (1.0f + X / 4.0f * (1.0f + X / 5.0f * (1.0f + X / 6.0f * (1.0f + X / 7.0f * (1.0f + X / 8.0f)))))));
+	
+	return Fraction * BitsToFloat((u32)(Whole + 127) << 23);
+}
+
+internal float PowF(float Base, float Exponent)
+{
+	return (Base > 0.0f) ? Exp2(Exponent * Log2(Base)) : 0.0f;
+}
+
+//
+// Transfer functions, the exact curves the tables are made from
+//
+
+internal float SRGBToLinear(float Value)
+{
+	return (Value <= 0.04045f) ? Value / 12.92f : PowF((Value + 0.055f) / 1.055f, 2.4f);
+}
+
+internal float LinearToSRGB(float Value)
+{
+	return (Value <= 0.0031308f) ? Value * 12.92f : 1.055f * PowF(Value, 1.0f / 2.4f) - 0.055f;
+}
+
+// @Note SMPTE ST 2084, the signal to and from nits over PQ_MAX_NITS
+#define PQ_M1 (2610.0f / 16384.0f)
+#define PQ_M2 (2523.0f / 4096.0f * 128.0f)
+#define PQ_C1 (3424.0f / 4096.0f)
+#define PQ_C2 (2413.0f / 4096.0f * 32.0f)
+#define PQ_C3 (2392.0f / 4096.0f * 32.0f)
+
+internal float PQToLinear(float Value)
+{
+	float Power = PowF(Value, 1.0f / PQ_M2);
+	return PowF(Max(Power - PQ_C1, 0.0f) / (PQ_C2 - PQ_C3 * Power), 1.0f / PQ_M1);
+}
+
+internal float LinearToPQ(float Value)
+{
+	float Power = PowF(Value, PQ_M1);
+	return PowF((PQ_C1 + PQ_C2 * Power) / (1.0f + PQ_C3 * Power), PQ_M2);
+}
+
+// @Note Linear light from BT.2020 primaries to BT.709 ones and back, HDR10 to scRGB
+global const float BT2020To709[3][3] =
+{
+	{  1.660491f, -0.587641f, -0.072850f },
+	{ -0.124550f,  1.132900f, -0.008349f },
+	{ -0.018151f, -0.100579f,  1.118730f },
+};
+
+global const float BT709To2020[3][3] =
+{
+	{ 0.627404f, 0.329283f, 0.043313f },
+	{ 0.069097f, 0.919540f, 0.011362f },
+	{ 0.016391f, 0.088013f, 0.895595f },
+};
+
+//
+// FP16
+//
+// @Note Both ways are exact apart from the rounding to nearest even, so any kernel that gets them right
+// gives the same bits. The float math here is the same the SSE2 kernels do without F16C.
+//
+
+inline float HalfToFloat(u16 Half)
+{
+	u32 ExponentMantissa = Half & 0x7FFF;
+	
+	// @Note Shifted into place the exponent is 112 short, a multiply puts it right and normalizes the denormals
+	u32 Bits = FloatToBits(BitsToFloat(ExponentMantissa << 13) * BitsToFloat((254 - 15) << 23));
+	if (ExponentMantissa > 0x7BFF)
+	{
+		Bits |= 255 << 23;
+	}
+	
+	return BitsToFloat(Bits | ((u32)(Half & 0x8000) << 16));
+}
+
+inline u16 FloatToHalf(float Value)
+{
+	u32 Bits = FloatToBits(Value);
+	u32 Sign = Bits & 0x80000000;
+	Bits ^= Sign;
+	
+	u32 Result;
+	if (Bits >= ((127 + 16) << 23))
+	{
+		// Too big, infinity, or NaN
+		Result = (Bits > (255u << 23)) ? 0x7E00 : 0x7C00;
+	}
+	else if (Bits < (113 << 23))
+	{
+		// @Note A denormal half, an add lines the mantissa up and rounds it
+		float DenormalMagic = BitsToFloat(((127 - 15) + (23 - 10) + 1) << 23);
+		Result = FloatToBits(BitsToFloat(Bits) + DenormalMagic) - FloatToBits(DenormalMagic);
+	}
+	else
+	{
+		u32 MantissaIsOdd = (Bits >> 13) & 1;
+		Bits += ((u32)(15 - 127) << 23) + 0xFFF + MantissaIsOdd;
+		Result = Bits >> 13;
+	}
+	
+	return (u16)(Result | (Sign >> 16));
+}
+
+//
+// Tables
+//
+
+struct colour_tables
+{
+	bool IsInitialized;
+	
+	// @Note Every 8-bit sRGB code in linear light
+	float SRGBDecode[256];
+	
+	// @Note Linear light in SRGB_ENCODE_STEPS steps to the nearest 8-bit code, as floats for the kernels
+	float SRGBEncode[SRGB_ENCODE_STEPS + 1];
+	
+	// @Note Every 10-bit PQ code in nits over PQ_MAX_NITS
+	float PQDecode[1024];
+};
+
+global colour_tables ColourTables;
+
+// @Note Call before anything shades or converts, again is fine
+internal void InitializeColourTables()
+{
+	colour_tables *Tables = &ColourTables;
+	if (Tables->IsInitialized)
+	{
+		return;
+	}
+	
+	for (int Code = 0; Code < 256; ++Code)
+	{
+		Tables->SRGBDecode[Code] = SRGBToLinear((float)Code / 255.0f);
+	}
+	
+	for (int Step = 0; Step <= SRGB_ENCODE_STEPS; ++Step)
+	{
+		float Encoded = LinearToSRGB((float)Step / (float)SRGB_ENCODE_STEPS);
+		Tables->SRGBEncode[Step] = (float)(int)(Min(Max(Encoded, 0.0f), 1.0f) * 255.0f + 0.5f);
+	}
+	
+	for (int Code = 0; Code < 1024; ++Code)
+	{
+		Tables->PQDecode[Code] = PQToLinear((float)Code / 1023.0f);
+	}
+	
+	Tables->IsInitialized = true;
+}
+
+// @Note Linear light 0..1 to the 8-bit code, as a float
+inline float EncodeSRGB(float Linear)
+{
+	return ColourTables.SRGBEncode[(int)(Linear * (float)SRGB_ENCODE_STEPS + 0.5f)];
+}
+
+//
+// Conversion to the display texture: HDR into the 8-bit sRGB the overlay draws from
+//
+// @Note Scaled so the output's SDR white lands on 1.0, then the brightest channel rolls off from TONE_MAP_KNEE
+// and every channel is scaled with it so the hue stays put. Up to the knee nothing changes.
+// The scalar rows are the reference for the SIMD ones in overlay_convert.cpp.
+//
+
+struct colour_convert
+{
+	// @Note Linear light times this puts SDR white on 1.0, for BGRA8 to scRGB it goes the other way
+	float Scale;
+};
+
+internal colour_convert GetColourConvert(surface_format Format, float WhiteNits)
+{
+	colour_convert Result;
+	switch (Format)
+	{
+		case SurfaceFormat_RGBA16F: { Result.Scale = SCRGB_WHITE_NITS / WhiteNits; } break;
+		case SurfaceFormat_RGB10A2: { Result.Scale = PQ_MAX_NITS / WhiteNits;      } break;
+		default:                    { Result.Scale = 1.0f;                         } break;
+	}
+	
+	return Result;
+}
+
+// @Note The other way, BGRA8 out to Format at the output's SDR white
+internal colour_convert GetColourExpand(surface_format Format, float WhiteNits)
+{
+	colour_convert Result;
+	switch (Format)
+	{
+		case SurfaceFormat_RGBA16F: { Result.Scale = WhiteNits / SCRGB_WHITE_NITS; } break;
+		case SurfaceFormat_RGB10A2: { Result.Scale = WhiteNits / PQ_MAX_NITS;      } break;
+		default:                    { Result.Scale = 1.0f;                         } break;
+	}
+	
+	return Result;
+}
+
+inline u32 GetSurfaceBytesPerPixel(surface_format Format)
+{
+	return (Format == SurfaceFormat_RGBA16F) ? 8 : 4;
+}
+
+// Pixels Begin to End, Source and Destination are the first pixel of their rows
+#define CONVERT_ROW(Name) void Name(colour_convert *Convert, u8 *Source, u8 *Destination, int Begin, int End)
+typedef CONVERT_ROW(convert_row_function);
+
+inline u32 ToneMapPixel(float Red, float Green, float Blue)
+{
+	// @Note scRGB and the BT.2020 to BT.709 matrix both go negative out of gamut, there is nothing to show for it
+	Red   = Max(Red,   0.0f);
+	Green = Max(Green, 0.0f);
+	Blue  = Max(Blue,  0.0f);
+	
+	float Peak = Max(Max(Red, Green), Blue);
+	if (Peak > TONE_MAP_KNEE)
+	{
+		float Over   = (Peak - TONE_MAP_KNEE) * TONE_MAP_STRETCH;
+		float Mapped = TONE_MAP_KNEE + TONE_MAP_SHOULDER * (Over / (1.0f + Over));
+		float Scale  = Mapped / Peak;
+		
+		Red   *= Scale;
+		Green *= Scale;
+		Blue  *= Scale;
+	}
+	
+	u32 RedCode   = (u32)EncodeSRGB(Min(Red,   1.0f));
+	u32 GreenCode = (u32)EncodeSRGB(Min(Green, 1.0f));
+	u32 BlueCode  = (u32)EncodeSRGB(Min(Blue,  1.0f));
+	
+	return 0xFF000000 | (RedCode << 16) | (GreenCode << 8) | BlueCode;
+}
+
+// @Note DXGI_FORMAT_R16G16B16A16_FLOAT, the alpha is dropped like the desktop's always is
+internal CONVERT_ROW(ConvertScRGBRowScalar)
+{
+	u16 *Halves = (u16 *)Source;
+	u32 *Dest   = (u32 *)Destination;
+	for (int X = Begin; X < End; ++X)
+	{
+		u16 *Pixel = Halves + 4 * X;
+		float Red   = HalfToFloat(Pixel[0]) * Convert->Scale;
+		float Green = HalfToFloat(Pixel[1]) * Convert->Scale;
+		float Blue  = HalfToFloat(Pixel[2]) * Convert->Scale;
+		
+		Dest[X] = ToneMapPixel(Red, Green, Blue);
+	}
+}
+
+// @Note DXGI_FORMAT_R10G10B10A2_UNORM, red in the low bits
+internal CONVERT_ROW(ConvertPQRowScalar)
+{
+	u32 *Packed = (u32 *)Source;
+	u32 *Dest   = (u32 *)Destination;
+	for (int X = Begin; X < End; ++X)
+	{
+		float Red   = ColourTables.PQDecode[Packed[X] & 0x3FF]         * Convert->Scale;
+		float Green = ColourTables.PQDecode[(Packed[X] >> 10) & 0x3FF] * Convert->Scale;
+		float Blue  = ColourTables.PQDecode[(Packed[X] >> 20) & 0x3FF] * Convert->Scale;
+		
+		float Red709   = BT2020To709[0][0] * Red + BT2020To709[0][1] * Green + BT2020To709[0][2] * Blue;
+		float Green709 = BT2020To709[1][0] * Red + BT2020To709[1][1] * Green + BT2020To709[1][2] * Blue;
+		float Blue709  = BT2020To709[2][0] * Red + BT2020To709[2][1] * Green + BT2020To709[2][2] * Blue;
+		
+		Dest[X] = ToneMapPixel(Red709, Green709, Blue709);
+	}
+}
+
+// @Note BGRA8 to DXGI_FORMAT_R16G16B16A16_FLOAT with SDR white where the output has it, the way DWM puts
+// SDR windows on an HDR desktop. Opaque, so it comes back as the same codes up to the knee.
+internal CONVERT_ROW(ExpandSRGBRowScalar)
+{
+	u8  *Texels = Source;
+	u16 *Halves = (u16 *)Destination;
+	for (int X = Begin; X < End; ++X)
+	{
+		u8  *Texel = Texels + 4 * X;
+		u16 *Pixel = Halves + 4 * X;
+		Pixel[0] = FloatToHalf(ColourTables.SRGBDecode[Texel[2]] * Convert->Scale);
+		Pixel[1] = FloatToHalf(ColourTables.SRGBDecode[Texel[1]] * Convert->Scale);
+		Pixel[2] = FloatToHalf(ColourTables.SRGBDecode[Texel[0]] * Convert->Scale);
+		Pixel[3] = 0x3C00;
+	}
+}
+
+// @Note BGRA8 to HDR10 at the output's SDR white, only the synthetic source needs it so there is just this one
+internal CONVERT_ROW(EncodePQRowScalar)
+{
+	u8  *Texels = Source;
+	u32 *Packed = (u32 *)Destination;
+	for (int X = Begin; X < End; ++X)
+	{
+		u8 *Texel = Texels + 4 * X;
+		float Red   = ColourTables.SRGBDecode[Texel[2]] * Convert->Scale;
+		float Green = ColourTables.SRGBDecode[Texel[1]] * Convert->Scale;
+		float Blue  = ColourTables.SRGBDecode[Texel[0]] * Convert->Scale;
+		
+		u32 Codes[3];
+		for (int Channel = 0; Channel < 3; ++Channel)
+		{
+			float Value = BT709To2020[Channel][0] * Red + BT709To2020[Channel][1] * Green + BT709To2020[Channel][2] * Blue;
+			Codes[Channel] = (u32)(LinearToPQ(Min(Max(Value, 0.0f), 1.0f)) * 1023.0f + 0.5f);
+		}
+		
+		Packed[X] = (3u << 30) | (Codes[2] << 20) | (Codes[1] << 10) | Codes[0];
+	}
+}
@@ -0,0 +1,465 @@
+//
+// Convert kernels: HDR desktop rows into the display texture's 8-bit sRGB, and SDR rows out to FP16
+//
+// @Note The scalar rows in overlay_colour.cpp are the reference. Every other row does the same float math in the
+// same order, and the FP16 conversions are exact, so on x86 they match it bit for bit. ARM can be one off from
+// it where the compiler fused a multiply-add in the scalar row, same as the shade kernels.
+//
+
+//
+// SSE2, four pixels at a time. FP16 by hand without F16C, the table lookups are scalar.
+//
+
+#if defined(SHADE_X86)
+
+// @Note HalfToFloat for the low 16 bits of every lane
+inline __m128 HalfToFloatSSE2(__m128i Halves)
+{
+	__m128i ExponentMantissa = _mm_and_si128(Halves, _mm_set1_epi32(0x7FFF));
+	__m128 Scaled = _mm_mul_ps(_mm_castsi128_ps(_mm_slli_epi32(ExponentMantissa, 13)), _mm_castsi128_ps(_mm_set1_epi32((254 - 15) << 23)));
+	
+	__m128i WasInfNaN = _mm_cmpgt_epi32(ExponentMantissa, _mm_set1_epi32(0x7BFF));
+	__m128i InfNaN    = _mm_and_si128(WasInfNaN, _mm_set1_epi32(255 << 23));
+	__m128i Sign      = _mm_slli_epi32(_mm_xor_si128(Halves, ExponentMantissa), 16);
+	
+	return _mm_or_ps(Scaled, _mm_castsi128_ps(_mm_or_si128(Sign, InfNaN)));
+}
+
+// @Note FloatToHalf into the low 16 bits of every lane, both ways worked out and the right one picked
+inline __m128i FloatToHalfSSE2(__m128 Value)
+{
+	__m128i Bits = _mm_castps_si128(Value);
+	__m128i Sign = _mm_and_si128(Bits, _mm_set1_epi32((int)0x80000000));
+	Bits = _mm_xor_si128(Bits, Sign);
+	
+	__m128i MantissaIsOdd = _mm_and_si128(_mm_srli_epi32(Bits, 13), _mm_set1_epi32(1));
+	__m128i Rebiased = _mm_add_epi32(Bits, _mm_set1_epi32((int)(((u32)(15 - 127) << 23) + 0xFFF)));
+	__m128i Normal   = _mm_srli_epi32(_mm_add_epi32(Rebiased, MantissaIsOdd), 13);
+	
+	__m128 DenormalMagic = _mm_castsi128_ps(_mm_set1_epi32(((127 - 15) + (23 - 10) + 1) << 23));
+	__m128i Denormal   = _mm_sub_epi32(_mm_castps_si128(_mm_add_ps(_mm_castsi128_ps(Bits), DenormalMagic)), _mm_castps_si128(DenormalMagic));
+	__m128i IsDenormal = _mm_cmplt_epi32(Bits, _mm_set1_epi32(113 << 23));
+	__m128i Result     = _mm_or_si128(_mm_and_si128(IsDenormal, Denormal), _mm_andnot_si128(IsDenormal, Normal));
+	
+	__m128i IsTooBig = _mm_cmpgt_epi32(Bits, _mm_set1_epi32(((127 + 16) << 23) - 1));
+	__m128i IsNaN    = _mm_cmpgt_epi32(Bits, _mm_set1_epi32(255 << 23));
+	__m128i TooBig   = _mm_or_si128(_mm_set1_epi32(0x7C00), _mm_and_si128(IsNaN, _mm_set1_epi32(0x0200)));
+	Result = _mm_or_si128(_mm_and_si128(IsTooBig, TooBig), _mm_andnot_si128(IsTooBig, Result));
+	
+	return _mm_or_si128(Result, _mm_srli_epi32(Sign, 16));
+}
+
+// @Note ToneMapPixel four at a time
+inline __m128i ToneMapSSE2(__m128 Red, __m128 Green, __m128 Blue)
+{
+	__m128 Zero = _mm_setzero_ps();
+	__m128 One  = _mm_set1_ps(1.0f);
+	__m128 Knee = _mm_set1_ps(TONE_MAP_KNEE);
+	
+	Red   = _mm_max_ps(Red,   Zero);
+	Green = _mm_max_ps(Green, Zero);
+	Blue  = _mm_max_ps(Blue,  Zero);
+	
+	// @Note Worked out for every lane, the ones under the knee scale by exactly 1
+	__m128 Peak   = _mm_max_ps(_mm_max_ps(Red, Green), Blue);
+	__m128 Over   = _mm_mul_ps(_mm_sub_ps(Peak, Knee), _mm_set1_ps(TONE_MAP_STRETCH));
+	__m128 Mapped = _mm_add_ps(Knee, _mm_mul_ps(_mm_set1_ps(TONE_MAP_SHOULDER), _mm_div_ps(Over, _mm_add_ps(One, Over))));
+	__m128 IsOver = _mm_cmpgt_ps(Peak, Knee);
+	__m128 Scale  = _mm_or_ps(_mm_and_ps(IsOver, _mm_div_ps(Mapped, Peak)), _mm_andnot_ps(IsOver, One));
+	
+	__m128i RedCode   = _mm_cvttps_epi32(EncodeSRGBSSE2(_mm_min_ps(_mm_mul_ps(Red,   Scale), One)));
+	__m128i GreenCode = _mm_cvttps_epi32(EncodeSRGBSSE2(_mm_min_ps(_mm_mul_ps(Green, Scale), One)));
+	__m128i BlueCode  = _mm_cvttps_epi32(EncodeSRGBSSE2(_mm_min_ps(_mm_mul_ps(Blue,  Scale), One)));
+	
+	__m128i Result = _mm_or_si128(_mm_set1_epi32((int)0xFF000000), _mm_slli_epi32(RedCode, 16));
+	return _mm_or_si128(Result, _mm_or_si128(_mm_slli_epi32(GreenCode, 8), BlueCode));
+}
+
+internal CONVERT_ROW(ConvertScRGBRowSSE2)
+{
+	__m128i Zero  = _mm_setzero_si128();
+	__m128  Scale = _mm_set1_ps(Convert->Scale);
+	
+	int X = Begin;
+	for (; X + 4 <= End; X += 4)
+	{
+		__m128i Pixels01 = _mm_loadu_si128((__m128i *)(Source + 8 * X));
+		__m128i Pixels23 = _mm_loadu_si128((__m128i *)(Source + 8 * X + 16));
+		
+		// @Note R0 R2 G0 G2 B0 B2 A0 A2 and R1 R3 ... first, then R0 R1 R2 R3 G0 G1 G2 G3 and the same for blue and alpha
+		__m128i Even = _mm_unpacklo_epi16(Pixels01, Pixels23);
+		__m128i Odd  = _mm_unpackhi_epi16(Pixels01, Pixels23);
+		__m128i RedGreen  = _mm_unpacklo_epi16(Even, Odd);
+		__m128i BlueAlpha = _mm_unpackhi_epi16(Even, Odd);
+		
+		__m128 Red   = _mm_mul_ps(HalfToFloatSSE2(_mm_unpacklo_epi16(RedGreen,  Zero)), Scale);
+		__m128 Green = _mm_mul_ps(HalfToFloatSSE2(_mm_unpackhi_epi16(RedGreen,  Zero)), Scale);
+		__m128 Blue  = _mm_mul_ps(HalfToFloatSSE2(_mm_unpacklo_epi16(BlueAlpha, Zero)), Scale);
+		
+		_mm_storeu_si128((__m128i *)(Destination + 4 * X), ToneMapSSE2(Red, Green, Blue));
+	}
+	
+	ConvertScRGBRowScalar(Convert, Source, Destination, X, End);
+}
+
+inline __m128 DecodePQSSE2(u32 *Packed, int Shift, __m128 Scale)
+{
+	float *Decode = ColourTables.PQDecode;
+	__m128 Linear = _mm_setr_ps(Decode[(Packed[0] >> Shift) & 0x3FF], Decode[(Packed[1] >> Shift) & 0x3FF],
+								Decode[(Packed[2] >> Shift) & 0x3FF], Decode[(Packed[3] >> Shift) & 0x3FF]);
+	return _mm_mul_ps(Linear, Scale);
+}
+
+// @Note One row of BT2020To709, in the scalar row's order
+inline __m128 MixSSE2(const float *Row, __m128 Red, __m128 Green, __m128 Blue)
+{
+	__m128 Result = _mm_add_ps(_mm_mul_ps(_mm_set1_ps(Row[0]), Red), _mm_mul_ps(_mm_set1_ps(Row[1]), Green));
+	return _mm_add_ps(Result, _mm_mul_ps(_mm_set1_ps(Row[2]), Blue));
+}
+
+internal CONVERT_ROW(ConvertPQRowSSE2)
+{
+	__m128 Scale = _mm_set1_ps(Convert->Scale);
+	
+	int X = Begin;
+	for (; X + 4 <= End; X += 4)
+	{
+		u32 *Packed = (u32 *)Source + X;
+		__m128 Red   = DecodePQSSE2(Packed, 0,  Scale);
+		__m128 Green = DecodePQSSE2(Packed, 10, Scale);
+		__m128 Blue  = DecodePQSSE2(Packed, 20, Scale);
+		
+		__m128 Red709   = MixSSE2(BT2020To709[0], Red, Green, Blue);
+		__m128 Green709 = MixSSE2(BT2020To709[1], Red, Green, Blue);
+		__m128 Blue709  = MixSSE2(BT2020To709[2], Red, Green, Blue);
+		
+		_mm_storeu_si128((__m128i *)(Destination + 4 * X), ToneMapSSE2(Red709, Green709, Blue709));
+	}
+	
+	ConvertPQRowScalar(Convert, Source, Destination, X, End);
+}
+
+// @Note The halves are in the low 16 bits of the lanes, the shifts sign extend them so the saturating pack keeps every bit
+inline __m128i PackHalvesSSE2(__m128i A, __m128i B)
+{
+	return _mm_packs_epi32(_mm_srai_epi32(_mm_slli_epi32(A, 16), 16), _mm_srai_epi32(_mm_slli_epi32(B, 16), 16));
+}
+
+internal CONVERT_ROW(ExpandSRGBRowSSE2)
+{
+	__m128 Scale = _mm_set1_ps(Convert->Scale);
+	__m128i Alpha = _mm_set1_epi32(0x3C00);
+	
+	int X = Begin;
+	for (; X + 4 <= End; X += 4)
+	{
+		u32 *Texels = (u32 *)Source + X;
+		__m128i Red   = FloatToHalfSSE2(_mm_mul_ps(DecodeChannelSSE2(Texels, 2), Scale));
+		__m128i Green = FloatToHalfSSE2(_mm_mul_ps(DecodeChannelSSE2(Texels, 1), Scale));
+		__m128i Blue  = FloatToHalfSSE2(_mm_mul_ps(DecodeChannelSSE2(Texels, 0), Scale));
+		
+		// @Note R0..R3 G0..G3 and B0..B3 A0..A3, then R0 B0 R1 B1 ... and G0 A0 G1 A1 ..., then pixels
+		__m128i RedGreen  = PackHalvesSSE2(Red, Green);
+		__m128i BlueAlpha = PackHalvesSSE2(Blue, Alpha);
+		__m128i RedBlue    = _mm_unpacklo_epi16(RedGreen, BlueAlpha);
+		__m128i GreenAlpha = _mm_unpackhi_epi16(RedGreen, BlueAlpha);
+		
+		_mm_storeu_si128((__m128i *)(Destination + 8 * X),      _mm_unpacklo_epi16(RedBlue, GreenAlpha));
+		_mm_storeu_si128((__m128i *)(Destination + 8 * X + 16), _mm_unpackhi_epi16(RedBlue, GreenAlpha));
+	}
+	
+	ExpandSRGBRowScalar(Convert, Source, Destination, X, End);
+}
+
+//
+// AVX2 with F16C, eight pixels at a time, the table lookups are gathers
+//
+
+#if defined(_MSC_VER)
+#define TARGET_AVX2_F16C
+#else
+#define TARGET_AVX2_F16C __attribute__((target("avx2,f16c")))
+#endif
+
+// @Note ToneMapPixel eight at a time
+TARGET_AVX2_F16C inline __m256i ToneMapAVX2(__m256 Red, __m256 Green, __m256 Blue)
+{
+	__m256 Zero = _mm256_setzero_ps();
+	__m256 One  = _mm256_set1_ps(1.0f);
+	__m256 Knee = _mm256_set1_ps(TONE_MAP_KNEE);
+	
+	Red   = _mm256_max_ps(Red,   Zero);
+	Green = _mm256_max_ps(Green, Zero);
+	Blue  = _mm256_max_ps(Blue,  Zero);
+	
+	__m256 Peak   = _mm256_max_ps(_mm256_max_ps(Red, Green), Blue);
+	__m256 Over   = _mm256_mul_ps(_mm256_sub_ps(Peak, Knee), _mm256_set1_ps(TONE_MAP_STRETCH));
+	__m256 Mapped = _mm256_add_ps(Knee, _mm256_mul_ps(_mm256_set1_ps(TONE_MAP_SHOULDER), _mm256_div_ps(Over, _mm256_add_ps(One, Over))));
+	__m256 IsOver = _mm256_cmp_ps(Peak, Knee, _CMP_GT_OQ);
+	__m256 Scale  = _mm256_blendv_ps(One, _mm256_div_ps(Mapped, Peak), IsOver);
+	
+	__m256i RedCode   = _mm256_cvttps_epi32(EncodeSRGBAVX2(_mm256_min_ps(_mm256_mul_ps(Red,   Scale), One)));
+	__m256i GreenCode = _mm256_cvttps_epi32(EncodeSRGBAVX2(_mm256_min_ps(_mm256_mul_ps(Green, Scale), One)));
+	__m256i BlueCode  = _mm256_cvttps_epi32(EncodeSRGBAVX2(_mm256_min_ps(_mm256_mul_ps(Blue,  Scale), One)));
+	
+	__m256i Result = _mm256_or_si256(_mm256_set1_epi32((int)0xFF000000), _mm256_slli_epi32(RedCode, 16));
+	return _mm256_or_si256(Result, _mm256_or_si256(_mm256_slli_epi32(GreenCode, 8), BlueCode));
+}
+
+TARGET_AVX2_F16C internal CONVERT_ROW(ConvertScRGBRowAVX2)
+{
+	__m256 Scale = _mm256_set1_ps(Convert->Scale);
+	
+	int X = Begin;
+	for (; X + 8 <= End; X += 8)
+	{
+		__m128i *Pixels = (__m128i *)(Source + 8 * X);
+		__m128i Pixels01 = _mm_loadu_si128(Pixels + 0);
+		__m128i Pixels23 = _mm_loadu_si128(Pixels + 1);
+		__m128i Pixels45 = _mm_loadu_si128(Pixels + 2);
+		__m128i Pixels67 = _mm_loadu_si128(Pixels + 3);
+		
+		// @Note Same shuffle as the SSE2 row for each half, then the halves side by side
+		__m128i Even0 = _mm_unpacklo_epi16(Pixels01, Pixels23);
+		__m128i Odd0  = _mm_unpackhi_epi16(Pixels01, Pixels23);
+		__m128i Even1 = _mm_unpacklo_epi16(Pixels45, Pixels67);
+		__m128i Odd1  = _mm_unpackhi_epi16(Pixels45, Pixels67);
+		__m128i RedGreen0  = _mm_unpacklo_epi16(Even0, Odd0);
+		__m128i BlueAlpha0 = _mm_unpackhi_epi16(Even0, Odd0);
+		__m128i RedGreen1  = _mm_unpacklo_epi16(Even1, Odd1);
+		__m128i BlueAlpha1 = _mm_unpackhi_epi16(Even1, Odd1);
+		
+		__m256 Red   = _mm256_mul_ps(_mm256_cvtph_ps(_mm_unpacklo_epi64(RedGreen0,  RedGreen1)),  Scale);
+		__m256 Green = _mm256_mul_ps(_mm256_cvtph_ps(_mm_unpackhi_epi64(RedGreen0,  RedGreen1)),  Scale);
+		__m256 Blue  = _mm256_mul_ps(_mm256_cvtph_ps(_mm_unpacklo_epi64(BlueAlpha0, BlueAlpha1)), Scale);
+		
+		_mm256_storeu_si256((__m256i *)(Destination + 4 * X), ToneMapAVX2(Red, Green, Blue));
+	}
+	
+	ConvertScRGBRowScalar(Convert, Source, Destination, X, End);
+}
+
+TARGET_AVX2_F16C inline __m256 DecodePQAVX2(__m256i Packed, int Shift, __m256 Scale)
+{
+	__m256i Codes = _mm256_and_si256(_mm256_srl_epi32(Packed, _mm_cvtsi32_si128(Shift)), _mm256_set1_epi32(0x3FF));
+	return _mm256_mul_ps(_mm256_i32gather_ps(ColourTables.PQDecode, Codes, 4), Scale);
+}
+
+TARGET_AVX2_F16C inline __m256 MixAVX2(const float *Row, __m256 Red, __m256 Green, __m256 Blue)
+{
+	__m256 Result = _mm256_add_ps(_mm256_mul_ps(_mm256_set1_ps(Row[0]), Red), _mm256_mul_ps(_mm256_set1_ps(Row[1]), Green));
+	return _mm256_add_ps(Result, _mm256_mul_ps(_mm256_set1_ps(Row[2]), Blue));
+}
+
+TARGET_AVX2_F16C internal CONVERT_ROW(ConvertPQRowAVX2)
+{
+	__m256 Scale = _mm256_set1_ps(Convert->Scale);
+	
+	int X = Begin;
+	for (; X + 8 <= End; X += 8)
+	{
+		__m256i Packed = _mm256_loadu_si256((__m256i *)(Source + 4 * X));
+		__m256 Red   = DecodePQAVX2(Packed, 0,  Scale);
+		__m256 Green = DecodePQAVX2(Packed, 10, Scale);
+		__m256 Blue  = DecodePQAVX2(Packed, 20, Scale);
+		
+		__m256 Red709   = MixAVX2(BT2020To709[0], Red, Green, Blue);
+		__m256 Green709 = MixAVX2(BT2020To709[1], Red, Green, Blue);
+		__m256 Blue709  = MixAVX2(BT2020To709[2], Red, Green, Blue);
+		
+		_mm256_storeu_si256((__m256i *)(Destination + 4 * X), ToneMapAVX2(Red709, Green709, Blue709));
+	}
+	
+	ConvertPQRowScalar(Convert, Source, Destination, X, End);
+}
+
+TARGET_AVX2_F16C internal CONVERT_ROW(ExpandSRGBRowAVX2)
+{
+	__m256 Scale = _mm256_set1_ps(Convert->Scale);
+	__m128i Alpha = _mm_set1_epi16(0x3C00);
+	
+	int X = Begin;
+	for (; X + 8 <= End; X += 8)
+	{
+		__m256i Texels = _mm256_loadu_si256((__m256i *)(Source + 4 * X));
+		__m128i Red   = _mm256_cvtps_ph(_mm256_mul_ps(DecodeChannelAVX2(Texels, 2), Scale), _MM_FROUND_TO_NEAREST_INT);
+		__m128i Green = _mm256_cvtps_ph(_mm256_mul_ps(DecodeChannelAVX2(Texels, 1), Scale), _MM_FROUND_TO_NEAREST_INT);
+		__m128i Blue  = _mm256_cvtps_ph(_mm256_mul_ps(DecodeChannelAVX2(Texels, 0), Scale), _MM_FROUND_TO_NEAREST_INT);
+		
+		__m128i RedBlue0    = _mm_unpacklo_epi16(Red, Blue);
+		__m128i RedBlue1    = _mm_unpackhi_epi16(Red, Blue);
+		__m128i GreenAlpha0 = _mm_unpacklo_epi16(Green, Alpha);
+		__m128i GreenAlpha1 = _mm_unpackhi_epi16(Green, Alpha);
+		
+		__m128i *Pixels = (__m128i *)(Destination + 8 * X);
+		_mm_storeu_si128(Pixels + 0, _mm_unpacklo_epi16(RedBlue0, GreenAlpha0));
+		_mm_storeu_si128(Pixels + 1, _mm_unpackhi_epi16(RedBlue0, GreenAlpha0));
+		_mm_storeu_si128(Pixels + 2, _mm_unpacklo_epi16(RedBlue1, GreenAlpha1));
+		_mm_storeu_si128(Pixels + 3, _mm_unpackhi_epi16(RedBlue1, GreenAlpha1));
+	}
+	
+	ExpandSRGBRowScalar(Convert, Source, Destination, X, End);
+}
+
+internal bool CPUHasF16C()
+{
+#if defined(_MSC_VER)
+	int Info[4];
+	__cpuid(Info, 1);
+	return (Info[2] & (1 << 29)) != 0;
+#else
+	return __builtin_cpu_supports("f16c");
+#endif
+}
+
+#endif
+
+//
+// NEON, four pixels at a time. FP16 is built in, the table lookups are scalar.
+//
+
+#if defined(SHADE_NEON)
+
+inline uint32x4_t ToneMapNEON(float32x4_t Red, float32x4_t Green, float32x4_t Blue)
+{
+	float32x4_t Zero = vdupq_n_f32(0.0f);
+	float32x4_t One  = vdupq_n_f32(1.0f);
+	float32x4_t Knee = vdupq_n_f32(TONE_MAP_KNEE);
+	
+	Red   = vmaxq_f32(Red,   Zero);
+	Green = vmaxq_f32(Green, Zero);
+	Blue  = vmaxq_f32(Blue,  Zero);
+	
+	float32x4_t Peak   = vmaxq_f32(vmaxq_f32(Red, Green), Blue);
+	float32x4_t Over   = vmulq_f32(vsubq_f32(Peak, Knee), vdupq_n_f32(TONE_MAP_STRETCH));
+	float32x4_t Mapped = vaddq_f32(Knee, vmulq_f32(vdupq_n_f32(TONE_MAP_SHOULDER), vdivq_f32(Over, vaddq_f32(One, Over))));
+	float32x4_t Scale  = vbslq_f32(vcgtq_f32(Peak, Knee), vdivq_f32(Mapped, Peak), One);
+	
+	uint32x4_t RedCode   = vcvtq_u32_f32(EncodeSRGBNEON(vminq_f32(vmulq_f32(Red,   Scale), One)));
+	uint32x4_t GreenCode = vcvtq_u32_f32(EncodeSRGBNEON(vminq_f32(vmulq_f32(Green, Scale), One)));
+	uint32x4_t BlueCode  = vcvtq_u32_f32(EncodeSRGBNEON(vminq_f32(vmulq_f32(Blue,  Scale), One)));
+	
+	uint32x4_t Result = vorrq_u32(vdupq_n_u32(0xFF000000), vshlq_n_u32(RedCode, 16));
+	return vorrq_u32(Result, vorrq_u32(vshlq_n_u32(GreenCode, 8), BlueCode));
+}
+
+internal CONVERT_ROW(ConvertScRGBRowNEON)
+{
+	float32x4_t Scale = vdupq_n_f32(Convert->Scale);
+	
+	int X = Begin;
+	for (; X + 4 <= End; X += 4)
+	{
+		uint16x4x4_t Pixels = vld4_u16((u16 *)Source + 4 * X);
+		float32x4_t Red   = vmulq_f32(vcvt_f32_f16(vreinterpret_f16_u16(Pixels.val[0])), Scale);
+		float32x4_t Green = vmulq_f32(vcvt_f32_f16(vreinterpret_f16_u16(Pixels.val[1])), Scale);
+		float32x4_t Blue  = vmulq_f32(vcvt_f32_f16(vreinterpret_f16_u16(Pixels.val[2])), Scale);
+		
+		vst1q_u32((u32 *)Destination + X, ToneMapNEON(Red, Green, Blue));
+	}
+	
+	ConvertScRGBRowScalar(Convert, Source, Destination, X, End);
+}
+
+inline float32x4_t DecodePQNEON(u32 *Packed, int Shift, float32x4_t Scale)
+{
+	float *Decode = ColourTables.PQDecode;
+	float Lanes[4] = { Decode[(Packed[0] >> Shift) & 0x3FF], Decode[(Packed[1] >> Shift) & 0x3FF],
+					   Decode[(Packed[2] >> Shift) & 0x3FF], Decode[(Packed[3] >> Shift) & 0x3FF] };
+	return vmulq_f32(vld1q_f32(Lanes), Scale);
+}
+
+inline float32x4_t MixNEON(const float *Row, float32x4_t Red, float32x4_t Green, float32x4_t Blue)
+{
+	float32x4_t Result = vaddq_f32(vmulq_n_f32(Red, Row[0]), vmulq_n_f32(Green, Row[1]));
+	return vaddq_f32(Result, vmulq_n_f32(Blue, Row[2]));
+}
+
+internal CONVERT_ROW(ConvertPQRowNEON)
+{
+	float32x4_t Scale = vdupq_n_f32(Convert->Scale);
+	
+	int X = Begin;
+	for (; X + 4 <= End; X += 4)
+	{
+		u32 *Packed = (u32 *)Source + X;
+		float32x4_t Red   = DecodePQNEON(Packed, 0,  Scale);
+		float32x4_t Green = DecodePQNEON(Packed, 10, Scale);
+		float32x4_t Blue  = DecodePQNEON(Packed, 20, Scale);
+		
+		float32x4_t Red709   = MixNEON(BT2020To709[0], Red, Green, Blue);
+		float32x4_t Green709 = MixNEON(BT2020To709[1], Red, Green, Blue);
+		float32x4_t Blue709  = MixNEON(BT2020To709[2], Red, Green, Blue);
+		
+		vst1q_u32((u32 *)Destination + X, ToneMapNEON(Red709, Green709, Blue709));
+	}
+	
+	ConvertPQRowScalar(Convert, Source, Destination, X, End);
+}
+
+internal CONVERT_ROW(ExpandSRGBRowNEON)
+{
+	float32x4_t Scale = vdupq_n_f32(Convert->Scale);
+	
+	int X = Begin;
+	for (; X + 4 <= End; X += 4)
+	{
+		u32 *Texels = (u32 *)Source + X;
+		
+		uint16x4x4_t Pixels;
+		Pixels.val[0] = vreinterpret_u16_f16(vcvt_f16_f32(vmulq_f32(DecodeChannelNEON(Texels, 2), Scale)));
+		Pixels.val[1] = vreinterpret_u16_f16(vcvt_f16_f32(vmulq_f32(DecodeChannelNEON(Texels, 1), Scale)));
+		Pixels.val[2] = vreinterpret_u16_f16(vcvt_f16_f32(vmulq_f32(DecodeChannelNEON(Texels, 0), Scale)));
+		Pixels.val[3] = vdup_n_u16(0x3C00);
+		
+		vst4_u16((u16 *)Destination + 4 * X, Pixels);
+	}
+	
+	ExpandSRGBRowScalar(Convert, Source, Destination, X, End);
+}
+
+#endif
+
+//
+// Dispatch, by the same kernels as the shade
+//
+
+// Returns NULL for BGRA8, which is a straight copy, and if this build or this CPU doesn't have the kernel
+internal convert_row_function *GetConvertRow(surface_format Format, shade_kernel Kernel)
+{
+	bool IsScRGB = (Format == SurfaceFormat_RGBA16F);
+	if ((Format != SurfaceFormat_RGBA16F) && (Format != SurfaceFormat_RGB10A2))
+	{
+		return NULL;
+	}
+	
+	switch (Kernel)
+	{
+		case ShadeKernel_Scalar: return IsScRGB ? ConvertScRGBRowScalar : ConvertPQRowScalar;
+#if defined(SHADE_X86)
+		case ShadeKernel_SSE2: return IsScRGB ? ConvertScRGBRowSSE2 : ConvertPQRowSSE2;
+		case ShadeKernel_AVX2: return (CPUHasAVX2() && CPUHasF16C()) ? (IsScRGB ? ConvertScRGBRowAVX2 : ConvertPQRowAVX2) : NULL;
+#endif
+#if defined(SHADE_NEON)
+		case ShadeKernel_NEON: return IsScRGB ? ConvertScRGBRowNEON : ConvertPQRowNEON;
+#endif
+		default: return NULL;
+	}
+}
+
+// @Note BGRA8 out to scRGB, NULL if this build or this CPU doesn't have the kernel
+internal convert_row_function *GetExpandRow(shade_kernel Kernel)
+{
+	switch (Kernel)
+	{
+		case ShadeKernel_Scalar: return ExpandSRGBRowScalar;
+#if defined(SHADE_X86)
+		case ShadeKernel_SSE2: return ExpandSRGBRowSSE2;
+		case ShadeKernel_AVX2: return (CPUHasAVX2() && CPUHasF16C()) ? ExpandSRGBRowAVX2 : NULL;
+#endif
+#if defined(SHADE_NEON)
+		case ShadeKernel_NEON: return ExpandSRGBRowNEON;
+#endif
+		default: return NULL;
+	}
+}
@@ -0,0 +1,137 @@
+//
+// What changed inside the cut box, from the frame's move and dirty rectangles
+//
+
+#define MAX_CROP_REGIONS 16
+
+struct crop_damage
+{
+	u32 RegionCount;
+	box Regions[MAX_CROP_REGIONS];
+};
+
+inline bool BoxesAreEqual(box A, box B)
+{
+	return (A.Left == B.Left) && (A.Top == B.Top) && (A.Right == B.Right) && (A.Bottom == B.Bottom);
+}
+
+inline bool BoxIsEmpty(box Box)
+{
+	return (Box.Right <= Box.Left) || (Box.Bottom <= Box.Top);
+}
+
+inline box IntersectBoxes(box A, box B)
+{
+	box Result;
+	Result.Left   = Max(A.Left,   B.Left);
+	Result.Top    = Max(A.Top,    B.Top);
+	Result.Right  = Min(A.Right,  B.Right);
+	Result.Bottom = Min(A.Bottom, B.Bottom);
+	
+	return Result;
+}
+
+inline box UnionBoxes(box A, box B)
+{
+	box Result;
+	Result.Left   = Min(A.Left,   B.Left);
+	Result.Top    = Min(A.Top,    B.Top);
+	Result.Right  = Max(A.Right,  B.Right);
+	Result.Bottom = Max(A.Bottom, B.Bottom);
+	
+	return Result;
+}
+
+inline bool BoxContains(box Outer, box Inner)
+{
+	return (Inner.Left >= Outer.Left) && (Inner.Top >= Outer.Top) && (Inner.Right <= Outer.Right) && (Inner.Bottom <= Outer.Bottom);
+}
+
+internal void AddDamage(crop_damage *Damage, box CutBox, box Region)
+{
+	Region = IntersectBoxes(Region, CutBox);
+	if (BoxIsEmpty(Region))
+	{
+		return;
+	}
+	
+	for (u32 RegionIndex = 0; RegionIndex < Damage->RegionCount; ++RegionIndex)
+	{
+		if (BoxContains(Damage->Regions[RegionIndex], Region))
+		{
+			return;
+		}
+	}
+	
+	// @Note Every region the new one covers goes, not only the first, or they would all be copied again
+	u32 KeptCount = 0;
+	for (u32 RegionIndex = 0; RegionIndex < Damage->RegionCount; ++RegionIndex)
+	{
+		box Existing = Damage->Regions[RegionIndex];
+		if (!BoxContains(Region, Existing))
+		{
+			Damage->Regions[KeptCount++] = Existing;
+		}
+	}
+	Damage->RegionCount = KeptCount;
+	
+	if (Damage->RegionCount < MAX_CROP_REGIONS)
+	{
+		Damage->Regions[Damage->RegionCount++] = Region;
+	}
+	else
+	{
+		// @Note Too many small copies cost more than one big one, collapse everything into the bounds
+		box Bounds = Region;
+		for (u32 RegionIndex = 0; RegionIndex < Damage->RegionCount; ++RegionIndex)
+		{
+			Bounds = UnionBoxes(Bounds, Damage->Regions[RegionIndex]);
+		}
+		
+		Damage->Regions[0]  = Bounds;
+		Damage->RegionCount = 1;
+	}
+}
+
+//
+// Fills Damage with the parts of CutBox that changed in this frame, none if nothing did
+//
+internal void ComputeCropDamage(captured_frame *Frame, box CutBox, crop_damage *Damage)
+{
+	Damage->RegionCount = 0;
+	
+	if (Frame->LastPresentTime == 0)
+	{
+		// Only the mouse moved, the desktop image did not change
+		return;
+	}
+	
+	if (!Frame->MetadataIsValid)
+	{
+		AddDamage(Damage, CutBox, CutBox);
+		return;
+	}
+	
+	// @Note A move only changes its destination, whatever got uncovered at the source comes as a dirty rect
+	for (u32 MoveIndex = 0; MoveIndex < Frame->MoveRectCount; ++MoveIndex)
+	{
+		AddDamage(Damage, CutBox, Frame->MoveRects[MoveIndex].Destination);
+	}
+	
+	for (u32 DirtyIndex = 0; DirtyIndex < Frame->DirtyRectCount; ++DirtyIndex)
+	{
+		AddDamage(Damage, CutBox, Frame->DirtyRects[DirtyIndex]);
+	}
+}
+
+internal u64 GetDamageArea(crop_damage *Damage)
+{
+	u64 Area = 0;
+	for (u32 RegionIndex = 0; RegionIndex < Damage->RegionCount; ++RegionIndex)
+	{
+		box Region = Damage->Regions[RegionIndex];
+		Area += (u64)GetBoxWidth(Region) * GetBoxHeight(Region);
+	}
+	
+	return Area;
+}
@@ -0,0 +1,177 @@
+//
+// Device resource registry
+//
+// @Note Everything a backend makes from its GPU device is registered with how to make it and what it is made from,
+// so when the device is lost the whole lot can be made again on a new one. A resource can only depend on resources
+// registered before it, so registry order is a build order and its reverse a release order.
+//
+
+#define MAX_DEVICE_RESOURCES 32
+
+struct device_resource;
+
+// Make the resource from its recipe, out of whatever the resources it depends on are now. Returns false if it can't
+// be made, because the device went away again for one, and the rebuild stops there.
+#define DEVICE_RESOURCE_CREATE(Name) bool Name(void *Context, device_resource *Resource)
+typedef DEVICE_RESOURCE_CREATE(device_resource_create);
+
+// Let go of the resource. Only ever called on one that was made, and before anything made from it goes.
+#define DEVICE_RESOURCE_RELEASE(Name) void Name(void *Context, device_resource *Resource)
+typedef DEVICE_RESOURCE_RELEASE(device_resource_release);
+
+struct device_resource
+{
+	const char *Name;
+	
+	device_resource_create  *Create;
+	device_resource_release *Release; // NULL when there is nothing to let go of, bindings for one
+	
+	// @Note Whatever Create needs past the backend itself, owned by the backend and read again on every rebuild
+	void *Recipe;
+	
+	// @Note Bit N for resource N
+	u32 DependsOn;
+	
+	bool IsLive;
+};
+
+struct device_registry
+{
+	void *Context;
+	platform_get_nanoseconds *GetNanoseconds;
+	
+	u32 ResourceCount;
+	device_resource Resources[MAX_DEVICE_RESOURCES];
+	
+	// @Note Bumped by every build that went through, anything made from an older one is stale
+	u32 Generation;
+	
+	// @Note The resource the last build that didn't go through stopped at
+	const char *FailedName;
+	
+	u32 RebuildCount;
+	u32 FailedRebuildCount;
+	u64 LastRecoveryTime;
+	u64 MaxRecoveryTime;
+	u64 TotalRecoveryTime;
+};
+
+internal void InitializeDeviceRegistry(device_registry *Registry, void *Context, platform_get_nanoseconds *GetNanoseconds)
+{
+	*Registry = {};
+	Registry->Context        = Context;
+	Registry->GetNanoseconds = GetNanoseconds;
+}
+
+inline u32 GetDeviceResourceBit(u32 ResourceIndex)
+{
+	return 1u << ResourceIndex;
+}
+
+// @Note Not made yet, BuildDeviceResources makes everything that isn't
+internal u32 AddDeviceResource(device_registry *Registry, const char *Name, device_resource_create *Create,
+							   device_resource_release *Release, void *Recipe, u32 DependsOn)
+{
+	Assert(Registry->ResourceCount < MAX_DEVICE_RESOURCES);
+	u32 ResourceIndex = Registry->ResourceCount++;
+	
+	// @Note Only on what is already there, that is what keeps registry order a build order
+	Assert((DependsOn >> ResourceIndex) == 0);
+	
+	device_resource *Resource = &Registry->Resources[ResourceIndex];
+	Resource->Name      = Name;
+	Resource->Create    = Create;
+	Resource->Release   = Release;
+	Resource->Recipe    = Recipe;
+	Resource->DependsOn = DependsOn;
+	Resource->IsLive    = false;
+	
+	return ResourceIndex;
+}
+
+// @Note Newest first, so nothing goes before what was made from it
+internal void ReleaseDeviceResources(device_registry *Registry)
+{
+	for (u32 ResourceIndex = Registry->ResourceCount; ResourceIndex-- > 0;)
+	{
+		device_resource *Resource = &Registry->Resources[ResourceIndex];
+		if (Resource->IsLive)
+		{
+			if (Resource->Release)
+			{
+				Resource->Release(Registry->Context, Resource);
+			}
+			
+			Resource->IsLive = false;
+		}
+	}
+}
+
+// Makes every resource that isn't live, oldest first. Returns false at the first one that can't be made,
+// whatever was made before it stays live.
+internal bool BuildDeviceResources(device_registry *Registry)
+{
+	for (u32 ResourceIndex = 0; ResourceIndex < Registry->ResourceCount; ++ResourceIndex)
+	{
+		device_resource *Resource = &Registry->Resources[ResourceIndex];
+		if (Resource->IsLive)
+		{
+			continue;
+		}
+		
+		for (u32 DependencyIndex = 0; DependencyIndex < ResourceIndex; ++DependencyIndex)
+		{
+			Assert(!(Resource->DependsOn & GetDeviceResourceBit(DependencyIndex)) || Registry->Resources[DependencyIndex].IsLive);
+		}
+		
+		if (!Resource->Create(Registry->Context, Resource))
+		{
+			Registry->FailedName = Resource->Name;
+			return false;
+		}
+		
+		Resource->IsLive = true;
+	}
+	
+	++Registry->Generation;
+	return true;
+}
+
+//
+// After the device was lost: everything goes and is made again from its recipe. Returns false if the new
+// device went away too, or there isn't one yet, with nothing left live. Just try again later.
+//
+internal bool RebuildDeviceResources(device_registry *Registry)
+{
+	u64 StartTime = Registry->GetNanoseconds();
+	
+	ReleaseDeviceResources(Registry);
+	if (!BuildDeviceResources(Registry))
+	{
+		ReleaseDeviceResources(Registry);
+		++Registry->FailedRebuildCount;
+		
+		return false;
+	}
+	
+	u64 RecoveryTime = Registry->GetNanoseconds() - StartTime;
+	Registry->LastRecoveryTime   = RecoveryTime;
+	Registry->MaxRecoveryTime    = Max(Registry->MaxRecoveryTime, RecoveryTime);
+	Registry->TotalRecoveryTime += RecoveryTime;
+	++Registry->RebuildCount;
+	
+	return true;
+}
+
+inline bool DeviceResourcesAreLive(device_registry *Registry)
+{
+	for (u32 ResourceIndex = 0; ResourceIndex < Registry->ResourceCount; ++ResourceIndex)
+	{
+		if (!Registry->Resources[ResourceIndex].IsLive)
+		{
+			return false;
+		}
+	}
+	
+	return true;
+}
@@ -0,0 +1,479 @@
+//
+// Effect chains: the shade with any of effect_flag's stages between the bilinear sample and the darken, on the CPU
+//
+// @Note Every row is a template over the key, so each key gets its own row with the stages that are off compiled out
+// and nothing tested per pixel. The same template built for EFFECT_KEY_BRANCHING has every stage in and tests the
+// row's key for each pixel instead, -bench effects holds the two against each other. The math is in the same order as
+// ShadeRowScalar and as the EFFECT_KEY permutations of PixelMain, so on x86 every kernel matches the scalar one bit for
+// bit and key 0 matches the plain shade.
+//
+
+// @Note By bit, lowest first
+global const char *EffectNames[] = { "key", "grayscale", "contrast", "edges" };
+
+// @Note BT.709 luminance weights in texel order, blue green red. The shaders have the same ones the other way round.
+global const float EffectLuma[3] = { 0.0722f, 0.7152f, 0.2126f };
+
+// @Note Past every real key, the row that reads its key off the shade_row
+#define EFFECT_KEY_BRANCHING EffectKey_Count
+
+constexpr bool EffectStageIsBuilt(u32 Key, u32 Effect)
+{
+	return (Key == EFFECT_KEY_BRANCHING) || ((Key & Effect) != 0);
+}
+
+template <u32 Key>
+inline bool EffectStageIsOn(shade_row *Row, u32 Effect)
+{
+	if constexpr (Key == EFFECT_KEY_BRANCHING)
+	{
+		return (Row->EffectKey & Effect) != 0;
+	}
+	
+	return true;
+}
+
+// @Note Opens the block of a stage, gone from the rows of keys without it and tested per pixel only by the branching row
+#define EFFECT_STAGE(Effect) if constexpr (EffectStageIsBuilt(Key, Effect)) if (EffectStageIsOn<Key>(Row, Effect))
+
+//
+// Scalar, the reference
+//
+
+template <u32 Key>
+internal SHADE_ROW(ShadeRowEffectsScalar)
+{
+	float *Decode = ColourTables.SRGBDecode;
+	effect_constants *Effects = &Row->Effects;
+	
+	for (int X = Begin; X < End; ++X)
+	{
+		float PixelU = Row->U + (float)X * Row->StepU;
+		float PixelV = Row->V + (float)X * Row->StepV;
+		
+		float U  = Min(Max(PixelU, Row->MinU), Row->MaxU);
+		int   X0 = (int)U;
+		int   X1 = Min(X0 + 1, Row->LastX);
+		float FX = U - (float)X0;
+		
+		float V  = Min(Max(PixelV, Row->MinV), Row->MaxV);
+		int   Y0 = (int)V;
+		int   Y1 = Min(Y0 + 1, Row->LastY);
+		float FY = V - (float)Y0;
+		
+		u8 *Row0 = Row->Texels + Y0 * Row->Pitch;
+		u8 *Row1 = Row->Texels + Y1 * Row->Pitch;
+		
+		u8 *T00 = Row0 + X0 * BITMAP_BYTES_PER_PIXEL;
+		u8 *T10 = Row0 + X1 * BITMAP_BYTES_PER_PIXEL;
+		u8 *T01 = Row1 + X0 * BITMAP_BYTES_PER_PIXEL;
+		u8 *T11 = Row1 + X1 * BITMAP_BYTES_PER_PIXEL;
+		
+		// @Note Luminance of T00, T10, T01 and T11 for the edges
+		float Sample[3];
+		float Luma[4] = { 0.0f, 0.0f, 0.0f, 0.0f };
+		for (int Channel = 0; Channel < 3; ++Channel)
+		{
+			float C00 = Decode[T00[Channel]];
+			float C10 = Decode[T10[Channel]];
+			float C01 = Decode[T01[Channel]];
+			float C11 = Decode[T11[Channel]];
+			
+			float Top    = C00 + (C10 - C00) * FX;
+			float Bottom = C01 + (C11 - C01) * FX;
+			Sample[Channel] = Top + (Bottom - Top) * FY;
+			
+			EFFECT_STAGE(Effect_Edges)
+			{
+				Luma[0] += C00 * EffectLuma[Channel];
+				Luma[1] += C10 * EffectLuma[Channel];
+				Luma[2] += C01 * EffectLuma[Channel];
+				Luma[3] += C11 * EffectLuma[Channel];
+			}
+		}
+		
+		// @Note Keyed on the sample as it came in, before anything changes it
+		u32 KeepMask = 0xFFFFFFFF;
+		EFFECT_STAGE(Effect_ColourKey)
+		{
+			float Distance = AbsF(Sample[0] - Effects->KeyColour[2]) + AbsF(Sample[1] - Effects->KeyColour[1]) +
+				AbsF(Sample[2] - Effects->KeyColour[0]);
+			KeepMask = (Distance < Effects->KeyTolerance) ? 0 : 0xFFFFFFFF;
+		}
+		
+		EFFECT_STAGE(Effect_Grayscale)
+		{
+			float Gray = Sample[0] * EffectLuma[0] + Sample[1] * EffectLuma[1] + Sample[2] * EffectLuma[2];
+			Sample[0] = Gray;
+			Sample[1] = Gray;
+			Sample[2] = Gray;
+		}
+		
+		EFFECT_STAGE(Effect_Contrast)
+		{
+			for (int Channel = 0; Channel < 3; ++Channel)
+			{
+				Sample[Channel] = EFFECT_CONTRAST_PIVOT + (Sample[Channel] - EFFECT_CONTRAST_PIVOT) * Effects->Contrast;
+			}
+		}
+		
+		EFFECT_STAGE(Effect_Edges)
+		{
+			float GradientX = (Luma[1] - Luma[0]) + (Luma[3] - Luma[2]);
+			float GradientY = (Luma[2] - Luma[0]) + (Luma[3] - Luma[1]);
+			float Edge = (AbsF(GradientX) + AbsF(GradientY)) * Effects->EdgeStrength;
+			for (int Channel = 0; Channel < 3; ++Channel)
+			{
+				Sample[Channel] += Effects->EdgeColour[2 - Channel] * Edge;
+			}
+		}
+		
+		// @Note A keyed pixel is all zero, nothing of it shows through DWM's blend
+		u32 Pixel = Row->AlphaByte << 24;
+		for (int Channel = 0; Channel < 3; ++Channel)
+		{
+			Pixel |= ShadeChannel(Row, Sample[Channel]) << (8 * Channel);
+		}
+		
+		Destination[X] = Pixel & KeepMask;
+	}
+}
+
+//
+// SSE2, four pixels at a time, the texel fetch and the table lookups are scalar like ShadeRowSSE2
+//
+
+#if defined(SHADE_X86)
+
+inline __m128 AbsSSE2(__m128 Value)
+{
+	return _mm_andnot_ps(_mm_set1_ps(-0.0f), Value);
+}
+
+template <u32 Key>
+internal SHADE_ROW(ShadeRowEffectsSSE2)
+{
+	__m128 StepU  = _mm_set1_ps(Row->StepU);
+	__m128 StepV  = _mm_set1_ps(Row->StepV);
+	__m128 MinU   = _mm_set1_ps(Row->MinU);
+	__m128 MinV   = _mm_set1_ps(Row->MinV);
+	__m128 MaxU   = _mm_set1_ps(Row->MaxU);
+	__m128 MaxV   = _mm_set1_ps(Row->MaxV);
+	__m128 Alpha  = _mm_set1_ps(Row->Alpha);
+	__m128 Darken = _mm_set1_ps(Row->Darken);
+	__m128i AlphaBits = _mm_set1_epi32((int)(Row->AlphaByte << 24));
+	
+	effect_constants *Effects = &Row->Effects;
+	__m128 Pivot        = _mm_set1_ps(EFFECT_CONTRAST_PIVOT);
+	__m128 Contrast     = _mm_set1_ps(Effects->Contrast);
+	__m128 EdgeStrength = _mm_set1_ps(Effects->EdgeStrength);
+	__m128 KeyTolerance = _mm_set1_ps(Effects->KeyTolerance);
+	
+	__m128 Luma[3];
+	__m128 EdgeColour[3];
+	__m128 KeyColour[3];
+	for (int Channel = 0; Channel < 3; ++Channel)
+	{
+		Luma[Channel]       = _mm_set1_ps(EffectLuma[Channel]);
+		EdgeColour[Channel] = _mm_set1_ps(Effects->EdgeColour[2 - Channel]);
+		KeyColour[Channel]  = _mm_set1_ps(Effects->KeyColour[2 - Channel]);
+	}
+	
+	int X = Begin;
+	for (; X + 4 <= End; X += 4)
+	{
+		__m128 PixelX = _mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(X), _mm_setr_epi32(0, 1, 2, 3)));
+		__m128 U = _mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_set1_ps(Row->U), _mm_mul_ps(PixelX, StepU)), MinU), MaxU);
+		__m128 V = _mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_set1_ps(Row->V), _mm_mul_ps(PixelX, StepV)), MinV), MaxV);
+		
+		__m128i X0 = _mm_cvttps_epi32(U);
+		__m128i Y0 = _mm_cvttps_epi32(V);
+		__m128 FX = _mm_sub_ps(U, _mm_cvtepi32_ps(X0));
+		__m128 FY = _mm_sub_ps(V, _mm_cvtepi32_ps(Y0));
+		
+		alignas(16) s32 X0s[4];
+		alignas(16) s32 Y0s[4];
+		_mm_store_si128((__m128i *)X0s, X0);
+		_mm_store_si128((__m128i *)Y0s, Y0);
+		
+		alignas(16) u32 Taps[4][4];
+		for (int Lane = 0; Lane < 4; ++Lane)
+		{
+			int X1 = Min(X0s[Lane] + 1, Row->LastX);
+			int Y1 = Min(Y0s[Lane] + 1, Row->LastY);
+			
+			u32 *Row0 = (u32 *)(Row->Texels + Y0s[Lane] * Row->Pitch);
+			u32 *Row1 = (u32 *)(Row->Texels + Y1 * Row->Pitch);
+			
+			Taps[0][Lane] = Row0[X0s[Lane]];
+			Taps[1][Lane] = Row0[X1];
+			Taps[2][Lane] = Row1[X0s[Lane]];
+			Taps[3][Lane] = Row1[X1];
+		}
+		
+		__m128 Sample[3];
+		__m128 Luma00 = _mm_setzero_ps();
+		__m128 Luma10 = _mm_setzero_ps();
+		__m128 Luma01 = _mm_setzero_ps();
+		__m128 Luma11 = _mm_setzero_ps();
+		for (int Channel = 0; Channel < 3; ++Channel)
+		{
+			__m128 C00 = DecodeChannelSSE2(Taps[0], Channel);
+			__m128 C10 = DecodeChannelSSE2(Taps[1], Channel);
+			__m128 C01 = DecodeChannelSSE2(Taps[2], Channel);
+			__m128 C11 = DecodeChannelSSE2(Taps[3], Channel);
+			
+			__m128 Top    = _mm_add_ps(C00, _mm_mul_ps(_mm_sub_ps(C10, C00), FX));
+			__m128 Bottom = _mm_add_ps(C01, _mm_mul_ps(_mm_sub_ps(C11, C01), FX));
+			Sample[Channel] = _mm_add_ps(Top, _mm_mul_ps(_mm_sub_ps(Bottom, Top), FY));
+			
+			EFFECT_STAGE(Effect_Edges)
+			{
+				Luma00 = _mm_add_ps(Luma00, _mm_mul_ps(C00, Luma[Channel]));
+				Luma10 = _mm_add_ps(Luma10, _mm_mul_ps(C10, Luma[Channel]));
+				Luma01 = _mm_add_ps(Luma01, _mm_mul_ps(C01, Luma[Channel]));
+				Luma11 = _mm_add_ps(Luma11, _mm_mul_ps(C11, Luma[Channel]));
+			}
+		}
+		
+		__m128i Keep = _mm_set1_epi32(-1);
+		EFFECT_STAGE(Effect_ColourKey)
+		{
+			__m128 Distance = _mm_add_ps(_mm_add_ps(AbsSSE2(_mm_sub_ps(Sample[0], KeyColour[0])), AbsSSE2(_mm_sub_ps(Sample[1], KeyColour[1]))),
+										 AbsSSE2(_mm_sub_ps(Sample[2], KeyColour[2])));
+			Keep = _mm_castps_si128(_mm_cmpge_ps(Distance, KeyTolerance));
+		}
+		
+		EFFECT_STAGE(Effect_Grayscale)
+		{
+			__m128 Gray = _mm_add_ps(_mm_add_ps(_mm_mul_ps(Sample[0], Luma[0]), _mm_mul_ps(Sample[1], Luma[1])), _mm_mul_ps(Sample[2], Luma[2]));
+			Sample[0] = Gray;
+			Sample[1] = Gray;
+			Sample[2] = Gray;
+		}
+		
+		EFFECT_STAGE(Effect_Contrast)
+		{
+			for (int Channel = 0; Channel < 3; ++Channel)
+			{
+				Sample[Channel] = _mm_add_ps(Pivot, _mm_mul_ps(_mm_sub_ps(Sample[Channel], Pivot), Contrast));
+			}
+		}
+		
+		EFFECT_STAGE(Effect_Edges)
+		{
+			__m128 GradientX = _mm_add_ps(_mm_sub_ps(Luma10, Luma00), _mm_sub_ps(Luma11, Luma01));
+			__m128 GradientY = _mm_add_ps(_mm_sub_ps(Luma01, Luma00), _mm_sub_ps(Luma11, Luma10));
+			__m128 Edge = _mm_mul_ps(_mm_add_ps(AbsSSE2(GradientX), AbsSSE2(GradientY)), EdgeStrength);
+			for (int Channel = 0; Channel < 3; ++Channel)
+			{
+				Sample[Channel] = _mm_add_ps(Sample[Channel], _mm_mul_ps(EdgeColour[Channel], Edge));
+			}
+		}
+		
+		__m128i Output = AlphaBits;
+		for (int Channel = 0; Channel < 3; ++Channel)
+		{
+			__m128i Byte = ShadeChannelSSE2(Sample[Channel], Darken, Alpha);
+			Output = _mm_or_si128(Output, _mm_sll_epi32(Byte, _mm_cvtsi32_si128(8 * Channel)));
+		}
+		
+		_mm_storeu_si128((__m128i *)(Destination + X), _mm_and_si128(Output, Keep));
+	}
+	
+	ShadeRowEffectsScalar<Key>(Row, Destination, X, End);
+}
+
+//
+// AVX2, eight pixels at a time with gathers like ShadeRowAVX2
+//
+
+TARGET_AVX2 inline __m256 AbsAVX2(__m256 Value)
+{
+	return _mm256_andnot_ps(_mm256_set1_ps(-0.0f), Value);
+}
+
+template <u32 Key>
+TARGET_AVX2 internal SHADE_ROW(ShadeRowEffectsAVX2)
+{
+	__m256 StepU  = _mm256_set1_ps(Row->StepU);
+	__m256 StepV  = _mm256_set1_ps(Row->StepV);
+	__m256 MinU   = _mm256_set1_ps(Row->MinU);
+	__m256 MinV   = _mm256_set1_ps(Row->MinV);
+	__m256 MaxU   = _mm256_set1_ps(Row->MaxU);
+	__m256 MaxV   = _mm256_set1_ps(Row->MaxV);
+	__m256 Alpha  = _mm256_set1_ps(Row->Alpha);
+	__m256 Darken = _mm256_set1_ps(Row->Darken);
+	__m256i LastX = _mm256_set1_epi32(Row->LastX);
+	__m256i LastY = _mm256_set1_epi32(Row->LastY);
+	__m256i Pitch = _mm256_set1_epi32(Row->Pitch);
+	__m256i OneTexel  = _mm256_set1_epi32(1);
+	__m256i AlphaBits = _mm256_set1_epi32((int)(Row->AlphaByte << 24));
+	int const *Texels = (int const *)Row->Texels;
+	
+	effect_constants *Effects = &Row->Effects;
+	__m256 Pivot        = _mm256_set1_ps(EFFECT_CONTRAST_PIVOT);
+	__m256 Contrast     = _mm256_set1_ps(Effects->Contrast);
+	__m256 EdgeStrength = _mm256_set1_ps(Effects->EdgeStrength);
+	__m256 KeyTolerance = _mm256_set1_ps(Effects->KeyTolerance);
+	
+	__m256 Luma[3];
+	__m256 EdgeColour[3];
+	__m256 KeyColour[3];
+	for (int Channel = 0; Channel < 3; ++Channel)
+	{
+		Luma[Channel]       = _mm256_set1_ps(EffectLuma[Channel]);
+		EdgeColour[Channel] = _mm256_set1_ps(Effects->EdgeColour[2 - Channel]);
+		KeyColour[Channel]  = _mm256_set1_ps(Effects->KeyColour[2 - Channel]);
+	}
+	
+	int X = Begin;
+	for (; X + 8 <= End; X += 8)
+	{
+		__m256 PixelX = _mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(X), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)));
+		__m256 U = _mm256_min_ps(_mm256_max_ps(_mm256_add_ps(_mm256_set1_ps(Row->U), _mm256_mul_ps(PixelX, StepU)), MinU), MaxU);
+		__m256 V = _mm256_min_ps(_mm256_max_ps(_mm256_add_ps(_mm256_set1_ps(Row->V), _mm256_mul_ps(PixelX, StepV)), MinV), MaxV);
+		
+		__m256i X0 = _mm256_cvttps_epi32(U);
+		__m256i Y0 = _mm256_cvttps_epi32(V);
+		__m256i X1 = _mm256_min_epi32(_mm256_add_epi32(X0, OneTexel), LastX);
+		__m256i Y1 = _mm256_min_epi32(_mm256_add_epi32(Y0, OneTexel), LastY);
+		__m256 FX = _mm256_sub_ps(U, _mm256_cvtepi32_ps(X0));
+		__m256 FY = _mm256_sub_ps(V, _mm256_cvtepi32_ps(Y0));
+		
+		__m256i Row0 = _mm256_mullo_epi32(Y0, Pitch);
+		__m256i Row1 = _mm256_mullo_epi32(Y1, Pitch);
+		__m256i Column0 = _mm256_slli_epi32(X0, 2);
+		__m256i Column1 = _mm256_slli_epi32(X1, 2);
+		
+		__m256i T00 = _mm256_i32gather_epi32(Texels, _mm256_add_epi32(Row0, Column0), 1);
+		__m256i T10 = _mm256_i32gather_epi32(Texels, _mm256_add_epi32(Row0, Column1), 1);
+		__m256i T01 = _mm256_i32gather_epi32(Texels, _mm256_add_epi32(Row1, Column0), 1);
+		__m256i T11 = _mm256_i32gather_epi32(Texels, _mm256_add_epi32(Row1, Column1), 1);
+		
+		__m256 Sample[3];
+		__m256 Luma00 = _mm256_setzero_ps();
+		__m256 Luma10 = _mm256_setzero_ps();
+		__m256 Luma01 = _mm256_setzero_ps();
+		__m256 Luma11 = _mm256_setzero_ps();
+		for (int Channel = 0; Channel < 3; ++Channel)
+		{
+			__m256 C00 = DecodeChannelAVX2(T00, Channel);
+			__m256 C10 = DecodeChannelAVX2(T10, Channel);
+			__m256 C01 = DecodeChannelAVX2(T01, Channel);
+			__m256 C11 = DecodeChannelAVX2(T11, Channel);
+			
+			__m256 Top    = _mm256_add_ps(C00, _mm256_mul_ps(_mm256_sub_ps(C10, C00), FX));
+			__m256 Bottom = _mm256_add_ps(C01, _mm256_mul_ps(_mm256_sub_ps(C11, C01), FX));
+			Sample[Channel] = _mm256_add_ps(Top, _mm256_mul_ps(_mm256_sub_ps(Bottom, Top), FY));
+			
+			EFFECT_STAGE(Effect_Edges)
+			{
+				Luma00 = _mm256_add_ps(Luma00, _mm256_mul_ps(C00, Luma[Channel]));
+				Luma10 = _mm256_add_ps(Luma10, _mm256_mul_ps(C10, Luma[Channel]));
+				Luma01 = _mm256_add_ps(Luma01, _mm256_mul_ps(C01, Luma[Channel]));
+				Luma11 = _mm256_add_ps(Luma11, _mm256_mul_ps(C11, Luma[Channel]));
+			}
+		}
+		
+		__m256i Keep = _mm256_set1_epi32(-1);
+		EFFECT_STAGE(Effect_ColourKey)
+		{
+			__m256 Distance = _mm256_add_ps(_mm256_add_ps(AbsAVX2(_mm256_sub_ps(Sample[0], KeyColour[0])), AbsAVX2(_mm256_sub_ps(Sample[1], KeyColour[1]))),
+											AbsAVX2(_mm256_sub_ps(Sample[2], KeyColour[2])));
+			Keep = _mm256_castps_si256(_mm256_cmp_ps(Distance, KeyTolerance, _CMP_GE_OQ));
+		}
+		
+		EFFECT_STAGE(Effect_Grayscale)
+		{
+			__m256 Gray = _mm256_add_ps(_mm256_add_ps(_mm256_mul_ps(Sample[0], Luma[0]), _mm256_mul_ps(Sample[1], Luma[1])), _mm256_mul_ps(Sample[2], Luma[2]));
+			Sample[0] = Gray;
+			Sample[1] = Gray;
+			Sample[2] = Gray;
+		}
+		
+		EFFECT_STAGE(Effect_Contrast)
+		{
+			for (int Channel = 0; Channel < 3; ++Channel)
+			{
+				Sample[Channel] = _mm256_add_ps(Pivot, _mm256_mul_ps(_mm256_sub_ps(Sample[Channel], Pivot), Contrast));
+			}
+		}
+		
+		EFFECT_STAGE(Effect_Edges)
+		{
+			__m256 GradientX = _mm256_add_ps(_mm256_sub_ps(Luma10, Luma00), _mm256_sub_ps(Luma11, Luma01));
+			__m256 GradientY = _mm256_add_ps(_mm256_sub_ps(Luma01, Luma00), _mm256_sub_ps(Luma11, Luma10));
+			__m256 Edge = _mm256_mul_ps(_mm256_add_ps(AbsAVX2(GradientX), AbsAVX2(GradientY)), EdgeStrength);
+			for (int Channel = 0; Channel < 3; ++Channel)
+			{
+				Sample[Channel] = _mm256_add_ps(Sample[Channel], _mm256_mul_ps(EdgeColour[Channel], Edge));
+			}
+		}
+		
+		__m256i Output = AlphaBits;
+		for (int Channel = 0; Channel < 3; ++Channel)
+		{
+			__m256i Byte = ShadeChannelAVX2(Sample[Channel], Darken, Alpha);
+			Output = _mm256_or_si256(Output, _mm256_sll_epi32(Byte, _mm_cvtsi32_si128(8 * Channel)));
+		}
+		
+		_mm256_storeu_si256((__m256i *)(Destination + X), _mm256_and_si256(Output, Keep));
+	}
+	
+	ShadeRowEffectsScalar<Key>(Row, Destination, X, End);
+}
+
+#endif
+
+//
+// Dispatch
+//
+
+// @Note Every key's specialization of a kernel, indexed by the key
+#define EFFECT_ROWS(Kernel) \
+{ \
+	Kernel<0x0>, Kernel<0x1>, Kernel<0x2>, Kernel<0x3>, Kernel<0x4>, Kernel<0x5>, Kernel<0x6>, Kernel<0x7>, \
+	Kernel<0x8>, Kernel<0x9>, Kernel<0xA>, Kernel<0xB>, Kernel<0xC>, Kernel<0xD>, Kernel<0xE>, Kernel<0xF>, \
+}
+
+global shade_row_function *EffectRowsScalar[EffectKey_Count] = EFFECT_ROWS(ShadeRowEffectsScalar);
+#if defined(SHADE_X86)
+global shade_row_function *EffectRowsSSE2[EffectKey_Count] = EFFECT_ROWS(ShadeRowEffectsSSE2);
+global shade_row_function *EffectRowsAVX2[EffectKey_Count] = EFFECT_ROWS(ShadeRowEffectsAVX2);
+#endif
+
+// Returns NULL if this build or this CPU doesn't have the kernel, NEON has no effect rows. Key 0 is the plain shade,
+// GetShadeRow's row.
+internal shade_row_function *GetEffectRow(shade_kernel Kernel, u32 Key)
+{
+	Assert(Key < EffectKey_Count);
+	if (Key == 0)
+	{
+		return GetShadeRow(Kernel);
+	}
+	
+	switch (Kernel)
+	{
+		case ShadeKernel_Scalar: return EffectRowsScalar[Key];
+#if defined(SHADE_X86)
+		case ShadeKernel_SSE2: return EffectRowsSSE2[Key];
+		case ShadeKernel_AVX2: return CPUHasAVX2() ? EffectRowsAVX2[Key] : NULL;
+#endif
+		default: return NULL;
+	}
+}
+
+// @Note The one row for every key that tests the key per pixel, only for -bench effects to measure against
+internal shade_row_function *GetBranchingEffectRow(shade_kernel Kernel)
+{
+	switch (Kernel)
+	{
+		case ShadeKernel_Scalar: return ShadeRowEffectsScalar<EFFECT_KEY_BRANCHING>;
+#if defined(SHADE_X86)
+		case ShadeKernel_SSE2: return ShadeRowEffectsSSE2<EFFECT_KEY_BRANCHING>;
+		case ShadeKernel_AVX2: return CPUHasAVX2() ? ShadeRowEffectsAVX2<EFFECT_KEY_BRANCHING> : NULL;
+#endif
+		default: return NULL;
+	}
+}
@@ -0,0 +1,88 @@
+//
+// Triple buffered handoff from one writer thread to one reader thread
+//
+// @Note The writer fills its own slot and swaps it with the shared middle one, the reader swaps its
+// slot with the middle one when it's marked as new. Neither side ever waits and neither side can see
+// a slot the other one is writing. The newest one wins: whatever was in the middle when the writer
+// swapped a newer one in is dropped unread. Only the slot indices live here, the slots are the user's.
+//
+
+#define EXCHANGE_SLOT_COUNT	3
+#define EXCHANGE_NEW_BIT	0x80000000u
+#define EXCHANGE_INDEX_MASK	0x3u
+
+struct slot_exchange
+{
+	// @Note Each one on its own cache line, the writer and the reader hammer different ones
+	alignas(64) u32 WriteIndex;
+	alignas(64) u32 ReadIndex;
+	alignas(64) u32 volatile Middle;
+};
+
+internal void InitializeSlotExchange(slot_exchange *Exchange)
+{
+	Exchange->WriteIndex = 0;
+	Exchange->ReadIndex  = 1;
+	AtomicStoreU32(&Exchange->Middle, 2);
+}
+
+// @Note Writer side, only ever called from one thread. Hands over the WriteIndex slot and gets another one.
+// Returns true if the one it got was never read.
+internal bool PublishSlot(slot_exchange *Exchange)
+{
+	u32 Previous = AtomicExchangeU32(&Exchange->Middle, Exchange->WriteIndex | EXCHANGE_NEW_BIT);
+	Exchange->WriteIndex = Previous & EXCHANGE_INDEX_MASK;
+	
+	return (Previous & EXCHANGE_NEW_BIT) != 0;
+}
+
+// @Note Reader side, only ever called from one thread. Returns true if ReadIndex is a newer slot than before.
+internal bool TakeNewestSlot(slot_exchange *Exchange)
+{
+	if (AtomicLoadU32(&Exchange->Middle) & EXCHANGE_NEW_BIT)
+	{
+		u32 Previous = AtomicExchangeU32(&Exchange->Middle, Exchange->ReadIndex);
+		Exchange->ReadIndex = Previous & EXCHANGE_INDEX_MASK;
+		return true;
+	}
+	
+	return false;
+}
+
+//
+// Render state handoff from the window thread to the render thread
+//
+// @Note A frame always gets a cut box, a transform and a display size that were published together
+//
+
+struct render_state_exchange
+{
+	render_state Slots[EXCHANGE_SLOT_COUNT];
+	slot_exchange Exchange;
+};
+
+internal void InitializeRenderStateExchange(render_state_exchange *Exchange, render_state *State)
+{
+	for (u32 SlotIndex = 0; SlotIndex < GetArrayCount(Exchange->Slots); ++SlotIndex)
+	{
+		Exchange->Slots[SlotIndex] = *State;
+	}
+	
+	InitializeSlotExchange(&Exchange->Exchange);
+}
+
+// @Note Writer side, only ever called from one thread
+internal void PublishRenderState(render_state_exchange *Exchange, render_state *State)
+{
+	Exchange->Slots[Exchange->Exchange.WriteIndex] = *State;
+	PublishSlot(&Exchange->Exchange);
+}
+
+// @Note Reader side, only ever called from one thread. Returns true if the state is newer than the last read.
+internal bool ReadRenderState(render_state_exchange *Exchange, render_state *State)
+{
+	bool IsNew = TakeNewestSlot(&Exchange->Exchange);
+	*State = Exchange->Slots[Exchange->Exchange.ReadIndex];
+	
+	return IsNew;
+}
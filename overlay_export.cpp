@@ -0,0 +1,371 @@
+//
+// Frame export: every presented display texture goes into a ring in shared memory, for other processes to read
+//
+// @Note The ring is a header and a few fixed slots, each slot a header and room for one frame's pixels. A slot's
+// sequence word says which frame it holds, and is zero while the writer is in it. The writer never waits on
+// anyone: it zeroes the word, writes the frame, stores the frame's sequence in the slot and then in the ring
+// header. A reader looks at the newest frame where it lies and checks the slot's word again once it is done;
+// if the writer came round to the slot meanwhile, what it read is no good and it goes for the newest again.
+// Readers write nothing into the ring, so any number of them can map it read only.
+//
+// Frame N is in slot (N - 1) % SlotCount, so a reader has as long as the writer takes to fill every other slot.
+//
+
+#define EXPORT_RING_MAGIC   0x5058564F // "OVXP"
+#define EXPORT_RING_VERSION 2
+
+// @Note A reader has three frames' time to finish with one
+#define EXPORT_RING_SLOT_COUNT 4
+
+// @Note Headers and pixels start on their own cache lines
+#define EXPORT_RING_ALIGNMENT 64
+
+// @Note Formats past the surface formats, for frames converted to YUV, see overlay_yuv.cpp. Format is this plus the
+// yuv_layout and ColourSpace says which matrix and range. The Y plane is Pitch bytes a row, the chroma follows it.
+#define EXPORT_FORMAT_YUV 0x100
+
+struct export_piece
+{
+	u32 OverlayIndex;
+	u32 OutputIndex;
+	box Slot;       // Its crop in the frame's pixels
+	box SurfaceBox; // Where that was cut from, on its output's surface
+};
+
+// @Note Everything about a frame but its pixels. Nothing but 4 and 8 byte fields, so every compiler lays it out the same.
+struct export_frame
+{
+	u64 Sequence;  // 1 for the first frame written, one more for every one after
+	u64 Timestamp; // Overlay clock microseconds at the present
+	u32 Width;
+	u32 Height;
+	u32 Pitch;
+	u32 Format; // surface_format, SurfaceFormat_BGRA8 for the display texture as it is, sRGB, or EXPORT_FORMAT_YUV and up
+	u32 PieceCount;
+	u32 ColourSpace; // YUV only, yuv_matrix in the low byte and yuv_range in the next one
+	export_piece Pieces[MAX_CROP_PIECES];
+};
+
+struct export_slot_header
+{
+	// @Note Zero while the writer is in the slot
+	u64 volatile Sequence;
+	u64 Pad;
+	
+	export_frame Frame;
+};
+
+// @Note At the start of the shared memory, the slots follow from SlotOffset
+struct export_ring_header
+{
+	u32 volatile Magic; // Stored last, a reader that sees it sees the rest
+	u32 Version;
+	u32 SlotCount;
+	u32 Pad;
+	u64 SlotOffset;
+	u64 SlotSize;   // From one slot header to the next
+	u64 PixelBytes; // Most a frame's pixels can take
+	
+	// @Note Newest frame that is whole, zero before the first
+	alignas(EXPORT_RING_ALIGNMENT) u64 volatile Sequence;
+};
+
+inline u64 AlignExportSize(u64 Size)
+{
+	return (Size + EXPORT_RING_ALIGNMENT - 1) & ~(u64)(EXPORT_RING_ALIGNMENT - 1);
+}
+
+internal u64 GetExportRingSize(u32 SlotCount, u64 PixelBytes)
+{
+	u64 SlotSize = AlignExportSize(sizeof(export_slot_header)) + AlignExportSize(PixelBytes);
+	return AlignExportSize(sizeof(export_ring_header)) + SlotCount * SlotSize;
+}
+
+inline export_slot_header *GetExportSlot(export_ring_header *Header, u64 Sequence)
+{
+	u8 *Slots = (u8 *)Header + Header->SlotOffset;
+	return (export_slot_header *)(Slots + ((Sequence - 1) % Header->SlotCount) * Header->SlotSize);
+}
+
+inline u8 *GetExportPixels(export_slot_header *Slot)
+{
+	return (u8 *)Slot + AlignExportSize(sizeof(export_slot_header));
+}
+
+// @Note BGRA rows, or the Y plane and a quarter of it again for each of U and V
+inline u64 GetExportFrameSize(export_frame *Frame)
+{
+	u64 Size = (u64)Frame->Pitch * Frame->Height;
+	return (Frame->Format == SurfaceFormat_BGRA8) ? Size : Size + Size / 2;
+}
+
+// @Note The pieces as the pipeline has them and where the crop atlas put them. Only the ones whose crop is
+// in the display texture go in, a piece without an image or drawn straight from the surface has nothing there.
+internal void GetExportFrame(export_frame *Frame, crop_piece *Pieces, u32 PieceCount, box *Slots, u64 Timestamp)
+{
+	Frame->Timestamp  = Timestamp;
+	Frame->PieceCount = 0;
+	
+	for (u32 PieceIndex = 0; PieceIndex < PieceCount; ++PieceIndex)
+	{
+		crop_piece *Piece = &Pieces[PieceIndex];
+		if (Piece->HasImage && !Piece->SamplesSurface)
+		{
+			export_piece *Exported = &Frame->Pieces[Frame->PieceCount++];
+			Exported->OverlayIndex = Piece->OverlayIndex;
+			Exported->OutputIndex  = Piece->OutputIndex;
+			Exported->Slot         = Slots[PieceIndex];
+			Exported->SurfaceBox   = Piece->Mapping.SurfaceBox;
+		}
+	}
+}
+
+//
+// Writer, only ever on the render thread
+//
+
+struct export_ring
+{
+	export_ring_header *Header;
+	u64 Sequence;
+	
+	u64 WrittenCount;
+	u64 TooBigCount; // Frames bigger than a slot, not written
+	u64 WrittenBytes;
+};
+
+// @Note Memory is GetExportRingSize bytes of shared memory. A ring that was already there starts over,
+// its readers see the sequence go back and follow.
+internal void InitializeExportRing(export_ring *Ring, void *Memory, u32 SlotCount, u64 PixelBytes)
+{
+	export_ring_header *Header = (export_ring_header *)Memory;
+	AtomicStoreU32(&Header->Magic, 0);
+	
+	Header->Version    = EXPORT_RING_VERSION;
+	Header->SlotCount  = SlotCount;
+	Header->Pad        = 0;
+	Header->SlotOffset = AlignExportSize(sizeof(export_ring_header));
+	Header->SlotSize   = AlignExportSize(sizeof(export_slot_header)) + AlignExportSize(PixelBytes);
+	Header->PixelBytes = PixelBytes;
+	
+	for (u32 SlotIndex = 0; SlotIndex < SlotCount; ++SlotIndex)
+	{
+		AtomicStoreU64(&GetExportSlot(Header, SlotIndex + 1)->Sequence, 0);
+	}
+	
+	AtomicStoreU64(&Header->Sequence, 0);
+	AtomicStoreU32(&Header->Magic, EXPORT_RING_MAGIC);
+	
+	Ring->Header       = Header;
+	Ring->Sequence     = 0;
+	Ring->WrittenCount = 0;
+	Ring->TooBigCount  = 0;
+	Ring->WrittenBytes = 0;
+}
+
+// @Note Takes the next slot and fills in its frame from Frame, which has everything but the sequence filled in.
+// The pixels go where it returns and EndExportWrite publishes them. NULL if they don't fit in a slot.
+internal u8 *BeginExportWrite(export_ring *Ring, export_frame *Frame)
+{
+	export_ring_header *Header = Ring->Header;
+	if (GetExportFrameSize(Frame) > Header->PixelBytes)
+	{
+		++Ring->TooBigCount;
+		return NULL;
+	}
+	
+	u64 Sequence = ++Ring->Sequence;
+	export_slot_header *Slot = GetExportSlot(Header, Sequence);
+	
+	// @Note A reader that started on the frame in here before sees the zero, or the new sequence, when it checks
+	AtomicStoreU64(&Slot->Sequence, 0);
+	CompletePreviousWritesBeforeFutureWrites();
+	
+	Slot->Frame = *Frame;
+	Slot->Frame.Sequence = Sequence;
+	
+	return GetExportPixels(Slot);
+}
+
+internal void EndExportWrite(export_ring *Ring, export_frame *Frame)
+{
+	export_ring_header *Header = Ring->Header;
+	u64 Sequence = Ring->Sequence;
+	
+	AtomicStoreU64(&GetExportSlot(Header, Sequence)->Sequence, Sequence);
+	AtomicStoreU64(&Header->Sequence, Sequence);
+	
+	++Ring->WrittenCount;
+	Ring->WrittenBytes += GetExportFrameSize(Frame);
+}
+
+// Writes Image into the next slot with Frame's timestamp and pieces, the rows packed tight.
+// Returns false if it doesn't fit in a slot.
+internal bool WriteExportRing(export_ring *Ring, export_frame *Frame, bitmap *Image)
+{
+	u64 RowSize = (u64)Image->Width * BITMAP_BYTES_PER_PIXEL;
+	
+	Frame->Width       = (u32)Image->Width;
+	Frame->Height      = (u32)Image->Height;
+	Frame->Pitch       = (u32)RowSize;
+	Frame->Format      = SurfaceFormat_BGRA8;
+	Frame->ColourSpace = 0;
+	
+	u8 *Pixels = BeginExportWrite(Ring, Frame);
+	if (!Pixels)
+	{
+		return false;
+	}
+	
+	for (int Y = 0; Y < Image->Height; ++Y)
+	{
+		CopyBytes(Pixels + Y * RowSize, Image->Memory + (size_t)Y * Image->Pitch, RowSize);
+	}
+	
+	EndExportWrite(Ring, Frame);
+	return true;
+}
+
+// @Note The same for a converted image, its planes are packed tight already and go across in one
+internal bool WriteExportRingYUV(export_ring *Ring, export_frame *Frame, yuv_image *Image)
+{
+	Frame->Width       = (u32)Image->Width;
+	Frame->Height      = (u32)Image->Height;
+	Frame->Pitch       = (u32)Image->Width;
+	Frame->Format      = EXPORT_FORMAT_YUV + Image->Format.Layout;
+	Frame->ColourSpace = (u32)Image->Format.Matrix | ((u32)Image->Format.Range << 8);
+	
+	u8 *Pixels = BeginExportWrite(Ring, Frame);
+	if (!Pixels)
+	{
+		return false;
+	}
+	
+	CopyBytes(Pixels, Image->Planes[0], Image->Size);
+	
+	EndExportWrite(Ring, Frame);
+	return true;
+}
+
+//
+// Reader, one per thread, in whatever process maps the ring
+//
+
+struct export_reader
+{
+	export_ring_header *Header;
+	u64 LastSequence;
+	
+	// @Note The read in progress
+	export_slot_header *Slot;
+	u64 ReadSequence;
+	
+	u64 ReadCount;
+	u64 SkippedCount;     // Written while the reader wasn't looking, never read
+	u64 OverwrittenCount; // Reads the writer came round on, tried again with a newer frame
+};
+
+// @Note Memory is all Size bytes of the mapping. False if that isn't a ring, or one of another version.
+internal bool OpenExportReader(export_reader *Reader, void *Memory, u64 Size)
+{
+	export_ring_header *Header = (export_ring_header *)Memory;
+	if ((Size < sizeof(export_ring_header)) || (AtomicLoadU32(&Header->Magic) != EXPORT_RING_MAGIC) ||
+		(Header->Version != EXPORT_RING_VERSION) || (Header->SlotCount == 0) ||
+		(Header->SlotSize < AlignExportSize(sizeof(export_slot_header)) + Header->PixelBytes) ||
+		(Header->SlotOffset + Header->SlotCount * Header->SlotSize > Size))
+	{
+		return false;
+	}
+	
+	Reader->Header           = Header;
+	Reader->LastSequence     = 0;
+	Reader->Slot             = NULL;
+	Reader->ReadSequence     = 0;
+	Reader->ReadCount        = 0;
+	Reader->SkippedCount     = 0;
+	Reader->OverwrittenCount = 0;
+	
+	return true;
+}
+
+//
+// Starts a read of the newest frame if it is newer than the last one read: fills *Frame and returns its pixels,
+// where they are in the ring. NULL if there is no newer frame. Nothing read from the frame is any good until
+// EndExportRead says it wasn't written over in the meantime, so read what is needed and end the read quickly.
+//
+internal u8 *BeginExportRead(export_reader *Reader, export_frame *Frame)
+{
+	export_ring_header *Header = Reader->Header;
+	
+	// @Note Backwards when the writer started the ring over
+	u64 Sequence = AtomicLoadU64(&Header->Sequence);
+	if (Sequence < Reader->LastSequence)
+	{
+		Reader->LastSequence = 0;
+	}
+	
+	if (Sequence == Reader->LastSequence)
+	{
+		return NULL;
+	}
+	
+	export_slot_header *Slot = GetExportSlot(Header, Sequence);
+	if (AtomicLoadU64(&Slot->Sequence) != Sequence)
+	{
+		// @Note The writer is in it again already, a newer frame is on its way
+		++Reader->OverwrittenCount;
+		return NULL;
+	}
+	
+	*Frame = Slot->Frame;
+	
+	// @Note A frame written over while it was copied can say anything, it mustn't send the reader outside its slot
+	u32 BytesPerPixel = (Frame->Format == SurfaceFormat_BGRA8) ? BITMAP_BYTES_PER_PIXEL : 1;
+	if ((GetExportFrameSize(Frame) > Header->PixelBytes) || ((u64)Frame->Width * BytesPerPixel > Frame->Pitch) ||
+		(Frame->PieceCount > MAX_CROP_PIECES))
+	{
+		Frame->Width      = 0;
+		Frame->Height     = 0;
+		Frame->PieceCount = 0;
+	}
+	
+	Reader->Slot         = Slot;
+	Reader->ReadSequence = Sequence;
+	
+	return GetExportPixels(Slot);
+}
+
+// Returns true if the frame BeginExportRead started on is still in its slot, so everything read from it is good
+internal bool EndExportRead(export_reader *Reader)
+{
+	CompletePreviousReadsBeforeFutureReads();
+	bool IsWhole = (AtomicLoadU64(&Reader->Slot->Sequence) == Reader->ReadSequence);
+	
+	if (IsWhole)
+	{
+		Reader->SkippedCount += Reader->ReadSequence - Reader->LastSequence - 1;
+		Reader->LastSequence  = Reader->ReadSequence;
+		++Reader->ReadCount;
+	}
+	else
+	{
+		++Reader->OverwrittenCount;
+	}
+	
+	Reader->Slot = NULL;
+	return IsWhole;
+}
+
+// @Note BeginExportRead and EndExportRead for a reader that wants its own copy. Returns false if there was no
+// newer frame, or it went before it was copied whole. Pixels has room for a frame of the ring's PixelBytes.
+internal bool ReadExportRing(export_reader *Reader, export_frame *Frame, u8 *Pixels)
+{
+	u8 *Source = BeginExportRead(Reader, Frame);
+	if (!Source)
+	{
+		return false;
+	}
+	
+	CopyBytes(Pixels, Source, (size_t)GetExportFrameSize(Frame));
+	return EndExportRead(Reader);
+}
@@ -0,0 +1,606 @@
+//
+// Change detector: the display texture hashed in small tiles, so a crop that copied the same pixels again is known to have
+//
+// @Note A dirty rect only says something was drawn there. A blinking caret next to the cut box, or an animation
+// that shares a dirty rect with it, gets the crop copied again with nothing new in it. Every tile a crop touched
+// is hashed again and compared with what it hashed to last time. The changed tiles are also kept as a bitmap
+// for anything later in the frame that only wants to look at those.
+//
+// The hash is 64 lanes, pixel X of row Y goes into lane X of the lane set Y % 4. That makes one row of a tile one
+// step of 16 lanes, four SSE2 or two AVX2 registers, with four rows in flight at once so the multiplies don't wait on
+// each other. The sets are folded into each other and then into 64 bits, every kernel gets the same value as the
+// scalar one. It only has to tell a tile from what it held the frame before, it is no good for anything that has to
+// be hard to collide.
+//
+
+#define CHANGE_TILE_SIZE 16
+
+#define HASH_ROW_LANES 16
+#define HASH_LANE_SETS 4
+#define HASH_LANES     (HASH_ROW_LANES * HASH_LANE_SETS)
+#define HASH_PRIME     0x9E3779B1u
+
+// @Note Never a hash, tiles that hold it count as changed whatever they hash to
+#define UNKNOWN_TILE_HASH 0
+
+// @Note Up to this many texels a kept copy of the texture is compared against instead of hashing, see -bench hash.
+// Reading both and writing back the changed tiles is cheaper than the hash until the copy stops fitting in cache,
+// and a 1024x1024 copy is only 4MB. Past that the hashes save the memory and cost about the same.
+#define CHANGE_COMPARE_MAX_PIXELS (1024 * 1024)
+
+// Height rows of Width pixels, Width at most HASH_ROW_LANES
+#define HASH_TILE(Name) u64 Name(u8 *Memory, int Pitch, int Width, int Height)
+typedef HASH_TILE(hash_tile_function);
+
+inline u32 MixHashLane(u32 Lane, u32 Pixel)
+{
+	Lane = (Lane ^ Pixel) * HASH_PRIME;
+	return (Lane << 15) | (Lane >> 17);
+}
+
+// @Note Lanes is the sets already mixed into the first one, this is FNV-1a over it two lanes at a time
+internal u64 FoldHashLanes(u32 *Lanes)
+{
+	u64 Hash = 14695981039346656037ull;
+	for (int Lane = 0; Lane < HASH_ROW_LANES; Lane += 2)
+	{
+		Hash = (Hash ^ (Lanes[Lane] | ((u64)Lanes[Lane + 1] << 32))) * 1099511628211ull;
+	}
+	
+	return (Hash == UNKNOWN_TILE_HASH) ? 1 : Hash;
+}
+
+internal HASH_TILE(HashTileScalar)
+{
+	u32 Lanes[HASH_LANES];
+	for (int Lane = 0; Lane < HASH_LANES; ++Lane)
+	{
+		Lanes[Lane] = (u32)Lane;
+	}
+	
+	for (int Y = 0; Y < Height; ++Y)
+	{
+		u32 *Pixel = (u32 *)(Memory + Y * Pitch);
+		u32 *Set   = Lanes + (Y % HASH_LANE_SETS) * HASH_ROW_LANES;
+		for (int X = 0; X < Width; ++X)
+		{
+			Set[X] = MixHashLane(Set[X], Pixel[X]);
+		}
+	}
+	
+	for (int Lane = 0; Lane < HASH_ROW_LANES; ++Lane)
+	{
+		for (int Set = 1; Set < HASH_LANE_SETS; ++Set)
+		{
+			Lanes[Lane] = MixHashLane(Lanes[Lane], Lanes[Set * HASH_ROW_LANES + Lane]);
+		}
+	}
+	
+	return FoldHashLanes(Lanes);
+}
+
+// @Note The vector kernels take whole tiles, the scalar one does the edges
+inline bool IsWholeHashTile(int Width, int Height)
+{
+	return (Width == HASH_ROW_LANES) && ((Height % HASH_LANE_SETS) == 0);
+}
+
+#if defined(SHADE_X86)
+
+//
+// SSE2, a row in four registers. There is no 32 bit multiply, it is made of two 32x32->64 ones.
+//
+
+inline __m128i MultiplyLow32(__m128i A, __m128i B)
+{
+	__m128i Even = _mm_mul_epu32(A, B);
+	__m128i Odd  = _mm_mul_epu32(_mm_srli_epi64(A, 32), _mm_srli_epi64(B, 32));
+	return _mm_unpacklo_epi32(_mm_shuffle_epi32(Even, _MM_SHUFFLE(0, 0, 2, 0)), _mm_shuffle_epi32(Odd, _MM_SHUFFLE(0, 0, 2, 0)));
+}
+
+inline __m128i MixHashLanesSSE2(__m128i Lanes, __m128i Pixels, __m128i Prime)
+{
+	Lanes = MultiplyLow32(_mm_xor_si128(Lanes, Pixels), Prime);
+	return _mm_or_si128(_mm_slli_epi32(Lanes, 15), _mm_srli_epi32(Lanes, 17));
+}
+
+internal HASH_TILE(HashTileSSE2)
+{
+	if (!IsWholeHashTile(Width, Height))
+	{
+		return HashTileScalar(Memory, Pitch, Width, Height);
+	}
+	
+	__m128i Prime = _mm_set1_epi32((int)HASH_PRIME);
+	
+	__m128i Lanes[HASH_LANES / 4];
+	for (int Register = 0; Register < HASH_LANES / 4; ++Register)
+	{
+		Lanes[Register] = _mm_setr_epi32(Register * 4, Register * 4 + 1, Register * 4 + 2, Register * 4 + 3);
+	}
+	
+	for (int Y = 0; Y < Height; Y += HASH_LANE_SETS)
+	{
+		for (int Set = 0; Set < HASH_LANE_SETS; ++Set)
+		{
+			__m128i *Row = (__m128i *)(Memory + (Y + Set) * Pitch);
+			__m128i *SetLanes = Lanes + Set * 4;
+			SetLanes[0] = MixHashLanesSSE2(SetLanes[0], _mm_loadu_si128(Row + 0), Prime);
+			SetLanes[1] = MixHashLanesSSE2(SetLanes[1], _mm_loadu_si128(Row + 1), Prime);
+			SetLanes[2] = MixHashLanesSSE2(SetLanes[2], _mm_loadu_si128(Row + 2), Prime);
+			SetLanes[3] = MixHashLanesSSE2(SetLanes[3], _mm_loadu_si128(Row + 3), Prime);
+		}
+	}
+	
+	u32 Folded[HASH_ROW_LANES];
+	for (int Register = 0; Register < 4; ++Register)
+	{
+		__m128i Lane = Lanes[Register];
+		for (int Set = 1; Set < HASH_LANE_SETS; ++Set)
+		{
+			Lane = MixHashLanesSSE2(Lane, Lanes[Set * 4 + Register], Prime);
+		}
+		
+		_mm_storeu_si128((__m128i *)Folded + Register, Lane);
+	}
+	
+	return FoldHashLanes(Folded);
+}
+
+//
+// AVX2, a row in two registers
+//
+
+TARGET_AVX2 inline __m256i MixHashLanesAVX2(__m256i Lanes, __m256i Pixels, __m256i Prime)
+{
+	Lanes = _mm256_mullo_epi32(_mm256_xor_si256(Lanes, Pixels), Prime);
+	return _mm256_or_si256(_mm256_slli_epi32(Lanes, 15), _mm256_srli_epi32(Lanes, 17));
+}
+
+TARGET_AVX2 internal HASH_TILE(HashTileAVX2)
+{
+	if (!IsWholeHashTile(Width, Height))
+	{
+		return HashTileScalar(Memory, Pitch, Width, Height);
+	}
+	
+	__m256i Prime = _mm256_set1_epi32((int)HASH_PRIME);
+	__m256i Step  = _mm256_set1_epi32(8);
+	
+	__m256i Lanes[HASH_LANES / 8];
+	Lanes[0] = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+	for (int Register = 1; Register < HASH_LANES / 8; ++Register)
+	{
+		Lanes[Register] = _mm256_add_epi32(Lanes[Register - 1], Step);
+	}
+	
+	for (int Y = 0; Y < Height; Y += HASH_LANE_SETS)
+	{
+		for (int Set = 0; Set < HASH_LANE_SETS; ++Set)
+		{
+			__m256i *Row = (__m256i *)(Memory + (Y + Set) * Pitch);
+			Lanes[Set * 2 + 0] = MixHashLanesAVX2(Lanes[Set * 2 + 0], _mm256_loadu_si256(Row + 0), Prime);
+			Lanes[Set * 2 + 1] = MixHashLanesAVX2(Lanes[Set * 2 + 1], _mm256_loadu_si256(Row + 1), Prime);
+		}
+	}
+	
+	u32 Folded[HASH_ROW_LANES];
+	for (int Register = 0; Register < 2; ++Register)
+	{
+		__m256i Lane = Lanes[Register];
+		for (int Set = 1; Set < HASH_LANE_SETS; ++Set)
+		{
+			Lane = MixHashLanesAVX2(Lane, Lanes[Set * 2 + Register], Prime);
+		}
+		
+		_mm256_storeu_si256((__m256i *)Folded + Register, Lane);
+	}
+	
+	return FoldHashLanes(Folded);
+}
+
+#endif
+
+#if defined(SHADE_NEON)
+
+//
+// NEON, a row in four registers
+//
+
+inline uint32x4_t MixHashLanesNEON(uint32x4_t Lanes, uint32x4_t Pixels)
+{
+	Lanes = vmulq_n_u32(veorq_u32(Lanes, Pixels), HASH_PRIME);
+	return vorrq_u32(vshlq_n_u32(Lanes, 15), vshrq_n_u32(Lanes, 17));
+}
+
+internal HASH_TILE(HashTileNEON)
+{
+	if (!IsWholeHashTile(Width, Height))
+	{
+		return HashTileScalar(Memory, Pitch, Width, Height);
+	}
+	
+	u32 Start[HASH_LANES];
+	for (int Lane = 0; Lane < HASH_LANES; ++Lane)
+	{
+		Start[Lane] = (u32)Lane;
+	}
+	
+	uint32x4_t Lanes[HASH_LANES / 4];
+	for (int Register = 0; Register < HASH_LANES / 4; ++Register)
+	{
+		Lanes[Register] = vld1q_u32(Start + Register * 4);
+	}
+	
+	for (int Y = 0; Y < Height; Y += HASH_LANE_SETS)
+	{
+		for (int Set = 0; Set < HASH_LANE_SETS; ++Set)
+		{
+			u32 *Row = (u32 *)(Memory + (Y + Set) * Pitch);
+			uint32x4_t *SetLanes = Lanes + Set * 4;
+			SetLanes[0] = MixHashLanesNEON(SetLanes[0], vld1q_u32(Row + 0));
+			SetLanes[1] = MixHashLanesNEON(SetLanes[1], vld1q_u32(Row + 4));
+			SetLanes[2] = MixHashLanesNEON(SetLanes[2], vld1q_u32(Row + 8));
+			SetLanes[3] = MixHashLanesNEON(SetLanes[3], vld1q_u32(Row + 12));
+		}
+	}
+	
+	u32 Folded[HASH_ROW_LANES];
+	for (int Register = 0; Register < 4; ++Register)
+	{
+		uint32x4_t Lane = Lanes[Register];
+		for (int Set = 1; Set < HASH_LANE_SETS; ++Set)
+		{
+			Lane = MixHashLanesNEON(Lane, Lanes[Set * 4 + Register]);
+		}
+		
+		vst1q_u32(Folded + Register * 4, Lane);
+	}
+	
+	return FoldHashLanes(Folded);
+}
+
+#endif
+
+// @Note Same instruction sets as the shade kernels, NULL if this build or CPU doesn't have it
+internal hash_tile_function *GetHashTile(shade_kernel Kernel)
+{
+	switch (Kernel)
+	{
+		case ShadeKernel_Scalar: return HashTileScalar;
+#if defined(SHADE_X86)
+		case ShadeKernel_SSE2: return HashTileSSE2;
+		case ShadeKernel_AVX2: return CPUHasAVX2() ? HashTileAVX2 : NULL;
+#endif
+#if defined(SHADE_NEON)
+		case ShadeKernel_NEON: return HashTileNEON;
+#endif
+		default: return NULL;
+	}
+}
+
+//
+// Kept copy, for textures small enough that comparing against it is cheaper than hashing
+//
+// @Note No early out, a tile is small and a branch-free tile is a handful of vector ops a row.
+// The edge tiles that aren't CHANGE_TILE_SIZE wide take the scalar kernel.
+//
+
+// True if any of Height rows of Width pixels differ from the kept ones
+#define COMPARE_TILE(Name) bool Name(u8 *Memory, int Pitch, u8 *Kept, int KeptPitch, int Width, int Height)
+typedef COMPARE_TILE(compare_tile_function);
+
+internal COMPARE_TILE(CompareTileScalar)
+{
+	u32 Difference = 0;
+	for (int Y = 0; Y < Height; ++Y)
+	{
+		u32 *Row     = (u32 *)(Memory + Y * Pitch);
+		u32 *KeptRow = (u32 *)(Kept + Y * KeptPitch);
+		for (int X = 0; X < Width; ++X)
+		{
+			Difference |= Row[X] ^ KeptRow[X];
+		}
+	}
+	
+	return Difference != 0;
+}
+
+#if defined(SHADE_X86)
+
+internal COMPARE_TILE(CompareTileSSE2)
+{
+	if (Width != CHANGE_TILE_SIZE)
+	{
+		return CompareTileScalar(Memory, Pitch, Kept, KeptPitch, Width, Height);
+	}
+	
+	__m128i Difference = _mm_setzero_si128();
+	for (int Y = 0; Y < Height; ++Y)
+	{
+		__m128i *Row     = (__m128i *)(Memory + Y * Pitch);
+		__m128i *KeptRow = (__m128i *)(Kept + Y * KeptPitch);
+		__m128i Low  = _mm_or_si128(_mm_xor_si128(_mm_loadu_si128(Row + 0), _mm_loadu_si128(KeptRow + 0)),
+									_mm_xor_si128(_mm_loadu_si128(Row + 1), _mm_loadu_si128(KeptRow + 1)));
+		__m128i High = _mm_or_si128(_mm_xor_si128(_mm_loadu_si128(Row + 2), _mm_loadu_si128(KeptRow + 2)),
+									_mm_xor_si128(_mm_loadu_si128(Row + 3), _mm_loadu_si128(KeptRow + 3)));
+		Difference = _mm_or_si128(Difference, _mm_or_si128(Low, High));
+	}
+	
+	return _mm_movemask_epi8(_mm_cmpeq_epi8(Difference, _mm_setzero_si128())) != 0xFFFF;
+}
+
+TARGET_AVX2 internal COMPARE_TILE(CompareTileAVX2)
+{
+	if (Width != CHANGE_TILE_SIZE)
+	{
+		return CompareTileScalar(Memory, Pitch, Kept, KeptPitch, Width, Height);
+	}
+	
+	__m256i Difference = _mm256_setzero_si256();
+	for (int Y = 0; Y < Height; ++Y)
+	{
+		__m256i *Row     = (__m256i *)(Memory + Y * Pitch);
+		__m256i *KeptRow = (__m256i *)(Kept + Y * KeptPitch);
+		Difference = _mm256_or_si256(Difference, _mm256_xor_si256(_mm256_loadu_si256(Row + 0), _mm256_loadu_si256(KeptRow + 0)));
+		Difference = _mm256_or_si256(Difference, _mm256_xor_si256(_mm256_loadu_si256(Row + 1), _mm256_loadu_si256(KeptRow + 1)));
+	}
+	
+	return !_mm256_testz_si256(Difference, Difference);
+}
+
+#endif
+
+#if defined(SHADE_NEON)
+
+internal COMPARE_TILE(CompareTileNEON)
+{
+	if (Width != CHANGE_TILE_SIZE)
+	{
+		return CompareTileScalar(Memory, Pitch, Kept, KeptPitch, Width, Height);
+	}
+	
+	uint32x4_t Difference = vdupq_n_u32(0);
+	for (int Y = 0; Y < Height; ++Y)
+	{
+		u32 *Row     = (u32 *)(Memory + Y * Pitch);
+		u32 *KeptRow = (u32 *)(Kept + Y * KeptPitch);
+		uint32x4_t Low  = vorrq_u32(veorq_u32(vld1q_u32(Row + 0), vld1q_u32(KeptRow + 0)), veorq_u32(vld1q_u32(Row + 4),  vld1q_u32(KeptRow + 4)));
+		uint32x4_t High = vorrq_u32(veorq_u32(vld1q_u32(Row + 8), vld1q_u32(KeptRow + 8)), veorq_u32(vld1q_u32(Row + 12), vld1q_u32(KeptRow + 12)));
+		Difference = vorrq_u32(Difference, vorrq_u32(Low, High));
+	}
+	
+	return vmaxvq_u32(Difference) != 0;
+}
+
+#endif
+
+// @Note Alongside GetHashTile, NULL if this build or CPU doesn't have it
+internal compare_tile_function *GetCompareTile(shade_kernel Kernel)
+{
+	switch (Kernel)
+	{
+		case ShadeKernel_Scalar: return CompareTileScalar;
+#if defined(SHADE_X86)
+		case ShadeKernel_SSE2: return CompareTileSSE2;
+		case ShadeKernel_AVX2: return CPUHasAVX2() ? CompareTileAVX2 : NULL;
+#endif
+#if defined(SHADE_NEON)
+		case ShadeKernel_NEON: return CompareTileNEON;
+#endif
+		default: return NULL;
+	}
+}
+
+internal void CopyKeptTile(u8 *Memory, int Pitch, u8 *Kept, int KeptPitch, int Width, int Height)
+{
+	for (int Y = 0; Y < Height; ++Y)
+	{
+		CopyBytes(Kept + Y * KeptPitch, Memory + Y * Pitch, (size_t)Width * BITMAP_BYTES_PER_PIXEL);
+	}
+}
+
+//
+// Tiles of the whole texture, an atlas slot's tiles are whichever its boxes touch
+//
+
+struct change_detector
+{
+	platform_allocate_memory *AllocateMemory;
+	platform_free_memory     *FreeMemory;
+	
+	hash_tile_function *HashTile;
+	compare_tile_function *CompareTile;
+	
+	// @Note CHANGE_COMPARE_MAX_PIXELS, zero always hashes
+	u64 MaxComparePixels;
+	
+	int Width;
+	int Height;
+	u32 TilesAcross;
+	u32 TilesDown;
+	
+	// @Note With a kept copy a tile's hash is only UNKNOWN_TILE_HASH or not, the copy says what it held
+	u64 *Hashes;
+	u8 *Kept;
+	
+	// @Note One bit a tile, set for whatever changed since the last ClearChangedTiles
+	u32 *ChangedTiles;
+	
+	u64 HashedTileCount;
+	u64 ChangedTileCount;
+};
+
+inline bool KeepsChangeCopy(change_detector *Detector, int Width, int Height)
+{
+	return (u64)Width * Height <= Detector->MaxComparePixels;
+}
+
+internal size_t GetChangeDetectorSize(change_detector *Detector, int Width, int Height)
+{
+	u32 TileCount = ((u32)(Width + CHANGE_TILE_SIZE - 1) / CHANGE_TILE_SIZE) * ((u32)(Height + CHANGE_TILE_SIZE - 1) / CHANGE_TILE_SIZE);
+	size_t Size = TileCount * sizeof(u64) + ((TileCount + 31) / 32) * sizeof(u32);
+	if (KeepsChangeCopy(Detector, Width, Height))
+	{
+		Size += (size_t)Width * Height * BITMAP_BYTES_PER_PIXEL;
+	}
+	
+	return Size;
+}
+
+internal void InitializeChangeDetector(change_detector *Detector, platform_allocate_memory *AllocateMemory, platform_free_memory *FreeMemory,
+									   shade_kernel Kernel)
+{
+	*Detector = {};
+	Detector->AllocateMemory = AllocateMemory;
+	Detector->FreeMemory     = FreeMemory;
+	Detector->HashTile       = GetHashTile(Kernel) ? GetHashTile(Kernel) : HashTileScalar;
+	Detector->CompareTile    = GetCompareTile(Kernel) ? GetCompareTile(Kernel) : CompareTileScalar;
+	
+	Detector->MaxComparePixels = CHANGE_COMPARE_MAX_PIXELS;
+}
+
+internal void ClearChangedTiles(change_detector *Detector)
+{
+	u32 WordCount = (Detector->TilesAcross * Detector->TilesDown + 31) / 32;
+	for (u32 Word = 0; Word < WordCount; ++Word)
+	{
+		Detector->ChangedTiles[Word] = 0;
+	}
+}
+
+// @Note Whatever the tiles held is forgotten, the next look at any of them finds it changed
+internal void ForgetTileHashes(change_detector *Detector)
+{
+	u32 TileCount = Detector->TilesAcross * Detector->TilesDown;
+	for (u32 Tile = 0; Tile < TileCount; ++Tile)
+	{
+		Detector->Hashes[Tile] = UNKNOWN_TILE_HASH;
+	}
+}
+
+internal void FreeChangeDetector(change_detector *Detector)
+{
+	if (Detector->Hashes)
+	{
+		Detector->FreeMemory(Detector->Hashes, GetChangeDetectorSize(Detector, Detector->Width, Detector->Height));
+	}
+	
+	Detector->Hashes       = NULL;
+	Detector->Kept         = NULL;
+	Detector->ChangedTiles = NULL;
+}
+
+// @Note Allocates only when the texture changes size. Returns false without memory, and then detects nothing.
+internal bool ResizeChangeDetector(change_detector *Detector, int Width, int Height)
+{
+	if ((Detector->Width == Width) && (Detector->Height == Height) && Detector->Hashes)
+	{
+		return true;
+	}
+	
+	FreeChangeDetector(Detector);
+	
+	Detector->Width        = Width;
+	Detector->Height       = Height;
+	Detector->TilesAcross  = (u32)(Width  + CHANGE_TILE_SIZE - 1) / CHANGE_TILE_SIZE;
+	Detector->TilesDown    = (u32)(Height + CHANGE_TILE_SIZE - 1) / CHANGE_TILE_SIZE;
+	
+	u32 TileCount = Detector->TilesAcross * Detector->TilesDown;
+	u8 *Memory = TileCount ? (u8 *)Detector->AllocateMemory(GetChangeDetectorSize(Detector, Width, Height)) : NULL;
+	if (!Memory)
+	{
+		Detector->Width       = 0;
+		Detector->Height      = 0;
+		Detector->TilesAcross = 0;
+		Detector->TilesDown   = 0;
+		return false;
+	}
+	
+	Detector->Hashes       = (u64 *)Memory;
+	Detector->ChangedTiles = (u32 *)(Memory + TileCount * sizeof(u64));
+	
+	// @Note What the copy starts with doesn't matter, every tile is unknown
+	if (KeepsChangeCopy(Detector, Width, Height))
+	{
+		Detector->Kept = (u8 *)(Detector->ChangedTiles + (TileCount + 31) / 32);
+	}
+	
+	ForgetTileHashes(Detector);
+	ClearChangedTiles(Detector);
+	
+	return true;
+}
+
+inline bool TileHasChanged(change_detector *Detector, u32 TileX, u32 TileY)
+{
+	u32 Tile = TileY * Detector->TilesAcross + TileX;
+	return (Detector->ChangedTiles[Tile / 32] >> (Tile % 32)) & 1;
+}
+
+// Hashes every tile of the texture that Region touches, returns how many of them changed
+internal u32 DetectChanges(change_detector *Detector, bitmap *Texture, box Region)
+{
+	if (!Detector->Hashes || (Texture->Width != Detector->Width) || (Texture->Height != Detector->Height))
+	{
+		return 0;
+	}
+	
+	Region = IntersectBoxes(Region, box{ 0, 0, Texture->Width, Texture->Height });
+	if (BoxIsEmpty(Region))
+	{
+		return 0;
+	}
+	
+	u32 FirstX = (u32)Region.Left / CHANGE_TILE_SIZE;
+	u32 FirstY = (u32)Region.Top  / CHANGE_TILE_SIZE;
+	u32 EndX   = (u32)(Region.Right  + CHANGE_TILE_SIZE - 1) / CHANGE_TILE_SIZE;
+	u32 EndY   = (u32)(Region.Bottom + CHANGE_TILE_SIZE - 1) / CHANGE_TILE_SIZE;
+	
+	u32 ChangedCount = 0;
+	for (u32 TileY = FirstY; TileY < EndY; ++TileY)
+	{
+		int Top    = (int)TileY * CHANGE_TILE_SIZE;
+		int Height = Min(Top + CHANGE_TILE_SIZE, Texture->Height) - Top;
+		for (u32 TileX = FirstX; TileX < EndX; ++TileX)
+		{
+			int Left  = (int)TileX * CHANGE_TILE_SIZE;
+			int Width = Min(Left + CHANGE_TILE_SIZE, Texture->Width) - Left;
+			
+			u8 *Memory = Texture->Memory + Top * Texture->Pitch + Left * BITMAP_BYTES_PER_PIXEL;
+			u32 Tile = TileY * Detector->TilesAcross + TileX;
+			
+			bool Changed;
+			if (Detector->Kept)
+			{
+				int KeptPitch = Detector->Width * BITMAP_BYTES_PER_PIXEL;
+				u8 *Kept = Detector->Kept + Top * KeptPitch + Left * BITMAP_BYTES_PER_PIXEL;
+				Changed = Detector->CompareTile(Memory, Texture->Pitch, Kept, KeptPitch, Width, Height);
+				if (Changed)
+				{
+					CopyKeptTile(Memory, Texture->Pitch, Kept, KeptPitch, Width, Height);
+				}
+				
+				Changed |= (Detector->Hashes[Tile] == UNKNOWN_TILE_HASH);
+				Detector->Hashes[Tile] = 1;
+			}
+			else
+			{
+				u64 Hash = Detector->HashTile(Memory, Texture->Pitch, Width, Height);
+				Changed = (Hash != Detector->Hashes[Tile]);
+				Detector->Hashes[Tile] = Hash;
+			}
+			
+			if (Changed)
+			{
+				Detector->ChangedTiles[Tile / 32] |= 1u << (Tile % 32);
+				++ChangedCount;
+			}
+		}
+	}
+	
+	Detector->HashedTileCount  += (EndX - FirstX) * (EndY - FirstY);
+	Detector->ChangedTileCount += ChangedCount;
+	
+	return ChangedCount;
+}
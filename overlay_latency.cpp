@@ -0,0 +1,380 @@
+//
+// Per-stage latency: every thread records into its own ring, a dumper drains them into histograms
+//
+// @Note Recording is a clock read and a store into the thread's own single producer single consumer
+// ring, it never waits on the dumper. A full ring drops the sample and counts it. Durations are
+// nanoseconds from the platform clock, not the overlay_clock, which can be a synthetic one.
+//
+
+enum latency_stage
+{
+	LatencyStage_Acquire,          // Render thread waiting for any output's frame
+	LatencyStage_OutputAcquire,    // A worker waiting for its output's frame
+	LatencyStage_Layout,           // Pieces and atlases
+	LatencyStage_Crop,             // Copies out of the captured surface, CPU side
+	LatencyStage_SwapChainWait,    // Waiting for room in the swap chain
+	LatencyStage_Shade,            // The draw, CPU side
+	LatencyStage_Present,
+	LatencyStage_Gpu,              // Crops and draw on the GPU, from timestamp queries
+	LatencyStage_AcquireToPresent, // A frame with damage from acquired to presented, held back time included
+	
+	LatencyStage_Count,
+};
+
+global const char *LatencyStageNames[LatencyStage_Count] =
+{
+	"acquire", "output_acquire", "layout", "crop", "swap_chain_wait", "shade", "present", "gpu", "acquire_to_present",
+};
+
+//
+// Ring, one per recording thread
+//
+
+#define LATENCY_RING_SIZE 4096 // Must be a power of two
+
+struct latency_sample
+{
+	u32 Stage;
+	u32 Duration; // Nanoseconds, anything over 4 seconds is 4 seconds
+};
+
+struct latency_ring
+{
+	platform_get_nanoseconds *GetNanoseconds;
+	
+	latency_sample Samples[LATENCY_RING_SIZE];
+	
+	// @Note Free running counters, each side only ever writes its own one
+	alignas(64) u32 volatile WriteCount;
+	u32 volatile DroppedCount;
+	alignas(64) u32 volatile ReadCount;
+};
+
+internal void InitializeLatencyRing(latency_ring *Ring, platform_get_nanoseconds *GetNanoseconds)
+{
+	Ring->GetNanoseconds = GetNanoseconds;
+	Ring->WriteCount     = 0;
+	Ring->DroppedCount   = 0;
+	Ring->ReadCount      = 0;
+}
+
+// @Note Producer side
+inline void PushLatencySample(latency_ring *Ring, latency_stage Stage, u64 Duration)
+{
+	u32 WriteCount = Ring->WriteCount;
+	u32 ReadCount  = AtomicLoadU32(&Ring->ReadCount);
+	if ((WriteCount - ReadCount) == LATENCY_RING_SIZE)
+	{
+		AtomicStoreU32(&Ring->DroppedCount, Ring->DroppedCount + 1);
+		return;
+	}
+	
+	latency_sample *Sample = &Ring->Samples[WriteCount & (LATENCY_RING_SIZE - 1)];
+	Sample->Stage    = Stage;
+	Sample->Duration = (u32)Min(Duration, (u64)0xFFFFFFFF);
+	AtomicStoreU32(&Ring->WriteCount, WriteCount + 1);
+}
+
+// @Note Both take a NULL ring, nothing gets recorded then
+inline u64 StartLatency(latency_ring *Ring)
+{
+	return Ring ? Ring->GetNanoseconds() : 0;
+}
+
+inline void EndLatency(latency_ring *Ring, latency_stage Stage, u64 StartTime)
+{
+	if (Ring)
+	{
+		PushLatencySample(Ring, Stage, Ring->GetNanoseconds() - StartTime);
+	}
+}
+
+//
+// Histogram, log linear like HdrHistogram: exact under 32ns, within 1/32 of the value above that
+//
+
+#define LATENCY_SUB_BUCKET_BITS  5
+#define LATENCY_SUB_BUCKET_COUNT (1 << LATENCY_SUB_BUCKET_BITS)
+#define LATENCY_BUCKET_COUNT     ((32 - LATENCY_SUB_BUCKET_BITS + 1) * LATENCY_SUB_BUCKET_COUNT)
+
+struct latency_histogram
+{
+	u64 Count;
+	u64 Total;
+	u32 Min;
+	u32 Max;
+	
+	u32 Buckets[LATENCY_BUCKET_COUNT];
+};
+
+inline u32 FindHighestSetBit(u32 Value)
+{
+#if defined(_MSC_VER)
+	unsigned long Index;
+	_BitScanReverse(&Index, Value);
+	return (u32)Index;
+#else
+	return 31 - (u32)__builtin_clz(Value);
+#endif
+}
+
+inline u32 GetLatencyBucket(u32 Value)
+{
+	if (Value < LATENCY_SUB_BUCKET_COUNT)
+	{
+		return Value;
+	}
+	
+	u32 Shift = FindHighestSetBit(Value) - LATENCY_SUB_BUCKET_BITS;
+	return (Shift + 1) * LATENCY_SUB_BUCKET_COUNT + ((Value >> Shift) - LATENCY_SUB_BUCKET_COUNT);
+}
+
+// @Note The middle of the values that land in the bucket
+inline u32 GetLatencyBucketValue(u32 Bucket)
+{
+	if (Bucket < LATENCY_SUB_BUCKET_COUNT)
+	{
+		return Bucket;
+	}
+	
+	u32 Shift = Bucket / LATENCY_SUB_BUCKET_COUNT - 1;
+	u32 Low   = (LATENCY_SUB_BUCKET_COUNT + Bucket % LATENCY_SUB_BUCKET_COUNT) << Shift;
+	
+	return Low + ((1u << Shift) >> 1);
+}
+
+inline void RecordLatency(latency_histogram *Histogram, u32 Duration)
+{
+	Histogram->Min = Histogram->Count ? Min(Histogram->Min, Duration) : Duration;
+	Histogram->Max = Max(Histogram->Max, Duration);
+	Histogram->Count += 1;
+	Histogram->Total += Duration;
+	
+	++Histogram->Buckets[GetLatencyBucket(Duration)];
+}
+
+// PerTenThousand: 5000 is the median, 9990 is p99.9
+internal u32 GetLatencyPercentile(latency_histogram *Histogram, u32 PerTenThousand)
+{
+	if (Histogram->Count == 0)
+	{
+		return 0;
+	}
+	
+	u64 Target = (Histogram->Count * PerTenThousand + 9999) / 10000;
+	u64 Seen   = 0;
+	for (u32 Bucket = 0; Bucket < LATENCY_BUCKET_COUNT; ++Bucket)
+	{
+		Seen += Histogram->Buckets[Bucket];
+		if (Seen >= Max(Target, (u64)1))
+		{
+			return Max(Histogram->Min, Min(GetLatencyBucketValue(Bucket), Histogram->Max));
+		}
+	}
+	
+	return Histogram->Max;
+}
+
+//
+// Recorder, owned by the dumper
+//
+
+#define MAX_LATENCY_RINGS (MAX_OUTPUTS + 1)
+
+struct latency_recorder
+{
+	u32 RingCount;
+	latency_ring *Rings[MAX_LATENCY_RINGS];
+	
+	latency_histogram Histograms[LatencyStage_Count];
+};
+
+internal void InitializeLatencyRecorder(latency_recorder *Recorder)
+{
+	Recorder->RingCount = 0;
+	for (u32 Stage = 0; Stage < LatencyStage_Count; ++Stage)
+	{
+		latency_histogram *Histogram = &Recorder->Histograms[Stage];
+		Histogram->Count = 0;
+		Histogram->Total = 0;
+		Histogram->Min   = 0;
+		Histogram->Max   = 0;
+		
+		for (u32 Bucket = 0; Bucket < LATENCY_BUCKET_COUNT; ++Bucket)
+		{
+			Histogram->Buckets[Bucket] = 0;
+		}
+	}
+}
+
+// @Note Before the recording thread starts
+internal void AddLatencyRing(latency_recorder *Recorder, latency_ring *Ring)
+{
+	Assert(Recorder->RingCount < MAX_LATENCY_RINGS);
+	Recorder->Rings[Recorder->RingCount++] = Ring;
+}
+
+// @Note Consumer side of every ring. Returns how many samples it took.
+internal u32 DrainLatencyRings(latency_recorder *Recorder)
+{
+	u32 SampleCount = 0;
+	for (u32 RingIndex = 0; RingIndex < Recorder->RingCount; ++RingIndex)
+	{
+		latency_ring *Ring = Recorder->Rings[RingIndex];
+		
+		u32 ReadCount  = Ring->ReadCount;
+		u32 WriteCount = AtomicLoadU32(&Ring->WriteCount);
+		for (; ReadCount != WriteCount; ++ReadCount)
+		{
+			latency_sample Sample = Ring->Samples[ReadCount & (LATENCY_RING_SIZE - 1)];
+			if (Sample.Stage < LatencyStage_Count)
+			{
+				RecordLatency(&Recorder->Histograms[Sample.Stage], Sample.Duration);
+			}
+			
+			++SampleCount;
+		}
+		
+		AtomicStoreU32(&Ring->ReadCount, ReadCount);
+	}
+	
+	return SampleCount;
+}
+
+internal u64 GetDroppedLatencySamples(latency_recorder *Recorder)
+{
+	u64 DroppedCount = 0;
+	for (u32 RingIndex = 0; RingIndex < Recorder->RingCount; ++RingIndex)
+	{
+		DroppedCount += AtomicLoadU32(&Recorder->Rings[RingIndex]->DroppedCount);
+	}
+	
+	return DroppedCount;
+}
+
+//
+// Report, no CRT so no printf
+//
+
+enum latency_format
+{
+	LatencyFormat_CSV,  // One row per stage
+	LatencyFormat_JSON, // Same numbers plus every non-empty bucket
+};
+
+struct text_buffer
+{
+	char *Memory;
+	size_t Size;
+	size_t Used;
+};
+
+// @Note Whatever doesn't fit is cut off
+internal void AppendText(text_buffer *Buffer, const char *Text)
+{
+	for (; *Text && (Buffer->Used < Buffer->Size); ++Text)
+	{
+		Buffer->Memory[Buffer->Used++] = *Text;
+	}
+}
+
+internal void AppendNumber(text_buffer *Buffer, u64 Value)
+{
+	char Digits[20];
+	u32 DigitCount = 0;
+	do
+	{
+		Digits[DigitCount++] = (char)('0' + Value % 10);
+		Value /= 10;
+	} while (Value);
+	
+	while (DigitCount && (Buffer->Used < Buffer->Size))
+	{
+		Buffer->Memory[Buffer->Used++] = Digits[--DigitCount];
+	}
+}
+
+internal void WriteLatencyReport(latency_recorder *Recorder, latency_format Format, text_buffer *Buffer)
+{
+	u32 Percentiles[3] = { 5000, 9900, 9990 };
+	
+	if (Format == LatencyFormat_CSV)
+	{
+		AppendText(Buffer, "stage,count,min_ns,mean_ns,p50_ns,p99_ns,p999_ns,max_ns\n");
+	}
+	else
+	{
+		AppendText(Buffer, "{\n\t\"dropped\": ");
+		AppendNumber(Buffer, GetDroppedLatencySamples(Recorder));
+		AppendText(Buffer, ",\n\t\"stages\": [");
+	}
+	
+	bool First = true;
+	for (u32 Stage = 0; Stage < LatencyStage_Count; ++Stage)
+	{
+		latency_histogram *Histogram = &Recorder->Histograms[Stage];
+		if (Histogram->Count == 0)
+		{
+			continue;
+		}
+		
+		u64 Values[7];
+		Values[0] = Histogram->Count;
+		Values[1] = Histogram->Min;
+		Values[2] = Histogram->Total / Histogram->Count;
+		Values[3] = GetLatencyPercentile(Histogram, Percentiles[0]);
+		Values[4] = GetLatencyPercentile(Histogram, Percentiles[1]);
+		Values[5] = GetLatencyPercentile(Histogram, Percentiles[2]);
+		Values[6] = Histogram->Max;
+		
+		if (Format == LatencyFormat_CSV)
+		{
+			AppendText(Buffer, LatencyStageNames[Stage]);
+			for (u32 ValueIndex = 0; ValueIndex < GetArrayCount(Values); ++ValueIndex)
+			{
+				AppendText(Buffer, ",");
+				AppendNumber(Buffer, Values[ValueIndex]);
+			}
+			AppendText(Buffer, "\n");
+		}
+		else
+		{
+			const char *Keys[7] = { "count", "min_ns", "mean_ns", "p50_ns", "p99_ns", "p999_ns", "max_ns" };
+			
+			AppendText(Buffer, First ? "\n\t\t{ \"stage\": \"" : ",\n\t\t{ \"stage\": \"");
+			AppendText(Buffer, LatencyStageNames[Stage]);
+			AppendText(Buffer, "\"");
+			for (u32 ValueIndex = 0; ValueIndex < GetArrayCount(Values); ++ValueIndex)
+			{
+				AppendText(Buffer, ", \"");
+				AppendText(Buffer, Keys[ValueIndex]);
+				AppendText(Buffer, "\": ");
+				AppendNumber(Buffer, Values[ValueIndex]);
+			}
+			
+			// @Note [middle of the bucket in ns, count] pairs, enough to merge runs or plot the whole distribution
+			AppendText(Buffer, ", \"buckets\": [");
+			bool FirstBucket = true;
+			for (u32 Bucket = 0; Bucket < LATENCY_BUCKET_COUNT; ++Bucket)
+			{
+				if (Histogram->Buckets[Bucket])
+				{
+					AppendText(Buffer, FirstBucket ? "[" : ", [");
+					AppendNumber(Buffer, GetLatencyBucketValue(Bucket));
+					AppendText(Buffer, ", ");
+					AppendNumber(Buffer, Histogram->Buckets[Bucket]);
+					AppendText(Buffer, "]");
+					FirstBucket = false;
+				}
+			}
+			AppendText(Buffer, "] }");
+		}
+		
+		First = false;
+	}
+	
+	if (Format == LatencyFormat_JSON)
+	{
+		AppendText(Buffer, "\n\t]\n}\n");
+	}
+}
@@ -0,0 +1,173 @@
+//
+// Window coordinates -> desktop -> captured surface -> display texture UVs
+//
+// @Note The window thread drags in its own coordinates, which are desktop pixels divided by the
+// DPI scale when the process is not DPI aware. The desktop is what the user sees. The captured
+// surface is the desktop before the output's rotation, that is what DXGI hands us and what the
+// dirty rects are in. The crop stays in surface orientation and the vertex shader turns it upright.
+//
+
+inline bool RotationSwapsAxes(display_rotation Rotation)
+{
+	return (Rotation == DisplayRotation_90) || (Rotation == DisplayRotation_270);
+}
+
+inline display_rotation InvertRotation(display_rotation Rotation)
+{
+	return (display_rotation)((4 - (int)Rotation) & 3);
+}
+
+// @Note Desktop size is the rotated one, same as DXGI_OUTPUT_DESC::DesktopCoordinates
+internal box DesktopToSurfaceBox(box Box, int DesktopWidth, int DesktopHeight, display_rotation Rotation)
+{
+	box Result;
+	switch (Rotation)
+	{
+		case DisplayRotation_90:
+		{
+			Result.Left   = Box.Top;
+			Result.Top    = DesktopWidth - Box.Right;
+			Result.Right  = Box.Bottom;
+			Result.Bottom = DesktopWidth - Box.Left;
+		}
+		break;
+		
+		case DisplayRotation_180:
+		{
+			Result.Left   = DesktopWidth  - Box.Right;
+			Result.Top    = DesktopHeight - Box.Bottom;
+			Result.Right  = DesktopWidth  - Box.Left;
+			Result.Bottom = DesktopHeight - Box.Top;
+		}
+		break;
+		
+		case DisplayRotation_270:
+		{
+			Result.Left   = DesktopHeight - Box.Bottom;
+			Result.Top    = Box.Left;
+			Result.Right  = DesktopHeight - Box.Top;
+			Result.Bottom = Box.Right;
+		}
+		break;
+		
+		default:
+		{
+			Result = Box;
+		}
+		break;
+	}
+	
+	return Result;
+}
+
+internal box SurfaceToDesktopBox(box Box, int DesktopWidth, int DesktopHeight, display_rotation Rotation)
+{
+	// @Note Going back is the opposite turn on a surface whose size is the desktop's with the axes swapped
+	int SurfaceWidth  = RotationSwapsAxes(Rotation) ? DesktopHeight : DesktopWidth;
+	int SurfaceHeight = RotationSwapsAxes(Rotation) ? DesktopWidth  : DesktopHeight;
+	
+	return DesktopToSurfaceBox(Box, SurfaceWidth, SurfaceHeight, InvertRotation(Rotation));
+}
+
+inline int ScaleCoordinate(int Value, float Scale)
+{
+	float Scaled = (float)Value * Scale;
+	return (int)(Scaled + ((Scaled < 0.0f) ? -0.5f : 0.5f));
+}
+
+// @Note Each axis has its own scale, Windows rounds the monitor's width and height each on their own.
+// Going by the width alone loses the bottom row of a 1366x768 monitor at 125%.
+internal box WindowToDesktopBox(box Box, v2 DpiScale)
+{
+	box Result;
+	Result.Left   = ScaleCoordinate(Box.Left,   DpiScale.X);
+	Result.Top    = ScaleCoordinate(Box.Top,    DpiScale.Y);
+	Result.Right  = ScaleCoordinate(Box.Right,  DpiScale.X);
+	Result.Bottom = ScaleCoordinate(Box.Bottom, DpiScale.Y);
+	
+	return Result;
+}
+
+internal uv_transform GetRotationUV(display_rotation Rotation)
+{
+	uv_transform Result;
+	switch (Rotation)
+	{
+		case DisplayRotation_90:
+		{
+			Result.Origin = v2{ 0.0f,  1.0f };
+			Result.AxisX  = v2{ 0.0f, -1.0f };
+			Result.AxisY  = v2{ 1.0f,  0.0f };
+		}
+		break;
+		
+		case DisplayRotation_180:
+		{
+			Result.Origin = v2{  1.0f,  1.0f };
+			Result.AxisX  = v2{ -1.0f,  0.0f };
+			Result.AxisY  = v2{  0.0f, -1.0f };
+		}
+		break;
+		
+		case DisplayRotation_270:
+		{
+			Result.Origin = v2{  1.0f, 0.0f };
+			Result.AxisX  = v2{  0.0f, 1.0f };
+			Result.AxisY  = v2{ -1.0f, 0.0f };
+		}
+		break;
+		
+		default:
+		{
+			Result.Origin = v2{ 0.0f, 0.0f };
+			Result.AxisX  = v2{ 1.0f, 0.0f };
+			Result.AxisY  = v2{ 0.0f, 1.0f };
+		}
+		break;
+	}
+	
+	return Result;
+}
+
+// Physical desktop pixels per window thread coordinate along one axis, from the two views of the same monitor
+inline float GetDpiScale(int DesktopSize, int MonitorSize)
+{
+	return ((DesktopSize > 0) && (MonitorSize > 0)) ? (float)DesktopSize / (float)MonitorSize : 1.0f;
+}
+
+//
+// Everything the crop and the draw need to know about where the cut box is
+//
+// CutBox is in window thread coordinates, DpiScale turns it into desktop pixels. The part of it
+// that is off the desktop is dropped, whatever is left gets stretched over the whole display.
+//
+internal coordinate_mapping MapCoordinates(int DesktopWidth, int DesktopHeight, display_rotation Rotation, v2 DpiScale,
+										   box CutBox, int DisplayWidth, int DisplayHeight)
+{
+	coordinate_mapping Result;
+	
+	box DesktopBox = WindowToDesktopBox(CutBox, DpiScale);
+	DesktopBox = IntersectBoxes(DesktopBox, box{ 0, 0, DesktopWidth, DesktopHeight });
+	if (BoxIsEmpty(DesktopBox))
+	{
+		DesktopBox = box{ 0, 0, 0, 0 };
+	}
+	
+	Result.SurfaceBox    = DesktopToSurfaceBox(DesktopBox, DesktopWidth, DesktopHeight, Rotation);
+	Result.TextureWidth  = Max(GetBoxWidth(Result.SurfaceBox),  1);
+	Result.TextureHeight = Max(GetBoxHeight(Result.SurfaceBox), 1);
+	
+	Result.UV = GetRotationUV(Rotation);
+	
+	Result.TexelsPerPixel.X = (float)GetBoxWidth(DesktopBox)  / (float)Max(DisplayWidth,  1);
+	Result.TexelsPerPixel.Y = (float)GetBoxHeight(DesktopBox) / (float)Max(DisplayHeight, 1);
+	
+	return Result;
+}
+
+inline bool UVTransformsAreEqual(uv_transform A, uv_transform B)
+{
+	return (A.Origin.X == B.Origin.X) && (A.Origin.Y == B.Origin.Y) &&
+		(A.AxisX.X  == B.AxisX.X)  && (A.AxisX.Y  == B.AxisX.Y)  &&
+		(A.AxisY.X  == B.AxisY.X)  && (A.AxisY.Y  == B.AxisY.Y);
+}
@@ -0,0 +1,1694 @@
+//
+// OpenGL compositor: the D3D11 one on GL 3.3 core, so the GPU path runs on any driver down to Mesa's llvmpipe
+//
+// @Note Same atlases, same pool, same single instanced draw of every piece into its overlay's slot of one back
+// buffer, with the shaders translated from the HLSL in win32_d3d11.cpp. The constant buffers are std140 uniform
+// blocks with the same layout. GL puts row 0 at the bottom, we don't: uploads, the display texture and the back
+// buffer all keep row 0 at the top like the desktop does, so clip space y goes down instead of up and a readback
+// is the same bitmap the software compositor draws. With windows every overlay's slot is flipped into its own
+// window on the present, see PresentOpenGLWindows.
+//
+// The captured surface is a bitmap in memory, never a GL texture, so every crop is an upload and there is no Sample.
+//
+// The context is the device. Everything made in it is registered with the device registry, and when the driver resets
+// a context made with robustness the platform makes a new one and everything is made again in it, see
+// RecoverOpenGLContext. A context without robustness never says it was reset and just keeps going.
+//
+
+#include <GL/glcorearb.h>
+
+// @Note Same limit as the D3D11 compositor, GL 3.3 guarantees 1024 but every driver since does 8192 or more
+#define OPENGL_ATLAS_MAX_SIZE 8192
+
+// @Note Same as D3D11_FILTER_MAX_TAPS
+#define OPENGL_FILTER_MAX_TAPS 16
+
+#define OPENGL_SHADER_LOG_SIZE 1024
+
+#define OPENGL_FUNCTIONS(Function) \
+	Function(PFNGLGETERRORPROC,                GetError) \
+	Function(PFNGLGETSTRINGPROC,               GetString) \
+	Function(PFNGLENABLEPROC,                  Enable) \
+	Function(PFNGLDISABLEPROC,                 Disable) \
+	Function(PFNGLVIEWPORTPROC,                Viewport) \
+	Function(PFNGLCLEARCOLORPROC,              ClearColor) \
+	Function(PFNGLCLEARPROC,                   Clear) \
+	Function(PFNGLFLUSHPROC,                   Flush) \
+	Function(PFNGLFINISHPROC,                  Finish) \
+	Function(PFNGLPIXELSTOREIPROC,             PixelStorei) \
+	Function(PFNGLREADPIXELSPROC,              ReadPixels) \
+	Function(PFNGLGENTEXTURESPROC,             GenTextures) \
+	Function(PFNGLDELETETEXTURESPROC,          DeleteTextures) \
+	Function(PFNGLBINDTEXTUREPROC,             BindTexture) \
+	Function(PFNGLACTIVETEXTUREPROC,           ActiveTexture) \
+	Function(PFNGLTEXIMAGE2DPROC,              TexImage2D) \
+	Function(PFNGLTEXSUBIMAGE2DPROC,           TexSubImage2D) \
+	Function(PFNGLTEXPARAMETERIPROC,           TexParameteri) \
+	Function(PFNGLGENERATEMIPMAPPROC,          GenerateMipmap) \
+	Function(PFNGLGENSAMPLERSPROC,             GenSamplers) \
+	Function(PFNGLDELETESAMPLERSPROC,          DeleteSamplers) \
+	Function(PFNGLBINDSAMPLERPROC,             BindSampler) \
+	Function(PFNGLSAMPLERPARAMETERIPROC,       SamplerParameteri) \
+	Function(PFNGLSAMPLERPARAMETERFPROC,       SamplerParameterf) \
+	Function(PFNGLGENFRAMEBUFFERSPROC,         GenFramebuffers) \
+	Function(PFNGLDELETEFRAMEBUFFERSPROC,      DeleteFramebuffers) \
+	Function(PFNGLBINDFRAMEBUFFERPROC,         BindFramebuffer) \
+	Function(PFNGLFRAMEBUFFERTEXTURE2DPROC,    FramebufferTexture2D) \
+	Function(PFNGLCHECKFRAMEBUFFERSTATUSPROC,  CheckFramebufferStatus) \
+	Function(PFNGLBLITFRAMEBUFFERPROC,         BlitFramebuffer) \
+	Function(PFNGLCREATESHADERPROC,            CreateShader) \
+	Function(PFNGLSHADERSOURCEPROC,            ShaderSource) \
+	Function(PFNGLCOMPILESHADERPROC,           CompileShader) \
+	Function(PFNGLGETSHADERIVPROC,             GetShaderiv) \
+	Function(PFNGLGETSHADERINFOLOGPROC,        GetShaderInfoLog) \
+	Function(PFNGLDELETESHADERPROC,            DeleteShader) \
+	Function(PFNGLCREATEPROGRAMPROC,           CreateProgram) \
+	Function(PFNGLATTACHSHADERPROC,            AttachShader) \
+	Function(PFNGLLINKPROGRAMPROC,             LinkProgram) \
+	Function(PFNGLGETPROGRAMIVPROC,            GetProgramiv) \
+	Function(PFNGLGETPROGRAMINFOLOGPROC,       GetProgramInfoLog) \
+	Function(PFNGLDELETEPROGRAMPROC,           DeleteProgram) \
+	Function(PFNGLUSEPROGRAMPROC,              UseProgram) \
+	Function(PFNGLGETUNIFORMLOCATIONPROC,      GetUniformLocation) \
+	Function(PFNGLUNIFORM1IPROC,               Uniform1i) \
+	Function(PFNGLGETUNIFORMBLOCKINDEXPROC,    GetUniformBlockIndex) \
+	Function(PFNGLUNIFORMBLOCKBINDINGPROC,     UniformBlockBinding) \
+	Function(PFNGLGENBUFFERSPROC,              GenBuffers) \
+	Function(PFNGLDELETEBUFFERSPROC,           DeleteBuffers) \
+	Function(PFNGLBINDBUFFERPROC,              BindBuffer) \
+	Function(PFNGLBUFFERDATAPROC,              BufferData) \
+	Function(PFNGLBUFFERSUBDATAPROC,           BufferSubData) \
+	Function(PFNGLBINDBUFFERBASEPROC,          BindBufferBase) \
+	Function(PFNGLGENVERTEXARRAYSPROC,         GenVertexArrays) \
+	Function(PFNGLDELETEVERTEXARRAYSPROC,      DeleteVertexArrays) \
+	Function(PFNGLBINDVERTEXARRAYPROC,         BindVertexArray) \
+	Function(PFNGLDRAWARRAYSINSTANCEDPROC,     DrawArraysInstanced) \
+	Function(PFNGLFENCESYNCPROC,               FenceSync) \
+	Function(PFNGLCLIENTWAITSYNCPROC,          ClientWaitSync) \
+	Function(PFNGLDELETESYNCPROC,              DeleteSync)
+
+// @Note Everything we call, loaded through the platform so nothing here links against libGL
+struct opengl_functions
+{
+#define OPENGL_FUNCTION_MEMBER(Type, Name) Type Name;
+	OPENGL_FUNCTIONS(OPENGL_FUNCTION_MEMBER)
+#undef OPENGL_FUNCTION_MEMBER
+	
+	// @Note NULL unless the context was made to be lost on a reset, nothing else ever reports one
+	PFNGLGETGRAPHICSRESETSTATUSPROC GetGraphicsResetStatus;
+};
+
+// Returns NULL if the current context doesn't have the function
+#define PLATFORM_GET_OPENGL_FUNCTION(Name) void *Name(const char *FunctionName)
+typedef PLATFORM_GET_OPENGL_FUNCTION(platform_get_opengl_function);
+
+// Needs a current context. Returns the name of the first function that isn't there, NULL if they all are.
+// IsRobust is for a context made with GL_LOSE_CONTEXT_ON_RESET, from GL 4.5, GL_KHR_robustness or GL_ARB_robustness.
+internal const char *LoadOpenGLFunctions(opengl_functions *GL, platform_get_opengl_function *GetFunction, bool IsRobust)
+{
+#define OPENGL_FUNCTION_LOAD(Type, Name) \
+	GL->Name = (Type)GetFunction("gl" #Name); \
+	if (!GL->Name) return "gl" #Name;
+	OPENGL_FUNCTIONS(OPENGL_FUNCTION_LOAD)
+#undef OPENGL_FUNCTION_LOAD
+	
+	GL->GetGraphicsResetStatus = NULL;
+	if (IsRobust)
+	{
+		GL->GetGraphicsResetStatus = (PFNGLGETGRAPHICSRESETSTATUSPROC)GetFunction("glGetGraphicsResetStatus");
+		if (!GL->GetGraphicsResetStatus)
+		{
+			GL->GetGraphicsResetStatus = (PFNGLGETGRAPHICSRESETSTATUSPROC)GetFunction("glGetGraphicsResetStatusARB");
+		}
+	}
+	
+	return NULL;
+}
+
+// Makes a new context current on the render thread and loads it into the platform's functions, the ones the
+// compositor has. Returns false if there isn't one to be had, the driver can still be coming back from a reset.
+#define PLATFORM_OPEN_OPENGL_CONTEXT(Name) bool Name(void *Platform)
+typedef PLATFORM_OPEN_OPENGL_CONTEXT(platform_open_opengl_context);
+
+// Let go of the context, the compositor let go of everything it made in it first
+#define PLATFORM_CLOSE_OPENGL_CONTEXT(Name) void Name(void *Platform)
+typedef PLATFORM_CLOSE_OPENGL_CONTEXT(platform_close_opengl_context);
+
+// Makes overlay WindowIndex's window Width by Height, shows it and makes it what framebuffer 0 draws into. A 0 by 0
+// window is hidden. Returns false when there is nothing to draw into, hidden or not made.
+#define PLATFORM_SELECT_OPENGL_WINDOW(Name) bool Name(void *Platform, u32 WindowIndex, int Width, int Height)
+typedef PLATFORM_SELECT_OPENGL_WINDOW(platform_select_opengl_window);
+
+// Puts what was drawn into the selected window on screen. Returns false if the context was lost on the way.
+#define PLATFORM_SWAP_OPENGL_WINDOW(Name) bool Name(void *Platform, u32 WindowIndex)
+typedef PLATFORM_SWAP_OPENGL_WINDOW(platform_swap_opengl_window);
+
+// @Note What the compositor needs from the platform to get a context, and another one after a reset. The window
+// hooks are NULL when headless, the back buffer is then only ever read back.
+struct opengl_platform
+{
+	void *Context;
+	opengl_functions *GL;
+	platform_get_nanoseconds *GetNanoseconds;
+	
+	platform_open_opengl_context  *OpenContext;
+	platform_close_opengl_context *CloseContext;
+	
+	platform_select_opengl_window *SelectWindow;
+	platform_swap_opengl_window   *SwapWindow;
+};
+
+// @Note Registry order, see InitializeOpenGLCompositor
+enum opengl_resource
+{
+	OpenGLResource_Context,
+	OpenGLResource_Programs,
+	OpenGLResource_Samplers,
+	OpenGLResource_Buffers,
+	OpenGLResource_DisplayTexture,
+	OpenGLResource_BackBuffer,
+	OpenGLResource_Bindings,
+};
+
+struct opengl_compositor
+{
+	opengl_functions *GL;
+	opengl_platform *Platform;
+	
+	// @Note Everything below that is made in the context, and how, see RecoverOpenGLContext
+	device_registry Registry;
+	bool ContextIsLost;
+	bool ContextWasRebuilt;
+	
+	// @Note Every piece of a cut box has its slot in the one display texture, sized to the crop atlas. These come
+	// out of the pool and go back into it, each with the framebuffer an HDR crop draws into it through.
+	atlas_layout CropAtlas;
+	texture_pool TexturePool;
+	GLuint DisplayTexture;
+	GLuint DisplayTextureTarget;
+	int TextureWidth;
+	int TextureHeight;
+	
+	// @Note Every overlay draws into its slot of the one back buffer, just big enough for the display atlas.
+	// A plain texture, the windows are not its swap chain, their slots are copied into them on the present.
+	atlas_layout DisplayAtlas;
+	u32 WindowCount;
+	GLuint BackBuffer;
+	GLuint BackBufferTarget;
+	int BackBufferWidth;
+	int BackBufferHeight;
+	
+	// @Note Empty, core profile wants one bound to draw and the corners come from gl_VertexID
+	GLuint VertexArray;
+	
+	// @Note A PixelMain and a sampler for every scaling mode, the shade uses whichever the state asks for
+	GLuint ShadePrograms[ScaleMode_Count];
+	GLuint Samplers[ScaleMode_Count];
+	GLuint InstanceBuffer;
+	
+	// @Note Linked the first time a shade draws with their key. Their parameters are in the effect buffer, which is
+	// only uploaded again when they change.
+	GLuint EffectPrograms[EffectKey_Count];
+	GLuint EffectBuffer;
+	effect_constants Effects;
+	bool EffectsAreStale;
+	
+	// @Note Set by every crop, the mip chain is only generated for a shade that samples it
+	bool MipsAreStale;
+	
+	// @Note An HDR crop uploads its regions into the source texture, as big as the surface so texel and surface
+	// pixel are the same, then draws them into the display texture. One program per source format, 0 for BGRA8.
+	GLuint ConvertPrograms[SurfaceFormat_Count];
+	GLuint ConvertBuffer;
+	GLuint ConvertSource;
+	surface_format ConvertSourceFormat;
+	int ConvertSourceWidth;
+	int ConvertSourceHeight;
+	
+	// @Note What the instance buffer holds, only uploaded again when this changes
+	u32 InstanceCount;
+	overlay_instance Instances[MAX_CROP_PIECES];
+	
+	// @Note Signalled when the GPU is done with the last present, at most one frame is queued
+	GLsync PresentFence;
+	
+	// @Note What InitializeOpenGLCompositor couldn't make, the registry's name for it, and the compiler's say on it
+	const char *FailedName;
+	char ShaderLog[OPENGL_SHADER_LOG_SIZE];
+	
+	compositor_memory  Memory;
+	compositor_traffic Traffic;
+	u64 PresentCount;
+};
+
+inline GLuint GetPooledName(void *Handle)
+{
+	return (GLuint)(uintptr_t)Handle;
+}
+
+// @Note Returns false on GL_OUT_OF_MEMORY, or anything else the last calls ran into
+internal bool OpenGLCallsWentThrough(opengl_functions *GL)
+{
+	bool WentThrough = true;
+	while (GL->GetError() != GL_NO_ERROR)
+	{
+		WentThrough = false;
+	}
+	
+	return WentThrough;
+}
+
+internal TEXTURE_POOL_CREATE(OpenGLCreateTexture)
+{
+	opengl_compositor *Compositor = (opengl_compositor *)Context;
+	opengl_functions *GL = Compositor->GL;
+	OpenGLCallsWentThrough(GL);
+	
+	// @Note sRGB like the D3D11 views, the shade samples linear light and the mips and filters average in it.
+	// GenerateMipmap makes the chain for ScaleMode_Mip the first time it is asked for, the pool counts it from the start.
+	GLuint DisplayTexture;
+	GL->GenTextures(1, &DisplayTexture);
+	GL->ActiveTexture(GL_TEXTURE0);
+	GL->BindTexture(GL_TEXTURE_2D, DisplayTexture);
+	GL->TexImage2D(GL_TEXTURE_2D, 0, GL_SRGB8_ALPHA8, Texture->Width, Texture->Height, 0, GL_BGRA, GL_UNSIGNED_BYTE, NULL);
+	
+	GLuint TextureTarget;
+	GL->GenFramebuffers(1, &TextureTarget);
+	GL->BindFramebuffer(GL_FRAMEBUFFER, TextureTarget);
+	GL->FramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, DisplayTexture, 0);
+	
+	bool IsComplete = (GL->CheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+	GL->BindFramebuffer(GL_FRAMEBUFFER, 0);
+	
+	if (!OpenGLCallsWentThrough(GL) || !IsComplete)
+	{
+		GL->DeleteFramebuffers(1, &TextureTarget);
+		GL->DeleteTextures(1, &DisplayTexture);
+		return false;
+	}
+	
+	Texture->Handle = (void *)(uintptr_t)DisplayTexture;
+	Texture->View   = NULL;
+	Texture->Target = (void *)(uintptr_t)TextureTarget;
+	
+	return true;
+}
+
+internal TEXTURE_POOL_DESTROY(OpenGLDestroyTexture)
+{
+	opengl_compositor *Compositor = (opengl_compositor *)Context;
+	
+	GLuint TextureTarget  = GetPooledName(Texture->Target);
+	GLuint DisplayTexture = GetPooledName(Texture->Handle);
+	Compositor->GL->DeleteFramebuffers(1, &TextureTarget);
+	Compositor->GL->DeleteTextures(1, &DisplayTexture);
+}
+
+internal void UpdateOpenGLMemory(opengl_compositor *Compositor)
+{
+	texture_pool *Pool = &Compositor->TexturePool;
+	compositor_memory *Memory = &Compositor->Memory;
+	
+	Memory->TextureBytes           = GetTextureBytes(Pool, Compositor->TextureWidth, Compositor->TextureHeight);
+	Memory->PooledBytes            = Pool->PooledBytes;
+	Memory->SwapChainBytes         = (u64)Compositor->BackBufferWidth * Compositor->BackBufferHeight * 4;
+	Memory->TextureAllocationCount = Pool->AllocationCount;
+	Memory->TextureReuseCount      = Pool->ReuseCount;
+}
+
+internal bool ResizeDisplayTexture(opengl_compositor *Compositor, int Width, int Height)
+{
+	if ((Compositor->TextureWidth == Width) && (Compositor->TextureHeight == Height))
+	{
+		return true;
+	}
+	
+	pooled_texture *Texture = GetPooledTexture(&Compositor->TexturePool, Width, Height);
+	if (!Texture)
+	{
+		Compositor->DisplayTexture       = 0;
+		Compositor->DisplayTextureTarget = 0;
+		Compositor->TextureWidth         = 0;
+		Compositor->TextureHeight        = 0;
+		
+		UpdateOpenGLMemory(Compositor);
+		return false;
+	}
+	
+	Compositor->DisplayTexture       = GetPooledName(Texture->Handle);
+	Compositor->DisplayTextureTarget = GetPooledName(Texture->Target);
+	Compositor->TextureWidth         = Width;
+	Compositor->TextureHeight        = Height;
+	
+	UpdateOpenGLMemory(Compositor);
+	return true;
+}
+
+// @Note Same as ResizeBuffers, the old contents are gone and the whole thing gets cleared on the next draw anyway
+internal bool ResizeBackBuffer(opengl_compositor *Compositor, int Width, int Height)
+{
+	opengl_functions *GL = Compositor->GL;
+	if ((Compositor->BackBufferWidth == Width) && (Compositor->BackBufferHeight == Height))
+	{
+		return true;
+	}
+	
+	if (Compositor->BackBuffer)
+	{
+		GL->DeleteFramebuffers(1, &Compositor->BackBufferTarget);
+		GL->DeleteTextures(1, &Compositor->BackBuffer);
+		Compositor->BackBufferTarget = 0;
+		Compositor->BackBuffer       = 0;
+		++Compositor->Memory.SwapChainResizeCount;
+	}
+	
+	Compositor->BackBufferWidth  = 0;
+	Compositor->BackBufferHeight = 0;
+	OpenGLCallsWentThrough(GL);
+	
+	// @Note Not sRGB, PixelMain encodes itself so it can premultiply after the encode the way DWM blends
+	GLuint BackBuffer;
+	GL->GenTextures(1, &BackBuffer);
+	GL->ActiveTexture(GL_TEXTURE0);
+	GL->BindTexture(GL_TEXTURE_2D, BackBuffer);
+	GL->TexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, Width, Height, 0, GL_BGRA, GL_UNSIGNED_BYTE, NULL);
+	
+	GLuint BackBufferTarget;
+	GL->GenFramebuffers(1, &BackBufferTarget);
+	GL->BindFramebuffer(GL_FRAMEBUFFER, BackBufferTarget);
+	GL->FramebufferTexture2D(GL_FRAMEBUFFER, GL_COLOR_ATTACHMENT0, GL_TEXTURE_2D, BackBuffer, 0);
+	
+	bool IsComplete = (GL->CheckFramebufferStatus(GL_FRAMEBUFFER) == GL_FRAMEBUFFER_COMPLETE);
+	GL->BindFramebuffer(GL_FRAMEBUFFER, 0);
+	
+	if (!OpenGLCallsWentThrough(GL) || !IsComplete)
+	{
+		GL->DeleteFramebuffers(1, &BackBufferTarget);
+		GL->DeleteTextures(1, &BackBuffer);
+		UpdateOpenGLMemory(Compositor);
+		
+		return false;
+	}
+	
+	Compositor->BackBuffer       = BackBuffer;
+	Compositor->BackBufferTarget = BackBufferTarget;
+	Compositor->BackBufferWidth  = Width;
+	Compositor->BackBufferHeight = Height;
+	
+	UpdateOpenGLMemory(Compositor);
+	return true;
+}
+
+//
+// Shaders
+//
+
+// @Note Translated from the HLSL in LoadD3D11Shaders line for line, both stages are in the one source.
+// Same defines too, plus VERTEX_SHADER and VARYING for the stage.
+global const char OpenGLShadeSource[] =
+R"RAW(
+					struct Instance
+					{
+						vec4  Destination; // Display slot in clip space, left top right bottom
+						vec4  UVClamp;     // Crop slot in the atlas, half a texel in from the edges
+						vec2  UVOrigin;
+						vec2  UVAxisX;
+						vec2  UVAxisY;
+						float Decode;      // 1 for the desktop itself, never the case here
+						float Pad;
+					};
+
+					layout(std140) uniform CBuffer { Instance Instances[MAX_INSTANCES]; };
+
+					// Same as effect_constants, the colours are in linear light
+					layout(std140) uniform Effects
+					{
+						float Alpha;
+						float Darken;
+						float Contrast;
+						float EdgeStrength;
+						vec4  EdgeColour;
+						vec3  KeyColour;
+						float KeyTolerance;
+					};
+
+					VARYING vec2 Tex;
+					flat VARYING vec4 Clamp;
+					flat VARYING float Decode;
+
+					#if VERTEX_SHADER
+
+					// Two triangles per piece, corner bit 0 is right and bit 1 is bottom
+					const uint Corners[6] = uint[6](0u, 1u, 2u, 2u, 1u, 3u);
+
+					void main()
+					{
+						Instance Overlay = Instances[gl_InstanceID];
+						uint Corner = Corners[gl_VertexID];
+
+						// Display position, 0..1 from the top-left
+						vec2 Display;
+						Display.x = float(Corner & 1u);
+						Display.y = float(Corner >> 1u);
+
+						gl_Position = vec4(mix(Overlay.Destination.xy, Overlay.Destination.zw, Display), 0.0f, 1.0f);
+
+						// Turn the crop upright, it is in the output's native orientation
+						Tex    = Overlay.UVOrigin + Display.x * Overlay.UVAxisX + Display.y * Overlay.UVAxisY;
+						Clamp  = Overlay.UVClamp;
+						Decode = Overlay.Decode;
+					}
+
+					#else
+
+					uniform sampler2D Texture;
+
+					out vec4 Target;
+
+					// Exact, same curve as SRGBToLinear in overlay_colour.cpp
+					vec3 SRGBToLinear(vec3 Encoded)
+					{
+						vec3 Low  = Encoded / 12.92f;
+						vec3 High = pow((Encoded + 0.055f) / 1.055f, vec3(2.4f));
+						return mix(High, Low, lessThanEqual(Encoded, vec3(0.04045f)));
+					}
+
+					// Same order as scale_mode, SCALE_MODE picks the permutation
+					#define SCALE_BILINEAR 0
+					#define SCALE_NEAREST  1
+					#define SCALE_MIP      2
+					#define SCALE_BICUBIC  3
+					#define SCALE_LANCZOS  4
+
+					#if (SCALE_MODE == SCALE_BICUBIC) || (SCALE_MODE == SCALE_LANCZOS)
+
+					// Same weights as FilterWeight in overlay_scale.cpp
+					#if SCALE_MODE == SCALE_BICUBIC
+					#define FILTER_RADIUS 2.0f
+					float FilterWeight(float X)
+					{
+						X = abs(X);
+						if (X < 1.0f) return (1.5f * X - 2.5f) * X * X + 1.0f;
+						if (X < 2.0f) return ((-0.5f * X + 2.5f) * X - 4.0f) * X + 2.0f;
+						return 0.0f;
+					}
+					#else
+					#define FILTER_RADIUS 3.0f
+					float FilterWeight(float X)
+					{
+						X = abs(X);
+						if (X < 1e-6f) return 1.0f;
+						if (X >= 3.0f) return 0.0f;
+						float PiX = 3.14159265f * X;
+						return 3.0f * sin(PiX) * sin(PiX / 3.0f) / (PiX * PiX);
+					}
+					#endif
+
+					// Every tap of the separable weights, widened when the piece shrinks and kept inside the crop slot
+					vec4 SampleFiltered(vec2 UV, vec4 Clamp, float Decode)
+					{
+						vec2 Size = vec2(textureSize(Texture, 0));
+
+						// Texels a pixel covers along each texture axis, the pieces only ever turn by quarters
+						vec2 Footprint = max(abs(dFdx(UV)), abs(dFdy(UV))) * Size;
+						vec2 Scale   = clamp(Footprint, 1.0f, (FILTER_MAX_TAPS - 1) / (2.0f * FILTER_RADIUS));
+						vec2 Support = FILTER_RADIUS * Scale;
+						vec2 Center  = UV * Size - 0.5f;
+
+						ivec2 Low   = ivec2(ceil(Center - Support));
+						ivec2 High  = ivec2(floor(Center + Support));
+						ivec2 First = ivec2(round(Clamp.xy * Size - 0.5f));
+						ivec2 Last  = ivec2(round(Clamp.zw * Size - 0.5f));
+
+						vec4 Sum = vec4(0.0f);
+						float WeightSum = 0.0f;
+						for (int Y = Low.y; Y <= High.y; ++Y)
+						{
+							float WeightY = FilterWeight((float(Y) - Center.y) / Scale.y);
+							int TexelY = clamp(Y, First.y, Last.y);
+							for (int X = Low.x; X <= High.x; ++X)
+							{
+								float Weight = WeightY * FilterWeight((float(X) - Center.x) / Scale.x);
+								vec4 Texel = texelFetch(Texture, ivec2(clamp(X, First.x, Last.x), TexelY), 0);
+								if (Decode != 0.0f) Texel.rgb = SRGBToLinear(Texel.rgb);
+
+								Sum += Weight * Texel;
+								WeightSum += Weight;
+							}
+						}
+
+						return Sum / WeightSum;
+					}
+
+					#endif
+
+					// Exact, same curve as LinearToSRGB in overlay_colour.cpp
+					vec3 LinearToSRGB(vec3 Linear)
+					{
+						vec3 Low  = Linear * 12.92f;
+						vec3 High = 1.055f * pow(Linear, vec3(1.0f / 2.4f)) - 0.055f;
+						return mix(High, Low, lessThanEqual(Linear, vec3(0.0031308f)));
+					}
+
+					#if EFFECT_KEY
+
+					// Same bits as effect_flag, EFFECT_KEY picks the permutation. Only ever with SCALE_BILINEAR.
+					#define EFFECT_COLOUR_KEY 0x1
+					#define EFFECT_GRAYSCALE  0x2
+					#define EFFECT_CONTRAST   0x4
+					#define EFFECT_EDGES      0x8
+
+					// BT.709, same as EffectLuma in overlay_effects.cpp
+					const vec3 Luma = vec3(0.2126f, 0.7152f, 0.0722f);
+
+					vec3 FetchLinear(ivec2 Texel)
+					{
+						vec3 Colour = texelFetch(Texture, Texel, 0).rgb;
+						return (Decode != 0.0f) ? SRGBToLinear(Colour) : Colour;
+					}
+
+					// The stages in the same order as ShadeRowEffectsScalar, returns 0 for a keyed out pixel
+					float ApplyEffects(inout vec3 Colour)
+					{
+						float Keep = 1.0f;
+						
+						#if (EFFECT_KEY & EFFECT_COLOUR_KEY) != 0
+						vec3 Distance = abs(Colour - KeyColour);
+						Keep = ((Distance.r + Distance.g + Distance.b) < KeyTolerance) ? 0.0f : 1.0f;
+						#endif
+						
+						#if (EFFECT_KEY & EFFECT_GRAYSCALE) != 0
+						Colour = vec3(dot(Colour, Luma));
+						#endif
+						
+						#if (EFFECT_KEY & EFFECT_CONTRAST) != 0
+						Colour = CONTRAST_PIVOT + (Colour - CONTRAST_PIVOT) * Contrast;
+						#endif
+						
+						#if (EFFECT_KEY & EFFECT_EDGES) != 0
+						// The four texels the bilinear sample came from, kept inside the crop slot the same way
+						vec2 Size = vec2(textureSize(Texture, 0));
+						
+						ivec2 Last = ivec2(round(Clamp.zw * Size - 0.5f));
+						ivec2 Low  = ivec2(floor(clamp(Tex, Clamp.xy, Clamp.zw) * Size - 0.5f));
+						ivec2 High = min(Low + 1, Last);
+						
+						float L00 = dot(FetchLinear(ivec2(Low.x,  Low.y)),  Luma);
+						float L10 = dot(FetchLinear(ivec2(High.x, Low.y)),  Luma);
+						float L01 = dot(FetchLinear(ivec2(Low.x,  High.y)), Luma);
+						float L11 = dot(FetchLinear(ivec2(High.x, High.y)), Luma);
+						
+						float GradientX = (L10 - L00) + (L11 - L01);
+						float GradientY = (L01 - L00) + (L11 - L10);
+						Colour += EdgeColour.rgb * ((abs(GradientX) + abs(GradientY)) * EdgeStrength);
+						#endif
+						
+						return Keep;
+					}
+
+					#endif
+
+					void main()
+					{
+						#if (SCALE_MODE == SCALE_BICUBIC) || (SCALE_MODE == SCALE_LANCZOS)
+						vec4 Output = SampleFiltered(Tex, Clamp, Decode);
+						#else
+						// @Note The neighbouring slots in the atlas would bleed in through the filter otherwise
+						vec4 Output = texture(Texture, clamp(Tex, Clamp.xy, Clamp.zw));
+
+						if (Decode != 0.0f) Output.rgb = SRGBToLinear(Output.rgb);
+						#endif
+
+						#if EFFECT_KEY
+						float Keep = ApplyEffects(Output.rgb);
+						#else
+						float Keep = 1.0f;
+						#endif
+
+						// The texture is sRGB so this is linear light. Darkened there, then encoded and premultiplied
+						// since DWM blends in gamma space, same as ShadeChannel in overlay_shade.cpp.
+						Output.rgb = LinearToSRGB(clamp(Output.rgb - Darken, 0.0f, 1.0f)) * (Alpha * Keep);
+						Output.a   = Alpha * Keep;
+
+						Target = Output;
+					}
+
+					#endif
+				)RAW";
+
+// @Note Draws the regions of an HDR crop into the display texture, which encodes to sRGB on the write with
+// GL_FRAMEBUFFER_SRGB, see ConvertCrop. The pixels land one to one, texelFetch reads the surface texel under each.
+global const char OpenGLConvertSource[] =
+R"RAW(
+					layout(std140) uniform CBuffer
+					{
+						vec4 Regions[MAX_REGIONS]; // Surface pixels, left top right bottom
+						vec4 Target;               // xy from a surface pixel to its display texel, zw texels to clip space
+						vec4 Convert;              // x puts SDR white on 1.0
+						vec4 Mix[3];               // BT.2020 to BT.709
+					};
+
+					#if VERTEX_SHADER
+
+					const uint Corners[6] = uint[6](0u, 1u, 2u, 2u, 1u, 3u);
+
+					void main()
+					{
+						vec4 Region = Regions[gl_InstanceID];
+						uint Corner = Corners[gl_VertexID];
+
+						vec2 Texel;
+						Texel.x = ((Corner & 1u)  != 0u) ? Region.z : Region.x;
+						Texel.y = ((Corner >> 1u) != 0u) ? Region.w : Region.y;
+						Texel  += Target.xy;
+
+						// Row 0 at the top, see the top of overlay_opengl.cpp
+						gl_Position = vec4(Texel.x * Target.z - 1.0f, Texel.y * Target.w - 1.0f, 0.0f, 1.0f);
+					}
+
+					#else
+
+					uniform sampler2D Desktop;
+
+					out vec4 Output;
+
+					// Same order as surface_format, COLOUR_SOURCE picks the permutation
+					#define COLOUR_SCRGB 1
+					#define COLOUR_PQ    2
+
+					void main()
+					{
+						vec3 Colour = texelFetch(Desktop, ivec2(gl_FragCoord.xy - Target.xy), 0).rgb;
+
+						#if COLOUR_SOURCE == COLOUR_PQ
+						// Same as PQToLinear, then into BT.709 primaries
+						vec3 Power = pow(clamp(Colour, 0.0f, 1.0f), vec3(1.0f / PQ_M2));
+						Colour = pow(max(Power - PQ_C1, 0.0f) / (PQ_C2 - PQ_C3 * Power), vec3(1.0f / PQ_M1)) * Convert.x;
+						Colour = vec3(dot(Mix[0].xyz, Colour), dot(Mix[1].xyz, Colour), dot(Mix[2].xyz, Colour));
+						#else
+						Colour *= Convert.x;
+						#endif
+
+						// Same as ToneMapPixel, the hue stays and the brightest channel rolls off past the knee
+						Colour = max(Colour, 0.0f);
+						float Peak = max(max(Colour.r, Colour.g), Colour.b);
+						if (Peak > TONE_MAP_KNEE)
+						{
+							float Over = (Peak - TONE_MAP_KNEE) / (1.0f - TONE_MAP_KNEE);
+							Colour *= (TONE_MAP_KNEE + (1.0f - TONE_MAP_KNEE) * (Over / (1.0f + Over))) / Peak;
+						}
+
+						// The target is sRGB, the encode is done on the write
+						Output = vec4(min(Colour, 1.0f), 1.0f);
+					}
+
+					#endif
+				)RAW";
+
+global const char *OpenGLShadeDefines =
+	"#define MAX_INSTANCES "   STRINGIFY(MAX_CROP_PIECES) "\n"
+	"#define FILTER_MAX_TAPS " STRINGIFY(OPENGL_FILTER_MAX_TAPS) "\n"
+	"#define CONTRAST_PIVOT "  STRINGIFY(EFFECT_CONTRAST_PIVOT) "\n";
+
+global const char *OpenGLScaleModeDefines[ScaleMode_Count] =
+{
+	"#define SCALE_MODE 0\n#define EFFECT_KEY 0\n",
+	"#define SCALE_MODE 1\n#define EFFECT_KEY 0\n",
+	"#define SCALE_MODE 2\n#define EFFECT_KEY 0\n",
+	"#define SCALE_MODE 3\n#define EFFECT_KEY 0\n",
+	"#define SCALE_MODE 4\n#define EFFECT_KEY 0\n",
+};
+
+// @Note The bilinear permutation with an effect chain, nothing for key 0 since that is ShadePrograms[0]
+global const char *OpenGLEffectKeyDefines[EffectKey_Count] =
+{
+	NULL,
+	"#define SCALE_MODE 0\n#define EFFECT_KEY 1\n",
+	"#define SCALE_MODE 0\n#define EFFECT_KEY 2\n",
+	"#define SCALE_MODE 0\n#define EFFECT_KEY 3\n",
+	"#define SCALE_MODE 0\n#define EFFECT_KEY 4\n",
+	"#define SCALE_MODE 0\n#define EFFECT_KEY 5\n",
+	"#define SCALE_MODE 0\n#define EFFECT_KEY 6\n",
+	"#define SCALE_MODE 0\n#define EFFECT_KEY 7\n",
+	"#define SCALE_MODE 0\n#define EFFECT_KEY 8\n",
+	"#define SCALE_MODE 0\n#define EFFECT_KEY 9\n",
+	"#define SCALE_MODE 0\n#define EFFECT_KEY 10\n",
+	"#define SCALE_MODE 0\n#define EFFECT_KEY 11\n",
+	"#define SCALE_MODE 0\n#define EFFECT_KEY 12\n",
+	"#define SCALE_MODE 0\n#define EFFECT_KEY 13\n",
+	"#define SCALE_MODE 0\n#define EFFECT_KEY 14\n",
+	"#define SCALE_MODE 0\n#define EFFECT_KEY 15\n",
+};
+
+global const char *OpenGLConvertDefines =
+	"#define MAX_REGIONS "   STRINGIFY(CONVERT_MAX_REGIONS) "\n"
+	"#define TONE_MAP_KNEE " STRINGIFY(TONE_MAP_KNEE) "\n"
+	"#define PQ_M1 "         STRINGIFY(PQ_M1) "\n"
+	"#define PQ_M2 "         STRINGIFY(PQ_M2) "\n"
+	"#define PQ_C1 "         STRINGIFY(PQ_C1) "\n"
+	"#define PQ_C2 "         STRINGIFY(PQ_C2) "\n"
+	"#define PQ_C3 "         STRINGIFY(PQ_C3) "\n";
+
+global const char *OpenGLColourSourceDefines[SurfaceFormat_Count] =
+{
+	NULL,
+	"#define COLOUR_SOURCE 1\n",
+	"#define COLOUR_SOURCE 2\n",
+};
+
+// @Note Returns 0 with the compiler's log in ShaderLog if it doesn't compile
+internal GLuint CompileOpenGLShader(opengl_compositor *Compositor, GLenum Stage, const char *Defines, const char *Permutation,
+									const char *Source)
+{
+	opengl_functions *GL = Compositor->GL;
+	
+	const char *Sources[4];
+	Sources[0] = (Stage == GL_VERTEX_SHADER) ?
+		"#version 330 core\n#define VERTEX_SHADER 1\n#define VARYING out\n" :
+		"#version 330 core\n#define VERTEX_SHADER 0\n#define VARYING in\n";
+	Sources[1] = Defines;
+	Sources[2] = Permutation;
+	Sources[3] = Source;
+	
+	GLuint Shader = GL->CreateShader(Stage);
+	GL->ShaderSource(Shader, 4, Sources, NULL);
+	GL->CompileShader(Shader);
+	
+	GLint IsCompiled;
+	GL->GetShaderiv(Shader, GL_COMPILE_STATUS, &IsCompiled);
+	if (!IsCompiled)
+	{
+		GL->GetShaderInfoLog(Shader, sizeof(Compositor->ShaderLog), NULL, Compositor->ShaderLog);
+		GL->DeleteShader(Shader);
+		return 0;
+	}
+	
+	return Shader;
+}
+
+// @Note The uniform block is bound to BlockBinding and the one texture to TextureUnit, nothing else gets set later
+internal GLuint LinkOpenGLProgram(opengl_compositor *Compositor, const char *Defines, const char *Permutation, const char *Source,
+								  const char *TextureName, GLint TextureUnit, GLuint BlockBinding)
+{
+	opengl_functions *GL = Compositor->GL;
+	
+	GLuint VertexShader = CompileOpenGLShader(Compositor, GL_VERTEX_SHADER, Defines, Permutation, Source);
+	if (!VertexShader)
+	{
+		return 0;
+	}
+	
+	GLuint PixelShader = CompileOpenGLShader(Compositor, GL_FRAGMENT_SHADER, Defines, Permutation, Source);
+	if (!PixelShader)
+	{
+		GL->DeleteShader(VertexShader);
+		return 0;
+	}
+	
+	GLuint Program = GL->CreateProgram();
+	GL->AttachShader(Program, VertexShader);
+	GL->AttachShader(Program, PixelShader);
+	GL->LinkProgram(Program);
+	
+	// @Note Flagged for deletion, they go with the program
+	GL->DeleteShader(VertexShader);
+	GL->DeleteShader(PixelShader);
+	
+	GLint IsLinked;
+	GL->GetProgramiv(Program, GL_LINK_STATUS, &IsLinked);
+	if (!IsLinked)
+	{
+		GL->GetProgramInfoLog(Program, sizeof(Compositor->ShaderLog), NULL, Compositor->ShaderLog);
+		GL->DeleteProgram(Program);
+		return 0;
+	}
+	
+	GL->UniformBlockBinding(Program, GL->GetUniformBlockIndex(Program, "CBuffer"), BlockBinding);
+	GL->UseProgram(Program);
+	GL->Uniform1i(GL->GetUniformLocation(Program, TextureName), TextureUnit);
+	
+	return Program;
+}
+
+//
+// Setup
+//
+
+// @Note Texture units and uniform block bindings, each program only ever uses its own
+#define OPENGL_SHADE_TEXTURE_UNIT   0
+#define OPENGL_CONVERT_TEXTURE_UNIT 1
+#define OPENGL_SHADE_BINDING        0
+#define OPENGL_CONVERT_BINDING      1
+#define OPENGL_EFFECT_BINDING       2
+
+// @Note The shade programs have the effect block as well as the instances
+internal GLuint LinkOpenGLShadeProgram(opengl_compositor *Compositor, const char *Permutation)
+{
+	opengl_functions *GL = Compositor->GL;
+	
+	GLuint Program = LinkOpenGLProgram(Compositor, OpenGLShadeDefines, Permutation, OpenGLShadeSource, "Texture",
+									   OPENGL_SHADE_TEXTURE_UNIT, OPENGL_SHADE_BINDING);
+	if (Program)
+	{
+		GL->UniformBlockBinding(Program, GL->GetUniformBlockIndex(Program, "Effects"), OPENGL_EFFECT_BINDING);
+	}
+	
+	return Program;
+}
+
+//
+// Context resources, registered by InitializeOpenGLCompositor in this order
+//
+// @Note Every create cleans up after itself when it fails half way, the registry only releases what was made. Deleting
+// in a context that was lost is fine, GL just ignores it.
+//
+
+internal DEVICE_RESOURCE_CREATE(OpenGLOpenContext)
+{
+	opengl_compositor *Compositor = (opengl_compositor *)Context;
+	opengl_platform *Platform = Compositor->Platform;
+	
+	return Platform->OpenContext(Platform->Context);
+}
+
+internal DEVICE_RESOURCE_RELEASE(OpenGLCloseContext)
+{
+	opengl_compositor *Compositor = (opengl_compositor *)Context;
+	opengl_platform *Platform = Compositor->Platform;
+	
+	// @Note The fence belongs to the context, and one that was lost never signals it
+	if (Compositor->PresentFence)
+	{
+		Compositor->GL->DeleteSync(Compositor->PresentFence);
+		Compositor->PresentFence = NULL;
+	}
+	
+	Platform->CloseContext(Platform->Context);
+}
+
+internal DEVICE_RESOURCE_RELEASE(OpenGLReleasePrograms)
+{
+	opengl_compositor *Compositor = (opengl_compositor *)Context;
+	opengl_functions *GL = Compositor->GL;
+	
+	for (int Mode = 0; Mode < ScaleMode_Count; ++Mode)
+	{
+		if (Compositor->ShadePrograms[Mode])
+		{
+			GL->DeleteProgram(Compositor->ShadePrograms[Mode]);
+			Compositor->ShadePrograms[Mode] = 0;
+		}
+	}
+	
+	for (u32 Key = 0; Key < EffectKey_Count; ++Key)
+	{
+		if (Compositor->EffectPrograms[Key])
+		{
+			GL->DeleteProgram(Compositor->EffectPrograms[Key]);
+			Compositor->EffectPrograms[Key] = 0;
+		}
+	}
+	
+	for (int Format = 0; Format < SurfaceFormat_Count; ++Format)
+	{
+		if (Compositor->ConvertPrograms[Format])
+		{
+			GL->DeleteProgram(Compositor->ConvertPrograms[Format]);
+			Compositor->ConvertPrograms[Format] = 0;
+		}
+	}
+}
+
+// @Note The effect chains are only linked when a shade first draws with them, see GetOpenGLEffectProgram
+internal DEVICE_RESOURCE_CREATE(OpenGLCreatePrograms)
+{
+	opengl_compositor *Compositor = (opengl_compositor *)Context;
+	
+	for (int Mode = 0; Mode < ScaleMode_Count; ++Mode)
+	{
+		Compositor->ShadePrograms[Mode] = LinkOpenGLShadeProgram(Compositor, OpenGLScaleModeDefines[Mode]);
+		if (!Compositor->ShadePrograms[Mode])
+		{
+			OpenGLReleasePrograms(Context, Resource);
+			return false;
+		}
+	}
+	
+	for (int Format = SurfaceFormat_RGBA16F; Format < SurfaceFormat_Count; ++Format)
+	{
+		Compositor->ConvertPrograms[Format] = LinkOpenGLProgram(Compositor, OpenGLConvertDefines, OpenGLColourSourceDefines[Format], OpenGLConvertSource,
+																"Desktop", OPENGL_CONVERT_TEXTURE_UNIT, OPENGL_CONVERT_BINDING);
+		if (!Compositor->ConvertPrograms[Format])
+		{
+			OpenGLReleasePrograms(Context, Resource);
+			return false;
+		}
+	}
+	
+	return true;
+}
+
+internal DEVICE_RESOURCE_RELEASE(OpenGLReleaseSamplers)
+{
+	opengl_compositor *Compositor = (opengl_compositor *)Context;
+	
+	Compositor->GL->DeleteSamplers(ScaleMode_Count, Compositor->Samplers);
+	for (int Mode = 0; Mode < ScaleMode_Count; ++Mode)
+	{
+		Compositor->Samplers[Mode] = 0;
+	}
+}
+
+// @Note Same filters as the D3D11 sampler descs, bicubic and Lanczos only ever texelFetch
+internal DEVICE_RESOURCE_CREATE(OpenGLCreateSamplers)
+{
+	opengl_compositor *Compositor = (opengl_compositor *)Context;
+	opengl_functions *GL = Compositor->GL;
+	
+	GLint MinFilters[ScaleMode_Count] = { GL_LINEAR, GL_NEAREST, GL_LINEAR_MIPMAP_LINEAR, GL_NEAREST, GL_NEAREST };
+	GLint MagFilters[ScaleMode_Count] = { GL_LINEAR, GL_NEAREST, GL_LINEAR,               GL_NEAREST, GL_NEAREST };
+	GL->GenSamplers(ScaleMode_Count, Compositor->Samplers);
+	for (int Mode = 0; Mode < ScaleMode_Count; ++Mode)
+	{
+		GLuint Sampler = Compositor->Samplers[Mode];
+		GL->SamplerParameteri(Sampler, GL_TEXTURE_MIN_FILTER, MinFilters[Mode]);
+		GL->SamplerParameteri(Sampler, GL_TEXTURE_MAG_FILTER, MagFilters[Mode]);
+		GL->SamplerParameteri(Sampler, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+		GL->SamplerParameteri(Sampler, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+		GL->SamplerParameterf(Sampler, GL_TEXTURE_MAX_LOD, (Mode == ScaleMode_Mip) ? 1000.0f : 0.0f);
+	}
+	
+	if (!OpenGLCallsWentThrough(GL))
+	{
+		OpenGLReleaseSamplers(Context, Resource);
+		return false;
+	}
+	
+	return true;
+}
+
+internal DEVICE_RESOURCE_RELEASE(OpenGLReleaseBuffers)
+{
+	opengl_compositor *Compositor = (opengl_compositor *)Context;
+	opengl_functions *GL = Compositor->GL;
+	
+	GL->DeleteBuffers(1, &Compositor->InstanceBuffer);
+	GL->DeleteBuffers(1, &Compositor->ConvertBuffer);
+	GL->DeleteBuffers(1, &Compositor->EffectBuffer);
+	GL->DeleteVertexArrays(1, &Compositor->VertexArray);
+	Compositor->InstanceBuffer = 0;
+	Compositor->ConvertBuffer  = 0;
+	Compositor->EffectBuffer   = 0;
+	Compositor->VertexArray    = 0;
+}
+
+// @Note Bound once, BufferData on a bound name keeps the binding. Empty, so what they held is uploaded again.
+internal DEVICE_RESOURCE_CREATE(OpenGLCreateBuffers)
+{
+	opengl_compositor *Compositor = (opengl_compositor *)Context;
+	opengl_functions *GL = Compositor->GL;
+	
+	GL->GenVertexArrays(1, &Compositor->VertexArray);
+	
+	GL->GenBuffers(1, &Compositor->InstanceBuffer);
+	GL->BindBuffer(GL_UNIFORM_BUFFER, Compositor->InstanceBuffer);
+	GL->BufferData(GL_UNIFORM_BUFFER, sizeof(Compositor->Instances), NULL, GL_STREAM_DRAW);
+	GL->BindBufferBase(GL_UNIFORM_BUFFER, OPENGL_SHADE_BINDING, Compositor->InstanceBuffer);
+	Compositor->InstanceCount = 0;
+	
+	GL->GenBuffers(1, &Compositor->ConvertBuffer);
+	GL->BindBuffer(GL_UNIFORM_BUFFER, Compositor->ConvertBuffer);
+	GL->BufferData(GL_UNIFORM_BUFFER, sizeof(convert_constant_buffer), NULL, GL_STREAM_DRAW);
+	GL->BindBufferBase(GL_UNIFORM_BUFFER, OPENGL_CONVERT_BINDING, Compositor->ConvertBuffer);
+	
+	GL->GenBuffers(1, &Compositor->EffectBuffer);
+	GL->BindBuffer(GL_UNIFORM_BUFFER, Compositor->EffectBuffer);
+	GL->BufferData(GL_UNIFORM_BUFFER, sizeof(effect_constants), NULL, GL_STREAM_DRAW);
+	GL->BindBufferBase(GL_UNIFORM_BUFFER, OPENGL_EFFECT_BINDING, Compositor->EffectBuffer);
+	Compositor->EffectsAreStale = true;
+	
+	if (!OpenGLCallsWentThrough(GL))
+	{
+		OpenGLReleaseBuffers(Context, Resource);
+		return false;
+	}
+	
+	return true;
+}
+
+// @Note The convert source goes with it, it is only ever made by a crop
+internal DEVICE_RESOURCE_RELEASE(OpenGLReleaseDisplayTexture)
+{
+	opengl_compositor *Compositor = (opengl_compositor *)Context;
+	
+	ReleaseTexturePool(&Compositor->TexturePool);
+	Compositor->DisplayTexture       = 0;
+	Compositor->DisplayTextureTarget = 0;
+	Compositor->TextureWidth         = 0;
+	Compositor->TextureHeight        = 0;
+	
+	if (Compositor->ConvertSource)
+	{
+		Compositor->GL->DeleteTextures(1, &Compositor->ConvertSource);
+		Compositor->ConvertSource = 0;
+	}
+}
+
+// @Note The size of the crop atlas as it is now, nothing before the first layout. What was cropped into it is gone,
+// the pipeline crops everything again after a present that didn't happen.
+internal DEVICE_RESOURCE_CREATE(OpenGLCreateDisplayTexture)
+{
+	opengl_compositor *Compositor = (opengl_compositor *)Context;
+	atlas_packer *Packer = &Compositor->CropAtlas.Packer;
+	
+	Compositor->DisplayTexture       = 0;
+	Compositor->DisplayTextureTarget = 0;
+	Compositor->TextureWidth         = 0;
+	Compositor->TextureHeight        = 0;
+	Compositor->ConvertSource        = 0;
+	Compositor->MipsAreStale         = true;
+	
+	if ((Packer->Width > 0) && (Packer->Height > 0))
+	{
+		return ResizeDisplayTexture(Compositor, Packer->Width, Packer->Height);
+	}
+	
+	return true;
+}
+
+internal DEVICE_RESOURCE_RELEASE(OpenGLReleaseBackBuffer)
+{
+	opengl_compositor *Compositor = (opengl_compositor *)Context;
+	
+	Compositor->GL->DeleteFramebuffers(1, &Compositor->BackBufferTarget);
+	Compositor->GL->DeleteTextures(1, &Compositor->BackBuffer);
+	Compositor->BackBufferTarget = 0;
+	Compositor->BackBuffer       = 0;
+	Compositor->BackBufferWidth  = 0;
+	Compositor->BackBufferHeight = 0;
+}
+
+// @Note The size of the display atlas as it is now, like the display texture
+internal DEVICE_RESOURCE_CREATE(OpenGLCreateBackBuffer)
+{
+	opengl_compositor *Compositor = (opengl_compositor *)Context;
+	atlas_packer *Packer = &Compositor->DisplayAtlas.Packer;
+	box Bounds = GetAtlasBounds(&Compositor->DisplayAtlas);
+	
+	Compositor->BackBuffer       = 0;
+	Compositor->BackBufferTarget = 0;
+	Compositor->BackBufferWidth  = 0;
+	Compositor->BackBufferHeight = 0;
+	
+	if ((Packer->Width > 0) && (Packer->Height > 0))
+	{
+		return ResizeBackBuffer(Compositor, Bounds.Right, Bounds.Bottom);
+	}
+	
+	return true;
+}
+
+// @Note What the stages count on staying set
+internal DEVICE_RESOURCE_CREATE(OpenGLCreateBindings)
+{
+	opengl_compositor *Compositor = (opengl_compositor *)Context;
+	opengl_functions *GL = Compositor->GL;
+	
+	// @Note For the regions' texels straight from the surface bitmaps, and the back buffer straight into one
+	GL->PixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	GL->PixelStorei(GL_PACK_ALIGNMENT, 4);
+	
+	// @Note Only the display texture is sRGB, that is the only thing the convert pass draws into
+	GL->Enable(GL_FRAMEBUFFER_SRGB);
+	GL->ClearColor(0.0f, 0.0f, 0.0f, 1.0f);
+	
+	GL->BindVertexArray(Compositor->VertexArray);
+	
+	return OpenGLCallsWentThrough(GL);
+}
+
+// Needs the context current on this thread from here on. Returns false with FailedName, and the log in ShaderLog
+// for a shader, if something couldn't be made.
+internal bool InitializeOpenGLCompositor(opengl_compositor *Compositor, opengl_platform *Platform)
+{
+	*Compositor = {};
+	Compositor->GL       = Platform->GL;
+	Compositor->Platform = Platform;
+	
+	InitializeTexturePool(&Compositor->TexturePool, Compositor, OpenGLCreateTexture, OpenGLDestroyTexture, 4, true);
+	InitializeAtlasLayout(&Compositor->CropAtlas, OPENGL_ATLAS_MAX_SIZE);
+	InitializeAtlasLayout(&Compositor->DisplayAtlas, OPENGL_ATLAS_MAX_SIZE);
+	
+	device_registry *Registry = &Compositor->Registry;
+	InitializeDeviceRegistry(Registry, Compositor, Platform->GetNanoseconds);
+	
+	u32 Context  = GetDeviceResourceBit(OpenGLResource_Context);
+	u32 Bindings = GetDeviceResourceBit(OpenGLResource_Buffers);
+	
+	AddDeviceResource(Registry, "Context",        OpenGLOpenContext,          OpenGLCloseContext,          NULL, 0);
+	AddDeviceResource(Registry, "Programs",       OpenGLCreatePrograms,       OpenGLReleasePrograms,       NULL, Context);
+	AddDeviceResource(Registry, "Samplers",       OpenGLCreateSamplers,       OpenGLReleaseSamplers,       NULL, Context);
+	AddDeviceResource(Registry, "Buffers",        OpenGLCreateBuffers,        OpenGLReleaseBuffers,        NULL, Context);
+	AddDeviceResource(Registry, "DisplayTexture", OpenGLCreateDisplayTexture, OpenGLReleaseDisplayTexture, NULL, Context);
+	AddDeviceResource(Registry, "BackBuffer",     OpenGLCreateBackBuffer,     OpenGLReleaseBackBuffer,     NULL, Context);
+	AddDeviceResource(Registry, "Bindings",       OpenGLCreateBindings,       NULL,                        NULL, Bindings);
+	
+	if (!BuildDeviceResources(Registry))
+	{
+		Compositor->FailedName = Registry->FailedName;
+		return false;
+	}
+	
+	return true;
+}
+
+//
+// After a reset: everything made in the lost context goes and is made again in a new one, like RecoverD3D11Device
+//
+internal bool RecoverOpenGLContext(opengl_compositor *Compositor)
+{
+	device_registry *Registry = &Compositor->Registry;
+	bool Recovered = RebuildDeviceResources(Registry);
+	
+	Compositor->ContextIsLost     = !Recovered;
+	Compositor->ContextWasRebuilt = Recovered;
+	if (Recovered)
+	{
+		UpdateOpenGLMemory(Compositor);
+	}
+	
+	return Recovered;
+}
+
+// @Note A rebuild that didn't go through is tried again by the next call, every frame makes a few
+inline bool OpenGLContextIsReady(opengl_compositor *Compositor)
+{
+	return !Compositor->ContextIsLost || RecoverOpenGLContext(Compositor);
+}
+
+// @Note Guilty, innocent or unknown, the context is gone whoever caused it
+inline bool OpenGLContextWasReset(opengl_compositor *Compositor)
+{
+	opengl_functions *GL = Compositor->GL;
+	return GL->GetGraphicsResetStatus && (GL->GetGraphicsResetStatus() != GL_NO_ERROR);
+}
+
+// @Note Linked the first time a shade draws with Key, 0 with the log in ShaderLog if it doesn't
+internal GLuint GetOpenGLEffectProgram(opengl_compositor *Compositor, u32 Key)
+{
+	if (!Compositor->EffectPrograms[Key])
+	{
+		Compositor->EffectPrograms[Key] = LinkOpenGLShadeProgram(Compositor, OpenGLEffectKeyDefines[Key]);
+	}
+	
+	return Compositor->EffectPrograms[Key];
+}
+
+//
+// Stages
+//
+
+internal COMPOSITOR_LAYOUT(OpenGLLayout)
+{
+	opengl_compositor *Compositor = (opengl_compositor *)Context;
+	
+	int Widths[ATLAS_MAX_SLOTS];
+	int Heights[ATLAS_MAX_SLOTS];
+	for (u32 PieceIndex = 0; PieceIndex < PieceCount; ++PieceIndex)
+	{
+		Widths[PieceIndex]  = Pieces[PieceIndex].Mapping.TextureWidth;
+		Heights[PieceIndex] = Pieces[PieceIndex].Mapping.TextureHeight;
+	}
+	
+	UpdateAtlasLayout(&Compositor->CropAtlas, Widths, Heights, PieceCount, SlotMoved);
+	
+	for (u32 OverlayIndex = 0; OverlayIndex < State->OverlayCount; ++OverlayIndex)
+	{
+		Widths[OverlayIndex]  = Max(State->Overlays[OverlayIndex].DisplayWidth,  1);
+		Heights[OverlayIndex] = Max(State->Overlays[OverlayIndex].DisplayHeight, 1);
+	}
+	
+	// @Note Whatever was drawn gets drawn again anyway, where it ended up doesn't matter here
+	bool DisplayMoved[ATLAS_MAX_SLOTS];
+	UpdateAtlasLayout(&Compositor->DisplayAtlas, Widths, Heights, State->OverlayCount, DisplayMoved);
+	Compositor->WindowCount = State->OverlayCount;
+	
+	// @Note Without a context the atlases are all there is, a rebuild makes everything to fit them
+	if (!OpenGLContextIsReady(Compositor))
+	{
+		return;
+	}
+	
+	// @Note Out of memory leaves either one empty and nothing gets cropped into it or drawn from it
+	atlas_packer *Packer = &Compositor->CropAtlas.Packer;
+	box Bounds = GetAtlasBounds(&Compositor->DisplayAtlas);
+	ResizeDisplayTexture(Compositor, Packer->Width, Packer->Height);
+	ResizeBackBuffer(Compositor, Bounds.Right, Bounds.Bottom);
+}
+
+// @Note The source texture goes from one format to another with the surface, it is only ever as big as that
+internal bool ResizeConvertSource(opengl_compositor *Compositor, surface_format Format, int Width, int Height)
+{
+	opengl_functions *GL = Compositor->GL;
+	if (Compositor->ConvertSource && (Compositor->ConvertSourceFormat == Format) &&
+		(Compositor->ConvertSourceWidth == Width) && (Compositor->ConvertSourceHeight == Height))
+	{
+		return true;
+	}
+	
+	if (!Compositor->ConvertSource)
+	{
+		GL->GenTextures(1, &Compositor->ConvertSource);
+		GL->BindTexture(GL_TEXTURE_2D, Compositor->ConvertSource);
+		GL->TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_NEAREST);
+		GL->TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_NEAREST);
+		GL->TexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAX_LEVEL, 0);
+	}
+	
+	OpenGLCallsWentThrough(GL);
+	
+	// @Note R10G10B10A2 has red in the low bits, which is what 2_10_10_10_REV reads
+	GL->BindTexture(GL_TEXTURE_2D, Compositor->ConvertSource);
+	if (Format == SurfaceFormat_RGBA16F)
+	{
+		GL->TexImage2D(GL_TEXTURE_2D, 0, GL_RGBA16F, Width, Height, 0, GL_RGBA, GL_HALF_FLOAT, NULL);
+	}
+	else
+	{
+		GL->TexImage2D(GL_TEXTURE_2D, 0, GL_RGB10_A2, Width, Height, 0, GL_RGBA, GL_UNSIGNED_INT_2_10_10_10_REV, NULL);
+	}
+	
+	if (!OpenGLCallsWentThrough(GL))
+	{
+		Compositor->ConvertSourceWidth  = 0;
+		Compositor->ConvertSourceHeight = 0;
+		return false;
+	}
+	
+	Compositor->ConvertSourceFormat = Format;
+	Compositor->ConvertSourceWidth  = Width;
+	Compositor->ConvertSourceHeight = Height;
+	
+	return true;
+}
+
+// @Note An HDR desktop can't be uploaded into the 8-bit display texture, so its regions are drawn into it instead and
+// converted and tone mapped on the way, like SoftwareCropTile does. The regions are already inside the cut box.
+internal void ConvertCrop(opengl_compositor *Compositor, captured_frame *Frame, bitmap *Desktop, box Slot, box CutBox,
+						  box *Regions, u32 RegionCount)
+{
+	opengl_functions *GL = Compositor->GL;
+	
+	GL->ActiveTexture(GL_TEXTURE0 + OPENGL_CONVERT_TEXTURE_UNIT);
+	if (!ResizeConvertSource(Compositor, Frame->Format, Desktop->Width, Desktop->Height))
+	{
+		GL->ActiveTexture(GL_TEXTURE0 + OPENGL_SHADE_TEXTURE_UNIT);
+		return;
+	}
+	
+	GLenum UploadFormat = (Frame->Format == SurfaceFormat_RGBA16F) ? GL_HALF_FLOAT : GL_UNSIGNED_INT_2_10_10_10_REV;
+	u32 BytesPerPixel   = GetSurfaceBytesPerPixel(Frame->Format);
+	for (u32 RegionIndex = 0; RegionIndex < RegionCount; ++RegionIndex)
+	{
+		box Region = Regions[RegionIndex];
+		GL->TexSubImage2D(GL_TEXTURE_2D, 0, Region.Left, Region.Top, GetBoxWidth(Region), GetBoxHeight(Region), GL_RGBA, UploadFormat,
+						  Desktop->Memory + (size_t)Region.Top * Desktop->Pitch + (size_t)Region.Left * BytesPerPixel);
+	}
+	
+	GL->ActiveTexture(GL_TEXTURE0 + OPENGL_SHADE_TEXTURE_UNIT);
+	
+	GL->BindFramebuffer(GL_FRAMEBUFFER, Compositor->DisplayTextureTarget);
+	GL->Viewport(0, 0, Compositor->TextureWidth, Compositor->TextureHeight);
+	GL->UseProgram(Compositor->ConvertPrograms[Frame->Format]);
+	GL->BindBuffer(GL_UNIFORM_BUFFER, Compositor->ConvertBuffer);
+	
+	// @Note A source that doesn't know its SDR white gets the default
+	float WhiteNits = (Frame->WhiteNits > 0.0f) ? Frame->WhiteNits : SCRGB_WHITE_NITS;
+	colour_convert Convert = GetColourConvert(Frame->Format, WhiteNits);
+	
+	for (u32 FirstRegion = 0; FirstRegion < RegionCount; FirstRegion += CONVERT_MAX_REGIONS)
+	{
+		u32 BatchCount = Min(RegionCount - FirstRegion, (u32)CONVERT_MAX_REGIONS);
+		
+		convert_constant_buffer CBuffer;
+		for (u32 RegionIndex = 0; RegionIndex < BatchCount; ++RegionIndex)
+		{
+			box Region = Regions[FirstRegion + RegionIndex];
+			CBuffer.Regions[RegionIndex][0] = (float)Region.Left;
+			CBuffer.Regions[RegionIndex][1] = (float)Region.Top;
+			CBuffer.Regions[RegionIndex][2] = (float)Region.Right;
+			CBuffer.Regions[RegionIndex][3] = (float)Region.Bottom;
+		}
+		
+		CBuffer.Offset[0]      = (float)(Slot.Left - CutBox.Left);
+		CBuffer.Offset[1]      = (float)(Slot.Top  - CutBox.Top);
+		CBuffer.TargetScale[0] = 2.0f / (float)Compositor->TextureWidth;
+		CBuffer.TargetScale[1] = 2.0f / (float)Compositor->TextureHeight;
+		CBuffer.Scale          = Convert.Scale;
+		for (int Row = 0; Row < 3; ++Row)
+		{
+			CBuffer.Mix[Row][0] = BT2020To709[Row][0];
+			CBuffer.Mix[Row][1] = BT2020To709[Row][1];
+			CBuffer.Mix[Row][2] = BT2020To709[Row][2];
+			CBuffer.Mix[Row][3] = 0.0f;
+		}
+		
+		// @Note Orphaned first, same as D3D11_MAP_WRITE_DISCARD, the last batch's draw keeps the old storage
+		GL->BufferData(GL_UNIFORM_BUFFER, sizeof(CBuffer), NULL, GL_STREAM_DRAW);
+		GL->BufferSubData(GL_UNIFORM_BUFFER, 0, sizeof(CBuffer), &CBuffer);
+		GL->DrawArraysInstanced(GL_TRIANGLES, 0, 6, BatchCount);
+	}
+}
+
+internal COMPOSITOR_CROP(OpenGLCrop)
+{
+	opengl_compositor *Compositor = (opengl_compositor *)Context;
+	opengl_functions *GL = Compositor->GL;
+	bitmap *Desktop = (bitmap *)Frame->Surface;
+	
+	box Slot = Compositor->CropAtlas.Slots[PieceIndex];
+	if (!OpenGLContextIsReady(Compositor) || BoxIsEmpty(Slot) || !Compositor->DisplayTexture || !Desktop)
+	{
+		return false;
+	}
+	
+	// @Note Same clamp as SoftwareCrop, an upload out of bounds fails as a whole
+	CutBox.Left   = Max(CutBox.Left, 0);
+	CutBox.Top    = Max(CutBox.Top, 0);
+	CutBox.Right  = Min(CutBox.Right,  Min(Desktop->Width,  CutBox.Left + GetBoxWidth(Slot)));
+	CutBox.Bottom = Min(CutBox.Bottom, Min(Desktop->Height, CutBox.Top  + GetBoxHeight(Slot)));
+	
+	box Copied[MAX_CROP_REGIONS];
+	u32 CopiedCount = 0;
+	for (u32 RegionIndex = 0; (RegionIndex < RegionCount) && (CopiedCount < MAX_CROP_REGIONS); ++RegionIndex)
+	{
+		box Region = IntersectBoxes(Regions[RegionIndex], CutBox);
+		if (!BoxIsEmpty(Region))
+		{
+			Copied[CopiedCount++] = Region;
+			
+			++Compositor->Traffic.CopyCount;
+			Compositor->Traffic.CopiedBytes += (u64)GetBoxWidth(Region) * (u64)GetBoxHeight(Region) * 4;
+		}
+	}
+	
+	u32 BytesPerPixel = GetSurfaceBytesPerPixel(Frame->Format);
+	GL->PixelStorei(GL_UNPACK_ROW_LENGTH, Desktop->Pitch / BytesPerPixel);
+	
+	// @Note sRGB textures take BGRA bytes as they are, an SDR desktop uploads straight in
+	if (Frame->Format != SurfaceFormat_BGRA8)
+	{
+		ConvertCrop(Compositor, Frame, Desktop, Slot, CutBox, Copied, CopiedCount);
+	}
+	else
+	{
+		GL->BindTexture(GL_TEXTURE_2D, Compositor->DisplayTexture);
+		for (u32 RegionIndex = 0; RegionIndex < CopiedCount; ++RegionIndex)
+		{
+			box Region = Copied[RegionIndex];
+			GL->TexSubImage2D(GL_TEXTURE_2D, 0, Slot.Left + (Region.Left - CutBox.Left), Slot.Top + (Region.Top - CutBox.Top),
+							  GetBoxWidth(Region), GetBoxHeight(Region), GL_BGRA, GL_UNSIGNED_BYTE,
+							  Desktop->Memory + (size_t)Region.Top * Desktop->Pitch + (size_t)Region.Left * BITMAP_BYTES_PER_PIXEL);
+		}
+	}
+	
+	GL->PixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+	Compositor->MipsAreStale = true;
+	
+	// @Note The upload never comes back to the CPU, whether it changed anything is for the GPU to know
+	return true;
+}
+
+internal COMPOSITOR_SHADE(OpenGLShade)
+{
+	opengl_compositor *Compositor = (opengl_compositor *)Context;
+	opengl_functions *GL = Compositor->GL;
+	
+	// @Note Lost since the wait, the present doesn't happen either
+	if (Compositor->ContextIsLost || !Compositor->DisplayTexture || !Compositor->BackBuffer)
+	{
+		return;
+	}
+	
+	//
+	// One instance per piece that has something to show, the pieces of a cut box share its display slot
+	//
+	
+	float SourceWidth  = (float)Compositor->TextureWidth;
+	float SourceHeight = (float)Compositor->TextureHeight;
+	float TargetWidth  = (float)Compositor->BackBufferWidth;
+	float TargetHeight = (float)Compositor->BackBufferHeight;
+	
+	u32 InstanceCount = 0;
+	bool InstancesChanged = false;
+	for (u32 PieceIndex = 0; PieceIndex < PieceCount; ++PieceIndex)
+	{
+		crop_piece *Piece = &Pieces[PieceIndex];
+		box CropSlot    = Compositor->CropAtlas.Slots[PieceIndex];
+		box DisplaySlot = Compositor->DisplayAtlas.Slots[Piece->OverlayIndex];
+		
+		// @Note Nothing was cropped for a cut box that is entirely off the desktop
+		if (!Piece->HasImage || BoxIsEmpty(CropSlot) || BoxIsEmpty(DisplaySlot) || BoxIsEmpty(Piece->Mapping.SurfaceBox))
+		{
+			continue;
+		}
+		
+		float SlotWidth  = (float)GetBoxWidth(DisplaySlot);
+		float SlotHeight = (float)GetBoxHeight(DisplaySlot);
+		float Left   = (float)DisplaySlot.Left + Piece->DisplayMin.X * SlotWidth;
+		float Top    = (float)DisplaySlot.Top  + Piece->DisplayMin.Y * SlotHeight;
+		float Right  = (float)DisplaySlot.Left + Piece->DisplayMax.X * SlotWidth;
+		float Bottom = (float)DisplaySlot.Top  + Piece->DisplayMax.Y * SlotHeight;
+		
+		// @Note Clip space y goes down here, see the top of the file
+		overlay_instance Instance;
+		Instance.Destination[0] = 2.0f * Left   / TargetWidth  - 1.0f;
+		Instance.Destination[1] = 2.0f * Top    / TargetHeight - 1.0f;
+		Instance.Destination[2] = 2.0f * Right  / TargetWidth  - 1.0f;
+		Instance.Destination[3] = 2.0f * Bottom / TargetHeight - 1.0f;
+		Instance.UVClamp[0]     = ((float)CropSlot.Left   + 0.5f) / SourceWidth;
+		Instance.UVClamp[1]     = ((float)CropSlot.Top    + 0.5f) / SourceHeight;
+		Instance.UVClamp[2]     = ((float)CropSlot.Right  - 0.5f) / SourceWidth;
+		Instance.UVClamp[3]     = ((float)CropSlot.Bottom - 0.5f) / SourceHeight;
+		Instance.UV             = GetAtlasUV(Piece->Mapping.UV, CropSlot, Compositor->TextureWidth, Compositor->TextureHeight);
+		Instance.Decode         = 0.0f;
+		Instance.Pad            = 0.0f;
+		
+		overlay_instance *Cached = &Compositor->Instances[InstanceCount++];
+		if (!InstancesAreEqual(Cached, &Instance))
+		{
+			*Cached = Instance;
+			InstancesChanged = true;
+		}
+	}
+	
+	if (InstancesChanged || (InstanceCount != Compositor->InstanceCount))
+	{
+		Compositor->InstanceCount = InstanceCount;
+		
+		GL->BindBuffer(GL_UNIFORM_BUFFER, Compositor->InstanceBuffer);
+		GL->BufferData(GL_UNIFORM_BUFFER, sizeof(Compositor->Instances), NULL, GL_STREAM_DRAW);
+		GL->BufferSubData(GL_UNIFORM_BUFFER, 0, InstanceCount * sizeof(overlay_instance), Compositor->Instances);
+	}
+	
+	//
+	// Effect parameters, the same for every piece
+	//
+	
+	effect_constants Effects = GetEffectConstants(State->Shade);
+	if (Compositor->EffectsAreStale || !BytesAreEqual(&Effects, &Compositor->Effects, sizeof(Effects)))
+	{
+		Compositor->Effects         = Effects;
+		Compositor->EffectsAreStale = false;
+		
+		GL->BindBuffer(GL_UNIFORM_BUFFER, Compositor->EffectBuffer);
+		GL->BufferData(GL_UNIFORM_BUFFER, sizeof(Effects), &Effects, GL_STREAM_DRAW);
+	}
+	
+	//
+	// Scaling mode and effect chain, the mip chain only gets generated if it is sampled
+	//
+	
+	scale_mode Scale = GetShadeScale(&State->Shade);
+	u32 EffectKey = State->Shade.Effects.Key & (EffectKey_Count - 1);
+	
+	// @Note A chain that doesn't link draws without its effects rather than not at all
+	GLuint Program = Compositor->ShadePrograms[Scale];
+	if (EffectKey)
+	{
+		GLuint EffectProgram = GetOpenGLEffectProgram(Compositor, EffectKey);
+		if (EffectProgram)
+		{
+			Program = EffectProgram;
+		}
+	}
+	
+	GL->UseProgram(Program);
+	GL->BindSampler(OPENGL_SHADE_TEXTURE_UNIT, Compositor->Samplers[Scale]);
+	GL->BindTexture(GL_TEXTURE_2D, Compositor->DisplayTexture);
+	
+	if ((Scale == ScaleMode_Mip) && Compositor->MipsAreStale)
+	{
+		Compositor->MipsAreStale = false;
+		GL->GenerateMipmap(GL_TEXTURE_2D);
+	}
+	
+	//
+	// Render every piece in one draw
+	//
+	
+	GL->BindFramebuffer(GL_FRAMEBUFFER, Compositor->BackBufferTarget);
+	GL->Viewport(0, 0, Compositor->BackBufferWidth, Compositor->BackBufferHeight);
+	GL->Clear(GL_COLOR_BUFFER_BIT);
+	
+	if (InstanceCount > 0)
+	{
+		GL->DrawArraysInstanced(GL_TRIANGLES, 0, 6, InstanceCount);
+	}
+}
+
+// @Note A wait that timed out keeps the fence, the next one picks it up again
+internal COMPOSITOR_WAIT(OpenGLWait)
+{
+	opengl_compositor *Compositor = (opengl_compositor *)Context;
+	opengl_functions *GL = Compositor->GL;
+	
+	// @Note Nothing gets drawn without a context, the frame waits for the next try
+	if (!OpenGLContextIsReady(Compositor))
+	{
+		return false;
+	}
+	
+	if (!Compositor->PresentFence)
+	{
+		return true;
+	}
+	
+	GLenum WaitResult = GL->ClientWaitSync(Compositor->PresentFence, GL_SYNC_FLUSH_COMMANDS_BIT, (GLuint64)TimeoutMS * 1000000);
+	if (WaitResult == GL_TIMEOUT_EXPIRED)
+	{
+		return false;
+	}
+	
+	GL->DeleteSync(Compositor->PresentFence);
+	Compositor->PresentFence = NULL;
+	
+	return true;
+}
+
+// @Note Every overlay's slot into its window, flipped since a window's row 0 is at the bottom. A straight copy, the
+// back buffer is already encoded and premultiplied the way a compositing manager blends a 32-bit window. The windows
+// of overlays that are gone are hidden. Returns false if the context was lost.
+internal bool PresentOpenGLWindows(opengl_compositor *Compositor)
+{
+	opengl_functions *GL = Compositor->GL;
+	opengl_platform *Platform = Compositor->Platform;
+	
+	bool ContextIsLost = false;
+	GL->Disable(GL_FRAMEBUFFER_SRGB);
+	for (u32 WindowIndex = 0; WindowIndex < MAX_OVERLAYS; ++WindowIndex)
+	{
+		box Slot = {};
+		if (WindowIndex < Compositor->WindowCount)
+		{
+			Slot = Compositor->DisplayAtlas.Slots[WindowIndex];
+		}
+		
+		int Width  = GetBoxWidth(Slot);
+		int Height = GetBoxHeight(Slot);
+		if (!Platform->SelectWindow(Platform->Context, WindowIndex, Width, Height))
+		{
+			continue;
+		}
+		
+		GL->BindFramebuffer(GL_READ_FRAMEBUFFER, Compositor->BackBufferTarget);
+		GL->BindFramebuffer(GL_DRAW_FRAMEBUFFER, 0);
+		GL->BlitFramebuffer(Slot.Left, Slot.Top, Slot.Right, Slot.Bottom, 0, Height, Width, 0, GL_COLOR_BUFFER_BIT, GL_NEAREST);
+		
+		if (!Platform->SwapWindow(Platform->Context, WindowIndex))
+		{
+			ContextIsLost = true;
+			break;
+		}
+	}
+	
+	GL->Enable(GL_FRAMEBUFFER_SRGB);
+	GL->BindFramebuffer(GL_FRAMEBUFFER, 0);
+	
+	return !ContextIsLost;
+}
+
+// @Note Headless the frame is done once the GPU gets past the fence, with windows once it got past their copies
+internal COMPOSITOR_PRESENT(OpenGLPresent)
+{
+	opengl_compositor *Compositor = (opengl_compositor *)Context;
+	opengl_functions *GL = Compositor->GL;
+	
+	// @Note What was just drawn came from a display texture that lost its crops with the old context. Not presenting
+	// it has the pipeline crop everything again.
+	if (Compositor->ContextIsLost || Compositor->ContextWasRebuilt)
+	{
+		Compositor->ContextWasRebuilt = false;
+		return false;
+	}
+	
+	bool WindowsWentThrough = true;
+	if (Compositor->Platform->SelectWindow && Compositor->BackBuffer)
+	{
+		WindowsWentThrough = PresentOpenGLWindows(Compositor);
+	}
+	
+	if (Compositor->PresentFence)
+	{
+		GL->DeleteSync(Compositor->PresentFence);
+	}
+	
+	Compositor->PresentFence = GL->FenceSync(GL_SYNC_GPU_COMMANDS_COMPLETE, 0);
+	GL->Flush();
+	
+	// @Note A reset takes whatever was queued with it, so this frame never shows either
+	if (!WindowsWentThrough || OpenGLContextWasReset(Compositor))
+	{
+		RecoverOpenGLContext(Compositor);
+		Compositor->ContextWasRebuilt = false;
+		
+		return false;
+	}
+	
+	Compositor->PresentCount++;
+	return true;
+}
+
+// Waits for the GPU and copies the back buffer into Target, which has to be its size. Row 0 is the top.
+internal bool ReadOpenGLBackBuffer(opengl_compositor *Compositor, bitmap *Target)
+{
+	opengl_functions *GL = Compositor->GL;
+	if (!Compositor->BackBuffer || (Target->Width != Compositor->BackBufferWidth) || (Target->Height != Compositor->BackBufferHeight))
+	{
+		return false;
+	}
+	
+	GL->BindFramebuffer(GL_READ_FRAMEBUFFER, Compositor->BackBufferTarget);
+	GL->PixelStorei(GL_PACK_ROW_LENGTH, Target->Pitch / BITMAP_BYTES_PER_PIXEL);
+	GL->ReadPixels(0, 0, Target->Width, Target->Height, GL_BGRA, GL_UNSIGNED_BYTE, Target->Memory);
+	GL->PixelStorei(GL_PACK_ROW_LENGTH, 0);
+	GL->BindFramebuffer(GL_READ_FRAMEBUFFER, 0);
+	
+	return OpenGLCallsWentThrough(GL);
+}
+
+internal compositor OpenGLCompositor(opengl_compositor *Compositor)
+{
+	compositor Result;
+	Result.Context = Compositor;
+	Result.Layout  = OpenGLLayout;
+	Result.Crop    = OpenGLCrop;
+	Result.Sample  = NULL;
+	Result.Shade   = OpenGLShade;
+	Result.Wait    = OpenGLWait;
+	Result.Present = OpenGLPresent;
+	Result.Memory  = &Compositor->Memory;
+	Result.Traffic = &Compositor->Traffic;
+	
+	return Result;
+}
@@ -0,0 +1,441 @@
+//
+// Several outputs: which ones the cut boxes need, how a cut box splits over them,
+// and the source that runs one capture worker per output
+//
+
+//
+// Output selection
+//
+
+// Bit i is set when some cut box covers part of output i
+internal u32 GetTouchedOutputs(render_state *State)
+{
+	u32 Mask = 0;
+	for (u32 OverlayIndex = 0; OverlayIndex < State->OverlayCount; ++OverlayIndex)
+	{
+		box CutBox = State->Overlays[OverlayIndex].CutBox;
+		for (u32 OutputIndex = 0; OutputIndex < State->OutputCount; ++OutputIndex)
+		{
+			if (!BoxIsEmpty(IntersectBoxes(CutBox, State->Outputs[OutputIndex])))
+			{
+				Mask |= (1u << OutputIndex);
+			}
+		}
+	}
+	
+	return Mask;
+}
+
+//
+// Stitching: one piece per output a cut box covers, each mapped through its own output's rotation and
+// DPI scale and drawn into its part of the display. The parts of a cut box that are on no output at all
+// (the gap next to a shorter monitor) stay clear.
+//
+internal u32 BuildCropPieces(render_state *State, output_geometry *Geometry, crop_piece *Pieces)
+{
+	u32 PieceCount = 0;
+	for (u32 OverlayIndex = 0; OverlayIndex < State->OverlayCount; ++OverlayIndex)
+	{
+		overlay_region *Overlay = &State->Overlays[OverlayIndex];
+		box CutBox = Overlay->CutBox;
+		if (BoxIsEmpty(CutBox))
+		{
+			continue;
+		}
+		
+		float CutWidth  = (float)GetBoxWidth(CutBox);
+		float CutHeight = (float)GetBoxHeight(CutBox);
+		
+		for (u32 OutputIndex = 0; OutputIndex < State->OutputCount; ++OutputIndex)
+		{
+			box Output = State->Outputs[OutputIndex];
+			box Part   = IntersectBoxes(CutBox, Output);
+			
+			// @Note Out of pieces only happens with a lot of overlays over a lot of outputs, the rest just isn't drawn
+			if (BoxIsEmpty(Part) || (PieceCount == MAX_CROP_PIECES))
+			{
+				continue;
+			}
+			
+			crop_piece *Piece = &Pieces[PieceCount++];
+			Piece->OverlayIndex = OverlayIndex;
+			Piece->OutputIndex  = OutputIndex;
+			Piece->HasImage     = false;
+			
+			Piece->DisplayMin.X = (float)(Part.Left   - CutBox.Left) / CutWidth;
+			Piece->DisplayMin.Y = (float)(Part.Top    - CutBox.Top)  / CutHeight;
+			Piece->DisplayMax.X = (float)(Part.Right  - CutBox.Left) / CutWidth;
+			Piece->DisplayMax.Y = (float)(Part.Bottom - CutBox.Top)  / CutHeight;
+			
+			// @Note Until the output's first frame says otherwise it is upright and not scaled
+			output_geometry *OutputGeometry = &Geometry[OutputIndex];
+			int DesktopWidth  = OutputGeometry->DesktopWidth  ? OutputGeometry->DesktopWidth  : GetBoxWidth(Output);
+			int DesktopHeight = OutputGeometry->DesktopHeight ? OutputGeometry->DesktopHeight : GetBoxHeight(Output);
+			
+			v2 DpiScale;
+			DpiScale.X = GetDpiScale(DesktopWidth,  GetBoxWidth(Output));
+			DpiScale.Y = GetDpiScale(DesktopHeight, GetBoxHeight(Output));
+			
+			box LocalPart;
+			LocalPart.Left   = Part.Left   - Output.Left;
+			LocalPart.Top    = Part.Top    - Output.Top;
+			LocalPart.Right  = Part.Right  - Output.Left;
+			LocalPart.Bottom = Part.Bottom - Output.Top;
+			
+			int DisplayWidth  = (int)((Piece->DisplayMax.X - Piece->DisplayMin.X) * (float)Overlay->DisplayWidth  + 0.5f);
+			int DisplayHeight = (int)((Piece->DisplayMax.Y - Piece->DisplayMin.Y) * (float)Overlay->DisplayHeight + 0.5f);
+			
+			Piece->Mapping = MapCoordinates(DesktopWidth, DesktopHeight, OutputGeometry->Rotation, DpiScale,
+											LocalPart, DisplayWidth, DisplayHeight);
+		}
+	}
+	
+	return PieceCount;
+}
+
+//
+// Multi-output source
+//
+// @Note Each output has a worker that acquires from that output's own source and hands the frame to the
+// render thread through a bounded queue. A worker keeps its frame until the render thread releases it, so
+// it never has more than one in flight and the queue can't fill up. The workers run on their own threads
+// when the platform gives us events to sleep on, otherwise the render thread steps them inline on acquire.
+//
+// @Note A worker with a capture ring copies the frame into it and releases it right away instead, so the
+// source can get on with the next one while the render thread draws. It queues a notice when there's
+// none queued yet, and the render thread takes whatever copy is newest by the time it gets to it.
+//
+
+// @Note Auto reset, a wait returns once per signal or when it times out
+#define PLATFORM_WAIT_EVENT(Name) bool Name(void *Event, u32 TimeoutMS)
+typedef PLATFORM_WAIT_EVENT(platform_wait_event);
+
+#define PLATFORM_SIGNAL_EVENT(Name) void Name(void *Event)
+typedef PLATFORM_SIGNAL_EVENT(platform_signal_event);
+
+struct multi_output_source;
+
+struct output_worker
+{
+	multi_output_source *Multi;
+	u32 OutputIndex;
+	
+	// @Note Captures this output only
+	frame_source Source;
+	void *WakeEvent;
+	
+	// @Note Render thread -> worker
+	u32 volatile IsSelected;
+	u32 volatile InvalidateRequested;
+	u32 volatile ReleaseRequested;
+	
+	// @Note Set the rings before the worker starts. No latency ring records nothing, no capture ring holds the frame.
+	latency_ring *LatencyRing;
+	capture_ring *CaptureRing;
+	u32 volatile NoticeIsQueued;
+	
+	// @Note Worker only
+	bool IsCapturing;
+	bool HoldingFrame;
+	bool WasReset;
+	captured_frame Frame;
+};
+
+struct multi_output_source
+{
+	u32 WorkerCount;
+	output_worker Workers[MAX_OUTPUTS];
+	
+	output_frame_queue Queue;
+	void *FrameEvent;
+	
+	platform_wait_event   *WaitEvent;
+	platform_signal_event *SignalEvent;
+	
+	u64 FrameCount[MAX_OUTPUTS];
+};
+
+// @Note Events are only needed when the workers get their own threads, pass NULLs to step them inline
+internal void InitializeMultiOutputSource(multi_output_source *Multi, platform_wait_event *WaitEvent,
+										  platform_signal_event *SignalEvent, void *FrameEvent)
+{
+	Multi->WorkerCount = 0;
+	Multi->FrameEvent  = FrameEvent;
+	Multi->WaitEvent   = WaitEvent;
+	Multi->SignalEvent = SignalEvent;
+	
+	InitializeOutputFrameQueue(&Multi->Queue);
+	
+	for (u32 OutputIndex = 0; OutputIndex < MAX_OUTPUTS; ++OutputIndex)
+	{
+		Multi->FrameCount[OutputIndex] = 0;
+	}
+}
+
+// @Note In render_state Outputs order, the worker index is the output index
+internal output_worker *AddOutputWorker(multi_output_source *Multi, frame_source Source, void *WakeEvent)
+{
+	Assert(Multi->WorkerCount < MAX_OUTPUTS);
+	
+	output_worker *Worker = &Multi->Workers[Multi->WorkerCount];
+	Worker->Multi       = Multi;
+	Worker->OutputIndex = Multi->WorkerCount++;
+	Worker->Source      = Source;
+	Worker->WakeEvent   = WakeEvent;
+	
+	Worker->IsSelected          = 0;
+	Worker->InvalidateRequested = 0;
+	Worker->ReleaseRequested    = 0;
+	
+	Worker->LatencyRing  = NULL;
+	Worker->CaptureRing  = NULL;
+	Worker->IsCapturing  = false;
+	Worker->HoldingFrame = false;
+	Worker->WasReset     = true;
+	
+	Worker->NoticeIsQueued = 0;
+	
+	return Worker;
+}
+
+inline void WakeOutputWorker(multi_output_source *Multi, output_worker *Worker)
+{
+	if (Multi->SignalEvent)
+	{
+		Multi->SignalEvent(Worker->WakeEvent);
+	}
+}
+
+//
+// One go around the worker loop: give back the frame the render thread is done with, then wait
+// at most TimeoutMS for the next one and queue it. Returns true if a frame was queued.
+//
+internal bool StepOutputWorker(output_worker *Worker, u32 TimeoutMS)
+{
+	multi_output_source *Multi = Worker->Multi;
+	frame_source *Source = &Worker->Source;
+	
+	if (Worker->HoldingFrame)
+	{
+		if (!AtomicExchangeU32(&Worker->ReleaseRequested, 0))
+		{
+			return false;
+		}
+		
+		Worker->HoldingFrame = false;
+		if (!Source->Release(Source->Context, &Worker->Frame))
+		{
+			Worker->WasReset = true;
+		}
+	}
+	
+	// @Note A duplication costs the compositor work even when nobody reads it, drop it while not needed
+	if (!AtomicLoadU32(&Worker->IsSelected))
+	{
+		if (Worker->IsCapturing)
+		{
+			Worker->IsCapturing = false;
+			Worker->WasReset    = true;
+			Source->Invalidate(Source->Context, 1);
+		}
+		
+		return false;
+	}
+	
+	Worker->IsCapturing = true;
+	if (AtomicExchangeU32(&Worker->InvalidateRequested, 0))
+	{
+		Worker->WasReset = true;
+		Source->Invalidate(Source->Context, 1);
+	}
+	
+	u64 AcquireStart = StartLatency(Worker->LatencyRing);
+	acquire_result AcquireResult = Source->Acquire(Source->Context, TimeoutMS, &Worker->Frame);
+	if (AcquireResult != AcquireResult_Frame)
+	{
+		if (AcquireResult == AcquireResult_Lost)
+		{
+			Worker->WasReset = true;
+		}
+		
+		return false;
+	}
+	
+	EndLatency(Worker->LatencyRing, LatencyStage_OutputAcquire, AcquireStart);
+	
+	Worker->Frame.OutputIndex     = Worker->OutputIndex;
+	Worker->Frame.SourceWasReset |= Worker->WasReset;
+	Worker->WasReset = false;
+	
+	if (Worker->CaptureRing)
+	{
+		bool Written = WriteCaptureRing(Worker->CaptureRing, &Worker->Frame);
+		if (!Source->Release(Source->Context, &Worker->Frame))
+		{
+			Worker->WasReset = true;
+		}
+		
+		if (!Written || AtomicExchangeU32(&Worker->NoticeIsQueued, 1))
+		{
+			return Written;
+		}
+	}
+	else
+	{
+		Worker->HoldingFrame = true;
+	}
+	
+	bool Pushed = PushOutputFrame(&Multi->Queue, &Worker->Frame);
+	Assert(Pushed);
+	
+	if (Multi->SignalEvent)
+	{
+		Multi->SignalEvent(Multi->FrameEvent);
+	}
+	
+	return true;
+}
+
+// @Note Body of a worker thread, never returns
+internal void RunOutputWorker(output_worker *Worker, u32 TimeoutMS)
+{
+	multi_output_source *Multi = Worker->Multi;
+	for (;;)
+	{
+		// @Note The flags are set before the event, if one lands between the check and the wait the wait returns straight away
+		bool IsIdle = Worker->HoldingFrame ? !AtomicLoadU32(&Worker->ReleaseRequested) : !AtomicLoadU32(&Worker->IsSelected);
+		if (IsIdle)
+		{
+			Multi->WaitEvent(Worker->WakeEvent, TimeoutMS);
+		}
+		
+		StepOutputWorker(Worker, TimeoutMS);
+	}
+}
+
+// @Note A notice from a worker with a capture ring may be for a copy that was taken along with an earlier one
+internal bool PopMultiOutputFrame(multi_output_source *Multi, captured_frame *Frame)
+{
+	for (;;)
+	{
+		captured_frame *Next = PopOutputFrame(&Multi->Queue);
+		if (!Next)
+		{
+			return false;
+		}
+		
+		output_worker *Worker = NULL;
+		for (u32 WorkerIndex = 0; WorkerIndex < Multi->WorkerCount; ++WorkerIndex)
+		{
+			if (Next == &Multi->Workers[WorkerIndex].Frame)
+			{
+				Worker = &Multi->Workers[WorkerIndex];
+			}
+		}
+		
+		if (!Worker->CaptureRing)
+		{
+			*Frame = *Next;
+			return true;
+		}
+		
+		// @Note Cleared before the take, a copy that lands after it queues a notice of its own
+		AtomicStoreU32(&Worker->NoticeIsQueued, 0);
+		if (TakeCaptureRing(Worker->CaptureRing, Frame))
+		{
+			Frame->OutputIndex = Worker->OutputIndex;
+			return true;
+		}
+	}
+}
+
+internal FRAME_SOURCE_ACQUIRE(MultiOutputAcquire)
+{
+	multi_output_source *Multi = (multi_output_source *)Context;
+	
+	bool HaveFrame = PopMultiOutputFrame(Multi, Frame);
+	if (!HaveFrame)
+	{
+		if (Multi->WaitEvent)
+		{
+			Multi->WaitEvent(Multi->FrameEvent, TimeoutMS);
+		}
+		else
+		{
+			for (u32 WorkerIndex = 0; WorkerIndex < Multi->WorkerCount; ++WorkerIndex)
+			{
+				StepOutputWorker(&Multi->Workers[WorkerIndex], TimeoutMS);
+			}
+		}
+		
+		HaveFrame = PopMultiOutputFrame(Multi, Frame);
+	}
+	
+	if (!HaveFrame)
+	{
+		return AcquireResult_Timeout;
+	}
+	
+	++Multi->FrameCount[Frame->OutputIndex];
+	
+	return AcquireResult_Frame;
+}
+
+// @Note Losing the output on release shows up as a reset on its next frame. A copy from a capture ring
+// was released already and stays the render thread's until it takes the next one.
+internal FRAME_SOURCE_RELEASE(MultiOutputRelease)
+{
+	multi_output_source *Multi = (multi_output_source *)Context;
+	output_worker *Worker = &Multi->Workers[Frame->OutputIndex];
+	if (Worker->CaptureRing)
+	{
+		return true;
+	}
+	
+	AtomicStoreU32(&Worker->ReleaseRequested, 1);
+	WakeOutputWorker(Multi, Worker);
+	
+	return true;
+}
+
+internal FRAME_SOURCE_INVALIDATE(MultiOutputInvalidate)
+{
+	multi_output_source *Multi = (multi_output_source *)Context;
+	for (u32 WorkerIndex = 0; WorkerIndex < Multi->WorkerCount; ++WorkerIndex)
+	{
+		if (OutputMask & (1u << WorkerIndex))
+		{
+			output_worker *Worker = &Multi->Workers[WorkerIndex];
+			AtomicStoreU32(&Worker->InvalidateRequested, 1);
+			WakeOutputWorker(Multi, Worker);
+		}
+	}
+}
+
+internal FRAME_SOURCE_SELECT(MultiOutputSelect)
+{
+	multi_output_source *Multi = (multi_output_source *)Context;
+	for (u32 WorkerIndex = 0; WorkerIndex < Multi->WorkerCount; ++WorkerIndex)
+	{
+		output_worker *Worker = &Multi->Workers[WorkerIndex];
+		u32 IsSelected = (OutputMask >> WorkerIndex) & 1;
+		
+		if (AtomicLoadU32(&Worker->IsSelected) != IsSelected)
+		{
+			AtomicStoreU32(&Worker->IsSelected, IsSelected);
+			WakeOutputWorker(Multi, Worker);
+		}
+	}
+}
+
+internal frame_source MultiOutputFrameSource(multi_output_source *Multi)
+{
+	frame_source Result;
+	Result.Context    = Multi;
+	Result.Acquire    = MultiOutputAcquire;
+	Result.Release    = MultiOutputRelease;
+	Result.Invalidate = MultiOutputInvalidate;
+	Result.Select     = MultiOutputSelect;
+	
+	return Result;
+}
@@ -0,0 +1,117 @@
+//
+// Frame pacing: when the render thread may present what it cropped
+//
+// @Note Every frame still gets cropped as it arrives, only the present waits for its turn. If a newer
+// frame lands before then it replaces the waiting one, which is dropped, so a source running faster
+// than the cap costs copies but never queues anything up. Time only comes in through the arguments,
+// the pipeline passes in its overlay_clock.
+//
+
+// @Note A frame this much of an interval early still goes, so jitter in the source doesn't cost it a whole interval
+#define PACING_SLACK_DIVISOR 4
+
+// @Note Desktop updates further apart than this are the desktop going still, not its rate
+#define PACING_SOURCE_GAP 250000
+
+internal void UpdatePacingParams(frame_pacer *Pacer, pacing_params Params)
+{
+	if ((Pacer->Params.Mode == Params.Mode) && (Pacer->Params.CapRate == Params.CapRate))
+	{
+		return;
+	}
+	
+	Pacer->Params          = Params;
+	Pacer->CapInterval     = (Params.CapRate > 0) ? (1000000 / Params.CapRate) : 0;
+	Pacer->NextPresentTime = 0;
+}
+
+// Microseconds between presents the mode is after, zero is as soon as there is something to show
+internal u64 GetPacingInterval(frame_pacer *Pacer)
+{
+	u64 Interval = 0;
+	if (Pacer->Params.Mode == PacingMode_FixedCap)
+	{
+		Interval = Pacer->CapInterval;
+	}
+	else if (Pacer->Params.Mode == PacingMode_MatchSource)
+	{
+		Interval = Pacer->SourceInterval;
+	}
+	
+	return Interval;
+}
+
+// @Note Call with the time a frame with a desktop update was acquired
+internal void NoteSourceFrame(frame_pacer *Pacer, u64 Now)
+{
+	if (Pacer->LastSourceTime)
+	{
+		u64 Delta = Now - Pacer->LastSourceTime;
+		if (Delta < PACING_SOURCE_GAP)
+		{
+			// @Note Moves an eighth of the way each update, a single late frame barely shifts it
+			if (Pacer->SourceInterval == 0)
+			{
+				Pacer->SourceInterval = Delta;
+			}
+			else
+			{
+				Pacer->SourceInterval = Pacer->SourceInterval - Pacer->SourceInterval / 8 + Delta / 8;
+			}
+		}
+	}
+	
+	Pacer->LastSourceTime = Now;
+}
+
+// Microseconds until a present is allowed, zero if it is now
+internal u64 GetPresentDelay(frame_pacer *Pacer, u64 Now)
+{
+	u64 Interval = GetPacingInterval(Pacer);
+	u64 Slack    = Interval / PACING_SLACK_DIVISOR;
+	
+	if ((Interval == 0) || (Now + Slack >= Pacer->NextPresentTime))
+	{
+		return 0;
+	}
+	
+	return Pacer->NextPresentTime - Slack - Now;
+}
+
+// @Note Call with the time Present returned
+internal void NotePresent(frame_pacer *Pacer, u64 Now)
+{
+	u64 Interval = GetPacingInterval(Pacer);
+	
+	// @Note A gap of two intervals or more is nothing to show, not the pacing being off
+	if (Interval && Pacer->LastPresentTime)
+	{
+		u64 Actual = Now - Pacer->LastPresentTime;
+		if (Actual < 2 * Interval)
+		{
+			u64 Jitter = (Actual > Interval) ? (Actual - Interval) : (Interval - Actual);
+			
+			++Pacer->JitterCount;
+			Pacer->JitterTotal += Jitter;
+			Pacer->JitterMax    = Max(Pacer->JitterMax, Jitter);
+		}
+	}
+	
+	Pacer->LastPresentTime = Now;
+	
+	// @Note Stay on the beat while presents land close to it, start a new one after falling behind
+	if (Interval && (Now <= Pacer->NextPresentTime + Interval / PACING_SLACK_DIVISOR))
+	{
+		Pacer->NextPresentTime += Interval;
+	}
+	else
+	{
+		Pacer->NextPresentTime = Now + Interval;
+	}
+}
+
+inline const char *GetPacingModeName(pacing_mode Mode)
+{
+	const char *Names[PacingMode_Count] = { "lowest latency", "fixed cap", "match source" };
+	return (Mode < PacingMode_Count) ? Names[Mode] : "unknown";
+}
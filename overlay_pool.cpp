@@ -0,0 +1,143 @@
+//
+// Display texture pool
+//
+// @Note The display texture is exactly the size of the cut box. Dragging between a few regions
+// is the common case, so the last few sizes stay allocated and switching back costs nothing.
+//
+
+#define TEXTURE_POOL_SIZE 4
+
+struct pooled_texture
+{
+	// @Note Backend objects, ID3D11Texture2D + ID3D11ShaderResourceView or bitmap memory.
+	// Target is the ID3D11RenderTargetView an HDR crop draws through, NULL for the software backend.
+	void *Handle;
+	void *View;
+	void *Target;
+	
+	int Width;
+	int Height;
+	
+	u64 LastUsed;
+};
+
+#define TEXTURE_POOL_CREATE(Name) bool Name(void *Context, pooled_texture *Texture)
+typedef TEXTURE_POOL_CREATE(texture_pool_create);
+
+#define TEXTURE_POOL_DESTROY(Name) void Name(void *Context, pooled_texture *Texture)
+typedef TEXTURE_POOL_DESTROY(texture_pool_destroy);
+
+struct texture_pool
+{
+	void *Context;
+	
+	texture_pool_create  *Create;
+	texture_pool_destroy *Destroy;
+	
+	int BytesPerPixel;
+	bool HasMipChain; // Every level down to 1x1 is allocated with the texture, ScaleMode_Mip samples them
+	
+	u32 EntryCount;
+	pooled_texture Entries[TEXTURE_POOL_SIZE];
+	
+	u64 UseCounter;
+	
+	u64 PooledBytes;
+	u32 AllocationCount;
+	u32 ReuseCount;
+};
+
+internal void InitializeTexturePool(texture_pool *Pool, void *Context, texture_pool_create *Create, texture_pool_destroy *Destroy, int BytesPerPixel,
+									 bool HasMipChain)
+{
+	*Pool = {};
+	Pool->Context       = Context;
+	Pool->Create        = Create;
+	Pool->Destroy       = Destroy;
+	Pool->BytesPerPixel = BytesPerPixel;
+	Pool->HasMipChain   = HasMipChain;
+}
+
+// @Note Each level is half the last rounded down and at least 1, the chain comes to about a third on top of level 0
+internal u64 GetTextureBytes(texture_pool *Pool, int Width, int Height)
+{
+	u64 Bytes = (u64)Width * Height * Pool->BytesPerPixel;
+	while (Pool->HasMipChain && ((Width > 1) || (Height > 1)))
+	{
+		Width  = Max(Width  / 2, 1);
+		Height = Max(Height / 2, 1);
+		Bytes += (u64)Width * Height * Pool->BytesPerPixel;
+	}
+	
+	return Bytes;
+}
+
+// Returns a texture of exactly Width x Height, or NULL if the backend couldn't make one
+internal pooled_texture *GetPooledTexture(texture_pool *Pool, int Width, int Height)
+{
+	++Pool->UseCounter;
+	
+	for (u32 EntryIndex = 0; EntryIndex < Pool->EntryCount; ++EntryIndex)
+	{
+		pooled_texture *Entry = &Pool->Entries[EntryIndex];
+		if ((Entry->Width == Width) && (Entry->Height == Height))
+		{
+			Entry->LastUsed = Pool->UseCounter;
+			++Pool->ReuseCount;
+			
+			return Entry;
+		}
+	}
+	
+	pooled_texture *Entry;
+	if (Pool->EntryCount < TEXTURE_POOL_SIZE)
+	{
+		Entry = &Pool->Entries[Pool->EntryCount++];
+	}
+	else
+	{
+		// @Note Evict the least recently used one, the one in use is always the most recent
+		Entry = &Pool->Entries[0];
+		for (u32 EntryIndex = 1; EntryIndex < Pool->EntryCount; ++EntryIndex)
+		{
+			if (Pool->Entries[EntryIndex].LastUsed < Entry->LastUsed)
+			{
+				Entry = &Pool->Entries[EntryIndex];
+			}
+		}
+		
+		Pool->Destroy(Pool->Context, Entry);
+		Pool->PooledBytes -= GetTextureBytes(Pool, Entry->Width, Entry->Height);
+	}
+	
+	Entry->Handle   = NULL;
+	Entry->View     = NULL;
+	Entry->Target   = NULL;
+	Entry->Width    = Width;
+	Entry->Height   = Height;
+	Entry->LastUsed = Pool->UseCounter;
+	
+	if (!Pool->Create(Pool->Context, Entry))
+	{
+		// @Note Give the slot back, it holds nothing now
+		*Entry = Pool->Entries[--Pool->EntryCount];
+		return NULL;
+	}
+	
+	Pool->PooledBytes += GetTextureBytes(Pool, Width, Height);
+	++Pool->AllocationCount;
+	
+	return Entry;
+}
+
+// @Note Everything goes, the textures belong to a device that is about to go away
+internal void ReleaseTexturePool(texture_pool *Pool)
+{
+	for (u32 EntryIndex = 0; EntryIndex < Pool->EntryCount; ++EntryIndex)
+	{
+		Pool->Destroy(Pool->Context, &Pool->Entries[EntryIndex]);
+	}
+	
+	Pool->EntryCount  = 0;
+	Pool->PooledBytes = 0;
+}
@@ -0,0 +1,148 @@
+//
+// Window thread -> render thread commands, single producer single consumer ring
+//
+// @Note The render state itself goes through the exchange, commands only wake the render thread
+// up and carry the time they were issued so we can tell how long it took to get them on screen.
+//
+
+#define RENDER_COMMAND_QUEUE_SIZE 64 // Must be a power of two
+
+enum render_command_type
+{
+	RenderCommand_StateChanged,
+};
+
+struct render_command
+{
+	render_command_type Type;
+	u64 IssueTime; // Microseconds, overlay_clock
+};
+
+struct render_command_queue
+{
+	render_command Commands[RENDER_COMMAND_QUEUE_SIZE];
+	
+	// @Note Free running counters, each side only ever writes its own one
+	alignas(64) u32 volatile WriteCount;
+	alignas(64) u32 volatile ReadCount;
+};
+
+// @Note Producer side. When the queue is full the command is dropped, the render
+// thread is already behind and picks up the newest state with the commands it has.
+internal bool PushRenderCommand(render_command_queue *Queue, render_command Command)
+{
+	u32 WriteCount = Queue->WriteCount;
+	u32 ReadCount  = AtomicLoadU32(&Queue->ReadCount);
+	if ((WriteCount - ReadCount) == RENDER_COMMAND_QUEUE_SIZE)
+	{
+		return false;
+	}
+	
+	Queue->Commands[WriteCount & (RENDER_COMMAND_QUEUE_SIZE - 1)] = Command;
+	AtomicStoreU32(&Queue->WriteCount, WriteCount + 1);
+	
+	return true;
+}
+
+// @Note Consumer side
+internal bool PopRenderCommand(render_command_queue *Queue, render_command *Command)
+{
+	u32 ReadCount  = Queue->ReadCount;
+	u32 WriteCount = AtomicLoadU32(&Queue->WriteCount);
+	if (ReadCount == WriteCount)
+	{
+		return false;
+	}
+	
+	*Command = Queue->Commands[ReadCount & (RENDER_COMMAND_QUEUE_SIZE - 1)];
+	AtomicStoreU32(&Queue->ReadCount, ReadCount + 1);
+	
+	return true;
+}
+
+//
+// Output workers -> render thread frames, multiple producer single consumer bounded ring
+//
+// @Note Every cell carries a sequence number: Index when it is free for the write with that index,
+// Index + 1 once that write is done. Producers claim an index with a compare exchange and only
+// touch their own cell, so a worker that stalls mid push never blocks the others.
+//
+
+#define OUTPUT_FRAME_QUEUE_SIZE 8 // Must be a power of two
+
+struct output_frame_cell
+{
+	u32 volatile Sequence;
+	captured_frame *Frame;
+};
+
+struct output_frame_queue
+{
+	output_frame_cell Cells[OUTPUT_FRAME_QUEUE_SIZE];
+	
+	alignas(64) u32 volatile WriteCount;
+	alignas(64) u32 ReadCount;
+};
+
+internal void InitializeOutputFrameQueue(output_frame_queue *Queue)
+{
+	for (u32 CellIndex = 0; CellIndex < OUTPUT_FRAME_QUEUE_SIZE; ++CellIndex)
+	{
+		Queue->Cells[CellIndex].Sequence = CellIndex;
+		Queue->Cells[CellIndex].Frame    = NULL;
+	}
+	
+	Queue->WriteCount = 0;
+	Queue->ReadCount  = 0;
+}
+
+// @Note Producer side, any thread. False when the queue is full.
+internal bool PushOutputFrame(output_frame_queue *Queue, captured_frame *Frame)
+{
+	u32 WriteCount = AtomicLoadU32(&Queue->WriteCount);
+	for (;;)
+	{
+		output_frame_cell *Cell = &Queue->Cells[WriteCount & (OUTPUT_FRAME_QUEUE_SIZE - 1)];
+		s32 Difference = (s32)(AtomicLoadU32(&Cell->Sequence) - WriteCount);
+		
+		if (Difference == 0)
+		{
+			u32 Previous = AtomicCompareExchangeU32(&Queue->WriteCount, WriteCount + 1, WriteCount);
+			if (Previous == WriteCount)
+			{
+				Cell->Frame = Frame;
+				AtomicStoreU32(&Cell->Sequence, WriteCount + 1);
+				return true;
+			}
+			
+			WriteCount = Previous;
+		}
+		else if (Difference < 0)
+		{
+			// The reader hasn't got to this cell since the last lap
+			return false;
+		}
+		else
+		{
+			// Another producer got this index first
+			WriteCount = AtomicLoadU32(&Queue->WriteCount);
+		}
+	}
+}
+
+// @Note Consumer side, the render thread only
+internal captured_frame *PopOutputFrame(output_frame_queue *Queue)
+{
+	u32 ReadCount = Queue->ReadCount;
+	output_frame_cell *Cell = &Queue->Cells[ReadCount & (OUTPUT_FRAME_QUEUE_SIZE - 1)];
+	if (AtomicLoadU32(&Cell->Sequence) != ReadCount + 1)
+	{
+		return NULL;
+	}
+	
+	captured_frame *Frame = Cell->Frame;
+	AtomicStoreU32(&Cell->Sequence, ReadCount + OUTPUT_FRAME_QUEUE_SIZE);
+	Queue->ReadCount = ReadCount + 1;
+	
+	return Frame;
+}
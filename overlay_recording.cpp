@@ -0,0 +1,873 @@
+//
+// Recording: the display texture frame by frame, as tile deltas, and a reader that can seek in it
+//
+// @Note A file is a recording_header then frames back to back. A frame is a recording_frame_header,
+// the layout if it changed (the shade setups, enough to draw the frame again exactly as it was), one
+// byte per tile saying what became of it, then the data of the tiles that changed. Keyframes have every
+// tile and the layout, so reading can start at any of them. Everything is little-endian as written.
+//
+// A changed tile is a list of runs, a byte of op and length then the pixels if the op needs any.
+// Runs that repeat the previous frame or the row above cost that one byte, which is most of what
+// changes between two frames of a desktop. A tile that doesn't get any smaller is stored as it is.
+//
+
+#define RECORDING_MAGIC       0x4352564F // "OVRC"
+#define RECORDING_FRAME_MAGIC 0x4D415246 // "FRAM"
+#define RECORDING_VERSION     3 // 2: Darken is in linear light, 3: the effect chain
+
+#define RECORDING_TILE_SIZE 32
+
+// @Note Frames between keyframes, what a seek decodes at most
+#define RECORDING_KEYFRAME_INTERVAL 300
+
+enum recording_frame_flags
+{
+	RecordingFrame_Keyframe  = 0x1,
+	RecordingFrame_HasLayout = 0x2,
+};
+
+enum recording_tile_type
+{
+	RecordingTile_Same,    // As the previous frame left it
+	RecordingTile_Encoded, // u32 size, then runs
+	RecordingTile_Raw,     // Every pixel, row after row
+};
+
+// @Note Top two bits of a run's first byte, the low six are the length less one
+enum recording_run_op
+{
+	RecordingRun_Literal,  // The pixels follow
+	RecordingRun_Repeat,   // One pixel follows, that many times
+	RecordingRun_Previous, // Same as the previous frame
+	RecordingRun_Above,    // Same as the pixel a row up in this tile
+};
+
+#define RECORDING_MAX_RUN 64
+
+struct recording_header
+{
+	u32 Magic;
+	u32 Version;
+	u32 TileSize;
+	u32 KeyframeInterval;
+};
+
+struct recording_frame_header
+{
+	u32 Magic;
+	u32 Size; // Header included
+	u64 Timestamp;
+	
+	// @Note The display texture, and the back buffer it was drawn into
+	u16 Width;
+	u16 Height;
+	u16 TargetWidth;
+	u16 TargetHeight;
+	
+	u8 Flags;
+	u8 PieceCount;
+	u8 ScaleMode; // Goes with the layout
+	u8 Pad;
+	u32 ChangedTileCount;
+};
+
+// @Note A shade_setup without the texture, all four byte fields so it has no padding anywhere
+struct recording_piece
+{
+	s32 Left;
+	s32 Top;
+	s32 Right;
+	s32 Bottom;
+	
+	float U;
+	float V;
+	float StepU;
+	float StepV;
+	float StepUY;
+	float StepVY;
+	
+	float MinU;
+	float MinV;
+	float MaxU;
+	float MaxV;
+	s32 LastX;
+	s32 LastY;
+	
+	float Alpha;
+	float Darken; // Linear, as the shade row has it
+	
+	u32 EffectKey;
+	effect_constants Effects;
+};
+
+internal recording_piece PackRecordingPiece(shade_setup *Setup)
+{
+	recording_piece Piece;
+	Piece.Left   = Setup->Rect.Left;
+	Piece.Top    = Setup->Rect.Top;
+	Piece.Right  = Setup->Rect.Right;
+	Piece.Bottom = Setup->Rect.Bottom;
+	Piece.U      = Setup->Row.U;
+	Piece.V      = Setup->Row.V;
+	Piece.StepU  = Setup->Row.StepU;
+	Piece.StepV  = Setup->Row.StepV;
+	Piece.StepUY = Setup->StepUY;
+	Piece.StepVY = Setup->StepVY;
+	Piece.MinU   = Setup->Row.MinU;
+	Piece.MinV   = Setup->Row.MinV;
+	Piece.MaxU   = Setup->Row.MaxU;
+	Piece.MaxV   = Setup->Row.MaxV;
+	Piece.LastX  = Setup->Row.LastX;
+	Piece.LastY  = Setup->Row.LastY;
+	Piece.Alpha  = Setup->Row.Alpha;
+	Piece.Darken = Setup->Row.Darken;
+	
+	Piece.EffectKey = Setup->Row.EffectKey;
+	Piece.Effects   = Setup->Row.Effects;
+	
+	return Piece;
+}
+
+internal shade_setup UnpackRecordingPiece(recording_piece *Piece, bitmap *Texture)
+{
+	shade_setup Setup;
+	Setup.Rect          = box{ Piece->Left, Piece->Top, Piece->Right, Piece->Bottom };
+	Setup.Row.Texels    = Texture->Memory;
+	Setup.Row.Pitch     = Texture->Pitch;
+	Setup.Row.U         = Piece->U;
+	Setup.Row.V         = Piece->V;
+	Setup.Row.StepU     = Piece->StepU;
+	Setup.Row.StepV     = Piece->StepV;
+	Setup.Row.MinU      = Piece->MinU;
+	Setup.Row.MinV      = Piece->MinV;
+	Setup.Row.MaxU      = Piece->MaxU;
+	Setup.Row.MaxV      = Piece->MaxV;
+	Setup.Row.LastX     = Piece->LastX;
+	Setup.Row.LastY     = Piece->LastY;
+	Setup.Row.Alpha     = Piece->Alpha;
+	Setup.Row.Darken    = Piece->Darken;
+	Setup.Row.AlphaByte = UnitToByte(Piece->Alpha);
+	Setup.Row.EffectKey = Piece->EffectKey & (EffectKey_Count - 1);
+	Setup.Row.Effects   = Piece->Effects;
+	Setup.StepUY        = Piece->StepUY;
+	Setup.StepVY        = Piece->StepVY;
+	
+	return Setup;
+}
+
+inline bool BytesAreEqual(void *A, void *B, size_t Size)
+{
+	u8 *BytesA = (u8 *)A;
+	u8 *BytesB = (u8 *)B;
+	for (size_t Index = 0; Index < Size; ++Index)
+	{
+		if (BytesA[Index] != BytesB[Index])
+		{
+			return false;
+		}
+	}
+	
+	return true;
+}
+
+inline u32 GetRecordingTileCount(int Width, int Height)
+{
+	u32 Across = (u32)(Width  + RECORDING_TILE_SIZE - 1) / RECORDING_TILE_SIZE;
+	u32 Down   = (u32)(Height + RECORDING_TILE_SIZE - 1) / RECORDING_TILE_SIZE;
+	return Across * Down;
+}
+
+inline box GetRecordingTile(int Width, int Height, u32 TileIndex)
+{
+	u32 Across = (u32)(Width + RECORDING_TILE_SIZE - 1) / RECORDING_TILE_SIZE;
+	
+	box Tile;
+	Tile.Left   = (int)(TileIndex % Across) * RECORDING_TILE_SIZE;
+	Tile.Top    = (int)(TileIndex / Across) * RECORDING_TILE_SIZE;
+	Tile.Right  = Min(Tile.Left + RECORDING_TILE_SIZE, Width);
+	Tile.Bottom = Min(Tile.Top  + RECORDING_TILE_SIZE, Height);
+	
+	return Tile;
+}
+
+//
+// Writer
+//
+
+struct recording_writer
+{
+	platform_allocate_memory *AllocateMemory;
+	platform_free_memory     *FreeMemory;
+	
+	// @Note What the reader will have after the last frame, the deltas are against this
+	bitmap Previous;
+	
+	// @Note One frame, sized for the worst case of the current texture size
+	u8 *Buffer;
+	size_t BufferSize;
+	
+	u32 FramesSinceKeyframe;
+	u32 PieceCount;
+	recording_piece Pieces[MAX_CROP_PIECES];
+	scale_mode ScaleMode;
+	int TargetWidth;
+	int TargetHeight;
+	
+	u64 FrameCount;
+	u64 KeyframeCount;
+	u64 ByteCount;
+	u64 SameTileCount;
+	u64 EncodedTileCount;
+	u64 RawTileCount;
+};
+
+internal void InitializeRecordingWriter(recording_writer *Writer, platform_allocate_memory *AllocateMemory, platform_free_memory *FreeMemory)
+{
+	*Writer = {};
+	Writer->AllocateMemory = AllocateMemory;
+	Writer->FreeMemory     = FreeMemory;
+}
+
+internal recording_header GetRecordingHeader()
+{
+	recording_header Header;
+	Header.Magic            = RECORDING_MAGIC;
+	Header.Version          = RECORDING_VERSION;
+	Header.TileSize         = RECORDING_TILE_SIZE;
+	Header.KeyframeInterval = RECORDING_KEYFRAME_INTERVAL;
+	
+	return Header;
+}
+
+inline size_t GetRecordingFrameBound(int Width, int Height)
+{
+	u32 TileCount = GetRecordingTileCount(Width, Height);
+	return sizeof(recording_frame_header) + MAX_CROP_PIECES * sizeof(recording_piece) +
+		TileCount * (1 + sizeof(u32)) + (size_t)Width * Height * BITMAP_BYTES_PER_PIXEL;
+}
+
+// @Note Only a texture of a new size allocates, and then everything after it is a keyframe
+internal bool ResizeRecordingWriter(recording_writer *Writer, int Width, int Height)
+{
+	bitmap *Previous = &Writer->Previous;
+	if ((Previous->Width == Width) && (Previous->Height == Height))
+	{
+		return true;
+	}
+	
+	if (Previous->Memory)
+	{
+		Writer->FreeMemory(Previous->Memory, (size_t)Previous->Pitch * Previous->Height);
+		Writer->FreeMemory(Writer->Buffer, Writer->BufferSize);
+	}
+	
+	Previous->Width  = Width;
+	Previous->Height = Height;
+	Previous->Pitch  = Width * BITMAP_BYTES_PER_PIXEL;
+	Previous->Memory = (u8 *)Writer->AllocateMemory((size_t)Previous->Pitch * Height);
+	
+	Writer->BufferSize = GetRecordingFrameBound(Width, Height);
+	Writer->Buffer     = (u8 *)Writer->AllocateMemory(Writer->BufferSize);
+	
+	if (!Previous->Memory || !Writer->Buffer)
+	{
+		if (Previous->Memory)
+		{
+			Writer->FreeMemory(Previous->Memory, (size_t)Previous->Pitch * Height);
+		}
+		if (Writer->Buffer)
+		{
+			Writer->FreeMemory(Writer->Buffer, Writer->BufferSize);
+		}
+		
+		*Previous = {};
+		Writer->Buffer     = NULL;
+		Writer->BufferSize = 0;
+		return false;
+	}
+	
+	return true;
+}
+
+// @Note Packs a tile's rows one after the other, so the runs can go straight across row ends
+internal void GatherRecordingTile(bitmap *Image, box Tile, u32 *Pixels)
+{
+	size_t RowSize = (size_t)GetBoxWidth(Tile) * BITMAP_BYTES_PER_PIXEL;
+	for (int Y = Tile.Top; Y < Tile.Bottom; ++Y)
+	{
+		CopyBytes(Pixels, Image->Memory + (size_t)Y * Image->Pitch + (size_t)Tile.Left * BITMAP_BYTES_PER_PIXEL, RowSize);
+		Pixels += GetBoxWidth(Tile);
+	}
+}
+
+// Returns the bytes written to Out, or zero if the runs came out no smaller than the raw tile
+internal size_t EncodeRecordingTile(bitmap *Image, bitmap *Previous, box Tile, bool HasPrevious, u8 *Out)
+{
+	int Width      = GetBoxWidth(Tile);
+	int PixelCount = Width * GetBoxHeight(Tile);
+	size_t RawSize = (size_t)PixelCount * BITMAP_BYTES_PER_PIXEL;
+	
+	u32 Current[RECORDING_TILE_SIZE * RECORDING_TILE_SIZE];
+	u32 Before[RECORDING_TILE_SIZE * RECORDING_TILE_SIZE];
+	GatherRecordingTile(Image, Tile, Current);
+	if (HasPrevious)
+	{
+		GatherRecordingTile(Previous, Tile, Before);
+	}
+	
+	size_t Used = 0;
+	size_t LiteralHeader = 0;
+	bool InLiteral = false;
+	
+	int Index = 0;
+	while (Index < PixelCount)
+	{
+		u32 Pixel = Current[Index];
+		int Limit = Min(PixelCount - Index, RECORDING_MAX_RUN);
+		
+		int PreviousRun = 0;
+		if (HasPrevious)
+		{
+			while ((PreviousRun < Limit) && (Current[Index + PreviousRun] == Before[Index + PreviousRun]))
+			{
+				++PreviousRun;
+			}
+		}
+		
+		int AboveRun = 0;
+		if (Index >= Width)
+		{
+			while ((AboveRun < Limit) && (Current[Index + AboveRun] == Current[Index + AboveRun - Width]))
+			{
+				++AboveRun;
+			}
+		}
+		
+		int RepeatRun = 1;
+		while ((RepeatRun < Limit) && (Current[Index + RepeatRun] == Pixel))
+		{
+			++RepeatRun;
+		}
+		
+		// @Note A run without pixels is worth it from one pixel on, a repeat from two
+		u8 Op = RecordingRun_Literal;
+		int Run = 1;
+		if ((PreviousRun > 0) || (AboveRun > 0))
+		{
+			Op  = (PreviousRun >= AboveRun) ? RecordingRun_Previous : RecordingRun_Above;
+			Run = Max(PreviousRun, AboveRun);
+		}
+		
+		if ((RepeatRun >= 2) && (RepeatRun > Run))
+		{
+			Op  = RecordingRun_Repeat;
+			Run = RepeatRun;
+		}
+		
+		if (Used + 1 + BITMAP_BYTES_PER_PIXEL > RawSize)
+		{
+			return 0;
+		}
+		
+		if (Op == RecordingRun_Literal)
+		{
+			// @Note Joins the literal run before it while there is room
+			if (InLiteral && ((Out[LiteralHeader] & 0x3F) < RECORDING_MAX_RUN - 1))
+			{
+				++Out[LiteralHeader];
+			}
+			else
+			{
+				LiteralHeader = Used;
+				Out[Used++] = (u8)(RecordingRun_Literal << 6);
+				InLiteral = true;
+			}
+			
+			CopyBytes(Out + Used, &Pixel, sizeof(Pixel));
+			Used += sizeof(Pixel);
+		}
+		else
+		{
+			Out[Used++] = (u8)((Op << 6) | (Run - 1));
+			if (Op == RecordingRun_Repeat)
+			{
+				CopyBytes(Out + Used, &Pixel, sizeof(Pixel));
+				Used += sizeof(Pixel);
+			}
+			
+			InLiteral = false;
+		}
+		
+		Index += Run;
+	}
+	
+	return (Used < RawSize) ? Used : 0;
+}
+
+inline bool PiecesAreEqual(recording_piece *A, recording_piece *B, u32 Count)
+{
+	return BytesAreEqual(A, B, Count * sizeof(recording_piece));
+}
+
+//
+// One frame into Writer->Buffer, returns its size. Zero if there was no memory for a texture this size.
+//
+// @Note Setups are what the frame was drawn with, scaled that way into a target of that size. Their texels are ignored.
+//
+internal size_t EncodeRecordingFrame(recording_writer *Writer, bitmap *Image, u64 Timestamp, shade_setup *Setups, u32 SetupCount,
+									 scale_mode ScaleMode, int TargetWidth, int TargetHeight)
+{
+	bool Resized = (Writer->Previous.Width != Image->Width) || (Writer->Previous.Height != Image->Height);
+	if (!ResizeRecordingWriter(Writer, Image->Width, Image->Height))
+	{
+		return 0;
+	}
+	
+	bool IsKeyframe = Resized || (Writer->FrameCount == 0) || (Writer->FramesSinceKeyframe + 1 >= RECORDING_KEYFRAME_INTERVAL);
+	
+	recording_piece Pieces[MAX_CROP_PIECES];
+	u32 PieceCount = Min(SetupCount, (u32)MAX_CROP_PIECES);
+	for (u32 PieceIndex = 0; PieceIndex < PieceCount; ++PieceIndex)
+	{
+		Pieces[PieceIndex] = PackRecordingPiece(&Setups[PieceIndex]);
+	}
+	
+	bool LayoutChanged = (PieceCount != Writer->PieceCount) || (ScaleMode != Writer->ScaleMode) || (TargetWidth != Writer->TargetWidth) ||
+		(TargetHeight != Writer->TargetHeight) || !PiecesAreEqual(Pieces, Writer->Pieces, PieceCount);
+	bool HasLayout = IsKeyframe || LayoutChanged;
+	
+	u8 *Out = Writer->Buffer;
+	size_t Used = sizeof(recording_frame_header);
+	
+	if (HasLayout)
+	{
+		CopyBytes(Out + Used, Pieces, PieceCount * sizeof(recording_piece));
+		Used += PieceCount * sizeof(recording_piece);
+		
+		CopyBytes(Writer->Pieces, Pieces, PieceCount * sizeof(recording_piece));
+		Writer->PieceCount   = PieceCount;
+		Writer->ScaleMode    = ScaleMode;
+		Writer->TargetWidth  = TargetWidth;
+		Writer->TargetHeight = TargetHeight;
+	}
+	
+	u32 TileCount = GetRecordingTileCount(Image->Width, Image->Height);
+	u8 *TileTypes = Out + Used;
+	Used += TileCount;
+	
+	u32 ChangedTileCount = 0;
+	for (u32 TileIndex = 0; TileIndex < TileCount; ++TileIndex)
+	{
+		box Tile = GetRecordingTile(Image->Width, Image->Height, TileIndex);
+		size_t RowSize = (size_t)GetBoxWidth(Tile) * BITMAP_BYTES_PER_PIXEL;
+		
+		bool IsSame = !IsKeyframe;
+		for (int Y = Tile.Top; IsSame && (Y < Tile.Bottom); ++Y)
+		{
+			size_t Offset = (size_t)Y * Image->Pitch + (size_t)Tile.Left * BITMAP_BYTES_PER_PIXEL;
+			IsSame = BytesAreEqual(Image->Memory + Offset, Writer->Previous.Memory + Offset, RowSize);
+		}
+		
+		if (IsSame)
+		{
+			TileTypes[TileIndex] = RecordingTile_Same;
+			++Writer->SameTileCount;
+			continue;
+		}
+		
+		++ChangedTileCount;
+		
+		size_t EncodedSize = EncodeRecordingTile(Image, &Writer->Previous, Tile, !IsKeyframe, Out + Used + sizeof(u32));
+		if (EncodedSize)
+		{
+			u32 Size = (u32)EncodedSize;
+			CopyBytes(Out + Used, &Size, sizeof(Size));
+			Used += sizeof(Size) + EncodedSize;
+			
+			TileTypes[TileIndex] = RecordingTile_Encoded;
+			++Writer->EncodedTileCount;
+		}
+		else
+		{
+			for (int Y = Tile.Top; Y < Tile.Bottom; ++Y)
+			{
+				CopyBytes(Out + Used, Image->Memory + (size_t)Y * Image->Pitch + (size_t)Tile.Left * BITMAP_BYTES_PER_PIXEL, RowSize);
+				Used += RowSize;
+			}
+			
+			TileTypes[TileIndex] = RecordingTile_Raw;
+			++Writer->RawTileCount;
+		}
+		
+		// @Note The reader's copy moves on with every tile it gets
+		for (int Y = Tile.Top; Y < Tile.Bottom; ++Y)
+		{
+			size_t Offset = (size_t)Y * Image->Pitch + (size_t)Tile.Left * BITMAP_BYTES_PER_PIXEL;
+			CopyBytes(Writer->Previous.Memory + Offset, Image->Memory + Offset, RowSize);
+		}
+	}
+	
+	recording_frame_header Header;
+	Header.Magic            = RECORDING_FRAME_MAGIC;
+	Header.Size             = (u32)Used;
+	Header.Timestamp        = Timestamp;
+	Header.Width            = (u16)Image->Width;
+	Header.Height           = (u16)Image->Height;
+	Header.TargetWidth      = (u16)TargetWidth;
+	Header.TargetHeight     = (u16)TargetHeight;
+	Header.Flags            = (u8)((IsKeyframe ? RecordingFrame_Keyframe : 0) | (HasLayout ? RecordingFrame_HasLayout : 0));
+	Header.PieceCount       = (u8)PieceCount;
+	Header.ScaleMode        = (u8)ScaleMode;
+	Header.Pad              = 0;
+	Header.ChangedTileCount = ChangedTileCount;
+	CopyBytes(Out, &Header, sizeof(Header));
+	
+	Writer->FramesSinceKeyframe = IsKeyframe ? 0 : Writer->FramesSinceKeyframe + 1;
+	Writer->KeyframeCount += IsKeyframe;
+	++Writer->FrameCount;
+	Writer->ByteCount += Used;
+	
+	return Used;
+}
+
+//
+// Reader, over the whole file in memory, which is meant to be a mapping of it
+//
+// @Note Nothing in the file is trusted, every size is checked against what is left
+//
+
+struct recording_reader
+{
+	platform_allocate_memory *AllocateMemory;
+	platform_free_memory     *FreeMemory;
+	
+	u8 *Base;
+	size_t Size;
+	recording_header Header;
+	
+	u32 FrameCount;
+	u64 *FrameOffsets;
+	
+	// @Note What the last read left, frames after it only need their own deltas
+	u32 CurrentFrame;
+	bitmap Image;
+	u64 Timestamp;
+	
+	u32 PieceCount;
+	recording_piece Pieces[MAX_CROP_PIECES];
+	scale_mode ScaleMode;
+	int TargetWidth;
+	int TargetHeight;
+};
+
+#define RECORDING_NO_FRAME 0xFFFFFFFF
+
+// @Note Walks the frame headers, FrameOffsets can be NULL to only count them
+internal u32 ScanRecording(u8 *Base, size_t Size, u64 *FrameOffsets, u32 MaxFrames)
+{
+	recording_header Header;
+	if (Size < sizeof(Header))
+	{
+		return 0;
+	}
+	
+	CopyBytes(&Header, Base, sizeof(Header));
+	if ((Header.Magic != RECORDING_MAGIC) || (Header.Version != RECORDING_VERSION) || (Header.TileSize != RECORDING_TILE_SIZE))
+	{
+		return 0;
+	}
+	
+	u32 FrameCount = 0;
+	size_t Offset = sizeof(Header);
+	while (Offset + sizeof(recording_frame_header) <= Size)
+	{
+		recording_frame_header Frame;
+		CopyBytes(&Frame, Base + Offset, sizeof(Frame));
+		if ((Frame.Magic != RECORDING_FRAME_MAGIC) || (Frame.Size < sizeof(Frame)) || (Frame.Size > Size - Offset))
+		{
+			// @Note A recording cut off mid-frame still plays up to there
+			break;
+		}
+		
+		if (FrameOffsets)
+		{
+			if (FrameCount == MaxFrames)
+			{
+				break;
+			}
+			
+			FrameOffsets[FrameCount] = Offset;
+		}
+		
+		++FrameCount;
+		Offset += Frame.Size;
+	}
+	
+	return FrameCount;
+}
+
+// @Note FrameOffsets has room for ScanRecording's count
+internal bool InitializeRecordingReader(recording_reader *Reader, u8 *Base, size_t Size, u64 *FrameOffsets, u32 FrameCount,
+										platform_allocate_memory *AllocateMemory, platform_free_memory *FreeMemory)
+{
+	*Reader = {};
+	Reader->AllocateMemory = AllocateMemory;
+	Reader->FreeMemory     = FreeMemory;
+	Reader->Base           = Base;
+	Reader->Size           = Size;
+	Reader->FrameOffsets   = FrameOffsets;
+	Reader->FrameCount     = ScanRecording(Base, Size, FrameOffsets, FrameCount);
+	Reader->CurrentFrame   = RECORDING_NO_FRAME;
+	
+	if (Reader->FrameCount == 0)
+	{
+		return false;
+	}
+	
+	CopyBytes(&Reader->Header, Base, sizeof(Reader->Header));
+	return true;
+}
+
+internal bool ResizeRecordingImage(recording_reader *Reader, int Width, int Height)
+{
+	bitmap *Image = &Reader->Image;
+	if ((Image->Width == Width) && (Image->Height == Height))
+	{
+		return true;
+	}
+	
+	if (Image->Memory)
+	{
+		Reader->FreeMemory(Image->Memory, (size_t)Image->Pitch * Image->Height);
+	}
+	
+	Image->Width  = Width;
+	Image->Height = Height;
+	Image->Pitch  = Width * BITMAP_BYTES_PER_PIXEL;
+	Image->Memory = (u8 *)Reader->AllocateMemory((size_t)Image->Pitch * Height);
+	if (!Image->Memory)
+	{
+		*Image = {};
+		return false;
+	}
+	
+	return true;
+}
+
+// @Note Decodes over the image's own tile, a run from the previous frame is whatever it already holds there
+internal bool DecodeRecordingTile(bitmap *Image, box Tile, u8 *Data, size_t Size)
+{
+	int Width      = GetBoxWidth(Tile);
+	int PixelCount = Width * GetBoxHeight(Tile);
+	
+	u32 Pixels[RECORDING_TILE_SIZE * RECORDING_TILE_SIZE];
+	GatherRecordingTile(Image, Tile, Pixels);
+	
+	size_t Used = 0;
+	int Index = 0;
+	while (Index < PixelCount)
+	{
+		if (Used >= Size)
+		{
+			return false;
+		}
+		
+		u8 Op  = Data[Used] >> 6;
+		int Run = (Data[Used] & 0x3F) + 1;
+		++Used;
+		
+		if ((Index + Run > PixelCount) || ((Op == RecordingRun_Above) && (Index < Width)))
+		{
+			return false;
+		}
+		
+		size_t PixelBytes = (Op == RecordingRun_Literal) ? Run * sizeof(u32) : ((Op == RecordingRun_Repeat) ? sizeof(u32) : 0);
+		if (Used + PixelBytes > Size)
+		{
+			return false;
+		}
+		
+		if (Op == RecordingRun_Literal)
+		{
+			CopyBytes(Pixels + Index, Data + Used, PixelBytes);
+		}
+		else if (Op == RecordingRun_Repeat)
+		{
+			u32 Pixel;
+			CopyBytes(&Pixel, Data + Used, sizeof(Pixel));
+			for (int RunIndex = 0; RunIndex < Run; ++RunIndex)
+			{
+				Pixels[Index + RunIndex] = Pixel;
+			}
+		}
+		else if (Op == RecordingRun_Above)
+		{
+			for (int RunIndex = 0; RunIndex < Run; ++RunIndex)
+			{
+				Pixels[Index + RunIndex] = Pixels[Index + RunIndex - Width];
+			}
+		}
+		
+		Index += Run;
+		Used  += PixelBytes;
+	}
+	
+	if (Used != Size)
+	{
+		return false;
+	}
+	
+	size_t RowSize = (size_t)Width * BITMAP_BYTES_PER_PIXEL;
+	for (int Y = Tile.Top; Y < Tile.Bottom; ++Y)
+	{
+		CopyBytes(Image->Memory + (size_t)Y * Image->Pitch + (size_t)Tile.Left * BITMAP_BYTES_PER_PIXEL, Pixels + (Y - Tile.Top) * Width, RowSize);
+	}
+	
+	return true;
+}
+
+// @Note The image has to hold the frame before, unless this is a keyframe
+internal bool DecodeRecordingFrame(recording_reader *Reader, u32 FrameIndex)
+{
+	u8 *Data = Reader->Base + Reader->FrameOffsets[FrameIndex];
+	
+	recording_frame_header Header;
+	CopyBytes(&Header, Data, sizeof(Header));
+	size_t Size = Header.Size;
+	
+	bool IsKeyframe = (Header.Flags & RecordingFrame_Keyframe) != 0;
+	if (!IsKeyframe && ((Reader->Image.Width != Header.Width) || (Reader->Image.Height != Header.Height)))
+	{
+		return false;
+	}
+	
+	if ((Header.PieceCount > MAX_CROP_PIECES) || (Header.ScaleMode >= ScaleMode_Count) || !ResizeRecordingImage(Reader, Header.Width, Header.Height))
+	{
+		return false;
+	}
+	
+	size_t Used = sizeof(Header);
+	if (Header.Flags & RecordingFrame_HasLayout)
+	{
+		size_t LayoutSize = Header.PieceCount * sizeof(recording_piece);
+		if (Used + LayoutSize > Size)
+		{
+			return false;
+		}
+		
+		CopyBytes(Reader->Pieces, Data + Used, LayoutSize);
+		Reader->PieceCount   = Header.PieceCount;
+		Reader->ScaleMode    = (scale_mode)Header.ScaleMode;
+		Reader->TargetWidth  = Header.TargetWidth;
+		Reader->TargetHeight = Header.TargetHeight;
+		Used += LayoutSize;
+	}
+	
+	u32 TileCount = GetRecordingTileCount(Header.Width, Header.Height);
+	if (Used + TileCount > Size)
+	{
+		return false;
+	}
+	
+	u8 *TileTypes = Data + Used;
+	Used += TileCount;
+	
+	bitmap *Image = &Reader->Image;
+	for (u32 TileIndex = 0; TileIndex < TileCount; ++TileIndex)
+	{
+		box Tile = GetRecordingTile(Image->Width, Image->Height, TileIndex);
+		size_t RowSize = (size_t)GetBoxWidth(Tile) * BITMAP_BYTES_PER_PIXEL;
+		
+		if (TileTypes[TileIndex] == RecordingTile_Same)
+		{
+			if (IsKeyframe)
+			{
+				return false;
+			}
+		}
+		else if (TileTypes[TileIndex] == RecordingTile_Encoded)
+		{
+			u32 TileSize;
+			if (Used + sizeof(TileSize) > Size)
+			{
+				return false;
+			}
+			
+			CopyBytes(&TileSize, Data + Used, sizeof(TileSize));
+			Used += sizeof(TileSize);
+			
+			if ((TileSize > Size - Used) || !DecodeRecordingTile(Image, Tile, Data + Used, TileSize))
+			{
+				return false;
+			}
+			
+			Used += TileSize;
+		}
+		else if (TileTypes[TileIndex] == RecordingTile_Raw)
+		{
+			if (Used + RowSize * GetBoxHeight(Tile) > Size)
+			{
+				return false;
+			}
+			
+			for (int Y = Tile.Top; Y < Tile.Bottom; ++Y)
+			{
+				CopyBytes(Image->Memory + (size_t)Y * Image->Pitch + (size_t)Tile.Left * BITMAP_BYTES_PER_PIXEL, Data + Used, RowSize);
+				Used += RowSize;
+			}
+		}
+		else
+		{
+			return false;
+		}
+	}
+	
+	Reader->Timestamp    = Header.Timestamp;
+	Reader->CurrentFrame = FrameIndex;
+	
+	return true;
+}
+
+// Leaves frame FrameIndex in the reader's image. Returns false if the recording is damaged there.
+internal bool SeekRecording(recording_reader *Reader, u32 FrameIndex)
+{
+	if (FrameIndex >= Reader->FrameCount)
+	{
+		return false;
+	}
+	
+	if (Reader->CurrentFrame == FrameIndex)
+	{
+		return true;
+	}
+	
+	// @Note Forward from where we are if no keyframe is closer
+	u32 Start = FrameIndex;
+	while (Start > 0)
+	{
+		if ((Reader->CurrentFrame != RECORDING_NO_FRAME) && (Start == Reader->CurrentFrame + 1))
+		{
+			break;
+		}
+		
+		recording_frame_header Header;
+		CopyBytes(&Header, Reader->Base + Reader->FrameOffsets[Start], sizeof(Header));
+		if (Header.Flags & RecordingFrame_Keyframe)
+		{
+			break;
+		}
+		
+		--Start;
+	}
+	
+	for (u32 Frame = Start; Frame <= FrameIndex; ++Frame)
+	{
+		if (!DecodeRecordingFrame(Reader, Frame))
+		{
+			Reader->CurrentFrame = RECORDING_NO_FRAME;
+			return false;
+		}
+	}
+	
+	return true;
+}
@@ -0,0 +1,231 @@
+//
+// Capture ring: the capture side copies every frame into a slot of its own and gives the frame back to the
+// source straight away, the render side crops from the newest copy whenever it gets to it
+//
+// @Note The slots go through a slot_exchange, so the newest copy wins and the ones the render side never got
+// to are dropped. Only what changed gets copied: a slot is behind by everything the frames written into the
+// other slots changed, and that is copied along with this frame's changes. The render side is handed the
+// changes since the copy it took last as the dirty rects of its frame, dropped frames included.
+//
+
+// @Note Frames whose changes the render side may not have seen yet, older ones get merged past this
+#define CAPTURE_RING_HISTORY 4
+
+// Copy Regions (surface space) of the frame's surface into *Slot, which is NULL or what an earlier call put there.
+// A copy that isn't the surface's size and format is made again and copied whole. Returns false if there's no copy to be had.
+#define CAPTURE_RING_COPY(Name) bool Name(void *Context, captured_frame *Frame, void **Slot, box *Regions, u32 RegionCount)
+typedef CAPTURE_RING_COPY(capture_ring_copy);
+
+struct capture_ring_slot
+{
+	void *Surface;
+	
+	// @Note Capture side only, what changed since the last copy into this slot
+	crop_damage Missed;
+	
+	// @Note What the render side gets when it takes the slot, DirtyRects point at Changed
+	captured_frame Frame;
+	u32 Sequence;
+	box Changed[MAX_CROP_REGIONS];
+};
+
+struct capture_ring_changes
+{
+	u32 Sequence;
+	bool WasReset;
+	crop_damage Damage;
+};
+
+struct capture_ring
+{
+	slot_exchange Exchange;
+	capture_ring_slot Slots[EXCHANGE_SLOT_COUNT];
+	
+	void *CopyContext;
+	capture_ring_copy *Copy;
+	
+	// @Note Render side -> capture side, the sequence of the copy taken last. Zero before the first one.
+	alignas(64) u32 volatile TakenSequence;
+	
+	// @Note Capture side only, changes of the frames after TakenSequence, oldest first
+	u32 Sequence;
+	u32 ChangeCount;
+	capture_ring_changes Changes[CAPTURE_RING_HISTORY];
+	
+	u64 WrittenCount;
+	u64 DroppedCount; // Written and never taken
+	u64 CopiedBytes;
+};
+
+internal void InitializeCaptureRing(capture_ring *Ring, capture_ring_copy *Copy, void *CopyContext)
+{
+	InitializeSlotExchange(&Ring->Exchange);
+	
+	for (u32 SlotIndex = 0; SlotIndex < EXCHANGE_SLOT_COUNT; ++SlotIndex)
+	{
+		capture_ring_slot *Slot = &Ring->Slots[SlotIndex];
+		Slot->Surface  = NULL;
+		Slot->Sequence = 0;
+		Slot->Missed.RegionCount = 0;
+	}
+	
+	Ring->Copy        = Copy;
+	Ring->CopyContext = CopyContext;
+	
+	AtomicStoreU32(&Ring->TakenSequence, 0);
+	Ring->Sequence    = 0;
+	Ring->ChangeCount = 0;
+	
+	Ring->WrittenCount = 0;
+	Ring->DroppedCount = 0;
+	Ring->CopiedBytes  = 0;
+}
+
+// @Note Surface space, the desktop before the output's rotation
+inline box GetSurfaceBounds(captured_frame *Frame)
+{
+	bool Swap = RotationSwapsAxes(Frame->Rotation);
+	return box{ 0, 0, Swap ? Frame->DesktopHeight : Frame->DesktopWidth, Swap ? Frame->DesktopWidth : Frame->DesktopHeight };
+}
+
+internal void AddDamageRegions(crop_damage *Damage, box Bounds, crop_damage *Regions)
+{
+	for (u32 RegionIndex = 0; RegionIndex < Regions->RegionCount; ++RegionIndex)
+	{
+		AddDamage(Damage, Bounds, Regions->Regions[RegionIndex]);
+	}
+}
+
+//
+// Capture side, only ever called from one thread. Copies the frame into the ring and hands it over.
+// Returns false if nothing was handed over, because nothing changed (the mouse moved) or there was no copy
+// to be had. The changes go with the next frame then, the source frame can be released either way.
+//
+internal bool WriteCaptureRing(capture_ring *Ring, captured_frame *Frame)
+{
+	box Bounds = GetSurfaceBounds(Frame);
+	
+	crop_damage Damage;
+	if (Frame->SourceWasReset)
+	{
+		Damage.RegionCount = 1;
+		Damage.Regions[0]  = Bounds;
+	}
+	else
+	{
+		ComputeCropDamage(Frame, Bounds, &Damage);
+		if (Damage.RegionCount == 0)
+		{
+			return false;
+		}
+	}
+	
+	for (u32 SlotIndex = 0; SlotIndex < EXCHANGE_SLOT_COUNT; ++SlotIndex)
+	{
+		AddDamageRegions(&Ring->Slots[SlotIndex].Missed, Bounds, &Damage);
+	}
+	
+	// @Note The render side may take another copy while we look, that only hands over more than it needs
+	u32 TakenSequence = AtomicLoadU32(&Ring->TakenSequence);
+	u32 SeenCount = 0;
+	while ((SeenCount < Ring->ChangeCount) && ((s32)(Ring->Changes[SeenCount].Sequence - TakenSequence) <= 0))
+	{
+		++SeenCount;
+	}
+	
+	for (u32 ChangeIndex = SeenCount; ChangeIndex < Ring->ChangeCount; ++ChangeIndex)
+	{
+		Ring->Changes[ChangeIndex - SeenCount] = Ring->Changes[ChangeIndex];
+	}
+	Ring->ChangeCount -= SeenCount;
+	
+	// @Note Out of room the oldest two become one, under the newer sequence so it isn't dropped too early
+	if (Ring->ChangeCount == CAPTURE_RING_HISTORY)
+	{
+		capture_ring_changes *Oldest = &Ring->Changes[0];
+		capture_ring_changes *Next   = &Ring->Changes[1];
+		AddDamageRegions(&Next->Damage, Bounds, &Oldest->Damage);
+		Next->WasReset |= Oldest->WasReset;
+		
+		for (u32 ChangeIndex = 1; ChangeIndex < Ring->ChangeCount; ++ChangeIndex)
+		{
+			Ring->Changes[ChangeIndex - 1] = Ring->Changes[ChangeIndex];
+		}
+		--Ring->ChangeCount;
+	}
+	
+	u32 Sequence = ++Ring->Sequence;
+	
+	capture_ring_changes *Changes = &Ring->Changes[Ring->ChangeCount++];
+	Changes->Sequence = Sequence;
+	Changes->WasReset = Frame->SourceWasReset;
+	Changes->Damage   = Damage;
+	
+	//
+	// Copy
+	//
+	
+	capture_ring_slot *Slot = &Ring->Slots[Ring->Exchange.WriteIndex];
+	if (!Ring->Copy(Ring->CopyContext, Frame, &Slot->Surface, Slot->Missed.Regions, Slot->Missed.RegionCount))
+	{
+		return false;
+	}
+	
+	Ring->CopiedBytes += GetDamageArea(&Slot->Missed) * GetSurfaceBytesPerPixel(Frame->Format);
+	Slot->Missed.RegionCount = 0;
+	
+	//
+	// Hand over
+	//
+	
+	crop_damage Changed;
+	Changed.RegionCount = 0;
+	
+	bool WasReset = false;
+	for (u32 ChangeIndex = 0; ChangeIndex < Ring->ChangeCount; ++ChangeIndex)
+	{
+		AddDamageRegions(&Changed, Bounds, &Ring->Changes[ChangeIndex].Damage);
+		WasReset |= Ring->Changes[ChangeIndex].WasReset;
+	}
+	
+	for (u32 RegionIndex = 0; RegionIndex < Changed.RegionCount; ++RegionIndex)
+	{
+		Slot->Changed[RegionIndex] = Changed.Regions[RegionIndex];
+	}
+	
+	Slot->Sequence = Sequence;
+	Slot->Frame    = *Frame;
+	Slot->Frame.Surface         = Slot->Surface;
+	Slot->Frame.SourceWasReset  = WasReset;
+	Slot->Frame.MetadataIsValid = true;
+	Slot->Frame.MoveRectCount   = 0;
+	Slot->Frame.MoveRects       = NULL;
+	Slot->Frame.DirtyRectCount  = Changed.RegionCount;
+	Slot->Frame.DirtyRects      = Slot->Changed;
+	
+	if (PublishSlot(&Ring->Exchange))
+	{
+		++Ring->DroppedCount;
+	}
+	++Ring->WrittenCount;
+	
+	return true;
+}
+
+//
+// Render side, only ever called from one thread. Fills Frame from the newest copy if there is one newer
+// than the last, that copy stays the render side's until the next take. Returns false if there isn't.
+//
+internal bool TakeCaptureRing(capture_ring *Ring, captured_frame *Frame)
+{
+	if (!TakeNewestSlot(&Ring->Exchange))
+	{
+		return false;
+	}
+	
+	capture_ring_slot *Slot = &Ring->Slots[Ring->Exchange.ReadIndex];
+	AtomicStoreU32(&Ring->TakenSequence, Slot->Sequence);
+	*Frame = Slot->Frame;
+	
+	return true;
+}
@@ -0,0 +1,988 @@
+//
+// Scaling modes past bilinear: nearest with a fast path for whole ratios, a box filtered mip chain,
+// and separable bicubic and Lanczos with their weights cached per mapping
+//
+// @Note The CPU reference for the D3D11 permutations of PixelMain, the software compositor draws with it.
+// Every mode samples the same texel space as ShadeRowScalar, keeps inside the crop slot the same way,
+// filters in linear light and shades the same way. Only the filter differs.
+//
+
+global const char *ScaleModeNames[ScaleMode_Count] = { "bilinear", "nearest", "mip", "bicubic", "lanczos" };
+
+// @Note Enough for a 8192 texel slot down to 1x1
+#define SCALE_MAX_LEVELS 14
+
+// @Note Per axis. Past this the filter stops widening and a very far downscale aliases a little.
+#define SCALE_MAX_TAPS 64
+
+// @Note A table across and a table down for every piece
+#define SCALE_TABLE_COUNT (2 * MAX_CROP_PIECES)
+
+// @Note Texel rows filtered across per tile job
+#define SCALE_BAND_ROWS 16
+
+#define SCALE_PI 3.14159265f
+
+inline float AbsF(float Value)
+{
+	return (Value < 0.0f) ? -Value : Value;
+}
+
+// @Note sin(Pi * X) without the CRT, folded into -0.5..0.5 and then a Taylor series, good to about 1e-6
+internal float SinPi(float X)
+{
+	int Whole = FloorToInt(X + 0.5f);
+	float Angle  = (X - (float)Whole) * SCALE_PI;
+	float Angle2 = Angle * Angle;
+	
+	float Result = Angle * (1.0f - Angle2 / 6.0f * (1.0f - Angle2 / 20.0f * (1.0f - Angle2 / 42.0f * (1.0f - Angle2 / 72.0f * (1.0f - Angle2 / 110.0f)))));
+	return (Whole & 1) ? -Result : Result;
+}
+
+// @Note Channels are in linear light like the filters work in, the same shade as the end of ShadeRowScalar
+inline u32 ShadeChannels(shade_row *Row, float *Channels)
+{
+	u32 Result = Row->AlphaByte << 24;
+	for (int Channel = 0; Channel < 3; ++Channel)
+	{
+		Result |= ShadeChannel(Row, Channels[Channel]) << (8 * Channel);
+	}
+	
+	return Result;
+}
+
+inline u32 ShadeTexel(shade_row *Row, u32 Texel)
+{
+	float Channels[3];
+	Channels[0] = ColourTables.SRGBDecode[Texel & 0xFF];
+	Channels[1] = ColourTables.SRGBDecode[(Texel >> 8) & 0xFF];
+	Channels[2] = ColourTables.SRGBDecode[(Texel >> 16) & 0xFF];
+	
+	return ShadeChannels(Row, Channels);
+}
+
+//
+// Weights
+//
+
+internal float GetFilterRadius(scale_mode Mode)
+{
+	return (Mode == ScaleMode_Lanczos) ? 3.0f : 2.0f;
+}
+
+internal float FilterWeight(scale_mode Mode, float X)
+{
+	X = AbsF(X);
+	if (Mode == ScaleMode_Bicubic)
+	{
+		// @Note Catmull-Rom, B = 0 and C = 0.5. Goes through every texel so 1:1 stays sharp
+		if (X < 1.0f)
+		{
+			return (1.5f * X - 2.5f) * X * X + 1.0f;
+		}
+		
+		if (X < 2.0f)
+		{
+			return ((-0.5f * X + 2.5f) * X - 4.0f) * X + 2.0f;
+		}
+		
+		return 0.0f;
+	}
+	
+	// Lanczos 3
+	if (X < 1e-6f)
+	{
+		return 1.0f;
+	}
+	
+	if (X >= 3.0f)
+	{
+		return 0.0f;
+	}
+	
+	return 3.0f * SinPi(X) * SinPi(X / 3.0f) / (SCALE_PI * SCALE_PI * X * X);
+}
+
+// @Note Destination pixel I samples around texel Start + I * Step, never outside First to Last
+struct scale_table
+{
+	// @Note What the weights were built for, the cache hands them back while all of it still matches
+	scale_mode Mode;
+	float Start;
+	float Step;
+	int Count;
+	int First;
+	int Last;
+	
+	// @Note Count runs of Taps weights, run I starts at texel Begins[I]
+	int Taps;
+	int *Begins;
+	float *Weights;
+	
+	void *Memory;
+	size_t Size;
+	u64 LastUsed;
+};
+
+internal int GetScaleTaps(scale_mode Mode, float Step, int First, int Last, float *Scale)
+{
+	// @Note Downscaling widens the filter to cover every texel under the pixel
+	float Radius = GetFilterRadius(Mode);
+	*Scale = Min(Max(AbsF(Step), 1.0f), (float)(SCALE_MAX_TAPS - 1) / (2.0f * Radius));
+	
+	int Taps = FloorToInt(2.0f * Radius * *Scale) + 1;
+	return Min(Taps, Last - First + 1);
+}
+
+internal void BuildScaleTable(scale_table *Table)
+{
+	float Scale;
+	GetScaleTaps(Table->Mode, Table->Step, Table->First, Table->Last, &Scale);
+	float Support = GetFilterRadius(Table->Mode) * Scale;
+	int Taps = Table->Taps;
+	
+	for (int Index = 0; Index < Table->Count; ++Index)
+	{
+		float Center = Table->Start + (float)Index * Table->Step;
+		int Low  = CeilToInt(Center - Support);
+		int High = FloorToInt(Center + Support);
+		
+		// @Note Past the slot's edges the edge texel repeats, like the clamp on the bilinear sample
+		int Begin = Min(Max(Low, Table->First), Table->Last - Taps + 1);
+		float *Weights = Table->Weights + Index * Taps;
+		for (int Tap = 0; Tap < Taps; ++Tap)
+		{
+			Weights[Tap] = 0.0f;
+		}
+		
+		float Sum = 0.0f;
+		for (int Texel = Low; Texel <= High; ++Texel)
+		{
+			int Tap = Min(Max(Texel, Table->First), Table->Last) - Begin;
+			if ((Tap >= 0) && (Tap < Taps))
+			{
+				float Weight = FilterWeight(Table->Mode, ((float)Texel - Center) / Scale);
+				Weights[Tap] += Weight;
+				Sum += Weight;
+			}
+		}
+		
+		if (Sum != 0.0f)
+		{
+			for (int Tap = 0; Tap < Taps; ++Tap)
+			{
+				Weights[Tap] /= Sum;
+			}
+		}
+		else
+		{
+			int Nearest = Min(Max(FloorToInt(Center + 0.5f), Table->First), Table->Last);
+			Weights[Nearest - Begin] = 1.0f;
+		}
+		
+		Table->Begins[Index] = Begin;
+	}
+}
+
+//
+// Mip chain
+//
+
+// @Note Level 0 is the crop slot in the texture, the rest are built from it and live in Memory
+struct scale_mip_chain
+{
+	box Slot;
+	int LevelCount;
+	int Widths[SCALE_MAX_LEVELS];
+	int Heights[SCALE_MAX_LEVELS];
+	int Pitches[SCALE_MAX_LEVELS];
+	u8 *Levels[SCALE_MAX_LEVELS];
+	
+	void *Memory;
+	size_t Size;
+	
+	// @Note In slot texels, whatever was cropped since the chain was last built
+	box Dirty;
+};
+
+// @Note 2x2 box in linear light and back to sRGB, like GenerateMips on an sRGB view. Sizes halve rounding down
+// like it too, an odd last row or column drops out. A side that is already 1 stays 1 and only the other side gets averaged.
+internal u64 BuildMipLevel(scale_mip_chain *Chain, int Level, box Dirty)
+{
+	u8 *Source = Chain->Levels[Level - 1];
+	int SourcePitch = Chain->Pitches[Level - 1];
+	int SourceLastX = Chain->Widths[Level - 1]  - 1;
+	int SourceLastY = Chain->Heights[Level - 1] - 1;
+	float *Decode = ColourTables.SRGBDecode;
+	
+	u64 TexelCount = 0;
+	u8 *DestRow = Chain->Levels[Level] + Dirty.Top * Chain->Pitches[Level];
+	for (int Y = Dirty.Top; Y < Dirty.Bottom; ++Y)
+	{
+		u8 *Top    = Source + (2 * Y) * SourcePitch;
+		u8 *Bottom = Source + Min(2 * Y + 1, SourceLastY) * SourcePitch;
+		for (int X = Dirty.Left; X < Dirty.Right; ++X)
+		{
+			u8 *Dest = DestRow + X * BITMAP_BYTES_PER_PIXEL;
+			int Left  = 2 * X * BITMAP_BYTES_PER_PIXEL;
+			int Right = Min(2 * X + 1, SourceLastX) * BITMAP_BYTES_PER_PIXEL;
+			for (int Channel = 0; Channel < 3; ++Channel)
+			{
+				float Sum = Decode[Top[Left + Channel]] + Decode[Top[Right + Channel]] + Decode[Bottom[Left + Channel]] + Decode[Bottom[Right + Channel]];
+				Dest[Channel] = (u8)EncodeSRGB(Sum * 0.25f);
+			}
+			
+			int AlphaSum = Top[Left + 3] + Top[Right + 3] + Bottom[Left + 3] + Bottom[Right + 3];
+			Dest[3] = (u8)((AlphaSum + 2) / 4);
+		}
+		
+		TexelCount += (u64)GetBoxWidth(Dirty);
+		DestRow += Chain->Pitches[Level];
+	}
+	
+	return TexelCount;
+}
+
+// @Note Level 0 sized for the slot, false without memory
+internal bool SizeMipChain(scale_mip_chain *Chain, box Slot, platform_allocate_memory *AllocateMemory, platform_free_memory *FreeMemory)
+{
+	int Width  = GetBoxWidth(Slot);
+	int Height = GetBoxHeight(Slot);
+	
+	size_t Size = 0;
+	int LevelCount = 1;
+	Chain->Widths[0]  = Width;
+	Chain->Heights[0] = Height;
+	while (((Width > 1) || (Height > 1)) && (LevelCount < SCALE_MAX_LEVELS))
+	{
+		Width  = Max(Width  / 2, 1);
+		Height = Max(Height / 2, 1);
+		
+		Chain->Widths[LevelCount]  = Width;
+		Chain->Heights[LevelCount] = Height;
+		Chain->Pitches[LevelCount] = Width * BITMAP_BYTES_PER_PIXEL;
+		Size += (size_t)Width * Height * BITMAP_BYTES_PER_PIXEL;
+		++LevelCount;
+	}
+	
+	if (Size > Chain->Size)
+	{
+		if (Chain->Memory)
+		{
+			FreeMemory(Chain->Memory, Chain->Size);
+		}
+		
+		Chain->Memory = AllocateMemory(Size);
+		Chain->Size   = Chain->Memory ? Size : 0;
+		if (!Chain->Memory)
+		{
+			Chain->Slot = box{ 0, 0, 0, 0 };
+			return false;
+		}
+	}
+	
+	u8 *Level = (u8 *)Chain->Memory;
+	for (int LevelIndex = 1; LevelIndex < LevelCount; ++LevelIndex)
+	{
+		Chain->Levels[LevelIndex] = Level;
+		Level += (size_t)Chain->Pitches[LevelIndex] * Chain->Heights[LevelIndex];
+	}
+	
+	Chain->Slot       = Slot;
+	Chain->LevelCount = LevelCount;
+	Chain->Dirty      = box{ 0, 0, GetBoxWidth(Slot), GetBoxHeight(Slot) };
+	
+	return true;
+}
+
+// @Note Bilinear on one level. U and V are slot texels of level 0, with the same half texel offset as the shade row.
+internal void SampleMipLevel(scale_mip_chain *Chain, int Level, float U, float V, float *Channels)
+{
+	int Width  = Chain->Widths[Level];
+	int Height = Chain->Heights[Level];
+	
+	// @Note Normalized coordinates like the sampler, so a level that rounded down stays lined up
+	U = (U + 0.5f) * (float)Width  / (float)Chain->Widths[0]  - 0.5f;
+	V = (V + 0.5f) * (float)Height / (float)Chain->Heights[0] - 0.5f;
+	
+	U = Min(Max(U, 0.0f), (float)(Width  - 1));
+	V = Min(Max(V, 0.0f), (float)(Height - 1));
+	int X0 = (int)U;
+	int Y0 = (int)V;
+	int X1 = Min(X0 + 1, Width  - 1);
+	int Y1 = Min(Y0 + 1, Height - 1);
+	float FX = U - (float)X0;
+	float FY = V - (float)Y0;
+	
+	u8 *Row0 = Chain->Levels[Level] + Y0 * Chain->Pitches[Level];
+	u8 *Row1 = Chain->Levels[Level] + Y1 * Chain->Pitches[Level];
+	u8 *T00 = Row0 + X0 * BITMAP_BYTES_PER_PIXEL;
+	u8 *T10 = Row0 + X1 * BITMAP_BYTES_PER_PIXEL;
+	u8 *T01 = Row1 + X0 * BITMAP_BYTES_PER_PIXEL;
+	u8 *T11 = Row1 + X1 * BITMAP_BYTES_PER_PIXEL;
+	
+	float *Decode = ColourTables.SRGBDecode;
+	for (int Channel = 0; Channel < 3; ++Channel)
+	{
+		float Top    = Decode[T00[Channel]] + (Decode[T10[Channel]] - Decode[T00[Channel]]) * FX;
+		float Bottom = Decode[T01[Channel]] + (Decode[T11[Channel]] - Decode[T01[Channel]]) * FX;
+		Channels[Channel] = Top + (Bottom - Top) * FY;
+	}
+}
+
+//
+// Scaler, what every mode keeps between frames
+//
+
+// @Note Only for an upright piece scaled by a whole number either way: pixel I shows texel
+// First + (I + Phase) * Multiply / Divide, so no pixel needs any float math
+struct scale_nearest_axis
+{
+	int First;
+	int Phase;
+	int Multiply;
+	int Divide;
+};
+
+struct scale_piece
+{
+	bool IsWholeRatio;
+	scale_nearest_axis NearestX;
+	scale_nearest_axis NearestY;
+	
+	// @Note Nearest shades a channel from its byte alone, this is every byte shaded, see ShadeTexelNearest
+	u8 NearestShade[256];
+	
+	// @Note Trilinear between Level and the one after it
+	int Level;
+	float Blend;
+	
+	// @Note Across is the table along U, down the one along V. AcrossIsX is false for a piece turned a quarter, then U goes down the screen.
+	scale_table *Across;
+	scale_table *Down;
+	bool AcrossIsX;
+	
+	// @Note Texel rows First to First + Count - 1 filtered across, three floats of linear light for every entry of Across
+	int RowFirst;
+	int RowCount;
+	float *Rows;
+	u32 BandCount;
+};
+
+struct scaler
+{
+	platform_allocate_memory *AllocateMemory;
+	platform_free_memory     *FreeMemory;
+	
+	// @Note What the last PrepareScale set up, one piece per shade setup
+	scale_mode Mode;
+	shade_setup *Setups;
+	u32 PieceCount;
+	scale_piece Pieces[MAX_CROP_PIECES];
+	
+	scale_mip_chain Chains[MAX_CROP_PIECES];
+	
+	scale_table Tables[SCALE_TABLE_COUNT];
+	u64 UseCount;
+	
+	float *Rows;
+	size_t RowsSize;
+	
+	u64 TableBuildCount;
+	u64 TableHitCount;
+	u64 MipTexelCount;
+};
+
+internal void InitializeScaler(scaler *Scaler, platform_allocate_memory *AllocateMemory, platform_free_memory *FreeMemory)
+{
+	*Scaler = {};
+	Scaler->AllocateMemory = AllocateMemory;
+	Scaler->FreeMemory     = FreeMemory;
+	Scaler->Mode           = ScaleMode_Bilinear;
+}
+
+// @Note Region is in texture texels, every chain it lands on rebuilds that part on its next use
+internal void MarkScaleDirty(scaler *Scaler, box Region)
+{
+	for (u32 ChainIndex = 0; ChainIndex < MAX_CROP_PIECES; ++ChainIndex)
+	{
+		scale_mip_chain *Chain = &Scaler->Chains[ChainIndex];
+		box Dirty = IntersectBoxes(Region, Chain->Slot);
+		if (!BoxIsEmpty(Dirty))
+		{
+			Dirty.Left   -= Chain->Slot.Left;
+			Dirty.Right  -= Chain->Slot.Left;
+			Dirty.Top    -= Chain->Slot.Top;
+			Dirty.Bottom -= Chain->Slot.Top;
+			
+			Chain->Dirty = BoxIsEmpty(Chain->Dirty) ? Dirty : UnionBoxes(Chain->Dirty, Dirty);
+		}
+	}
+}
+
+// Returns NULL without memory
+internal scale_table *GetScaleTable(scaler *Scaler, scale_mode Mode, float Start, float Step, int Count, int First, int Last)
+{
+	++Scaler->UseCount;
+	
+	scale_table *Oldest = &Scaler->Tables[0];
+	for (u32 TableIndex = 0; TableIndex < SCALE_TABLE_COUNT; ++TableIndex)
+	{
+		scale_table *Table = &Scaler->Tables[TableIndex];
+		if (Table->Memory && (Table->Mode == Mode) && (Table->Start == Start) && (Table->Step == Step) &&
+			(Table->Count == Count) && (Table->First == First) && (Table->Last == Last))
+		{
+			Table->LastUsed = Scaler->UseCount;
+			++Scaler->TableHitCount;
+			return Table;
+		}
+		
+		if (Table->LastUsed < Oldest->LastUsed)
+		{
+			Oldest = Table;
+		}
+	}
+	
+	// @Note There are two tables for every piece, so the oldest one was never handed out this frame
+	scale_table *Table = Oldest;
+	
+	float Scale;
+	int Taps = GetScaleTaps(Mode, Step, First, Last, &Scale);
+	size_t Size = (size_t)Count * (sizeof(int) + Taps * sizeof(float));
+	if (Size > Table->Size)
+	{
+		if (Table->Memory)
+		{
+			Scaler->FreeMemory(Table->Memory, Table->Size);
+		}
+		
+		Table->Memory = Scaler->AllocateMemory(Size);
+		Table->Size   = Table->Memory ? Size : 0;
+		if (!Table->Memory)
+		{
+			return NULL;
+		}
+	}
+	
+	Table->Mode     = Mode;
+	Table->Start    = Start;
+	Table->Step     = Step;
+	Table->Count    = Count;
+	Table->First    = First;
+	Table->Last     = Last;
+	Table->Taps     = Taps;
+	Table->Begins   = (int *)Table->Memory;
+	Table->Weights  = (float *)(Table->Begins + Count);
+	Table->LastUsed = Scaler->UseCount;
+	
+	BuildScaleTable(Table);
+	++Scaler->TableBuildCount;
+	
+	return Table;
+}
+
+// Returns false unless Step is a whole number or one over one
+internal bool GetWholeRatio(float Start, float Step, scale_nearest_axis *Axis)
+{
+	if (Step >= 1.0f)
+	{
+		int Whole = (int)(Step + 0.5f);
+		if ((float)Whole != Step)
+		{
+			return false;
+		}
+		
+		Axis->Multiply = Whole;
+		Axis->Divide   = 1;
+	}
+	else if (Step > 0.0f)
+	{
+		float Inverse = 1.0f / Step;
+		int Whole = (int)(Inverse + 0.5f);
+		if (AbsF(Inverse - (float)Whole) > 1e-3f)
+		{
+			return false;
+		}
+		
+		Axis->Multiply = 1;
+		Axis->Divide   = Whole;
+	}
+	else
+	{
+		return false;
+	}
+	
+	// @Note The texel under the first pixel center, and how many pixels of it are already behind
+	float Position = Start + 0.5f;
+	Axis->First = FloorToInt(Position);
+	Axis->Phase = Min((int)((Position - (float)Axis->First) * (float)Axis->Divide), Axis->Divide - 1);
+	
+	return true;
+}
+
+// @Note Texel rows filtered across, the first pass of the separable filter
+internal bool PrepareScaleFilter(scaler *Scaler, scale_mode Mode, shade_setup *Setup, scale_piece *Piece)
+{
+	shade_row *Row = &Setup->Row;
+	int Width  = GetBoxWidth(Setup->Rect);
+	int Height = GetBoxHeight(Setup->Rect);
+	
+	Piece->AcrossIsX = (Row->StepU != 0.0f) || (Setup->StepUY == 0.0f);
+	float AcrossStep = Piece->AcrossIsX ? Row->StepU : Setup->StepUY;
+	float DownStep   = Piece->AcrossIsX ? Setup->StepVY : Row->StepV;
+	int AcrossCount  = Piece->AcrossIsX ? Width : Height;
+	int DownCount    = Piece->AcrossIsX ? Height : Width;
+	
+	int SlotLeft = (int)Row->MinU;
+	int SlotTop  = (int)Row->MinV;
+	Piece->Across = GetScaleTable(Scaler, Mode, Row->U, AcrossStep, AcrossCount, SlotLeft, Row->LastX);
+	Piece->Down   = GetScaleTable(Scaler, Mode, Row->V, DownStep, DownCount, SlotTop, Row->LastY);
+	if (!Piece->Across || !Piece->Down)
+	{
+		return false;
+	}
+	
+	scale_table *Down = Piece->Down;
+	int RowFirst = Down->Last;
+	int RowLast  = Down->First;
+	for (int Index = 0; Index < Down->Count; ++Index)
+	{
+		RowFirst = Min(RowFirst, Down->Begins[Index]);
+		RowLast  = Max(RowLast,  Down->Begins[Index] + Down->Taps - 1);
+	}
+	
+	Piece->RowFirst  = RowFirst;
+	Piece->RowCount  = RowLast - RowFirst + 1;
+	Piece->BandCount = (u32)(Piece->RowCount + SCALE_BAND_ROWS - 1) / SCALE_BAND_ROWS;
+	
+	return true;
+}
+
+// Returns the mode it will draw with, bilinear if the one asked for didn't get its memory
+internal scale_mode PrepareScale(scaler *Scaler, scale_mode Mode, shade_setup *Setups, u32 SetupCount)
+{
+	Scaler->Mode       = Mode;
+	Scaler->Setups     = Setups;
+	Scaler->PieceCount = SetupCount;
+	
+	size_t RowsSize = 0;
+	for (u32 SetupIndex = 0; SetupIndex < SetupCount; ++SetupIndex)
+	{
+		shade_setup *Setup = &Setups[SetupIndex];
+		shade_row *Row = &Setup->Row;
+		scale_piece *Piece = &Scaler->Pieces[SetupIndex];
+		
+		if (Mode == ScaleMode_Nearest)
+		{
+			Piece->IsWholeRatio = (Row->StepV == 0.0f) && (Setup->StepUY == 0.0f) &&
+				GetWholeRatio(Row->U, Row->StepU, &Piece->NearestX) && GetWholeRatio(Row->V, Setup->StepVY, &Piece->NearestY);
+			
+			for (int Byte = 0; Byte < 256; ++Byte)
+			{
+				Piece->NearestShade[Byte] = (u8)ShadeChannel(Row, ColourTables.SRGBDecode[Byte]);
+			}
+		}
+		else if (Mode == ScaleMode_Mip)
+		{
+			box Slot = { (int)Row->MinU, (int)Row->MinV, Row->LastX + 1, Row->LastY + 1 };
+			scale_mip_chain *Chain = &Scaler->Chains[SetupIndex];
+			if (!BoxesAreEqual(Chain->Slot, Slot) && !SizeMipChain(Chain, Slot, Scaler->AllocateMemory, Scaler->FreeMemory))
+			{
+				Scaler->Mode = ScaleMode_Bilinear;
+				return Scaler->Mode;
+			}
+			
+			Chain->Levels[0]  = Row->Texels + Slot.Top * Row->Pitch + Slot.Left * BITMAP_BYTES_PER_PIXEL;
+			Chain->Pitches[0] = Row->Pitch;
+			
+			// @Note Only what was cropped, each level covers the part of the one before it that changed
+			box Dirty = Chain->Dirty;
+			for (int Level = 1; (Level < Chain->LevelCount) && !BoxIsEmpty(Dirty); ++Level)
+			{
+				Dirty.Left   = Dirty.Left / 2;
+				Dirty.Top    = Dirty.Top  / 2;
+				Dirty.Right  = Min((Dirty.Right  + 1) / 2, Chain->Widths[Level]);
+				Dirty.Bottom = Min((Dirty.Bottom + 1) / 2, Chain->Heights[Level]);
+				
+				Scaler->MipTexelCount += BuildMipLevel(Chain, Level, Dirty);
+			}
+			
+			Chain->Dirty = box{ 0, 0, 0, 0 };
+			
+			// @Note The pieces only ever turn by quarters, so the footprint is one step along each screen axis
+			float Footprint = Max(AbsF(Row->StepU) + AbsF(Row->StepV), AbsF(Setup->StepUY) + AbsF(Setup->StepVY));
+			float Lod = (Footprint > 1.0f) ? Log2(Footprint) : 0.0f;
+			
+			Piece->Level = Min(FloorToInt(Lod), Chain->LevelCount - 1);
+			Piece->Blend = (Piece->Level < Chain->LevelCount - 1) ? (Lod - (float)Piece->Level) : 0.0f;
+		}
+		else if ((Mode == ScaleMode_Bicubic) || (Mode == ScaleMode_Lanczos))
+		{
+			if (!PrepareScaleFilter(Scaler, Mode, Setup, Piece))
+			{
+				Scaler->Mode = ScaleMode_Bilinear;
+				return Scaler->Mode;
+			}
+			
+			RowsSize += (size_t)Piece->RowCount * Piece->Across->Count * 3 * sizeof(float);
+		}
+	}
+	
+	if (RowsSize)
+	{
+		if (RowsSize > Scaler->RowsSize)
+		{
+			if (Scaler->Rows)
+			{
+				Scaler->FreeMemory(Scaler->Rows, Scaler->RowsSize);
+			}
+			
+			Scaler->Rows     = (float *)Scaler->AllocateMemory(RowsSize);
+			Scaler->RowsSize = Scaler->Rows ? RowsSize : 0;
+			if (!Scaler->Rows)
+			{
+				Scaler->Mode = ScaleMode_Bilinear;
+				return Scaler->Mode;
+			}
+		}
+		
+		float *Rows = Scaler->Rows;
+		for (u32 PieceIndex = 0; PieceIndex < SetupCount; ++PieceIndex)
+		{
+			scale_piece *Piece = &Scaler->Pieces[PieceIndex];
+			Piece->Rows = Rows;
+			Rows += (size_t)Piece->RowCount * Piece->Across->Count * 3;
+		}
+	}
+	
+	return Mode;
+}
+
+// @Note Bicubic and Lanczos filter the texel rows across first, in bands that can run on any thread
+internal u32 GetScaleBandCount(scaler *Scaler)
+{
+	u32 BandCount = 0;
+	if ((Scaler->Mode == ScaleMode_Bicubic) || (Scaler->Mode == ScaleMode_Lanczos))
+	{
+		for (u32 PieceIndex = 0; PieceIndex < Scaler->PieceCount; ++PieceIndex)
+		{
+			BandCount += Scaler->Pieces[PieceIndex].BandCount;
+		}
+	}
+	
+	return BandCount;
+}
+
+internal void FilterScaleBand(scaler *Scaler, u32 BandIndex)
+{
+	for (u32 PieceIndex = 0; PieceIndex < Scaler->PieceCount; ++PieceIndex)
+	{
+		scale_piece *Piece = &Scaler->Pieces[PieceIndex];
+		if (BandIndex >= Piece->BandCount)
+		{
+			BandIndex -= Piece->BandCount;
+			continue;
+		}
+		
+		shade_row *Row = &Scaler->Setups[PieceIndex].Row;
+		scale_table *Across = Piece->Across;
+		float *Decode = ColourTables.SRGBDecode;
+		
+		int Top    = (int)BandIndex * SCALE_BAND_ROWS;
+		int Bottom = Min(Top + SCALE_BAND_ROWS, Piece->RowCount);
+		for (int RowIndex = Top; RowIndex < Bottom; ++RowIndex)
+		{
+			u8 *Texels = Row->Texels + (Piece->RowFirst + RowIndex) * Row->Pitch;
+			float *Out = Piece->Rows + (size_t)RowIndex * Across->Count * 3;
+			for (int Index = 0; Index < Across->Count; ++Index)
+			{
+				u8 *Texel = Texels + Across->Begins[Index] * BITMAP_BYTES_PER_PIXEL;
+				float *Weights = Across->Weights + Index * Across->Taps;
+				
+				float Blue  = 0.0f;
+				float Green = 0.0f;
+				float Red   = 0.0f;
+				for (int Tap = 0; Tap < Across->Taps; ++Tap)
+				{
+					Blue  += Weights[Tap] * Decode[Texel[0]];
+					Green += Weights[Tap] * Decode[Texel[1]];
+					Red   += Weights[Tap] * Decode[Texel[2]];
+					Texel += BITMAP_BYTES_PER_PIXEL;
+				}
+				
+				Out[0] = Blue;
+				Out[1] = Green;
+				Out[2] = Red;
+				Out += 3;
+			}
+		}
+		
+		return;
+	}
+}
+
+//
+// Drawing, any part of a setup's Rect like ShadeRect
+//
+
+// @Note The same as ShadeTexel, looked up
+inline u32 ShadeTexelNearest(u8 *Shade, u32 AlphaByte, u32 Texel)
+{
+	return (u32)Shade[Texel & 0xFF] | ((u32)Shade[(Texel >> 8) & 0xFF] << 8) | ((u32)Shade[(Texel >> 16) & 0xFF] << 16) | (AlphaByte << 24);
+}
+
+internal void ShadeRectNearest(scale_piece *Piece, shade_setup *Setup, bitmap *Target, box Rect)
+{
+	shade_row *Row = &Setup->Row;
+	int MinX = (int)Row->MinU;
+	int MinY = (int)Row->MinV;
+	u8 *Shade = Piece->NearestShade;
+	u32 AlphaByte = Row->AlphaByte;
+	
+	u32 *DestRow = (u32 *)(Target->Memory + Rect.Top * Target->Pitch);
+	if (Piece->IsWholeRatio)
+	{
+		scale_nearest_axis *AxisX = &Piece->NearestX;
+		scale_nearest_axis *AxisY = &Piece->NearestY;
+		
+		int LastTexelY = -1;
+		u32 *LastRow = NULL;
+		for (int Y = Rect.Top; Y < Rect.Bottom; ++Y)
+		{
+			int PixelY = Y - Setup->Rect.Top;
+			int TexelY = AxisY->First + ((PixelY + AxisY->Phase) * AxisY->Multiply) / AxisY->Divide;
+			TexelY = Min(Max(TexelY, MinY), Row->LastY);
+			
+			// @Note Scaled up, the rows that show the same texels are copies of the first
+			if (TexelY == LastTexelY)
+			{
+				CopyBytes(DestRow + Rect.Left, LastRow + Rect.Left, (size_t)GetBoxWidth(Rect) * BITMAP_BYTES_PER_PIXEL);
+			}
+			else if (AxisX->Divide == 1)
+			{
+				// @Note Scaled down or 1:1, every pixel is the texel Multiply on from the last one. Only the pixels
+				// past the slot's edges are clamped, the ones in between are a plain stride through the row.
+				u32 *Texels = (u32 *)(Row->Texels + TexelY * Row->Pitch);
+				int Stride = AxisX->Multiply;
+				int TexelX = AxisX->First + (Rect.Left - Setup->Rect.Left + AxisX->Phase) * Stride;
+				
+				int X = Rect.Left;
+				for (; (X < Rect.Right) && (TexelX < MinX); ++X, TexelX += Stride)
+				{
+					DestRow[X] = ShadeTexelNearest(Shade, AlphaByte, Texels[MinX]);
+				}
+				
+				int End = Rect.Right;
+				if (TexelX <= Row->LastX)
+				{
+					End = Min(End, X + (Row->LastX - TexelX) / Stride + 1);
+				}
+				else
+				{
+					End = X;
+				}
+				
+				u32 *Texel = Texels + TexelX;
+				for (; X < End; ++X)
+				{
+					DestRow[X] = ShadeTexelNearest(Shade, AlphaByte, *Texel);
+					Texel += Stride;
+				}
+				
+				for (; X < Rect.Right; ++X)
+				{
+					DestRow[X] = ShadeTexelNearest(Shade, AlphaByte, Texels[Row->LastX]);
+				}
+			}
+			else
+			{
+				u32 *Texels = (u32 *)(Row->Texels + TexelY * Row->Pitch);
+				int X = Rect.Left;
+				while (X < Rect.Right)
+				{
+					int PixelX = X - Setup->Rect.Left + AxisX->Phase;
+					int TexelX = AxisX->First + (PixelX * AxisX->Multiply) / AxisX->Divide;
+					TexelX = Min(Max(TexelX, MinX), Row->LastX);
+					
+					// @Note Every pixel that shows this texel gets it shaded once
+					int End = Min(X + AxisX->Divide - (PixelX % AxisX->Divide), Rect.Right);
+					u32 Colour = ShadeTexelNearest(Shade, AlphaByte, Texels[TexelX]);
+					while (X < End)
+					{
+						DestRow[X++] = Colour;
+					}
+				}
+			}
+			
+			LastTexelY = TexelY;
+			LastRow    = DestRow;
+			DestRow = (u32 *)((u8 *)DestRow + Target->Pitch);
+		}
+		
+		return;
+	}
+	
+	for (int Y = Rect.Top; Y < Rect.Bottom; ++Y)
+	{
+		float RowY = (float)(Y - Setup->Rect.Top);
+		for (int X = Rect.Left; X < Rect.Right; ++X)
+		{
+			float PixelX = (float)(X - Setup->Rect.Left);
+			float U = Min(Max(Row->U + PixelX * Row->StepU + RowY * Setup->StepUY, Row->MinU), Row->MaxU);
+			float V = Min(Max(Row->V + PixelX * Row->StepV + RowY * Setup->StepVY, Row->MinV), Row->MaxV);
+			
+			u32 *Texels = (u32 *)(Row->Texels + (int)(V + 0.5f) * Row->Pitch);
+			DestRow[X] = ShadeTexelNearest(Shade, AlphaByte, Texels[(int)(U + 0.5f)]);
+		}
+		
+		DestRow = (u32 *)((u8 *)DestRow + Target->Pitch);
+	}
+}
+
+internal void ShadeRectMip(scale_piece *Piece, scale_mip_chain *Chain, shade_setup *Setup, bitmap *Target, box Rect)
+{
+	shade_row *Row = &Setup->Row;
+	
+	u32 *DestRow = (u32 *)(Target->Memory + Rect.Top * Target->Pitch);
+	for (int Y = Rect.Top; Y < Rect.Bottom; ++Y)
+	{
+		float RowY = (float)(Y - Setup->Rect.Top);
+		for (int X = Rect.Left; X < Rect.Right; ++X)
+		{
+			// @Note Clamped to the slot like the bilinear sample, then into the chain's own texels
+			float PixelX = (float)(X - Setup->Rect.Left);
+			float U = Min(Max(Row->U + PixelX * Row->StepU + RowY * Setup->StepUY, Row->MinU), Row->MaxU) - Row->MinU;
+			float V = Min(Max(Row->V + PixelX * Row->StepV + RowY * Setup->StepVY, Row->MinV), Row->MaxV) - Row->MinV;
+			
+			float Channels[3];
+			SampleMipLevel(Chain, Piece->Level, U, V, Channels);
+			if (Piece->Blend > 0.0f)
+			{
+				float Coarser[3];
+				SampleMipLevel(Chain, Piece->Level + 1, U, V, Coarser);
+				for (int Channel = 0; Channel < 3; ++Channel)
+				{
+					Channels[Channel] += (Coarser[Channel] - Channels[Channel]) * Piece->Blend;
+				}
+			}
+			
+			DestRow[X] = ShadeChannels(Row, Channels);
+		}
+		
+		DestRow = (u32 *)((u8 *)DestRow + Target->Pitch);
+	}
+}
+
+// @Note The second pass, down the rows FilterScaleBand filtered across
+internal void ShadeRectFiltered(scale_piece *Piece, shade_setup *Setup, bitmap *Target, box Rect)
+{
+	scale_table *Across = Piece->Across;
+	scale_table *Down   = Piece->Down;
+	size_t RowStride = (size_t)Across->Count * 3;
+	
+	u32 *DestRow = (u32 *)(Target->Memory + Rect.Top * Target->Pitch);
+	for (int Y = Rect.Top; Y < Rect.Bottom; ++Y)
+	{
+		int PixelY = Y - Setup->Rect.Top;
+		for (int X = Rect.Left; X < Rect.Right; ++X)
+		{
+			int PixelX = X - Setup->Rect.Left;
+			int AcrossIndex = Piece->AcrossIsX ? PixelX : PixelY;
+			int DownIndex   = Piece->AcrossIsX ? PixelY : PixelX;
+			
+			float *Weights = Down->Weights + DownIndex * Down->Taps;
+			float *Rows = Piece->Rows + (size_t)(Down->Begins[DownIndex] - Piece->RowFirst) * RowStride + AcrossIndex * 3;
+			
+			float Channels[3] = { 0.0f, 0.0f, 0.0f };
+			for (int Tap = 0; Tap < Down->Taps; ++Tap)
+			{
+				Channels[0] += Weights[Tap] * Rows[0];
+				Channels[1] += Weights[Tap] * Rows[1];
+				Channels[2] += Weights[Tap] * Rows[2];
+				Rows += RowStride;
+			}
+			
+			DestRow[X] = ShadeChannels(&Setup->Row, Channels);
+		}
+		
+		DestRow = (u32 *)((u8 *)DestRow + Target->Pitch);
+	}
+}
+
+// @Note Setup SetupIndex of the ones PrepareScale was given, with the mode it returned. Bilinear goes through ShadeRect.
+internal void ShadeScaledRect(scaler *Scaler, u32 SetupIndex, bitmap *Target, box Rect)
+{
+	shade_setup *Setup = &Scaler->Setups[SetupIndex];
+	scale_piece *Piece = &Scaler->Pieces[SetupIndex];
+	
+	switch (Scaler->Mode)
+	{
+		case ScaleMode_Nearest:
+		{
+			ShadeRectNearest(Piece, Setup, Target, Rect);
+		} break;
+		
+		case ScaleMode_Mip:
+		{
+			ShadeRectMip(Piece, &Scaler->Chains[SetupIndex], Setup, Target, Rect);
+		} break;
+		
+		case ScaleMode_Bicubic:
+		case ScaleMode_Lanczos:
+		{
+			ShadeRectFiltered(Piece, Setup, Target, Rect);
+		} break;
+		
+		default:
+		{
+			Assert(!"ShadeScaledRect: bilinear goes through ShadeRect");
+		} break;
+	}
+}
+
+// @Note The setups have to stay where they are until the last ShadeScaledRect
+internal void ShadeScaledPiece(scaler *Scaler, scale_mode Mode, shade_setup *Setup, bitmap *Target, shade_row_function *ShadeRow)
+{
+	Mode = PrepareScale(Scaler, Mode, Setup, 1);
+	if (Mode == ScaleMode_Bilinear)
+	{
+		ShadeRect(Setup, Target, Setup->Rect, ShadeRow);
+		return;
+	}
+	
+	u32 BandCount = GetScaleBandCount(Scaler);
+	for (u32 BandIndex = 0; BandIndex < BandCount; ++BandIndex)
+	{
+		FilterScaleBand(Scaler, BandIndex);
+	}
+	
+	ShadeScaledRect(Scaler, 0, Target, Setup->Rect);
+}
+
+internal void FreeScaler(scaler *Scaler)
+{
+	for (u32 ChainIndex = 0; ChainIndex < MAX_CROP_PIECES; ++ChainIndex)
+	{
+		scale_mip_chain *Chain = &Scaler->Chains[ChainIndex];
+		if (Chain->Memory)
+		{
+			Scaler->FreeMemory(Chain->Memory, Chain->Size);
+		}
+	}
+	
+	for (u32 TableIndex = 0; TableIndex < SCALE_TABLE_COUNT; ++TableIndex)
+	{
+		scale_table *Table = &Scaler->Tables[TableIndex];
+		if (Table->Memory)
+		{
+			Scaler->FreeMemory(Table->Memory, Table->Size);
+		}
+	}
+	
+	if (Scaler->Rows)
+	{
+		Scaler->FreeMemory(Scaler->Rows, Scaler->RowsSize);
+	}
+	
+	*Scaler = {};
+}
@@ -0,0 +1,622 @@
+//
+// Shade kernel: a crop slot scaled into a display rectangle with PixelMain's look, on the CPU
+//
+// @Note Bilinear like D3D11_FILTER_MIN_MAG_LINEAR_MIP_POINT through an sRGB view, so in linear light, then
+// darken, back to sRGB and premultiply by the alpha, see overlay_colour.cpp. The software compositor draws with it. The scalar row is the reference, every other row does the same
+// float math in the same order so on x86 they match it bit for bit. Compilers for ARM fuse the
+// multiply-adds in the scalar row, so NEON can be one off from it there.
+//
+
+#if defined(__aarch64__) || defined(_M_ARM64)
+#define SHADE_NEON 1
+#include <arm_neon.h>
+#elif defined(__x86_64__) || defined(_M_X64) || defined(__i386__) || defined(_M_IX86)
+#define SHADE_X86 1
+#include <immintrin.h>
+#endif
+
+// @Note MSVC takes AVX2 intrinsics anywhere, GCC and Clang only in functions built for it
+#if defined(_MSC_VER)
+#define TARGET_AVX2
+#else
+#define TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+
+enum shade_kernel
+{
+	ShadeKernel_Scalar,
+	ShadeKernel_SSE2,
+	ShadeKernel_AVX2,
+	ShadeKernel_NEON,
+	
+	ShadeKernel_Count,
+};
+
+global const char *ShadeKernelNames[ShadeKernel_Count] = { "scalar", "sse2", "avx2", "neon" };
+
+// @Note One row of destination pixels, in atlas texels. Pixel X samples at U + X * StepU, V + X * StepV.
+struct shade_row
+{
+	u8 *Texels;
+	int Pitch;
+	
+	float U;
+	float V;
+	float StepU;
+	float StepV;
+	
+	// @Note The crop slot, the sample never leaves it so neighbours in the atlas don't bleed in
+	float MinU;
+	float MinV;
+	float MaxU;
+	float MaxV;
+	int LastX;
+	int LastY;
+	
+	// @Note Alpha is 0..1 and Darken is in linear light
+	float Alpha;
+	float Darken;
+	u32 AlphaByte;
+	
+	// @Note Only the effect rows read these, see overlay_effects.cpp
+	u32 EffectKey;
+	effect_constants Effects;
+};
+
+// Pixels Begin to End of the row, Destination is the row's first pixel
+#define SHADE_ROW(Name) void Name(shade_row *Row, u32 *Destination, int Begin, int End)
+typedef SHADE_ROW(shade_row_function);
+
+inline float Clamp01(float Value)
+{
+	return (Value < 0.0f) ? 0.0f : ((Value > 1.0f) ? 1.0f : Value);
+}
+
+inline u8 UnitToByte(float Value)
+{
+	return (u8)(Clamp01(Value) * 255.0f + 0.5f);
+}
+
+inline int CeilToInt(float Value)
+{
+	int Result = (int)Value;
+	return ((float)Result < Value) ? Result + 1 : Result;
+}
+
+// @Note Linear light in, darkened, back to sRGB and premultiplied by the alpha. Every row and scaling mode ends with this.
+inline u32 ShadeChannel(shade_row *Row, float Linear)
+{
+	return (u32)(EncodeSRGB(Clamp01(Linear - Row->Darken)) * Row->Alpha + 0.5f);
+}
+
+// @Note The same for the CPU rows and the shaders' constant buffer
+internal effect_constants GetEffectConstants(shade_params Shade)
+{
+	effect_params *Effects = &Shade.Effects;
+	
+	effect_constants Result;
+	Result.Alpha         = Clamp01(Shade.Alpha);
+	Result.Darken        = SRGBToLinear(Shade.Darken);
+	Result.Contrast      = Effects->Contrast;
+	Result.EdgeStrength  = Effects->EdgeStrength;
+	Result.EdgeColour[3] = 0.0f;
+	for (int Channel = 0; Channel < 3; ++Channel)
+	{
+		Result.EdgeColour[Channel] = SRGBToLinear(Clamp01(Effects->EdgeColour[Channel]));
+		Result.KeyColour[Channel]  = SRGBToLinear(Clamp01(Effects->KeyColour[Channel]));
+	}
+	Result.KeyTolerance = Effects->KeyTolerance;
+	
+	return Result;
+}
+
+// @Note An effect chain samples bilinear, see effect_flag
+inline scale_mode GetShadeScale(shade_params *Shade)
+{
+	return Shade->Effects.Key ? ScaleMode_Bilinear : Shade->Scale;
+}
+
+//
+// Scalar, the reference
+//
+
+internal SHADE_ROW(ShadeRowScalar)
+{
+	float *Decode = ColourTables.SRGBDecode;
+	
+	u8 *Dest = (u8 *)(Destination + Begin);
+	for (int X = Begin; X < End; ++X)
+	{
+		float PixelU = Row->U + (float)X * Row->StepU;
+		float PixelV = Row->V + (float)X * Row->StepV;
+		
+		// @Note MIN_MAG_LINEAR with the edges clamped to the crop
+		float U  = Min(Max(PixelU, Row->MinU), Row->MaxU);
+		int   X0 = (int)U;
+		int   X1 = Min(X0 + 1, Row->LastX);
+		float FX = U - (float)X0;
+		
+		float V  = Min(Max(PixelV, Row->MinV), Row->MaxV);
+		int   Y0 = (int)V;
+		int   Y1 = Min(Y0 + 1, Row->LastY);
+		float FY = V - (float)Y0;
+		
+		u8 *Row0 = Row->Texels + Y0 * Row->Pitch;
+		u8 *Row1 = Row->Texels + Y1 * Row->Pitch;
+		
+		u8 *T00 = Row0 + X0 * BITMAP_BYTES_PER_PIXEL;
+		u8 *T10 = Row0 + X1 * BITMAP_BYTES_PER_PIXEL;
+		u8 *T01 = Row1 + X0 * BITMAP_BYTES_PER_PIXEL;
+		u8 *T11 = Row1 + X1 * BITMAP_BYTES_PER_PIXEL;
+		
+		for (int Channel = 0; Channel < 3; ++Channel)
+		{
+			float C00 = Decode[T00[Channel]];
+			float C10 = Decode[T10[Channel]];
+			float C01 = Decode[T01[Channel]];
+			float C11 = Decode[T11[Channel]];
+			
+			float Top    = C00 + (C10 - C00) * FX;
+			float Bottom = C01 + (C11 - C01) * FX;
+			float Sample = Top + (Bottom - Top) * FY;
+			
+			// Darken RGB absolute, premultiplied by the alpha
+			Dest[Channel] = (u8)ShadeChannel(Row, Sample);
+		}
+		
+		Dest[3] = (u8)Row->AlphaByte;
+		Dest += BITMAP_BYTES_PER_PIXEL;
+	}
+}
+
+//
+// SSE2, four pixels at a time. No gather and no 32-bit min before SSE4.1, the texel fetch and the table lookups are scalar.
+//
+
+#if defined(SHADE_X86)
+
+inline __m128 DecodeChannelSSE2(u32 *Texels, int Channel)
+{
+	float *Decode = ColourTables.SRGBDecode;
+	int Shift = 8 * Channel;
+	return _mm_setr_ps(Decode[(Texels[0] >> Shift) & 0xFF], Decode[(Texels[1] >> Shift) & 0xFF],
+					   Decode[(Texels[2] >> Shift) & 0xFF], Decode[(Texels[3] >> Shift) & 0xFF]);
+}
+
+// @Note EncodeSRGB four at a time, Linear has to be 0..1
+inline __m128 EncodeSRGBSSE2(__m128 Linear)
+{
+	__m128i Steps = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(Linear, _mm_set1_ps((float)SRGB_ENCODE_STEPS)), _mm_set1_ps(0.5f)));
+	
+	alignas(16) s32 Step[4];
+	_mm_store_si128((__m128i *)Step, Steps);
+	
+	float *Encode = ColourTables.SRGBEncode;
+	return _mm_setr_ps(Encode[Step[0]], Encode[Step[1]], Encode[Step[2]], Encode[Step[3]]);
+}
+
+// @Note ShadeChannel four at a time
+inline __m128i ShadeChannelSSE2(__m128 Sample, __m128 Darken, __m128 Alpha)
+{
+	__m128 Shaded = _mm_min_ps(_mm_max_ps(_mm_sub_ps(Sample, Darken), _mm_setzero_ps()), _mm_set1_ps(1.0f));
+	return _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(EncodeSRGBSSE2(Shaded), Alpha), _mm_set1_ps(0.5f)));
+}
+
+internal SHADE_ROW(ShadeRowSSE2)
+{
+	__m128 StepU  = _mm_set1_ps(Row->StepU);
+	__m128 StepV  = _mm_set1_ps(Row->StepV);
+	__m128 MinU   = _mm_set1_ps(Row->MinU);
+	__m128 MinV   = _mm_set1_ps(Row->MinV);
+	__m128 MaxU   = _mm_set1_ps(Row->MaxU);
+	__m128 MaxV   = _mm_set1_ps(Row->MaxV);
+	__m128 Alpha  = _mm_set1_ps(Row->Alpha);
+	__m128 Darken = _mm_set1_ps(Row->Darken);
+	__m128i AlphaBits = _mm_set1_epi32((int)(Row->AlphaByte << 24));
+	
+	int X = Begin;
+	for (; X + 4 <= End; X += 4)
+	{
+		__m128 PixelX = _mm_cvtepi32_ps(_mm_add_epi32(_mm_set1_epi32(X), _mm_setr_epi32(0, 1, 2, 3)));
+		__m128 U = _mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_set1_ps(Row->U), _mm_mul_ps(PixelX, StepU)), MinU), MaxU);
+		__m128 V = _mm_min_ps(_mm_max_ps(_mm_add_ps(_mm_set1_ps(Row->V), _mm_mul_ps(PixelX, StepV)), MinV), MaxV);
+		
+		__m128i X0 = _mm_cvttps_epi32(U);
+		__m128i Y0 = _mm_cvttps_epi32(V);
+		__m128 FX = _mm_sub_ps(U, _mm_cvtepi32_ps(X0));
+		__m128 FY = _mm_sub_ps(V, _mm_cvtepi32_ps(Y0));
+		
+		alignas(16) s32 X0s[4];
+		alignas(16) s32 Y0s[4];
+		_mm_store_si128((__m128i *)X0s, X0);
+		_mm_store_si128((__m128i *)Y0s, Y0);
+		
+		alignas(16) u32 Taps[4][4];
+		for (int Lane = 0; Lane < 4; ++Lane)
+		{
+			int X1 = Min(X0s[Lane] + 1, Row->LastX);
+			int Y1 = Min(Y0s[Lane] + 1, Row->LastY);
+			
+			u32 *Row0 = (u32 *)(Row->Texels + Y0s[Lane] * Row->Pitch);
+			u32 *Row1 = (u32 *)(Row->Texels + Y1 * Row->Pitch);
+			
+			Taps[0][Lane] = Row0[X0s[Lane]];
+			Taps[1][Lane] = Row0[X1];
+			Taps[2][Lane] = Row1[X0s[Lane]];
+			Taps[3][Lane] = Row1[X1];
+		}
+		
+		__m128i Output = AlphaBits;
+		for (int Channel = 0; Channel < 3; ++Channel)
+		{
+			__m128 C00 = DecodeChannelSSE2(Taps[0], Channel);
+			__m128 C10 = DecodeChannelSSE2(Taps[1], Channel);
+			__m128 C01 = DecodeChannelSSE2(Taps[2], Channel);
+			__m128 C11 = DecodeChannelSSE2(Taps[3], Channel);
+			
+			__m128 Top    = _mm_add_ps(C00, _mm_mul_ps(_mm_sub_ps(C10, C00), FX));
+			__m128 Bottom = _mm_add_ps(C01, _mm_mul_ps(_mm_sub_ps(C11, C01), FX));
+			__m128 Sample = _mm_add_ps(Top, _mm_mul_ps(_mm_sub_ps(Bottom, Top), FY));
+			
+			__m128i Byte = ShadeChannelSSE2(Sample, Darken, Alpha);
+			
+			Output = _mm_or_si128(Output, _mm_sll_epi32(Byte, _mm_cvtsi32_si128(8 * Channel)));
+		}
+		
+		_mm_storeu_si128((__m128i *)(Destination + X), Output);
+	}
+	
+	ShadeRowScalar(Row, Destination, X, End);
+}
+
+//
+// AVX2, eight pixels at a time, the texels and the table lookups are gathers
+//
+
+TARGET_AVX2 inline __m256 DecodeChannelAVX2(__m256i Texels, int Channel)
+{
+	__m256i Shifted = _mm256_srl_epi32(Texels, _mm_cvtsi32_si128(8 * Channel));
+	return _mm256_i32gather_ps(ColourTables.SRGBDecode, _mm256_and_si256(Shifted, _mm256_set1_epi32(0xFF)), 4);
+}
+
+// @Note EncodeSRGB eight at a time, Linear has to be 0..1
+TARGET_AVX2 inline __m256 EncodeSRGBAVX2(__m256 Linear)
+{
+	__m256i Steps = _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(Linear, _mm256_set1_ps((float)SRGB_ENCODE_STEPS)), _mm256_set1_ps(0.5f)));
+	return _mm256_i32gather_ps(ColourTables.SRGBEncode, Steps, 4);
+}
+
+// @Note ShadeChannel eight at a time
+TARGET_AVX2 inline __m256i ShadeChannelAVX2(__m256 Sample, __m256 Darken, __m256 Alpha)
+{
+	__m256 Shaded = _mm256_min_ps(_mm256_max_ps(_mm256_sub_ps(Sample, Darken), _mm256_setzero_ps()), _mm256_set1_ps(1.0f));
+	return _mm256_cvttps_epi32(_mm256_add_ps(_mm256_mul_ps(EncodeSRGBAVX2(Shaded), Alpha), _mm256_set1_ps(0.5f)));
+}
+
+TARGET_AVX2 internal SHADE_ROW(ShadeRowAVX2)
+{
+	__m256 StepU  = _mm256_set1_ps(Row->StepU);
+	__m256 StepV  = _mm256_set1_ps(Row->StepV);
+	__m256 MinU   = _mm256_set1_ps(Row->MinU);
+	__m256 MinV   = _mm256_set1_ps(Row->MinV);
+	__m256 MaxU   = _mm256_set1_ps(Row->MaxU);
+	__m256 MaxV   = _mm256_set1_ps(Row->MaxV);
+	__m256 Alpha  = _mm256_set1_ps(Row->Alpha);
+	__m256 Darken = _mm256_set1_ps(Row->Darken);
+	__m256i LastX = _mm256_set1_epi32(Row->LastX);
+	__m256i LastY = _mm256_set1_epi32(Row->LastY);
+	__m256i Pitch = _mm256_set1_epi32(Row->Pitch);
+	__m256i OneTexel  = _mm256_set1_epi32(1);
+	__m256i AlphaBits = _mm256_set1_epi32((int)(Row->AlphaByte << 24));
+	int const *Texels = (int const *)Row->Texels;
+	
+	int X = Begin;
+	for (; X + 8 <= End; X += 8)
+	{
+		__m256 PixelX = _mm256_cvtepi32_ps(_mm256_add_epi32(_mm256_set1_epi32(X), _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7)));
+		__m256 U = _mm256_min_ps(_mm256_max_ps(_mm256_add_ps(_mm256_set1_ps(Row->U), _mm256_mul_ps(PixelX, StepU)), MinU), MaxU);
+		__m256 V = _mm256_min_ps(_mm256_max_ps(_mm256_add_ps(_mm256_set1_ps(Row->V), _mm256_mul_ps(PixelX, StepV)), MinV), MaxV);
+		
+		__m256i X0 = _mm256_cvttps_epi32(U);
+		__m256i Y0 = _mm256_cvttps_epi32(V);
+		__m256i X1 = _mm256_min_epi32(_mm256_add_epi32(X0, OneTexel), LastX);
+		__m256i Y1 = _mm256_min_epi32(_mm256_add_epi32(Y0, OneTexel), LastY);
+		__m256 FX = _mm256_sub_ps(U, _mm256_cvtepi32_ps(X0));
+		__m256 FY = _mm256_sub_ps(V, _mm256_cvtepi32_ps(Y0));
+		
+		// @Note Byte offsets, the atlas tops out at 8192x8192 so they fit
+		__m256i Row0 = _mm256_mullo_epi32(Y0, Pitch);
+		__m256i Row1 = _mm256_mullo_epi32(Y1, Pitch);
+		__m256i Column0 = _mm256_slli_epi32(X0, 2);
+		__m256i Column1 = _mm256_slli_epi32(X1, 2);
+		
+		__m256i T00 = _mm256_i32gather_epi32(Texels, _mm256_add_epi32(Row0, Column0), 1);
+		__m256i T10 = _mm256_i32gather_epi32(Texels, _mm256_add_epi32(Row0, Column1), 1);
+		__m256i T01 = _mm256_i32gather_epi32(Texels, _mm256_add_epi32(Row1, Column0), 1);
+		__m256i T11 = _mm256_i32gather_epi32(Texels, _mm256_add_epi32(Row1, Column1), 1);
+		
+		__m256i Output = AlphaBits;
+		for (int Channel = 0; Channel < 3; ++Channel)
+		{
+			__m256 C00 = DecodeChannelAVX2(T00, Channel);
+			__m256 C10 = DecodeChannelAVX2(T10, Channel);
+			__m256 C01 = DecodeChannelAVX2(T01, Channel);
+			__m256 C11 = DecodeChannelAVX2(T11, Channel);
+			
+			__m256 Top    = _mm256_add_ps(C00, _mm256_mul_ps(_mm256_sub_ps(C10, C00), FX));
+			__m256 Bottom = _mm256_add_ps(C01, _mm256_mul_ps(_mm256_sub_ps(C11, C01), FX));
+			__m256 Sample = _mm256_add_ps(Top, _mm256_mul_ps(_mm256_sub_ps(Bottom, Top), FY));
+			
+			__m256i Byte = ShadeChannelAVX2(Sample, Darken, Alpha);
+			
+			Output = _mm256_or_si256(Output, _mm256_sll_epi32(Byte, _mm_cvtsi32_si128(8 * Channel)));
+		}
+		
+		_mm256_storeu_si256((__m256i *)(Destination + X), Output);
+	}
+	
+	ShadeRowScalar(Row, Destination, X, End);
+}
+
+internal bool CPUHasAVX2()
+{
+#if defined(_MSC_VER)
+	int Info[4];
+	__cpuid(Info, 0);
+	if (Info[0] < 7)
+	{
+		return false;
+	}
+	
+	// @Note The CPU having it isn't enough, the OS has to save the YMM registers too
+	__cpuid(Info, 1);
+	bool HasAVX = (Info[2] & (1 << 27)) && (Info[2] & (1 << 28)) && ((_xgetbv(0) & 6) == 6);
+	
+	__cpuidex(Info, 7, 0);
+	return HasAVX && (Info[1] & (1 << 5));
+#else
+	return __builtin_cpu_supports("avx2");
+#endif
+}
+
+#endif
+
+//
+// NEON, four pixels at a time. No gather either.
+//
+
+#if defined(SHADE_NEON)
+
+inline float32x4_t DecodeChannelNEON(u32 *Texels, int Channel)
+{
+	float *Decode = ColourTables.SRGBDecode;
+	int Shift = 8 * Channel;
+	float Lanes[4] = { Decode[(Texels[0] >> Shift) & 0xFF], Decode[(Texels[1] >> Shift) & 0xFF],
+					   Decode[(Texels[2] >> Shift) & 0xFF], Decode[(Texels[3] >> Shift) & 0xFF] };
+	return vld1q_f32(Lanes);
+}
+
+// @Note EncodeSRGB four at a time, Linear has to be 0..1
+inline float32x4_t EncodeSRGBNEON(float32x4_t Linear)
+{
+	uint32x4_t Steps = vcvtq_u32_f32(vaddq_f32(vmulq_f32(Linear, vdupq_n_f32((float)SRGB_ENCODE_STEPS)), vdupq_n_f32(0.5f)));
+	
+	u32 Step[4];
+	vst1q_u32(Step, Steps);
+	
+	float *Encode = ColourTables.SRGBEncode;
+	float Codes[4] = { Encode[Step[0]], Encode[Step[1]], Encode[Step[2]], Encode[Step[3]] };
+	return vld1q_f32(Codes);
+}
+
+// @Note ShadeChannel four at a time
+inline uint32x4_t ShadeChannelNEON(float32x4_t Sample, float32x4_t Darken, float32x4_t Alpha)
+{
+	float32x4_t Shaded = vminq_f32(vmaxq_f32(vsubq_f32(Sample, Darken), vdupq_n_f32(0.0f)), vdupq_n_f32(1.0f));
+	return vcvtq_u32_f32(vaddq_f32(vmulq_f32(EncodeSRGBNEON(Shaded), Alpha), vdupq_n_f32(0.5f)));
+}
+
+internal SHADE_ROW(ShadeRowNEON)
+{
+	float32x4_t StepU  = vdupq_n_f32(Row->StepU);
+	float32x4_t StepV  = vdupq_n_f32(Row->StepV);
+	float32x4_t MinU   = vdupq_n_f32(Row->MinU);
+	float32x4_t MinV   = vdupq_n_f32(Row->MinV);
+	float32x4_t MaxU   = vdupq_n_f32(Row->MaxU);
+	float32x4_t MaxV   = vdupq_n_f32(Row->MaxV);
+	float32x4_t Alpha  = vdupq_n_f32(Row->Alpha);
+	float32x4_t Darken = vdupq_n_f32(Row->Darken);
+	uint32x4_t AlphaBits = vdupq_n_u32(Row->AlphaByte << 24);
+	
+	s32 LaneOffsets[4] = { 0, 1, 2, 3 };
+	int32x4_t Lanes = vld1q_s32(LaneOffsets);
+	
+	int X = Begin;
+	for (; X + 4 <= End; X += 4)
+	{
+		float32x4_t PixelX = vcvtq_f32_s32(vaddq_s32(vdupq_n_s32(X), Lanes));
+		float32x4_t U = vminq_f32(vmaxq_f32(vaddq_f32(vdupq_n_f32(Row->U), vmulq_f32(PixelX, StepU)), MinU), MaxU);
+		float32x4_t V = vminq_f32(vmaxq_f32(vaddq_f32(vdupq_n_f32(Row->V), vmulq_f32(PixelX, StepV)), MinV), MaxV);
+		
+		int32x4_t X0 = vcvtq_s32_f32(U);
+		int32x4_t Y0 = vcvtq_s32_f32(V);
+		float32x4_t FX = vsubq_f32(U, vcvtq_f32_s32(X0));
+		float32x4_t FY = vsubq_f32(V, vcvtq_f32_s32(Y0));
+		
+		s32 X0s[4];
+		s32 Y0s[4];
+		vst1q_s32(X0s, X0);
+		vst1q_s32(Y0s, Y0);
+		
+		u32 Taps[4][4];
+		for (int Lane = 0; Lane < 4; ++Lane)
+		{
+			int X1 = Min(X0s[Lane] + 1, Row->LastX);
+			int Y1 = Min(Y0s[Lane] + 1, Row->LastY);
+			
+			u32 *Row0 = (u32 *)(Row->Texels + Y0s[Lane] * Row->Pitch);
+			u32 *Row1 = (u32 *)(Row->Texels + Y1 * Row->Pitch);
+			
+			Taps[0][Lane] = Row0[X0s[Lane]];
+			Taps[1][Lane] = Row0[X1];
+			Taps[2][Lane] = Row1[X0s[Lane]];
+			Taps[3][Lane] = Row1[X1];
+		}
+		
+		uint32x4_t Output = AlphaBits;
+		for (int Channel = 0; Channel < 3; ++Channel)
+		{
+			float32x4_t C00 = DecodeChannelNEON(Taps[0], Channel);
+			float32x4_t C10 = DecodeChannelNEON(Taps[1], Channel);
+			float32x4_t C01 = DecodeChannelNEON(Taps[2], Channel);
+			float32x4_t C11 = DecodeChannelNEON(Taps[3], Channel);
+			
+			float32x4_t Top    = vaddq_f32(C00, vmulq_f32(vsubq_f32(C10, C00), FX));
+			float32x4_t Bottom = vaddq_f32(C01, vmulq_f32(vsubq_f32(C11, C01), FX));
+			float32x4_t Sample = vaddq_f32(Top, vmulq_f32(vsubq_f32(Bottom, Top), FY));
+			
+			uint32x4_t Byte = ShadeChannelNEON(Sample, Darken, Alpha);
+			
+			Output = vorrq_u32(Output, vshlq_u32(Byte, vdupq_n_s32(8 * Channel)));
+		}
+		
+		vst1q_u32(Destination + X, Output);
+	}
+	
+	ShadeRowScalar(Row, Destination, X, End);
+}
+
+#endif
+
+//
+// Dispatch
+//
+
+// Returns NULL if this build or this CPU doesn't have it
+internal shade_row_function *GetShadeRow(shade_kernel Kernel)
+{
+	switch (Kernel)
+	{
+		case ShadeKernel_Scalar: return ShadeRowScalar;
+#if defined(SHADE_X86)
+		case ShadeKernel_SSE2: return ShadeRowSSE2;
+		case ShadeKernel_AVX2: return CPUHasAVX2() ? ShadeRowAVX2 : NULL;
+#endif
+#if defined(SHADE_NEON)
+		case ShadeKernel_NEON: return ShadeRowNEON;
+#endif
+		default: return NULL;
+	}
+}
+
+internal shade_kernel GetBestShadeKernel()
+{
+	for (int Kernel = ShadeKernel_Count - 1; Kernel > ShadeKernel_Scalar; --Kernel)
+	{
+		if (GetShadeRow((shade_kernel)Kernel))
+		{
+			return (shade_kernel)Kernel;
+		}
+	}
+	
+	return ShadeKernel_Scalar;
+}
+
+//
+// One piece: its crop slot sampled into its part of the overlay's display slot, same as one instance of the D3D11 draw
+//
+// @Note Destination is in back buffer pixels and doesn't have to land on pixel edges, a pixel is
+// drawn when its center is inside like the rasterizer does, so pieces that share an edge don't overlap.
+//
+
+struct shade_setup
+{
+	// @Note Row is the top one, row Y of Rect starts at Row.U + Y * StepUY, Row.V + Y * StepVY
+	box Rect;
+	shade_row Row;
+	float StepUY;
+	float StepVY;
+};
+
+// Returns false if the piece covers no pixel centers of the target
+internal bool SetupShadePiece(shade_setup *Setup, bitmap *Target, v2 DestinationMin, v2 DestinationMax, bitmap *Texture,
+							  box CropSlot, uv_transform UV, shade_params Shade)
+{
+	box Rect;
+	Rect.Left   = Max(CeilToInt(DestinationMin.X - 0.5f), 0);
+	Rect.Top    = Max(CeilToInt(DestinationMin.Y - 0.5f), 0);
+	Rect.Right  = Min(CeilToInt(DestinationMax.X - 0.5f), Target->Width);
+	Rect.Bottom = Min(CeilToInt(DestinationMax.Y - 0.5f), Target->Height);
+	if (BoxIsEmpty(Rect))
+	{
+		return false;
+	}
+	
+	// @Note Same as the vertex shader, in atlas texels instead of UVs
+	float DestinationWidth  = DestinationMax.X - DestinationMin.X;
+	float DestinationHeight = DestinationMax.Y - DestinationMin.Y;
+	
+	UV = GetAtlasUV(UV, CropSlot, Texture->Width, Texture->Height);
+	float StepUX = UV.AxisX.X * (float)Texture->Width  / DestinationWidth;
+	float StepVX = UV.AxisX.Y * (float)Texture->Height / DestinationWidth;
+	float StepUY = UV.AxisY.X * (float)Texture->Width  / DestinationHeight;
+	float StepVY = UV.AxisY.Y * (float)Texture->Height / DestinationHeight;
+	
+	// Pixel centers, then texel centers
+	float OffsetX = (float)Rect.Left + 0.5f - DestinationMin.X;
+	float OffsetY = (float)Rect.Top  + 0.5f - DestinationMin.Y;
+	
+	shade_row *Row = &Setup->Row;
+	Row->Texels    = Texture->Memory;
+	Row->Pitch     = Texture->Pitch;
+	Row->U         = UV.Origin.X * (float)Texture->Width  + OffsetX * StepUX + OffsetY * StepUY - 0.5f;
+	Row->V         = UV.Origin.Y * (float)Texture->Height + OffsetX * StepVX + OffsetY * StepVY - 0.5f;
+	Row->StepU     = StepUX;
+	Row->StepV     = StepVX;
+	Row->MinU      = (float)CropSlot.Left;
+	Row->MinV      = (float)CropSlot.Top;
+	Row->MaxU      = (float)(CropSlot.Right  - 1);
+	Row->MaxV      = (float)(CropSlot.Bottom - 1);
+	Row->LastX     = CropSlot.Right  - 1;
+	Row->LastY     = CropSlot.Bottom - 1;
+	Row->Effects   = GetEffectConstants(Shade);
+	Row->EffectKey = Shade.Effects.Key;
+	Row->Alpha     = Row->Effects.Alpha;
+	Row->Darken    = Row->Effects.Darken;
+	Row->AlphaByte = UnitToByte(Shade.Alpha);
+	
+	Setup->Rect   = Rect;
+	Setup->StepUY = StepUY;
+	Setup->StepVY = StepVY;
+	
+	return true;
+}
+
+// @Note Any part of the setup's Rect. Every pixel comes out the same whichever part it is drawn with.
+internal void ShadeRect(shade_setup *Setup, bitmap *Target, box Rect, shade_row_function *ShadeRow)
+{
+	shade_row Row = Setup->Row;
+	int Begin = Rect.Left  - Setup->Rect.Left;
+	int End   = Rect.Right - Setup->Rect.Left;
+	
+	u32 *DestRow = (u32 *)(Target->Memory + Rect.Top * Target->Pitch) + Setup->Rect.Left;
+	for (int Y = Rect.Top; Y < Rect.Bottom; ++Y)
+	{
+		float RowY = (float)(Y - Setup->Rect.Top);
+		Row.U = Setup->Row.U + RowY * Setup->StepUY;
+		Row.V = Setup->Row.V + RowY * Setup->StepVY;
+		
+		ShadeRow(&Row, DestRow, Begin, End);
+		DestRow = (u32 *)((u8 *)DestRow + Target->Pitch);
+	}
+}
+
+internal void ShadePiece(bitmap *Target, v2 DestinationMin, v2 DestinationMax, bitmap *Texture, box CropSlot, uv_transform UV,
+						 shade_params Shade, shade_row_function *ShadeRow)
+{
+	shade_setup Setup;
+	if (SetupShadePiece(&Setup, Target, DestinationMin, DestinationMax, Texture, CropSlot, UV, Shade))
+	{
+		ShadeRect(&Setup, Target, Setup.Rect, ShadeRow);
+	}
+}
@@ -0,0 +1,940 @@
+//
+// Pure CPU backend: a synthetic desktop to capture from and a compositor that mirrors the D3D11 one
+//
+
+//
+// Synthetic frame source
+//
+
+struct synthetic_source
+{
+	// @Note The desktop before the output's rotation. It is the captured surface unless the output is HDR,
+	// then Surface is and every change to Desktop gets encoded into it, the way DWM puts SDR windows on it.
+	bitmap Desktop;
+	bitmap Surface;
+	surface_format Format;
+	float WhiteNits;
+	convert_row_function *EncodeRow;
+	
+	u32 FrameIndex;
+	s64 Time; // Microseconds, this is also the clock for the whole headless pipeline
+	
+	// @Note Desktop is the surface, the user sees it turned by this much
+	display_rotation Rotation;
+	
+	// @Note After the first frame nothing changes and every acquire waits out its timeout
+	bool IsStatic;
+	bool IsInvalid;
+	
+	// @Note Side of the square that moves around the desktop every frame, the rest of the desktop is static
+	int MoverSize;
+	box LastMover;
+	
+	// @Note Report the whole desktop dirty every frame, like an animation somewhere that shares a dirty rect with everything
+	bool CoarseDirtyRects;
+	
+	box DirtyRects[2];
+};
+
+// @Note The pattern follows the virtual desktop the user sees, so it carries on unbroken
+// from one output to the next whatever they are rotated by
+internal void FillDesktopPattern(bitmap *Desktop, display_rotation Rotation, int OriginX, int OriginY)
+{
+	bool Swap = RotationSwapsAxes(Rotation);
+	int DesktopWidth  = Swap ? Desktop->Height : Desktop->Width;
+	int DesktopHeight = Swap ? Desktop->Width  : Desktop->Height;
+	
+	u8 *Row = Desktop->Memory;
+	for (int Y = 0; Y < Desktop->Height; ++Y)
+	{
+		u32 *Pixel = (u32 *)Row;
+		for (int X = 0; X < Desktop->Width; ++X)
+		{
+			box Texel = SurfaceToDesktopBox(box{ X, Y, X + 1, Y + 1 }, DesktopWidth, DesktopHeight, Rotation);
+			int DesktopX = OriginX + Texel.Left;
+			int DesktopY = OriginY + Texel.Top;
+			
+			u8 Blue  = (u8)DesktopX;
+			u8 Green = (u8)DesktopY;
+			u8 Red   = (u8)(DesktopX ^ DesktopY);
+			*Pixel++ = (0xFFu << 24) | (Red << 16) | (Green << 8) | Blue;
+		}
+		
+		Row += Desktop->Pitch;
+	}
+}
+
+internal void FillBox(bitmap *Bitmap, box Box, u32 Colour)
+{
+	Box.Left   = Max(Box.Left, 0);
+	Box.Top    = Max(Box.Top, 0);
+	Box.Right  = Min(Box.Right, Bitmap->Width);
+	Box.Bottom = Min(Box.Bottom, Bitmap->Height);
+	
+	u8 *Row = Bitmap->Memory + Box.Top * Bitmap->Pitch + Box.Left * BITMAP_BYTES_PER_PIXEL;
+	for (int Y = Box.Top; Y < Box.Bottom; ++Y)
+	{
+		u32 *Pixel = (u32 *)Row;
+		for (int X = Box.Left; X < Box.Right; ++X)
+		{
+			*Pixel++ = Colour;
+		}
+		
+		Row += Bitmap->Pitch;
+	}
+}
+
+// @Note Desktop size is the rotated one and the origin is where the output is on the virtual desktop, both in physical pixels
+internal void InitializeSyntheticSource(synthetic_source *Source, memory_arena *Arena, int DesktopWidth, int DesktopHeight,
+									   display_rotation Rotation, int OriginX, int OriginY)
+{
+	bool Swap = RotationSwapsAxes(Rotation);
+	
+	Source->Desktop    = PushBitmap(Arena, Swap ? DesktopHeight : DesktopWidth, Swap ? DesktopWidth : DesktopHeight);
+	Source->FrameIndex = 0;
+	Source->Time       = 1;
+	Source->Rotation   = Rotation;
+	Source->IsStatic   = false;
+	Source->IsInvalid  = false;
+	Source->MoverSize  = 64;
+	Source->LastMover  = box{ 0, 0, 0, 0 };
+	
+	Source->CoarseDirtyRects = false;
+	
+	Source->Surface   = Source->Desktop;
+	Source->Format    = SurfaceFormat_BGRA8;
+	Source->WhiteNits = SCRGB_WHITE_NITS;
+	Source->EncodeRow = NULL;
+	
+	FillDesktopPattern(&Source->Desktop, Rotation, OriginX, OriginY);
+}
+
+// @Note Part of the desktop into the HDR surface
+internal void EncodeSyntheticBox(synthetic_source *Source, box Box)
+{
+	if (!Source->EncodeRow)
+	{
+		return;
+	}
+	
+	Box = IntersectBoxes(Box, box{ 0, 0, Source->Desktop.Width, Source->Desktop.Height });
+	colour_convert Expand = GetColourExpand(Source->Format, Source->WhiteNits);
+	u32 BytesPerPixel = GetSurfaceBytesPerPixel(Source->Format);
+	
+	for (int Y = Box.Top; Y < Box.Bottom; ++Y)
+	{
+		u8 *DesktopRow = Source->Desktop.Memory + Y * Source->Desktop.Pitch + Box.Left * BITMAP_BYTES_PER_PIXEL;
+		u8 *SurfaceRow = Source->Surface.Memory + Y * Source->Surface.Pitch + Box.Left * BytesPerPixel;
+		Source->EncodeRow(&Expand, DesktopRow, SurfaceRow, 0, GetBoxWidth(Box));
+	}
+}
+
+// @Note Captures as an HDR output would with SDR white at WhiteNits. Call before the first acquire.
+internal void SetSyntheticFormat(synthetic_source *Source, memory_arena *Arena, surface_format Format, float WhiteNits, shade_kernel Kernel)
+{
+	Source->Format    = Format;
+	Source->WhiteNits = WhiteNits;
+	if (Format == SurfaceFormat_BGRA8)
+	{
+		return;
+	}
+	
+	u32 BytesPerPixel = GetSurfaceBytesPerPixel(Format);
+	Source->Surface.Width  = Source->Desktop.Width;
+	Source->Surface.Height = Source->Desktop.Height;
+	Source->Surface.Pitch  = Source->Desktop.Width * BytesPerPixel;
+	Source->Surface.Memory = (u8 *)PushSize(Arena, (size_t)Source->Surface.Pitch * Source->Surface.Height);
+	
+	Source->EncodeRow = (Format == SurfaceFormat_RGBA16F) ? GetExpandRow(Kernel) : EncodePQRowScalar;
+	if (!Source->EncodeRow)
+	{
+		Source->EncodeRow = ExpandSRGBRowScalar;
+	}
+	
+	EncodeSyntheticBox(Source, box{ 0, 0, Source->Desktop.Width, Source->Desktop.Height });
+}
+
+internal void SetSyntheticGeometry(synthetic_source *Source, captured_frame *Frame)
+{
+	bool Swap = RotationSwapsAxes(Source->Rotation);
+	
+	Frame->Surface       = &Source->Surface;
+	Frame->Format        = Source->Format;
+	Frame->WhiteNits     = Source->WhiteNits;
+	Frame->Rotation      = Source->Rotation;
+	Frame->DesktopWidth  = Swap ? Source->Desktop.Height : Source->Desktop.Width;
+	Frame->DesktopHeight = Swap ? Source->Desktop.Width  : Source->Desktop.Height;
+}
+
+internal FRAME_SOURCE_ACQUIRE(SyntheticAcquire)
+{
+	synthetic_source *Source = (synthetic_source *)Context;
+	bitmap *Desktop = &Source->Desktop;
+	
+	SetSyntheticGeometry(Source, Frame);
+	
+	if (Source->IsStatic && (Source->FrameIndex > 0))
+	{
+		if (!Source->IsInvalid)
+		{
+			Source->Time += (s64)TimeoutMS * 1000;
+			return AcquireResult_Timeout;
+		}
+		
+		// @Note Same desktop as before, handed over whole like a fresh duplication does
+		Source->IsInvalid = false;
+		
+		Frame->SourceWasReset    = true;
+		Frame->LastPresentTime   = Source->Time;
+		Frame->AccumulatedFrames = 0;
+		Frame->MetadataIsValid   = false;
+		Frame->MoveRectCount     = 0;
+		Frame->DirtyRectCount    = 0;
+		
+		return AcquireResult_Frame;
+	}
+	
+	// @Note Pretend a desktop update landed: paint over the old mover and draw it at its new spot
+	int Travel = Max(Desktop->Width - Source->MoverSize, 1);
+	int MoverX = (int)((Source->FrameIndex * 7) % Travel);
+	int MoverY = (Desktop->Height - Source->MoverSize) / 2;
+	
+	box Mover;
+	Mover.Left   = MoverX;
+	Mover.Top    = MoverY;
+	Mover.Right  = MoverX + Source->MoverSize;
+	Mover.Bottom = MoverY + Source->MoverSize;
+	
+	FillBox(Desktop, Source->LastMover, 0xFF202020);
+	FillBox(Desktop, Mover, 0xFF000000 | ((0x00FFFFFF - Source->FrameIndex * 0x010101) & 0x00FFFFFF));
+	EncodeSyntheticBox(Source, Source->LastMover);
+	EncodeSyntheticBox(Source, Mover);
+	
+	Source->DirtyRects[0] = Source->LastMover;
+	Source->DirtyRects[1] = Mover;
+	
+	// @Note The first frame is the whole desktop, like the first one from a new duplication
+	Frame->SourceWasReset = (Source->FrameIndex == 0) || Source->IsInvalid;
+	Source->IsInvalid     = false;
+	
+	Source->LastMover = Mover;
+	Source->FrameIndex++;
+	Source->Time += 16667; // 60Hz in microseconds
+	
+	Frame->LastPresentTime   = Source->Time;
+	Frame->AccumulatedFrames = 1;
+	Frame->MetadataIsValid   = true;
+	Frame->MoveRectCount     = 0;
+	Frame->MoveRects         = NULL;
+	Frame->DirtyRectCount    = 2;
+	Frame->DirtyRects        = Source->DirtyRects;
+	
+	if (Source->CoarseDirtyRects)
+	{
+		Source->DirtyRects[0] = box{ 0, 0, Desktop->Width, Desktop->Height };
+		Frame->DirtyRectCount = 1;
+	}
+	
+	return AcquireResult_Frame;
+}
+
+internal FRAME_SOURCE_RELEASE(SyntheticRelease)
+{
+	return true;
+}
+
+internal FRAME_SOURCE_INVALIDATE(SyntheticInvalidate)
+{
+	synthetic_source *Source = (synthetic_source *)Context;
+	Source->IsInvalid = true;
+}
+
+internal frame_source SyntheticFrameSource(synthetic_source *Source)
+{
+	frame_source Result;
+	Result.Context = Source;
+	Result.Acquire    = SyntheticAcquire;
+	Result.Release    = SyntheticRelease;
+	Result.Invalidate = SyntheticInvalidate;
+	Result.Select     = NULL;
+	
+	return Result;
+}
+
+//
+// Several synthetic outputs side by side, each one is its own source with its own worker
+//
+
+struct synthetic_desktop
+{
+	u32 OutputCount;
+	synthetic_source Outputs[MAX_OUTPUTS];
+};
+
+// @Note Every output keeps its own time, the pipeline goes by whichever is furthest along
+internal OVERLAY_CLOCK_NOW(SyntheticClockNow)
+{
+	synthetic_desktop *Desktop = (synthetic_desktop *)Context;
+	
+	s64 Time = 0;
+	for (u32 OutputIndex = 0; OutputIndex < Desktop->OutputCount; ++OutputIndex)
+	{
+		Time = Max(Time, Desktop->Outputs[OutputIndex].Time);
+	}
+	
+	return (u64)Time;
+}
+
+internal overlay_clock SyntheticClock(synthetic_desktop *Desktop)
+{
+	overlay_clock Result;
+	Result.Context = Desktop;
+	Result.Now     = SyntheticClockNow;
+	
+	return Result;
+}
+
+//
+// Capture ring copies of a bitmap surface, see overlay_ring.cpp
+//
+
+struct software_ring_copier
+{
+	platform_allocate_memory *AllocateMemory;
+	platform_free_memory     *FreeMemory;
+};
+
+// @Note The bitmap and its pixels in one allocation
+internal CAPTURE_RING_COPY(SoftwareRingCopy)
+{
+	software_ring_copier *Copier = (software_ring_copier *)Context;
+	bitmap *Desktop = (bitmap *)Frame->Surface;
+	bitmap *Copy    = (bitmap *)*Slot;
+	
+	box Whole = box{ 0, 0, Desktop->Width, Desktop->Height };
+	if (!Copy || (Copy->Width != Desktop->Width) || (Copy->Height != Desktop->Height) || (Copy->Pitch != Desktop->Pitch))
+	{
+		if (Copy)
+		{
+			Copier->FreeMemory(Copy, sizeof(bitmap) + (size_t)Copy->Pitch * Copy->Height);
+		}
+		
+		size_t Size = sizeof(bitmap) + (size_t)Desktop->Pitch * Desktop->Height;
+		Copy = (bitmap *)Copier->AllocateMemory(Size);
+		*Slot = Copy;
+		if (!Copy)
+		{
+			return false;
+		}
+		
+		Copy->Memory = (u8 *)(Copy + 1);
+		Copy->Width  = Desktop->Width;
+		Copy->Height = Desktop->Height;
+		Copy->Pitch  = Desktop->Pitch;
+		
+		Regions     = &Whole;
+		RegionCount = 1;
+	}
+	
+	u32 BytesPerPixel = GetSurfaceBytesPerPixel(Frame->Format);
+	for (u32 RegionIndex = 0; RegionIndex < RegionCount; ++RegionIndex)
+	{
+		box Region = IntersectBoxes(Regions[RegionIndex], Whole);
+		if (BoxIsEmpty(Region))
+		{
+			continue;
+		}
+		
+		size_t Offset = (size_t)Region.Top * Desktop->Pitch + (size_t)Region.Left * BytesPerPixel;
+		size_t Width  = (size_t)GetBoxWidth(Region) * BytesPerPixel;
+		for (int Y = Region.Top; Y < Region.Bottom; ++Y)
+		{
+			CopyBytes(Copy->Memory + Offset, Desktop->Memory + Offset, Width);
+			Offset += Desktop->Pitch;
+		}
+	}
+	
+	return true;
+}
+
+//
+// Software compositor
+//
+
+// @Note Same limit as a D3D_FEATURE_LEVEL_10_0 texture
+#define SOFTWARE_ATLAS_MAX_SIZE 8192
+
+// @Note 32KB of back buffer a tile, and about as much texture under it near 1:1, so a tile stays in L1/L2
+#define SOFTWARE_TILE_WIDTH  128
+#define SOFTWARE_TILE_HEIGHT 64
+
+// @Note Rows of a dirty rect copied per tile
+#define SOFTWARE_CROP_TILE_ROWS 32
+
+// @Note What a crop hands its tiles
+struct software_crop_batch
+{
+	// @Note Anything but BGRA8 goes through ConvertRow instead of a copy
+	bitmap *Desktop;
+	u32 DesktopBytesPerPixel;
+	convert_row_function *ConvertRow;
+	colour_convert Convert;
+	
+	bitmap *Texture;
+	box CutBox;
+	box Slot;
+	box *Regions;
+	u32 RegionCount;
+};
+
+// @Note What a shade hands its tiles, the back buffer in a grid
+struct software_shade_batch
+{
+	bitmap *Target;
+	shade_row_function **ShadeRows; // By the setup's effect key
+	u32 TilesAcross;
+	
+	// @Note Anything but bilinear draws through the scaler, which PrepareScale has set up for these setups
+	scale_mode ScaleMode;
+	scaler *Scaler;
+	
+	u32 SetupCount;
+	shade_setup Setups[MAX_CROP_PIECES];
+};
+
+struct software_compositor
+{
+	platform_allocate_memory *AllocateMemory;
+	platform_free_memory     *FreeMemory;
+	
+	// @Note Every overlay's crop, packed. Handed out by the pool, same as the D3D11 display texture
+	texture_pool TexturePool;
+	atlas_layout CropAtlas;
+	bitmap DisplayTexture;
+	
+	// @Note Every overlay's display, packed, same as the composition swap chain
+	atlas_layout DisplayAtlas;
+	bitmap BackBuffer;
+	
+	// @Note The fastest this CPU has unless told otherwise, see overlay_shade.cpp. A row for every effect
+	// key from it, see overlay_effects.cpp, key 0 is the plain shade.
+	shade_kernel ShadeKernel;
+	shade_row_function *ShadeRows[EffectKey_Count];
+	
+	// @Note By the same kernel, see overlay_convert.cpp. NULL for BGRA8.
+	convert_row_function *ConvertRows[SurfaceFormat_Count];
+	
+	// @Note Crops hash what they copied and only report a change if there was one, see overlay_hash.cpp
+	bool HashTiles;
+	change_detector Changes;
+	
+	// @Note Mip chains, weight tables and filtered rows for the scaling modes, see overlay_scale.cpp
+	scaler Scaler;
+	
+	// @Note NULL does every tile on the render thread
+	tile_pool *TilePool;
+	software_crop_batch CropBatch;
+	software_shade_batch ShadeBatch;
+	
+	// @Note Where the pieces with SamplesSurface get drawn from, clamped to the surface, see SoftwareSample
+	bitmap *SampledSurface;
+	box SampledBoxes[MAX_CROP_PIECES];
+	
+	compositor_memory  Memory;
+	compositor_traffic Traffic;
+	u64 PresentCount;
+};
+
+internal TEXTURE_POOL_CREATE(SoftwareCreateTexture)
+{
+	software_compositor *Compositor = (software_compositor *)Context;
+	Texture->Handle = Compositor->AllocateMemory((size_t)Texture->Width * Texture->Height * BITMAP_BYTES_PER_PIXEL);
+	
+	return Texture->Handle != NULL;
+}
+
+internal TEXTURE_POOL_DESTROY(SoftwareDestroyTexture)
+{
+	software_compositor *Compositor = (software_compositor *)Context;
+	Compositor->FreeMemory(Texture->Handle, (size_t)Texture->Width * Texture->Height * BITMAP_BYTES_PER_PIXEL);
+}
+
+// @Note Kernel has to be one GetShadeRow has, NEON shades the keys past 0 with the scalar effect row
+internal void SetShadeRows(software_compositor *Compositor, shade_kernel Kernel)
+{
+	for (u32 Key = 0; Key < EffectKey_Count; ++Key)
+	{
+		shade_row_function *ShadeRow = GetEffectRow(Kernel, Key);
+		Compositor->ShadeRows[Key] = ShadeRow ? ShadeRow : GetEffectRow(ShadeKernel_Scalar, Key);
+	}
+}
+
+// @Note A CPU with AVX2 but without F16C converts with the scalar rows
+internal void SetConvertRows(software_compositor *Compositor, shade_kernel Kernel)
+{
+	for (int Format = 0; Format < SurfaceFormat_Count; ++Format)
+	{
+		convert_row_function *ConvertRow = GetConvertRow((surface_format)Format, Kernel);
+		Compositor->ConvertRows[Format] = ConvertRow ? ConvertRow : GetConvertRow((surface_format)Format, ShadeKernel_Scalar);
+	}
+}
+
+internal void InitializeSoftwareCompositor(software_compositor *Compositor, platform_allocate_memory *AllocateMemory, platform_free_memory *FreeMemory)
+{
+	*Compositor = {};
+	Compositor->AllocateMemory = AllocateMemory;
+	Compositor->FreeMemory     = FreeMemory;
+	
+	InitializeTexturePool(&Compositor->TexturePool, Compositor, SoftwareCreateTexture, SoftwareDestroyTexture, BITMAP_BYTES_PER_PIXEL,
+						  false);
+	InitializeAtlasLayout(&Compositor->CropAtlas, SOFTWARE_ATLAS_MAX_SIZE);
+	InitializeAtlasLayout(&Compositor->DisplayAtlas, SOFTWARE_ATLAS_MAX_SIZE);
+	
+	InitializeColourTables();
+	
+	Compositor->ShadeKernel = GetBestShadeKernel();
+	SetShadeRows(Compositor, Compositor->ShadeKernel);
+	SetConvertRows(Compositor, Compositor->ShadeKernel);
+	
+	Compositor->HashTiles = true;
+	InitializeChangeDetector(&Compositor->Changes, AllocateMemory, FreeMemory, Compositor->ShadeKernel);
+	
+	InitializeScaler(&Compositor->Scaler, AllocateMemory, FreeMemory);
+}
+
+// Returns false and keeps the one it had if this build or CPU doesn't have the kernel
+internal bool SetShadeKernel(software_compositor *Compositor, shade_kernel Kernel)
+{
+	if (!GetShadeRow(Kernel))
+	{
+		return false;
+	}
+	
+	Compositor->ShadeKernel = Kernel;
+	SetShadeRows(Compositor, Kernel);
+	SetConvertRows(Compositor, Kernel);
+	
+	// @Note The hash and the compare go with it, every kernel hashes the same
+	Compositor->Changes.HashTile    = GetHashTile(Kernel);
+	Compositor->Changes.CompareTile = GetCompareTile(Kernel);
+	
+	return true;
+}
+
+internal void UpdateSoftwareMemory(software_compositor *Compositor)
+{
+	texture_pool *Pool = &Compositor->TexturePool;
+	compositor_memory *Memory = &Compositor->Memory;
+	
+	Memory->TextureBytes           = (size_t)Compositor->DisplayTexture.Pitch * Compositor->DisplayTexture.Height;
+	Memory->PooledBytes            = Pool->PooledBytes;
+	Memory->SwapChainBytes         = (size_t)Compositor->BackBuffer.Pitch * Compositor->BackBuffer.Height;
+	Memory->TextureAllocationCount = Pool->AllocationCount;
+	Memory->TextureReuseCount      = Pool->ReuseCount;
+}
+
+internal bool ResizeDisplayTexture(software_compositor *Compositor, int Width, int Height)
+{
+	bitmap *Texture = &Compositor->DisplayTexture;
+	if ((Texture->Width == Width) && (Texture->Height == Height))
+	{
+		return true;
+	}
+	
+	pooled_texture *Pooled = GetPooledTexture(&Compositor->TexturePool, Width, Height);
+	if (!Pooled)
+	{
+		*Texture = {};
+		UpdateSoftwareMemory(Compositor);
+		return false;
+	}
+	
+	Texture->Memory = (u8 *)Pooled->Handle;
+	Texture->Width  = Width;
+	Texture->Height = Height;
+	Texture->Pitch  = Width * BITMAP_BYTES_PER_PIXEL;
+	
+	UpdateSoftwareMemory(Compositor);
+	return true;
+}
+
+// @Note Same as ResizeBuffers, the old contents are gone and the whole thing gets cleared on the next draw anyway
+internal bool ResizeBackBuffer(software_compositor *Compositor, int Width, int Height)
+{
+	bitmap *Target = &Compositor->BackBuffer;
+	if ((Target->Width == Width) && (Target->Height == Height))
+	{
+		return true;
+	}
+	
+	if (Target->Memory)
+	{
+		Compositor->FreeMemory(Target->Memory, (size_t)Target->Pitch * Target->Height);
+		++Compositor->Memory.SwapChainResizeCount;
+	}
+	
+	Target->Width  = Width;
+	Target->Height = Height;
+	Target->Pitch  = Width * BITMAP_BYTES_PER_PIXEL;
+	Target->Memory = (u8 *)Compositor->AllocateMemory((size_t)Target->Pitch * Height);
+	if (!Target->Memory)
+	{
+		*Target = {};
+	}
+	
+	UpdateSoftwareMemory(Compositor);
+	
+	return Target->Memory != NULL;
+}
+
+internal COMPOSITOR_LAYOUT(SoftwareLayout)
+{
+	software_compositor *Compositor = (software_compositor *)Context;
+	
+	int Widths[ATLAS_MAX_SLOTS];
+	int Heights[ATLAS_MAX_SLOTS];
+	for (u32 PieceIndex = 0; PieceIndex < PieceCount; ++PieceIndex)
+	{
+		Widths[PieceIndex]  = Pieces[PieceIndex].Mapping.TextureWidth;
+		Heights[PieceIndex] = Pieces[PieceIndex].Mapping.TextureHeight;
+	}
+	
+	UpdateAtlasLayout(&Compositor->CropAtlas, Widths, Heights, PieceCount, SlotMoved);
+	
+	// @Note Out of memory leaves the bitmap empty and nothing gets cropped into it or drawn from it
+	atlas_packer *Packer = &Compositor->CropAtlas.Packer;
+	ResizeDisplayTexture(Compositor, Packer->Width, Packer->Height);
+	
+	// @Note A new texture starts with no hashes, every tile of it is a change
+	if (Compositor->HashTiles)
+	{
+		ResizeChangeDetector(&Compositor->Changes, Compositor->DisplayTexture.Width, Compositor->DisplayTexture.Height);
+		if (Compositor->Changes.Hashes)
+		{
+			ClearChangedTiles(&Compositor->Changes);
+		}
+	}
+	
+	for (u32 OverlayIndex = 0; OverlayIndex < State->OverlayCount; ++OverlayIndex)
+	{
+		Widths[OverlayIndex]  = Max(State->Overlays[OverlayIndex].DisplayWidth,  1);
+		Heights[OverlayIndex] = Max(State->Overlays[OverlayIndex].DisplayHeight, 1);
+	}
+	
+	// @Note Whatever was drawn gets drawn again anyway, where it ended up doesn't matter here
+	bool DisplayMoved[ATLAS_MAX_SLOTS];
+	UpdateAtlasLayout(&Compositor->DisplayAtlas, Widths, Heights, State->OverlayCount, DisplayMoved);
+	
+	box Bounds = GetAtlasBounds(&Compositor->DisplayAtlas);
+	ResizeBackBuffer(Compositor, Bounds.Right, Bounds.Bottom);
+}
+
+// @Note A tile is a band of rows of one region
+internal TILE_JOB(SoftwareCropTile)
+{
+	software_crop_batch *Batch = (software_crop_batch *)Context;
+	bitmap *Desktop = Batch->Desktop;
+	bitmap *Texture = Batch->Texture;
+	
+	for (u32 RegionIndex = 0; RegionIndex < Batch->RegionCount; ++RegionIndex)
+	{
+		box Region = IntersectBoxes(Batch->Regions[RegionIndex], Batch->CutBox);
+		if (BoxIsEmpty(Region))
+		{
+			continue;
+		}
+		
+		u32 BandCount = (u32)(GetBoxHeight(Region) + SOFTWARE_CROP_TILE_ROWS - 1) / SOFTWARE_CROP_TILE_ROWS;
+		if (TileIndex >= BandCount)
+		{
+			TileIndex -= BandCount;
+			continue;
+		}
+		
+		int Top    = Region.Top + (int)TileIndex * SOFTWARE_CROP_TILE_ROWS;
+		int Bottom = Min(Top + SOFTWARE_CROP_TILE_ROWS, Region.Bottom);
+		int Width  = GetBoxWidth(Region);
+		
+		int DestX = Batch->Slot.Left + (Region.Left - Batch->CutBox.Left);
+		int DestY = Batch->Slot.Top  + (Top - Batch->CutBox.Top);
+		
+		// @Note The conversion and the tone map happen on the way through, there is no HDR copy of the crop
+		u8 *SourceRow = Desktop->Memory + Top * Desktop->Pitch + Region.Left * Batch->DesktopBytesPerPixel;
+		u8 *DestRow   = Texture->Memory + DestY * Texture->Pitch + DestX * BITMAP_BYTES_PER_PIXEL;
+		for (int Y = Top; Y < Bottom; ++Y)
+		{
+			if (Batch->ConvertRow)
+			{
+				Batch->ConvertRow(&Batch->Convert, SourceRow, DestRow, 0, Width);
+			}
+			else
+			{
+				CopyBytes(DestRow, SourceRow, (size_t)Width * BITMAP_BYTES_PER_PIXEL);
+			}
+			
+			SourceRow += Desktop->Pitch;
+			DestRow   += Texture->Pitch;
+		}
+		
+		return;
+	}
+}
+
+internal COMPOSITOR_CROP(SoftwareCrop)
+{
+	software_compositor *Compositor = (software_compositor *)Context;
+	bitmap *Desktop = (bitmap *)Frame->Surface;
+	bitmap *Texture = &Compositor->DisplayTexture;
+	
+	box Slot = Compositor->CropAtlas.Slots[PieceIndex];
+	if (BoxIsEmpty(Slot) || !Texture->Memory)
+	{
+		return false;
+	}
+	
+	// @Note CopySubresourceRegion drops the copy if the box is out of bounds, clamp instead so the reference is useful
+	CutBox.Left   = Max(CutBox.Left, 0);
+	CutBox.Top    = Max(CutBox.Top, 0);
+	CutBox.Right  = Min(CutBox.Right,  Min(Desktop->Width,  CutBox.Left + GetBoxWidth(Slot)));
+	CutBox.Bottom = Min(CutBox.Bottom, Min(Desktop->Height, CutBox.Top  + GetBoxHeight(Slot)));
+	
+	// @Note A source that doesn't know its SDR white gets the default
+	float WhiteNits = (Frame->WhiteNits > 0.0f) ? Frame->WhiteNits : SCRGB_WHITE_NITS;
+	
+	software_crop_batch *Batch = &Compositor->CropBatch;
+	Batch->Desktop     = Desktop;
+	Batch->DesktopBytesPerPixel = GetSurfaceBytesPerPixel(Frame->Format);
+	Batch->ConvertRow  = Compositor->ConvertRows[Frame->Format];
+	Batch->Convert     = GetColourConvert(Frame->Format, WhiteNits);
+	Batch->Texture     = Texture;
+	Batch->CutBox      = CutBox;
+	Batch->Slot        = Slot;
+	Batch->Regions     = Regions;
+	Batch->RegionCount = RegionCount;
+	
+	u32 TileCount = 0;
+	for (u32 RegionIndex = 0; RegionIndex < RegionCount; ++RegionIndex)
+	{
+		box Region = IntersectBoxes(Regions[RegionIndex], CutBox);
+		if (!BoxIsEmpty(Region))
+		{
+			TileCount += (u32)(GetBoxHeight(Region) + SOFTWARE_CROP_TILE_ROWS - 1) / SOFTWARE_CROP_TILE_ROWS;
+		}
+	}
+	
+	RunTiles(Compositor->TilePool, SoftwareCropTile, Batch, TileCount);
+	
+	bool Detect = Compositor->HashTiles && Compositor->Changes.Hashes;
+	
+	u32 ChangedCount = 0;
+	for (u32 RegionIndex = 0; RegionIndex < RegionCount; ++RegionIndex)
+	{
+		box Region = IntersectBoxes(Regions[RegionIndex], CutBox);
+		if (!BoxIsEmpty(Region))
+		{
+			box Copied;
+			Copied.Left   = Slot.Left + (Region.Left - CutBox.Left);
+			Copied.Top    = Slot.Top  + (Region.Top  - CutBox.Top);
+			Copied.Right  = Copied.Left + GetBoxWidth(Region);
+			Copied.Bottom = Copied.Top  + GetBoxHeight(Region);
+			
+			// @Note Whatever mode is drawn with next, the mip chain over this is stale now
+			MarkScaleDirty(&Compositor->Scaler, Copied);
+			
+			++Compositor->Traffic.CopyCount;
+			Compositor->Traffic.CopiedBytes += (u64)GetBoxWidth(Copied) * (u64)GetBoxHeight(Copied) * BITMAP_BYTES_PER_PIXEL;
+			
+			if (Detect)
+			{
+				ChangedCount += DetectChanges(&Compositor->Changes, Texture, Copied);
+			}
+		}
+	}
+	
+	return !Detect || (ChangedCount > 0);
+}
+
+// @Note The shade only reads BGRA8, and the mip chains are built over the display texture's slots
+internal COMPOSITOR_SAMPLE(SoftwareSample)
+{
+	software_compositor *Compositor = (software_compositor *)Context;
+	bitmap *Desktop = (bitmap *)Frame->Surface;
+	
+	if (!Desktop || (Frame->Format != SurfaceFormat_BGRA8) || (GetShadeScale(&State->Shade) == ScaleMode_Mip))
+	{
+		return false;
+	}
+	
+	Compositor->SampledSurface = Desktop;
+	Compositor->SampledBoxes[PieceIndex] = IntersectBoxes(CutBox, box{ 0, 0, Desktop->Width, Desktop->Height });
+	
+	return true;
+}
+
+// @Note A tile clears its part of the back buffer and draws whatever pieces cover it
+internal TILE_JOB(SoftwareShadeTile)
+{
+	software_shade_batch *Batch = (software_shade_batch *)Context;
+	bitmap *Target = Batch->Target;
+	
+	box Tile;
+	Tile.Left   = (int)(TileIndex % Batch->TilesAcross) * SOFTWARE_TILE_WIDTH;
+	Tile.Top    = (int)(TileIndex / Batch->TilesAcross) * SOFTWARE_TILE_HEIGHT;
+	Tile.Right  = Min(Tile.Left + SOFTWARE_TILE_WIDTH,  Target->Width);
+	Tile.Bottom = Min(Tile.Top  + SOFTWARE_TILE_HEIGHT, Target->Height);
+	
+	// @Note ClearColour { 0, 0, 0, 1 }
+	FillBox(Target, Tile, 0xFF000000);
+	
+	for (u32 SetupIndex = 0; SetupIndex < Batch->SetupCount; ++SetupIndex)
+	{
+		shade_setup *Setup = &Batch->Setups[SetupIndex];
+		box Rect = IntersectBoxes(Tile, Setup->Rect);
+		if (BoxIsEmpty(Rect))
+		{
+			continue;
+		}
+		
+		if (Batch->ScaleMode == ScaleMode_Bilinear)
+		{
+			ShadeRect(Setup, Target, Rect, Batch->ShadeRows[Setup->Row.EffectKey]);
+		}
+		else
+		{
+			ShadeScaledRect(Batch->Scaler, SetupIndex, Target, Rect);
+		}
+	}
+}
+
+// @Note A tile is a band of texel rows of one piece, filtered across for bicubic and Lanczos
+internal TILE_JOB(SoftwareScaleTile)
+{
+	FilterScaleBand((scaler *)Context, TileIndex);
+}
+
+// @Note Every setup is in the batch, sets up whatever the scaling mode needs and draws the tiles
+internal void SoftwareShadeBatch(software_compositor *Compositor, scale_mode ScaleMode)
+{
+	software_shade_batch *Batch = &Compositor->ShadeBatch;
+	bitmap *Target = Batch->Target;
+	
+	Batch->Scaler    = &Compositor->Scaler;
+	Batch->ScaleMode = PrepareScale(Batch->Scaler, ScaleMode, Batch->Setups, Batch->SetupCount);
+	RunTiles(Compositor->TilePool, SoftwareScaleTile, Batch->Scaler, GetScaleBandCount(Batch->Scaler));
+	
+	u32 TilesDown = (u32)(Target->Height + SOFTWARE_TILE_HEIGHT - 1) / SOFTWARE_TILE_HEIGHT;
+	RunTiles(Compositor->TilePool, SoftwareShadeTile, Batch, Batch->TilesAcross * TilesDown);
+}
+
+internal COMPOSITOR_SHADE(SoftwareShade)
+{
+	software_compositor *Compositor = (software_compositor *)Context;
+	bitmap *Texture = &Compositor->DisplayTexture;
+	bitmap *Target  = &Compositor->BackBuffer;
+	if (!Texture->Memory || !Target->Memory)
+	{
+		return;
+	}
+	
+	software_shade_batch *Batch = &Compositor->ShadeBatch;
+	Batch->Target      = Target;
+	Batch->ShadeRows   = Compositor->ShadeRows;
+	Batch->TilesAcross = (u32)(Target->Width + SOFTWARE_TILE_WIDTH - 1) / SOFTWARE_TILE_WIDTH;
+	Batch->SetupCount  = 0;
+	
+	for (u32 PieceIndex = 0; PieceIndex < PieceCount; ++PieceIndex)
+	{
+		crop_piece *Piece = &Pieces[PieceIndex];
+		box CropSlot    = Compositor->CropAtlas.Slots[PieceIndex];
+		box DisplaySlot = Compositor->DisplayAtlas.Slots[Piece->OverlayIndex];
+		
+		bitmap *Source = Texture;
+		if (Piece->SamplesSurface)
+		{
+			Source   = Compositor->SampledSurface;
+			CropSlot = Compositor->SampledBoxes[PieceIndex];
+		}
+		
+		// @Note Nothing was cropped for a cut box that is entirely off the desktop
+		if (!Piece->HasImage || BoxIsEmpty(CropSlot) || BoxIsEmpty(DisplaySlot) || BoxIsEmpty(Piece->Mapping.SurfaceBox))
+		{
+			continue;
+		}
+		
+		float SlotWidth  = (float)GetBoxWidth(DisplaySlot);
+		float SlotHeight = (float)GetBoxHeight(DisplaySlot);
+		
+		v2 DestinationMin;
+		DestinationMin.X = (float)DisplaySlot.Left + Piece->DisplayMin.X * SlotWidth;
+		DestinationMin.Y = (float)DisplaySlot.Top  + Piece->DisplayMin.Y * SlotHeight;
+		
+		v2 DestinationMax;
+		DestinationMax.X = (float)DisplaySlot.Left + Piece->DisplayMax.X * SlotWidth;
+		DestinationMax.Y = (float)DisplaySlot.Top  + Piece->DisplayMax.Y * SlotHeight;
+		
+		shade_setup *Setup = &Batch->Setups[Batch->SetupCount];
+		if (SetupShadePiece(Setup, Target, DestinationMin, DestinationMax, Source, CropSlot, Piece->Mapping.UV, State->Shade))
+		{
+			++Batch->SetupCount;
+			
+			if (Piece->SamplesSurface)
+			{
+				++Compositor->Traffic.SampleCount;
+			}
+		}
+	}
+	
+	SoftwareShadeBatch(Compositor, GetShadeScale(&State->Shade));
+}
+
+// @Note Draws the reader's current frame the way it was drawn when it was recorded, over the same tiles
+internal bool SoftwareReplay(software_compositor *Compositor, recording_reader *Reader)
+{
+	if (!ResizeBackBuffer(Compositor, Reader->TargetWidth, Reader->TargetHeight))
+	{
+		return false;
+	}
+	
+	bitmap *Target = &Compositor->BackBuffer;
+	
+	software_shade_batch *Batch = &Compositor->ShadeBatch;
+	Batch->Target      = Target;
+	Batch->ShadeRows   = Compositor->ShadeRows;
+	Batch->TilesAcross = (u32)(Target->Width + SOFTWARE_TILE_WIDTH - 1) / SOFTWARE_TILE_WIDTH;
+	Batch->SetupCount  = Reader->PieceCount;
+	
+	for (u32 PieceIndex = 0; PieceIndex < Reader->PieceCount; ++PieceIndex)
+	{
+		Batch->Setups[PieceIndex] = UnpackRecordingPiece(&Reader->Pieces[PieceIndex], &Reader->Image);
+	}
+	
+	// @Note The reader doesn't say which texels a seek changed, the mip chains rebuild whole
+	MarkScaleDirty(&Compositor->Scaler, box{ 0, 0, Reader->Image.Width, Reader->Image.Height });
+	SoftwareShadeBatch(Compositor, Reader->ScaleMode);
+	
+	return true;
+}
+
+internal COMPOSITOR_PRESENT(SoftwarePresent)
+{
+	software_compositor *Compositor = (software_compositor *)Context;
+	Compositor->PresentCount++;
+	
+	return true;
+}
+
+internal compositor SoftwareCompositor(software_compositor *Compositor)
+{
+	compositor Result;
+	Result.Context = Compositor;
+	Result.Layout  = SoftwareLayout;
+	Result.Crop    = SoftwareCrop;
+	Result.Sample  = SoftwareSample;
+	Result.Shade   = SoftwareShade;
+	Result.Wait    = NULL;
+	Result.Present = SoftwarePresent;
+	Result.Memory  = &Compositor->Memory;
+	Result.Traffic = &Compositor->Traffic;
+	
+	return Result;
+}
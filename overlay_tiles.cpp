@@ -0,0 +1,195 @@
+//
+// Tile pool: the calling thread and a few long-lived workers split a batch of tiles between them
+//
+// @Note Every worker starts on its own run of tiles, in order so neighbouring tiles stay on one core,
+// and once that runs out it takes tiles from the others' runs. Taking a tile is one atomic add on the
+// run's counter, owner and thief alike, nothing ever locks. Each batch wakes every worker once and
+// waits for all of them to check back in, so the batch can be rewritten as soon as RunTiles returns.
+// The threads and their events come from the platform layer, the pool itself never allocates.
+//
+
+#define MAX_TILE_WORKERS 16
+
+// @Note The pool keeps its workers waiting this long at a time between batches
+#define TILE_IDLE_WAIT_MS 1000
+
+// @Note The caller spins this many times for the others to finish before it sleeps on the event
+#define TILE_DONE_SPINS 4096
+
+#define TILE_JOB(Name) void Name(void *Context, u32 TileIndex)
+typedef TILE_JOB(tile_job);
+
+struct tile_pool;
+
+struct tile_worker
+{
+	tile_pool *Pool;
+	u32 Index;
+	void *WakeEvent;
+	
+	// @Note This worker's run of the batch, everyone takes from the front of it
+	alignas(64) u32 volatile NextTile;
+	u32 EndTile;
+	
+	// @Note Worker only
+	alignas(64) u64 TileCount;
+	u64 StolenCount;
+};
+
+struct tile_pool
+{
+	// @Note Worker 0 is whoever calls RunTiles
+	u32 WorkerCount;
+	tile_worker Workers[MAX_TILE_WORKERS];
+	
+	platform_wait_event   *WaitEvent;
+	platform_signal_event *SignalEvent;
+	void *DoneEvent;
+	
+	// @Note The batch, written before the workers are woken and left alone until they all checked back in
+	tile_job *Job;
+	void *Context;
+	
+	alignas(64) u32 volatile BusyCount;
+	
+	u64 BatchCount;
+};
+
+internal void InitializeTilePool(tile_pool *Pool, platform_wait_event *WaitEvent, platform_signal_event *SignalEvent, void *DoneEvent)
+{
+	Pool->WaitEvent   = WaitEvent;
+	Pool->SignalEvent = SignalEvent;
+	Pool->DoneEvent   = DoneEvent;
+	Pool->Job         = NULL;
+	Pool->Context     = NULL;
+	Pool->BusyCount   = 0;
+	Pool->BatchCount  = 0;
+	
+	// @Note The calling thread, it needs no event
+	Pool->WorkerCount = 0;
+	for (u32 WorkerIndex = 0; WorkerIndex < MAX_TILE_WORKERS; ++WorkerIndex)
+	{
+		tile_worker *Worker = &Pool->Workers[WorkerIndex];
+		Worker->Pool        = Pool;
+		Worker->Index       = WorkerIndex;
+		Worker->WakeEvent   = NULL;
+		Worker->NextTile    = 0;
+		Worker->EndTile     = 0;
+		Worker->TileCount   = 0;
+		Worker->StolenCount = 0;
+	}
+	
+	Pool->WorkerCount = 1;
+}
+
+// @Note The platform starts a thread running RunTileWorker on it, before the first batch
+internal tile_worker *AddTileWorker(tile_pool *Pool, void *WakeEvent)
+{
+	Assert(Pool->WorkerCount < MAX_TILE_WORKERS);
+	
+	tile_worker *Worker = &Pool->Workers[Pool->WorkerCount++];
+	Worker->WakeEvent = WakeEvent;
+	
+	return Worker;
+}
+
+internal void RunTilesAsWorker(tile_worker *Worker)
+{
+	tile_pool *Pool = Worker->Pool;
+	u32 WorkerCount = Pool->WorkerCount;
+	
+	// @Note Our own run first, then everybody else's starting with the next one along
+	for (u32 Offset = 0; Offset < WorkerCount; ++Offset)
+	{
+		tile_worker *Owner = &Pool->Workers[(Worker->Index + Offset) % WorkerCount];
+		for (;;)
+		{
+			u32 Tile = AtomicAddU32(&Owner->NextTile, 1);
+			if (Tile >= Owner->EndTile)
+			{
+				break;
+			}
+			
+			Pool->Job(Pool->Context, Tile);
+			
+			++Worker->TileCount;
+			Worker->StolenCount += (Offset != 0);
+		}
+	}
+}
+
+internal void RunTileWorker(tile_worker *Worker)
+{
+	tile_pool *Pool = Worker->Pool;
+	for (;;)
+	{
+		if (!Pool->WaitEvent(Worker->WakeEvent, TILE_IDLE_WAIT_MS))
+		{
+			continue;
+		}
+		
+		RunTilesAsWorker(Worker);
+		
+		if (AtomicAddU32(&Pool->BusyCount, (u32)-1) == 1)
+		{
+			Pool->SignalEvent(Pool->DoneEvent);
+		}
+	}
+}
+
+// Runs Job on tiles 0 to TileCount, returns once all of them are done. A NULL pool runs them right here.
+internal void RunTiles(tile_pool *Pool, tile_job *Job, void *Context, u32 TileCount)
+{
+	if (!Pool || (Pool->WorkerCount == 1) || (TileCount <= 1))
+	{
+		for (u32 Tile = 0; Tile < TileCount; ++Tile)
+		{
+			Job(Context, Tile);
+		}
+		
+		return;
+	}
+	
+	u32 WorkerCount = Pool->WorkerCount;
+	for (u32 WorkerIndex = 0; WorkerIndex < WorkerCount; ++WorkerIndex)
+	{
+		tile_worker *Worker = &Pool->Workers[WorkerIndex];
+		Worker->NextTile = (u32)((u64)TileCount * WorkerIndex / WorkerCount);
+		Worker->EndTile  = (u32)((u64)TileCount * (WorkerIndex + 1) / WorkerCount);
+	}
+	
+	Pool->Job     = Job;
+	Pool->Context = Context;
+	++Pool->BatchCount;
+	
+	// @Note The store publishes the batch to whoever the events wake
+	AtomicStoreU32(&Pool->BusyCount, WorkerCount - 1);
+	for (u32 WorkerIndex = 1; WorkerIndex < WorkerCount; ++WorkerIndex)
+	{
+		Pool->SignalEvent(Pool->Workers[WorkerIndex].WakeEvent);
+	}
+	
+	RunTilesAsWorker(&Pool->Workers[0]);
+	
+	// @Note A done signal left over from the last batch only costs another look at the count
+	for (u32 Spin = 0; (Spin < TILE_DONE_SPINS) && AtomicLoadU32(&Pool->BusyCount); ++Spin)
+	{
+		SpinPause();
+	}
+	
+	while (AtomicLoadU32(&Pool->BusyCount))
+	{
+		Pool->WaitEvent(Pool->DoneEvent, 1);
+	}
+}
+
+internal u64 GetStolenTileCount(tile_pool *Pool)
+{
+	u64 StolenCount = 0;
+	for (u32 WorkerIndex = 0; WorkerIndex < Pool->WorkerCount; ++WorkerIndex)
+	{
+		StolenCount += Pool->Workers[WorkerIndex].StolenCount;
+	}
+	
+	return StolenCount;
+}
@@ -0,0 +1,711 @@
+//
+// YUV conversion: the display texture's crops as NV12 or I420, for an encoder or a stream to take as they are
+//
+// @Note BT.601 or BT.709, full or limited range, from the sRGB bytes the way every encoder takes them: no decode to
+// linear light, the matrix goes straight onto the encoded values. Chroma is the plain average of each 2x2 block, centred
+// between its four pixels. The coefficients are 2^14 fixed point and every kernel does the same integer math as the
+// scalar one, so they all match it bit for bit, on ARM too. An odd edge repeats its last row or column into the padding.
+//
+// Only the tiles the change detector has a new hash for get converted again, see ConvertToYUV.
+//
+
+enum yuv_layout
+{
+	YUVLayout_NV12, // Y plane, then one plane of U and V interleaved
+	YUVLayout_I420, // Y plane, then the U plane, then the V plane
+	
+	YUVLayout_Count,
+};
+
+enum yuv_matrix
+{
+	YUVMatrix_BT601,
+	YUVMatrix_BT709,
+	
+	YUVMatrix_Count,
+};
+
+enum yuv_range
+{
+	YUVRange_Limited, // Y 16..235, U and V 16..240
+	YUVRange_Full,
+	
+	YUVRange_Count,
+};
+
+global const char *YUVLayoutNames[YUVLayout_Count] = { "nv12", "i420" };
+global const char *YUVMatrixNames[YUVMatrix_Count] = { "bt601", "bt709" };
+global const char *YUVRangeNames[YUVRange_Count]   = { "limited", "full" };
+
+struct yuv_format
+{
+	yuv_layout Layout;
+	yuv_matrix Matrix;
+	yuv_range  Range;
+};
+
+#define YUV_FIXED_BITS 14
+
+// @Note Blue, green and red, in 2^14 fixed point. Every one fits 16 bits, the SSE2 and AVX2 rows multiply them in pairs.
+struct yuv_coefficients
+{
+	s32 Y[3];
+	s32 U[3];
+	s32 V[3];
+	
+	// @Note The offset and the rounding, Y's for one pixel and U and V's for the sum of four
+	s32 YBias;
+	s32 ChromaBias;
+};
+
+// @Note Kr and Kb of each matrix, green is what's left
+global const float YUVMatrixWeights[YUVMatrix_Count][2] =
+{
+	{ 0.299f,  0.114f  },
+	{ 0.2126f, 0.0722f },
+};
+
+// @Note The float version of what the coefficients do, the reference they are checked against.
+// Blue, green and red, each for a byte value 0..255; Offsets is Y's and then U and V's.
+internal void GetYUVMatrix(yuv_format Format, float *Y, float *U, float *V, float *Offsets)
+{
+	float Red   = YUVMatrixWeights[Format.Matrix][0];
+	float Blue  = YUVMatrixWeights[Format.Matrix][1];
+	float Green = 1.0f - Red - Blue;
+	
+	bool Full = (Format.Range == YUVRange_Full);
+	float LumaScale   = Full ? 1.0f : (219.0f / 255.0f);
+	float ChromaScale = Full ? 1.0f : (224.0f / 255.0f);
+	
+	Y[0] = Blue  * LumaScale;
+	Y[1] = Green * LumaScale;
+	Y[2] = Red   * LumaScale;
+	
+	// Cb = (B - Y) / (2 * (1 - Kb)), Cr = (R - Y) / (2 * (1 - Kr))
+	float BlueSpan = 2.0f * (1.0f - Blue);
+	U[0] = 0.5f * ChromaScale;
+	U[1] = -Green / BlueSpan * ChromaScale;
+	U[2] = -Red   / BlueSpan * ChromaScale;
+	
+	float RedSpan = 2.0f * (1.0f - Red);
+	V[0] = -Blue  / RedSpan * ChromaScale;
+	V[1] = -Green / RedSpan * ChromaScale;
+	V[2] = 0.5f * ChromaScale;
+	
+	Offsets[0] = Full ? 0.0f : 16.0f;
+	Offsets[1] = 128.0f;
+}
+
+inline s32 ToYUVFixed(float Value)
+{
+	float Scaled = Value * (float)(1 << YUV_FIXED_BITS);
+	return (s32)((Scaled < 0.0f) ? (Scaled - 0.5f) : (Scaled + 0.5f));
+}
+
+// @Note Green takes up the rounding of the other two, so white comes out at exactly 235 or 255 and grey has no colour at all
+internal yuv_coefficients GetYUVCoefficients(yuv_format Format)
+{
+	float Y[3];
+	float U[3];
+	float V[3];
+	float Offsets[2];
+	GetYUVMatrix(Format, Y, U, V, Offsets);
+	
+	yuv_coefficients Result;
+	Result.Y[0] = ToYUVFixed(Y[0]);
+	Result.Y[2] = ToYUVFixed(Y[2]);
+	Result.Y[1] = ToYUVFixed(Y[0] + Y[1] + Y[2]) - Result.Y[0] - Result.Y[2];
+	
+	Result.U[0] = ToYUVFixed(U[0]);
+	Result.U[2] = ToYUVFixed(U[2]);
+	Result.U[1] = -Result.U[0] - Result.U[2];
+	
+	Result.V[0] = ToYUVFixed(V[0]);
+	Result.V[2] = ToYUVFixed(V[2]);
+	Result.V[1] = -Result.V[0] - Result.V[2];
+	
+	Result.YBias      = ((s32)Offsets[0] << YUV_FIXED_BITS) + (1 << (YUV_FIXED_BITS - 1));
+	Result.ChromaBias = ((s32)Offsets[1] << (YUV_FIXED_BITS + 2)) + (1 << (YUV_FIXED_BITS + 1));
+	
+	return Result;
+}
+
+// @Note Two source rows and the rows of each plane they go to. Pixel X of the rows is Y[Row][X] and U and V X / 2 * ChromaStep.
+struct yuv_rows
+{
+	u8 *Source[2]; // BGRA, the second the first again for the last row of an odd height
+	u8 *Y[2];
+	u8 *U;
+	u8 *V;
+	int ChromaStep; // 2 for NV12's interleaved plane
+};
+
+// Pixels Begin to End of the rows, Begin even. An odd End is the texture's edge, its pixel fills in for the one past it.
+#define YUV_ROWS(Name) void Name(yuv_coefficients *Coefficients, yuv_rows *Rows, int Begin, int End)
+typedef YUV_ROWS(yuv_rows_function);
+
+//
+// Scalar, the reference
+//
+
+inline u8 GetYUVLuma(yuv_coefficients *Coefficients, u8 *Pixel)
+{
+	s32 Luma = Pixel[0] * Coefficients->Y[0] + Pixel[1] * Coefficients->Y[1] + Pixel[2] * Coefficients->Y[2] + Coefficients->YBias;
+	return (u8)Min(Luma >> YUV_FIXED_BITS, 255);
+}
+
+// @Note Sums are of the four pixels, so this is the average with two more bits. Never below zero, the bias keeps it up.
+inline u8 GetYUVChroma(s32 *Weights, s32 Bias, s32 *Sums)
+{
+	s32 Chroma = Sums[0] * Weights[0] + Sums[1] * Weights[1] + Sums[2] * Weights[2] + Bias;
+	return (u8)Min(Chroma >> (YUV_FIXED_BITS + 2), 255);
+}
+
+internal YUV_ROWS(ConvertYUVRowsScalar)
+{
+	for (int X = Begin; X < End; X += 2)
+	{
+		int Right = Min(X + 1, End - 1);
+		
+		u8 *Pixels[4] =
+		{
+			Rows->Source[0] + X * BITMAP_BYTES_PER_PIXEL, Rows->Source[0] + Right * BITMAP_BYTES_PER_PIXEL,
+			Rows->Source[1] + X * BITMAP_BYTES_PER_PIXEL, Rows->Source[1] + Right * BITMAP_BYTES_PER_PIXEL,
+		};
+		
+		Rows->Y[0][X]     = GetYUVLuma(Coefficients, Pixels[0]);
+		Rows->Y[0][X + 1] = GetYUVLuma(Coefficients, Pixels[1]);
+		Rows->Y[1][X]     = GetYUVLuma(Coefficients, Pixels[2]);
+		Rows->Y[1][X + 1] = GetYUVLuma(Coefficients, Pixels[3]);
+		
+		s32 Sums[3];
+		for (int Channel = 0; Channel < 3; ++Channel)
+		{
+			Sums[Channel] = Pixels[0][Channel] + Pixels[1][Channel] + Pixels[2][Channel] + Pixels[3][Channel];
+		}
+		
+		int Chroma = (X / 2) * Rows->ChromaStep;
+		Rows->U[Chroma] = GetYUVChroma(Coefficients->U, Coefficients->ChromaBias, Sums);
+		Rows->V[Chroma] = GetYUVChroma(Coefficients->V, Coefficients->ChromaBias, Sums);
+	}
+}
+
+//
+// SSE2, eight pixels at a time. Blue and red, and green and alpha, are the 16-bit halves of a pixel masked,
+// so each multiply-add does two channels of four pixels and nothing has to be unpacked.
+//
+
+#if defined(SHADE_X86)
+
+// @Note Low and High as the two 16-bit halves of every lane, the way _mm_madd_epi16 pairs them with a pixel's
+inline s32 PackYUVPair(s32 Low, s32 High)
+{
+	return (s32)(((u32)High << 16) | ((u32)Low & 0xFFFF));
+}
+
+struct yuv_weights_sse2
+{
+	__m128i BlueRed;
+	__m128i GreenAlpha;
+};
+
+inline yuv_weights_sse2 GetYUVWeightsSSE2(s32 *Weights)
+{
+	yuv_weights_sse2 Result;
+	Result.BlueRed    = _mm_set1_epi32(PackYUVPair(Weights[0], Weights[2]));
+	Result.GreenAlpha = _mm_set1_epi32(PackYUVPair(Weights[1], 0));
+	return Result;
+}
+
+inline __m128i WeighYUVSSE2(__m128i BlueRed, __m128i GreenAlpha, yuv_weights_sse2 Weights)
+{
+	return _mm_add_epi32(_mm_madd_epi16(BlueRed, Weights.BlueRed), _mm_madd_epi16(GreenAlpha, Weights.GreenAlpha));
+}
+
+// @Note Four pixels' Y, still 32 bits
+inline __m128i GetYUVLumaSSE2(__m128i Pixels, yuv_weights_sse2 Weights, __m128i Bias)
+{
+	__m128i Mask = _mm_set1_epi32(0x00FF00FF);
+	__m128i Luma = WeighYUVSSE2(_mm_and_si128(Pixels, Mask), _mm_and_si128(_mm_srli_epi32(Pixels, 8), Mask), Weights);
+	return _mm_srai_epi32(_mm_add_epi32(Luma, Bias), YUV_FIXED_BITS);
+}
+
+inline __m128i PickYUVPixelsSSE2(__m128i Low, __m128i High, bool Odd)
+{
+	__m128 Picked = Odd ? _mm_shuffle_ps(_mm_castsi128_ps(Low), _mm_castsi128_ps(High), _MM_SHUFFLE(3, 1, 3, 1))
+		: _mm_shuffle_ps(_mm_castsi128_ps(Low), _mm_castsi128_ps(High), _MM_SHUFFLE(2, 0, 2, 0));
+	return _mm_castps_si128(Picked);
+}
+
+internal YUV_ROWS(ConvertYUVRowsSSE2)
+{
+	yuv_weights_sse2 YWeights = GetYUVWeightsSSE2(Coefficients->Y);
+	yuv_weights_sse2 UWeights = GetYUVWeightsSSE2(Coefficients->U);
+	yuv_weights_sse2 VWeights = GetYUVWeightsSSE2(Coefficients->V);
+	__m128i YBias      = _mm_set1_epi32(Coefficients->YBias);
+	__m128i ChromaBias = _mm_set1_epi32(Coefficients->ChromaBias);
+	__m128i Mask       = _mm_set1_epi32(0x00FF00FF);
+	
+	int X = Begin;
+	for (; X + 8 <= End; X += 8)
+	{
+		__m128i BlueRed    = _mm_setzero_si128();
+		__m128i GreenAlpha = _mm_setzero_si128();
+		for (int Row = 0; Row < 2; ++Row)
+		{
+			u8 *Source = Rows->Source[Row] + X * BITMAP_BYTES_PER_PIXEL;
+			__m128i Low  = _mm_loadu_si128((__m128i *)Source);
+			__m128i High = _mm_loadu_si128((__m128i *)(Source + 16));
+			
+			__m128i Luma = _mm_packs_epi32(GetYUVLumaSSE2(Low, YWeights, YBias), GetYUVLumaSSE2(High, YWeights, YBias));
+			_mm_storel_epi64((__m128i *)(Rows->Y[Row] + X), _mm_packus_epi16(Luma, Luma));
+			
+			// @Note The 2x2 sums are at most 1020, they stay inside their 16 bits
+			__m128i Even = PickYUVPixelsSSE2(Low, High, false);
+			__m128i Odd  = PickYUVPixelsSSE2(Low, High, true);
+			BlueRed    = _mm_add_epi16(BlueRed, _mm_add_epi16(_mm_and_si128(Even, Mask), _mm_and_si128(Odd, Mask)));
+			GreenAlpha = _mm_add_epi16(GreenAlpha, _mm_add_epi16(_mm_and_si128(_mm_srli_epi32(Even, 8), Mask),
+																 _mm_and_si128(_mm_srli_epi32(Odd, 8), Mask)));
+		}
+		
+		__m128i U = _mm_srai_epi32(_mm_add_epi32(WeighYUVSSE2(BlueRed, GreenAlpha, UWeights), ChromaBias), YUV_FIXED_BITS + 2);
+		__m128i V = _mm_srai_epi32(_mm_add_epi32(WeighYUVSSE2(BlueRed, GreenAlpha, VWeights), ChromaBias), YUV_FIXED_BITS + 2);
+		
+		// @Note Four U and then four V
+		__m128i Chroma = _mm_packs_epi32(U, V);
+		Chroma = _mm_packus_epi16(Chroma, Chroma);
+		
+		int ChromaX = (X / 2) * Rows->ChromaStep;
+		if (Rows->ChromaStep == 2)
+		{
+			_mm_storel_epi64((__m128i *)(Rows->U + ChromaX), _mm_unpacklo_epi8(Chroma, _mm_srli_si128(Chroma, 4)));
+		}
+		else
+		{
+			*(s32 *)(Rows->U + ChromaX) = _mm_cvtsi128_si32(Chroma);
+			*(s32 *)(Rows->V + ChromaX) = _mm_cvtsi128_si32(_mm_srli_si128(Chroma, 4));
+		}
+	}
+	
+	ConvertYUVRowsScalar(Coefficients, Rows, X, End);
+}
+
+//
+// AVX2, sixteen pixels at a time. The packs work inside 128-bit lanes, so the loads are swapped about first
+// for the pixels to come out of them in order.
+//
+
+struct yuv_weights_avx2
+{
+	__m256i BlueRed;
+	__m256i GreenAlpha;
+};
+
+TARGET_AVX2 inline yuv_weights_avx2 GetYUVWeightsAVX2(s32 *Weights)
+{
+	yuv_weights_avx2 Result;
+	Result.BlueRed    = _mm256_set1_epi32(PackYUVPair(Weights[0], Weights[2]));
+	Result.GreenAlpha = _mm256_set1_epi32(PackYUVPair(Weights[1], 0));
+	return Result;
+}
+
+TARGET_AVX2 inline __m256i WeighYUVAVX2(__m256i BlueRed, __m256i GreenAlpha, yuv_weights_avx2 Weights)
+{
+	return _mm256_add_epi32(_mm256_madd_epi16(BlueRed, Weights.BlueRed), _mm256_madd_epi16(GreenAlpha, Weights.GreenAlpha));
+}
+
+TARGET_AVX2 inline __m256i GetYUVLumaAVX2(__m256i Pixels, yuv_weights_avx2 Weights, __m256i Bias)
+{
+	__m256i Mask = _mm256_set1_epi32(0x00FF00FF);
+	__m256i Luma = WeighYUVAVX2(_mm256_and_si256(Pixels, Mask), _mm256_and_si256(_mm256_srli_epi32(Pixels, 8), Mask), Weights);
+	return _mm256_srai_epi32(_mm256_add_epi32(Luma, Bias), YUV_FIXED_BITS);
+}
+
+TARGET_AVX2 internal YUV_ROWS(ConvertYUVRowsAVX2)
+{
+	yuv_weights_avx2 YWeights = GetYUVWeightsAVX2(Coefficients->Y);
+	yuv_weights_avx2 UWeights = GetYUVWeightsAVX2(Coefficients->U);
+	yuv_weights_avx2 VWeights = GetYUVWeightsAVX2(Coefficients->V);
+	__m256i YBias      = _mm256_set1_epi32(Coefficients->YBias);
+	__m256i ChromaBias = _mm256_set1_epi32(Coefficients->ChromaBias);
+	__m256i Mask       = _mm256_set1_epi32(0x00FF00FF);
+	__m256i ChromaOrder = _mm256_setr_epi32(0, 4, 1, 5, 0, 0, 0, 0);
+	
+	int X = Begin;
+	for (; X + 16 <= End; X += 16)
+	{
+		__m256i BlueRed    = _mm256_setzero_si256();
+		__m256i GreenAlpha = _mm256_setzero_si256();
+		for (int Row = 0; Row < 2; ++Row)
+		{
+			u8 *Source = Rows->Source[Row] + X * BITMAP_BYTES_PER_PIXEL;
+			__m256i First  = _mm256_loadu_si256((__m256i *)Source);
+			__m256i Second = _mm256_loadu_si256((__m256i *)(Source + 32));
+			
+			// @Note Pixels 0-3 and 8-11, and 4-7 and 12-15
+			__m256i Low  = _mm256_permute2x128_si256(First, Second, 0x20);
+			__m256i High = _mm256_permute2x128_si256(First, Second, 0x31);
+			
+			__m256i Luma = _mm256_packs_epi32(GetYUVLumaAVX2(Low, YWeights, YBias), GetYUVLumaAVX2(High, YWeights, YBias));
+			Luma = _mm256_permute4x64_epi64(_mm256_packus_epi16(Luma, Luma), _MM_SHUFFLE(3, 1, 2, 0));
+			_mm_storeu_si128((__m128i *)(Rows->Y[Row] + X), _mm256_castsi256_si128(Luma));
+			
+			__m256i Even = _mm256_castps_si256(_mm256_shuffle_ps(_mm256_castsi256_ps(Low), _mm256_castsi256_ps(High), _MM_SHUFFLE(2, 0, 2, 0)));
+			__m256i Odd  = _mm256_castps_si256(_mm256_shuffle_ps(_mm256_castsi256_ps(Low), _mm256_castsi256_ps(High), _MM_SHUFFLE(3, 1, 3, 1)));
+			BlueRed    = _mm256_add_epi16(BlueRed, _mm256_add_epi16(_mm256_and_si256(Even, Mask), _mm256_and_si256(Odd, Mask)));
+			GreenAlpha = _mm256_add_epi16(GreenAlpha, _mm256_add_epi16(_mm256_and_si256(_mm256_srli_epi32(Even, 8), Mask),
+																	   _mm256_and_si256(_mm256_srli_epi32(Odd, 8), Mask)));
+		}
+		
+		__m256i U = _mm256_srai_epi32(_mm256_add_epi32(WeighYUVAVX2(BlueRed, GreenAlpha, UWeights), ChromaBias), YUV_FIXED_BITS + 2);
+		__m256i V = _mm256_srai_epi32(_mm256_add_epi32(WeighYUVAVX2(BlueRed, GreenAlpha, VWeights), ChromaBias), YUV_FIXED_BITS + 2);
+		
+		// @Note Eight U and then eight V
+		__m256i Packed = _mm256_packs_epi32(U, V);
+		Packed = _mm256_permutevar8x32_epi32(_mm256_packus_epi16(Packed, Packed), ChromaOrder);
+		__m128i Chroma = _mm256_castsi256_si128(Packed);
+		
+		int ChromaX = (X / 2) * Rows->ChromaStep;
+		if (Rows->ChromaStep == 2)
+		{
+			_mm_storeu_si128((__m128i *)(Rows->U + ChromaX), _mm_unpacklo_epi8(Chroma, _mm_srli_si128(Chroma, 8)));
+		}
+		else
+		{
+			_mm_storel_epi64((__m128i *)(Rows->U + ChromaX), Chroma);
+			_mm_storel_epi64((__m128i *)(Rows->V + ChromaX), _mm_srli_si128(Chroma, 8));
+		}
+	}
+	
+	ConvertYUVRowsSSE2(Coefficients, Rows, X, End);
+}
+
+#endif
+
+//
+// NEON, eight pixels at a time. The load splits the channels out, the sums are widened to 32 bits.
+//
+
+#if defined(SHADE_NEON)
+
+inline uint16x4_t GetYUVLumaNEON(int16x4_t Blue, int16x4_t Green, int16x4_t Red, yuv_coefficients *Coefficients)
+{
+	int32x4_t Luma = vdupq_n_s32(Coefficients->YBias);
+	Luma = vmlal_s16(Luma, Blue,  vdup_n_s16((int16_t)Coefficients->Y[0]));
+	Luma = vmlal_s16(Luma, Green, vdup_n_s16((int16_t)Coefficients->Y[1]));
+	Luma = vmlal_s16(Luma, Red,   vdup_n_s16((int16_t)Coefficients->Y[2]));
+	return vqmovun_s32(vshrq_n_s32(Luma, YUV_FIXED_BITS));
+}
+
+inline uint16x4_t GetYUVChromaNEON(int32x4_t *Sums, s32 *Weights, s32 Bias)
+{
+	int32x4_t Chroma = vdupq_n_s32(Bias);
+	Chroma = vmlaq_n_s32(Chroma, Sums[0], Weights[0]);
+	Chroma = vmlaq_n_s32(Chroma, Sums[1], Weights[1]);
+	Chroma = vmlaq_n_s32(Chroma, Sums[2], Weights[2]);
+	return vqmovun_s32(vshrq_n_s32(Chroma, YUV_FIXED_BITS + 2));
+}
+
+internal YUV_ROWS(ConvertYUVRowsNEON)
+{
+	int X = Begin;
+	for (; X + 8 <= End; X += 8)
+	{
+		uint8x8x4_t Rows0 = vld4_u8(Rows->Source[0] + X * BITMAP_BYTES_PER_PIXEL);
+		uint8x8x4_t Rows1 = vld4_u8(Rows->Source[1] + X * BITMAP_BYTES_PER_PIXEL);
+		
+		int32x4_t Sums[3];
+		for (int Row = 0; Row < 2; ++Row)
+		{
+			uint8x8x4_t *Pixels = Row ? &Rows1 : &Rows0;
+			int16x8_t Blue  = vreinterpretq_s16_u16(vmovl_u8(Pixels->val[0]));
+			int16x8_t Green = vreinterpretq_s16_u16(vmovl_u8(Pixels->val[1]));
+			int16x8_t Red   = vreinterpretq_s16_u16(vmovl_u8(Pixels->val[2]));
+			
+			uint16x4_t Low  = GetYUVLumaNEON(vget_low_s16(Blue),  vget_low_s16(Green),  vget_low_s16(Red),  Coefficients);
+			uint16x4_t High = GetYUVLumaNEON(vget_high_s16(Blue), vget_high_s16(Green), vget_high_s16(Red), Coefficients);
+			vst1_u8(Rows->Y[Row] + X, vqmovn_u16(vcombine_u16(Low, High)));
+		}
+		
+		for (int Channel = 0; Channel < 3; ++Channel)
+		{
+			uint16x8_t Columns = vaddl_u8(Rows0.val[Channel], Rows1.val[Channel]);
+			Sums[Channel] = vreinterpretq_s32_u32(vpaddlq_u16(Columns));
+		}
+		
+		uint16x4_t U = GetYUVChromaNEON(Sums, Coefficients->U, Coefficients->ChromaBias);
+		uint16x4_t V = GetYUVChromaNEON(Sums, Coefficients->V, Coefficients->ChromaBias);
+		
+		// @Note Four U and then four V
+		uint8x8_t Chroma = vqmovn_u16(vcombine_u16(U, V));
+		
+		int ChromaX = (X / 2) * Rows->ChromaStep;
+		if (Rows->ChromaStep == 2)
+		{
+			vst1_u8(Rows->U + ChromaX, vzip_u8(Chroma, vext_u8(Chroma, Chroma, 4)).val[0]);
+		}
+		else
+		{
+			vst1_lane_u32((u32 *)(Rows->U + ChromaX), vreinterpret_u32_u8(Chroma), 0);
+			vst1_lane_u32((u32 *)(Rows->V + ChromaX), vreinterpret_u32_u8(Chroma), 1);
+		}
+	}
+	
+	ConvertYUVRowsScalar(Coefficients, Rows, X, End);
+}
+
+#endif
+
+// @Note Same instruction sets as the shade kernels, NULL if this build or CPU doesn't have it
+internal yuv_rows_function *GetYUVRows(shade_kernel Kernel)
+{
+	switch (Kernel)
+	{
+		case ShadeKernel_Scalar: return ConvertYUVRowsScalar;
+#if defined(SHADE_X86)
+		case ShadeKernel_SSE2: return ConvertYUVRowsSSE2;
+		case ShadeKernel_AVX2: return CPUHasAVX2() ? ConvertYUVRowsAVX2 : NULL;
+#endif
+#if defined(SHADE_NEON)
+		case ShadeKernel_NEON: return ConvertYUVRowsNEON;
+#endif
+		default: return NULL;
+	}
+}
+
+//
+// The converted image, the texture's size rounded up to even. One block with the planes one after the other,
+// as an encoder takes NV12 or I420, every row of a plane packed tight.
+//
+
+struct yuv_image
+{
+	yuv_format Format;
+	int Width;
+	int Height;
+	
+	// @Note Y, U and V. NV12's V is U's plane one byte on.
+	u8 *Planes[3];
+	int Pitches[3];
+	
+	// @Note All three planes, Size bytes from the start of Y
+	u8 *Memory;
+	size_t Size;
+};
+
+inline size_t GetYUVImageSize(int Width, int Height)
+{
+	return (size_t)Width * Height + 2 * (size_t)(Width / 2) * (Height / 2);
+}
+
+// @Note The image and then the converted hashes, on a u64 boundary after it
+inline size_t GetYUVConverterSize(size_t ImageSize, u32 TileCount)
+{
+	return ((ImageSize + 7) & ~(size_t)7) + TileCount * sizeof(u64);
+}
+
+struct yuv_converter
+{
+	platform_allocate_memory *AllocateMemory;
+	platform_free_memory     *FreeMemory;
+	
+	yuv_coefficients Coefficients;
+	yuv_rows_function *ConvertRows;
+	
+	yuv_image Image;
+	
+	// @Note The change detector's hash of every tile as it was last converted, UNKNOWN_TILE_HASH if it wasn't
+	u64 *ConvertedHashes;
+	u32 TilesAcross;
+	u32 TilesDown;
+	
+	u64 FrameCount;
+	u64 ConvertedTileCount;
+	u64 UnchangedTileCount;
+	u64 ConvertedPixelCount;
+};
+
+internal void InitializeYUVConverter(yuv_converter *Converter, platform_allocate_memory *AllocateMemory, platform_free_memory *FreeMemory,
+									 yuv_format Format, shade_kernel Kernel)
+{
+	*Converter = {};
+	Converter->AllocateMemory = AllocateMemory;
+	Converter->FreeMemory     = FreeMemory;
+	Converter->Coefficients   = GetYUVCoefficients(Format);
+	Converter->ConvertRows    = GetYUVRows(Kernel) ? GetYUVRows(Kernel) : ConvertYUVRowsScalar;
+	Converter->Image.Format   = Format;
+}
+
+internal void FreeYUVConverter(yuv_converter *Converter)
+{
+	if (Converter->Image.Memory)
+	{
+		u32 TileCount = Converter->TilesAcross * Converter->TilesDown;
+		Converter->FreeMemory(Converter->Image.Memory, GetYUVConverterSize(Converter->Image.Size, TileCount));
+	}
+	
+	Converter->Image.Memory    = NULL;
+	Converter->Image.Size      = 0;
+	Converter->Image.Width     = 0;
+	Converter->Image.Height    = 0;
+	Converter->ConvertedHashes = NULL;
+	Converter->TilesAcross     = 0;
+	Converter->TilesDown       = 0;
+}
+
+// @Note Allocates only when the texture changes size, and then nothing has been converted. False without memory.
+internal bool ResizeYUVConverter(yuv_converter *Converter, int Width, int Height)
+{
+	yuv_image *Image = &Converter->Image;
+	int EvenWidth  = (Width  + 1) & ~1;
+	int EvenHeight = (Height + 1) & ~1;
+	if ((Image->Width == EvenWidth) && (Image->Height == EvenHeight) && Image->Memory)
+	{
+		return true;
+	}
+	
+	FreeYUVConverter(Converter);
+	
+	u32 TilesAcross = (u32)(Width  + CHANGE_TILE_SIZE - 1) / CHANGE_TILE_SIZE;
+	u32 TilesDown   = (u32)(Height + CHANGE_TILE_SIZE - 1) / CHANGE_TILE_SIZE;
+	size_t ImageSize = GetYUVImageSize(EvenWidth, EvenHeight);
+	size_t Size = GetYUVConverterSize(ImageSize, TilesAcross * TilesDown);
+	
+	u8 *Memory = ImageSize ? (u8 *)Converter->AllocateMemory(Size) : NULL;
+	if (!Memory)
+	{
+		return false;
+	}
+	
+	Converter->ConvertedHashes = (u64 *)(Memory + Size) - TilesAcross * TilesDown;
+	Converter->TilesAcross     = TilesAcross;
+	Converter->TilesDown       = TilesDown;
+	for (u32 Tile = 0; Tile < TilesAcross * TilesDown; ++Tile)
+	{
+		Converter->ConvertedHashes[Tile] = UNKNOWN_TILE_HASH;
+	}
+	
+	Image->Width  = EvenWidth;
+	Image->Height = EvenHeight;
+	Image->Memory = Memory;
+	Image->Size   = ImageSize;
+	
+	u8 *Planes = Memory;
+	int ChromaWidth = EvenWidth / 2;
+	size_t ChromaSize = (size_t)ChromaWidth * (EvenHeight / 2);
+	
+	Image->Planes[0]  = Planes;
+	Image->Pitches[0] = EvenWidth;
+	Image->Planes[1]  = Planes + (size_t)EvenWidth * EvenHeight;
+	if (Image->Format.Layout == YUVLayout_NV12)
+	{
+		Image->Planes[2]  = Image->Planes[1] + 1;
+		Image->Pitches[1] = EvenWidth;
+		Image->Pitches[2] = EvenWidth;
+	}
+	else
+	{
+		Image->Planes[2]  = Image->Planes[1] + ChromaSize;
+		Image->Pitches[1] = ChromaWidth;
+		Image->Pitches[2] = ChromaWidth;
+	}
+	
+	return true;
+}
+
+// @Note Tiles FirstTileX to EndTileX of tile row TileY, every row pair of them in one call of the kernel
+internal void ConvertYUVTiles(yuv_converter *Converter, bitmap *Texture, u32 FirstTileX, u32 EndTileX, u32 TileY)
+{
+	yuv_image *Image = &Converter->Image;
+	
+	int Left   = (int)FirstTileX * CHANGE_TILE_SIZE;
+	int Right  = Min((int)EndTileX * CHANGE_TILE_SIZE, Texture->Width);
+	int Top    = (int)TileY * CHANGE_TILE_SIZE;
+	int Bottom = Min(Top + CHANGE_TILE_SIZE, Texture->Height);
+	
+	yuv_rows Rows;
+	Rows.ChromaStep = (Image->Format.Layout == YUVLayout_NV12) ? 2 : 1;
+	for (int Y = Top; Y < Bottom; Y += 2)
+	{
+		Rows.Source[0] = Texture->Memory + (size_t)Y * Texture->Pitch;
+		Rows.Source[1] = (Y + 1 < Texture->Height) ? Rows.Source[0] + Texture->Pitch : Rows.Source[0];
+		Rows.Y[0] = Image->Planes[0] + (size_t)Y * Image->Pitches[0];
+		Rows.Y[1] = Rows.Y[0] + Image->Pitches[0];
+		Rows.U    = Image->Planes[1] + (size_t)(Y / 2) * Image->Pitches[1];
+		Rows.V    = Image->Planes[2] + (size_t)(Y / 2) * Image->Pitches[2];
+		
+		Converter->ConvertRows(&Converter->Coefficients, &Rows, Left, Right);
+	}
+	
+	Converter->ConvertedTileCount  += EndTileX - FirstTileX;
+	Converter->ConvertedPixelCount += (u64)(Right - Left) * (u64)(Bottom - Top);
+}
+
+//
+// Converts the tiles of Texture that the regions touch into the converter's image and returns how many it converted.
+//
+// @Note With Changes hashing the same texture, a tile is only converted if its hash isn't the one it had when it
+// was converted last, however many crops came and went in between. Without them every tile is converted.
+// The tiles hold whole 2x2 blocks, so a tile's Y, U and V are all its own.
+//
+internal u32 ConvertToYUV(yuv_converter *Converter, bitmap *Texture, box *Regions, u32 RegionCount, change_detector *Changes)
+{
+	if (!ResizeYUVConverter(Converter, Texture->Width, Texture->Height))
+	{
+		return 0;
+	}
+	
+	bool UseHashes = Changes && Changes->Hashes && (Changes->Width == Texture->Width) && (Changes->Height == Texture->Height);
+	
+	u32 ConvertedCount = 0;
+	for (u32 RegionIndex = 0; RegionIndex < RegionCount; ++RegionIndex)
+	{
+		box Region = IntersectBoxes(Regions[RegionIndex], box{ 0, 0, Texture->Width, Texture->Height });
+		if (BoxIsEmpty(Region))
+		{
+			continue;
+		}
+		
+		u32 FirstX = (u32)Region.Left / CHANGE_TILE_SIZE;
+		u32 FirstY = (u32)Region.Top  / CHANGE_TILE_SIZE;
+		u32 EndX   = (u32)(Region.Right  + CHANGE_TILE_SIZE - 1) / CHANGE_TILE_SIZE;
+		u32 EndY   = (u32)(Region.Bottom + CHANGE_TILE_SIZE - 1) / CHANGE_TILE_SIZE;
+		
+		for (u32 TileY = FirstY; TileY < EndY; ++TileY)
+		{
+			// @Note Tiles next to each other that both changed go to the kernel as one run
+			u32 RunStart = EndX;
+			for (u32 TileX = FirstX; TileX <= EndX; ++TileX)
+			{
+				bool Convert = false;
+				if (TileX < EndX)
+				{
+					u32 Tile = TileY * Converter->TilesAcross + TileX;
+					u64 Hash = UseHashes ? Changes->Hashes[Tile] : UNKNOWN_TILE_HASH;
+					
+					Convert = (Hash == UNKNOWN_TILE_HASH) || (Hash != Converter->ConvertedHashes[Tile]);
+					Converter->ConvertedHashes[Tile] = Hash;
+					
+					if (!Convert)
+					{
+						++Converter->UnchangedTileCount;
+					}
+				}
+				
+				if (Convert && (RunStart == EndX))
+				{
+					RunStart = TileX;
+				}
+				else if (!Convert && (RunStart != EndX))
+				{
+					ConvertYUVTiles(Converter, Texture, RunStart, TileX, TileY);
+					ConvertedCount += TileX - RunStart;
+					RunStart = EndX;
+				}
+			}
+		}
+	}
+	
+	++Converter->FrameCount;
+	return ConvertedCount;
+}
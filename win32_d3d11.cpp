@@ -0,0 +1,3723 @@
+//
+// D3D11 + DirectComposition compositor and the DXGI desktop duplication source
+//
+
+#if EMBEDDED_SHADERS
+#include "win32_shaders.h"
+#endif
+
+// @Note Bytecode is looked for in the binary, then in the shader cache, and only compiled when it is in neither.
+// d3dcompiler is loaded by the first compile, a start with every shader embedded or cached never loads it.
+#define D3D_COMPILER_NAME "d3dcompiler_47.dll"
+
+// @Note 1 + ScaleMode_Count + 1 + 2 HDR conversions, and an effect chain for every key, with room to grow
+#define MAX_BAKED_SHADERS 32
+
+struct d3d11_shader_loader
+{
+	shader_cache *Cache; // NULL to always compile
+	pD3DCompile Compile;
+	platform_get_nanoseconds *GetNanoseconds;
+	
+	// @Note Replaces the built-in source when the file is there, see LoadShaderSource
+	char *ShadeSourcePath;
+	char *ConvertSourcePath;
+	
+	u32 EmbeddedCount;
+	u32 CachedCount;
+	u32 CompiledCount;
+	u64 CompileTime;
+	
+	// @Note Every shader loaded, for a BAKE_SHADERS build to write out
+	u32 BakedCount;
+	embedded_shader Baked[MAX_BAKED_SHADERS];
+};
+
+internal void InitializeShaderLoader(d3d11_shader_loader *Loader, shader_cache *Cache, platform_get_nanoseconds *GetNanoseconds)
+{
+	*Loader = {};
+	Loader->Cache             = Cache;
+	Loader->GetNanoseconds    = GetNanoseconds;
+	Loader->ShadeSourcePath   = "overlay_shade.hlsl";
+	Loader->ConvertSourcePath = "overlay_convert.hlsl";
+}
+
+internal shader_blob CompileShader(d3d11_shader_loader *Loader, char *ShaderSource, size_t ShaderSourceSize, char *EntryPoint,
+								   char *Target, int Flags, D3D_SHADER_MACRO *Defines)
+{
+	if (!Loader->Compile)
+	{
+		HMODULE Compiler = LoadLibraryA(D3D_COMPILER_NAME);
+		Loader->Compile = Compiler ? (pD3DCompile)GetProcAddress(Compiler, "D3DCompile") : NULL;
+		if (!Loader->Compile)
+		{
+			Error("LoadLibrary(" D3D_COMPILER_NAME ")");
+		}
+	}
+	
+	ID3DBlob *OutputBlob;
+	ID3DBlob *ErrorBlob;
+	Result = Loader->Compile(ShaderSource, ShaderSourceSize, NULL, Defines, NULL, EntryPoint, Target, Flags, 0, &OutputBlob, &ErrorBlob);
+	if (FAILED(Result))
+	{
+		char *ErrorMessage		= (char *)ErrorBlob->GetBufferPointer();
+		SIZE_T ErrorMessageSize	= ErrorBlob->GetBufferSize();
+		
+		MessageBoxA(0, EntryPoint, 0, 0);
+		Error(ErrorMessage);
+	}
+	
+	shader_blob Shader;
+	Shader.Data = OutputBlob->GetBufferPointer();
+	Shader.Size = (u32)OutputBlob->GetBufferSize();
+	
+	return Shader;
+}
+
+//
+// The bytecode for one permutation, kept for as long as the process runs: a new device makes its shaders from it
+//
+internal shader_blob LoadShader(d3d11_shader_loader *Loader, char *ShaderSource, size_t ShaderSourceSize, char *EntryPoint,
+								D3D_SHADER_MACRO *Defines)
+{
+	int Flags =
+	(DEBUG_BUILD * D3DCOMPILE_DEBUG) |
+	(DEBUG_BUILD * D3DCOMPILE_OPTIMIZATION_LEVEL3) | (              D3DCOMPILE_ENABLE_STRICTNESS) | (              D3DCOMPILE_PARTIAL_PRECISION);
+	
+	char *Target;
+	if (EntryPoint == "VertexMain")
+	{
+		Target = "vs_4_0";
+	}
+	else if (EntryPoint == "PixelMain")
+	{
+		EntryPoint = "PixelMain";
+		Target = "ps_4_0";
+	}
+	else
+	{
+		Error("CompileShader: Unknown Shader Target, Vertex/Pixel");
+	}
+	
+	// @Note Everything the compile is made from. The compiler too, a new one can make other bytecode from the same source.
+	shader_key Key = StartShaderKey();
+	MixShaderKey(&Key, ShaderSource, ShaderSourceSize);
+	MixShaderKeyString(&Key, EntryPoint);
+	MixShaderKeyString(&Key, Target);
+	MixShaderKeyString(&Key, D3D_COMPILER_NAME);
+	MixShaderKey(&Key, &Flags, sizeof(Flags));
+	for (D3D_SHADER_MACRO *Define = Defines; Define->Name; ++Define)
+	{
+		MixShaderKeyString(&Key, Define->Name);
+		MixShaderKeyString(&Key, Define->Definition);
+	}
+	
+	shader_blob Shader = { NULL, 0 };
+
+#if EMBEDDED_SHADERS
+	Shader = FindEmbeddedShader(EmbeddedShaders, GetArrayCount(EmbeddedShaders), Key);
+	Loader->EmbeddedCount += (Shader.Data != NULL);
+#endif
+	
+	if (!Shader.Data && Loader->Cache)
+	{
+		Shader = LookupShaderCache(Loader->Cache, Key);
+		Loader->CachedCount += (Shader.Data != NULL);
+	}
+	
+	if (!Shader.Data)
+	{
+		u64 StartTime = Loader->GetNanoseconds();
+		Shader = CompileShader(Loader, ShaderSource, ShaderSourceSize, EntryPoint, Target, Flags, Defines);
+		Loader->CompileTime += Loader->GetNanoseconds() - StartTime;
+		++Loader->CompiledCount;
+		
+		if (Loader->Cache)
+		{
+			StoreShaderCache(Loader->Cache, Key, Shader.Data, Shader.Size);
+		}
+	}
+	
+	Assert(Loader->BakedCount < MAX_BAKED_SHADERS);
+	embedded_shader *Baked = &Loader->Baked[Loader->BakedCount++];
+	Baked->Key  = Key;
+	Baked->Data = (u8 *)Shader.Data;
+	Baked->Size = Shader.Size;
+	
+	return Shader;
+}
+
+// @Note A user's own shader, read from the working directory, in place of the one built in. Same entry points
+// and defines. Its key is its own, so it is compiled once and comes from the cache after that.
+internal char *LoadShaderSource(d3d11_shader_loader *Loader, char *Path, char *BuiltIn, size_t *SourceSize)
+{
+	*SourceSize = GetStringLength(BuiltIn);
+	
+	size_t FileSize;
+	if (!Loader->Cache || !Loader->Cache->Files->ReadFile(Path, NULL, 0, &FileSize) || (FileSize == 0) ||
+		(FileSize > SHADER_CACHE_MAX_SIZE))
+	{
+		return BuiltIn;
+	}
+	
+	char *Source = (char *)VirtualAlloc(NULL, FileSize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+	size_t ReadSize;
+	if (!Source || !Loader->Cache->Files->ReadFile(Path, Source, FileSize, &ReadSize) || (ReadSize != FileSize))
+	{
+		Error("ReadFile(shader source)");
+	}
+	
+	*SourceSize = FileSize;
+	return Source;
+}
+
+// @Note The immediate context takes a lock around every call from then on
+internal void ProtectD3D11Context(ID3D11DeviceContext *DeviceContext)
+{
+	ID3D11Multithread *Multithread;
+	Result = DeviceContext->QueryInterface(__uuidof(ID3D11Multithread), (void **)&Multithread);
+	if (FAILED(Result))
+	{
+		Error("ID3D11Multithread");
+	}
+	
+	Multithread->SetMultithreadProtected(TRUE);
+	Multithread->Release();
+}
+
+// @Note Returns false when there is no device to be had, right after a driver update or a TDR for one
+internal bool Direct3DCreateDevice(ID3D11Device **Device, ID3D11DeviceContext **DeviceContext, bool WorkersUseContext)
+{
+	// @Note Not single threaded, the output workers duplicate and acquire on their own threads
+	int DeviceFlags =
+		D3D11_CREATE_DEVICE_BGRA_SUPPORT |
+	(DEBUG_BUILD * D3D11_CREATE_DEVICE_DEBUG);
+	
+	D3D_FEATURE_LEVEL FeatureLevel = D3D_FEATURE_LEVEL_10_0;
+	Result = D3D11CreateDevice(NULL, D3D_DRIVER_TYPE_HARDWARE, NULL, DeviceFlags, &FeatureLevel,
+							   1, D3D11_SDK_VERSION, Device, NULL, DeviceContext);
+	
+	if (FAILED(Result))
+	{
+		*Device        = NULL;
+		*DeviceContext = NULL;
+		return false;
+	}
+	
+	if (WorkersUseContext)
+	{
+		ProtectD3D11Context(*DeviceContext);
+	}
+	
+	return true;
+}
+
+inline bool IsDeviceLoss(HRESULT Failure)
+{
+	return (Failure == DXGI_ERROR_DEVICE_REMOVED) || (Failure == DXGI_ERROR_DEVICE_RESET);
+}
+
+// @Note For the device resource release callbacks, which also clean up after a create that failed half way
+#define ReleaseObject(Object) if (Object) { (Object)->Release(); (Object) = NULL; }
+
+// @Note A desktop acquired just before the device was lost still belongs to the old one, and can't be copied from
+inline bool IsOnDevice(ID3D11DeviceChild *Object, ID3D11Device *Device)
+{
+	ID3D11Device *ObjectDevice;
+	Object->GetDevice(&ObjectDevice);
+	ObjectDevice->Release();
+	
+	return (ObjectDevice == Device);
+}
+
+// @Note Shared by the compositor and the duplication source, the compositor makes it again on device loss.
+// The output workers hold the lock shared while they use the device, the rebuild holds it exclusive.
+struct d3d11_device
+{
+	ID3D11Device		*Device;
+	ID3D11DeviceContext	*DeviceContext;
+	
+	SRWLOCK Lock;
+	
+	// @Note Bumped every time a device is made, the output workers duplicate again when it changes
+	u32 volatile Generation;
+	
+	// @Note The output workers use the immediate context while the render thread draws, copying into a capture
+	// ring or taking the keyed mutex of a frame from another adapter. Every device is made multithread protected then.
+	bool WorkersUseContext;
+};
+
+//
+// Capture ring copies, made on the output worker threads
+//
+
+// @Note Same size and format as the desktop and bindable, the crop and the sampling take them like the desktop.
+// A copy from before the device was lost is made again.
+internal bool CopyIntoD3D11Ring(d3d11_device *D3D, ID3D11Texture2D *DesktopTexture, void **Slot, box *Regions, u32 RegionCount)
+{
+	ID3D11Texture2D *Copy = (ID3D11Texture2D *)*Slot;
+	if (!D3D->Device || !IsOnDevice(DesktopTexture, D3D->Device))
+	{
+		return false;
+	}
+	
+	D3D11_TEXTURE2D_DESC DesktopDesc;
+	DesktopTexture->GetDesc(&DesktopDesc);
+	
+	bool CopyIsCurrent = false;
+	if (Copy)
+	{
+		D3D11_TEXTURE2D_DESC CopyDesc;
+		Copy->GetDesc(&CopyDesc);
+		
+		CopyIsCurrent = IsOnDevice(Copy, D3D->Device) && (CopyDesc.Width == DesktopDesc.Width) &&
+			(CopyDesc.Height == DesktopDesc.Height) && (CopyDesc.Format == DesktopDesc.Format);
+	}
+	
+	box Whole = box{ 0, 0, (int)DesktopDesc.Width, (int)DesktopDesc.Height };
+	if (!CopyIsCurrent)
+	{
+		if (Copy)
+		{
+			Copy->Release();
+			*Slot = NULL;
+		}
+		
+		D3D11_TEXTURE2D_DESC CopyDesc = {};
+		CopyDesc.Width              = DesktopDesc.Width;
+		CopyDesc.Height             = DesktopDesc.Height;
+		CopyDesc.MipLevels          = 1;
+		CopyDesc.ArraySize          = 1;
+		CopyDesc.Format             = DesktopDesc.Format;
+		CopyDesc.SampleDesc.Count   = 1;
+		CopyDesc.SampleDesc.Quality = 0;
+		CopyDesc.Usage              = D3D11_USAGE_DEFAULT;
+		CopyDesc.BindFlags          = D3D11_BIND_SHADER_RESOURCE;
+		
+		HRESULT CopyResult = D3D->Device->CreateTexture2D(&CopyDesc, NULL, &Copy);
+		if (FAILED(CopyResult))
+		{
+			return false;
+		}
+		
+		*Slot = Copy;
+		Regions     = &Whole;
+		RegionCount = 1;
+	}
+	
+	for (u32 RegionIndex = 0; RegionIndex < RegionCount; ++RegionIndex)
+	{
+		box Region = Regions[RegionIndex];
+		
+		D3D11_BOX RegionBox;
+		RegionBox.left   = Region.Left;
+		RegionBox.top    = Region.Top;
+		RegionBox.right  = Region.Right;
+		RegionBox.bottom = Region.Bottom;
+		RegionBox.front  = 0;
+		RegionBox.back   = 1;
+		
+		D3D->DeviceContext->CopySubresourceRegion(Copy, 0, Region.Left, Region.Top, 0, DesktopTexture, 0, &RegionBox);
+	}
+	
+	return true;
+}
+
+// @Note The rebuild after a lost device waits for the copy, and the copy for the rebuild
+internal CAPTURE_RING_COPY(D3D11RingCopy)
+{
+	d3d11_device *D3D = (d3d11_device *)Context;
+	ID3D11Texture2D *DesktopTexture = (ID3D11Texture2D *)Frame->Surface;
+	
+	AcquireSRWLockShared(&D3D->Lock);
+	bool Copied = CopyIntoD3D11Ring(D3D, DesktopTexture, Slot, Regions, RegionCount);
+	ReleaseSRWLockShared(&D3D->Lock);
+	
+	return Copied;
+}
+
+
+//
+// Compositor
+//
+
+#define SWAP_CHAIN_BUFFER_COUNT 2
+
+// @Note Created with a frame latency waitable object, resizes have to keep the flag
+#define SWAP_CHAIN_FLAGS DXGI_SWAP_CHAIN_FLAG_FRAME_LATENCY_WAITABLE_OBJECT
+
+// @Note Largest texture feature level 10_0 guarantees, which is what we create the device with
+#define D3D11_ATLAS_MAX_SIZE 8192
+
+// @Note Taps a side for the bicubic and Lanczos PixelMain, 256 loads a pixel at most. The CPU reference goes to
+// SCALE_MAX_TAPS, so past about a 4x shrink the GPU filter is narrower than the software one.
+#define D3D11_FILTER_MAX_TAPS 16
+
+// @Note Results come back a few frames late, this many can be in flight before we stop timing
+#define GPU_TIMER_COUNT 4
+
+// @Note Display texture copies on their way to the export ring, mapped a few frames late so the CPU never waits on them
+#define EXPORT_STAGING_COUNT 3
+
+// @Note The same for the recording, which can't drop a frame for being late so it waits on the oldest instead
+#define RECORD_STAGING_COUNT 3
+
+// @Note Crops up to this many pixels are read back to tell whether they changed anything. The map waits on the GPU
+// for the copy, which for a crop this small costs less than drawing and presenting it again. Bigger ones always present.
+#define CHANGE_READBACK_MAX_PIXELS (512 * 512)
+
+struct gpu_timer
+{
+	ID3D11Query *Disjoint;
+	ID3D11Query *Start;
+	ID3D11Query *End;
+};
+
+struct export_staging
+{
+	ID3D11Texture2D *Texture;
+	int Width;
+	int Height;
+	
+	// @Note What goes into the ring with the copy, the pieces as they were when it was made
+	export_frame Frame;
+};
+
+struct record_staging
+{
+	ID3D11Texture2D *Texture;
+	int Width;
+	int Height;
+	
+	// @Note How the copy was drawn, as the software shade would have set it up, see EncodeRecordingFrame
+	u64 Timestamp;
+	scale_mode ScaleMode;
+	int TargetWidth;
+	int TargetHeight;
+	u32 SetupCount;
+	shade_setup Setups[MAX_CROP_PIECES];
+};
+
+// @Note Compiled once, a new device makes its shaders from the same bytecode
+struct d3d11_shader_code
+{
+	shader_blob Vertex;
+	shader_blob Pixel[ScaleMode_Count];
+	shader_blob ConvertVertex;
+	shader_blob ConvertPixel[SurfaceFormat_Count];
+	
+	// @Note The bilinear PixelMain with an effect chain, by key. Loaded the first time a shade draws with it,
+	// from the source the rest were, see LoadD3D11EffectShader. Nothing for key 0, that is Pixel[0].
+	char *ShadeSource;
+	size_t ShadeSourceSize;
+	shader_blob EffectPixel[EffectKey_Count];
+};
+
+// @Note Registry order, see InitializeD3D11Compositor. The GPU timers come after the rest, and only with a latency ring.
+// The export staging textures go after them, and only with an export ring.
+enum d3d11_resource
+{
+	D3D11Resource_Device,
+	D3D11Resource_Shaders,
+	D3D11Resource_ConvertShaders,
+	D3D11Resource_ConstantBuffers,
+	D3D11Resource_Samplers,
+	D3D11Resource_SampledView,
+	D3D11Resource_SwapChain,
+	D3D11Resource_BackBufferView,
+	D3D11Resource_Composition,
+	D3D11Resource_DisplayTexture,
+	D3D11Resource_Bindings,
+	D3D11Resource_GpuTimers,
+};
+
+struct d3d11_compositor
+{
+	d3d11_device *D3D;
+	
+	// @Note Everything below that is made from the device, and how, see RecoverD3D11Device.
+	// Lost until a rebuild goes through, which is tried again every frame.
+	device_registry Registry;
+	bool DeviceIsLost;
+	bool DeviceWasRebuilt;
+	
+	d3d11_shader_code ShaderCode;
+	D3D11_SAMPLER_DESC SamplerDescs[ScaleMode_Count];
+	
+	ID3D11Buffer				*ConstantBuffer;
+	IDXGISwapChain1				*SwapChain;
+	ID3D11RenderTargetView		*RenderTargetView;
+	
+	// @Note Signalled when the swap chain has room for a frame, at most one is queued. A wait that
+	// went through is good for one present, so it is kept if we end up not presenting.
+	HANDLE FrameLatencyWaitable;
+	bool CanPresent;
+	
+	// @Note Every piece of a cut box has its slot in the one display texture, sized to the crop atlas.
+	// These come out of the pool and go back into it.
+	atlas_layout				CropAtlas;
+	texture_pool				TexturePool;
+	ID3D11Texture2D				*DisplayTexture;
+	ID3D11ShaderResourceView	*DisplayTextureView;
+	ID3D11RenderTargetView		*DisplayTextureTarget;
+	int TextureWidth;
+	int TextureHeight;
+	
+	// @Note Every overlay draws into its slot of the one swap chain, which is just big enough for the
+	// display atlas. Each window's visual shows that swap chain shifted so its own slot is at the origin.
+	atlas_layout				DisplayAtlas;
+	int SwapChainWidth;
+	int SwapChainHeight;
+	
+	HWND Windows[MAX_OVERLAYS];
+	u32 WindowCount;
+	
+	IDCompositionDevice			*CompositionDevice;
+	IDCompositionTarget			*Targets[MAX_OVERLAYS];
+	IDCompositionVisual			*Visuals[MAX_OVERLAYS];
+	box VisualSlots[MAX_OVERLAYS];
+	bool VisualsChanged;
+	
+	int ViewportWidth;
+	int ViewportHeight;
+	
+	// @Note A PixelMain and a sampler for every scaling mode, the shade binds whichever the state asks for
+	ID3D11VertexShader *VertexShader;
+	ID3D11PixelShader  *PixelShaders[ScaleMode_Count];
+	ID3D11SamplerState *Samplers[ScaleMode_Count];
+	scale_mode BoundScale;
+	
+	// @Note Made the first time a shade draws with their key, from bytecode the loader finds or compiles then.
+	// Their parameters are in the effect buffer, which is only mapped again when they change.
+	d3d11_shader_loader *Loader;
+	ID3D11PixelShader  *EffectShaders[EffectKey_Count];
+	u32 BoundEffectKey;
+	ID3D11Buffer       *EffectBuffer;
+	effect_constants Effects;
+	bool EffectsAreStale;
+	
+	// @Note Set by every crop, the mip chain is only generated for a shade that samples it
+	bool MipsAreStale;
+	
+	// @Note An HDR crop draws with these instead of copying, one PixelMain per source format and NULL for BGRA8
+	ID3D11VertexShader *ConvertVertexShader;
+	ID3D11PixelShader  *ConvertPixelShaders[SurfaceFormat_Count];
+	ID3D11Buffer       *ConvertConstantBuffer;
+	
+	// @Note The acquired desktop, and a view of it for the pieces drawn straight from it, see D3D11Sample.
+	// Duplication hands out the same texture frame after frame so the view is kept until it doesn't.
+	ID3D11Texture2D          *SampledTexture;
+	ID3D11ShaderResourceView *SampledView;
+	int SampledWidth;
+	int SampledHeight;
+	
+	// @Note What the constant buffer holds, only mapped again when this changes
+	u32 InstanceCount;
+	overlay_instance Instances[MAX_CROP_PIECES];
+	
+	// @Note Only with a latency ring, see EnableD3D11GpuTiming
+	latency_ring *LatencyRing;
+	gpu_timer GpuTimers[GPU_TIMER_COUNT];
+	u32 GpuTimerWriteCount;
+	u32 GpuTimerReadCount;
+	bool GpuTimerIsOpen;
+	
+	// @Note Only with an export ring, see EnableD3D11FrameExport
+	export_ring *ExportRing;
+	yuv_converter *ExportConverter; // NULL exports the BGRA as it is
+	export_staging ExportStaging[EXPORT_STAGING_COUNT];
+	u32 ExportWriteCount;
+	u32 ExportReadCount;
+	u64 ExportDroppedCount; // Presented while every staging texture was still in flight
+	
+	// @Note Only with change detection, see EnableD3D11ChangeDetection. The staging texture is the display texture's size,
+	// a crop goes to the same place in it.
+	change_detector *Changes;
+	ID3D11Texture2D *ChangeStaging;
+	int ChangeStagingWidth;
+	int ChangeStagingHeight;
+	
+	// @Note Only with a recorder, see EnableD3D11Recording
+	recording_writer *Recorder;
+	HANDLE RecordFile;
+	record_staging RecordStaging[RECORD_STAGING_COUNT];
+	u32 RecordWriteCount;
+	u32 RecordReadCount;
+	
+	compositor_memory  Memory;
+	compositor_traffic Traffic;
+};
+
+internal TEXTURE_POOL_CREATE(D3D11CreateTexture)
+{
+	d3d11_compositor *Compositor = (d3d11_compositor *)Context;
+	ID3D11Device *Device = Compositor->D3D->Device;
+	
+	// @Note A full mip chain for ScaleMode_Mip, GenerateMips needs it bound as a render target too. The atlas only holds
+	// the crops so the chain only covers them, but the coarse levels blend neighbouring slots along their edges.
+	// The pool counts the whole chain.
+	// @Note Typeless so the desktop copies straight in and the views can be sRGB, the shade samples linear light
+	// and the mips and filters average in it. An HDR crop draws into it through the sRGB target view.
+	D3D11_TEXTURE2D_DESC TextureDesc;
+	TextureDesc.Width          = Texture->Width;
+	TextureDesc.Height         = Texture->Height;
+	TextureDesc.MipLevels      = 0;
+	TextureDesc.ArraySize      = 1;
+	TextureDesc.Format         = DXGI_FORMAT_B8G8R8A8_TYPELESS;
+	TextureDesc.SampleDesc     = DXGI_SAMPLE_DESC{ 1, 0 };
+	TextureDesc.Usage          = D3D11_USAGE_DEFAULT;
+	TextureDesc.BindFlags      = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_RENDER_TARGET;
+	TextureDesc.CPUAccessFlags = 0;
+	TextureDesc.MiscFlags      = D3D11_RESOURCE_MISC_GENERATE_MIPS;
+	
+	// @Note Fails when the device is lost, the display texture gets made again along with everything else
+	ID3D11Texture2D *DisplayTexture;
+	Result = Device->CreateTexture2D(&TextureDesc, NULL, &DisplayTexture);
+	if (FAILED(Result))
+	{
+		return false;
+	}
+	
+	D3D11_SHADER_RESOURCE_VIEW_DESC ShaderResourceViewDesc;
+	ShaderResourceViewDesc.Format                    = DXGI_FORMAT_B8G8R8A8_UNORM_SRGB;
+	ShaderResourceViewDesc.ViewDimension             = D3D11_SRV_DIMENSION_TEXTURE2D;
+	ShaderResourceViewDesc.Texture2D.MostDetailedMip = 0;
+	ShaderResourceViewDesc.Texture2D.MipLevels       = (UINT)-1;
+	
+	ID3D11ShaderResourceView *TextureView;
+	Result = Device->CreateShaderResourceView(DisplayTexture, &ShaderResourceViewDesc, &TextureView);
+	if (FAILED(Result))
+	{
+		DisplayTexture->Release();
+		return false;
+	}
+	
+	D3D11_RENDER_TARGET_VIEW_DESC RenderTargetViewDesc;
+	RenderTargetViewDesc.Format             = DXGI_FORMAT_B8G8R8A8_UNORM_SRGB;
+	RenderTargetViewDesc.ViewDimension      = D3D11_RTV_DIMENSION_TEXTURE2D;
+	RenderTargetViewDesc.Texture2D.MipSlice = 0;
+	
+	ID3D11RenderTargetView *TextureTarget;
+	Result = Device->CreateRenderTargetView(DisplayTexture, &RenderTargetViewDesc, &TextureTarget);
+	if (FAILED(Result))
+	{
+		TextureView->Release();
+		DisplayTexture->Release();
+		return false;
+	}
+	
+	Texture->Handle = DisplayTexture;
+	Texture->View   = TextureView;
+	Texture->Target = TextureTarget;
+	
+	return true;
+}
+
+internal TEXTURE_POOL_DESTROY(D3D11DestroyTexture)
+{
+	((ID3D11RenderTargetView *)Texture->Target)->Release();
+	((ID3D11ShaderResourceView *)Texture->View)->Release();
+	((ID3D11Texture2D *)Texture->Handle)->Release();
+}
+
+internal void UpdateD3D11Memory(d3d11_compositor *Compositor)
+{
+	texture_pool *Pool = &Compositor->TexturePool;
+	compositor_memory *Memory = &Compositor->Memory;
+	
+	Memory->TextureBytes           = GetTextureBytes(Pool, Compositor->TextureWidth, Compositor->TextureHeight);
+	Memory->PooledBytes            = Pool->PooledBytes;
+	Memory->SwapChainBytes         = (u64)Compositor->SwapChainWidth * Compositor->SwapChainHeight * 4 * SWAP_CHAIN_BUFFER_COUNT;
+	Memory->TextureAllocationCount = Pool->AllocationCount;
+	Memory->TextureReuseCount      = Pool->ReuseCount;
+	
+	// @Note Shows up in the debugger output, there is no console to print it to
+	char Report[256];
+	wsprintfA(Report, "Overlay memory: texture atlas %dx%d, swap chain atlas %dx%d, %u KB in use (monitor-sized would be %u KB per overlay), %u textures allocated, %u reused, %u resizes\n",
+			  Compositor->TextureWidth, Compositor->TextureHeight, Compositor->SwapChainWidth, Compositor->SwapChainHeight,
+			  (u32)((Memory->PooledBytes + Memory->SwapChainBytes) / 1024),
+			  (u32)((u64)MonitorWidth * MonitorHeight * 4 * (1 + SWAP_CHAIN_BUFFER_COUNT) / 1024),
+			  Memory->TextureAllocationCount, Memory->TextureReuseCount, Memory->SwapChainResizeCount);
+	OutputDebugStringA(Report);
+}
+
+// @Note The swap chain can't be resized while anything still points at its buffers, so the view never keeps one
+internal bool CreateBackBufferView(d3d11_compositor *Compositor)
+{
+	ID3D11Texture2D *BackBuffer;
+	Result = Compositor->SwapChain->GetBuffer(0, __uuidof(ID3D11Texture2D), (void **)&BackBuffer);
+	if (FAILED(Result))
+	{
+		return false;
+	}
+	
+	// @Note Not sRGB, PixelMain encodes itself so it can premultiply after the encode the way DWM blends
+	D3D11_RENDER_TARGET_VIEW_DESC RenderTargetViewDesc;
+	RenderTargetViewDesc.Format             = DXGI_FORMAT_B8G8R8A8_UNORM;
+	RenderTargetViewDesc.ViewDimension      = D3D11_RTV_DIMENSION_TEXTURE2D;
+	RenderTargetViewDesc.Texture2D.MipSlice = 0;
+	
+	Result = Compositor->D3D->Device->CreateRenderTargetView(BackBuffer, &RenderTargetViewDesc, &Compositor->RenderTargetView);
+	BackBuffer->Release();
+	
+	if (FAILED(Result))
+	{
+		Compositor->RenderTargetView = NULL;
+		return false;
+	}
+	
+	return true;
+}
+
+
+// @Note Returns false when the texture couldn't be made, the device is lost then
+internal bool ResizeDisplayTexture(d3d11_compositor *Compositor, int Width, int Height)
+{
+	if ((Compositor->TextureWidth == Width) && (Compositor->TextureHeight == Height))
+	{
+		return true;
+	}
+	
+	pooled_texture *Texture = GetPooledTexture(&Compositor->TexturePool, Width, Height);
+	if (!Texture)
+	{
+		return false;
+	}
+	
+	Compositor->DisplayTexture       = (ID3D11Texture2D *)Texture->Handle;
+	Compositor->DisplayTextureView   = (ID3D11ShaderResourceView *)Texture->View;
+	Compositor->DisplayTextureTarget = (ID3D11RenderTargetView *)Texture->Target;
+	Compositor->TextureWidth         = Width;
+	Compositor->TextureHeight        = Height;
+	
+	Compositor->D3D->DeviceContext->PSSetShaderResources(0, 1, &Compositor->DisplayTextureView);
+	
+	UpdateD3D11Memory(Compositor);
+	return true;
+}
+
+// @Note Returns false when the device was lost on the way, the rebuild makes the swap chain the new size
+internal bool ResizeSwapChain(d3d11_compositor *Compositor, int Width, int Height)
+{
+	if ((Compositor->SwapChainWidth == Width) && (Compositor->SwapChainHeight == Height))
+	{
+		return true;
+	}
+	
+	// @Note Every reference to the back buffers has to go first, the bound render target included
+	Compositor->D3D->DeviceContext->OMSetRenderTargets(0, NULL, NULL);
+	Compositor->RenderTargetView->Release();
+	Compositor->RenderTargetView = NULL;
+	
+	Result = Compositor->SwapChain->ResizeBuffers(0, Width, Height, DXGI_FORMAT_UNKNOWN, SWAP_CHAIN_FLAGS);
+	if (FAILED(Result))
+	{
+		if (IsDeviceLoss(Result))
+		{
+			return false;
+		}
+		
+		Error("ResizeBuffers");
+	}
+	
+	if (!CreateBackBufferView(Compositor))
+	{
+		return false;
+	}
+	
+	Compositor->SwapChainWidth  = Width;
+	Compositor->SwapChainHeight = Height;
+	++Compositor->Memory.SwapChainResizeCount;
+	
+	UpdateD3D11Memory(Compositor);
+	return true;
+}
+
+//
+// GPU timing: timestamp queries around the crops and the draw of a frame
+//
+// @Note With the pacer holding a frame back the hold is in there too, the GPU just sits idle
+// between the crops and the draw. Lowest latency pacing gives the cost of the work alone.
+//
+
+internal void ReleaseGpuTimers(d3d11_compositor *Compositor)
+{
+	for (u32 TimerIndex = 0; TimerIndex < GPU_TIMER_COUNT; ++TimerIndex)
+	{
+		gpu_timer *Timer = &Compositor->GpuTimers[TimerIndex];
+		ReleaseObject(Timer->Disjoint);
+		ReleaseObject(Timer->Start);
+		ReleaseObject(Timer->End);
+	}
+}
+
+// @Note Queries belong to the device, whatever was in flight is gone with it
+internal bool CreateGpuTimers(d3d11_compositor *Compositor)
+{
+	ID3D11Device *Device = Compositor->D3D->Device;
+	
+	D3D11_QUERY_DESC DisjointDesc;
+	DisjointDesc.Query     = D3D11_QUERY_TIMESTAMP_DISJOINT;
+	DisjointDesc.MiscFlags = 0;
+	
+	D3D11_QUERY_DESC TimestampDesc;
+	TimestampDesc.Query     = D3D11_QUERY_TIMESTAMP;
+	TimestampDesc.MiscFlags = 0;
+	
+	for (u32 TimerIndex = 0; TimerIndex < GPU_TIMER_COUNT; ++TimerIndex)
+	{
+		gpu_timer *Timer = &Compositor->GpuTimers[TimerIndex];
+		Timer->Disjoint = NULL;
+		Timer->Start    = NULL;
+		Timer->End      = NULL;
+	}
+	
+	for (u32 TimerIndex = 0; TimerIndex < GPU_TIMER_COUNT; ++TimerIndex)
+	{
+		gpu_timer *Timer = &Compositor->GpuTimers[TimerIndex];
+		if (FAILED(Device->CreateQuery(&DisjointDesc,  &Timer->Disjoint)) ||
+			FAILED(Device->CreateQuery(&TimestampDesc, &Timer->Start))    ||
+			FAILED(Device->CreateQuery(&TimestampDesc, &Timer->End)))
+		{
+			ReleaseGpuTimers(Compositor);
+			return false;
+		}
+	}
+	
+	Compositor->GpuTimerWriteCount = 0;
+	Compositor->GpuTimerReadCount  = 0;
+	Compositor->GpuTimerIsOpen     = false;
+	
+	return true;
+}
+
+// @Note Never waits on the GPU, whatever isn't done yet gets looked at next frame
+internal void CollectGpuTimers(d3d11_compositor *Compositor)
+{
+	ID3D11DeviceContext *DeviceContext = Compositor->D3D->DeviceContext;
+	
+	while (Compositor->GpuTimerReadCount != Compositor->GpuTimerWriteCount)
+	{
+		gpu_timer *Timer = &Compositor->GpuTimers[Compositor->GpuTimerReadCount % GPU_TIMER_COUNT];
+		
+		D3D11_QUERY_DATA_TIMESTAMP_DISJOINT Disjoint;
+		u64 StartTime;
+		u64 EndTime;
+		if ((DeviceContext->GetData(Timer->Disjoint, &Disjoint,  sizeof(Disjoint),  D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK) ||
+			(DeviceContext->GetData(Timer->Start,    &StartTime, sizeof(StartTime), D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK) ||
+			(DeviceContext->GetData(Timer->End,      &EndTime,   sizeof(EndTime),   D3D11_ASYNC_GETDATA_DONOTFLUSH) != S_OK))
+		{
+			break;
+		}
+		
+		// @Note Disjoint means the clock changed speed in between, the ticks are no good then
+		if (!Disjoint.Disjoint && (Disjoint.Frequency > 0) && (EndTime >= StartTime))
+		{
+			u64 Ticks   = EndTime - StartTime;
+			u64 Seconds = Ticks / Disjoint.Frequency;
+			u64 Rest    = Ticks % Disjoint.Frequency;
+			PushLatencySample(Compositor->LatencyRing, LatencyStage_Gpu,
+							  Seconds * 1000000000 + (Rest * 1000000000) / Disjoint.Frequency);
+		}
+		
+		++Compositor->GpuTimerReadCount;
+	}
+}
+
+// @Note Skipped when every timer is still in flight, that frame just doesn't get timed
+internal void BeginGpuTimer(d3d11_compositor *Compositor)
+{
+	if (!Compositor->LatencyRing || Compositor->GpuTimerIsOpen)
+	{
+		return;
+	}
+	
+	CollectGpuTimers(Compositor);
+	if ((Compositor->GpuTimerWriteCount - Compositor->GpuTimerReadCount) == GPU_TIMER_COUNT)
+	{
+		return;
+	}
+	
+	ID3D11DeviceContext *DeviceContext = Compositor->D3D->DeviceContext;
+	gpu_timer *Timer = &Compositor->GpuTimers[Compositor->GpuTimerWriteCount % GPU_TIMER_COUNT];
+	
+	DeviceContext->Begin(Timer->Disjoint);
+	DeviceContext->End(Timer->Start);
+	Compositor->GpuTimerIsOpen = true;
+}
+
+internal void EndGpuTimer(d3d11_compositor *Compositor)
+{
+	if (!Compositor->GpuTimerIsOpen)
+	{
+		return;
+	}
+	
+	ID3D11DeviceContext *DeviceContext = Compositor->D3D->DeviceContext;
+	gpu_timer *Timer = &Compositor->GpuTimers[Compositor->GpuTimerWriteCount % GPU_TIMER_COUNT];
+	
+	DeviceContext->End(Timer->End);
+	DeviceContext->End(Timer->Disjoint);
+	++Compositor->GpuTimerWriteCount;
+	Compositor->GpuTimerIsOpen = false;
+}
+
+//
+// Device resources, registered by InitializeD3D11Compositor in this order
+//
+// @Note Every create cleans up after itself when it fails half way, the registry only releases what was made
+//
+
+internal DEVICE_RESOURCE_CREATE(D3D11OpenDevice)
+{
+	d3d11_compositor *Compositor = (d3d11_compositor *)Context;
+	d3d11_device *D3D = Compositor->D3D;
+	
+	if (!Direct3DCreateDevice(&D3D->Device, &D3D->DeviceContext, D3D->WorkersUseContext))
+	{
+		return false;
+	}
+	
+	AtomicStoreU32(&D3D->Generation, D3D->Generation + 1);
+	return true;
+}
+
+internal DEVICE_RESOURCE_RELEASE(D3D11CloseDevice)
+{
+	d3d11_compositor *Compositor = (d3d11_compositor *)Context;
+	d3d11_device *D3D = Compositor->D3D;
+	
+	ReleaseObject(D3D->DeviceContext);
+	ReleaseObject(D3D->Device);
+}
+
+internal DEVICE_RESOURCE_RELEASE(D3D11ReleaseShaders)
+{
+	d3d11_compositor *Compositor = (d3d11_compositor *)Context;
+	
+	ReleaseObject(Compositor->VertexShader);
+	for (int Mode = 0; Mode < ScaleMode_Count; ++Mode)
+	{
+		ReleaseObject(Compositor->PixelShaders[Mode]);
+	}
+	
+	for (u32 Key = 0; Key < EffectKey_Count; ++Key)
+	{
+		ReleaseObject(Compositor->EffectShaders[Key]);
+	}
+}
+
+internal DEVICE_RESOURCE_CREATE(D3D11CreateShaders)
+{
+	d3d11_compositor *Compositor = (d3d11_compositor *)Context;
+	d3d11_shader_code *Code = (d3d11_shader_code *)Resource->Recipe;
+	ID3D11Device *Device = Compositor->D3D->Device;
+	
+	Compositor->VertexShader = NULL;
+	for (int Mode = 0; Mode < ScaleMode_Count; ++Mode)
+	{
+		Compositor->PixelShaders[Mode] = NULL;
+	}
+	
+	// @Note The effect chains are made again the first time a shade draws with them
+	for (u32 Key = 0; Key < EffectKey_Count; ++Key)
+	{
+		Compositor->EffectShaders[Key] = NULL;
+	}
+	
+	Result = Device->CreateVertexShader(Code->Vertex.Data, Code->Vertex.Size, NULL, &Compositor->VertexShader);
+	for (int Mode = 0; SUCCEEDED(Result) && (Mode < ScaleMode_Count); ++Mode)
+	{
+		Result = Device->CreatePixelShader(Code->Pixel[Mode].Data, Code->Pixel[Mode].Size, NULL, &Compositor->PixelShaders[Mode]);
+	}
+	
+	if (FAILED(Result))
+	{
+		D3D11ReleaseShaders(Context, Resource);
+		return false;
+	}
+	
+	return true;
+}
+
+internal DEVICE_RESOURCE_RELEASE(D3D11ReleaseConvertShaders)
+{
+	d3d11_compositor *Compositor = (d3d11_compositor *)Context;
+	
+	ReleaseObject(Compositor->ConvertVertexShader);
+	for (int Format = 0; Format < SurfaceFormat_Count; ++Format)
+	{
+		ReleaseObject(Compositor->ConvertPixelShaders[Format]);
+	}
+}
+
+// @Note Nothing for BGRA8, it copies straight in
+internal DEVICE_RESOURCE_CREATE(D3D11CreateConvertShaders)
+{
+	d3d11_compositor *Compositor = (d3d11_compositor *)Context;
+	d3d11_shader_code *Code = (d3d11_shader_code *)Resource->Recipe;
+	ID3D11Device *Device = Compositor->D3D->Device;
+	
+	Compositor->ConvertVertexShader = NULL;
+	for (int Format = 0; Format < SurfaceFormat_Count; ++Format)
+	{
+		Compositor->ConvertPixelShaders[Format] = NULL;
+	}
+	
+	Result = Device->CreateVertexShader(Code->ConvertVertex.Data, Code->ConvertVertex.Size, NULL, &Compositor->ConvertVertexShader);
+	for (int Format = SurfaceFormat_RGBA16F; SUCCEEDED(Result) && (Format < SurfaceFormat_Count); ++Format)
+	{
+		Result = Device->CreatePixelShader(Code->ConvertPixel[Format].Data, Code->ConvertPixel[Format].Size, NULL,
+										   &Compositor->ConvertPixelShaders[Format]);
+	}
+	
+	if (FAILED(Result))
+	{
+		D3D11ReleaseConvertShaders(Context, Resource);
+		return false;
+	}
+	
+	return true;
+}
+
+internal DEVICE_RESOURCE_RELEASE(D3D11ReleaseConstantBuffers)
+{
+	d3d11_compositor *Compositor = (d3d11_compositor *)Context;
+	
+	ReleaseObject(Compositor->ConstantBuffer);
+	ReleaseObject(Compositor->ConvertConstantBuffer);
+	ReleaseObject(Compositor->EffectBuffer);
+}
+
+// @Note Filled in by the first shade, nothing is drawn before that. The convert one is only bound while an HDR crop draws.
+internal DEVICE_RESOURCE_CREATE(D3D11CreateConstantBuffers)
+{
+	d3d11_compositor *Compositor = (d3d11_compositor *)Context;
+	ID3D11Device *Device = Compositor->D3D->Device;
+	
+	D3D11_BUFFER_DESC BufferDescription;
+	BufferDescription.ByteWidth           = sizeof(vertex_constant_buffer);
+	BufferDescription.Usage               = D3D11_USAGE_DYNAMIC;
+	BufferDescription.BindFlags           = D3D11_BIND_CONSTANT_BUFFER;
+	BufferDescription.CPUAccessFlags      = D3D11_CPU_ACCESS_WRITE;
+	BufferDescription.MiscFlags           = 0;
+	BufferDescription.StructureByteStride = 0;
+	
+	Compositor->ConvertConstantBuffer = NULL;
+	Compositor->EffectBuffer          = NULL;
+	Result = Device->CreateBuffer(&BufferDescription, NULL, &Compositor->ConstantBuffer);
+	if (FAILED(Result))
+	{
+		Compositor->ConstantBuffer = NULL;
+		return false;
+	}
+	
+	BufferDescription.ByteWidth = sizeof(convert_constant_buffer);
+	Result = Device->CreateBuffer(&BufferDescription, NULL, &Compositor->ConvertConstantBuffer);
+	if (FAILED(Result))
+	{
+		Compositor->ConvertConstantBuffer = NULL;
+		D3D11ReleaseConstantBuffers(Context, Resource);
+		return false;
+	}
+	
+	BufferDescription.ByteWidth = sizeof(effect_constants);
+	Result = Device->CreateBuffer(&BufferDescription, NULL, &Compositor->EffectBuffer);
+	if (FAILED(Result))
+	{
+		Compositor->EffectBuffer = NULL;
+		D3D11ReleaseConstantBuffers(Context, Resource);
+		return false;
+	}
+	
+	return true;
+}
+
+internal DEVICE_RESOURCE_RELEASE(D3D11ReleaseSamplers)
+{
+	d3d11_compositor *Compositor = (d3d11_compositor *)Context;
+	
+	for (int Mode = 0; Mode < ScaleMode_Count; ++Mode)
+	{
+		ReleaseObject(Compositor->Samplers[Mode]);
+	}
+}
+
+internal DEVICE_RESOURCE_CREATE(D3D11CreateSamplers)
+{
+	d3d11_compositor *Compositor = (d3d11_compositor *)Context;
+	D3D11_SAMPLER_DESC *SamplerDescs = (D3D11_SAMPLER_DESC *)Resource->Recipe;
+	
+	for (int Mode = 0; Mode < ScaleMode_Count; ++Mode)
+	{
+		Compositor->Samplers[Mode] = NULL;
+	}
+	
+	for (int Mode = 0; Mode < ScaleMode_Count; ++Mode)
+	{
+		Result = Compositor->D3D->Device->CreateSamplerState(&SamplerDescs[Mode], &Compositor->Samplers[Mode]);
+		if (FAILED(Result))
+		{
+			Compositor->Samplers[Mode] = NULL;
+			D3D11ReleaseSamplers(Context, Resource);
+			return false;
+		}
+	}
+	
+	return true;
+}
+
+// @Note Made by D3D11Sample when a frame asks for it, all a new device needs is for the old view to go
+internal DEVICE_RESOURCE_CREATE(D3D11CreateSampledView)
+{
+	d3d11_compositor *Compositor = (d3d11_compositor *)Context;
+	
+	Compositor->SampledTexture = NULL;
+	Compositor->SampledView    = NULL;
+	Compositor->SampledWidth   = 0;
+	Compositor->SampledHeight  = 0;
+	
+	return true;
+}
+
+internal DEVICE_RESOURCE_RELEASE(D3D11ReleaseSampledView)
+{
+	d3d11_compositor *Compositor = (d3d11_compositor *)Context;
+	
+	ReleaseObject(Compositor->SampledView);
+	Compositor->SampledTexture = NULL;
+}
+
+internal DEVICE_RESOURCE_RELEASE(D3D11ReleaseSwapChain)
+{
+	d3d11_compositor *Compositor = (d3d11_compositor *)Context;
+	
+	if (Compositor->FrameLatencyWaitable)
+	{
+		CloseHandle(Compositor->FrameLatencyWaitable);
+		Compositor->FrameLatencyWaitable = NULL;
+	}
+	
+	ReleaseObject(Compositor->SwapChain);
+	Compositor->CanPresent = false;
+}
+
+// @Note The size of the display atlas as it is now, 1x1 before the first layout
+internal DEVICE_RESOURCE_CREATE(D3D11CreateSwapChain)
+{
+	d3d11_compositor *Compositor = (d3d11_compositor *)Context;
+	ID3D11Device *Device = Compositor->D3D->Device;
+	
+	Compositor->SwapChain            = NULL;
+	Compositor->FrameLatencyWaitable = NULL;
+	Compositor->CanPresent           = false;
+	
+	IDXGIDevice *DXGIDevice;
+	Result = Device->QueryInterface(__uuidof(IDXGIDevice), (void **)&DXGIDevice);
+	if (FAILED(Result))
+	{
+		return false;
+	}
+	
+	IDXGIAdapter *Adapter;
+	Result = DXGIDevice->GetAdapter(&Adapter);
+	DXGIDevice->Release();
+	if (FAILED(Result))
+	{
+		return false;
+	}
+	
+	IDXGIFactory2 *Factory;
+	Result = Adapter->GetParent(__uuidof(IDXGIFactory2), (void **)&Factory);
+	Adapter->Release();
+	if (FAILED(Result))
+	{
+		return false;
+	}
+	
+	box Bounds = GetAtlasBounds(&Compositor->DisplayAtlas);
+	Compositor->SwapChainWidth  = Bounds.Right;
+	Compositor->SwapChainHeight = Bounds.Bottom;
+	
+	DXGI_SWAP_CHAIN_DESC1 SwapChainDesc;
+	SwapChainDesc.Width        = Compositor->SwapChainWidth;
+	SwapChainDesc.Height       = Compositor->SwapChainHeight;
+	SwapChainDesc.Format       = DXGI_FORMAT_B8G8R8A8_UNORM;
+	SwapChainDesc.Stereo       = false;
+	SwapChainDesc.SampleDesc   = DXGI_SAMPLE_DESC{ 1, 0 };
+	SwapChainDesc.BufferUsage  = DXGI_USAGE_RENDER_TARGET_OUTPUT;
+	SwapChainDesc.BufferCount  = SWAP_CHAIN_BUFFER_COUNT;
+	SwapChainDesc.Scaling      = DXGI_SCALING_STRETCH;
+	SwapChainDesc.SwapEffect   = DXGI_SWAP_EFFECT_FLIP_DISCARD;
+	SwapChainDesc.AlphaMode    = DXGI_ALPHA_MODE_PREMULTIPLIED;
+	SwapChainDesc.Flags        = SWAP_CHAIN_FLAGS;
+	
+	Result = Factory->CreateSwapChainForComposition(Device, &SwapChainDesc, NULL, &Compositor->SwapChain);
+	Factory->Release();
+	if (FAILED(Result))
+	{
+		Compositor->SwapChain = NULL;
+		return false;
+	}
+	
+	// @Note One frame in flight, so we don't stack frames up behind DWM and take GPU time from the game underneath
+	IDXGISwapChain2 *SwapChain2;
+	Result = Compositor->SwapChain->QueryInterface(__uuidof(IDXGISwapChain2), (void **)&SwapChain2);
+	if (SUCCEEDED(Result))
+	{
+		Result = SwapChain2->SetMaximumFrameLatency(1);
+		if (SUCCEEDED(Result))
+		{
+			Compositor->FrameLatencyWaitable = SwapChain2->GetFrameLatencyWaitableObject();
+		}
+		
+		SwapChain2->Release();
+	}
+	
+	if (FAILED(Result))
+	{
+		D3D11ReleaseSwapChain(Context, Resource);
+		return false;
+	}
+	
+	return true;
+}
+
+internal DEVICE_RESOURCE_CREATE(D3D11CreateBackBufferView)
+{
+	d3d11_compositor *Compositor = (d3d11_compositor *)Context;
+	return CreateBackBufferView(Compositor);
+}
+
+internal DEVICE_RESOURCE_RELEASE(D3D11ReleaseBackBufferView)
+{
+	d3d11_compositor *Compositor = (d3d11_compositor *)Context;
+	
+	Compositor->D3D->DeviceContext->OMSetRenderTargets(0, NULL, NULL);
+	ReleaseObject(Compositor->RenderTargetView);
+}
+
+// @Note A hidden window keeps whatever offset it had, it gets a new one when it comes back
+internal void PointVisualsAtSlots(d3d11_compositor *Compositor)
+{
+	for (u32 OverlayIndex = 0; OverlayIndex < MAX_OVERLAYS; ++OverlayIndex)
+	{
+		box Slot = Compositor->DisplayAtlas.Slots[OverlayIndex];
+		IDCompositionVisual *Visual = Compositor->Visuals[OverlayIndex];
+		
+		if (!Visual || BoxIsEmpty(Slot) || BoxesAreEqual(Slot, Compositor->VisualSlots[OverlayIndex]))
+		{
+			continue;
+		}
+		
+		Visual->SetOffsetX(-(float)Slot.Left);
+		Visual->SetOffsetY(-(float)Slot.Top);
+		
+		Compositor->VisualSlots[OverlayIndex] = Slot;
+		Compositor->VisualsChanged = true;
+	}
+}
+
+internal DEVICE_RESOURCE_RELEASE(D3D11ReleaseComposition)
+{
+	d3d11_compositor *Compositor = (d3d11_compositor *)Context;
+	
+	for (u32 WindowIndex = 0; WindowIndex < MAX_OVERLAYS; ++WindowIndex)
+	{
+		ReleaseObject(Compositor->Visuals[WindowIndex]);
+		ReleaseObject(Compositor->Targets[WindowIndex]);
+		Compositor->VisualSlots[WindowIndex] = box{ 0, 0, 0, 0 };
+	}
+	
+	ReleaseObject(Compositor->CompositionDevice);
+	Compositor->VisualsChanged = false;
+}
+
+// @Note Every window shows the same swap chain, the visual offset picks out its slot and the window clips the rest.
+// A window can only have one target, the old one has to be gone before the window gets a new one.
+internal DEVICE_RESOURCE_CREATE(D3D11CreateComposition)
+{
+	d3d11_compositor *Compositor = (d3d11_compositor *)Context;
+	
+	Compositor->CompositionDevice = NULL;
+	for (u32 WindowIndex = 0; WindowIndex < MAX_OVERLAYS; ++WindowIndex)
+	{
+		Compositor->Targets[WindowIndex]     = NULL;
+		Compositor->Visuals[WindowIndex]     = NULL;
+		Compositor->VisualSlots[WindowIndex] = box{ 0, 0, 0, 0 };
+	}
+	
+	IDXGIDevice *DXGIDevice;
+	Result = Compositor->D3D->Device->QueryInterface(__uuidof(IDXGIDevice), (void **)&DXGIDevice);
+	if (FAILED(Result))
+	{
+		return false;
+	}
+	
+	Result = DCompositionCreateDevice(DXGIDevice, __uuidof(IDCompositionDevice), (void **)&Compositor->CompositionDevice);
+	DXGIDevice->Release();
+	if (FAILED(Result))
+	{
+		Compositor->CompositionDevice = NULL;
+		return false;
+	}
+	
+	for (u32 WindowIndex = 0; SUCCEEDED(Result) && (WindowIndex < Compositor->WindowCount); ++WindowIndex)
+	{
+		Result = Compositor->CompositionDevice->CreateTargetForHwnd(Compositor->Windows[WindowIndex], true, &Compositor->Targets[WindowIndex]);
+		if (SUCCEEDED(Result))
+		{
+			Result = Compositor->CompositionDevice->CreateVisual(&Compositor->Visuals[WindowIndex]);
+		}
+		
+		if (SUCCEEDED(Result))
+		{
+			Result = Compositor->Visuals[WindowIndex]->SetContent((IUnknown *)Compositor->SwapChain);
+		}
+		
+		if (SUCCEEDED(Result))
+		{
+			Result = Compositor->Targets[WindowIndex]->SetRoot(Compositor->Visuals[WindowIndex]);
+		}
+	}
+	
+	if (SUCCEEDED(Result))
+	{
+		PointVisualsAtSlots(Compositor);
+		Result = Compositor->CompositionDevice->Commit();
+	}
+	
+	if (FAILED(Result))
+	{
+		D3D11ReleaseComposition(Context, Resource);
+		return false;
+	}
+	
+	Compositor->VisualsChanged = false;
+	return true;
+}
+
+internal DEVICE_RESOURCE_RELEASE(D3D11ReleaseDisplayTexture)
+{
+	d3d11_compositor *Compositor = (d3d11_compositor *)Context;
+	
+	ReleaseTexturePool(&Compositor->TexturePool);
+	Compositor->DisplayTexture       = NULL;
+	Compositor->DisplayTextureView   = NULL;
+	Compositor->DisplayTextureTarget = NULL;
+	Compositor->TextureWidth         = 0;
+	Compositor->TextureHeight        = 0;
+}
+
+// @Note The size of the crop atlas as it is now, nothing before the first layout. What was cropped into it is gone,
+// the pipeline crops everything again after a present that didn't happen.
+internal DEVICE_RESOURCE_CREATE(D3D11CreateDisplayTexture)
+{
+	d3d11_compositor *Compositor = (d3d11_compositor *)Context;
+	atlas_packer *Packer = &Compositor->CropAtlas.Packer;
+	
+	Compositor->DisplayTexture       = NULL;
+	Compositor->DisplayTextureView   = NULL;
+	Compositor->DisplayTextureTarget = NULL;
+	Compositor->TextureWidth         = 0;
+	Compositor->TextureHeight        = 0;
+	Compositor->MipsAreStale         = true;
+	
+	if ((Packer->Width > 0) && (Packer->Height > 0))
+	{
+		return ResizeDisplayTexture(Compositor, Packer->Width, Packer->Height);
+	}
+	
+	return true;
+}
+
+// @Note What the shade counts on staying bound, and what it only binds when it changes
+internal DEVICE_RESOURCE_CREATE(D3D11CreateBindings)
+{
+	d3d11_compositor *Compositor = (d3d11_compositor *)Context;
+	ID3D11DeviceContext *DeviceContext = Compositor->D3D->DeviceContext;
+	
+	DeviceContext->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
+	DeviceContext->VSSetShader(Compositor->VertexShader, NULL, 0);
+	DeviceContext->VSSetConstantBuffers(0, 1, &Compositor->ConstantBuffer);
+	DeviceContext->PSSetConstantBuffers(1, 1, &Compositor->EffectBuffer);
+	DeviceContext->PSSetShaderResources(0, 1, &Compositor->DisplayTextureView);
+	
+	Compositor->BoundScale      = ScaleMode_Count;
+	Compositor->BoundEffectKey  = EffectKey_Count;
+	Compositor->EffectsAreStale = true;
+	Compositor->InstanceCount   = 0;
+	Compositor->ViewportWidth   = 0;
+	Compositor->ViewportHeight  = 0;
+	
+	return true;
+}
+
+// @Note Made by the first export after the rebuild, at the size the display texture is then
+internal DEVICE_RESOURCE_CREATE(D3D11CreateExportStaging)
+{
+	d3d11_compositor *Compositor = (d3d11_compositor *)Context;
+	
+	for (u32 StagingIndex = 0; StagingIndex < EXPORT_STAGING_COUNT; ++StagingIndex)
+	{
+		export_staging *Staging = &Compositor->ExportStaging[StagingIndex];
+		Staging->Texture = NULL;
+		Staging->Width   = 0;
+		Staging->Height  = 0;
+	}
+	
+	Compositor->ExportWriteCount = 0;
+	Compositor->ExportReadCount  = 0;
+	return true;
+}
+
+// @Note Copies still in flight are dropped, the readers just see the sequence skip them
+internal DEVICE_RESOURCE_RELEASE(D3D11ReleaseExportStaging)
+{
+	d3d11_compositor *Compositor = (d3d11_compositor *)Context;
+	
+	for (u32 StagingIndex = 0; StagingIndex < EXPORT_STAGING_COUNT; ++StagingIndex)
+	{
+		ReleaseObject(Compositor->ExportStaging[StagingIndex].Texture);
+	}
+	
+	Compositor->ExportWriteCount = 0;
+	Compositor->ExportReadCount  = 0;
+}
+
+// @Note Made by the first crop read back after the rebuild. The display texture it was read from is gone too.
+internal DEVICE_RESOURCE_CREATE(D3D11CreateChangeStaging)
+{
+	d3d11_compositor *Compositor = (d3d11_compositor *)Context;
+	
+	Compositor->ChangeStaging       = NULL;
+	Compositor->ChangeStagingWidth  = 0;
+	Compositor->ChangeStagingHeight = 0;
+	
+	if (Compositor->Changes->Hashes)
+	{
+		ForgetTileHashes(Compositor->Changes);
+	}
+	
+	return true;
+}
+
+internal DEVICE_RESOURCE_RELEASE(D3D11ReleaseChangeStaging)
+{
+	d3d11_compositor *Compositor = (d3d11_compositor *)Context;
+	
+	ReleaseObject(Compositor->ChangeStaging);
+	Compositor->ChangeStagingWidth  = 0;
+	Compositor->ChangeStagingHeight = 0;
+}
+
+// @Note Made by the first recorded frame after the rebuild, like the export's
+internal DEVICE_RESOURCE_CREATE(D3D11CreateRecordStaging)
+{
+	d3d11_compositor *Compositor = (d3d11_compositor *)Context;
+	
+	for (u32 StagingIndex = 0; StagingIndex < RECORD_STAGING_COUNT; ++StagingIndex)
+	{
+		record_staging *Staging = &Compositor->RecordStaging[StagingIndex];
+		Staging->Texture = NULL;
+		Staging->Width   = 0;
+		Staging->Height  = 0;
+	}
+	
+	Compositor->RecordWriteCount = 0;
+	Compositor->RecordReadCount  = 0;
+	return true;
+}
+
+// @Note The frames in flight are lost with the device, the recording goes on from the next one
+internal DEVICE_RESOURCE_RELEASE(D3D11ReleaseRecordStaging)
+{
+	d3d11_compositor *Compositor = (d3d11_compositor *)Context;
+	
+	for (u32 StagingIndex = 0; StagingIndex < RECORD_STAGING_COUNT; ++StagingIndex)
+	{
+		ReleaseObject(Compositor->RecordStaging[StagingIndex].Texture);
+	}
+	
+	Compositor->RecordWriteCount = 0;
+	Compositor->RecordReadCount  = 0;
+}
+
+internal DEVICE_RESOURCE_CREATE(D3D11CreateGpuTimers)
+{
+	d3d11_compositor *Compositor = (d3d11_compositor *)Context;
+	return CreateGpuTimers(Compositor);
+}
+
+internal DEVICE_RESOURCE_RELEASE(D3D11ReleaseGpuTimers)
+{
+	d3d11_compositor *Compositor = (d3d11_compositor *)Context;
+	ReleaseGpuTimers(Compositor);
+}
+
+//
+// After DXGI_ERROR_DEVICE_REMOVED or _RESET: everything the compositor made goes and is made again on a new device.
+// The output workers see the device generation change and duplicate again on the new device, see DuplicationAcquire.
+//
+internal bool RecoverD3D11Device(d3d11_compositor *Compositor)
+{
+	d3d11_device *D3D = Compositor->D3D;
+	device_registry *Registry = &Compositor->Registry;
+	
+	AcquireSRWLockExclusive(&D3D->Lock);
+	bool Recovered = RebuildDeviceResources(Registry);
+	ReleaseSRWLockExclusive(&D3D->Lock);
+	
+	Compositor->DeviceIsLost     = !Recovered;
+	Compositor->DeviceWasRebuilt = Recovered;
+	if (Recovered)
+	{
+		// @Note Shows up in the debugger output, like the memory report
+		char Report[256];
+		wsprintfA(Report, "Overlay device recovered in %u us, %u resources made again, %u recoveries, %u attempts that failed, slowest %u us\n",
+				  (u32)(Registry->LastRecoveryTime / 1000), Registry->ResourceCount, Registry->RebuildCount, Registry->FailedRebuildCount,
+				  (u32)(Registry->MaxRecoveryTime / 1000));
+		OutputDebugStringA(Report);
+		
+		UpdateD3D11Memory(Compositor);
+	}
+	
+	return Recovered;
+}
+
+// @Note A rebuild that didn't go through is tried again by the next call, every frame makes a few
+inline bool D3D11DeviceIsReady(d3d11_compositor *Compositor)
+{
+	return !Compositor->DeviceIsLost || RecoverD3D11Device(Compositor);
+}
+
+// @Note Every permutation the compositor draws with, see LoadShader. Needs no device.
+internal void LoadD3D11Shaders(d3d11_shader_code *Code, d3d11_shader_loader *Loader)
+{
+	char *ShaderSource = 
+	R"RAW(
+					struct Instance
+					{
+						float4 Destination; // Display slot in clip space, left top right bottom
+						float4 UVClamp;     // Crop slot in the atlas, half a texel in from the edges
+						float2 UVOrigin;
+						float2 UVAxisX;
+						float2 UVAxisY;
+						float  Decode;      // 1 for the desktop itself, its view isn't sRGB
+						float  Pad;
+					};
+					
+					cbuffer CBuffer : register(b0) { Instance Instances[MAX_INSTANCES]; };
+					
+					// Same as effect_constants, the colours are in linear light
+					cbuffer Effects : register(b1)
+					{
+						float  Alpha;
+						float  Darken;
+						float  Contrast;
+						float  EdgeStrength;
+						float4 EdgeColour;
+						float3 KeyColour;
+						float  KeyTolerance;
+					};
+					
+					struct VSOutput
+					{
+						float4 pos : SV_POSITION;
+						float2 tex : TEXCOORD0;
+						nointerpolation float4 clamp  : TEXCOORD1;
+						nointerpolation float  decode : TEXCOORD2;
+					};
+					
+					// Two triangles per piece, corner bit 0 is right and bit 1 is bottom
+					static const uint Corners[6] = { 0, 1, 2, 2, 1, 3 };
+					
+					VSOutput VertexMain(uint ID : SV_VERTEXID, uint InstanceID : SV_INSTANCEID)
+					{
+						Instance Overlay = Instances[InstanceID];
+						uint Corner = Corners[ID];
+						
+						// Display position, 0..1 from the top-left
+						float2 Display;
+						Display.x = (float)(Corner & 1);
+						Display.y = (float)(Corner >> 1);
+						
+						VSOutput Output;
+						Output.pos.xy = lerp(Overlay.Destination.xy, Overlay.Destination.zw, Display);
+						Output.pos.z  = 0.0f;
+						Output.pos.w  = 1.0f;
+						
+						// Turn the crop upright, it is in the output's native orientation
+						Output.tex.xy = Overlay.UVOrigin + Display.x * Overlay.UVAxisX + Display.y * Overlay.UVAxisY;
+						Output.clamp  = Overlay.UVClamp;
+						Output.decode = Overlay.Decode;
+						
+						return Output;
+					}
+					
+					SamplerState Sampler;
+					Texture2D    Texture;
+					
+					// Exact, same curve as SRGBToLinear in overlay_colour.cpp
+					float3 SRGBToLinear(float3 Encoded)
+					{
+						float3 Low  = Encoded / 12.92f;
+						float3 High = pow((Encoded + 0.055f) / 1.055f, 2.4f);
+						return (Encoded <= 0.04045f) ? Low : High;
+					}
+					
+					// Same order as scale_mode, SCALE_MODE picks the permutation
+					#define SCALE_BILINEAR 0
+					#define SCALE_NEAREST  1
+					#define SCALE_MIP      2
+					#define SCALE_BICUBIC  3
+					#define SCALE_LANCZOS  4
+					
+					#if (SCALE_MODE == SCALE_BICUBIC) || (SCALE_MODE == SCALE_LANCZOS)
+					
+					// Same weights as FilterWeight in overlay_scale.cpp
+					#if SCALE_MODE == SCALE_BICUBIC
+					#define FILTER_RADIUS 2.0f
+					float FilterWeight(float X)
+					{
+						X = abs(X);
+						if (X < 1.0f) return (1.5f * X - 2.5f) * X * X + 1.0f;
+						if (X < 2.0f) return ((-0.5f * X + 2.5f) * X - 4.0f) * X + 2.0f;
+						return 0.0f;
+					}
+					#else
+					#define FILTER_RADIUS 3.0f
+					float FilterWeight(float X)
+					{
+						X = abs(X);
+						if (X < 1e-6f) return 1.0f;
+						if (X >= 3.0f) return 0.0f;
+						float PiX = 3.14159265f * X;
+						return 3.0f * sin(PiX) * sin(PiX / 3.0f) / (PiX * PiX);
+					}
+					#endif
+					
+					// Every tap of the separable weights, widened when the piece shrinks and kept inside the crop slot
+					float4 SampleFiltered(float2 UV, float4 Clamp, float Decode)
+					{
+						float2 Size;
+						Texture.GetDimensions(Size.x, Size.y);
+						
+						// Texels a pixel covers along each texture axis, the pieces only ever turn by quarters
+						float2 Footprint = max(abs(ddx(UV)), abs(ddy(UV))) * Size;
+						float2 Scale   = clamp(Footprint, 1.0f, (FILTER_MAX_TAPS - 1) / (2.0f * FILTER_RADIUS));
+						float2 Support = FILTER_RADIUS * Scale;
+						float2 Center  = UV * Size - 0.5f;
+						
+						int2 Low   = (int2)ceil(Center - Support);
+						int2 High  = (int2)floor(Center + Support);
+						int2 First = (int2)round(Clamp.xy * Size - 0.5f);
+						int2 Last  = (int2)round(Clamp.zw * Size - 0.5f);
+						
+						float4 Sum = 0.0f;
+						float WeightSum = 0.0f;
+						[loop] for (int Y = Low.y; Y <= High.y; ++Y)
+						{
+							float WeightY = FilterWeight(((float)Y - Center.y) / Scale.y);
+							int TexelY = clamp(Y, First.y, Last.y);
+							[loop] for (int X = Low.x; X <= High.x; ++X)
+							{
+								float Weight = WeightY * FilterWeight(((float)X - Center.x) / Scale.x);
+								float4 Texel = Texture.Load(int3(clamp(X, First.x, Last.x), TexelY, 0));
+								if (Decode) Texel.rgb = SRGBToLinear(Texel.rgb);
+								
+								Sum += Weight * Texel;
+								WeightSum += Weight;
+							}
+						}
+						
+						return Sum / WeightSum;
+					}
+					
+					#endif
+					
+					// Exact, same curve as LinearToSRGB in overlay_colour.cpp
+					float3 LinearToSRGB(float3 Linear)
+					{
+						float3 Low  = Linear * 12.92f;
+						float3 High = 1.055f * pow(Linear, 1.0f / 2.4f) - 0.055f;
+						return (Linear <= 0.0031308f) ? Low : High;
+					}
+					
+					#if EFFECT_KEY
+					
+					// Same bits as effect_flag, EFFECT_KEY picks the permutation. Only ever with SCALE_BILINEAR.
+					#define EFFECT_COLOUR_KEY 0x1
+					#define EFFECT_GRAYSCALE  0x2
+					#define EFFECT_CONTRAST   0x4
+					#define EFFECT_EDGES      0x8
+					
+					// BT.709, same as EffectLuma in overlay_effects.cpp
+					static const float3 Luma = float3(0.2126f, 0.7152f, 0.0722f);
+					
+					float3 LoadLinear(int2 Texel, float Decode)
+					{
+						float3 Colour = Texture.Load(int3(Texel, 0)).rgb;
+						return Decode ? SRGBToLinear(Colour) : Colour;
+					}
+					
+					// The stages in the same order as ShadeRowEffectsScalar, returns 0 for a keyed out pixel
+					float ApplyEffects(inout float3 Colour, float2 UV, float4 Clamp, float Decode)
+					{
+						float Keep = 1.0f;
+						
+						#if EFFECT_KEY & EFFECT_COLOUR_KEY
+						float3 Distance = abs(Colour - KeyColour);
+						Keep = ((Distance.r + Distance.g + Distance.b) < KeyTolerance) ? 0.0f : 1.0f;
+						#endif
+						
+						#if EFFECT_KEY & EFFECT_GRAYSCALE
+						Colour = dot(Colour, Luma);
+						#endif
+						
+						#if EFFECT_KEY & EFFECT_CONTRAST
+						Colour = CONTRAST_PIVOT + (Colour - CONTRAST_PIVOT) * Contrast;
+						#endif
+						
+						#if EFFECT_KEY & EFFECT_EDGES
+						// The four texels the bilinear sample came from, kept inside the crop slot the same way
+						float2 Size;
+						Texture.GetDimensions(Size.x, Size.y);
+						
+						int2 Last = (int2)round(Clamp.zw * Size - 0.5f);
+						int2 Low  = (int2)floor(clamp(UV, Clamp.xy, Clamp.zw) * Size - 0.5f);
+						int2 High = min(Low + 1, Last);
+						
+						float L00 = dot(LoadLinear(int2(Low.x,  Low.y),  Decode), Luma);
+						float L10 = dot(LoadLinear(int2(High.x, Low.y),  Decode), Luma);
+						float L01 = dot(LoadLinear(int2(Low.x,  High.y), Decode), Luma);
+						float L11 = dot(LoadLinear(int2(High.x, High.y), Decode), Luma);
+						
+						float GradientX = (L10 - L00) + (L11 - L01);
+						float GradientY = (L01 - L00) + (L11 - L10);
+						Colour += EdgeColour.rgb * ((abs(GradientX) + abs(GradientY)) * EdgeStrength);
+						#endif
+						
+						return Keep;
+					}
+					
+					#endif
+					
+					float4 PixelMain(VSOutput Input) : SV_TARGET
+					{
+						#if (SCALE_MODE == SCALE_BICUBIC) || (SCALE_MODE == SCALE_LANCZOS)
+						float4 Output = SampleFiltered(Input.tex.xy, Input.clamp, Input.decode);
+						#else
+						// @Note The neighbouring slots in the atlas would bleed in through the filter otherwise
+						float4 Output = Texture.Sample(Sampler, clamp(Input.tex.xy, Input.clamp.xy, Input.clamp.zw));
+						
+						// @Note Straight from the desktop bilinear blends the encoded values, close enough at near 1:1
+						if (Input.decode) Output.rgb = SRGBToLinear(Output.rgb);
+						#endif
+						
+						#if EFFECT_KEY
+						float Keep = ApplyEffects(Output.rgb, Input.tex.xy, Input.clamp, Input.decode);
+						#else
+						float Keep = 1.0f;
+						#endif
+						
+						// The view is sRGB so this is linear light. Darkened there, then encoded and premultiplied
+						// since DWM blends in gamma space, same as ShadeChannel in overlay_shade.cpp.
+						Output.rgb = LinearToSRGB(saturate(Output.rgb - Darken)) * (Alpha * Keep);
+						Output.a   = Alpha * Keep;
+						
+						return Output;
+					}
+				)RAW";
+	
+	size_t ShaderSize;
+	ShaderSource = LoadShaderSource(Loader, Loader->ShadeSourcePath, ShaderSource, &ShaderSize);
+	Code->ShadeSource     = ShaderSource;
+	Code->ShadeSourceSize = ShaderSize;
+	
+	D3D_SHADER_MACRO Defines[] =
+	{
+		{ "MAX_INSTANCES",   STRINGIFY(MAX_CROP_PIECES) },
+		{ "FILTER_MAX_TAPS", STRINGIFY(D3D11_FILTER_MAX_TAPS) },
+		{ "SCALE_MODE",      "0" },
+		{ "EFFECT_KEY",      "0" },
+		{ "CONTRAST_PIVOT",  STRINGIFY(EFFECT_CONTRAST_PIVOT) },
+		{ NULL, NULL },
+	};
+	
+	Code->Vertex = LoadShader(Loader, ShaderSource, ShaderSize, "VertexMain", Defines);
+	
+	// @Note One permutation per scaling mode, bound by the first shade
+	char *ScaleModeDefinitions[ScaleMode_Count] = { "0", "1", "2", "3", "4" };
+	for (int Mode = 0; Mode < ScaleMode_Count; ++Mode)
+	{
+		Defines[2].Definition = ScaleModeDefinitions[Mode];
+		Code->Pixel[Mode] = LoadShader(Loader, ShaderSource, ShaderSize, "PixelMain", Defines);
+	}
+	
+	//
+	// HDR conversion
+	//
+	
+	// @Note Draws the regions of an HDR crop into the display texture through its sRGB target view, see ConvertCrop.
+	// The pixels land one to one, Load reads the desktop texel under each one.
+	char *ConvertSource =
+	R"RAW(
+					cbuffer CBuffer
+					{
+						float4 Regions[MAX_REGIONS]; // Surface pixels, left top right bottom
+						float4 Target;               // xy from a surface pixel to its display texel, zw texels to clip space
+						float4 Convert;              // x puts SDR white on 1.0
+						float4 Mix[3];               // BT.2020 to BT.709
+					};
+					
+					struct VSOutput { float4 pos : SV_POSITION; };
+					
+					static const uint Corners[6] = { 0, 1, 2, 2, 1, 3 };
+					
+					VSOutput VertexMain(uint ID : SV_VERTEXID, uint InstanceID : SV_INSTANCEID)
+					{
+						float4 Region = Regions[InstanceID];
+						uint Corner = Corners[ID];
+						
+						float2 Texel;
+						Texel.x = (Corner & 1)  ? Region.z : Region.x;
+						Texel.y = (Corner >> 1) ? Region.w : Region.y;
+						Texel  += Target.xy;
+						
+						VSOutput Output;
+						Output.pos = float4(Texel.x * Target.z - 1.0f, 1.0f - Texel.y * Target.w, 0.0f, 1.0f);
+						
+						return Output;
+					}
+					
+					Texture2D Desktop;
+					
+					// Same order as surface_format, COLOUR_SOURCE picks the permutation
+					#define COLOUR_SCRGB 1
+					#define COLOUR_PQ    2
+					
+					float4 PixelMain(VSOutput Input) : SV_TARGET
+					{
+						float3 Colour = Desktop.Load(int3((int2)(Input.pos.xy - Target.xy), 0)).rgb;
+						
+						#if COLOUR_SOURCE == COLOUR_PQ
+						// Same as PQToLinear, then into BT.709 primaries
+						float3 Power = pow(saturate(Colour), 1.0f / PQ_M2);
+						Colour = pow(max(Power - PQ_C1, 0.0f) / (PQ_C2 - PQ_C3 * Power), 1.0f / PQ_M1) * Convert.x;
+						Colour = float3(dot(Mix[0].xyz, Colour), dot(Mix[1].xyz, Colour), dot(Mix[2].xyz, Colour));
+						#else
+						Colour *= Convert.x;
+						#endif
+						
+						// Same as ToneMapPixel, the hue stays and the brightest channel rolls off past the knee
+						Colour = max(Colour, 0.0f);
+						float Peak = max(max(Colour.r, Colour.g), Colour.b);
+						if (Peak > TONE_MAP_KNEE)
+						{
+							float Over = (Peak - TONE_MAP_KNEE) / (1.0f - TONE_MAP_KNEE);
+							Colour *= (TONE_MAP_KNEE + (1.0f - TONE_MAP_KNEE) * (Over / (1.0f + Over))) / Peak;
+						}
+						
+						// The target view is sRGB, the encode is done on the write
+						return float4(min(Colour, 1.0f), 1.0f);
+					}
+				)RAW";
+	
+	size_t ConvertSize;
+	ConvertSource = LoadShaderSource(Loader, Loader->ConvertSourcePath, ConvertSource, &ConvertSize);
+	
+	D3D_SHADER_MACRO ConvertDefines[] =
+	{
+		{ "MAX_REGIONS",   STRINGIFY(CONVERT_MAX_REGIONS) },
+		{ "TONE_MAP_KNEE", STRINGIFY(TONE_MAP_KNEE) },
+		{ "PQ_M1",         STRINGIFY(PQ_M1) },
+		{ "PQ_M2",         STRINGIFY(PQ_M2) },
+		{ "PQ_C1",         STRINGIFY(PQ_C1) },
+		{ "PQ_C2",         STRINGIFY(PQ_C2) },
+		{ "PQ_C3",         STRINGIFY(PQ_C3) },
+		{ "COLOUR_SOURCE", "1" },
+		{ NULL, NULL },
+	};
+	
+	Code->ConvertVertex = LoadShader(Loader, ConvertSource, ConvertSize, "VertexMain", ConvertDefines);
+	
+	char *ColourSourceDefinitions[SurfaceFormat_Count] = { NULL, "1", "2" };
+	Code->ConvertPixel[SurfaceFormat_BGRA8] = shader_blob{ NULL, 0 };
+	for (int Format = SurfaceFormat_RGBA16F; Format < SurfaceFormat_Count; ++Format)
+	{
+		ConvertDefines[7].Definition = ColourSourceDefinitions[Format];
+		Code->ConvertPixel[Format] = LoadShader(Loader, ConvertSource, ConvertSize, "PixelMain", ConvertDefines);
+	}
+	
+	for (u32 Key = 0; Key < EffectKey_Count; ++Key)
+	{
+		Code->EffectPixel[Key] = shader_blob{ NULL, 0 };
+	}
+}
+
+// @Note The bilinear PixelMain with the chain for Key. Left out of LoadD3D11Shaders so only the chains that are used
+// get compiled, each is cached by its defines like any other permutation. Needs no device.
+internal shader_blob LoadD3D11EffectShader(d3d11_shader_code *Code, d3d11_shader_loader *Loader, u32 Key)
+{
+	Key &= EffectKey_Count - 1;
+	if (Key && !Code->EffectPixel[Key].Data)
+	{
+		char *KeyDefinitions[EffectKey_Count] =
+		{
+			"0", "1", "2", "3", "4", "5", "6", "7", "8", "9", "10", "11", "12", "13", "14", "15",
+		};
+		
+		D3D_SHADER_MACRO Defines[] =
+		{
+			{ "MAX_INSTANCES",   STRINGIFY(MAX_CROP_PIECES) },
+			{ "FILTER_MAX_TAPS", STRINGIFY(D3D11_FILTER_MAX_TAPS) },
+			{ "SCALE_MODE",      "0" },
+			{ "EFFECT_KEY",      KeyDefinitions[Key] },
+			{ "CONTRAST_PIVOT",  STRINGIFY(EFFECT_CONTRAST_PIVOT) },
+			{ NULL, NULL },
+		};
+		
+		Code->EffectPixel[Key] = LoadShader(Loader, Code->ShadeSource, Code->ShadeSourceSize, "PixelMain", Defines);
+	}
+	
+	return Code->EffectPixel[Key];
+}
+
+// @Note Made on the current device the first time a shade draws with Key, NULL if its bytecode can't be had
+internal ID3D11PixelShader *D3D11GetEffectShader(d3d11_compositor *Compositor, u32 Key)
+{
+	if (!Compositor->EffectShaders[Key])
+	{
+		shader_blob Code = LoadD3D11EffectShader(&Compositor->ShaderCode, Compositor->Loader, Key);
+		if (Code.Data)
+		{
+			Result = Compositor->D3D->Device->CreatePixelShader(Code.Data, Code.Size, NULL, &Compositor->EffectShaders[Key]);
+			if (FAILED(Result))
+			{
+				Compositor->EffectShaders[Key] = NULL;
+			}
+		}
+	}
+	
+	return Compositor->EffectShaders[Key];
+}
+
+// @Note One window per overlay slot, all of them created up front and shown or hidden by the window thread.
+// Makes the device too, everything made from it goes through the registry so it can all be made again.
+internal void InitializeD3D11Compositor(d3d11_compositor *Compositor, d3d11_device *D3D, HWND *Windows, u32 WindowCount,
+									   d3d11_shader_loader *Loader, platform_get_nanoseconds *GetNanoseconds)
+{
+	Compositor->D3D = D3D;
+	D3D->Device            = NULL;
+	D3D->DeviceContext     = NULL;
+	D3D->Generation        = 0;
+	D3D->WorkersUseContext = (CAPTURE_RING != 0);
+	InitializeSRWLock(&D3D->Lock);
+	
+	//
+	// Shaders
+	//
+	
+	d3d11_shader_code *Code = &Compositor->ShaderCode;
+	Compositor->Loader = Loader;
+	LoadD3D11Shaders(Code, Loader);
+	
+	// @Note Shows up in the debugger output, like the memory report
+	char Report[256];
+	wsprintfA(Report, "Overlay shaders: %u embedded, %u from the cache, %u compiled in %u us\n", Loader->EmbeddedCount,
+			  Loader->CachedCount, Loader->CompiledCount, (u32)(Loader->CompileTime / 1000));
+	OutputDebugStringA(Report);
+	
+	//
+	// Texture Sampler
+	//
+	
+	// @Note Every mode but mip stays on level 0, bicubic and Lanczos load their texels and never sample
+	D3D11_FILTER ScaleFilters[ScaleMode_Count] =
+	{
+		D3D11_FILTER_MIN_MAG_LINEAR_MIP_POINT,
+		D3D11_FILTER_MIN_MAG_MIP_POINT,
+		D3D11_FILTER_MIN_MAG_MIP_LINEAR,
+		D3D11_FILTER_MIN_MAG_MIP_POINT,
+		D3D11_FILTER_MIN_MAG_MIP_POINT,
+	};
+	
+	for (int Mode = 0; Mode < ScaleMode_Count; ++Mode)
+	{
+		D3D11_SAMPLER_DESC *SamplerDesc = &Compositor->SamplerDescs[Mode];
+		SamplerDesc->Filter         = ScaleFilters[Mode];
+		SamplerDesc->AddressU       = D3D11_TEXTURE_ADDRESS_CLAMP; // The texture is exactly the crop, wrapping would bleed the opposite edge in
+		SamplerDesc->AddressV       = D3D11_TEXTURE_ADDRESS_CLAMP;
+		SamplerDesc->AddressW       = D3D11_TEXTURE_ADDRESS_CLAMP;
+		SamplerDesc->MipLODBias     = 0.0f;
+		SamplerDesc->MaxAnisotropy  = 0; // Texture Anisotropic Filtering (TAF)
+		SamplerDesc->ComparisonFunc = D3D11_COMPARISON_NEVER;
+		SamplerDesc->BorderColor[0] = 0.0f;
+		SamplerDesc->BorderColor[1] = 0.0f;
+		SamplerDesc->BorderColor[2] = 0.0f;
+		SamplerDesc->BorderColor[3] = 0.0f;
+		SamplerDesc->MinLOD         = -D3D11_FLOAT32_MAX;
+		SamplerDesc->MaxLOD         = (Mode == ScaleMode_Mip) ? D3D11_FLOAT32_MAX : 0.0f;
+	}
+	
+	//
+	// Atlases
+	//
+	
+	// @Note The display texture is made by the first layout, once we know how big the cut boxes are,
+	// and the swap chain resized to the display atlas
+	InitializeAtlasLayout(&Compositor->CropAtlas, D3D11_ATLAS_MAX_SIZE);
+	InitializeAtlasLayout(&Compositor->DisplayAtlas, D3D11_ATLAS_MAX_SIZE);
+	InitializeTexturePool(&Compositor->TexturePool, Compositor, D3D11CreateTexture, D3D11DestroyTexture, 4, true);
+	
+	Assert(WindowCount <= MAX_OVERLAYS);
+	for (u32 WindowIndex = 0; WindowIndex < WindowCount; ++WindowIndex)
+	{
+		Compositor->Windows[WindowIndex] = Windows[WindowIndex];
+	}
+	Compositor->WindowCount = WindowCount;
+	
+	Compositor->ViewportWidth   = 0;
+	Compositor->ViewportHeight  = 0;
+	Compositor->LatencyRing    = NULL;
+	Compositor->ExportRing     = NULL;
+	Compositor->ExportDroppedCount = 0;
+	Compositor->Changes        = NULL;
+	Compositor->Recorder       = NULL;
+	
+	Compositor->Memory  = {};
+	Compositor->Traffic = {};
+	
+	//
+	// Everything made from the device, each after what it is made from
+	//
+	
+	device_registry *Registry = &Compositor->Registry;
+	InitializeDeviceRegistry(Registry, Compositor, GetNanoseconds);
+	Compositor->DeviceIsLost     = false;
+	Compositor->DeviceWasRebuilt = false;
+	
+	u32 Device    = GetDeviceResourceBit(D3D11Resource_Device);
+	u32 SwapChain = GetDeviceResourceBit(D3D11Resource_SwapChain);
+	u32 Bindings  = GetDeviceResourceBit(D3D11Resource_Shaders) | GetDeviceResourceBit(D3D11Resource_ConstantBuffers) |
+		GetDeviceResourceBit(D3D11Resource_DisplayTexture);
+	
+	AddDeviceResource(Registry, "Device",          D3D11OpenDevice,            D3D11CloseDevice,            NULL, 0);
+	AddDeviceResource(Registry, "Shaders",         D3D11CreateShaders,         D3D11ReleaseShaders,         Code, Device);
+	AddDeviceResource(Registry, "ConvertShaders",  D3D11CreateConvertShaders,  D3D11ReleaseConvertShaders,  Code, Device);
+	AddDeviceResource(Registry, "ConstantBuffers", D3D11CreateConstantBuffers, D3D11ReleaseConstantBuffers, NULL, Device);
+	AddDeviceResource(Registry, "Samplers",        D3D11CreateSamplers,        D3D11ReleaseSamplers,        Compositor->SamplerDescs, Device);
+	AddDeviceResource(Registry, "SampledView",     D3D11CreateSampledView,     D3D11ReleaseSampledView,     NULL, Device);
+	AddDeviceResource(Registry, "SwapChain",       D3D11CreateSwapChain,       D3D11ReleaseSwapChain,       NULL, Device);
+	AddDeviceResource(Registry, "BackBufferView",  D3D11CreateBackBufferView,  D3D11ReleaseBackBufferView,  NULL, SwapChain);
+	AddDeviceResource(Registry, "Composition",     D3D11CreateComposition,     D3D11ReleaseComposition,     NULL, Device | SwapChain);
+	AddDeviceResource(Registry, "DisplayTexture",  D3D11CreateDisplayTexture,  D3D11ReleaseDisplayTexture,  NULL, Device);
+	AddDeviceResource(Registry, "Bindings",        D3D11CreateBindings,        NULL,                        NULL, Bindings);
+	
+	if (!BuildDeviceResources(Registry))
+	{
+		Error((char *)Registry->FailedName);
+	}
+	
+	UpdateD3D11Memory(Compositor);
+}
+
+// @Note Call before the render thread starts, the GPU samples go into the render thread's ring.
+// The timers are made from nothing but the device, so they can go after everything else.
+internal void EnableD3D11GpuTiming(d3d11_compositor *Compositor, latency_ring *LatencyRing)
+{
+	Compositor->LatencyRing = LatencyRing;
+	
+	device_registry *Registry = &Compositor->Registry;
+	u32 ResourceIndex = AddDeviceResource(Registry, "GpuTimers", D3D11CreateGpuTimers, D3D11ReleaseGpuTimers, NULL,
+										  GetDeviceResourceBit(D3D11Resource_Device));
+	Assert(ResourceIndex == D3D11Resource_GpuTimers);
+	
+	if (!BuildDeviceResources(Registry))
+	{
+		Error((char *)Registry->FailedName);
+	}
+}
+
+// @Note Call before the render thread starts, like the GPU timing. The staging textures are made from nothing but the device.
+// With a converter the frames go into the ring as YUV, converted on the render thread from the mapped copy.
+internal void EnableD3D11FrameExport(d3d11_compositor *Compositor, export_ring *ExportRing, yuv_converter *Converter)
+{
+	Compositor->ExportRing      = ExportRing;
+	Compositor->ExportConverter = Converter;
+	
+	device_registry *Registry = &Compositor->Registry;
+	AddDeviceResource(Registry, "ExportStaging", D3D11CreateExportStaging, D3D11ReleaseExportStaging, NULL,
+					  GetDeviceResourceBit(D3D11Resource_Device));
+	
+	if (!BuildDeviceResources(Registry))
+	{
+		Error((char *)Registry->FailedName);
+	}
+}
+
+// @Note Writes the oldest copies the GPU is done with into the ring, in order, and stops at the first that isn't done
+internal void DrainExportStaging(d3d11_compositor *Compositor)
+{
+	ID3D11DeviceContext *DeviceContext = Compositor->D3D->DeviceContext;
+	
+	while (Compositor->ExportReadCount != Compositor->ExportWriteCount)
+	{
+		export_staging *Staging = &Compositor->ExportStaging[Compositor->ExportReadCount % EXPORT_STAGING_COUNT];
+		
+		D3D11_MAPPED_SUBRESOURCE Mapped;
+		HRESULT MapResult = DeviceContext->Map(Staging->Texture, 0, D3D11_MAP_READ, D3D11_MAP_FLAG_DO_NOT_WAIT, &Mapped);
+		if (MapResult == DXGI_ERROR_WAS_STILL_DRAWING)
+		{
+			break;
+		}
+		
+		// @Note A map that failed otherwise is a lost device, the frame is dropped and the rebuild starts over
+		if (SUCCEEDED(MapResult))
+		{
+			bitmap Image;
+			Image.Memory = (u8 *)Mapped.pData;
+			Image.Width  = Staging->Width;
+			Image.Height = Staging->Height;
+			Image.Pitch  = (int)Mapped.RowPitch;
+			
+			yuv_converter *Converter = Compositor->ExportConverter;
+			if (Converter)
+			{
+				// @Note No tile hashes on the GPU, every crop is converted whole
+				box Regions[MAX_CROP_PIECES];
+				for (u32 PieceIndex = 0; PieceIndex < Staging->Frame.PieceCount; ++PieceIndex)
+				{
+					Regions[PieceIndex] = Staging->Frame.Pieces[PieceIndex].Slot;
+				}
+				
+				ConvertToYUV(Converter, &Image, Regions, Staging->Frame.PieceCount, NULL);
+				DeviceContext->Unmap(Staging->Texture, 0);
+				WriteExportRingYUV(Compositor->ExportRing, &Staging->Frame, &Converter->Image);
+			}
+			else
+			{
+				WriteExportRing(Compositor->ExportRing, &Staging->Frame, &Image);
+				DeviceContext->Unmap(Staging->Texture, 0);
+			}
+		}
+		
+		++Compositor->ExportReadCount;
+	}
+}
+
+// @Note A staging texture the size of the display texture's level 0, made again when that size changed.
+// False if it couldn't be made, which is a lost device, the rebuild makes them again.
+internal bool SizeStagingTexture(d3d11_compositor *Compositor, ID3D11Texture2D **Staging, int *Width, int *Height)
+{
+	if ((*Width != Compositor->TextureWidth) || (*Height != Compositor->TextureHeight))
+	{
+		ReleaseObject(*Staging);
+		*Width  = 0;
+		*Height = 0;
+		
+		// @Note Level 0 only, in the display texture's typeless family so it copies straight across
+		D3D11_TEXTURE2D_DESC StagingDesc;
+		StagingDesc.Width          = Compositor->TextureWidth;
+		StagingDesc.Height         = Compositor->TextureHeight;
+		StagingDesc.MipLevels      = 1;
+		StagingDesc.ArraySize      = 1;
+		StagingDesc.Format         = DXGI_FORMAT_B8G8R8A8_UNORM;
+		StagingDesc.SampleDesc     = DXGI_SAMPLE_DESC{ 1, 0 };
+		StagingDesc.Usage          = D3D11_USAGE_STAGING;
+		StagingDesc.BindFlags      = 0;
+		StagingDesc.CPUAccessFlags = D3D11_CPU_ACCESS_READ;
+		StagingDesc.MiscFlags      = 0;
+		
+		Result = Compositor->D3D->Device->CreateTexture2D(&StagingDesc, NULL, Staging);
+		if (FAILED(Result))
+		{
+			*Staging = NULL;
+			return false;
+		}
+		
+		*Width  = Compositor->TextureWidth;
+		*Height = Compositor->TextureHeight;
+	}
+	
+	return true;
+}
+
+internal bool CopyDisplayTexture(d3d11_compositor *Compositor, ID3D11Texture2D **Staging, int *Width, int *Height)
+{
+	if (!SizeStagingTexture(Compositor, Staging, Width, Height))
+	{
+		return false;
+	}
+	
+	D3D11_BOX Whole;
+	Whole.left   = 0;
+	Whole.top    = 0;
+	Whole.right  = *Width;
+	Whole.bottom = *Height;
+	Whole.front  = 0;
+	Whole.back   = 1;
+	
+	Compositor->D3D->DeviceContext->CopySubresourceRegion(*Staging, 0, 0, 0, 0, Compositor->DisplayTexture, 0, &Whole);
+	return true;
+}
+
+//
+// Call after every present that went through. Queues a copy of the display texture to a staging texture
+// and writes the copies that are ready into the export ring. Never waits on the GPU: with every staging
+// texture still in flight the frame isn't exported.
+//
+internal void D3D11ExportFrame(d3d11_compositor *Compositor, crop_piece *Pieces, u32 PieceCount, u64 Timestamp)
+{
+	if (!Compositor->ExportRing || Compositor->DeviceIsLost || !Compositor->DisplayTexture)
+	{
+		return;
+	}
+	
+	DrainExportStaging(Compositor);
+	if ((Compositor->ExportWriteCount - Compositor->ExportReadCount) == EXPORT_STAGING_COUNT)
+	{
+		++Compositor->ExportDroppedCount;
+		return;
+	}
+	
+	export_staging *Staging = &Compositor->ExportStaging[Compositor->ExportWriteCount % EXPORT_STAGING_COUNT];
+	if (!CopyDisplayTexture(Compositor, &Staging->Texture, &Staging->Width, &Staging->Height))
+	{
+		return;
+	}
+	
+	GetExportFrame(&Staging->Frame, Pieces, PieceCount, Compositor->CropAtlas.Slots, Timestamp);
+	
+	++Compositor->ExportWriteCount;
+}
+
+// @Note Call before the render thread starts, like the export. Kernel picks the compare and hash kernels.
+internal void EnableD3D11ChangeDetection(d3d11_compositor *Compositor, change_detector *Changes, platform_allocate_memory *AllocateMemory,
+										 platform_free_memory *FreeMemory, shade_kernel Kernel)
+{
+	Compositor->Changes = Changes;
+	InitializeChangeDetector(Changes, AllocateMemory, FreeMemory, Kernel);
+	
+	device_registry *Registry = &Compositor->Registry;
+	AddDeviceResource(Registry, "ChangeStaging", D3D11CreateChangeStaging, D3D11ReleaseChangeStaging, NULL,
+					  GetDeviceResourceBit(D3D11Resource_Device));
+	
+	if (!BuildDeviceResources(Registry))
+	{
+		Error((char *)Registry->FailedName);
+	}
+}
+
+//
+// The regions a crop just copied into the display texture, read back into the staging texture and through the change
+// detector. True if any of it changed, or if it couldn't be told.
+//
+internal bool D3D11DetectChanges(d3d11_compositor *Compositor, box Slot, box CutBox, box *Regions, u32 RegionCount)
+{
+	change_detector *Changes = Compositor->Changes;
+	
+	u64 Area = 0;
+	for (u32 RegionIndex = 0; RegionIndex < RegionCount; ++RegionIndex)
+	{
+		Area += (u64)GetBoxWidth(Regions[RegionIndex]) * (u64)GetBoxHeight(Regions[RegionIndex]);
+	}
+	
+	if (!Changes || (Area > CHANGE_READBACK_MAX_PIXELS) || !ResizeChangeDetector(Changes, Compositor->TextureWidth, Compositor->TextureHeight) ||
+		!SizeStagingTexture(Compositor, &Compositor->ChangeStaging, &Compositor->ChangeStagingWidth, &Compositor->ChangeStagingHeight))
+	{
+		return true;
+	}
+	
+	ID3D11DeviceContext *DeviceContext = Compositor->D3D->DeviceContext;
+	
+	// @Note A crop has at most MAX_CROP_REGIONS, see crop_damage
+	box Copied[MAX_CROP_REGIONS];
+	for (u32 RegionIndex = 0; RegionIndex < RegionCount; ++RegionIndex)
+	{
+		box Region = Regions[RegionIndex];
+		
+		box *Box = &Copied[RegionIndex];
+		Box->Left   = Slot.Left + (Region.Left - CutBox.Left);
+		Box->Top    = Slot.Top  + (Region.Top  - CutBox.Top);
+		Box->Right  = Box->Left + GetBoxWidth(Region);
+		Box->Bottom = Box->Top  + GetBoxHeight(Region);
+		
+		D3D11_BOX RegionBox;
+		RegionBox.left   = Box->Left;
+		RegionBox.top    = Box->Top;
+		RegionBox.right  = Box->Right;
+		RegionBox.bottom = Box->Bottom;
+		RegionBox.front  = 0;
+		RegionBox.back   = 1;
+		
+		DeviceContext->CopySubresourceRegion(Compositor->ChangeStaging, 0, Box->Left, Box->Top, 0, Compositor->DisplayTexture, 0, &RegionBox);
+	}
+	
+	// @Note Waits for the copies, a failure is a lost device and the rebuild crops everything again anyway
+	D3D11_MAPPED_SUBRESOURCE Mapped;
+	Result = DeviceContext->Map(Compositor->ChangeStaging, 0, D3D11_MAP_READ, 0, &Mapped);
+	if (FAILED(Result))
+	{
+		return true;
+	}
+	
+	bitmap Image;
+	Image.Memory = (u8 *)Mapped.pData;
+	Image.Width  = Compositor->ChangeStagingWidth;
+	Image.Height = Compositor->ChangeStagingHeight;
+	Image.Pitch  = (int)Mapped.RowPitch;
+	
+	u32 ChangedCount = 0;
+	for (u32 RegionIndex = 0; RegionIndex < RegionCount; ++RegionIndex)
+	{
+		ChangedCount += DetectChanges(Changes, &Image, Copied[RegionIndex]);
+	}
+	
+	DeviceContext->Unmap(Compositor->ChangeStaging, 0);
+	
+	return ChangedCount > 0;
+}
+
+// @Note Call before the render thread starts, like the export. The file already has its header.
+internal void EnableD3D11Recording(d3d11_compositor *Compositor, recording_writer *Recorder, HANDLE RecordFile)
+{
+	Compositor->Recorder   = Recorder;
+	Compositor->RecordFile = RecordFile;
+	
+	device_registry *Registry = &Compositor->Registry;
+	AddDeviceResource(Registry, "RecordStaging", D3D11CreateRecordStaging, D3D11ReleaseRecordStaging, NULL,
+					  GetDeviceResourceBit(D3D11Resource_Device));
+	
+	if (!BuildDeviceResources(Registry))
+	{
+		Error((char *)Registry->FailedName);
+	}
+}
+
+// @Note Encodes the oldest copies into the file, in order. Without Wait it stops at the first the GPU isn't done with.
+internal void DrainRecordStaging(d3d11_compositor *Compositor, bool Wait)
+{
+	ID3D11DeviceContext *DeviceContext = Compositor->D3D->DeviceContext;
+	
+	while (Compositor->RecordReadCount != Compositor->RecordWriteCount)
+	{
+		record_staging *Staging = &Compositor->RecordStaging[Compositor->RecordReadCount % RECORD_STAGING_COUNT];
+		
+		D3D11_MAPPED_SUBRESOURCE Mapped;
+		HRESULT MapResult = DeviceContext->Map(Staging->Texture, 0, D3D11_MAP_READ, Wait ? 0 : D3D11_MAP_FLAG_DO_NOT_WAIT, &Mapped);
+		if (MapResult == DXGI_ERROR_WAS_STILL_DRAWING)
+		{
+			break;
+		}
+		
+		// @Note A lost device loses the frame, the writer keyframes on the size change if the rebuild brings one
+		if (SUCCEEDED(MapResult))
+		{
+			bitmap Image;
+			Image.Memory = (u8 *)Mapped.pData;
+			Image.Width  = Staging->Width;
+			Image.Height = Staging->Height;
+			Image.Pitch  = (int)Mapped.RowPitch;
+			
+			size_t Size = EncodeRecordingFrame(Compositor->Recorder, &Image, Staging->Timestamp, Staging->Setups, Staging->SetupCount,
+											   Staging->ScaleMode, Staging->TargetWidth, Staging->TargetHeight);
+			DeviceContext->Unmap(Staging->Texture, 0);
+			
+			DWORD Written = 0;
+			if (!Size || !WriteFile(Compositor->RecordFile, Compositor->Recorder->Buffer, (DWORD)Size, &Written, NULL) ||
+				(Written != Size))
+			{
+				Error("Can't write the recording");
+			}
+		}
+		
+		++Compositor->RecordReadCount;
+	}
+}
+
+//
+// Call after every present that went through, with the state it was drawn with. Queues a copy of the display
+// texture and the setups the software shade would have drawn it with, and records the copies that are ready.
+// Unlike the export every frame is kept: with every staging texture in flight it waits for the oldest.
+//
+internal void D3D11RecordFrame(d3d11_compositor *Compositor, crop_piece *Pieces, u32 PieceCount, shade_params *Shade, u64 Timestamp)
+{
+	if (!Compositor->Recorder || Compositor->DeviceIsLost || !Compositor->DisplayTexture)
+	{
+		return;
+	}
+	
+	DrainRecordStaging(Compositor, false);
+	if ((Compositor->RecordWriteCount - Compositor->RecordReadCount) == RECORD_STAGING_COUNT)
+	{
+		DrainRecordStaging(Compositor, true);
+	}
+	
+	record_staging *Staging = &Compositor->RecordStaging[Compositor->RecordWriteCount % RECORD_STAGING_COUNT];
+	if (!CopyDisplayTexture(Compositor, &Staging->Texture, &Staging->Width, &Staging->Height))
+	{
+		return;
+	}
+	
+	// @Note Only the sizes of these are used, the setups' texels point nowhere and the writer ignores them
+	bitmap Target = { NULL, Compositor->SwapChainWidth, Compositor->SwapChainHeight, 0 };
+	bitmap Source = { NULL, Compositor->TextureWidth, Compositor->TextureHeight, 0 };
+	
+	Staging->Timestamp    = Timestamp;
+	Staging->ScaleMode    = GetShadeScale(Shade);
+	Staging->TargetWidth  = Target.Width;
+	Staging->TargetHeight = Target.Height;
+	Staging->SetupCount   = 0;
+	
+	// @Note The same pieces D3D11Shade drew, a sampled one is never recorded since recording turns sampling off
+	for (u32 PieceIndex = 0; PieceIndex < PieceCount; ++PieceIndex)
+	{
+		crop_piece *Piece = &Pieces[PieceIndex];
+		box CropSlot    = Compositor->CropAtlas.Slots[PieceIndex];
+		box DisplaySlot = Compositor->DisplayAtlas.Slots[Piece->OverlayIndex];
+		if (!Piece->HasImage || Piece->SamplesSurface || BoxIsEmpty(CropSlot) || BoxIsEmpty(DisplaySlot) ||
+			BoxIsEmpty(Piece->Mapping.SurfaceBox))
+		{
+			continue;
+		}
+		
+		float SlotWidth  = (float)GetBoxWidth(DisplaySlot);
+		float SlotHeight = (float)GetBoxHeight(DisplaySlot);
+		
+		v2 DestinationMin;
+		DestinationMin.X = (float)DisplaySlot.Left + Piece->DisplayMin.X * SlotWidth;
+		DestinationMin.Y = (float)DisplaySlot.Top  + Piece->DisplayMin.Y * SlotHeight;
+		
+		v2 DestinationMax;
+		DestinationMax.X = (float)DisplaySlot.Left + Piece->DisplayMax.X * SlotWidth;
+		DestinationMax.Y = (float)DisplaySlot.Top  + Piece->DisplayMax.Y * SlotHeight;
+		
+		shade_setup *Setup = &Staging->Setups[Staging->SetupCount];
+		if (SetupShadePiece(Setup, &Target, DestinationMin, DestinationMax, &Source, CropSlot, Piece->Mapping.UV, *Shade))
+		{
+			++Staging->SetupCount;
+		}
+	}
+	
+	++Compositor->RecordWriteCount;
+}
+
+internal COMPOSITOR_LAYOUT(D3D11Layout)
+{
+	d3d11_compositor *Compositor = (d3d11_compositor *)Context;
+	
+	//
+	// Crop atlas, the display texture
+	//
+	
+	int Widths[ATLAS_MAX_SLOTS];
+	int Heights[ATLAS_MAX_SLOTS];
+	for (u32 PieceIndex = 0; PieceIndex < PieceCount; ++PieceIndex)
+	{
+		Widths[PieceIndex]  = Pieces[PieceIndex].Mapping.TextureWidth;
+		Heights[PieceIndex] = Pieces[PieceIndex].Mapping.TextureHeight;
+	}
+	
+	UpdateAtlasLayout(&Compositor->CropAtlas, Widths, Heights, PieceCount, SlotMoved);
+	
+	//
+	// Display atlas, the swap chain
+	//
+	
+	for (u32 OverlayIndex = 0; OverlayIndex < State->OverlayCount; ++OverlayIndex)
+	{
+		Widths[OverlayIndex]  = Max(State->Overlays[OverlayIndex].DisplayWidth,  1);
+		Heights[OverlayIndex] = Max(State->Overlays[OverlayIndex].DisplayHeight, 1);
+	}
+	
+	// @Note Whatever was drawn gets drawn again anyway, where it ended up doesn't matter here
+	bool DisplayMoved[ATLAS_MAX_SLOTS];
+	UpdateAtlasLayout(&Compositor->DisplayAtlas, Widths, Heights, State->OverlayCount, DisplayMoved);
+	
+	//
+	// Resize to fit, and point every window at its slot
+	//
+	
+	// @Note Without a device the atlases are all there is, a rebuild makes everything to fit them
+	if (!D3D11DeviceIsReady(Compositor))
+	{
+		return;
+	}
+	
+	atlas_packer *Packer = &Compositor->CropAtlas.Packer;
+	box Bounds = GetAtlasBounds(&Compositor->DisplayAtlas);
+	if (!ResizeDisplayTexture(Compositor, Packer->Width, Packer->Height) ||
+		!ResizeSwapChain(Compositor, Bounds.Right, Bounds.Bottom))
+	{
+		Compositor->DeviceIsLost = true;
+		return;
+	}
+	
+	PointVisualsAtSlots(Compositor);
+}
+
+// @Note An HDR desktop can't be copied into the 8-bit display texture, so its regions are drawn into it instead and
+// converted and tone mapped on the way, like SoftwareCropTile does. Whatever the shade had bound is put back after.
+internal void ConvertCrop(d3d11_compositor *Compositor, captured_frame *Frame, ID3D11Texture2D *DesktopTexture, box Slot, box CutBox,
+						  box *Regions, u32 RegionCount)
+{
+	ID3D11DeviceContext *DeviceContext = Compositor->D3D->DeviceContext;
+	
+	D3D11_SHADER_RESOURCE_VIEW_DESC DesktopViewDesc;
+	DesktopViewDesc.Format                    = (Frame->Format == SurfaceFormat_RGBA16F) ? DXGI_FORMAT_R16G16B16A16_FLOAT : DXGI_FORMAT_R10G10B10A2_UNORM;
+	DesktopViewDesc.ViewDimension             = D3D11_SRV_DIMENSION_TEXTURE2D;
+	DesktopViewDesc.Texture2D.MostDetailedMip = 0;
+	DesktopViewDesc.Texture2D.MipLevels       = 1;
+	
+	ID3D11ShaderResourceView *DesktopView;
+	Result = Compositor->D3D->Device->CreateShaderResourceView(DesktopTexture, &DesktopViewDesc, &DesktopView);
+	if (FAILED(Result))
+	{
+		Error("CreateShaderResourceView(Desktop)");
+	}
+	
+	D3D11_VIEWPORT Viewport;
+	Viewport.TopLeftX = 0;
+	Viewport.TopLeftY = 0;
+	Viewport.Width    = (float)Compositor->TextureWidth;
+	Viewport.Height   = (float)Compositor->TextureHeight;
+	Viewport.MinDepth = 0.0f;
+	Viewport.MaxDepth = 1.0f;
+	
+	DeviceContext->RSSetViewports(1, &Viewport);
+	DeviceContext->OMSetRenderTargets(1, &Compositor->DisplayTextureTarget, NULL);
+	DeviceContext->VSSetShader(Compositor->ConvertVertexShader, NULL, 0);
+	DeviceContext->VSSetConstantBuffers(0, 1, &Compositor->ConvertConstantBuffer);
+	DeviceContext->PSSetShader(Compositor->ConvertPixelShaders[Frame->Format], NULL, 0);
+	DeviceContext->PSSetShaderResources(0, 1, &DesktopView);
+	
+	// @Note A source that doesn't know its SDR white gets the default
+	float WhiteNits = (Frame->WhiteNits > 0.0f) ? Frame->WhiteNits : SCRGB_WHITE_NITS;
+	colour_convert Convert = GetColourConvert(Frame->Format, WhiteNits);
+	
+	for (u32 FirstRegion = 0; FirstRegion < RegionCount; FirstRegion += CONVERT_MAX_REGIONS)
+	{
+		u32 BatchCount = Min(RegionCount - FirstRegion, (u32)CONVERT_MAX_REGIONS);
+		
+		D3D11_MAPPED_SUBRESOURCE Mapped;
+		Result = DeviceContext->Map(Compositor->ConvertConstantBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &Mapped);
+		if (FAILED(Result))
+		{
+			continue;
+		}
+		
+		convert_constant_buffer *CBuffer = (convert_constant_buffer *)Mapped.pData;
+		for (u32 RegionIndex = 0; RegionIndex < BatchCount; ++RegionIndex)
+		{
+			box Region = Regions[FirstRegion + RegionIndex];
+			CBuffer->Regions[RegionIndex][0] = (float)Region.Left;
+			CBuffer->Regions[RegionIndex][1] = (float)Region.Top;
+			CBuffer->Regions[RegionIndex][2] = (float)Region.Right;
+			CBuffer->Regions[RegionIndex][3] = (float)Region.Bottom;
+		}
+		
+		CBuffer->Offset[0]      = (float)(Slot.Left - CutBox.Left);
+		CBuffer->Offset[1]      = (float)(Slot.Top  - CutBox.Top);
+		CBuffer->TargetScale[0] = 2.0f / (float)Compositor->TextureWidth;
+		CBuffer->TargetScale[1] = 2.0f / (float)Compositor->TextureHeight;
+		CBuffer->Scale          = Convert.Scale;
+		for (int Row = 0; Row < 3; ++Row)
+		{
+			CBuffer->Mix[Row][0] = BT2020To709[Row][0];
+			CBuffer->Mix[Row][1] = BT2020To709[Row][1];
+			CBuffer->Mix[Row][2] = BT2020To709[Row][2];
+			CBuffer->Mix[Row][3] = 0.0f;
+		}
+		
+		DeviceContext->Unmap(Compositor->ConvertConstantBuffer, 0);
+		DeviceContext->DrawInstanced(6, BatchCount, 0, 0);
+	}
+	
+	// @Note The display texture can't stay a target with its view bound for the shade
+	DeviceContext->OMSetRenderTargets(0, NULL, NULL);
+	DeviceContext->VSSetShader(Compositor->VertexShader, NULL, 0);
+	DeviceContext->VSSetConstantBuffers(0, 1, &Compositor->ConstantBuffer);
+	DeviceContext->PSSetShaderResources(0, 1, &Compositor->DisplayTextureView);
+	DesktopView->Release();
+	
+	// @Note So the shade binds its pixel shader and its viewport again
+	Compositor->BoundScale     = ScaleMode_Count;
+	Compositor->BoundEffectKey = EffectKey_Count;
+	Compositor->ViewportWidth   = 0;
+}
+
+internal COMPOSITOR_CROP(D3D11Crop)
+{
+	d3d11_compositor *Compositor = (d3d11_compositor *)Context;
+	ID3D11Texture2D *DesktopTexture = (ID3D11Texture2D *)Frame->Surface;
+	
+	// @Note A desktop from before the device was lost has nothing to copy into, the pipeline crops it all again
+	// once the present after the rebuild didn't happen
+	box Slot = Compositor->CropAtlas.Slots[PieceIndex];
+	if (!D3D11DeviceIsReady(Compositor) || BoxIsEmpty(Slot) || !Compositor->DisplayTexture ||
+		!IsOnDevice(DesktopTexture, Compositor->D3D->Device))
+	{
+		return false;
+	}
+	
+	BeginGpuTimer(Compositor);
+	
+	for (u32 RegionIndex = 0; RegionIndex < RegionCount; ++RegionIndex)
+	{
+		++Compositor->Traffic.CopyCount;
+		Compositor->Traffic.CopiedBytes += (u64)GetBoxWidth(Regions[RegionIndex]) * (u64)GetBoxHeight(Regions[RegionIndex]) * 4;
+	}
+	
+	// @Note The display texture is typeless B8G8R8A8, an SDR desktop copies straight in
+	if (Frame->Format != SurfaceFormat_BGRA8)
+	{
+		ConvertCrop(Compositor, Frame, DesktopTexture, Slot, CutBox, Regions, RegionCount);
+	}
+	else
+	{
+		for (u32 RegionIndex = 0; RegionIndex < RegionCount; ++RegionIndex)
+		{
+			box Region = Regions[RegionIndex];
+			
+			D3D11_BOX RegionBox;
+			RegionBox.left   = Region.Left;
+			RegionBox.top    = Region.Top;
+			RegionBox.right  = Region.Right;
+			RegionBox.bottom = Region.Bottom;
+			RegionBox.front  = 0;
+			RegionBox.back   = 1;
+			
+			Compositor->D3D->DeviceContext->CopySubresourceRegion(Compositor->DisplayTexture, 0,
+																  Slot.Left + (Region.Left - CutBox.Left), Slot.Top + (Region.Top - CutBox.Top), 0,
+																  DesktopTexture, 0,
+																  &RegionBox);
+		}
+	}
+	
+	Compositor->MipsAreStale = true;
+	
+	return D3D11DetectChanges(Compositor, Slot, CutBox, Regions, RegionCount);
+}
+
+// @Note HDR has to be converted, and the mip chain is only generated over the display texture.
+// Duplication may hand out a desktop that can't be bound, that one gets copied too.
+internal COMPOSITOR_SAMPLE(D3D11Sample)
+{
+	d3d11_compositor *Compositor = (d3d11_compositor *)Context;
+	ID3D11Texture2D *DesktopTexture = (ID3D11Texture2D *)Frame->Surface;
+	
+	if (!DesktopTexture || (Frame->Format != SurfaceFormat_BGRA8) || (GetShadeScale(&State->Shade) == ScaleMode_Mip) ||
+		!D3D11DeviceIsReady(Compositor) || !IsOnDevice(DesktopTexture, Compositor->D3D->Device))
+	{
+		return false;
+	}
+	
+	if (Compositor->SampledTexture != DesktopTexture)
+	{
+		if (Compositor->SampledView)
+		{
+			Compositor->SampledView->Release();
+			Compositor->SampledView = NULL;
+		}
+		
+		Compositor->SampledTexture = NULL;
+		
+		D3D11_TEXTURE2D_DESC DesktopDesc;
+		DesktopTexture->GetDesc(&DesktopDesc);
+		if (!(DesktopDesc.BindFlags & D3D11_BIND_SHADER_RESOURCE))
+		{
+			return false;
+		}
+		
+		Result = Compositor->D3D->Device->CreateShaderResourceView(DesktopTexture, NULL, &Compositor->SampledView);
+		if (FAILED(Result))
+		{
+			Compositor->SampledView = NULL;
+			return false;
+		}
+		
+		Compositor->SampledTexture = DesktopTexture;
+		Compositor->SampledWidth   = (int)DesktopDesc.Width;
+		Compositor->SampledHeight  = (int)DesktopDesc.Height;
+	}
+	
+	return true;
+}
+
+internal COMPOSITOR_SHADE(D3D11Shade)
+{
+	d3d11_compositor *Compositor = (d3d11_compositor *)Context;
+	ID3D11DeviceContext *DeviceContext = Compositor->D3D->DeviceContext;
+	
+	// @Note Lost since the wait, the present doesn't happen either
+	if (Compositor->DeviceIsLost)
+	{
+		return;
+	}
+	
+	// @Note A redraw without any crops only times the draw
+	BeginGpuTimer(Compositor);
+	
+	//
+	// Update the viewport, the whole swap chain
+	//
+	
+	if ((Compositor->ViewportWidth  != Compositor->SwapChainWidth) ||
+		(Compositor->ViewportHeight != Compositor->SwapChainHeight))
+	{
+		Compositor->ViewportWidth  = Compositor->SwapChainWidth;
+		Compositor->ViewportHeight = Compositor->SwapChainHeight;
+		
+		D3D11_VIEWPORT Viewport;
+		Viewport.TopLeftX = 0;
+		Viewport.TopLeftY = 0;
+		Viewport.Width    = (float)Compositor->ViewportWidth;
+		Viewport.Height   = (float)Compositor->ViewportHeight;
+		Viewport.MinDepth = 0.0f;
+		Viewport.MaxDepth = 1.0f;
+		
+		DeviceContext->RSSetViewports(1, &Viewport);
+	}
+	
+	//
+	// One instance per piece that has something to show, the pieces of a cut box share its display slot
+	//
+	
+	float TargetWidth   = (float)Compositor->SwapChainWidth;
+	float TargetHeight  = (float)Compositor->SwapChainHeight;
+	
+	u32 InstanceCount = 0;
+	bool InstancesChanged = false;
+	bool SamplesSurface   = false;
+	for (u32 PieceIndex = 0; PieceIndex < PieceCount; ++PieceIndex)
+	{
+		crop_piece *Piece = &Pieces[PieceIndex];
+		box CropSlot    = Compositor->CropAtlas.Slots[PieceIndex];
+		box DisplaySlot = Compositor->DisplayAtlas.Slots[Piece->OverlayIndex];
+		
+		// @Note Drawn from the desktop its cut box is the slot, all of them sample it or none do
+		int SourceWidth  = Compositor->TextureWidth;
+		int SourceHeight = Compositor->TextureHeight;
+		if (Piece->SamplesSurface)
+		{
+			SourceWidth  = Compositor->SampledWidth;
+			SourceHeight = Compositor->SampledHeight;
+			CropSlot     = IntersectBoxes(Piece->Mapping.SurfaceBox, box{ 0, 0, SourceWidth, SourceHeight });
+		}
+		
+		// @Note Nothing was cropped for a cut box that is entirely off the desktop
+		if (!Piece->HasImage || BoxIsEmpty(CropSlot) || BoxIsEmpty(DisplaySlot) || BoxIsEmpty(Piece->Mapping.SurfaceBox))
+		{
+			continue;
+		}
+		
+		float SlotWidth  = (float)GetBoxWidth(DisplaySlot);
+		float SlotHeight = (float)GetBoxHeight(DisplaySlot);
+		float Left   = (float)DisplaySlot.Left + Piece->DisplayMin.X * SlotWidth;
+		float Top    = (float)DisplaySlot.Top  + Piece->DisplayMin.Y * SlotHeight;
+		float Right  = (float)DisplaySlot.Left + Piece->DisplayMax.X * SlotWidth;
+		float Bottom = (float)DisplaySlot.Top  + Piece->DisplayMax.Y * SlotHeight;
+		
+		overlay_instance Instance;
+		Instance.Destination[0] = 2.0f * Left   / TargetWidth  - 1.0f;
+		Instance.Destination[1] = 1.0f - 2.0f * Top    / TargetHeight;
+		Instance.Destination[2] = 2.0f * Right  / TargetWidth  - 1.0f;
+		Instance.Destination[3] = 1.0f - 2.0f * Bottom / TargetHeight;
+		Instance.UVClamp[0]     = ((float)CropSlot.Left   + 0.5f) / (float)SourceWidth;
+		Instance.UVClamp[1]     = ((float)CropSlot.Top    + 0.5f) / (float)SourceHeight;
+		Instance.UVClamp[2]     = ((float)CropSlot.Right  - 0.5f) / (float)SourceWidth;
+		Instance.UVClamp[3]     = ((float)CropSlot.Bottom - 0.5f) / (float)SourceHeight;
+		Instance.UV             = GetAtlasUV(Piece->Mapping.UV, CropSlot, SourceWidth, SourceHeight);
+		Instance.Decode         = Piece->SamplesSurface ? 1.0f : 0.0f;
+		Instance.Pad            = 0.0f;
+		
+		if (Piece->SamplesSurface)
+		{
+			SamplesSurface = true;
+			++Compositor->Traffic.SampleCount;
+		}
+		
+		overlay_instance *Cached = &Compositor->Instances[InstanceCount++];
+		if (!InstancesAreEqual(Cached, &Instance))
+		{
+			*Cached = Instance;
+			InstancesChanged = true;
+		}
+	}
+	
+	//
+	// Update the constant buffer
+	//
+	
+	if (InstancesChanged || (InstanceCount != Compositor->InstanceCount))
+	{
+		Compositor->InstanceCount = InstanceCount;
+		
+		// @Note The buffer is D3D11_USAGE_DYNAMIC so it has to go through Map, UpdateSubresource is not allowed on it
+		D3D11_MAPPED_SUBRESOURCE Mapped;
+		Result = DeviceContext->Map(Compositor->ConstantBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &Mapped);
+		if (SUCCEEDED(Result))
+		{
+			vertex_constant_buffer *CBuffer = (vertex_constant_buffer *)Mapped.pData;
+			CopyBytes(CBuffer->Instances, Compositor->Instances, InstanceCount * sizeof(overlay_instance));
+			
+			DeviceContext->Unmap(Compositor->ConstantBuffer, 0);
+		}
+	}
+	
+	//
+	// Effect parameters, the same for every piece
+	//
+	
+	effect_constants Effects = GetEffectConstants(State->Shade);
+	if (Compositor->EffectsAreStale || !BytesAreEqual(&Effects, &Compositor->Effects, sizeof(Effects)))
+	{
+		D3D11_MAPPED_SUBRESOURCE Mapped;
+		Result = DeviceContext->Map(Compositor->EffectBuffer, 0, D3D11_MAP_WRITE_DISCARD, 0, &Mapped);
+		if (SUCCEEDED(Result))
+		{
+			CopyBytes(Mapped.pData, &Effects, sizeof(Effects));
+			DeviceContext->Unmap(Compositor->EffectBuffer, 0);
+			
+			Compositor->Effects         = Effects;
+			Compositor->EffectsAreStale = false;
+		}
+	}
+	
+	//
+	// Scaling mode and effect chain, the mip chain only gets generated if it is sampled
+	//
+	
+	scale_mode Scale = GetShadeScale(&State->Shade);
+	u32 EffectKey = State->Shade.Effects.Key & (EffectKey_Count - 1);
+	if ((Compositor->BoundScale != Scale) || (Compositor->BoundEffectKey != EffectKey))
+	{
+		// @Note A chain whose shader can't be had draws without its effects rather than not at all
+		ID3D11PixelShader *PixelShader = Compositor->PixelShaders[Scale];
+		if (EffectKey)
+		{
+			ID3D11PixelShader *EffectShader = D3D11GetEffectShader(Compositor, EffectKey);
+			if (EffectShader)
+			{
+				PixelShader = EffectShader;
+			}
+		}
+		
+		Compositor->BoundScale     = Scale;
+		Compositor->BoundEffectKey = EffectKey;
+		DeviceContext->PSSetShader(PixelShader, NULL, 0);
+		DeviceContext->PSSetSamplers(0, 1, &Compositor->Samplers[Scale]);
+	}
+	
+	if ((Scale == ScaleMode_Mip) && Compositor->MipsAreStale && Compositor->DisplayTextureView)
+	{
+		Compositor->MipsAreStale = false;
+		DeviceContext->GenerateMips(Compositor->DisplayTextureView);
+	}
+	
+	//
+	// Render every piece in one draw
+	//
+	
+	DeviceContext->OMSetRenderTargets(1, &Compositor->RenderTargetView, NULL);
+	
+	float ClearColour[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
+	DeviceContext->ClearRenderTargetView(Compositor->RenderTargetView, ClearColour);
+	
+	if (InstanceCount > 0)
+	{
+		// @Note Unbound again right after, the desktop goes back to duplication when the frame is released
+		if (SamplesSurface)
+		{
+			DeviceContext->PSSetShaderResources(0, 1, &Compositor->SampledView);
+		}
+		
+		UINT VertexCount = 6;
+		UINT StartVertex = 0;
+		DeviceContext->DrawInstanced(VertexCount, InstanceCount, StartVertex, 0);
+		
+		if (SamplesSurface)
+		{
+			DeviceContext->PSSetShaderResources(0, 1, &Compositor->DisplayTextureView);
+		}
+	}
+	
+	EndGpuTimer(Compositor);
+}
+
+internal COMPOSITOR_WAIT(D3D11Wait)
+{
+	d3d11_compositor *Compositor = (d3d11_compositor *)Context;
+	
+	// @Note Nothing gets drawn without a device, the frame waits for the next try
+	if (!D3D11DeviceIsReady(Compositor))
+	{
+		Sleep(TimeoutMS);
+		return false;
+	}
+	
+	if (!Compositor->CanPresent)
+	{
+		Compositor->CanPresent = (WaitForSingleObject(Compositor->FrameLatencyWaitable, TimeoutMS) == WAIT_OBJECT_0);
+	}
+	
+	return Compositor->CanPresent;
+}
+
+internal COMPOSITOR_PRESENT(D3D11Present)
+{
+	d3d11_compositor *Compositor = (d3d11_compositor *)Context;
+	
+	// @Note What was just drawn came from a display texture that lost its crops with the old device. Not presenting
+	// it has the pipeline crop everything again.
+	if (Compositor->DeviceIsLost || Compositor->DeviceWasRebuilt)
+	{
+		Compositor->DeviceWasRebuilt = false;
+		return false;
+	}
+	
+	// @Note For DXGI_SWAP_EFFECT_FLIP_SEQUENTIAL:
+	// 0 - Cancel the remaining time on the previously
+	//     presented frame and discard this frame if a newer frame is queued.
+	// When to present is up to the pacer, and D3D11Wait made sure there is room for it.
+	int SyncInterval = 0;
+	int Flags = 0;
+	Compositor->CanPresent = false;
+	Result = Compositor->SwapChain->Present(SyncInterval, Flags);
+	if (FAILED(Result))
+	{
+		if (IsDeviceLoss(Result))
+		{
+			RecoverD3D11Device(Compositor);
+			Compositor->DeviceWasRebuilt = false;
+			
+			return false;
+		}
+		else
+		{
+			Error("Present");
+		}
+	}
+	
+	// @Note After the present so the windows move to their new slots along with the frame that has them
+	if (Compositor->VisualsChanged)
+	{
+		Compositor->VisualsChanged = false;
+		
+		Result = Compositor->CompositionDevice->Commit();
+		if (FAILED(Result))
+		{
+			Error("Commit");
+		}
+	}
+	
+	return true;
+}
+
+internal compositor D3D11Compositor(d3d11_compositor *Compositor)
+{
+	compositor Result;
+	Result.Context = Compositor;
+	Result.Layout  = D3D11Layout;
+	Result.Crop    = D3D11Crop;
+	Result.Sample  = D3D11Sample;
+	Result.Shade   = D3D11Shade;
+	Result.Wait    = D3D11Wait;
+	Result.Present = D3D11Present;
+	Result.Memory  = &Compositor->Memory;
+	Result.Traffic = &Compositor->Traffic;
+	
+	return Result;
+}
+
+//
+// Desktop duplication source
+//
+// @Note One per output, each runs on its own worker thread. HRESULTs are kept in locals here,
+// the global Result belongs to the render thread.
+//
+
+struct dxgi_duplication_source
+{
+	d3d11_device *D3D;
+	
+	// @Note The device generation the outputs were found on. A driver update can bring the new device up
+	// on another adapter object, the outputs are looked up again from it.
+	u32 Generation;
+	u32 AdapterIndex;
+	u32 OutputIndex;
+	
+	// @Note Output5 duplicates an HDR desktop as it is, NULL before Windows 10 1703 or once it failed
+	IDXGIOutput1 *Output1;
+	IDXGIOutput5 *Output5;
+	
+	// @Note An output on another adapter is duplicated on a device of its own made on that adapter, and every frame
+	// is copied into a texture shared with our device. Its keyed mutex hands it back and forth: key 0 is the worker's
+	// to copy into it, key 1 the render thread's to crop from it. All NULL for an output on adapter 0.
+	ID3D11Device        *ForeignDevice;
+	ID3D11DeviceContext *ForeignContext;
+	ID3D11Texture2D     *ForeignTexture;
+	IDXGIKeyedMutex     *ForeignMutex;
+	ID3D11Texture2D     *SharedTexture;
+	IDXGIKeyedMutex     *SharedMutex;
+	bool SharedIsHeld;
+	
+	// @Note Creation is handled per-frame because it's not reliable and it can be destoyed at any time so we need to recreate it
+	IDXGIOutputDuplication *OutputDuplication;
+	bool DuplicationIsNew;
+	
+	IDXGIResource	*DesktopResource;
+	ID3D11Texture2D	*DesktopTexture;
+	
+	// @Note Read again every time the duplication is created, a mode change loses it. The white level isn't part
+	// of the mode, the SDR brightness slider moves it without a new duplication, so it is read again on its own.
+	display_rotation Rotation;
+	int DesktopWidth;
+	int DesktopHeight;
+	surface_format Format;
+	float WhiteNits;
+	u64 WhiteNitsTime; // GetTickCount64 when it was read
+	
+	// @Note Frame metadata, anything that doesn't fit is treated as the whole desktop changing
+	UINT MetadataBufferSize;
+	DXGI_OUTDUPL_MOVE_RECT *MoveRectBuffer;
+	RECT *DirtyRectBuffer;
+	move_rect *MoveRects;
+	box *DirtyRects;
+};
+
+// @Note Both sides of it, the texture is opened on whichever of our devices there was
+internal void CloseSharedTexture(dxgi_duplication_source *Source)
+{
+	ReleaseObject(Source->SharedMutex);
+	ReleaseObject(Source->SharedTexture);
+	ReleaseObject(Source->ForeignMutex);
+	ReleaseObject(Source->ForeignTexture);
+	Source->SharedIsHeld = false;
+}
+
+internal void CloseDuplicationOutput(dxgi_duplication_source *Source)
+{
+	CloseSharedTexture(Source);
+	ReleaseObject(Source->Output5);
+	ReleaseObject(Source->Output1);
+}
+
+// @Note Only the other adapter's device going away closes it, the next acquire opens the output again with a new one
+internal void CloseForeignDevice(dxgi_duplication_source *Source)
+{
+	CloseDuplicationOutput(Source);
+	ReleaseObject(Source->ForeignContext);
+	ReleaseObject(Source->ForeignDevice);
+}
+
+internal bool OpenOutputInterfaces(dxgi_duplication_source *Source, IDXGIOutput *Output)
+{
+	HRESULT Result = Output->QueryInterface(__uuidof(IDXGIOutput1), (void **)&Source->Output1);
+	if (SUCCEEDED(Result) && FAILED(Output->QueryInterface(__uuidof(IDXGIOutput5), (void **)&Source->Output5)))
+	{
+		Source->Output5 = NULL;
+	}
+	
+	return SUCCEEDED(Result);
+}
+
+// @Note The adapter is found again by its place in the factory and gets a device of its own the first time.
+// That device outlives our device's generations, only its own loss closes it, see CloseForeignDevice.
+internal bool OpenForeignOutput(dxgi_duplication_source *Source)
+{
+	HRESULT Result;
+	
+	IDXGIFactory1 *Factory = NULL;
+	IDXGIAdapter1 *Adapter = NULL;
+	IDXGIOutput *Output = NULL;
+	
+	Result = CreateDXGIFactory1(__uuidof(IDXGIFactory1), (void **)&Factory);
+	if (SUCCEEDED(Result))
+	{
+		Result = Factory->EnumAdapters1(Source->AdapterIndex, &Adapter);
+	}
+	
+	// @Note Only this output's worker ever uses it
+	if (SUCCEEDED(Result) && !Source->ForeignDevice)
+	{
+		D3D_FEATURE_LEVEL FeatureLevel = D3D_FEATURE_LEVEL_10_0;
+		Result = D3D11CreateDevice(Adapter, D3D_DRIVER_TYPE_UNKNOWN, NULL,
+								   D3D11_CREATE_DEVICE_BGRA_SUPPORT | D3D11_CREATE_DEVICE_SINGLETHREADED, &FeatureLevel, 1,
+								   D3D11_SDK_VERSION, &Source->ForeignDevice, NULL, &Source->ForeignContext);
+		if (FAILED(Result))
+		{
+			Source->ForeignDevice  = NULL;
+			Source->ForeignContext = NULL;
+		}
+	}
+	
+	if (SUCCEEDED(Result))
+	{
+		Result = Adapter->EnumOutputs(Source->OutputIndex, &Output);
+	}
+	
+	if (SUCCEEDED(Result) && !OpenOutputInterfaces(Source, Output))
+	{
+		Result = E_FAIL;
+	}
+	
+	ReleaseObject(Output);
+	ReleaseObject(Adapter);
+	ReleaseObject(Factory);
+	
+	if (FAILED(Result))
+	{
+		Source->Output1 = NULL;
+		CloseDuplicationOutput(Source);
+		return false;
+	}
+	
+	return true;
+}
+
+// @Note Finds the output on the adapter of the device as it is now. Returns false if there is no device, or the
+// output isn't there (yet), nothing is kept then. An output on another adapter is found on that one instead.
+internal bool OpenDuplicationOutput(dxgi_duplication_source *Source)
+{
+	HRESULT Result;
+	
+	Source->Output1 = NULL;
+	Source->Output5 = NULL;
+	if (Source->AdapterIndex != 0)
+	{
+		return OpenForeignOutput(Source);
+	}
+	
+	AcquireSRWLockShared(&Source->D3D->Lock);
+	
+	IDXGIDevice *DXGIDevice = NULL;
+	IDXGIAdapter *Adapter = NULL;
+	IDXGIOutput *Output = NULL;
+	
+	Result = Source->D3D->Device ? Source->D3D->Device->QueryInterface(__uuidof(IDXGIDevice), (void **)&DXGIDevice) : E_FAIL;
+	if (SUCCEEDED(Result))
+	{
+		Result = DXGIDevice->GetAdapter(&Adapter);
+	}
+	
+	if (SUCCEEDED(Result))
+	{
+		Result = Adapter->EnumOutputs(Source->OutputIndex, &Output);
+	}
+	
+	if (SUCCEEDED(Result) && !OpenOutputInterfaces(Source, Output))
+	{
+		Result = E_FAIL;
+	}
+	
+	ReleaseObject(Output);
+	ReleaseObject(Adapter);
+	ReleaseObject(DXGIDevice);
+	
+	ReleaseSRWLockShared(&Source->D3D->Lock);
+	
+	if (FAILED(Result))
+	{
+		Source->Output1 = NULL;
+		CloseDuplicationOutput(Source);
+		return false;
+	}
+	
+	return true;
+}
+
+//
+// AdapterIndex and OutputIndex are the output's place in the DXGI factory's enumeration. Duplication needs
+// a device on the output's own adapter and ours is made on the default one, adapter 0. An output on another
+// one is duplicated on a device of its own and copied over to ours, see CopyForeignFrame.
+//
+internal void InitializeDuplicationSource(dxgi_duplication_source *Source, d3d11_device *D3D, u32 AdapterIndex, u32 OutputIndex,
+										  int DesktopWidth, int DesktopHeight, memory_arena *Arena)
+{
+	Source->D3D          = D3D;
+	Source->Generation   = D3D->Generation;
+	Source->AdapterIndex = AdapterIndex;
+	Source->OutputIndex  = OutputIndex;
+	Source->Output1      = NULL;
+	Source->Output5      = NULL;
+	
+	Source->ForeignDevice  = NULL;
+	Source->ForeignContext = NULL;
+	Source->ForeignTexture = NULL;
+	Source->ForeignMutex   = NULL;
+	Source->SharedTexture  = NULL;
+	Source->SharedMutex    = NULL;
+	Source->SharedIsHeld   = false;
+	
+	// @Note The worker takes the shared texture's keyed mutex on our device, from its own thread
+	if ((AdapterIndex != 0) && !D3D->WorkersUseContext)
+	{
+		AcquireSRWLockExclusive(&D3D->Lock);
+		D3D->WorkersUseContext = true;
+		if (D3D->DeviceContext)
+		{
+			ProtectD3D11Context(D3D->DeviceContext);
+		}
+		ReleaseSRWLockExclusive(&D3D->Lock);
+	}
+	
+	Source->OutputDuplication = NULL;
+	Source->DuplicationIsNew  = false;
+	Source->DesktopResource   = NULL;
+	Source->DesktopTexture    = NULL;
+	
+	Source->Rotation      = DisplayRotation_Identity;
+	Source->DesktopWidth  = DesktopWidth;
+	Source->DesktopHeight = DesktopHeight;
+	Source->Format        = SurfaceFormat_BGRA8;
+	Source->WhiteNits     = SCRGB_WHITE_NITS;
+	Source->WhiteNitsTime = 0;
+	
+	Source->MetadataBufferSize = Kilobytes(16);
+	Source->MoveRectBuffer     = (DXGI_OUTDUPL_MOVE_RECT *)PushSize(Arena, Source->MetadataBufferSize);
+	Source->DirtyRectBuffer    = (RECT *)PushSize(Arena, Source->MetadataBufferSize);
+	Source->MoveRects          = PushArray(Arena, Source->MetadataBufferSize / sizeof(DXGI_OUTDUPL_MOVE_RECT), move_rect);
+	Source->DirtyRects         = PushArray(Arena, Source->MetadataBufferSize / sizeof(RECT), box);
+	
+	// @Note One on another adapter that can't be had yet is tried again on every acquire
+	if (!OpenDuplicationOutput(Source) && (AdapterIndex == 0))
+	{
+		Error("EnumOutputs");
+	}
+}
+
+internal void GetFrameMetadata(dxgi_duplication_source *Source, DXGI_OUTDUPL_FRAME_INFO *FrameInfo, captured_frame *Frame)
+{
+	Frame->MetadataIsValid = false;
+	Frame->MoveRectCount   = 0;
+	Frame->MoveRects       = Source->MoveRects;
+	Frame->DirtyRectCount  = 0;
+	Frame->DirtyRects      = Source->DirtyRects;
+	
+	if (FrameInfo->TotalMetadataBufferSize == 0)
+	{
+		return;
+	}
+	
+	HRESULT Result;
+	
+	// @Note Any failure here, DXGI_ERROR_MORE_DATA included, leaves the metadata invalid and the whole cut box gets copied
+	UINT MoveBufferSize;
+	Result = Source->OutputDuplication->GetFrameMoveRects(Source->MetadataBufferSize, Source->MoveRectBuffer, &MoveBufferSize);
+	if (FAILED(Result))
+	{
+		return;
+	}
+	
+	UINT DirtyBufferSize;
+	Result = Source->OutputDuplication->GetFrameDirtyRects(Source->MetadataBufferSize, Source->DirtyRectBuffer, &DirtyBufferSize);
+	if (FAILED(Result))
+	{
+		return;
+	}
+	
+	Frame->MoveRectCount = MoveBufferSize / sizeof(DXGI_OUTDUPL_MOVE_RECT);
+	for (u32 MoveIndex = 0; MoveIndex < Frame->MoveRectCount; ++MoveIndex)
+	{
+		DXGI_OUTDUPL_MOVE_RECT *Move = &Source->MoveRectBuffer[MoveIndex];
+		move_rect *Dest = &Source->MoveRects[MoveIndex];
+		
+		Dest->SourceX            = Move->SourcePoint.x;
+		Dest->SourceY            = Move->SourcePoint.y;
+		Dest->Destination.Left   = Move->DestinationRect.left;
+		Dest->Destination.Top    = Move->DestinationRect.top;
+		Dest->Destination.Right  = Move->DestinationRect.right;
+		Dest->Destination.Bottom = Move->DestinationRect.bottom;
+	}
+	
+	Frame->DirtyRectCount = DirtyBufferSize / sizeof(RECT);
+	for (u32 DirtyIndex = 0; DirtyIndex < Frame->DirtyRectCount; ++DirtyIndex)
+	{
+		RECT *Dirty = &Source->DirtyRectBuffer[DirtyIndex];
+		box *Dest = &Source->DirtyRects[DirtyIndex];
+		
+		Dest->Left   = Dirty->left;
+		Dest->Top    = Dirty->top;
+		Dest->Right  = Dirty->right;
+		Dest->Bottom = Dirty->bottom;
+	}
+	
+	Frame->MetadataIsValid = true;
+}
+
+inline bool WideStringsAreEqual(wchar_t *A, wchar_t *B)
+{
+	while (*A && (*A == *B))
+	{
+		++A;
+		++B;
+	}
+	
+	return *A == *B;
+}
+
+// @Note How often an HDR output's white level is read again, see DuplicationAcquire. The query walks the display
+// config, a second of the old brightness after the slider moved is fine.
+#define WHITE_LEVEL_CHECK_MS 1000
+
+// @Note Where the SDR content brightness slider puts SDR white on an HDR output. DXGI doesn't know it, the display
+// config does, found by the output's GDI device name. Default scRGB white if anything is missing.
+internal float GetOutputWhiteNits(IDXGIOutput1 *Output)
+{
+	DXGI_OUTPUT_DESC OutputDesc;
+	HRESULT Result = Output->GetDesc(&OutputDesc);
+	if (FAILED(Result))
+	{
+		return SCRGB_WHITE_NITS;
+	}
+	
+	// @Note Worker threads have small stacks, a desktop with more paths than this gets the default
+	DISPLAYCONFIG_PATH_INFO Paths[2 * MAX_OUTPUTS];
+	DISPLAYCONFIG_MODE_INFO Modes[4 * MAX_OUTPUTS];
+	UINT32 PathCount = GetArrayCount(Paths);
+	UINT32 ModeCount = GetArrayCount(Modes);
+	if (QueryDisplayConfig(QDC_ONLY_ACTIVE_PATHS, &PathCount, Paths, &ModeCount, Modes, NULL) != ERROR_SUCCESS)
+	{
+		return SCRGB_WHITE_NITS;
+	}
+	
+	for (UINT32 PathIndex = 0; PathIndex < PathCount; ++PathIndex)
+	{
+		DISPLAYCONFIG_PATH_INFO *Path = &Paths[PathIndex];
+		
+		DISPLAYCONFIG_SOURCE_DEVICE_NAME SourceName;
+		SourceName.header.type      = DISPLAYCONFIG_DEVICE_INFO_GET_SOURCE_NAME;
+		SourceName.header.size      = sizeof(SourceName);
+		SourceName.header.adapterId = Path->sourceInfo.adapterId;
+		SourceName.header.id        = Path->sourceInfo.id;
+		if ((DisplayConfigGetDeviceInfo(&SourceName.header) != ERROR_SUCCESS) ||
+			!WideStringsAreEqual(SourceName.viewGdiDeviceName, OutputDesc.DeviceName))
+		{
+			continue;
+		}
+		
+		// @Note In thousandths of scRGB white
+		DISPLAYCONFIG_SDR_WHITE_LEVEL WhiteLevel;
+		WhiteLevel.header.type      = DISPLAYCONFIG_DEVICE_INFO_GET_SDR_WHITE_LEVEL;
+		WhiteLevel.header.size      = sizeof(WhiteLevel);
+		WhiteLevel.header.adapterId = Path->targetInfo.adapterId;
+		WhiteLevel.header.id        = Path->targetInfo.id;
+		if ((DisplayConfigGetDeviceInfo(&WhiteLevel.header) == ERROR_SUCCESS) && WhiteLevel.SDRWhiteLevel)
+		{
+			return (float)WhiteLevel.SDRWhiteLevel * (SCRGB_WHITE_NITS / 1000.0f);
+		}
+	}
+	
+	return SCRGB_WHITE_NITS;
+}
+
+internal void GetOutputGeometry(dxgi_duplication_source *Source)
+{
+	DXGI_OUTDUPL_DESC DuplicationDesc;
+	Source->OutputDuplication->GetDesc(&DuplicationDesc);
+	
+	switch (DuplicationDesc.Rotation)
+	{
+		case DXGI_MODE_ROTATION_ROTATE90:  { Source->Rotation = DisplayRotation_90;       } break;
+		case DXGI_MODE_ROTATION_ROTATE180: { Source->Rotation = DisplayRotation_180;      } break;
+		case DXGI_MODE_ROTATION_ROTATE270: { Source->Rotation = DisplayRotation_270;      } break;
+		default:                           { Source->Rotation = DisplayRotation_Identity; } break;
+	}
+	
+	// @Note DuplicateOutput1 hands an HDR desktop over as DWM composes it, DuplicateOutput always converts to BGRA8
+	switch (DuplicationDesc.ModeDesc.Format)
+	{
+		case DXGI_FORMAT_R16G16B16A16_FLOAT: { Source->Format = SurfaceFormat_RGBA16F; } break;
+		case DXGI_FORMAT_R10G10B10A2_UNORM:  { Source->Format = SurfaceFormat_RGB10A2; } break;
+		default:                             { Source->Format = SurfaceFormat_BGRA8;   } break;
+	}
+	
+	Source->WhiteNits     = (Source->Format != SurfaceFormat_BGRA8) ? GetOutputWhiteNits(Source->Output1) : SCRGB_WHITE_NITS;
+	Source->WhiteNitsTime = GetTickCount64();
+	
+	// @Note Physical pixels and already rotated, whatever the DPI awareness of the process
+	DXGI_OUTPUT_DESC OutputDesc;
+	HRESULT Result = Source->Output1->GetDesc(&OutputDesc);
+	if (SUCCEEDED(Result))
+	{
+		RECT *Desktop = &OutputDesc.DesktopCoordinates;
+		Source->DesktopWidth  = Desktop->right  - Desktop->left;
+		Source->DesktopHeight = Desktop->bottom - Desktop->top;
+	}
+}
+
+// @Note Made on the other adapter's device like the desktop and opened on ours, bindable like the desktop
+// so the crop and the sampling take it the same way
+internal bool CreateSharedTexture(dxgi_duplication_source *Source, D3D11_TEXTURE2D_DESC *DesktopDesc)
+{
+	HRESULT Result;
+	
+	D3D11_TEXTURE2D_DESC SharedDesc = {};
+	SharedDesc.Width              = DesktopDesc->Width;
+	SharedDesc.Height             = DesktopDesc->Height;
+	SharedDesc.MipLevels          = 1;
+	SharedDesc.ArraySize          = 1;
+	SharedDesc.Format             = DesktopDesc->Format;
+	SharedDesc.SampleDesc.Count   = 1;
+	SharedDesc.SampleDesc.Quality = 0;
+	SharedDesc.Usage              = D3D11_USAGE_DEFAULT;
+	SharedDesc.BindFlags          = D3D11_BIND_SHADER_RESOURCE | D3D11_BIND_RENDER_TARGET;
+	SharedDesc.MiscFlags          = D3D11_RESOURCE_MISC_SHARED_KEYEDMUTEX;
+	
+	IDXGIResource *Resource = NULL;
+	HANDLE Handle = NULL;
+	
+	Result = Source->ForeignDevice->CreateTexture2D(&SharedDesc, NULL, &Source->ForeignTexture);
+	if (SUCCEEDED(Result))
+	{
+		Result = Source->ForeignTexture->QueryInterface(__uuidof(IDXGIKeyedMutex), (void **)&Source->ForeignMutex);
+	}
+	
+	if (SUCCEEDED(Result))
+	{
+		Result = Source->ForeignTexture->QueryInterface(__uuidof(IDXGIResource), (void **)&Resource);
+	}
+	
+	if (SUCCEEDED(Result))
+	{
+		Result = Resource->GetSharedHandle(&Handle);
+	}
+	
+	AcquireSRWLockShared(&Source->D3D->Lock);
+	if (SUCCEEDED(Result))
+	{
+		ID3D11Device *Device = Source->D3D->Device;
+		Result = Device ? Device->OpenSharedResource(Handle, __uuidof(ID3D11Texture2D), (void **)&Source->SharedTexture) : E_FAIL;
+	}
+	ReleaseSRWLockShared(&Source->D3D->Lock);
+	
+	if (SUCCEEDED(Result))
+	{
+		Result = Source->SharedTexture->QueryInterface(__uuidof(IDXGIKeyedMutex), (void **)&Source->SharedMutex);
+	}
+	
+	ReleaseObject(Resource);
+	
+	if (FAILED(Result))
+	{
+		CloseSharedTexture(Source);
+		return false;
+	}
+	
+	return true;
+}
+
+internal void CopyForeignRegion(dxgi_duplication_source *Source, box Region)
+{
+	if (BoxIsEmpty(Region))
+	{
+		return;
+	}
+	
+	D3D11_BOX RegionBox;
+	RegionBox.left   = Region.Left;
+	RegionBox.top    = Region.Top;
+	RegionBox.right  = Region.Right;
+	RegionBox.bottom = Region.Bottom;
+	RegionBox.front  = 0;
+	RegionBox.back   = 1;
+	
+	Source->ForeignContext->CopySubresourceRegion(Source->ForeignTexture, 0, Region.Left, Region.Top, 0,
+												  Source->DesktopTexture, 0, &RegionBox);
+}
+
+// @Note Puts the frame from the other adapter in the shared texture and takes that for our device, the release
+// hands it back. Only what the metadata says changed is copied, the texture keeps the rest from the last frame.
+// A new texture or a frame without metadata is copied whole. Returns false if the handover failed.
+internal bool CopyForeignFrame(dxgi_duplication_source *Source, captured_frame *Frame, u32 TimeoutMS)
+{
+	HRESULT Result;
+	
+	D3D11_TEXTURE2D_DESC DesktopDesc;
+	Source->DesktopTexture->GetDesc(&DesktopDesc);
+	
+	if (Source->ForeignTexture)
+	{
+		D3D11_TEXTURE2D_DESC SharedDesc;
+		Source->ForeignTexture->GetDesc(&SharedDesc);
+		if ((SharedDesc.Width != DesktopDesc.Width) || (SharedDesc.Height != DesktopDesc.Height) ||
+			(SharedDesc.Format != DesktopDesc.Format))
+		{
+			CloseSharedTexture(Source);
+		}
+	}
+	
+	bool CopyWhole = !Source->ForeignTexture || Frame->SourceWasReset || !Frame->MetadataIsValid;
+	if (!Source->ForeignTexture && !CreateSharedTexture(Source, &DesktopDesc))
+	{
+		return false;
+	}
+	
+	// @Note Key 0 is back as soon as the render thread released the last frame, which it did before asking for this one
+	Result = Source->ForeignMutex->AcquireSync(0, TimeoutMS);
+	if (Result != S_OK)
+	{
+		return false;
+	}
+	
+	if (CopyWhole)
+	{
+		Source->ForeignContext->CopyResource(Source->ForeignTexture, Source->DesktopTexture);
+	}
+	else
+	{
+		for (u32 MoveIndex = 0; MoveIndex < Frame->MoveRectCount; ++MoveIndex)
+		{
+			CopyForeignRegion(Source, Frame->MoveRects[MoveIndex].Destination);
+		}
+		
+		for (u32 DirtyIndex = 0; DirtyIndex < Frame->DirtyRectCount; ++DirtyIndex)
+		{
+			CopyForeignRegion(Source, Frame->DirtyRects[DirtyIndex]);
+		}
+	}
+	
+	Source->ForeignMutex->ReleaseSync(1);
+	
+	AcquireSRWLockShared(&Source->D3D->Lock);
+	Result = Source->SharedMutex->AcquireSync(1, TimeoutMS);
+	ReleaseSRWLockShared(&Source->D3D->Lock);
+	
+	if (Result != S_OK)
+	{
+		return false;
+	}
+	
+	Source->SharedIsHeld = true;
+	return true;
+}
+
+internal void DropDuplication(dxgi_duplication_source *Source)
+{
+	Source->OutputDuplication->Release();
+	Source->OutputDuplication = NULL;
+}
+
+internal FRAME_SOURCE_RELEASE(DuplicationRelease)
+{
+	dxgi_duplication_source *Source = (dxgi_duplication_source *)Context;
+	
+	// @Note Back to the worker for the next copy
+	if (Source->SharedIsHeld)
+	{
+		AcquireSRWLockShared(&Source->D3D->Lock);
+		Source->SharedMutex->ReleaseSync(0);
+		ReleaseSRWLockShared(&Source->D3D->Lock);
+		Source->SharedIsHeld = false;
+	}
+	
+	Source->DesktopTexture->Release();
+	Source->DesktopResource->Release();
+	Source->DesktopTexture  = NULL;
+	Source->DesktopResource = NULL;
+	
+	HRESULT Result = Source->OutputDuplication->ReleaseFrame();
+	if (FAILED(Result))
+	{
+		if ((Result == DXGI_ERROR_ACCESS_LOST) || (Result == DXGI_ERROR_INVALID_CALL) || IsDeviceLoss(Result))
+		{
+			DropDuplication(Source);
+			return false;
+		}
+		else
+		{
+			Error("ReleaseFrame");
+		}
+	}
+	
+	return true;
+}
+
+internal FRAME_SOURCE_ACQUIRE(DuplicationAcquire)
+{
+	dxgi_duplication_source *Source = (dxgi_duplication_source *)Context;
+	HRESULT Result;
+	
+	// @Note The render thread rebuilt the device: the duplication and the outputs belong to the old one.
+	// Until the outputs are found again on the new one, every acquire is lost and tries again.
+	u32 Generation = AtomicLoadU32(&Source->D3D->Generation);
+	if (Source->Generation != Generation)
+	{
+		if (Source->OutputDuplication)
+		{
+			DropDuplication(Source);
+		}
+		CloseDuplicationOutput(Source);
+		
+		if (!OpenDuplicationOutput(Source))
+		{
+			Sleep(TimeoutMS);
+			return AcquireResult_Lost;
+		}
+		
+		Source->Generation = Generation;
+	}
+	
+	// @Note Only an output on another adapter is ever left closed, its device was lost or never made
+	if (!Source->Output1 && !OpenDuplicationOutput(Source))
+	{
+		Sleep(TimeoutMS);
+		return AcquireResult_Lost;
+	}
+	
+	if (Source->OutputDuplication == NULL)
+	{
+		AcquireSRWLockShared(&Source->D3D->Lock);
+		
+		ID3D11Device *Device = Source->ForeignDevice ? Source->ForeignDevice : Source->D3D->Device;
+		// @Note FP16 first, an scRGB desktop is what DWM composes an HDR output in. Anything but E_ACCESSDENIED
+		// from DuplicateOutput1 means this process can't have it, DPI awareness for one, so it isn't tried again.
+		// A lost device fails both, the Output5 is kept for the next one then.
+		Result = E_FAIL;
+		if (Device && Source->Output5)
+		{
+			DXGI_FORMAT Formats[] = { DXGI_FORMAT_R16G16B16A16_FLOAT, DXGI_FORMAT_R10G10B10A2_UNORM, DXGI_FORMAT_B8G8R8A8_UNORM };
+			Result = Source->Output5->DuplicateOutput1(Device, 0, GetArrayCount(Formats), Formats, &Source->OutputDuplication);
+			if (FAILED(Result) && (Result != E_ACCESSDENIED) && !IsDeviceLoss(Result))
+			{
+				Source->Output5->Release();
+				Source->Output5 = NULL;
+			}
+		}
+		
+		if (Device && !Source->Output5)
+		{
+			Result = Source->Output1->DuplicateOutput(Device, &Source->OutputDuplication);
+		}
+		
+		ReleaseSRWLockShared(&Source->D3D->Lock);
+		
+		if (FAILED(Result))
+		{
+			Source->OutputDuplication = NULL;
+			if (Source->ForeignDevice && IsDeviceLoss(Result))
+			{
+				CloseForeignDevice(Source);
+			}
+			
+			if ((Result == E_ACCESSDENIED) || !Device || IsDeviceLoss(Result))
+			{
+				Sleep(100);
+				return AcquireResult_Lost;
+			}
+			else
+			{
+				Error("DuplicateOutput");
+			}
+		}
+		
+		GetOutputGeometry(Source);
+		Source->DuplicationIsNew = true;
+	}
+	
+	DXGI_OUTDUPL_FRAME_INFO FrameInfo;
+	Result = Source->OutputDuplication->AcquireNextFrame(TimeoutMS, &FrameInfo, &Source->DesktopResource);
+	if (FAILED(Result))
+	{
+		if (Result == DXGI_ERROR_WAIT_TIMEOUT)
+		{
+			return AcquireResult_Timeout;
+		}
+		else if ((Result == DXGI_ERROR_ACCESS_LOST) || (Result == DXGI_ERROR_INVALID_CALL) || IsDeviceLoss(Result))
+		{
+			// @Note INVALID_CALL too, that's what a duplication on a device that was removed says
+			DropDuplication(Source);
+			if (Source->ForeignDevice && FAILED(Source->ForeignDevice->GetDeviceRemovedReason()))
+			{
+				CloseForeignDevice(Source);
+			}
+			
+			return AcquireResult_Lost;
+		}
+		else
+		{
+			Error("AcquireNextFrame");
+		}
+	}
+	
+	Result = Source->DesktopResource->QueryInterface(__uuidof(ID3D11Texture2D), (void **)&Source->DesktopTexture);
+	if (FAILED(Result))
+	{
+		Error("QueryInterface(ID3D11Texture2D)");
+	}
+	
+	// @Note The slider only matters on an HDR desktop. When it moved, everything already converted was converted
+	// with the old white, the frame goes out as a reset so the render thread crops all of it again.
+	bool WhiteNitsChanged = false;
+	if ((Source->Format != SurfaceFormat_BGRA8) && (GetTickCount64() - Source->WhiteNitsTime >= WHITE_LEVEL_CHECK_MS))
+	{
+		float WhiteNits = GetOutputWhiteNits(Source->Output1);
+		WhiteNitsChanged = (WhiteNits != Source->WhiteNits);
+		
+		Source->WhiteNits     = WhiteNits;
+		Source->WhiteNitsTime = GetTickCount64();
+	}
+	
+	Frame->Format            = Source->Format;
+	Frame->WhiteNits         = Source->WhiteNits;
+	Frame->Rotation          = Source->Rotation;
+	Frame->DesktopWidth      = Source->DesktopWidth;
+	Frame->DesktopHeight     = Source->DesktopHeight;
+	Frame->LastPresentTime   = FrameInfo.LastPresentTime.QuadPart;
+	Frame->AccumulatedFrames = FrameInfo.AccumulatedFrames;
+	
+	// @Note The first frame of a duplication is the whole desktop, whatever the render thread had is stale
+	Frame->SourceWasReset    = Source->DuplicationIsNew || WhiteNitsChanged;
+	Source->DuplicationIsNew = false;
+	
+	GetFrameMetadata(Source, &FrameInfo, Frame);
+	
+	// @Note A frame from another adapter is cropped from our copy of it. When the copy fails the duplication goes,
+	// the next one starts with a whole image.
+	Frame->Surface = Source->DesktopTexture;
+	if (Source->ForeignDevice)
+	{
+		if (!CopyForeignFrame(Source, Frame, TimeoutMS))
+		{
+			DuplicationRelease(Source, Frame);
+			if (Source->OutputDuplication)
+			{
+				DropDuplication(Source);
+			}
+			CloseSharedTexture(Source);
+			
+			return AcquireResult_Lost;
+		}
+		
+		Frame->Surface = Source->SharedTexture;
+	}
+	
+	return AcquireResult_Frame;
+}
+
+// @Note There is no way to get the last image back after ReleaseFrame, but the first
+// frame of a new duplication is always the whole desktop and it comes right away
+internal FRAME_SOURCE_INVALIDATE(DuplicationInvalidate)
+{
+	dxgi_duplication_source *Source = (dxgi_duplication_source *)Context;
+	
+	if (Source->OutputDuplication)
+	{
+		DropDuplication(Source);
+	}
+}
+
+internal frame_source DuplicationFrameSource(dxgi_duplication_source *Source)
+{
+	frame_source Result;
+	Result.Context    = Source;
+	Result.Acquire    = DuplicationAcquire;
+	Result.Release    = DuplicationRelease;
+	Result.Invalidate = DuplicationInvalidate;
+	Result.Select     = NULL;
+	
+	return Result;
+}
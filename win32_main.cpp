@@ -4,30 +4,78 @@
 
 #define DEBUG_BUILD 0
 
+// @Note 1 writes per-stage latency to overlay_latency.csv in the working directory every few seconds,
+// 2 writes overlay_latency.json with the histogram buckets as well
+#define LATENCY_REPORT 0
+
+// @Note 1 draws the pieces straight from the acquired desktop when it can instead of copying them out first
+#define SAMPLE_SURFACES 0
+
+// @Note 1 has the output workers copy every frame into a capture ring and release it straight away,
+// the render thread crops from the newest copy instead of holding the desktop until it is done
+#define CAPTURE_RING 0
+
+// @Note 1 publishes every presented frame's display texture into a ring in the shared memory named below,
+// for other processes to read without a desktop duplication of their own, see overlay_export.cpp
+#define FRAME_EXPORT 0
+#define FRAME_EXPORT_NAME L"Local\\overlay_export"
+
+// @Note 1 exports the frames as NV12, BT.709 limited range, for an encoder to take as they are, see overlay_yuv.cpp
+#define FRAME_EXPORT_YUV 0
+
+// @Note 1 records every presented frame into the file below, read back from the GPU a few frames late,
+// see overlay_recording.cpp. The Linux build replays it with -replay.
+#define FRAME_RECORD 0
+#define FRAME_RECORD_NAME "overlay.rec"
+
+// @Note 1 reads small crops back to skip the draw and present when they copied the same pixels again,
+// see D3D11DetectChanges. 0 presents every damaged frame.
+#define DETECT_CHANGES 1
+
+// @Note The effect_flag bits the overlay draws with, e.g. Effect_Grayscale | Effect_Contrast. Anything but 0 draws
+// bilinear through that key's shader permutation, see overlay_effects.cpp.
+#define OVERLAY_EFFECTS 0
+
+// @Note build.cmd builds with BAKE_SHADERS 1 first, which writes every shader into win32_shaders.h and exits,
+// then with EMBEDDED_SHADERS 1 to link them in. Without them the shaders come from the cache or get compiled.
+#ifndef BAKE_SHADERS
+#define BAKE_SHADERS 0
+#endif
+
+#ifndef EMBEDDED_SHADERS
+#define EMBEDDED_SHADERS 0
+#endif
+
+// @Note Compiled shaders kept in overlay_shader_cache, the oldest go past this
+#define SHADER_CACHE_BUDGET Megabytes(8)
+
 #include <d3d11.h>
+#include <d3d11_4.h>
 #include <dxgi1_2.h>
+#include <dxgi1_3.h>
+#include <dxgi1_6.h>
 #include <d3dcompiler.h>
 #include <dcomp.h>
 #include <windows.h>
 
-#define internal	static
-#define global		static
+#include "overlay.cpp"
+
+// @Note Longest the render thread waits for a desktop update before looking at commands again
+#define FRAME_WAIT_SLICE_MS 8
 
 #define SC_GRAVE		0x0029
 #define SC_NUMPAD_5		0x004C
 #define SC_CONTROLLEFT	0x001D
+#define SC_SHIFTLEFT	0x002A
 
-#define GetArrayCount(Array)	(sizeof(Array) / sizeof((Array)[0]))
-#define Min(A, B)				((A) < (B) ? (A) : (B))
-#define Max(A, B)				((A) > (B) ? (A) : (B))
+// @Note The dumper drains the rings this often, they hold a few thousand samples each
+#define LATENCY_DRAIN_MS 100
+#define LATENCY_WRITE_DRAINS 50
 
-extern "C" int _fltused = 0;
+// @Note How far each new overlay window lands from the last one
+#define WINDOW_CASCADE_STEP 32
 
-struct v2
-{
-	float X;
-	float Y;
-};
+extern "C" int _fltused = 0;
 
 struct vertex
 {
@@ -39,11 +87,19 @@ union vertex_constant_buffer
 {
 	struct
 	{
-		v2 TextureTransform;
+		overlay_instance Instances[MAX_CROP_PIECES];
 	};
 	
 	// Must be in multiples of 16
-	char Buffer[16];
+	char Buffer[MAX_CROP_PIECES * sizeof(overlay_instance)];
+};
+
+// @Note Where DXGI lists the output and where the window thread sees it on the virtual desktop
+struct win32_output
+{
+	u32 AdapterIndex;
+	u32 OutputIndex;
+	box Rect;
 };
 
 //
@@ -52,37 +108,24 @@ union vertex_constant_buffer
 
 global HRESULT Result;
 
-// @Note These are fallback default values, in case of error 
+// @Note These are fallback default values, in case of error. The primary output's size.
 global int MonitorWidth  = 1920;
 global int MonitorHeight = 1080;
 
-global int DisplayWidth  = 200;
-global int DisplayHeight = 200;
+// @Note Every output on the desktop, the primary first
+global u32 OutputCount;
+global win32_output Outputs[MAX_OUTPUTS];
 
-global D3D11_BOX GlobalCutBox;
+// @Note Everything the window thread controls, the render thread gets a consistent copy once per frame
+global render_state_exchange RenderStateExchange;
+global render_command_queue  RenderCommands;
 
-global int RenderThreadCBufferVersion = 0;
-global int WindowThreadCBufferVersion = 0;
-global vertex_constant_buffer CBuffer = {
-	1.0f / (1280.0f / 200.0f), 
-	1.0f / (1024.0f / 200.0f), 
-};
+global s64 PerformanceFrequency;
 
 //
 // Functions
 //
 
-internal size_t GetStringLength(char *String)
-{
-	size_t Length = 0;
-	for (; String[Length] != '\0'; ++Length)
-	{
-		// Do nothing
-	}
-	
-	return Length;
-}
-
 internal void Error(char *ErrorCause)
 {
 	char ErrorMessage[1024] = "ERROR";
@@ -108,571 +151,541 @@ internal void Error(char *ErrorCause)
 	ExitProcess(1);
 }
 
-struct shader_data
+
+#include "win32_d3d11.cpp"
+
+internal u64 Win32GetMicroseconds()
 {
-	void  *Data;
-	size_t Size;
-};
+	LARGE_INTEGER Counter;
+	QueryPerformanceCounter(&Counter);
+	
+	// @Note Split so the multiply doesn't overflow after a few days of uptime
+	s64 Seconds   = Counter.QuadPart / PerformanceFrequency;
+	s64 Remainder = Counter.QuadPart % PerformanceFrequency;
+	
+	return (u64)(Seconds * 1000000 + (Remainder * 1000000) / PerformanceFrequency);
+}
 
-internal shader_data CompileShader(char *ShaderSource, size_t ShaderSourceSize, char *EntryPoint)
+internal PLATFORM_GET_NANOSECONDS(Win32GetNanoseconds)
 {
-	int Flags = 
-	(DEBUG_BUILD * D3DCOMPILE_DEBUG) | 
-	(DEBUG_BUILD * D3DCOMPILE_OPTIMIZATION_LEVEL3) | (              D3DCOMPILE_ENABLE_STRICTNESS) | (              D3DCOMPILE_PARTIAL_PRECISION);
+	LARGE_INTEGER Counter;
+	QueryPerformanceCounter(&Counter);
+	
+	s64 Seconds   = Counter.QuadPart / PerformanceFrequency;
+	s64 Remainder = Counter.QuadPart % PerformanceFrequency;
 	
-	char *Target;
-	if (EntryPoint == "VertexMain")
+	return (u64)(Seconds * 1000000000 + (Remainder * 1000000000) / PerformanceFrequency);
+}
+
+internal OVERLAY_CLOCK_NOW(Win32ClockNow)
+{
+	return Win32GetMicroseconds();
+}
+
+internal PLATFORM_WAIT_EVENT(Win32WaitEvent)
+{
+	return WaitForSingleObject((HANDLE)Event, TimeoutMS) == WAIT_OBJECT_0;
+}
+
+internal PLATFORM_SIGNAL_EVENT(Win32SignalEvent)
+{
+	SetEvent((HANDLE)Event);
+}
+
+internal HANDLE Win32CreateEvent()
+{
+	// @Note Auto reset, a wait lets one wake through
+	HANDLE Event = CreateEventW(NULL, FALSE, FALSE, NULL);
+	if (Event == NULL)
 	{
-		Target = "vs_4_0";
+		Error("CreateEventW");
 	}
-	else if (EntryPoint == "PixelMain")
+	
+	return Event;
+}
+
+internal PLATFORM_ALLOCATE_MEMORY(Win32AllocateMemory)
+{
+	return VirtualAlloc(NULL, Size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+}
+
+internal PLATFORM_FREE_MEMORY(Win32FreeMemory)
+{
+	VirtualFree(Memory, 0, MEM_RELEASE);
+}
+
+//
+// Files, for the shader cache
+//
+
+internal PLATFORM_READ_FILE(Win32ReadFile)
+{
+	HANDLE File = CreateFileA(Path, GENERIC_READ, FILE_SHARE_READ | FILE_SHARE_DELETE, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (File == INVALID_HANDLE_VALUE)
 	{
-		EntryPoint = "PixelMain";
-		Target = "ps_4_0";
+		return false;
 	}
-	else
+	
+	LARGE_INTEGER Size;
+	bool Read = GetFileSizeEx(File, &Size) != 0;
+	*FileSize = Read ? (size_t)Size.QuadPart : 0;
+	
+	DWORD ReadSize = (DWORD)Min(MemorySize, *FileSize);
+	DWORD BytesRead = 0;
+	if (Read && ReadSize)
 	{
-		Error("CompileShader: Unknown Shader Target, Vertex/Pixel");
+		Read = (ReadFile(File, Memory, ReadSize, &BytesRead, NULL) != 0) && (BytesRead == ReadSize);
 	}
 	
-	ID3DBlob *OutputBlob;
-	ID3DBlob *ErrorBlob;
-	Result = D3DCompile(ShaderSource, ShaderSourceSize, NULL, NULL, NULL, EntryPoint, Target, Flags, 0, &OutputBlob, &ErrorBlob);
-	if (FAILED(Result))
+	CloseHandle(File);
+	return Read;
+}
+
+internal PLATFORM_WRITE_FILE(Win32WriteFile)
+{
+	HANDLE File = CreateFileA(Path, GENERIC_WRITE, 0, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (File == INVALID_HANDLE_VALUE)
 	{
-		char *ErrorMessage		= (char *)ErrorBlob->GetBufferPointer();
-		SIZE_T ErrorMessageSize	= ErrorBlob->GetBufferSize();
-		
-		MessageBoxA(0, EntryPoint, 0, 0);
-		Error(ErrorMessage);
+		return false;
 	}
 	
-	shader_data Shader;
-	Shader.Data = OutputBlob->GetBufferPointer();
-	Shader.Size = OutputBlob->GetBufferSize();
+	DWORD Written = 0;
+	bool Wrote = (WriteFile(File, Memory, (DWORD)Size, &Written, NULL) != 0) && (Written == Size);
 	
-	return Shader;
+	CloseHandle(File);
+	return Wrote;
 }
 
-internal LRESULT CALLBACK WindowProc(HWND Window, UINT Message, WPARAM WParam, LPARAM LParam)
+internal PLATFORM_REPLACE_FILE(Win32ReplaceFile)
 {
-	LRESULT Result = 0;
+	return MoveFileExA(From, To, MOVEFILE_REPLACE_EXISTING | MOVEFILE_WRITE_THROUGH) != 0;
+}
+
+internal PLATFORM_DELETE_FILE(Win32DeleteFile)
+{
+	DeleteFileA(Path);
+}
+
+internal PLATFORM_LIST_FILES(Win32ListFiles)
+{
+	char Pattern[MAX_PATH];
+	text_buffer Text = { Pattern, MAX_PATH - 1, 0 };
+	AppendText(&Text, Directory);
+	AppendText(&Text, "/*");
+	Pattern[Text.Used] = 0;
+	
+	WIN32_FIND_DATAA Found;
+	HANDLE Find = FindFirstFileA(Pattern, &Found);
+	if (Find == INVALID_HANDLE_VALUE)
+	{
+		return 0;
+	}
 	
-	switch (Message)
+	u32 FileCount = 0;
+	do
 	{
-		case WM_NCHITTEST:
+		size_t NameLength = GetStringLength(Found.cFileName);
+		if ((Found.dwFileAttributes & FILE_ATTRIBUTE_DIRECTORY) || (NameLength >= sizeof(Files->Name)))
 		{
-			return HTNOWHERE;
+			continue;
 		}
-		break;
 		
-		case WM_CLOSE:
-		{
-			PostQuitMessage(0);
-		}
-		break;
-		
-		case WM_ERASEBKGND:
-		{
-			Result = 1; // @Note Pretend we cleared the background because we don't care
-		}
-		break;
-		
-		default:
-		{
-			Result = DefWindowProcW(Window, Message, WParam, LParam);
-		}
-		break;
-	}
-	
-	return Result;
+		platform_file_info *File = &Files[FileCount++];
+		CopyBytes(File->Name, Found.cFileName, NameLength + 1);
+		File->Size      = ((u64)Found.nFileSizeHigh << 32) | Found.nFileSizeLow;
+		File->WriteTime = (((u64)Found.ftLastWriteTime.dwHighDateTime << 32) | Found.ftLastWriteTime.dwLowDateTime) * 100;
+	} while ((FileCount < MaxCount) && FindNextFileA(Find, &Found));
+	
+	FindClose(Find);
+	return FileCount;
 }
 
-internal void Direct3DCreateDevice(ID3D11Device **Device, ID3D11DeviceContext **DeviceContext)
+global platform_file_api Win32Files =
 {
-	int DeviceFlags = 
-		D3D11_CREATE_DEVICE_SINGLETHREADED | 
-		D3D11_CREATE_DEVICE_BGRA_SUPPORT | 
-	(DEBUG_BUILD * D3D11_CREATE_DEVICE_DEBUG);
-	
-	D3D_FEATURE_LEVEL FeatureLevel = D3D_FEATURE_LEVEL_10_0;
-	Result = D3D11CreateDevice(NULL, D3D_DRIVER_TYPE_HARDWARE, NULL, DeviceFlags, &FeatureLevel, 
-							   1, D3D11_SDK_VERSION, Device, NULL, DeviceContext);
-	
-	if (FAILED(Result))
-	{
-		Error("D3D11CreateDevice");
-	}
-}
+	Win32ReadFile,
+	Win32WriteFile,
+	Win32ReplaceFile,
+	Win32DeleteFile,
+	Win32ListFiles,
+};
 
-internal DWORD WINAPI RenderThread(LPVOID lpParameter)
+// @Note In the working directory like the latency report, shared by every overlay process run from it
+internal void InitializeWin32ShaderCache(shader_cache *Cache)
 {
-	HWND Window = (HWND)lpParameter;
-	
-	//
-	// Initialize the Direct3D Device and DeviceContext
-	//
-	
-	ID3D11Device		*Device;
-	ID3D11DeviceContext	*DeviceContext;
+	char *Directory = "overlay_shader_cache";
+	CreateDirectoryA(Directory, NULL);
 	
-	Direct3DCreateDevice(&Device, &DeviceContext);
-	
-	//
-	// Primitive Topology
-	//
-	
-	DeviceContext->IASetPrimitiveTopology(D3D_PRIMITIVE_TOPOLOGY_TRIANGLELIST);
-	
-	//
-	// Shader compilation
-	//
-	
-	char *ShaderSource = 
-	R"RAW(
-					cbuffer CBuffer { float2 TextureTransform; };
-					
-					struct VSOutput { float4 pos : SV_POSITION; float2 tex : TEXCOORD0; };
-					
-					VSOutput VertexMain(uint ID : SV_VERTEXID)
-					{
-			// Full-screen Triangle from SV_VERTEXID
-						VSOutput Output;
-						Output.pos.x = (float)(ID / 2) * 4.0f - 1.0f;
-						Output.pos.y = (float)(ID % 2) * 4.0f - 1.0f;
-						Output.pos.z = 0.0f;
-						Output.pos.w = 1.0f;
-						
-						Output.tex.x = 0.0f + (float)(ID / 2) * 2.0f;
-						Output.tex.y = 1.0f - (float)(ID % 2) * 2.0f;
-						
-						// Draw only the cut region from CopySubresourceRegion
-						Output.tex.xy *= TextureTransform.xy;
-						
-						return Output;
-					}
-					
-					SamplerState Sampler;
-					Texture2D    Texture;
-					float4 PixelMain(VSOutput Input) : SV_TARGET
-					{
-						float4 Output = Texture.Sample(Sampler, Input.tex.xy);
-						
-float Alpha  = 0.1f;
-						float Darken = 0.1f;
-
-// Set alpha
-						Output.a = Alpha;
+	InitializeShaderCache(Cache, &Win32Files, Win32AllocateMemory, Win32FreeMemory, Directory, SHADER_CACHE_BUDGET,
+						  GetCurrentProcessId());
+}
 
-// Darken RGB absolute
-						Output.rgb = (Output.rgb - Darken) * Alpha;
-						
-						return Output;
-					}
-				)RAW";
+//
+// Writes every shader permutation into win32_shaders.h, for build.cmd to build again with them embedded.
+// Goes through the cache like a normal start, so a bake right after another one doesn't compile anything.
+//
+internal void BakeShaders()
+{
+	shader_cache Cache;
+	InitializeWin32ShaderCache(&Cache);
 	
-	size_t ShaderSize = GetStringLength(ShaderSource);
+	d3d11_shader_loader Loader;
+	InitializeShaderLoader(&Loader, &Cache, Win32GetNanoseconds);
 	
-	shader_data VertexShaderData = CompileShader(ShaderSource, ShaderSize, "VertexMain");
-	shader_data PixelShaderData  = CompileShader(ShaderSource, ShaderSize, "PixelMain");
+	// @Note Only the built-in source gets embedded, a user's own is looked up at runtime
+	Loader.ShadeSourcePath   = "";
+	Loader.ConvertSourcePath = "";
 	
-	ID3D11VertexShader *VertexShader;
-	Result = Device->CreateVertexShader(VertexShaderData.Data, VertexShaderData.Size, NULL, &VertexShader);
-	if (FAILED(Result))
-	{
-		Error("CreateVertexShader");
-	}
+	d3d11_shader_code Code;
+	LoadD3D11Shaders(&Code, &Loader);
+	LoadD3D11EffectShader(&Code, &Loader, OVERLAY_EFFECTS);
 	
-	ID3D11PixelShader *PixelShader;
-	Result = Device->CreatePixelShader(PixelShaderData.Data, PixelShaderData.Size, NULL, &PixelShader);
-	if (FAILED(Result))
+	text_buffer Text;
+	Text.Size   = Megabytes(4);
+	Text.Used   = 0;
+	Text.Memory = (char *)Win32AllocateMemory(Text.Size);
+	if (Text.Memory == NULL)
 	{
-		Error("CreatePixelShader");
+		Error("VirtualAlloc");
 	}
 	
-	DeviceContext->VSSetShader(VertexShader, NULL, 0);
-	DeviceContext->PSSetShader(PixelShader,  NULL, 0);
-	
-	//
-	// Constant buffer
-	//
-	
-	D3D11_BUFFER_DESC BufferDescription;
-	BufferDescription.ByteWidth           = sizeof(CBuffer);
-	BufferDescription.Usage               = D3D11_USAGE_DYNAMIC;
-	BufferDescription.BindFlags           = D3D11_BIND_CONSTANT_BUFFER;
-	BufferDescription.CPUAccessFlags      = D3D11_CPU_ACCESS_WRITE;
-	BufferDescription.MiscFlags           = 0;
-	BufferDescription.StructureByteStride = 0;
-	
-	D3D11_SUBRESOURCE_DATA ConstantBufferResource;
-	ConstantBufferResource.pSysMem = &CBuffer;
-	ConstantBufferResource.SysMemPitch = 0;
-	ConstantBufferResource.SysMemSlicePitch = 0;
-	
-	ID3D11Buffer *ConstantBuffer;
-	Result = Device->CreateBuffer(&BufferDescription, &ConstantBufferResource, &ConstantBuffer);
-	if (Result != S_OK)
+	WriteEmbeddedShaders(&Text, Loader.Baked, Loader.BakedCount);
+	if ((Text.Used == Text.Size) || !Win32WriteFile("win32_shaders.h", Text.Memory, Text.Used))
 	{
-		Error("CreateBuffer");
+		Error("WriteFile(win32_shaders.h)");
 	}
 	
-	DeviceContext->VSSetConstantBuffers(0, 1, &ConstantBuffer);
-	
-	//
-	// Texture
-	//
-	
-	D3D11_TEXTURE2D_DESC TextureDesc;
-	TextureDesc.Width          = MonitorWidth;
-	TextureDesc.Height         = MonitorHeight;
-	TextureDesc.MipLevels      = 1;
-	TextureDesc.ArraySize      = 1;
-	TextureDesc.Format         = DXGI_FORMAT_B8G8R8A8_UNORM;// @Todo Should it be sRGB here
-	TextureDesc.SampleDesc     = DXGI_SAMPLE_DESC{ 1, 0 };
-	TextureDesc.Usage          = D3D11_USAGE_DEFAULT;
-	TextureDesc.BindFlags      = D3D11_BIND_SHADER_RESOURCE;
-	TextureDesc.CPUAccessFlags = 0;
-	TextureDesc.MiscFlags      = 0;
-	
-	ID3D11Texture2D *DisplayTexture;
-	Result = Device->CreateTexture2D(&TextureDesc, NULL, &DisplayTexture);
+	ExitProcess(0);
+}
+
+//
+// Lists the outputs attached to the desktop. Rects come from the monitor, not the output description,
+// so they are in the same coordinates as the cursor and the windows whatever the DPI awareness.
+//
+internal void EnumerateOutputs()
+{
+	IDXGIFactory1 *Factory;
+	Result = CreateDXGIFactory1(__uuidof(IDXGIFactory1), (void **)&Factory);
 	if (FAILED(Result))
 	{
-		Error("CreateTexture2D");
+		Error("CreateDXGIFactory1");
 	}
 	
-	D3D11_SHADER_RESOURCE_VIEW_DESC ShaderResourceViewDesc;
-	ShaderResourceViewDesc.Format                    = DXGI_FORMAT_B8G8R8A8_UNORM;
-	ShaderResourceViewDesc.ViewDimension             = D3D11_SRV_DIMENSION_TEXTURE2D;// @Todo Should it be sRGB here
-	ShaderResourceViewDesc.Texture2D.MostDetailedMip = 0;
-	ShaderResourceViewDesc.Texture2D.MipLevels       = 1;
-	
-	ID3D11ShaderResourceView *TextureView;
-	Result = Device->CreateShaderResourceView(DisplayTexture, &ShaderResourceViewDesc, &TextureView);
-	if (FAILED(Result))
+	IDXGIAdapter1 *Adapter;
+	for (u32 AdapterIndex = 0; Factory->EnumAdapters1(AdapterIndex, &Adapter) != DXGI_ERROR_NOT_FOUND; ++AdapterIndex)
 	{
-		Error("CreateShaderResourceView");
+		IDXGIOutput *Output;
+		for (u32 OutputIndex = 0; Adapter->EnumOutputs(OutputIndex, &Output) != DXGI_ERROR_NOT_FOUND; ++OutputIndex)
+		{
+			DXGI_OUTPUT_DESC OutputDesc;
+			Result = Output->GetDesc(&OutputDesc);
+			Output->Release();
+			
+			MONITORINFO MonitorInfo;
+			MonitorInfo.cbSize = sizeof(MonitorInfo);
+			
+			if (FAILED(Result) || !OutputDesc.AttachedToDesktop || (OutputCount == MAX_OUTPUTS) ||
+				(GetMonitorInfoW(OutputDesc.Monitor, &MonitorInfo) == 0))
+			{
+				continue;
+			}
+			
+			RECT *Rect = &MonitorInfo.rcMonitor;
+			
+			win32_output *Added = &Outputs[OutputCount++];
+			Added->AdapterIndex = AdapterIndex;
+			Added->OutputIndex  = OutputIndex;
+			Added->Rect.Left    = Rect->left;
+			Added->Rect.Top     = Rect->top;
+			Added->Rect.Right   = Rect->right;
+			Added->Rect.Bottom  = Rect->bottom;
+			
+			if (MonitorInfo.dwFlags & MONITORINFOF_PRIMARY)
+			{
+				win32_output Primary = *Added;
+				*Added     = Outputs[0];
+				Outputs[0] = Primary;
+			}
+		}
+		
+		Adapter->Release();
 	}
 	
-	DeviceContext->PSSetShaderResources(0, 1, &TextureView);
-	
-	//
-	// Texture Sampler
-	//
+	Factory->Release();
 	
-	D3D11_SAMPLER_DESC SamplerDesc;
-	SamplerDesc.Filter         = D3D11_FILTER_MIN_MAG_LINEAR_MIP_POINT;
-	SamplerDesc.AddressU       = D3D11_TEXTURE_ADDRESS_WRAP;
-	SamplerDesc.AddressV       = D3D11_TEXTURE_ADDRESS_WRAP;
-	SamplerDesc.AddressW       = D3D11_TEXTURE_ADDRESS_WRAP;
-	SamplerDesc.MipLODBias     = 0.0f;
-	SamplerDesc.MaxAnisotropy  = 0; // Texture Anisotropic Filtering (TAF)
-	SamplerDesc.ComparisonFunc = D3D11_COMPARISON_NEVER;
-	SamplerDesc.BorderColor[0] = 0.0f;
-	SamplerDesc.BorderColor[1] = 0.0f;
-	SamplerDesc.BorderColor[2] = 0.0f;
-	SamplerDesc.BorderColor[3] = 0.0f;
-	SamplerDesc.MinLOD         = -D3D11_FLOAT32_MAX;
-	SamplerDesc.MaxLOD         = D3D11_FLOAT32_MAX;
-	
-	ID3D11SamplerState *SamplerState;
-	Result = Device->CreateSamplerState(&SamplerDesc, &SamplerState);
-	if(FAILED(Result))
+	if (OutputCount == 0)
 	{
-		Error("CreateSamplerState");
+		win32_output *Fallback = &Outputs[OutputCount++];
+		Fallback->AdapterIndex = 0;
+		Fallback->OutputIndex  = 0;
+		Fallback->Rect         = box{ 0, 0, MonitorWidth, MonitorHeight };
 	}
+}
+
+internal DWORD WINAPI OutputThread(LPVOID lpParameter)
+{
+	output_worker *Worker = (output_worker *)lpParameter;
+	RunOutputWorker(Worker, FRAME_WAIT_SLICE_MS);
 	
-	DeviceContext->PSSetSamplers(0, 1, &SamplerState);
+	return 0;
+}
+
+// @Note Overwrites the report with everything since the start, a failed write (the file is open somewhere) waits for the next one
+internal void WriteLatencyFile(latency_recorder *Recorder, text_buffer *Text)
+{
+	latency_format Format = (LATENCY_REPORT == 2) ? LatencyFormat_JSON : LatencyFormat_CSV;
+	const char *Path = (Format == LatencyFormat_JSON) ? "overlay_latency.json" : "overlay_latency.csv";
 	
-	//
-	// ViewPort
-	//
-#if 0
-	D3D11_VIEWPORT Viewport;
-	Viewport.TopLeftX = 0;
-	Viewport.TopLeftY = 0;
-	Viewport.Width    = DisplayWidth;
-	Viewport.Height   = DisplayHeight;
-	Viewport.MinDepth = 0.0f;
-	Viewport.MaxDepth = 1.0f;
-	
-	DeviceContext->RSSetViewports(1, &Viewport);
-#endif
-	//
-	// SwapChain
-	//
+	Text->Used = 0;
+	WriteLatencyReport(Recorder, Format, Text);
 	
-	IDXGIDevice *DXGIDevice;
-	Result = Device->QueryInterface(__uuidof(IDXGIDevice), (void **)&DXGIDevice);
-	if (FAILED(Result))
+	HANDLE File = CreateFileA(Path, GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS, FILE_ATTRIBUTE_NORMAL, NULL);
+	if (File == INVALID_HANDLE_VALUE)
 	{
-		Error("QueryInterface(IDXGIDevice)");
+		return;
 	}
 	
-	IDXGIAdapter *Adapter;
-	Result = DXGIDevice->GetAdapter(&Adapter);
-	if (FAILED(Result))
-	{
-		Error("GetAdapter");
-	}
+	DWORD Written;
+	WriteFile(File, Text->Memory, (DWORD)Text->Used, &Written, NULL);
+	CloseHandle(File);
+}
+
+internal DWORD WINAPI LatencyThread(LPVOID lpParameter)
+{
+	latency_recorder *Recorder = (latency_recorder *)lpParameter;
 	
-	IDXGIOutput *Output;
-	Result = Adapter->EnumOutputs(0, &Output);
-	if (FAILED(Result))
+	text_buffer Text;
+	Text.Size   = Megabytes(1);
+	Text.Used   = 0;
+	Text.Memory = (char *)VirtualAlloc(NULL, Text.Size, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+	if (Text.Memory == NULL)
 	{
-		Error("EnumOutputs");
+		Error("VirtualAlloc");
 	}
 	
-	IDXGIOutput1 *Output1;
-	Result = Output->QueryInterface(__uuidof(IDXGIOutput1), (void **)&Output1);
-	if (FAILED(Result))
+	for (u32 DrainCount = 1;; ++DrainCount)
 	{
-		Error("QueryInterface(IDXGIOutput1)");
+		Sleep(LATENCY_DRAIN_MS);
+		DrainLatencyRings(Recorder);
+		
+		if ((DrainCount % LATENCY_WRITE_DRAINS) == 0)
+		{
+			WriteLatencyFile(Recorder, &Text);
+		}
 	}
 	
-	IDXGIFactory2 *Factory;
-	Adapter->GetParent(__uuidof(IDXGIFactory2), (void **)&Factory);
-	
-	DXGI_SWAP_CHAIN_DESC1 SwapChainDesc;
-	SwapChainDesc.Width        = MonitorWidth;
-	SwapChainDesc.Height       = MonitorHeight;
-	SwapChainDesc.Format       = DXGI_FORMAT_B8G8R8A8_UNORM;
-	SwapChainDesc.Stereo       = false;
-	SwapChainDesc.SampleDesc   = DXGI_SAMPLE_DESC{ 1, 0 };
-	SwapChainDesc.BufferUsage  = DXGI_USAGE_RENDER_TARGET_OUTPUT;
-	SwapChainDesc.BufferCount  = 2;
-	SwapChainDesc.Scaling      = DXGI_SCALING_STRETCH;
-	SwapChainDesc.SwapEffect   = DXGI_SWAP_EFFECT_FLIP_DISCARD;
-	SwapChainDesc.AlphaMode    = DXGI_ALPHA_MODE_PREMULTIPLIED;
-	SwapChainDesc.Flags        = 0;
+	return 0;
+}
+
+internal LRESULT CALLBACK WindowProc(HWND Window, UINT Message, WPARAM WParam, LPARAM LParam)
+{
+	LRESULT Result = 0;
 	
-	IDXGISwapChain1 *SwapChain;
-	Result = Factory->CreateSwapChainForComposition(Device, &SwapChainDesc, NULL, &SwapChain);
-	if (FAILED(Result))
+	switch (Message)
 	{
-		Error("CreateSwapChain");
+		case WM_NCHITTEST:
+		{
+			return HTNOWHERE;
+		}
+		break;
+		
+		case WM_CLOSE:
+		{
+			PostQuitMessage(0);
+		}
+		break;
+		
+		case WM_ERASEBKGND:
+		{
+			Result = 1; // @Note Pretend we cleared the background because we don't care
+		}
+		break;
+		
+		default:
+		{
+			Result = DefWindowProcW(Window, Message, WParam, LParam);
+		}
+		break;
 	}
 	
+	return Result;
+}
+
+internal DWORD WINAPI RenderThread(LPVOID lpParameter)
+{
+	HWND *Windows = (HWND *)lpParameter;
+	
 	//
-	// Render Target View
+	// Memory
 	//
 	
-	ID3D11Texture2D *BackBuffer;
-	Result = SwapChain->GetBuffer(0, __uuidof(ID3D11Texture2D), (void **)&BackBuffer);
-	if (FAILED(Result))
+	size_t MemorySize = Megabytes(2);
+	void *Memory = VirtualAlloc(NULL, MemorySize, MEM_RESERVE | MEM_COMMIT, PAGE_READWRITE);
+	if (Memory == NULL)
 	{
-		Error("GetBuffer(BackBuffer)");
+		Error("VirtualAlloc");
 	}
 	
-	D3D11_RENDER_TARGET_VIEW_DESC RenderTargetViewDesc;
-	RenderTargetViewDesc.Format             = DXGI_FORMAT_B8G8R8A8_UNORM_SRGB;
-	RenderTargetViewDesc.ViewDimension      = D3D11_RTV_DIMENSION_TEXTURE2D;
-	RenderTargetViewDesc.Texture2D.MipSlice = 0;
-	
-	ID3D11RenderTargetView *RenderTargetView;
-	Result = Device->CreateRenderTargetView(BackBuffer, &RenderTargetViewDesc, &RenderTargetView);
-	if (FAILED(Result))
-	{
-		Error("CreateRenderTargetView");
-	}
+	memory_arena Arena;
+	InitializeArena(&Arena, Memory, MemorySize);
 	
 	//
-	// Direct Composition
+	// Pipeline stages
 	//
 	
-	IDCompositionDevice *CompositionDevice;
-	Result = DCompositionCreateDevice(DXGIDevice, __uuidof(CompositionDevice), (void **)&CompositionDevice);
-	if (FAILED(Result))
-	{
-		Error("DCompositionCreateDevice");
-	}
+	shader_cache ShaderCache;
+	InitializeWin32ShaderCache(&ShaderCache);
 	
-	IDCompositionTarget *CompositionTarget;
-	Result = CompositionDevice->CreateTargetForHwnd(Window, true, &CompositionTarget);
-	if (FAILED(Result))
-	{
-		Error("CreateTargetForHwnd");
-	}
+	d3d11_shader_loader ShaderLoader;
+	InitializeShaderLoader(&ShaderLoader, &ShaderCache, Win32GetNanoseconds);
 	
-	IDCompositionVisual *CompositionVisual;
-	Result = CompositionDevice->CreateVisual(&CompositionVisual);
-	if (FAILED(Result))
+	// @Note The compositor makes the device, and makes it again if it is lost
+	d3d11_device D3D;
+	d3d11_compositor Compositor;
+	InitializeD3D11Compositor(&Compositor, &D3D, Windows, MAX_OVERLAYS, &ShaderLoader, Win32GetNanoseconds);
+	
+	if (DETECT_CHANGES)
 	{
-		Error("CreateVisual");
+		change_detector *Changes = PushStruct(&Arena, change_detector);
+		EnableD3D11ChangeDetection(&Compositor, Changes, Win32AllocateMemory, Win32FreeMemory, GetBestShadeKernel());
 	}
 	
-	Result = CompositionVisual->SetContent((IUnknown *)SwapChain);
-	if (FAILED(Result))
+	// @Note A ring for this thread and one for every output worker, all of them registered before anything records
+	latency_recorder *LatencyRecorder = NULL;
+	latency_ring *LatencyRing = NULL;
+	if (LATENCY_REPORT)
 	{
-		Error("SetContent");
+		LatencyRecorder = PushStruct(&Arena, latency_recorder);
+		InitializeLatencyRecorder(LatencyRecorder);
+		
+		LatencyRing = PushStruct(&Arena, latency_ring);
+		InitializeLatencyRing(LatencyRing, Win32GetNanoseconds);
+		AddLatencyRing(LatencyRecorder, LatencyRing);
+		
+		EnableD3D11GpuTiming(&Compositor, LatencyRing);
 	}
 	
-	Result = CompositionTarget->SetRoot(CompositionVisual);
-	if (FAILED(Result))
+	// @Note Sized for the primary monitor's worth of crops, a frame bigger than that isn't exported. The mapping
+	// stays as long as the process does, readers open it by name.
+	if (FRAME_EXPORT)
 	{
-		Error("SetRoot");
+		u64 PixelBytes = (u64)MonitorWidth * MonitorHeight * BITMAP_BYTES_PER_PIXEL;
+		u64 ExportSize = GetExportRingSize(EXPORT_RING_SLOT_COUNT, PixelBytes);
+		
+		HANDLE Mapping = CreateFileMappingW(INVALID_HANDLE_VALUE, NULL, PAGE_READWRITE, (DWORD)(ExportSize >> 32),
+											(DWORD)ExportSize, FRAME_EXPORT_NAME);
+		void *ExportMemory = Mapping ? MapViewOfFile(Mapping, FILE_MAP_ALL_ACCESS, 0, 0, (SIZE_T)ExportSize) : NULL;
+		if (ExportMemory == NULL)
+		{
+			Error("CreateFileMappingW(FRAME_EXPORT_NAME)");
+		}
+		
+		export_ring *ExportRing = PushStruct(&Arena, export_ring);
+		InitializeExportRing(ExportRing, ExportMemory, EXPORT_RING_SLOT_COUNT, PixelBytes);
+		
+		yuv_converter *ExportConverter = NULL;
+		if (FRAME_EXPORT_YUV)
+		{
+			yuv_format Format = { YUVLayout_NV12, YUVMatrix_BT709, YUVRange_Limited };
+			ExportConverter = PushStruct(&Arena, yuv_converter);
+			InitializeYUVConverter(ExportConverter, Win32AllocateMemory, Win32FreeMemory, Format, GetBestShadeKernel());
+		}
+		EnableD3D11FrameExport(&Compositor, ExportRing, ExportConverter);
 	}
 	
-	Result = CompositionDevice->Commit();
-	if (FAILED(Result))
+	if (FRAME_RECORD)
 	{
-		Error("Commit");
+		recording_writer *Recorder = PushStruct(&Arena, recording_writer);
+		InitializeRecordingWriter(Recorder, Win32AllocateMemory, Win32FreeMemory);
+		
+		recording_header Header = GetRecordingHeader();
+		HANDLE RecordFile = CreateFileA(FRAME_RECORD_NAME, GENERIC_WRITE, FILE_SHARE_READ, NULL, CREATE_ALWAYS,
+										FILE_ATTRIBUTE_NORMAL, NULL);
+		DWORD Written = 0;
+		if ((RecordFile == INVALID_HANDLE_VALUE) || !WriteFile(RecordFile, &Header, sizeof(Header), &Written, NULL) ||
+			(Written != sizeof(Header)))
+		{
+			Error("CreateFileA(FRAME_RECORD_NAME)");
+		}
+		
+		EnableD3D11Recording(&Compositor, Recorder, RecordFile);
 	}
 	
-	// @Note Creation is handled per-frame because it's not reliable and it can be destoyed at any time so we need to recreate it
-	IDXGIOutputDuplication *OutputDuplication = NULL;
-	
-	//
-	// Render loop
-	//
-	
-	int ViewportWidth  = 0;
-	int ViewportHeight = 0;
+	// @Note A worker thread per output, AcquireNextFrame blocks and one slow output shouldn't hold up the others.
+	// Only the outputs a cut box covers are duplicated.
+	multi_output_source *Multi = PushStruct(&Arena, multi_output_source);
+	InitializeMultiOutputSource(Multi, Win32WaitEvent, Win32SignalEvent, Win32CreateEvent());
 	
-	for (;;)
+	for (u32 OutputIndex = 0; OutputIndex < OutputCount; ++OutputIndex)
 	{
-		//
-		// Update the viewport
-		//
+		win32_output *Output = &Outputs[OutputIndex];
 		
-		if ((ViewportWidth  != DisplayWidth) || 
-			(ViewportHeight != DisplayHeight))
-		{
-			ViewportWidth  = DisplayWidth;
-			ViewportHeight = DisplayHeight;
-			
-			D3D11_VIEWPORT Viewport;
-			Viewport.TopLeftX = 0;
-			Viewport.TopLeftY = 0;
-			Viewport.Width    = DisplayWidth;
-			Viewport.Height   = DisplayHeight;
-			Viewport.MinDepth = 0.0f;
-			Viewport.MaxDepth = 1.0f;
-			
-			DeviceContext->RSSetViewports(1, &Viewport);
-		}
+		dxgi_duplication_source *Source = PushStruct(&Arena, dxgi_duplication_source);
+		InitializeDuplicationSource(Source, &D3D, Output->AdapterIndex, Output->OutputIndex,
+									GetBoxWidth(Output->Rect), GetBoxHeight(Output->Rect), &Arena);
 		
-		//
-		// Update the constant buffer
-		//
+		output_worker *Worker = AddOutputWorker(Multi, DuplicationFrameSource(Source), Win32CreateEvent());
 		
-		if (RenderThreadCBufferVersion != WindowThreadCBufferVersion)
+		if (CAPTURE_RING)
 		{
-			RenderThreadCBufferVersion = WindowThreadCBufferVersion;
-			
-			DeviceContext->UpdateSubresource(ConstantBuffer, 0, NULL, &ConstantBufferResource, 0, 0);
+			Worker->CaptureRing = PushStruct(&Arena, capture_ring);
+			InitializeCaptureRing(Worker->CaptureRing, D3D11RingCopy, &D3D);
 		}
 		
-		//
-		// Capture the minimap
-		//
-		
-		IDXGIResource *DesktopResource;
-		DXGI_OUTDUPL_FRAME_INFO FrameInfo;
-		UINT Timeout = 100;
-		
-		if (OutputDuplication == NULL)
+		if (LatencyRecorder)
 		{
-			Result = Output1->DuplicateOutput(Device, &OutputDuplication);
-			if (FAILED(Result))
-			{
-				if (Result == E_ACCESSDENIED)
-				{
-					Sleep(100);
-					continue;
-				}
-				else
-				{
-					Error("DuplicateOutput");
-				}
-			}
+			Worker->LatencyRing = PushStruct(&Arena, latency_ring);
+			InitializeLatencyRing(Worker->LatencyRing, Win32GetNanoseconds);
+			AddLatencyRing(LatencyRecorder, Worker->LatencyRing);
 		}
 		
-		Result = OutputDuplication->AcquireNextFrame(INFINITE, &FrameInfo, &DesktopResource);
-		if (FAILED(Result))
+		DWORD OutputThreadID;
+		if (CreateThread(NULL, 0, OutputThread, (LPVOID)Worker, 0, &OutputThreadID) == NULL)
 		{
-			if (Result == DXGI_ERROR_ACCESS_LOST)
-			{
-				OutputDuplication->Release();
-				OutputDuplication = NULL;
-				continue;
-			}
-			else
-			{
-				Error("AcquireNextFrame");
-			}
+			Error("CreateThread(OutputThread)");
 		}
-		
-		ID3D11Texture2D *DesktopTexture;
-		Result = DesktopResource->QueryInterface(__uuidof(ID3D11Texture2D), (void **)&DesktopTexture);
-		if (FAILED(Result))
+	}
+	
+	overlay_pipeline Pipeline = {};
+	Pipeline.Source        = MultiOutputFrameSource(Multi);
+	Pipeline.Compositor    = D3D11Compositor(&Compositor);
+	Pipeline.Clock.Now     = Win32ClockNow;
+	Pipeline.StateExchange = &RenderStateExchange;
+	Pipeline.Commands      = &RenderCommands;
+	Pipeline.LatencyRing   = LatencyRing;
+	
+	// @Note The export and the recording are of the display texture, which a sampled piece never goes through
+	Pipeline.SampleSurfaces = (SAMPLE_SURFACES != 0) && !FRAME_EXPORT && !FRAME_RECORD;
+	
+	if (LatencyRecorder)
+	{
+		DWORD LatencyThreadID;
+		if (CreateThread(NULL, 0, LatencyThread, (LPVOID)LatencyRecorder, 0, &LatencyThreadID) == NULL)
 		{
-			Error("QueryInterface(ID3D11Texture2D)");
+			Error("CreateThread(LatencyThread)");
 		}
+	}
+	
+	//
+	// Render loop
+	//
+	
+	u64 ExportedCount = 0;
+	u64 RecordedCount = 0;
+	for (;;)
+	{
+		RunOverlayFrame(&Pipeline, FRAME_WAIT_SLICE_MS);
 		
-		D3D11_BOX CurrentCutBox = GlobalCutBox;
-		
-		DeviceContext->CopySubresourceRegion(DisplayTexture, 0, 
-											 0, 0, 0, 
-											 DesktopTexture, 0, 
-											 &CurrentCutBox);
-		
-		//
-		// Relesae the captured frame
-		//
-		
-		DesktopTexture->Release();
-		DesktopResource->Release();
-		
-		Result = OutputDuplication->ReleaseFrame();
-		if (FAILED(Result))
+		if (FRAME_EXPORT && (Pipeline.PresentedFrameCount > ExportedCount))
 		{
-			if (Result == DXGI_ERROR_ACCESS_LOST)
-			{
-				OutputDuplication->Release();
-				OutputDuplication = NULL;
-				continue;
-			}
-			else
-			{
-				Error("ReleaseFrame");
-			}
+			ExportedCount = Pipeline.PresentedFrameCount;
+			D3D11ExportFrame(&Compositor, Pipeline.Pieces, Pipeline.PieceCount, Pipeline.Clock.Now(Pipeline.Clock.Context));
 		}
 		
-		//
-		// Render the overlay
-		//
-		
-		DeviceContext->OMSetRenderTargets(1, &RenderTargetView, NULL);
-		
-		float ClearColour[4] = { 0.0f, 0.0f, 0.0f, 1.0f };
-		DeviceContext->ClearRenderTargetView(RenderTargetView, ClearColour);
-		
-		UINT VertexCount = 3;
-		UINT StartVertex = 0;
-		DeviceContext->Draw(VertexCount, StartVertex);
-		
-		// @Note For DXGI_SWAP_EFFECT_FLIP_SEQUENTIAL:
-		// 0 - Cancel the remaining time on the previously
-		//     presented frame and discard this frame if a newer frame is queued.
-		int SyncInterval = 0;
-		int Flags = 0;
-		Result = SwapChain->Present(SyncInterval, Flags);
-		if (FAILED(Result))
+		if (FRAME_RECORD && (Pipeline.PresentedFrameCount > RecordedCount))
 		{
-			if ((Result == DXGI_ERROR_DEVICE_RESET)   || 
-				(Result == DXGI_ERROR_DEVICE_REMOVED))
-			{
-				Device->Release();
-				DeviceContext->Release();
-				
-				Direct3DCreateDevice(&Device, &DeviceContext);
-			}
-			else
-			{
-				Error("Present");
-			}
+			RecordedCount = Pipeline.PresentedFrameCount;
+			D3D11RecordFrame(&Compositor, Pipeline.Pieces, Pipeline.PieceCount, &Pipeline.State.Shade,
+							 Pipeline.Clock.Now(Pipeline.Clock.Context));
 		}
 	}
 	
@@ -681,6 +694,15 @@ float Alpha  = 0.1f;
 
 void WINAPI WinMainCRTStartup()
 {
+	LARGE_INTEGER Frequency;
+	QueryPerformanceFrequency(&Frequency);
+	PerformanceFrequency = Frequency.QuadPart;
+	
+	if (BAKE_SHADERS)
+	{
+		BakeShaders();
+	}
+	
 	//
 	// Monitor info
 	//
@@ -697,16 +719,24 @@ void WINAPI WinMainCRTStartup()
 		MonitorHeight = Rect->bottom - Rect->top;
 	}
 	
+	EnumerateOutputs();
+	
 	//
 	// Default cut area
 	//
 	
-	GlobalCutBox.left   = MonitorWidth  - DisplayWidth;
-	GlobalCutBox.top    = MonitorHeight - DisplayHeight;
-	GlobalCutBox.right  = MonitorWidth;
-	GlobalCutBox.bottom = MonitorHeight;
-	GlobalCutBox.front  = 0;
-	GlobalCutBox.back   = 1;
+	int DisplayWidth  = 200;
+	int DisplayHeight = 200;
+	
+	box OutputRects[MAX_OUTPUTS];
+	for (u32 OutputIndex = 0; OutputIndex < OutputCount; ++OutputIndex)
+	{
+		OutputRects[OutputIndex] = Outputs[OutputIndex].Rect;
+	}
+	
+	render_state WindowState = DefaultRenderState(OutputRects, OutputCount, DisplayWidth, DisplayHeight);
+	WindowState.Shade.Effects.Key = OVERLAY_EFFECTS;
+	InitializeRenderStateExchange(&RenderStateExchange, &WindowState);
 	
 	//
 	// Window creation
@@ -738,13 +768,21 @@ void WINAPI WinMainCRTStartup()
 	int WindowX = (MonitorWidth  - DisplayWidth)  / 2;
 	int WindowY = (MonitorHeight - DisplayHeight) / 2;
 	
-	HWND Window = CreateWindowExW(ExtendedFlags, WindowClassDesc.lpszClassName, L"BigMap", 
-								  WS_POPUP | WS_VISIBLE, WindowX, WindowY, DisplayWidth, DisplayHeight, 
-								  NULL, NULL, WindowClassDesc.hInstance, NULL);
-	
-	if (Window == NULL)
+	// @Note One window per overlay slot, made up front so the render thread can set up composition
+	// for all of them once. Only the ones with an overlay are visible.
+	HWND Windows[MAX_OVERLAYS];
+	for (u32 WindowIndex = 0; WindowIndex < MAX_OVERLAYS; ++WindowIndex)
 	{
-		Error("CreateWindowExW");
+		DWORD Style = WS_POPUP | ((WindowIndex < WindowState.OverlayCount) ? WS_VISIBLE : 0);
+		
+		Windows[WindowIndex] = CreateWindowExW(ExtendedFlags, WindowClassDesc.lpszClassName, L"BigMap", 
+											   Style, WindowX, WindowY, DisplayWidth, DisplayHeight, 
+											   NULL, NULL, WindowClassDesc.hInstance, NULL);
+		
+		if (Windows[WindowIndex] == NULL)
+		{
+			Error("CreateWindowExW");
+		}
 	}
 	
 	//
@@ -755,7 +793,7 @@ void WINAPI WinMainCRTStartup()
 	Device.usUsagePage = 1; // Generic
 	Device.usUsage     = 6; // Keyboard
 	Device.dwFlags     = RIDEV_INPUTSINK | RIDEV_NOLEGACY;
-	Device.hwndTarget  = Window;
+	Device.hwndTarget  = Windows[0];
 	
 	if (RegisterRawInputDevices(&Device, 1, sizeof(Device)) == false)
 	{
@@ -767,7 +805,7 @@ void WINAPI WinMainCRTStartup()
 	//
 	
 	DWORD RenderThreadID;
-	HANDLE RenderThreadHandle = CreateThread(NULL, 0, RenderThread, (LPVOID)Window, 0, &RenderThreadID);
+	HANDLE RenderThreadHandle = CreateThread(NULL, 0, RenderThread, (LPVOID)Windows, 0, &RenderThreadID);
 	if (RenderThreadHandle == NULL)
 	{
 		Error("CreateThread(RenderThread)");
@@ -778,6 +816,8 @@ void WINAPI WinMainCRTStartup()
 	//
 	
 	size_t ControlIsDown = false;
+	size_t ShiftIsDown   = false;
+	size_t GraveIsDown   = false;
 	
 	size_t DragKeyScanCode	= SC_NUMPAD_5;
 	size_t DragKeyIsDown	= false;
@@ -825,6 +865,36 @@ void WINAPI WinMainCRTStartup()
 						{
 							ControlIsDown = IsDown;
 						}
+						else if (ScanCode == SC_SHIFTLEFT)
+						{
+							ShiftIsDown = IsDown;
+						}
+						else if (ScanCode == SC_GRAVE)
+						{
+							size_t GraveWasDown = GraveIsDown;
+							GraveIsDown = IsDown;
+							
+							if (GraveIsDown && !GraveWasDown)
+							{
+								if (ShiftIsDown)
+								{
+									// NEXT SCALING MODE, bilinear -> nearest -> mip -> bicubic -> Lanczos
+									WindowState.Shade.Scale = (scale_mode)((WindowState.Shade.Scale + 1) % ScaleMode_Count);
+								}
+								else
+								{
+									// NEXT PACING MODE, lowest latency -> capped -> match the desktop
+									WindowState.Pacing.Mode = (pacing_mode)((WindowState.Pacing.Mode + 1) % PacingMode_Count);
+								}
+								WindowState.Version++;
+								PublishRenderState(&RenderStateExchange, &WindowState);
+								
+								render_command Command;
+								Command.Type      = RenderCommand_StateChanged;
+								Command.IssueTime = Win32GetMicroseconds();
+								PushRenderCommand(&RenderCommands, Command);
+							}
+						}
 						else if (ScanCode == DragKeyScanCode)
 						{
 							size_t DragKeyWasDown = DragKeyIsDown;
@@ -853,44 +923,82 @@ void WINAPI WinMainCRTStartup()
 									// New cut area to capture
 									//
 									
-									D3D11_BOX DragCutBox;
-									DragCutBox.left		= Min(DragStartPoint.x, DragEndPoint.x);
-									DragCutBox.top		= Min(DragStartPoint.y, DragEndPoint.y);
-									DragCutBox.right	= Max(DragStartPoint.x, DragEndPoint.x);
-									DragCutBox.bottom	= Max(DragStartPoint.y, DragEndPoint.y);
-									DragCutBox.front	= 0;
-									DragCutBox.back     = 1;
+									box DragCutBox;
+									DragCutBox.Left		= Min(DragStartPoint.x, DragEndPoint.x);
+									DragCutBox.Top		= Min(DragStartPoint.y, DragEndPoint.y);
+									DragCutBox.Right	= Max(DragStartPoint.x, DragEndPoint.x);
+									DragCutBox.Bottom	= Max(DragStartPoint.y, DragEndPoint.y);
 									
-									int CutBoxWidth  = DragCutBox.right	 - DragCutBox.left;
-									int CutBoxHeight = DragCutBox.bottom - DragCutBox.top;
+									int CutBoxWidth  = GetBoxWidth(DragCutBox);
+									int CutBoxHeight = GetBoxHeight(DragCutBox);
 									
 									//
 									// New window dimensions
 									//
 									
-									if (!ControlIsDown)
+									// @Note Plain and control drags work on the newest overlay
+									u32 Selected = WindowState.OverlayCount - 1;
+									overlay_region *Overlay = &WindowState.Overlays[Selected];
+									bool StateChanged = true;
+									
+									if (ShiftIsDown)
+									{
+										if ((CutBoxWidth > 0) && (CutBoxHeight > 0))
+										{
+											// ADD AN OVERLAY
+											// @Note Shown 1:1 next to the last window, control drag it somewhere better
+											int Added = AddOverlay(&WindowState, DragCutBox, CutBoxWidth, CutBoxHeight);
+											if (Added >= 0)
+											{
+												int AddedX = WindowX + Added * WINDOW_CASCADE_STEP;
+												int AddedY = WindowY + Added * WINDOW_CASCADE_STEP;
+												
+												SetWindowPos(Windows[Added], NULL, AddedX, AddedY, CutBoxWidth, CutBoxHeight,
+															 SWP_NOCOPYBITS | SWP_NOACTIVATE | SWP_SHOWWINDOW);
+											}
+											else
+											{
+												StateChanged = false;
+											}
+										}
+										else if (WindowState.OverlayCount > 1)
+										{
+											// REMOVE THE NEWEST OVERLAY, a shift tap without a drag
+											RemoveOverlay(&WindowState, Selected);
+											ShowWindow(Windows[Selected], SW_HIDE);
+										}
+										else
+										{
+											StateChanged = false;
+										}
+									}
+									else if (!ControlIsDown)
 									{
 										// CHANGE THE CAPTURE REGION
-										GlobalCutBox = DragCutBox;
-										
-										v2 *Transform = &CBuffer.TextureTransform;
-										Transform->X = 1.0f / (1280.0f / CutBoxWidth);
-										Transform->Y = 1.0f / (1024.0f / CutBoxHeight);
-										
-										// @Todo There should be fence here :P
-										
-										// Tell the render thread to update the constant buffer
-										WindowThreadCBufferVersion++;
+										// @Note The render thread finds it a slot in the display texture
+										Overlay->CutBox = DragCutBox;
 									}
 									else
 									{
 										// CHANGE THE WINDOW REGION
-										WindowX	= DragCutBox.left;
-										WindowY	= DragCutBox.top;
-										DisplayWidth	= CutBoxWidth;
-										DisplayHeight	= CutBoxHeight;
+										// @Note The render thread finds it a slot in the swap chain
+										Overlay->DisplayWidth	= CutBoxWidth;
+										Overlay->DisplayHeight	= CutBoxHeight;
+										
+										SetWindowPos(Windows[Selected], NULL, DragCutBox.Left, DragCutBox.Top, CutBoxWidth, CutBoxHeight,
+													 SWP_NOCOPYBITS | SWP_NOACTIVATE);
+									}
+									
+									if (StateChanged)
+									{
+										// Hand the whole thing to the render thread in one go and wake it up
+										WindowState.Version++;
+										PublishRenderState(&RenderStateExchange, &WindowState);
 										
-										SetWindowPos(Window, NULL, WindowX, WindowY, DisplayWidth, DisplayHeight, SWP_NOCOPYBITS);
+										render_command Command;
+										Command.Type      = RenderCommand_StateChanged;
+										Command.IssueTime = Win32GetMicroseconds();
+										PushRenderCommand(&RenderCommands, Command);
 									}
 								}
 								